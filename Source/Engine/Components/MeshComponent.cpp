@@ -200,7 +200,7 @@ void MeshComponent::GraphicsSceneObjectUpdate(
 			worldBounds.TransformBy( transform );
 		}
 
-		pSceneObject->SetWorldBounds( worldBounds );
+		pScene->SetSceneObjectWorldBounds( graphicsSceneObjectId, worldBounds );
 
 		return;
 	}
@@ -216,7 +216,7 @@ void MeshComponent::GraphicsSceneObjectUpdate(
 		worldBounds.TransformBy( transform );
 	}
 
-	pSceneObject->SetWorldBounds( worldBounds );
+	pScene->SetSceneObjectWorldBounds( graphicsSceneObjectId, worldBounds );
 
 	const DynamicArray< size_t >& rSubMeshDataIds = pThis->m_graphicsSceneObjectSubMeshDataIds;
 	size_t subMeshCount = rSubMeshDataIds.GetSize();
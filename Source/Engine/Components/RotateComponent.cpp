@@ -80,7 +80,7 @@ void Helium::RotateComponent::ApplyRotation( TransformComponent *pTransform )
 
 //////////////////////////////////////////////////////////////////////////
 
-void UpdateRotateComponents(RotateComponent *pRotate, TransformComponent *pTransform)
+void UpdateRotateComponents(RotateComponent *pRotate, TransformComponent *pTransform, ComponentCommandBuffer &)
 {
 	pRotate->ApplyRotation(pTransform);
 }
@@ -89,6 +89,9 @@ void Helium::UpdateRotateComponentsTask::DefineContract( TaskContract &rContract
 {
 	rContract.ExecuteBefore<StandardDependencies::ProcessPhysics>();
 	rContract.ExecuteAfter<StandardDependencies::ReceiveInput>();
+	rContract.ReadsComponent<RotateComponent>();
+	rContract.WritesComponent<TransformComponent>();
+	rContract.SetWorldAffinity(WorldAffinities::PerWorld);
 }
 
-HELIUM_DEFINE_TASK( UpdateRotateComponentsTask, (ForEachWorld< QueryComponents< RotateComponent, TransformComponent, UpdateRotateComponents > >), TickTypes::Gameplay )
+HELIUM_DEFINE_TASK( UpdateRotateComponentsTask, (ForEachWorld< ParallelQueryComponents< RotateComponent, TransformComponent, UpdateRotateComponents > >), TickTypes::Gameplay )
@@ -49,7 +49,7 @@ void Helium::TransformComponentDefinition::PopulateMetaType( Reflect::MetaStruct
 //    }
 //}
 
-void ClearTransformComponentDirtyFlags( TransformComponent *pComponent )
+void ClearTransformComponentDirtyFlags( TransformComponent *pComponent, ComponentCommandBuffer & )
 {
 	pComponent->ClearDirtyFlag();
 }
@@ -57,7 +57,9 @@ void ClearTransformComponentDirtyFlags( TransformComponent *pComponent )
 void Helium::ClearTransformComponentDirtyFlagsTask::DefineContract( TaskContract &rContract )
 {
 	rContract.ExecuteAfter<StandardDependencies::Render>();
+	rContract.WritesComponent<TransformComponent>();
+	rContract.SetWorldAffinity(WorldAffinities::PerWorld);
 }
 
 //HELIUM_DEFINE_TASK(ClearTransformComponentDirtyFlagsTask, ForEachWorld<ClearTransformComponentDirtyFlags> )
-HELIUM_DEFINE_TASK( ClearTransformComponentDirtyFlagsTask, (ForEachWorld< QueryComponents< TransformComponent, ClearTransformComponentDirtyFlags > >), TickTypes::Render )
+HELIUM_DEFINE_TASK( ClearTransformComponentDirtyFlagsTask, (ForEachWorld< ParallelQueryComponents< TransformComponent, ClearTransformComponentDirtyFlags > >), TickTypes::Render )
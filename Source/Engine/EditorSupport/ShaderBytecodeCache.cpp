@@ -0,0 +1,342 @@
+#include "Precompile.h"
+
+#if HELIUM_TOOLS
+
+#include "EditorSupport/ShaderBytecodeCache.h"
+
+#include "Foundation/FileStream.h"
+
+#include <cstdio>
+
+using namespace Helium;
+
+/// Shader bytecode cache entry file signature.
+static const uint32_t SHADER_BYTECODE_CACHE_SIGNATURE = 0x5cbc0de5;
+
+/// Constructor.
+ShaderBytecodeCache::ShaderBytecodeCache()
+: m_bInitialized( false )
+{
+}
+
+/// Destructor.
+ShaderBytecodeCache::~ShaderBytecodeCache()
+{
+}
+
+/// Set up the cache for use.
+///
+/// @param[in] rDirectory  Directory in which to store compiled shader code, without a trailing path separator.  This
+///                        will be created if it does not already exist.
+///
+/// @return  True if the cache directory is available, false if not.
+///
+/// @see Shutdown()
+bool ShaderBytecodeCache::Initialize( const FilePath& rDirectory )
+{
+	Shutdown();
+
+	m_directory = rDirectory;
+	if( !m_directory.MakePath() )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"ShaderBytecodeCache: Failed to create cache directory \"%s\".  Compiled shaders will not be cached.\n",
+			m_directory.Data() );
+
+		m_directory.Clear();
+
+		return false;
+	}
+
+	m_directory += "/";
+	m_bInitialized = true;
+
+	return true;
+}
+
+/// Stop using the cache directory.
+///
+/// @see Initialize()
+void ShaderBytecodeCache::Shutdown()
+{
+	m_bInitialized = false;
+	m_directory.Clear();
+}
+
+/// Look up compiled shader code.
+///
+/// If another thread is already compiling the shader for the same key, this waits for it to finish and returns its
+/// result.  Otherwise, when no valid entry is found, the calling thread becomes responsible for compiling the shader
+/// and must pass the result to Store(), which wakes any threads that started waiting on the key in the meantime.
+///
+/// @param[in]  key            Hash of the shader compiler inputs.
+/// @param[out] rCompiledCode  Compiled shader code, if found.
+///
+/// @return  True if compiled code was found, false if the caller needs to compile the shader and call Store().
+///
+/// @see Store()
+bool ShaderBytecodeCache::Find( uint64_t key, DynamicArray< uint8_t >& rCompiledCode )
+{
+	rCompiledCode.Resize( 0 );
+
+	if( !m_bInitialized )
+	{
+		return false;
+	}
+
+	for( ; ; )
+	{
+		PendingCompile* pPendingCompile = NULL;
+		{
+			MutexScopeLock scopeLock( m_lock );
+
+			PendingCompileMap::Iterator pendingIterator;
+			if( m_pendingCompiles.Insert( pendingIterator, PendingCompileMap::ValueType( key, NULL ) ) )
+			{
+				pendingIterator->Second() = new PendingCompile;
+			}
+			else
+			{
+				pPendingCompile = pendingIterator->Second();
+				HELIUM_ASSERT( pPendingCompile );
+				++pPendingCompile->referenceCount;
+			}
+		}
+
+		if( !pPendingCompile )
+		{
+			break;
+		}
+
+		pPendingCompile->finishedCondition.Wait();
+		rCompiledCode = pPendingCompile->compiledCode;
+		ReleasePendingCompile( pPendingCompile );
+
+		if( !rCompiledCode.IsEmpty() )
+		{
+			return true;
+		}
+
+		// The other thread failed to compile the shader, so try again in case this was due to a transient error.
+	}
+
+	// This thread now owns the key, so other threads looking it up will wait on us while the entry file is read.
+	if( ReadEntry( key, rCompiledCode ) )
+	{
+		FinishPendingCompile( key, rCompiledCode );
+
+		return true;
+	}
+
+	return false;
+}
+
+/// Add compiled shader code to the cache, replacing any existing entry with the same key.
+///
+/// This must be called for every key for which Find() returned false, even if compiling failed.
+///
+/// @param[in] key            Hash of the shader compiler inputs.
+/// @param[in] rCompiledCode  Compiled shader code, or an empty buffer if compiling failed.
+///
+/// @see Find()
+void ShaderBytecodeCache::Store( uint64_t key, const DynamicArray< uint8_t >& rCompiledCode )
+{
+	if( m_bInitialized && !rCompiledCode.IsEmpty() )
+	{
+		WriteEntry( key, rCompiledCode );
+	}
+
+	FinishPendingCompile( key, rCompiledCode );
+}
+
+/// Get the name of the file in which the entry for a given key is stored.
+///
+/// @param[in] key  Cache key.
+///
+/// @return  Entry file name.
+String ShaderBytecodeCache::GetEntryFileName( uint64_t key ) const
+{
+	char keyString[ 32 ];
+	StringPrint( keyString, "%016" PRIx64 ".bin", key );
+	keyString[ HELIUM_ARRAY_COUNT( keyString ) - 1 ] = '\0';
+
+	String entryFileName( m_directory.Data() );
+	entryFileName += keyString;
+
+	return entryFileName;
+}
+
+/// Read the entry file for a given key.
+///
+/// @param[in]  key            Cache key.
+/// @param[out] rCompiledCode  Compiled shader code, if found.
+///
+/// @return  True if a valid entry was read, false if not.
+bool ShaderBytecodeCache::ReadEntry( uint64_t key, DynamicArray< uint8_t >& rCompiledCode ) const
+{
+	rCompiledCode.Resize( 0 );
+
+	String entryFileName = GetEntryFileName( key );
+
+	FileStream* pStream = FileStream::OpenFileStream( entryFileName, FileStream::MODE_READ );
+	if( !pStream )
+	{
+		return false;
+	}
+
+	// Entries with a mismatched header or truncated data are treated as missing and will be overwritten once the
+	// shader has been recompiled.
+	EntryHeader header;
+	bool bValid =
+		pStream->Read( &header, sizeof( header ), 1 ) == 1 &&
+		header.signature == SHADER_BYTECODE_CACHE_SIGNATURE &&
+		header.version == sm_Version &&
+		header.key == key &&
+		header.size != 0 &&
+		header.size <= static_cast< uint64_t >( pStream->GetSize() ) - sizeof( header );
+	if( bValid )
+	{
+		size_t size = static_cast< size_t >( header.size );
+		rCompiledCode.Resize( size );
+		bValid = ( pStream->Read( rCompiledCode.GetData(), 1, size ) == size );
+	}
+
+	delete pStream;
+
+	if( !bValid )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"ShaderBytecodeCache: Ignoring invalid cache entry \"%s\".\n",
+			*entryFileName );
+
+		rCompiledCode.Resize( 0 );
+
+		return false;
+	}
+
+	return true;
+}
+
+/// Write the entry file for a given key.
+///
+/// The entry is written to a temporary file first and then renamed into place, so readers (including other
+/// processes sharing the cache directory) never see a partially written entry.
+///
+/// @param[in] key            Cache key.
+/// @param[in] rCompiledCode  Compiled shader code.
+///
+/// @return  True if the entry was written, false if not.
+bool ShaderBytecodeCache::WriteEntry( uint64_t key, const DynamicArray< uint8_t >& rCompiledCode ) const
+{
+	HELIUM_ASSERT( !rCompiledCode.IsEmpty() );
+
+	String entryFileName = GetEntryFileName( key );
+	String tempFileName = entryFileName;
+	tempFileName += ".tmp";
+
+	EntryHeader header;
+	header.signature = SHADER_BYTECODE_CACHE_SIGNATURE;
+	header.version = sm_Version;
+	header.key = key;
+	header.size = rCompiledCode.GetSize();
+
+	FileStream* pStream = FileStream::OpenFileStream( tempFileName, FileStream::MODE_WRITE, true );
+	if( !pStream )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"ShaderBytecodeCache: Failed to open \"%s\" for writing.\n",
+			*tempFileName );
+
+		return false;
+	}
+
+	bool bSuccess =
+		pStream->Write( &header, sizeof( header ), 1 ) == 1 &&
+		pStream->Write( rCompiledCode.GetData(), 1, rCompiledCode.GetSize() ) == rCompiledCode.GetSize();
+
+	delete pStream;
+
+	// Renaming over an existing file fails on some platforms, so fall back to removing the old file first.
+	if( bSuccess &&
+		std::rename( *tempFileName, *entryFileName ) != 0 &&
+		( std::remove( *entryFileName ) != 0 || std::rename( *tempFileName, *entryFileName ) != 0 ) )
+	{
+		bSuccess = false;
+	}
+
+	if( !bSuccess )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"ShaderBytecodeCache: Failed to write cache entry \"%s\".\n",
+			*entryFileName );
+
+		std::remove( *tempFileName );
+	}
+
+	return bSuccess;
+}
+
+/// Publish the result of compiling a shader to any threads waiting on it and remove the key from the pending compile
+/// table.
+///
+/// @param[in] key            Cache key.
+/// @param[in] rCompiledCode  Compiled shader code, or an empty buffer if compiling failed.
+void ShaderBytecodeCache::FinishPendingCompile( uint64_t key, const DynamicArray< uint8_t >& rCompiledCode )
+{
+	PendingCompile* pPendingCompile = NULL;
+	{
+		MutexScopeLock scopeLock( m_lock );
+
+		PendingCompileMap::Iterator pendingIterator = m_pendingCompiles.Find( key );
+		if( pendingIterator != m_pendingCompiles.End() )
+		{
+			pPendingCompile = pendingIterator->Second();
+			m_pendingCompiles.Remove( pendingIterator );
+		}
+	}
+
+	if( !pPendingCompile )
+	{
+		return;
+	}
+
+	// Waiting threads only read the result once signaled, so it can be filled in without holding the lock.
+	pPendingCompile->compiledCode = rCompiledCode;
+	pPendingCompile->finishedCondition.Signal();
+
+	ReleasePendingCompile( pPendingCompile );
+}
+
+/// Drop a reference to a pending compile record, deleting it once no thread is using it.
+///
+/// @param[in] pPendingCompile  Pending compile record.
+void ShaderBytecodeCache::ReleasePendingCompile( PendingCompile* pPendingCompile )
+{
+	HELIUM_ASSERT( pPendingCompile );
+
+	bool bDelete;
+	{
+		MutexScopeLock scopeLock( m_lock );
+
+		HELIUM_ASSERT( pPendingCompile->referenceCount != 0 );
+		bDelete = ( --pPendingCompile->referenceCount == 0 );
+	}
+
+	if( bDelete )
+	{
+		delete pPendingCompile;
+	}
+}
+
+/// Constructor.
+ShaderBytecodeCache::PendingCompile::PendingCompile()
+: finishedCondition( true, false )
+, referenceCount( 1 )
+{
+}
+
+#endif  // HELIUM_TOOLS
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "EditorSupport/EditorSupport.h"
+
+#if HELIUM_TOOLS
+
+#include "Platform/Condition.h"
+#include "Platform/Locks.h"
+#include "Foundation/DynamicArray.h"
+#include "Foundation/FilePath.h"
+#include "Foundation/HashMap.h"
+
+namespace Helium
+{
+    /// Persistent store of compiled shader code, keyed on a hash of everything that affects the compiler output.
+    ///
+    /// Each entry is stored as a separate file in a local directory, so compiled code is shared between all shader
+    /// variants with identical inputs as well as across runs of the tools.
+    ///
+    /// A key that misses in the cache is handed to exactly one caller to compile.  Other threads looking up the same
+    /// key in the meantime wait for that compile to finish instead of compiling the shader again.
+    class HELIUM_EDITOR_SUPPORT_API ShaderBytecodeCache : NonCopyable
+    {
+    public:
+        /// Entry file format version.  Entries with a different version are ignored and recompiled.
+        static const uint32_t sm_Version = 1;
+
+        /// @name Construction/Destruction
+        //@{
+        ShaderBytecodeCache();
+        ~ShaderBytecodeCache();
+        //@}
+
+        /// @name Initialization
+        //@{
+        bool Initialize( const FilePath& rDirectory );
+        void Shutdown();
+
+        inline bool IsInitialized() const;
+        //@}
+
+        /// @name Cache Access
+        //@{
+        bool Find( uint64_t key, DynamicArray< uint8_t >& rCompiledCode );
+        void Store( uint64_t key, const DynamicArray< uint8_t >& rCompiledCode );
+        //@}
+
+    private:
+        /// Entry file header.
+        struct EntryHeader
+        {
+            /// File signature.
+            uint32_t signature;
+            /// File format version.
+            uint32_t version;
+            /// Cache key.
+            uint64_t key;
+            /// Compiled code size, in bytes.
+            uint64_t size;
+        };
+
+        /// Compile in progress for a key, shared by the thread compiling it and any threads waiting on the result.
+        struct PendingCompile
+        {
+            /// Signaled once the compiled code is available.
+            Condition finishedCondition;
+            /// Compiled code, or an empty buffer if compiling failed.
+            DynamicArray< uint8_t > compiledCode;
+            /// Number of threads still using this record (guarded by the cache lock).
+            uint32_t referenceCount;
+
+            PendingCompile();
+        };
+
+        /// Pending compile lookup table type.
+        typedef HashMap< uint64_t, PendingCompile* > PendingCompileMap;
+
+        /// Directory in which entry files are stored.
+        FilePath m_directory;
+        /// True if the cache directory is available.
+        bool m_bInitialized;
+
+        /// Compiles in progress, by key.
+        PendingCompileMap m_pendingCompiles;
+        /// Mutex guarding the pending compile table.  Entry files are read and written without holding it.
+        Mutex m_lock;
+
+        /// @name Private Utility Functions
+        //@{
+        String GetEntryFileName( uint64_t key ) const;
+        bool ReadEntry( uint64_t key, DynamicArray< uint8_t >& rCompiledCode ) const;
+        bool WriteEntry( uint64_t key, const DynamicArray< uint8_t >& rCompiledCode ) const;
+        void FinishPendingCompile( uint64_t key, const DynamicArray< uint8_t >& rCompiledCode );
+        void ReleasePendingCompile( PendingCompile* pPendingCompile );
+        //@}
+    };
+}
+
+#include "EditorSupport/ShaderBytecodeCache.inl"
+
+#endif  // HELIUM_TOOLS
@@ -0,0 +1,12 @@
+namespace Helium
+{
+    /// Get whether the cache directory has been set up successfully.
+    ///
+    /// @return  True if the cache is available for use, false if not.
+    ///
+    /// @see Initialize(), Shutdown()
+    bool ShaderBytecodeCache::IsInitialized() const
+    {
+        return m_bInitialized;
+    }
+}
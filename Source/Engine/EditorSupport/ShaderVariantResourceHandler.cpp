@@ -13,6 +13,7 @@
 #include "Engine/PackageLoader.h"
 #include "Rendering/ShaderProfiles.h"
 #include "PcSupport/AssetPreprocessor.h"
+#include "EngineJobs/JobManager.h"
 
 HELIUM_IMPLEMENT_ASSET( Helium::ShaderVariantResourceHandler, EditorSupport, 0 );
 
@@ -29,6 +30,15 @@ ShaderVariantResourceHandler::ShaderVariantResourceHandler()
 	HELIUM_ASSERT( !Shader::GetVariantLoadOverrideData() );
 
 	Shader::SetVariantLoadOverride( BeginLoadVariantCallback, TryFinishLoadVariantCallback, this );
+
+	// Compiled shader code is kept in the user directory so that it persists across runs without being tied to the
+	// data set being edited.
+	FilePath bytecodeCachePath;
+	if( FileLocations::GetUserDirectory( bytecodeCachePath ) )
+	{
+		bytecodeCachePath += "ShaderCache";
+		m_bytecodeCache.Initialize( bytecodeCachePath );
+	}
 }
 
 /// Destructor.
@@ -36,6 +46,19 @@ ShaderVariantResourceHandler::~ShaderVariantResourceHandler()
 {
 }
 
+/// Set the directory in which compiled shader code is cached.
+///
+/// By default, compiled code is cached in the "ShaderCache" directory under the user directory.
+///
+/// @param[in] rDirectory  Cache directory, without a trailing path separator.  This will be created if it does not
+///                        already exist.
+///
+/// @return  True if the cache directory is available, false if not (in which case shaders are always compiled).
+bool ShaderVariantResourceHandler::SetBytecodeCacheDirectory( const FilePath& rDirectory )
+{
+	return m_bytecodeCache.Initialize( rDirectory );
+}
+
 /// @copydoc ResourceHandler::GetResourceType()
 const AssetType* ShaderVariantResourceHandler::GetResourceType() const
 {
@@ -140,8 +163,6 @@ bool ShaderVariantResourceHandler::CacheResource(
 		pToken->definition = "1";
 	}
 
-	size_t userShaderTokenCount = shaderTokens.GetSize();
-
 	// Load the entire shader resource into memory.
 	FileStream* pSourceFileStream = FileStream::OpenFileStream( rSourceFilePath, FileStream::MODE_READ );
 	if( !pSourceFileStream )
@@ -239,23 +260,30 @@ bool ShaderVariantResourceHandler::CacheResource(
 		rPreprocessedData.bLoaded = true;
 	}
 
-//     DynamicArray< uint8_t > compiledCodeBuffer;
-//     DynamicArray< ShaderConstantBufferInfo > constantBuffers, pcSm4ConstantBuffers;
-//     DynamicArray< ShaderSamplerInfo > samplerInputs;
-//     DynamicArray< ShaderTextureInfo > textureInputs;
-	
-	Helium::StrongPtr<CompiledShaderData> spCompiledShaderData(new CompiledShaderData());
-	
-	CompiledShaderData &csd_pc_sm4 = *spCompiledShaderData;
-
+	// Gather the option tokens for each system option set up front, then compile the sets in parallel.  Each set
+	// writes to its own sub-data buffers, which were all allocated above.
+	DynamicArray< CompileOptionSetTask > tasks;
+	tasks.Reserve( systemOptionSetCount );
 	for( size_t systemOptionSetIndex = 0; systemOptionSetIndex < systemOptionSetCount; ++systemOptionSetIndex )
 	{
+		CompileOptionSetTask* pTask = tasks.New();
+		HELIUM_ASSERT( pTask );
+		pTask->pHandler = this;
+		pTask->pAssetPreprocessor = pAssetPreprocessor;
+		pTask->pVariant = pVariant;
+		pTask->shaderType = shaderType;
+		pTask->pShaderSourceData = pShaderSource;
+		pTask->shaderSourceSize = size;
+		pTask->systemOptionSetIndex = systemOptionSetIndex;
+		pTask->systemOptionSetCount = systemOptionSetCount;
+		pTask->tokens = shaderTokens;
+
 		rSystemOptions.GetOptionSetFromIndex( shaderType, systemOptionSetIndex, toggleNames, selectPairs );
 
 		size_t systemToggleNameCount = toggleNames.GetSize();
 		for( size_t toggleNameIndex = 0; toggleNameIndex < systemToggleNameCount; ++toggleNameIndex )
 		{
-			PlatformPreprocessor::ShaderToken* pToken = shaderTokens.New();
+			PlatformPreprocessor::ShaderToken* pToken = pTask->tokens.New();
 			HELIUM_ASSERT( pToken );
 			StringConverter< char, char >::Convert( pToken->name, *toggleNames[ toggleNameIndex ] );
 			pToken->definition = "1";
@@ -266,137 +294,35 @@ bool ShaderVariantResourceHandler::CacheResource(
 		{
 			const Shader::SelectPair& rPair = selectPairs[ selectPairIndex ];
 
-			PlatformPreprocessor::ShaderToken* pToken = shaderTokens.New();
+			PlatformPreprocessor::ShaderToken* pToken = pTask->tokens.New();
 			HELIUM_ASSERT( pToken );
 			StringConverter< char, char >::Convert( pToken->name, *rPair.name );
 			pToken->definition = "1";
 
-			pToken = shaderTokens.New();
+			pToken = pTask->tokens.New();
 			HELIUM_ASSERT( pToken );
 			StringConverter< char, char >::Convert( pToken->name, *rPair.choice );
 			pToken->definition = "1";
 		}
+	}
 
-		// Compile for PC shader model 4 first so that we can get the constant buffer information.
-		PlatformPreprocessor* pPreprocessor = pAssetPreprocessor->GetPlatformPreprocessor( Cache::PLATFORM_PC );
-		HELIUM_ASSERT( pPreprocessor );
-
-		csd_pc_sm4.compiledCodeBuffer.Resize( 0 );
-		bool bCompiled = CompileShader(
-			pVariant,
-			pPreprocessor,
-			Cache::PLATFORM_PC,
-			ShaderProfile::PC_SM4,
-			shaderType,
-			pShaderSource,
-			size,
-			shaderTokens,
-			csd_pc_sm4.compiledCodeBuffer );
-		if( !bCompiled )
+	JobManager* pJobManager = JobManager::GetInstance();
+	if( !pJobManager || systemOptionSetCount < 2 )
+	{
+		for( size_t taskIndex = 0; taskIndex < systemOptionSetCount; ++taskIndex )
 		{
-			HELIUM_TRACE(
-				TraceLevels::Error,
-				"ShaderVariantResourceHandler: Failed to compile shader for PC shader model 4, which is needed for reflection purposes.  Additional shader targets will not be built.\n" );
+			RunCompileOptionSetTask( &tasks[ taskIndex ] );
 		}
-		else
+	}
+	else
+	{
+		JobCounter counter;
+		for( size_t taskIndex = 0; taskIndex < systemOptionSetCount; ++taskIndex )
 		{
-			csd_pc_sm4.constantBuffers.Resize( 0 );
-			csd_pc_sm4.samplerInputs.Resize( 0 );
-			csd_pc_sm4.textureInputs.Resize( 0 );
-			bool bReadConstantBuffers = pPreprocessor->FillShaderReflectionData(
-				ShaderProfile::PC_SM4,
-				csd_pc_sm4.compiledCodeBuffer.GetData(),
-				csd_pc_sm4.compiledCodeBuffer.GetSize(),
-				csd_pc_sm4.constantBuffers,
-				csd_pc_sm4.samplerInputs,
-				csd_pc_sm4.textureInputs );
-			if( !bReadConstantBuffers )
-			{
-				HELIUM_TRACE(
-					TraceLevels::Error,
-					"ShaderVariantResourceHandler: Failed to read reflection information for PC shader model 4.  Additional shader targets will not be built.\n" );
-			}
-			else
-			{
-				Resource::PreprocessedData& rPcPreprocessedData = pVariant->GetPreprocessedData(
-					Cache::PLATFORM_PC );
-				DynamicArray< DynamicArray< uint8_t > >& rPcSubDataBuffers = rPcPreprocessedData.subDataBuffers;
-				DynamicArray< uint8_t >& rPcSm4SubDataBuffer =
-					rPcSubDataBuffers[ ShaderProfile::PC_SM4 * systemOptionSetCount + systemOptionSetIndex ];
-
-				Cache::WriteCacheObjectToBuffer( &csd_pc_sm4, rPcSm4SubDataBuffer);
-				
-				// FOR EACH PLATFORM
-				for( size_t platformIndex = 0;
-					platformIndex < static_cast< size_t >( Cache::PLATFORM_MAX );
-					++platformIndex )
-				{
-					PlatformPreprocessor* pPreprocessor = pAssetPreprocessor->GetPlatformPreprocessor(
-						static_cast< Cache::EPlatform >( platformIndex ) );
-					if( !pPreprocessor )
-					{
-						continue;
-					}
-					
-					// GET PLATFORM'S SUBDATA BUFFER
-					Resource::PreprocessedData& rPreprocessedData = pVariant->GetPreprocessedData(
-						static_cast< Cache::EPlatform >( platformIndex ) );
-					DynamicArray< DynamicArray< uint8_t > >& rSubDataBuffers = rPreprocessedData.subDataBuffers;
-
-					size_t shaderProfileCount = pPreprocessor->GetShaderProfileCount();
-					for( size_t shaderProfileIndex = 0;
-						shaderProfileIndex < shaderProfileCount;
-						++shaderProfileIndex )
-					{
-						CompiledShaderData csd;
-						csd.GetRefCountProxy()->AddStrongRef(); // stack allocated object!!
-
-						// Already cached PC shader model 4...
-						if( shaderProfileIndex == ShaderProfile::PC_SM4 && platformIndex == Cache::PLATFORM_PC )
-						{
-							continue;
-						}
-
-						bCompiled = CompileShader(
-							pVariant,
-							pPreprocessor,
-							platformIndex,
-							shaderProfileIndex,
-							shaderType,
-							pShaderSource,
-							size,
-							shaderTokens,
-							csd.compiledCodeBuffer );
-						if( !bCompiled )
-						{
-							continue;
-						}
-
-						csd.constantBuffers = csd_pc_sm4.constantBuffers;
-						csd.samplerInputs.Resize( 0 );
-						csd.textureInputs.Resize( 0 );
-						bReadConstantBuffers = pPreprocessor->FillShaderReflectionData(
-							shaderProfileIndex,
-							csd.compiledCodeBuffer.GetData(),
-							csd.compiledCodeBuffer.GetSize(),
-							csd.constantBuffers,
-							csd.samplerInputs,
-							csd.textureInputs );
-						if( !bReadConstantBuffers )
-						{
-							continue;
-						}
-
-						DynamicArray< uint8_t >& rTargetSubDataBuffer =
-							rSubDataBuffers[ shaderProfileIndex * systemOptionSetCount + systemOptionSetIndex ];
-						Cache::WriteCacheObjectToBuffer( &csd, rTargetSubDataBuffer);
-					}
-				}
-			}
+			pJobManager->Spawn( RunCompileOptionSetTask, &tasks[ taskIndex ], counter );
 		}
 
-		// Trim the system tokens off the shader token list for the next pass.
-		shaderTokens.Resize( userShaderTokenCount );
+		pJobManager->Wait( counter );
 	}
 
 	allocator.Free( pShaderSource );
@@ -614,6 +540,7 @@ bool ShaderVariantResourceHandler::TryFinishLoadVariantCallback(
 
 /// Helper function for compiling a shader for a specific profile.
 ///
+/// @param[in]  rBytecodeCache       Cache of previously compiled shader code.
 /// @param[in]  pVariant             Shader variant for which we are compiling.
 /// @param[in]  pPreprocessor        Platform preprocessor to use for compiling.
 /// @param[in]  platformIndex        Platform index.
@@ -626,6 +553,7 @@ bool ShaderVariantResourceHandler::TryFinishLoadVariantCallback(
 ///
 /// @return  True if compiling was successful, false if not.
 bool ShaderVariantResourceHandler::CompileShader(
+	ShaderBytecodeCache& rBytecodeCache,
 	ShaderVariant* pVariant,
 	PlatformPreprocessor* pPreprocessor,
 	size_t platformIndex,
@@ -641,8 +569,6 @@ bool ShaderVariantResourceHandler::CompileShader(
 	HELIUM_ASSERT( static_cast< size_t >( shaderType ) < static_cast< size_t >( RShader::TYPE_MAX ) );
 	HELIUM_ASSERT( pShaderSourceData || shaderSourceSize == 0 );
 
-	HELIUM_UNREF( platformIndex );  // Variable is used for logging only.
-
 	rCompiledCodeBuffer.Resize( 0 );
 
 #if HELIUM_ENABLE_TRACE
@@ -661,7 +587,12 @@ bool ShaderVariantResourceHandler::CompileShader(
 
 	shaderFilePath += pVariant->GetPath().GetParent().ToFilePathString().GetData();
 
-	bool bCompileResult = pPreprocessor->CompileShader(
+	// Use the previously compiled code if the shader has already been compiled with the same inputs, whether by
+	// another variant or during a previous run.  If another option set is compiling the same inputs right now, this
+	// waits for it to finish.
+	uint64_t cacheKey = 0;
+	DynamicArray< uint8_t > preprocessedCode;
+	bool bCacheable = rBytecodeCache.IsInitialized() && pPreprocessor->ComputeShaderCacheKey(
 		shaderFilePath,
 		shaderProfileIndex,
 		shaderType,
@@ -669,6 +600,40 @@ bool ShaderVariantResourceHandler::CompileShader(
 		shaderSourceSize,
 		rTokens.GetData(),
 		rTokens.GetSize(),
+		cacheKey,
+		preprocessedCode );
+	if( bCacheable )
+	{
+		// Platforms may share profile indices, so make sure the key is unique to the target platform as well.
+		cacheKey ^= ( static_cast< uint64_t >( platformIndex ) + 1 ) * 0x9e3779b97f4a7c15ULL;
+		if( rBytecodeCache.Find( cacheKey, rCompiledCodeBuffer ) )
+		{
+			return true;
+		}
+	}
+
+	// Compile the preprocessed code computed along with the key if there is any, as the tokens have already been
+	// applied to it.
+	const void* pCompileSourceData = pShaderSourceData;
+	size_t compileSourceSize = shaderSourceSize;
+	const PlatformPreprocessor::ShaderToken* pCompileTokens = rTokens.GetData();
+	size_t compileTokenCount = rTokens.GetSize();
+	if( !preprocessedCode.IsEmpty() )
+	{
+		pCompileSourceData = preprocessedCode.GetData();
+		compileSourceSize = preprocessedCode.GetSize();
+		pCompileTokens = NULL;
+		compileTokenCount = 0;
+	}
+
+	bool bCompileResult = pPreprocessor->CompileShader(
+		shaderFilePath,
+		shaderProfileIndex,
+		shaderType,
+		pCompileSourceData,
+		compileSourceSize,
+		pCompileTokens,
+		compileTokenCount,
 		rCompiledCodeBuffer
 #if HELIUM_ENABLE_TRACE
 		, &errorMessages
@@ -707,9 +672,155 @@ bool ShaderVariantResourceHandler::CompileShader(
 #endif  // HELIUM_ENABLE_TRACE
 	}
 
+	// Failed compiles are passed on as well, so that anything waiting on this key is released.
+	if( bCacheable )
+	{
+		rBytecodeCache.Store( cacheKey, rCompiledCodeBuffer );
+	}
+
 	return bCompileResult;
 }
 
+/// Compile a shader variant for a single set of system options, for each shader profile in each supported target
+/// platform.
+///
+/// @param[in] pData  CompileOptionSetTask to process.
+void ShaderVariantResourceHandler::RunCompileOptionSetTask( void* pData )
+{
+	CompileOptionSetTask* pTask = static_cast< CompileOptionSetTask* >( pData );
+	HELIUM_ASSERT( pTask );
+	HELIUM_ASSERT( pTask->pHandler );
+
+	ShaderBytecodeCache& rBytecodeCache = pTask->pHandler->m_bytecodeCache;
+	AssetPreprocessor* pAssetPreprocessor = pTask->pAssetPreprocessor;
+	ShaderVariant* pVariant = pTask->pVariant;
+	RShader::EType shaderType = pTask->shaderType;
+	const void* pShaderSourceData = pTask->pShaderSourceData;
+	size_t shaderSourceSize = pTask->shaderSourceSize;
+	size_t systemOptionSetIndex = pTask->systemOptionSetIndex;
+	size_t systemOptionSetCount = pTask->systemOptionSetCount;
+	const DynamicArray< PlatformPreprocessor::ShaderToken >& rTokens = pTask->tokens;
+
+	Helium::StrongPtr<CompiledShaderData> spCompiledShaderData(new CompiledShaderData());
+	CompiledShaderData &csd_pc_sm4 = *spCompiledShaderData;
+
+	// Compile for PC shader model 4 first so that we can get the constant buffer information.
+	PlatformPreprocessor* pPreprocessor = pAssetPreprocessor->GetPlatformPreprocessor( Cache::PLATFORM_PC );
+	HELIUM_ASSERT( pPreprocessor );
+
+	bool bCompiled = CompileShader(
+		rBytecodeCache,
+		pVariant,
+		pPreprocessor,
+		Cache::PLATFORM_PC,
+		ShaderProfile::PC_SM4,
+		shaderType,
+		pShaderSourceData,
+		shaderSourceSize,
+		rTokens,
+		csd_pc_sm4.compiledCodeBuffer );
+	if( !bCompiled )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"ShaderVariantResourceHandler: Failed to compile shader for PC shader model 4, which is needed for reflection purposes.  Additional shader targets will not be built.\n" );
+	}
+	else
+	{
+		bool bReadConstantBuffers = pPreprocessor->FillShaderReflectionData(
+			ShaderProfile::PC_SM4,
+			csd_pc_sm4.compiledCodeBuffer.GetData(),
+			csd_pc_sm4.compiledCodeBuffer.GetSize(),
+			csd_pc_sm4.constantBuffers,
+			csd_pc_sm4.samplerInputs,
+			csd_pc_sm4.textureInputs );
+		if( !bReadConstantBuffers )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"ShaderVariantResourceHandler: Failed to read reflection information for PC shader model 4.  Additional shader targets will not be built.\n" );
+		}
+		else
+		{
+			Resource::PreprocessedData& rPcPreprocessedData = pVariant->GetPreprocessedData(
+				Cache::PLATFORM_PC );
+			DynamicArray< DynamicArray< uint8_t > >& rPcSubDataBuffers = rPcPreprocessedData.subDataBuffers;
+			DynamicArray< uint8_t >& rPcSm4SubDataBuffer =
+				rPcSubDataBuffers[ ShaderProfile::PC_SM4 * systemOptionSetCount + systemOptionSetIndex ];
+
+			Cache::WriteCacheObjectToBuffer( &csd_pc_sm4, rPcSm4SubDataBuffer);
+			
+			// FOR EACH PLATFORM
+			for( size_t platformIndex = 0;
+				platformIndex < static_cast< size_t >( Cache::PLATFORM_MAX );
+				++platformIndex )
+			{
+				PlatformPreprocessor* pPreprocessor = pAssetPreprocessor->GetPlatformPreprocessor(
+					static_cast< Cache::EPlatform >( platformIndex ) );
+				if( !pPreprocessor )
+				{
+					continue;
+				}
+				
+				// GET PLATFORM'S SUBDATA BUFFER
+				Resource::PreprocessedData& rPreprocessedData = pVariant->GetPreprocessedData(
+					static_cast< Cache::EPlatform >( platformIndex ) );
+				DynamicArray< DynamicArray< uint8_t > >& rSubDataBuffers = rPreprocessedData.subDataBuffers;
+
+				size_t shaderProfileCount = pPreprocessor->GetShaderProfileCount();
+				for( size_t shaderProfileIndex = 0;
+					shaderProfileIndex < shaderProfileCount;
+					++shaderProfileIndex )
+				{
+					CompiledShaderData csd;
+					csd.GetRefCountProxy()->AddStrongRef(); // stack allocated object!!
+
+					// Already cached PC shader model 4...
+					if( shaderProfileIndex == ShaderProfile::PC_SM4 && platformIndex == Cache::PLATFORM_PC )
+					{
+						continue;
+					}
+
+					bCompiled = CompileShader(
+						rBytecodeCache,
+						pVariant,
+						pPreprocessor,
+						platformIndex,
+						shaderProfileIndex,
+						shaderType,
+						pShaderSourceData,
+						shaderSourceSize,
+						rTokens,
+						csd.compiledCodeBuffer );
+					if( !bCompiled )
+					{
+						continue;
+					}
+
+					csd.constantBuffers = csd_pc_sm4.constantBuffers;
+					csd.samplerInputs.Resize( 0 );
+					csd.textureInputs.Resize( 0 );
+					bReadConstantBuffers = pPreprocessor->FillShaderReflectionData(
+						shaderProfileIndex,
+						csd.compiledCodeBuffer.GetData(),
+						csd.compiledCodeBuffer.GetSize(),
+						csd.constantBuffers,
+						csd.samplerInputs,
+						csd.textureInputs );
+					if( !bReadConstantBuffers )
+					{
+						continue;
+					}
+
+					DynamicArray< uint8_t >& rTargetSubDataBuffer =
+						rSubDataBuffers[ shaderProfileIndex * systemOptionSetCount + systemOptionSetIndex ];
+					Cache::WriteCacheObjectToBuffer( &csd, rTargetSubDataBuffer);
+				}
+			}
+		}
+	}
+}
+
 /// Compute a hash value for a shader variant load request.
 ///
 /// @param[in] pRequest  Load request.
@@ -8,6 +8,7 @@
 
 #include "Graphics/Shader.h"
 #include "PcSupport/PlatformPreprocessor.h"
+#include "EditorSupport/ShaderBytecodeCache.h"
 
 namespace Helium
 {
@@ -34,6 +35,11 @@ namespace Helium
             AssetPreprocessor* pAssetPreprocessor, Resource* pResource, const String& rSourceFilePath ) override;
         //@}
 
+        /// @name Compiled Shader Caching
+        //@{
+        bool SetBytecodeCacheDirectory( const FilePath& rDirectory );
+        //@}
+
     private:
         /// Shader variant load request.
         struct LoadRequest
@@ -49,6 +55,30 @@ namespace Helium
             volatile int32_t requestCount;
         };
 
+        /// Compilation of a shader variant for a single set of system options.
+        struct CompileOptionSetTask
+        {
+            /// Resource handler performing the compilation.
+            ShaderVariantResourceHandler* pHandler;
+            /// Asset preprocessor providing the platform preprocessors.
+            AssetPreprocessor* pAssetPreprocessor;
+            /// Shader variant being cached.
+            ShaderVariant* pVariant;
+            /// Shader type.
+            RShader::EType shaderType;
+            /// Loaded shader source.
+            const void* pShaderSourceData;
+            /// Shader source size, in bytes.
+            size_t shaderSourceSize;
+            /// Index of the system option set to compile.
+            size_t systemOptionSetIndex;
+            /// Total number of system option sets for the shader type.
+            size_t systemOptionSetCount;
+
+            /// User and system option tokens with which to compile.
+            DynamicArray< PlatformPreprocessor::ShaderToken > tokens;
+        };
+
         /// Shader variant load request hasher.
         class LoadRequestHash
         {
@@ -77,6 +107,9 @@ namespace Helium
         /// Load request lookup set.
         LoadRequestSetType m_loadRequestSet;
 
+        /// Compiled shader code shared across all variants and runs.
+        ShaderBytecodeCache m_bytecodeCache;
+
         /// @name Shader Variant Load Override Support
         //@{
         size_t BeginLoadVariant( Shader* pShader, RShader::EType shaderType, uint32_t userOptionIndex );
@@ -93,10 +126,11 @@ namespace Helium
         /// @name Private Static Utility Functions
         //@{
         static bool CompileShader(
-            ShaderVariant* pVariant, PlatformPreprocessor* pPreprocessor, size_t platformIndex,
-            size_t shaderProfileIndex, RShader::EType shaderType, const void* pShaderSourceData,
+            ShaderBytecodeCache& rBytecodeCache, ShaderVariant* pVariant, PlatformPreprocessor* pPreprocessor,
+            size_t platformIndex, size_t shaderProfileIndex, RShader::EType shaderType, const void* pShaderSourceData,
             size_t shaderSourceSize, const DynamicArray< PlatformPreprocessor::ShaderToken >& rTokens,
             DynamicArray< uint8_t >& rCompiledCodeBuffer );
+        static void RunCompileOptionSetTask( void* pData );
         //@}
     };
 }
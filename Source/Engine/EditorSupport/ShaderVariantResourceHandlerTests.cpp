@@ -0,0 +1,444 @@
+#include "EditorSupport/ShaderVariantResourceHandler.h"
+
+#include "Platform/Atomic.h"
+#include "Platform/Thread.h"
+#include "Foundation/FilePath.h"
+#include "Reflect/Registry.h"
+#include "Persist/Archive.h"
+#include "Engine/AsyncLoader.h"
+#include "Engine/CacheManager.h"
+#include "Engine/FileLocations.h"
+#include "Engine/StableHash.h"
+#include "EngineJobs/JobManager.h"
+#include "Rendering/ShaderProfiles.h"
+#include "PcSupport/AssetPreprocessor.h"
+#include "PcSupport/PlatformPreprocessor.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if HELIUM_OS_LINUX
+
+#include <dirent.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Shader source shared by the tests.  Only the USED toggle is referenced, so the compiled code does not depend on
+	/// the other system options.
+	const char SHADER_SOURCE[] =
+		"#if USED\n"
+		"float4 main() : SV_Position { return 1; }\n"
+		"#else\n"
+		"float4 main() : SV_Position { return 0; }\n"
+		"#endif\n";
+
+	/// Number of distinct compiler inputs per profile for SHADER_SOURCE (USED set or not).
+	const uint32_t DISTINCT_OPTION_SET_COUNT = 2;
+	/// How long each stub compile takes, in milliseconds, so that compiles of duplicate inputs on different job
+	/// workers overlap.
+	const uint32_t COMPILE_DURATION_MS = 20;
+
+	/// Platform preprocessor standing in for the shader compiler, counting how often it is asked to preprocess and
+	/// compile.  Preprocessing prepends a definition for each token the source mentions, and compiling hashes the code
+	/// it is given.
+	class TestPlatformPreprocessor : public PlatformPreprocessor
+	{
+	public:
+		volatile int32_t m_compileCount;
+		volatile int32_t m_preprocessCount;
+		/// Number of compiles given tokens, that is, source that had not been preprocessed already.
+		volatile int32_t m_unpreprocessedCompileCount;
+
+		TestPlatformPreprocessor()
+			: m_compileCount( 0 )
+			, m_preprocessCount( 0 )
+			, m_unpreprocessedCompileCount( 0 )
+		{
+		}
+
+		virtual EByteOrder GetByteOrder() const
+		{
+			return BYTE_ORDER_LITTLE;
+		}
+
+		virtual size_t GetShaderProfileCount() const
+		{
+			return ShaderProfile::PC_MAX;
+		}
+
+		virtual bool CompileShader(
+			const FilePath& /*rShaderPath*/, size_t profileIndex, RShader::EType type, const void* pShaderCode,
+			size_t shaderCodeSize, const ShaderToken* pTokens, size_t tokenCount, DynamicArray< uint8_t >& rCompiledCode,
+			DynamicArray< String >* /*pErrorMessages*/ )
+		{
+			AtomicIncrementAcquire( m_compileCount );
+
+			DynamicArray< uint8_t > preprocessedCode;
+			if( tokenCount != 0 )
+			{
+				AtomicIncrementAcquire( m_unpreprocessedCompileCount );
+				Preprocess( pShaderCode, shaderCodeSize, pTokens, tokenCount, preprocessedCode );
+				pShaderCode = preprocessedCode.GetData();
+				shaderCodeSize = preprocessedCode.GetSize();
+			}
+
+			Thread::Sleep( COMPILE_DURATION_MS );
+
+			uint64_t key = ComputeKey( profileIndex, type, pShaderCode, shaderCodeSize );
+			rCompiledCode.Resize( 0 );
+			rCompiledCode.AddArray( reinterpret_cast< const uint8_t* >( &key ), sizeof( key ) );
+
+			return true;
+		}
+
+		virtual bool ComputeShaderCacheKey(
+			const FilePath& /*rShaderPath*/, size_t profileIndex, RShader::EType type, const void* pShaderCode,
+			size_t shaderCodeSize, const ShaderToken* pTokens, size_t tokenCount, uint64_t& rKey,
+			DynamicArray< uint8_t >& rPreprocessedCode )
+		{
+			Preprocess( pShaderCode, shaderCodeSize, pTokens, tokenCount, rPreprocessedCode );
+			rKey = ComputeKey( profileIndex, type, rPreprocessedCode.GetData(), rPreprocessedCode.GetSize() );
+
+			return true;
+		}
+
+		virtual bool FillShaderReflectionData(
+			size_t /*profileIndex*/, const void* /*pCompiledCode*/, size_t /*compiledCodeSize*/,
+			DynamicArray< ShaderConstantBufferInfo >& /*rConstantBuffers*/,
+			DynamicArray< ShaderSamplerInfo >& /*rSamplers*/,
+			DynamicArray< ShaderTextureInfo >& /*rTextures*/ )
+		{
+			return true;
+		}
+
+	private:
+		/// Apply the tokens to the source the way a preprocessor would see them: tokens the source never mentions do
+		/// not affect the result.
+		void Preprocess(
+			const void* pShaderCode, size_t shaderCodeSize, const ShaderToken* pTokens, size_t tokenCount,
+			DynamicArray< uint8_t >& rPreprocessedCode )
+		{
+			AtomicIncrementAcquire( m_preprocessCount );
+
+			DynamicArray< char > source;
+			source.AddArray( static_cast< const char* >( pShaderCode ), shaderCodeSize );
+			source.Push( '\0' );
+
+			rPreprocessedCode.Resize( 0 );
+			for( size_t tokenIndex = 0; tokenIndex < tokenCount; ++tokenIndex )
+			{
+				const ShaderToken& rToken = pTokens[ tokenIndex ];
+				if( strstr( source.GetData(), rToken.name.GetData() ) )
+				{
+					char definition[ 128 ];
+					int length = snprintf(
+						definition, sizeof( definition ), "#define %s %s\n", rToken.name.GetData(), rToken.definition.GetData() );
+					rPreprocessedCode.AddArray( reinterpret_cast< const uint8_t* >( definition ), length );
+				}
+			}
+
+			rPreprocessedCode.AddArray( static_cast< const uint8_t* >( pShaderCode ), shaderCodeSize );
+		}
+
+		static uint64_t ComputeKey( size_t profileIndex, RShader::EType type, const void* pCode, size_t codeSize )
+		{
+			uint64_t profileAndType[ 2 ] = { profileIndex, static_cast< uint64_t >( type ) };
+			uint64_t key = StableHash64( profileAndType, sizeof( profileAndType ) );
+
+			return StableHash64( key, pCode, codeSize );
+		}
+	};
+
+	/// Base directory holding the data and shader cache directories used by the tests.
+	char g_BaseDirectory[ 256 ];
+	/// Platform preprocessor registered for the PC platform (owned by the asset preprocessor).
+	TestPlatformPreprocessor* g_pPlatformPreprocessor = NULL;
+
+	int RemoveDirectoryEntry( const char* pPath, const struct stat* /*pStat*/, int /*type*/, struct FTW* /*pFtw*/ )
+	{
+		return remove( pPath );
+	}
+
+	class ShaderVariantResourceHandlerTest : public testing::Test
+	{
+	protected:
+		PackagePtr m_spPackage;
+
+		static void SetUpTestCase()
+		{
+			strcpy( g_BaseDirectory, "/tmp/ShaderVariantResourceHandlerTests.XXXXXX" );
+			ASSERT_TRUE( mkdtemp( g_BaseDirectory ) != NULL );
+
+			char dataDirectory[ 512 ];
+			snprintf( dataDirectory, sizeof( dataDirectory ), "%s/Data", g_BaseDirectory );
+			ASSERT_EQ( 0, mkdir( dataDirectory, 0700 ) );
+
+			FileLocations::SetBaseDirectory( FilePath( std::string( g_BaseDirectory ) + "/" ) );
+
+			// Same order as the editor uses when opening a project.
+			AsyncLoader::Startup();
+			CacheManager::Startup();
+			Reflect::Startup();
+			Persist::Startup();
+			AssetPreprocessor::Startup();
+
+			AssetPreprocessor* pAssetPreprocessor = AssetPreprocessor::GetInstance();
+			ASSERT_TRUE( pAssetPreprocessor != NULL );
+			g_pPlatformPreprocessor = new TestPlatformPreprocessor;
+			pAssetPreprocessor->SetPlatformPreprocessor( Cache::PLATFORM_PC, g_pPlatformPreprocessor );
+
+			// Keep compiled code in the test directory rather than the user directory.
+			ASSERT_TRUE( GetHandler() != NULL );
+			ASSERT_TRUE( ReopenBytecodeCache() );
+		}
+
+		static void TearDownTestCase()
+		{
+			AssetPreprocessor::Shutdown();
+			g_pPlatformPreprocessor = NULL;
+
+			Persist::Shutdown();
+			Reflect::Shutdown();
+			AssetType::Shutdown();
+			Asset::Shutdown();
+			Reflect::ObjectRefCountSupport::Shutdown();
+			CacheManager::Shutdown();
+			AsyncLoader::Shutdown();
+			FileLocations::Shutdown();
+
+			nftw( g_BaseDirectory, RemoveDirectoryEntry, 16, FTW_DEPTH | FTW_PHYS );
+		}
+
+		/// Get the handler template, which is the instance the asset preprocessor caches shader variants with.
+		static ShaderVariantResourceHandler* GetHandler()
+		{
+			return static_cast< ShaderVariantResourceHandler* >(
+				ResourceHandler::FindResourceHandlerForType( ShaderVariant::GetStaticType() ) );
+		}
+
+		void TearDown()
+		{
+			if ( JobManager::GetInstance() )
+			{
+				JobManager::Shutdown();
+			}
+		}
+
+		/// Reinitialize the bytecode cache on the test's cache directory, as a new run of the tools would.
+		static bool ReopenBytecodeCache()
+		{
+			ShaderVariantResourceHandler* pHandler = GetHandler();
+			HELIUM_ASSERT( pHandler );
+
+			char cacheDirectory[ 512 ];
+			GetCacheDirectory( cacheDirectory, sizeof( cacheDirectory ) );
+
+			return pHandler->SetBytecodeCacheDirectory( FilePath( cacheDirectory ) );
+		}
+
+		static void GetCacheDirectory( char* pBuffer, size_t bufferSize )
+		{
+			snprintf( pBuffer, bufferSize, "%s/ShaderCache", g_BaseDirectory );
+		}
+
+		/// Count the files in the cache directory whose names end with the given suffix.
+		static size_t CountCacheFiles( const char* pSuffix )
+		{
+			char cacheDirectory[ 512 ];
+			GetCacheDirectory( cacheDirectory, sizeof( cacheDirectory ) );
+
+			DIR* pDirectory = opendir( cacheDirectory );
+			if( !pDirectory )
+			{
+				ADD_FAILURE() << "Failed to open " << cacheDirectory;
+
+				return 0;
+			}
+
+			size_t suffixLength = strlen( pSuffix );
+			size_t fileCount = 0;
+			while( dirent* pEntry = readdir( pDirectory ) )
+			{
+				size_t nameLength = strlen( pEntry->d_name );
+				if( nameLength >= suffixLength && strcmp( pEntry->d_name + nameLength - suffixLength, pSuffix ) == 0 )
+				{
+					++fileCount;
+				}
+			}
+
+			closedir( pDirectory );
+
+			return fileCount;
+		}
+
+		/// Create the package holding the shaders of a test, along with its directory in the data directory.
+		void CreatePackage( const char* pName )
+		{
+			char packageDirectory[ 512 ];
+			snprintf( packageDirectory, sizeof( packageDirectory ), "%s/Data/%s", g_BaseDirectory, pName );
+			ASSERT_EQ( 0, mkdir( packageDirectory, 0700 ) );
+
+			ASSERT_TRUE( Asset::Create< Package >( m_spPackage, Name( pName ), NULL ) );
+		}
+
+		/// Create a precached shader with vertex shader toggles USED, UNUSED_A, and UNUSED_B, and write its source.
+		void CreateShader( const char* pName, const char* pSource, StrongPtr< Shader >& rspShader )
+		{
+			ASSERT_TRUE( Asset::Create< Shader >( rspShader, Name( pName ), m_spPackage ) );
+
+			Shader::PersistentResourceData* pData = new Shader::PersistentResourceData;
+			const char* const toggleNames[] = { "USED", "UNUSED_A", "UNUSED_B" };
+			for( size_t toggleIndex = 0; toggleIndex < HELIUM_ARRAY_COUNT( toggleNames ); ++toggleIndex )
+			{
+				Shader::Toggle* pToggle = pData->GetSystemOptions().GetToggles().New();
+				pToggle->name = Name( toggleNames[ toggleIndex ] );
+				pToggle->shaderTypeFlags = ( 1 << RShader::TYPE_VERTEX );
+			}
+
+			Reflect::ObjectPtr spData( pData );
+			ASSERT_TRUE( rspShader->LoadPersistentResourceObject( spData ) );
+			rspShader->SetFlags( Asset::FLAG_PRECACHED );
+
+			char path[ 512 ];
+			GetSourceFilePath( rspShader, path, sizeof( path ) );
+
+			FILE* pFile = fopen( path, "wb" );
+			ASSERT_TRUE( pFile != NULL );
+			fputs( pSource, pFile );
+			fclose( pFile );
+		}
+
+		void GetSourceFilePath( Shader* pShader, char* pBuffer, size_t bufferSize )
+		{
+			snprintf( pBuffer, bufferSize, "%s/Data/%s/%s", g_BaseDirectory, *m_spPackage->GetName(), *pShader->GetName() );
+		}
+
+		/// Cache the vertex shader variant of a shader.
+		///
+		/// @return  Number of times the shader compiler was invoked.
+		uint32_t CacheVertexVariant( Shader* pShader, ShaderVariantPtr& rspVariant )
+		{
+			if( !rspVariant && !Asset::Create< ShaderVariant >( rspVariant, Name( "v0" ), pShader ) )
+			{
+				ADD_FAILURE() << "Failed to create the shader variant";
+
+				return 0;
+			}
+
+			char path[ 512 ];
+			GetSourceFilePath( pShader, path, sizeof( path ) );
+
+			int32_t startCount = g_pPlatformPreprocessor->m_compileCount;
+			EXPECT_TRUE( GetHandler()->CacheResource( AssetPreprocessor::GetInstance(), rspVariant, String( path ) ) );
+
+			return static_cast< uint32_t >( g_pPlatformPreprocessor->m_compileCount - startCount );
+		}
+
+		/// Check that every system option set has compiled code for every PC shader profile.
+		void ExpectAllSubDataFilled( ShaderVariant* pVariant, size_t systemOptionSetCount )
+		{
+			const Resource::PreprocessedData& rData = pVariant->GetPreprocessedData( Cache::PLATFORM_PC );
+			ASSERT_EQ( ShaderProfile::PC_MAX * systemOptionSetCount, rData.subDataBuffers.GetSize() );
+			for( size_t bufferIndex = 0; bufferIndex < rData.subDataBuffers.GetSize(); ++bufferIndex )
+			{
+				EXPECT_FALSE( rData.subDataBuffers[ bufferIndex ].IsEmpty() ) << "sub-data buffer " << bufferIndex;
+			}
+		}
+	};
+}
+
+TEST_F( ShaderVariantResourceHandlerTest, CompilesEachDistinctInputOnce )
+{
+	CreatePackage( "CompileCountTest" );
+
+	StrongPtr< Shader > spShader;
+	CreateShader( "Test.hlsl", SHADER_SOURCE, spShader );
+	ASSERT_EQ( 8u, spShader->GetSystemOptions().ComputeOptionSetCount( RShader::TYPE_VERTEX ) );
+
+	// Eight system option sets, but the unused toggles do not change the compiler input.  Each set is preprocessed
+	// once per profile to compute its key, and compiles reuse the preprocessed code rather than the raw source.
+	int32_t startPreprocessCount = g_pPlatformPreprocessor->m_preprocessCount;
+	ShaderVariantPtr spVariant;
+	EXPECT_EQ( DISTINCT_OPTION_SET_COUNT * ShaderProfile::PC_MAX, CacheVertexVariant( spShader, spVariant ) );
+	ExpectAllSubDataFilled( spVariant, 8 );
+	EXPECT_EQ( 8 * ShaderProfile::PC_MAX, g_pPlatformPreprocessor->m_preprocessCount - startPreprocessCount );
+	EXPECT_EQ( 0, g_pPlatformPreprocessor->m_unpreprocessedCompileCount );
+
+	// Recaching the same variant compiles nothing.
+	EXPECT_EQ( 0u, CacheVertexVariant( spShader, spVariant ) );
+	ExpectAllSubDataFilled( spVariant, 8 );
+
+	// Neither does another shader with the same source.
+	StrongPtr< Shader > spCopy;
+	CreateShader( "Copy.hlsl", SHADER_SOURCE, spCopy );
+	ShaderVariantPtr spCopyVariant;
+	EXPECT_EQ( 0u, CacheVertexVariant( spCopy, spCopyVariant ) );
+	ExpectAllSubDataFilled( spCopyVariant, 8 );
+
+	// Nor does a later run of the tools using the same cache directory.
+	ASSERT_TRUE( ReopenBytecodeCache() );
+	spVariant.Release();
+	EXPECT_EQ( 0u, CacheVertexVariant( spShader, spVariant ) );
+	ExpectAllSubDataFilled( spVariant, 8 );
+}
+
+TEST_F( ShaderVariantResourceHandlerTest, EditingSourceRecompiles )
+{
+	CreatePackage( "EditTest" );
+
+	StrongPtr< Shader > spShader;
+	CreateShader( "Test.hlsl", SHADER_SOURCE, spShader );
+
+	ShaderVariantPtr spVariant;
+	CacheVertexVariant( spShader, spVariant );
+
+	StrongPtr< Shader > spEdited;
+	CreateShader( "Edited.hlsl", "#if USED\nfloat4 main() : SV_Position { return 2; }\n#endif\n", spEdited );
+	ShaderVariantPtr spEditedVariant;
+	EXPECT_EQ( DISTINCT_OPTION_SET_COUNT * ShaderProfile::PC_MAX, CacheVertexVariant( spEdited, spEditedVariant ) );
+}
+
+TEST_F( ShaderVariantResourceHandlerTest, DuplicateOptionSetsWaitForFirstCompileOnJobManager )
+{
+	CreatePackage( "JobManagerTest" );
+
+	JobManager::Startup();
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	// Source not compiled by any other test, so every key misses the cache at first.  The eight option sets are
+	// compiled as separate jobs, and four of them share each distinct input for every profile.  Those that find
+	// another job compiling their input wait for it instead of compiling it again.
+	StrongPtr< Shader > spShader;
+	CreateShader( "Parallel.hlsl", "#if USED\nfloat4 main() : SV_Position { return 3; }\n#endif\n", spShader );
+	ShaderVariantPtr spVariant;
+	EXPECT_EQ( DISTINCT_OPTION_SET_COUNT * ShaderProfile::PC_MAX, CacheVertexVariant( spShader, spVariant ) );
+	ExpectAllSubDataFilled( spVariant, 8 );
+
+	// Sets sharing an input end up with the same code.
+	const Resource::PreprocessedData& rData = spVariant->GetPreprocessedData( Cache::PLATFORM_PC );
+	for( size_t profileIndex = 0; profileIndex < ShaderProfile::PC_MAX; ++profileIndex )
+	{
+		for( size_t setIndex = 0; setIndex < 8; ++setIndex )
+		{
+			const DynamicArray< uint8_t >& rFirst = rData.subDataBuffers[ profileIndex * 8 + setIndex % DISTINCT_OPTION_SET_COUNT ];
+			const DynamicArray< uint8_t >& rSet = rData.subDataBuffers[ profileIndex * 8 + setIndex ];
+			ASSERT_EQ( rFirst.GetSize(), rSet.GetSize() );
+			EXPECT_EQ( 0, memcmp( rFirst.GetData(), rSet.GetData(), rSet.GetSize() ) )
+				<< "profile " << profileIndex << ", option set " << setIndex;
+		}
+	}
+
+	// Every entry was renamed into place, and a second run in parallel only reads them back.
+	EXPECT_EQ( 0u, CountCacheFiles( ".tmp" ) );
+	spVariant.Release();
+	EXPECT_EQ( 0u, CacheVertexVariant( spShader, spVariant ) );
+	ExpectAllSubDataFilled( spVariant, 8 );
+}
+
+#endif // HELIUM_OS_LINUX
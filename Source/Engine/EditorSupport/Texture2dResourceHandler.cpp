@@ -325,4 +325,11 @@ bool Texture2dResourceHandler::CacheResource(
     return true;
 }
 
+/// @copydoc ResourceHandler::SupportsConcurrentCaching()
+bool Texture2dResourceHandler::SupportsConcurrentCaching() const
+{
+    // Image loading and compression only use state local to each call.
+    return true;
+}
+
 #endif  // HELIUM_TOOLS
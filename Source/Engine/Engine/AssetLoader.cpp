@@ -3,6 +3,7 @@
 
 #include "Platform/Thread.h"
 #include "Engine/Asset.h"
+#include "Engine/AsyncLoader.h"
 #include "Engine/PackageLoader.h"
 #include "Engine/FileLocations.h"
 
@@ -21,6 +22,11 @@ AssetTracker* AssetTracker::sm_pInstance = NULL;
 /// Constructor.
 AssetLoader::AssetLoader()
 : m_loadRequestPool( LOAD_REQUEST_POOL_BLOCK_SIZE )
+, m_loadCompletionCounter( 0 )
+, m_resourceWakeLoadCounter( 0 )
+, m_resourceWakeAsyncCounter( 0 )
+, m_lastTickVisitCount( 0 )
+, m_bLoadTraceActive( false )
 {
 }
 
@@ -98,17 +104,27 @@ size_t AssetLoader::BeginLoadObject( AssetPath path, bool forceReload )
 	pRequest->stateFlags = pAsset ? 
 		(pAsset->GetFlags() & Asset::FLAG_BROKEN ? LOAD_FLAG_FULLY_LOADED | LOAD_FLAG_ERROR : LOAD_FLAG_FULLY_LOADED ) : 
 		0;
-	pRequest->requestCount = 1;
+	pRequest->requestCount = 2;  // Includes the reference held by the scheduler until the request has fully loaded.
 	HELIUM_ASSERT( !pRequest->spObject );
 	pRequest->spObject = pAsset;
 	pRequest->forceReload = forceReload;
+	pRequest->waitReason = WAIT_REASON_NONE;
+	pRequest->pBlockingRequest = NULL;
+	pRequest->blockingFlags = 0;
+	pRequest->scheduleState = SCHEDULE_STATE_NONE;
+	pRequest->bWakePending = false;
+	HELIUM_ASSERT( pRequest->dependents.IsEmpty() );
 
 	ConcurrentHashMap< AssetPath, LoadRequest* >::Accessor requestAccessor;
 	if( m_loadRequestMap.Insert( requestAccessor, KeyValue< AssetPath, LoadRequest* >( path, pRequest ) ) )
 	{
-		// New load request was created, so tick it once to get the load process running.
+		// New load request was created, so tick it once to get the load process running.  If that is enough to
+		// finish loading, the scheduler has no further use for its reference.
 		requestAccessor.Release();
-		TickLoadRequest( pRequest );
+		if( UpdateLoadRequest( pRequest ) )
+		{
+			AtomicDecrementRelease( pRequest->requestCount );
+		}
 	}
 	else
 	{
@@ -265,40 +281,112 @@ bool AssetLoader::CacheObject( Asset* /*pObject*/, bool /*bEvictPlatformPreproce
 #endif  // HELIUM_TOOLS
 
 /// Update object loading.
+///
+/// Only load requests that are able to make progress are updated.  A request that is waiting on its package loader,
+/// on another load request, or on resource data is parked until that event occurs, at which point it is queued for
+/// update during the next tick.
+///
+/// @see GetLastTickVisitCount()
 void AssetLoader::Tick()
 {
-	// Tick package loaders first.
+	// Tick package loaders first.  These report objects that have finished loading through WakeLoadRequest().
 	TickPackageLoaders();
 
-	// Build the list of object load requests to update this tick, incrementing the request count on each to prevent
-	// them from being released while we don't have a lock on the request hash map.
-	//HELIUM_ASSERT( m_loadRequestTickArray.IsEmpty() );
-	/// List of load requests to update in the current tick.
-	DynamicArray< LoadRequest* > m_loadRequestTickArray;
+	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+	uint32_t asyncCompletionCounter = ( pAsyncLoader ? pAsyncLoader->GetCompletedRequestCounter() : 0 );
+	uint32_t loadCompletionCounter = static_cast< uint32_t >( m_loadCompletionCounter );
+
+	DynamicArray< LoadRequest* > preloadWaitRequests;
 
-	ConcurrentHashMap< AssetPath, LoadRequest* >::ConstAccessor loadRequestConstAccessor;
-	if( m_loadRequestMap.First( loadRequestConstAccessor ) )
 	{
-		do
+		MutexScopeLock scopeLock( m_scheduleLock );
+
+		// Resource precaching typically waits on async reads or on other objects finishing their load, so requests
+		// waiting on it only need to be retried once either has happened.  Precaching can also wait on work the loader
+		// doesn't see (such as shader compilation in tools builds), so they are retried whenever nothing else is ready
+		// as well.
+		if( asyncCompletionCounter != m_resourceWakeAsyncCounter ||
+			loadCompletionCounter != m_resourceWakeLoadCounter ||
+			m_readyRequests.IsEmpty() )
 		{
-			LoadRequest* pRequest = loadRequestConstAccessor->Second();
-			HELIUM_ASSERT( pRequest );
-			AtomicIncrementUnsafe( pRequest->requestCount );
-			m_loadRequestTickArray.Add( pRequest );
+			m_resourceWakeAsyncCounter = asyncCompletionCounter;
+			m_resourceWakeLoadCounter = loadCompletionCounter;
+
+			size_t waitRequestCount = m_resourceWaitRequests.GetSize();
+			for( size_t requestIndex = 0; requestIndex < waitRequestCount; ++requestIndex )
+			{
+				QueueReadyRequest( m_resourceWaitRequests[ requestIndex ] );
+			}
+
+			m_resourceWaitRequests.Resize( 0 );
+		}
+
+		preloadWaitRequests.Swap( m_packagePreloadWaitRequests );
+	}
+
+	// Package loaders don't report when their own preloading has finished, so check on any requests still waiting for
+	// it (moving those that can continue to the front of the list).
+	size_t preloadWaitRequestCount = preloadWaitRequests.GetSize();
+	size_t preloadReadyCount = 0;
+	for( size_t requestIndex = 0; requestIndex < preloadWaitRequestCount; ++requestIndex )
+	{
+		LoadRequest* pRequest = preloadWaitRequests[ requestIndex ];
+		HELIUM_ASSERT( pRequest );
+		HELIUM_ASSERT( pRequest->pPackageLoader );
+
+		if( pRequest->pPackageLoader->TryFinishPreload() )
+		{
+			preloadWaitRequests[ requestIndex ] = preloadWaitRequests[ preloadReadyCount ];
+			preloadWaitRequests[ preloadReadyCount ] = pRequest;
+			++preloadReadyCount;
+		}
+	}
+
+	// Grab the list of requests to update this tick.  Each of these holds a scheduler reference, so they won't be
+	// released while we don't have a lock on the request hash map.
+	DynamicArray< LoadRequest* > tickRequests;
+
+	{
+		MutexScopeLock scopeLock( m_scheduleLock );
+
+		for( size_t requestIndex = 0; requestIndex < preloadWaitRequestCount; ++requestIndex )
+		{
+			LoadRequest* pRequest = preloadWaitRequests[ requestIndex ];
+			if( requestIndex < preloadReadyCount )
+			{
+				QueueReadyRequest( pRequest );
+			}
+			else
+			{
+				m_packagePreloadWaitRequests.Push( pRequest );
+			}
+		}
 
-			++loadRequestConstAccessor;
-		} while( loadRequestConstAccessor.IsValid() );
+		tickRequests.Swap( m_readyRequests );
+
+		size_t tickRequestCount = tickRequests.GetSize();
+		for( size_t requestIndex = 0; requestIndex < tickRequestCount; ++requestIndex )
+		{
+			LoadRequest* pRequest = tickRequests[ requestIndex ];
+			HELIUM_ASSERT( pRequest );
+			HELIUM_ASSERT( pRequest->scheduleState == SCHEDULE_STATE_READY );
+			pRequest->scheduleState = SCHEDULE_STATE_NONE;
+		}
 	}
 
 	// Tick object load requests.
-	size_t loadRequestCount = m_loadRequestTickArray.GetSize();
-	for( size_t requestIndex = 0; requestIndex < loadRequestCount; ++requestIndex )
+	size_t tickRequestCount = tickRequests.GetSize();
+	for( size_t requestIndex = 0; requestIndex < tickRequestCount; ++requestIndex )
 	{
-		LoadRequest* pRequest = m_loadRequestTickArray[ requestIndex ];
+		LoadRequest* pRequest = tickRequests[ requestIndex ];
 		HELIUM_ASSERT( pRequest );
 
-		TickLoadRequest( pRequest );
+		if( !UpdateLoadRequest( pRequest ) )
+		{
+			continue;
+		}
 
+		// Drop the scheduler reference now that the request has fully loaded.
 		int32_t newRequestCount = AtomicDecrementRelease( pRequest->requestCount );
 		if( newRequestCount == 0 )
 		{
@@ -310,6 +398,7 @@ void AssetLoader::Tick()
 				if( pRequest->requestCount == 0 )
 				{
 					HELIUM_ASSERT( ( pRequest->stateFlags & LOAD_FLAG_FULLY_LOADED ) == LOAD_FLAG_FULLY_LOADED );
+					HELIUM_ASSERT( pRequest->dependents.IsEmpty() );
 
 					pRequest->spObject.Release();
 					pRequest->resolver.Clear();
@@ -321,7 +410,122 @@ void AssetLoader::Tick()
 		}
 	}
 
-	//m_loadRequestTickArray.Resize( 0 );
+	AtomicExchangeRelease( m_lastTickVisitCount, static_cast< int32_t >( preloadWaitRequestCount + tickRequestCount ) );
+}
+
+/// Notify the loader that a package loader has finished loading an object.
+///
+/// This queues the load request for the object (if any) for update during the next tick.  Package loaders call this
+/// once an object load request started with PackageLoader::BeginLoadObject() is ready to be finished with
+/// PackageLoader::TryFinishLoadObject().  This may be called from any thread.
+///
+/// @param[in] path  Asset path.
+void AssetLoader::WakeLoadRequest( AssetPath path )
+{
+	ConcurrentHashMap< AssetPath, LoadRequest* >::ConstAccessor requestConstAccessor;
+	if( !m_loadRequestMap.Find( requestConstAccessor, path ) )
+	{
+		return;
+	}
+
+	LoadRequest* pRequest = requestConstAccessor->Second();
+	HELIUM_ASSERT( pRequest );
+
+	MutexScopeLock scopeLock( m_scheduleLock );
+
+	if( pRequest->scheduleState == SCHEDULE_STATE_NONE )
+	{
+		// The request is currently being ticked, so make sure it is queued again instead of being parked.
+		pRequest->bWakePending = true;
+	}
+	else if( pRequest->scheduleState == SCHEDULE_STATE_WAITING &&
+		pRequest->waitReason == WAIT_REASON_PACKAGE_OBJECT )
+	{
+		QueueReadyRequest( pRequest );
+	}
+}
+
+/// Get the number of load requests visited during the most recent call to Tick().
+///
+/// This includes requests updated because they were able to make progress as well as requests checked for whether
+/// their package loader has finished preloading.
+///
+/// @return  Number of load requests visited during the last tick.
+size_t AssetLoader::GetLastTickVisitCount() const
+{
+	return static_cast< size_t >( m_lastTickVisitCount );
+}
+
+/// Start recording the order and timing of cache entry requests.
+///
+/// Any previously recorded requests are discarded.
+///
+/// @see EndLoadTrace(), RecordLoadTraceRequest()
+void AssetLoader::BeginLoadTrace()
+{
+	m_loadTrace.Start();
+	m_bLoadTraceActive = true;
+
+	HELIUM_TRACE( TraceLevels::Info, "AssetLoader: Load tracing started.\n" );
+}
+
+/// Stop recording cache entry requests.
+///
+/// The recorded requests remain available through GetLoadTrace() until the next call to BeginLoadTrace().
+///
+/// @param[in] pFileName  Name of the file to which to save the recorded trace, or null to skip saving it.
+///
+/// @return  True if the trace was saved successfully (or no file name was given), false if saving failed.
+///
+/// @see BeginLoadTrace()
+bool AssetLoader::EndLoadTrace( const char* pFileName )
+{
+	m_bLoadTraceActive = false;
+
+	HELIUM_TRACE(
+		TraceLevels::Info,
+		"AssetLoader: Load tracing stopped (%" PRIuSZ " requests recorded).\n",
+		m_loadTrace.GetRecordCount() );
+
+	return ( !pFileName || m_loadTrace.Save( pFileName ) );
+}
+
+/// Get whether cache entry requests are currently being recorded.
+///
+/// @return  True if load tracing is active, false if not.
+///
+/// @see BeginLoadTrace(), EndLoadTrace()
+bool AssetLoader::IsLoadTraceActive() const
+{
+	return m_bLoadTraceActive;
+}
+
+/// Get the most recently recorded load trace.
+///
+/// This should not be accessed while load tracing is active.
+///
+/// @return  Recorded load trace.
+///
+/// @see BeginLoadTrace(), EndLoadTrace()
+const LoadTrace& AssetLoader::GetLoadTrace() const
+{
+	return m_loadTrace;
+}
+
+/// Record the request of a cache entry if load tracing is active.
+///
+/// This is called by package loaders and resources whenever they look up data in a cache, and may be called from any
+/// thread.
+///
+/// @param[in] cacheName     Name of the cache from which the entry is being requested.
+/// @param[in] path          Entry path.
+/// @param[in] subDataIndex  Entry sub-data index.
+void AssetLoader::RecordLoadTraceRequest( Name cacheName, AssetPath path, uint32_t subDataIndex )
+{
+	if( m_bLoadTraceActive )
+	{
+		m_loadTrace.Add( cacheName, path, subDataIndex );
+	}
 }
 
 /// Get the global object loader instance.
@@ -379,8 +583,157 @@ void AssetLoader::OnLoadComplete( const AssetPath & /*path*/, Asset* /*pObject*/
 {
 }
 
+/// Tick a load request and schedule it according to its progress.
+///
+/// If the request is still unable to finish loading, it is parked until the event on which it is waiting occurs.  Any
+/// requests waiting on this request are queued for update if it has progressed.  The caller must have exclusive
+/// access to the request for scheduling purposes (i.e. it must not be queued or parked).
+///
+/// @param[in] pRequest  Load request to update.
+///
+/// @return  True if the load request has fully loaded, false if it is still in progress.
+bool AssetLoader::UpdateLoadRequest( LoadRequest* pRequest )
+{
+	HELIUM_ASSERT( pRequest );
+
+	int32_t previousStateFlags = pRequest->stateFlags & LOAD_FLAG_FULLY_LOADED;
+
+	pRequest->waitReason = WAIT_REASON_NONE;
+	pRequest->pBlockingRequest = NULL;
+	pRequest->blockingFlags = 0;
+
+	bool bFinished = TickLoadRequest( pRequest );
+
+	int32_t stateFlags = pRequest->stateFlags & LOAD_FLAG_FULLY_LOADED;
+
+	MutexScopeLock scopeLock( m_scheduleLock );
+
+	HELIUM_ASSERT( pRequest->scheduleState == SCHEDULE_STATE_NONE );
+
+	// Requests waiting on this one may be able to continue now that it has progressed.  Note that the load flags are
+	// always updated before the schedule lock is acquired, so a request cannot start waiting on a stage that has
+	// already been completed.
+	if( stateFlags != previousStateFlags )
+	{
+		size_t dependentCount = pRequest->dependents.GetSize();
+		for( size_t dependentIndex = 0; dependentIndex < dependentCount; ++dependentIndex )
+		{
+			QueueReadyRequest( pRequest->dependents[ dependentIndex ] );
+		}
+
+		pRequest->dependents.Resize( 0 );
+	}
+
+	if( bFinished )
+	{
+		HELIUM_ASSERT( stateFlags == LOAD_FLAG_FULLY_LOADED );
+		pRequest->bWakePending = false;
+		AtomicIncrementRelease( m_loadCompletionCounter );
+
+		return true;
+	}
+
+	if( pRequest->bWakePending )
+	{
+		QueueReadyRequest( pRequest );
+
+		return false;
+	}
+
+	switch( pRequest->waitReason )
+	{
+		case WAIT_REASON_PACKAGE_PRELOAD:
+		{
+			pRequest->scheduleState = SCHEDULE_STATE_WAITING;
+			m_packagePreloadWaitRequests.Push( pRequest );
+
+			break;
+		}
+
+		case WAIT_REASON_PACKAGE_OBJECT:
+		{
+			// Woken by WakeLoadRequest() once the package loader has finished with the object.
+			pRequest->scheduleState = SCHEDULE_STATE_WAITING;
+
+			break;
+		}
+
+		case WAIT_REASON_DEPENDENCY:
+		{
+			LoadRequest* pBlockingRequest = pRequest->pBlockingRequest;
+			HELIUM_ASSERT( pBlockingRequest );
+
+			int32_t blockingFlags = pRequest->blockingFlags;
+			if( ( pBlockingRequest->stateFlags & blockingFlags ) == blockingFlags )
+			{
+				// The blocking request progressed after this request was ticked.
+				QueueReadyRequest( pRequest );
+			}
+			else
+			{
+				pRequest->scheduleState = SCHEDULE_STATE_WAITING;
+				pBlockingRequest->dependents.Push( pRequest );
+			}
+
+			break;
+		}
+
+		case WAIT_REASON_RESOURCE:
+		{
+			pRequest->scheduleState = SCHEDULE_STATE_WAITING;
+			m_resourceWaitRequests.Push( pRequest );
+
+			break;
+		}
+
+		default:
+		{
+			// Not waiting on a specific event (i.e. the request was being ticked elsewhere), so simply retry it.
+			QueueReadyRequest( pRequest );
+
+			break;
+		}
+	}
+
+	return false;
+}
+
+/// Queue a load request for update during the next tick.
+///
+/// The schedule lock must be held when calling this function.
+///
+/// @param[in] pRequest  Load request to queue.
+void AssetLoader::QueueReadyRequest( LoadRequest* pRequest )
+{
+	HELIUM_ASSERT( pRequest );
+	HELIUM_ASSERT( pRequest->scheduleState != SCHEDULE_STATE_READY );
+
+	pRequest->scheduleState = SCHEDULE_STATE_READY;
+	pRequest->bWakePending = false;
+	m_readyRequests.Push( pRequest );
+}
+
+/// Record that a load request is waiting for another load request to progress.
+///
+/// @param[in] pRequest               Load request that is waiting.
+/// @param[in] blockingLoadRequestId  ID of the load request being waited on.
+/// @param[in] blockingFlags          Load flags that must be set on the blocking request before the waiting request
+///                                   can make further progress.
+void AssetLoader::WaitOnLoadRequest( LoadRequest* pRequest, size_t blockingLoadRequestId, int32_t blockingFlags )
+{
+	HELIUM_ASSERT( pRequest );
+	HELIUM_ASSERT( IsValid( blockingLoadRequestId ) );
+
+	pRequest->waitReason = WAIT_REASON_DEPENDENCY;
+	pRequest->pBlockingRequest = m_loadRequestPool.GetObject( blockingLoadRequestId );
+	pRequest->blockingFlags = blockingFlags;
+	HELIUM_ASSERT( pRequest->pBlockingRequest );
+}
+
 /// Update the given load request.
 ///
+/// If the request is unable to make further progress, the event on which it is waiting is stored in the request.
+///
 /// @param[in] pRequest  Load request to update.
 ///
 /// @return  True if the load request has completed, false if it still requires time to process.
@@ -497,6 +850,8 @@ bool AssetLoader::TickPreload( LoadRequest* pRequest )
 		if( !pPackageLoader->TryFinishPreload() )
 		{
 			// Still waiting for package loader preload.
+			pRequest->waitReason = WAIT_REASON_PACKAGE_PRELOAD;
+
 			return false;
 		}
 
@@ -542,6 +897,8 @@ bool AssetLoader::TickPreload( LoadRequest* pRequest )
 	if( !bFinished )
 	{
 		// Still waiting for object to load.
+		pRequest->waitReason = WAIT_REASON_PACKAGE_OBJECT;
+
 		return false;
 	}
 
@@ -565,8 +922,11 @@ bool AssetLoader::TickLink( LoadRequest* pRequest )
 
 	if ( pRequest->spObject.ReferencesObject() )
 	{
-		if( !pRequest->resolver.ReadyToApplyFixups() )
+		size_t blockingLoadRequestId;
+		if( !pRequest->resolver.ReadyToApplyFixups( &blockingLoadRequestId ) )
 		{
+			WaitOnLoadRequest( pRequest, blockingLoadRequestId, LOAD_FLAG_PRELOADED );
+
 			return false;
 		}
 		
@@ -595,8 +955,11 @@ bool AssetLoader::TickPrecache( LoadRequest* pRequest )
 	if( pAsset )
 	{
 		// TODO: SHouldn't this be in the linking phase?
-		if ( !pRequest->resolver.TryFinishPrecachingDependencies() )
+		size_t blockingLoadRequestId;
+		if ( !pRequest->resolver.TryFinishPrecachingDependencies( &blockingLoadRequestId ) )
 		{
+			WaitOnLoadRequest( pRequest, blockingLoadRequestId, LOAD_FLAG_FULLY_LOADED );
+
 			return false;
 		}
 
@@ -630,6 +993,8 @@ bool AssetLoader::TickPrecache( LoadRequest* pRequest )
 
 			if( !pAsset->TryFinishPrecacheResourceData() )
 			{
+				pRequest->waitReason = WAIT_REASON_RESOURCE;
+
 				return false;
 			}
 		}
@@ -684,12 +1049,37 @@ int64_t AssetLoader::GetAssetFileTimestamp( const AssetPath &path )
 
 #endif
 
+Helium::AssetIdentifier::AssetIdentifier( DynamicArray< AssetPath >* pDependencies )
+	: m_pDependencies( pDependencies )
+{
+	if ( m_pDependencies )
+	{
+		HashMap< AssetPath, bool >::Iterator recordedIterator;
+		for ( size_t dependencyIndex = 0; dependencyIndex < m_pDependencies->GetSize(); ++dependencyIndex )
+		{
+			m_recordedDependencies.Insert(
+				recordedIterator, HashMap< AssetPath, bool >::ValueType( ( *m_pDependencies )[ dependencyIndex ], true ) );
+		}
+	}
+}
+
 bool Helium::AssetIdentifier::Identify( const Reflect::ObjectPtr& object, Name* identity )
 {
 	Asset *pAsset = Reflect::SafeCast<Asset>(object);
 
 	if ( pAsset )
 	{
+		if ( m_pDependencies )
+		{
+			AssetPath path = pAsset->GetPath();
+
+			HashMap< AssetPath, bool >::Iterator recordedIterator;
+			if ( m_recordedDependencies.Insert( recordedIterator, HashMap< AssetPath, bool >::ValueType( path, true ) ) )
+			{
+				m_pDependencies->Push( path );
+			}
+		}
+
 		if ( identity )
 		{
 			identity->Set(pAsset->GetPath().ToString());
@@ -744,7 +1134,7 @@ bool Helium::AssetResolver::Resolve( const Name& identity, Reflect::ObjectPtr& p
 	return false;
 }
 
-bool Helium::AssetResolver::ReadyToApplyFixups()
+bool Helium::AssetResolver::ReadyToApplyFixups( size_t* pBlockingLoadRequestId )
 {
 	for ( DynamicArray< Fixup >::Iterator iter = m_Fixups.Begin();
 		iter != m_Fixups.End(); ++iter)
@@ -754,6 +1144,11 @@ bool Helium::AssetResolver::ReadyToApplyFixups()
 
 		if ( !( pRequest->stateFlags & AssetLoader::LOAD_FLAG_PRELOADED ) )
 		{
+			if ( pBlockingLoadRequestId )
+			{
+				*pBlockingLoadRequestId = iter->m_LoadRequestId;
+			}
+
 			return false;
 		}
 	}
@@ -784,7 +1179,7 @@ void Helium::AssetResolver::Clear()
 	m_Fixups.Clear();
 }
 
-bool Helium::AssetResolver::TryFinishPrecachingDependencies()
+bool Helium::AssetResolver::TryFinishPrecachingDependencies( size_t* pBlockingLoadRequestId )
 {
 	for ( DynamicArray< Fixup >::Iterator iter = m_Fixups.Begin();
 		iter != m_Fixups.End(); ++iter)
@@ -794,6 +1189,11 @@ bool Helium::AssetResolver::TryFinishPrecachingDependencies()
 			AssetPtr asset;
 			if( !AssetLoader::GetInstance()->TryFinishLoad( iter->m_LoadRequestId, asset ) )
 			{
+				if ( pBlockingLoadRequestId )
+				{
+					*pBlockingLoadRequestId = iter->m_LoadRequestId;
+				}
+
 				return false;
 			}
 		
@@ -2,11 +2,14 @@
 
 #include "Engine/Engine.h"
 
+#include "Platform/Locks.h"
 #include "Reflect/Translator.h"
 #include "Foundation/ConcurrentHashMap.h"
+#include "Foundation/HashMap.h"
 #include "Foundation/ObjectPool.h"
 #include "Engine/AssetPath.h"
 #include "Engine/Asset.h"
+#include "Engine/LoadTrace.h"
 
 #define HELIUM_ASSET_CACHE_NAME "Asset"
 #define HELIUM_CONFIG_CACHE_NAME "Config"
@@ -18,7 +21,15 @@ namespace Helium
 	class HELIUM_ENGINE_API AssetIdentifier : public Reflect::ObjectIdentifier
 	{
 	public:
+		AssetIdentifier( DynamicArray< AssetPath >* pDependencies = NULL );
+
 		virtual bool Identify( const Reflect::ObjectPtr& object, Name* identity ) override;
+
+	private:
+		/// Optional list in which to record the path of each asset referenced by the serialized object.
+		DynamicArray< AssetPath >* m_pDependencies;
+		/// Paths already in the dependency list, so that each is only recorded once.
+		HashMap< AssetPath, bool > m_recordedDependencies;
 	};
 
 	class HELIUM_ENGINE_API AssetResolver : public Reflect::ObjectResolver
@@ -28,9 +39,9 @@ namespace Helium
 		virtual bool Resolve( const Name& identity, Reflect::ObjectPtr& pointer, const Reflect::MetaClass* pointerClass );
 
 		// Called by AssetLoader
-		bool ReadyToApplyFixups();
+		bool ReadyToApplyFixups( size_t* pBlockingLoadRequestId = NULL );
 		void ApplyFixups();
-		bool TryFinishPrecachingDependencies();
+		bool TryFinishPrecachingDependencies( size_t* pBlockingLoadRequestId = NULL );
 		void Clear();
 
 		// Internal fixups that must be completed
@@ -98,6 +109,23 @@ namespace Helium
 		virtual void Tick();
 		//@}
 
+		/// @name Load Scheduling
+		//@{
+		void WakeLoadRequest( AssetPath path );
+
+		size_t GetLastTickVisitCount() const;
+		//@}
+
+		/// @name Load Tracing
+		//@{
+		void BeginLoadTrace();
+		bool EndLoadTrace( const char* pFileName = NULL );
+		bool IsLoadTraceActive() const;
+		const LoadTrace& GetLoadTrace() const;
+
+		void RecordLoadTraceRequest( Name cacheName, AssetPath path, uint32_t subDataIndex );
+		//@}
+
 		/// @name Static Access
 		//@{
 		static AssetLoader* GetInstance();
@@ -135,6 +163,32 @@ namespace Helium
 			LOAD_FLAG_IN_TICK = 1 << 6,
 		};
 
+		/// Events on which a load request can be waiting when it is unable to make further progress.
+		enum EWaitReason
+		{
+			/// Not waiting on anything (the request can make progress if ticked again).
+			WAIT_REASON_NONE,
+			/// Waiting for the package loader to finish preloading.
+			WAIT_REASON_PACKAGE_PRELOAD,
+			/// Waiting for the package loader to finish loading the object.
+			WAIT_REASON_PACKAGE_OBJECT,
+			/// Waiting for another load request to progress.
+			WAIT_REASON_DEPENDENCY,
+			/// Waiting for resource data precaching to finish.
+			WAIT_REASON_RESOURCE,
+		};
+
+		/// Load request scheduling states.
+		enum EScheduleState
+		{
+			/// Not scheduled (being created, being ticked, or fully loaded).
+			SCHEDULE_STATE_NONE,
+			/// Queued for update during the next tick.
+			SCHEDULE_STATE_READY,
+			/// Parked until the event on which the request is waiting occurs.
+			SCHEDULE_STATE_WAITING,
+		};
+
 		/// Asset load request information.
 		struct LoadRequest
 		{
@@ -157,6 +211,20 @@ namespace Helium
 			AssetResolver resolver;
 
 			bool forceReload;
+
+			/// Event on which the most recent tick of this request was waiting.
+			EWaitReason waitReason;
+			/// Load request on which this request is waiting (if waiting on a dependency).
+			LoadRequest* pBlockingRequest;
+			/// Load flags that must be set on the blocking request before this request can make further progress.
+			int32_t blockingFlags;
+
+			/// Scheduling state (protected by m_scheduleLock).
+			EScheduleState scheduleState;
+			/// True if the request was woken while not waiting (protected by m_scheduleLock).
+			bool bWakePending;
+			/// Load requests waiting for this request to progress (protected by m_scheduleLock).
+			DynamicArray< LoadRequest* > dependents;
 		};
 
 		/// Load request hash map.
@@ -164,6 +232,28 @@ namespace Helium
 		/// Load request pool.
 		ObjectPool< LoadRequest > m_loadRequestPool;
 
+		/// Mutex protecting load request scheduling.
+		Mutex m_scheduleLock;
+		/// Load requests that can make progress, to be updated during the next tick.
+		DynamicArray< LoadRequest* > m_readyRequests;
+		/// Load requests waiting for their package loader to finish preloading.
+		DynamicArray< LoadRequest* > m_packagePreloadWaitRequests;
+		/// Load requests waiting for resource data precaching.
+		DynamicArray< LoadRequest* > m_resourceWaitRequests;
+		/// Counter incremented each time a load request is fully loaded.
+		volatile int32_t m_loadCompletionCounter;
+		/// Load completion counter value when requests waiting on resource data were last woken.
+		uint32_t m_resourceWakeLoadCounter;
+		/// Async loader completion counter value when requests waiting on resource data were last woken.
+		uint32_t m_resourceWakeAsyncCounter;
+		/// Number of load requests visited during the most recent tick.
+		volatile int32_t m_lastTickVisitCount;
+
+		/// Cache entry requests recorded since BeginLoadTrace() was called.
+		LoadTrace m_loadTrace;
+		/// True while cache entry requests are being recorded.
+		volatile bool m_bLoadTraceActive;
+
 		/// Singleton instance.
 		static AssetLoader* sm_pInstance;
 
@@ -178,6 +268,13 @@ namespace Helium
 
 	private:
 
+		/// @name Load Request Scheduling
+		//@{
+		bool UpdateLoadRequest( LoadRequest* pRequest );
+		void QueueReadyRequest( LoadRequest* pRequest );
+		void WaitOnLoadRequest( LoadRequest* pRequest, size_t blockingLoadRequestId, int32_t blockingFlags );
+		//@}
+
 		/// @name Load Process Updating
 		//@{
 		bool TickLoadRequest( LoadRequest* pRequest );
@@ -0,0 +1,527 @@
+#include "Engine/AssetLoader.h"
+
+#include "Foundation/DynamicArray.h"
+#include "Reflect/Registry.h"
+#include "Engine/PackageLoader.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+namespace AssetLoaderTests
+{
+	/// Asset that may reference another asset, as resolved by the stub package loader.
+	class ChainAsset : public Helium::Asset
+	{
+		HELIUM_DECLARE_ASSET( ChainAsset, Asset );
+
+	public:
+		Helium::Reflect::ObjectPtr m_Reference;
+	};
+	typedef Helium::StrongPtr< ChainAsset > ChainAssetPtr;
+}
+
+using namespace Helium;
+using namespace AssetLoaderTests;
+
+HELIUM_IMPLEMENT_ASSET( AssetLoaderTests::ChainAsset, EngineTests, 0 );
+
+namespace
+{
+	/// Number of objects in the dependency chain tests.
+	const uint32_t CHAIN_LENGTH = 32;
+	/// Number of ticks a request and the one it depends on may take to settle after the package loader finishes an
+	/// object (preload, then link once the dependency is preloaded, then precache once it has fully loaded).
+	const size_t SETTLE_TICK_COUNT = 4;
+
+	/// Package loader that creates objects in memory once the test marks them ready, resolving each object's
+	/// dependency (if any) as deserialization would.
+	class StubPackageLoader : public PackageLoader
+	{
+	public:
+		StubPackageLoader()
+			: m_bPreloaded( true )
+		{
+		}
+
+		/// Add an object that can be loaded, optionally with a dependency on another object.
+		void AddObject( AssetPath path, AssetPath dependencyPath = AssetPath() )
+		{
+			StubObject* pObject = m_objects.New();
+			HELIUM_ASSERT( pObject );
+			pObject->path = path;
+			pObject->dependencyPath = dependencyPath;
+			pObject->bReady = false;
+		}
+
+		/// Let the object be finished on the next tick.
+		void SetReady( AssetPath path )
+		{
+			size_t objectIndex = FindObject( path );
+			HELIUM_ASSERT( IsValid( objectIndex ) );
+			m_objects[ objectIndex ].bReady = true;
+		}
+
+		void SetPreloaded( bool bPreloaded )
+		{
+			m_bPreloaded = bPreloaded;
+		}
+
+		virtual bool TryFinishPreload()
+		{
+			return m_bPreloaded;
+		}
+
+		virtual size_t BeginLoadObject( AssetPath path, Reflect::ObjectResolver *pResolver, bool /*forceReload*/ )
+		{
+			size_t objectIndex = FindObject( path );
+			if ( IsInvalid( objectIndex ) )
+			{
+				return Invalid< size_t >();
+			}
+
+			StubRequest* pRequest = m_requests.New();
+			HELIUM_ASSERT( pRequest );
+			pRequest->objectIndex = objectIndex;
+			pRequest->pResolver = pResolver;
+			pRequest->bFinished = false;
+
+			return m_requests.GetSize() - 1;
+		}
+
+		virtual bool TryFinishLoadObject( size_t requestId, AssetPtr& rspObject )
+		{
+			HELIUM_ASSERT( requestId < m_requests.GetSize() );
+
+			StubRequest& rRequest = m_requests[ requestId ];
+			if ( !rRequest.bFinished )
+			{
+				return false;
+			}
+
+			rspObject = rRequest.spObject;
+			rRequest.spObject.Release();
+			if ( rspObject )
+			{
+				rspObject->SetFlags( Asset::FLAG_PRELOADED );
+			}
+
+			return true;
+		}
+
+		virtual void Tick()
+		{
+			// Creating an object can begin loading its dependency, which adds a request, so nothing is held across
+			// the calls below.
+			for ( size_t requestIndex = 0; requestIndex < m_requests.GetSize(); ++requestIndex )
+			{
+				if ( m_requests[ requestIndex ].bFinished )
+				{
+					continue;
+				}
+
+				StubObject object = m_objects[ m_requests[ requestIndex ].objectIndex ];
+				if ( !object.bReady )
+				{
+					continue;
+				}
+
+				ChainAssetPtr spObject;
+				HELIUM_VERIFY( Asset::Create< ChainAsset >( spObject, object.path.GetName(), Asset::FindObject( object.path.GetParent() ) ) );
+
+				if ( !object.dependencyPath.IsEmpty() )
+				{
+					String dependencyPathString;
+					object.dependencyPath.ToString( dependencyPathString );
+					HELIUM_VERIFY( m_requests[ requestIndex ].pResolver->Resolve(
+						Name( *dependencyPathString ),
+						spObject->m_Reference,
+						Reflect::GetMetaClass< ChainAsset >() ) );
+				}
+
+				m_requests[ requestIndex ].spObject = spObject.Get();
+				m_requests[ requestIndex ].bFinished = true;
+
+				AssetLoader::GetInstance()->WakeLoadRequest( object.path );
+			}
+		}
+
+		virtual size_t GetObjectCount() const
+		{
+			return m_objects.GetSize();
+		}
+
+		virtual AssetPath GetAssetPath( size_t index ) const
+		{
+			return m_objects[ index ].path;
+		}
+
+	private:
+		struct StubObject
+		{
+			AssetPath path;
+			AssetPath dependencyPath;
+			bool bReady;
+		};
+
+		struct StubRequest
+		{
+			size_t objectIndex;
+			Reflect::ObjectResolver* pResolver;
+			AssetPtr spObject;
+			bool bFinished;
+		};
+
+		DynamicArray< StubObject > m_objects;
+		DynamicArray< StubRequest > m_requests;
+		bool m_bPreloaded;
+
+		size_t FindObject( AssetPath path ) const
+		{
+			for ( size_t objectIndex = 0; objectIndex < m_objects.GetSize(); ++objectIndex )
+			{
+				if ( m_objects[ objectIndex ].path == path )
+				{
+					return objectIndex;
+				}
+			}
+
+			return Invalid< size_t >();
+		}
+	};
+
+	/// Asset loader that loads everything through the stub package loader and exposes its scheduling state.
+	class TestAssetLoader : public AssetLoader
+	{
+	public:
+		static void Startup( StubPackageLoader* pPackageLoader )
+		{
+			AssetLoader::Startup();
+
+			HELIUM_ASSERT( !sm_pInstance );
+			sm_pInstance = new TestAssetLoader( pPackageLoader );
+			HELIUM_ASSERT( sm_pInstance );
+		}
+
+		static void Shutdown()
+		{
+			HELIUM_ASSERT( sm_pInstance );
+			delete sm_pInstance;
+			sm_pInstance = NULL;
+
+			AssetLoader::Shutdown();
+		}
+
+		static TestAssetLoader* GetTestInstance()
+		{
+			return static_cast< TestAssetLoader* >( GetInstance() );
+		}
+
+		/// Get whether a load request for the given path still exists.
+		bool HasLoadRequest( AssetPath path )
+		{
+			ConcurrentHashMap< AssetPath, LoadRequest* >::ConstAccessor requestConstAccessor;
+
+			return m_loadRequestMap.Find( requestConstAccessor, path );
+		}
+
+		/// Get whether no load request is queued for update or parked on the package loader or resource data.
+		bool IsScheduleEmpty()
+		{
+			MutexScopeLock scopeLock( m_scheduleLock );
+
+			return m_readyRequests.IsEmpty() && m_packagePreloadWaitRequests.IsEmpty() && m_resourceWaitRequests.IsEmpty();
+		}
+
+	protected:
+		TestAssetLoader( StubPackageLoader* pPackageLoader )
+			: m_pPackageLoader( pPackageLoader )
+		{
+		}
+
+		virtual PackageLoader* GetPackageLoader( AssetPath /*path*/ )
+		{
+			return m_pPackageLoader;
+		}
+
+		virtual void TickPackageLoaders()
+		{
+			m_pPackageLoader->Tick();
+		}
+
+	private:
+		StubPackageLoader* m_pPackageLoader;
+	};
+
+	class AssetLoaderTest : public testing::Test
+	{
+	protected:
+		PackagePtr m_spPackage;
+		StubPackageLoader m_packageLoader;
+
+		static void SetUpTestCase()
+		{
+			Reflect::Startup();
+		}
+
+		static void TearDownTestCase()
+		{
+			Reflect::Shutdown();
+			AssetType::Shutdown();
+			Asset::Shutdown();
+			Reflect::ObjectRefCountSupport::Shutdown();
+		}
+
+		void SetUp()
+		{
+			TestAssetLoader::Startup( &m_packageLoader );
+		}
+
+		void TearDown()
+		{
+			TestAssetLoader::Shutdown();
+			m_spPackage.Release();
+		}
+
+		/// Create the package holding the objects of a test.  Each test uses its own package, as loaded objects stay
+		/// in memory for the rest of the run.
+		void CreatePackage( const char* pName )
+		{
+			ASSERT_TRUE( Asset::Create< Package >( m_spPackage, Name( pName ), NULL ) );
+		}
+
+		AssetPath GetObjectPath( uint32_t objectIndex )
+		{
+			char pathString[ 128 ];
+			snprintf( pathString, sizeof( pathString ), "/%s:Object%u", *m_spPackage->GetName(), objectIndex );
+
+			AssetPath path;
+			HELIUM_VERIFY( path.Set( pathString ) );
+
+			return path;
+		}
+
+		/// Add a chain of objects to the stub loader, each depending on the next.
+		void AddChain( uint32_t objectCount )
+		{
+			for ( uint32_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+			{
+				m_packageLoader.AddObject(
+					GetObjectPath( objectIndex ),
+					objectIndex + 1 < objectCount ? GetObjectPath( objectIndex + 1 ) : AssetPath() );
+			}
+		}
+
+		/// Check that a chain has fully loaded with every reference linked, and that none of its load requests are
+		/// left behind.
+		void CheckChain( uint32_t objectCount )
+		{
+			TestAssetLoader* pLoader = TestAssetLoader::GetTestInstance();
+			for ( uint32_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+			{
+				AssetPath path = GetObjectPath( objectIndex );
+				EXPECT_FALSE( pLoader->HasLoadRequest( path ) ) << "Request for object " << objectIndex << " was stranded";
+
+				ChainAsset* pObject = Reflect::SafeCast< ChainAsset >( Asset::FindObject( path ) );
+				ASSERT_TRUE( pObject != NULL ) << "Object " << objectIndex << " was not created";
+				EXPECT_TRUE( pObject->IsFullyLoaded() );
+
+				Asset* pReference = Reflect::SafeCast< Asset >( pObject->m_Reference.Get() );
+				if ( objectIndex + 1 < objectCount )
+				{
+					ASSERT_TRUE( pReference != NULL ) << "Object " << objectIndex << " was not linked";
+					EXPECT_TRUE( pReference->GetPath() == GetObjectPath( objectIndex + 1 ) );
+				}
+				else
+				{
+					EXPECT_TRUE( pReference == NULL );
+				}
+			}
+
+			EXPECT_TRUE( pLoader->IsScheduleEmpty() );
+		}
+	};
+}
+
+TEST_F( AssetLoaderTest, LoadsDependencyChain )
+{
+	CreatePackage( "Chain" );
+	AddChain( CHAIN_LENGTH );
+	for ( uint32_t objectIndex = 0; objectIndex < CHAIN_LENGTH; ++objectIndex )
+	{
+		m_packageLoader.SetReady( GetObjectPath( objectIndex ) );
+	}
+
+	AssetLoader* pLoader = AssetLoader::GetInstance();
+	size_t loadId = pLoader->BeginLoadObject( GetObjectPath( 0 ) );
+	ASSERT_TRUE( IsValid( loadId ) );
+
+	AssetPtr spObject;
+	pLoader->FinishLoad( loadId, spObject );
+	ASSERT_TRUE( spObject.Get() != NULL );
+	EXPECT_TRUE( spObject->GetPath() == GetObjectPath( 0 ) );
+
+	CheckChain( CHAIN_LENGTH );
+
+	pLoader->Tick();
+	EXPECT_EQ( 0u, pLoader->GetLastTickVisitCount() );
+}
+
+TEST_F( AssetLoaderTest, ChainLoadsAsObjectsBecomeReady )
+{
+	CreatePackage( "ReverseChain" );
+	AddChain( CHAIN_LENGTH );
+
+	AssetLoader* pLoader = AssetLoader::GetInstance();
+	size_t loadId = pLoader->BeginLoadObject( GetObjectPath( 0 ) );
+	ASSERT_TRUE( IsValid( loadId ) );
+
+	// Objects are finished one at a time from the root down, each one discovering the next.  Requests parked on the
+	// package loader or on their dependencies are not visited while they wait, so ticking soon stops visiting anything
+	// even though more requests are pending each time.
+	AssetPtr spObject;
+	for ( uint32_t objectIndex = 0; objectIndex < CHAIN_LENGTH; ++objectIndex )
+	{
+		size_t tickCount = 0;
+		do
+		{
+			pLoader->Tick();
+			++tickCount;
+		} while ( pLoader->GetLastTickVisitCount() != 0 && tickCount < SETTLE_TICK_COUNT );
+
+		EXPECT_EQ( 0u, pLoader->GetLastTickVisitCount() ) << "Waiting for object " << objectIndex;
+		EXPECT_FALSE( pLoader->TryFinishLoad( loadId, spObject ) );
+
+		m_packageLoader.SetReady( GetObjectPath( objectIndex ) );
+	}
+
+	pLoader->FinishLoad( loadId, spObject );
+	ASSERT_TRUE( spObject.Get() != NULL );
+
+	CheckChain( CHAIN_LENGTH );
+
+	pLoader->Tick();
+	EXPECT_EQ( 0u, pLoader->GetLastTickVisitCount() );
+}
+
+TEST_F( AssetLoaderTest, VisitsOnlyRequestsThatCanProgress )
+{
+	CreatePackage( "Independent" );
+	for ( uint32_t objectIndex = 0; objectIndex < CHAIN_LENGTH; ++objectIndex )
+	{
+		m_packageLoader.AddObject( GetObjectPath( objectIndex ) );
+	}
+
+	// Requests waiting for the package loader to preload are checked on every tick.
+	m_packageLoader.SetPreloaded( false );
+
+	AssetLoader* pLoader = AssetLoader::GetInstance();
+	DynamicArray< size_t > loadIds;
+	for ( uint32_t objectIndex = 0; objectIndex < CHAIN_LENGTH; ++objectIndex )
+	{
+		loadIds.Push( pLoader->BeginLoadObject( GetObjectPath( objectIndex ) ) );
+		ASSERT_TRUE( IsValid( loadIds[ objectIndex ] ) );
+	}
+
+	pLoader->Tick();
+	EXPECT_EQ( CHAIN_LENGTH, pLoader->GetLastTickVisitCount() );
+
+	// Once preloaded, each request is checked one last time and then updated to start its object load, after which it
+	// is parked until the package loader wakes it.
+	m_packageLoader.SetPreloaded( true );
+	pLoader->Tick();
+	EXPECT_EQ( 2 * CHAIN_LENGTH, pLoader->GetLastTickVisitCount() );
+	pLoader->Tick();
+	EXPECT_EQ( 0u, pLoader->GetLastTickVisitCount() );
+
+	for ( uint32_t objectIndex = 0; objectIndex < CHAIN_LENGTH; ++objectIndex )
+	{
+		m_packageLoader.SetReady( GetObjectPath( objectIndex ) );
+	}
+
+	pLoader->Tick();
+	EXPECT_EQ( CHAIN_LENGTH, pLoader->GetLastTickVisitCount() );
+	pLoader->Tick();
+	EXPECT_EQ( 0u, pLoader->GetLastTickVisitCount() );
+
+	for ( uint32_t objectIndex = 0; objectIndex < CHAIN_LENGTH; ++objectIndex )
+	{
+		AssetPtr spObject;
+		EXPECT_TRUE( pLoader->TryFinishLoad( loadIds[ objectIndex ], spObject ) );
+		EXPECT_TRUE( spObject.Get() != NULL );
+		EXPECT_FALSE( TestAssetLoader::GetTestInstance()->HasLoadRequest( GetObjectPath( objectIndex ) ) );
+	}
+
+	EXPECT_TRUE( TestAssetLoader::GetTestInstance()->IsScheduleEmpty() );
+}
+
+TEST_F( AssetLoaderTest, DependencyFinishedBeforeDependentRegisters )
+{
+	CreatePackage( "FinishedDependency" );
+	AddChain( 2 );
+
+	TestAssetLoader* pLoader = TestAssetLoader::GetTestInstance();
+
+	// Fully load the dependency while holding on to its request.
+	m_packageLoader.SetReady( GetObjectPath( 1 ) );
+	size_t dependencyLoadId = pLoader->BeginLoadObject( GetObjectPath( 1 ) );
+	ASSERT_TRUE( IsValid( dependencyLoadId ) );
+	pLoader->Tick();
+	pLoader->Tick();
+	ASSERT_TRUE( Asset::FindObject( GetObjectPath( 1 ) ) != NULL );
+	EXPECT_TRUE( Asset::FindObject( GetObjectPath( 1 ) )->IsFullyLoaded() );
+	EXPECT_TRUE( pLoader->HasLoadRequest( GetObjectPath( 1 ) ) );
+
+	// The dependent picks up the finished request instead of waiting for progress that has already been made.
+	m_packageLoader.SetReady( GetObjectPath( 0 ) );
+	size_t loadId = pLoader->BeginLoadObject( GetObjectPath( 0 ) );
+	ASSERT_TRUE( IsValid( loadId ) );
+
+	AssetPtr spObject;
+	pLoader->FinishLoad( loadId, spObject );
+	ASSERT_TRUE( spObject.Get() != NULL );
+	EXPECT_FALSE( pLoader->HasLoadRequest( GetObjectPath( 0 ) ) );
+
+	// The dependency's request is only released with the last reference to it.
+	EXPECT_TRUE( pLoader->HasLoadRequest( GetObjectPath( 1 ) ) );
+	AssetPtr spDependency;
+	EXPECT_TRUE( pLoader->TryFinishLoad( dependencyLoadId, spDependency ) );
+	EXPECT_TRUE( spDependency.Get() != NULL );
+
+	CheckChain( 2 );
+}
+
+TEST_F( AssetLoaderTest, RequestFinishedOnCreationIsReleased )
+{
+	CreatePackage( "Preloaded" );
+	m_packageLoader.AddObject( GetObjectPath( 0 ) );
+	m_packageLoader.SetReady( GetObjectPath( 0 ) );
+
+	TestAssetLoader* pLoader = TestAssetLoader::GetTestInstance();
+
+	AssetPtr spObject;
+	ASSERT_TRUE( pLoader->LoadObject( GetObjectPath( 0 ), spObject ) );
+	ASSERT_TRUE( spObject.Get() != NULL );
+	EXPECT_FALSE( pLoader->HasLoadRequest( GetObjectPath( 0 ) ) );
+
+	// The object is now in memory, so a new request finishes as soon as it is created.  The scheduler's reference
+	// is dropped right away, leaving only the references of the callers.
+	size_t firstLoadId = pLoader->BeginLoadObject( GetObjectPath( 0 ) );
+	size_t secondLoadId = pLoader->BeginLoadObject( GetObjectPath( 0 ) );
+	ASSERT_TRUE( IsValid( firstLoadId ) );
+	EXPECT_EQ( firstLoadId, secondLoadId );
+	EXPECT_TRUE( pLoader->IsScheduleEmpty() );
+
+	AssetPtr spFirstObject;
+	EXPECT_TRUE( pLoader->TryFinishLoad( firstLoadId, spFirstObject ) );
+	EXPECT_TRUE( spFirstObject.Get() == spObject.Get() );
+	EXPECT_TRUE( pLoader->HasLoadRequest( GetObjectPath( 0 ) ) );
+
+	AssetPtr spSecondObject;
+	EXPECT_TRUE( pLoader->TryFinishLoad( secondLoadId, spSecondObject ) );
+	EXPECT_TRUE( spSecondObject.Get() == spObject.Get() );
+	EXPECT_FALSE( pLoader->HasLoadRequest( GetObjectPath( 0 ) ) );
+
+	pLoader->Tick();
+	EXPECT_EQ( 0u, pLoader->GetLastTickVisitCount() );
+}
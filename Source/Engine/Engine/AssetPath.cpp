@@ -1,11 +1,18 @@
 #include "Precompile.h"
 #include "Engine/AssetPath.h"
 
+#include "Platform/Atomic.h"
 #include "Foundation/FilePath.h"
 
 #include "Foundation/ReferenceCounting.h"
 #include "Engine/Asset.h"
 
+#if HELIUM_OS_WIN
+#include "Platform/SystemWin.h"
+#else
+#include <unistd.h>
+#endif
+
 struct Helium::AssetPath::PendingLink
 {
 	PendingLink *rpNext;
@@ -17,8 +24,9 @@ struct Helium::AssetPath::PendingLink
 
 using namespace Helium;
 
-AssetPath::TableBucket* AssetPath::sm_pTable = NULL;
-StackMemoryHeap<>* AssetPath::sm_pEntryMemoryHeap = NULL;
+AssetPath::TableShard* AssetPath::sm_pTable = NULL;
+size_t AssetPath::sm_tableShardMask = 0;
+size_t AssetPath::sm_tableShardBits = 0;
 ObjectPool<AssetPath::PendingLink> *AssetPath::sm_pPendingLinksPool = NULL;
 
 /// Parse the object path in the specified string and store it in this object.
@@ -502,9 +510,8 @@ void AssetPath::Shutdown()
 
 	delete [] sm_pTable;
 	sm_pTable = NULL;
-
-	delete sm_pEntryMemoryHeap;
-	sm_pEntryMemoryHeap = NULL;
+	sm_tableShardMask = 0;
+	sm_tableShardBits = 0;
 
 	delete sm_pPendingLinksPool;
 	sm_pPendingLinksPool = NULL;
@@ -852,31 +859,35 @@ AssetPath::Entry* AssetPath::Add( const Entry& rEntry )
 {
 	// Lazily initialize the hash table.  Note that this is not inherently thread-safe, but there should always be
 	// at least one path created before any sub-threads are spawned.
-	if( !sm_pEntryMemoryHeap )
+	if( !sm_pTable )
 	{
-		sm_pEntryMemoryHeap = new StackMemoryHeap<>( STACK_HEAP_BLOCK_SIZE );
-		HELIUM_ASSERT( sm_pEntryMemoryHeap );
-
 		sm_pPendingLinksPool = new ObjectPool<PendingLink>( PENDING_LINKS_POOL_BLOCK_SIZE );
 		HELIUM_ASSERT( sm_pPendingLinksPool );
 
-		HELIUM_ASSERT( !sm_pTable );
-		sm_pTable = new TableBucket [ TABLE_BUCKET_COUNT ];
+		size_t shardCount = GetTableShardCount();
+		sm_tableShardMask = shardCount - 1;
+		sm_tableShardBits = 0;
+		while( ( static_cast< size_t >( 1 ) << sm_tableShardBits ) < shardCount )
+		{
+			++sm_tableShardBits;
+		}
+
+		sm_pTable = new TableShard [ shardCount ];
 		HELIUM_ASSERT( sm_pTable );
 	}
 
-	HELIUM_ASSERT( sm_pTable );
+	// Select the shard using the low bits of the entry hash and let the shard use the remaining bits for its own slot
+	// indexing.
+	size_t hash = ComputeEntryHash( rEntry );
+	TableShard& rShard = sm_pTable[ hash & sm_tableShardMask ];
+	size_t shardHash = ( hash >> sm_tableShardBits );
 
-	// Compute the entry's hash table index and retrieve the corresponding bucket.
-	uint32_t bucketIndex = ComputeEntryStringHash( rEntry ) % TABLE_BUCKET_COUNT;
-	TableBucket& rBucket = sm_pTable[ bucketIndex ];
-
-	// Locate the entry in the table.  If it does not exist, add it.
-	size_t entryCount = 0;
-	Entry* pTableEntry = rBucket.Find( rEntry, entryCount );
+	// Most lookups are for paths that already exist, which can be found without locking.  If the entry is not found,
+	// fall back to the locked add, which checks again in case another thread added it in the meantime.
+	Entry* pTableEntry = rShard.Find( rEntry, shardHash );
 	if( !pTableEntry )
 	{
-		pTableEntry = rBucket.Add( rEntry, entryCount );
+		pTableEntry = rShard.Add( rEntry, shardHash );
 		HELIUM_ASSERT( pTableEntry );
 	}
 
@@ -926,29 +937,56 @@ void AssetPath::EntryToFilePathString( const Entry& rEntry, String& rString )
 	rString += rEntry.name.Get();
 }
 
-/// Compute a hash value for an object path entry based on the contents of the name strings (slow, should only be
-/// used internally when a string comparison is needed).
+/// Compute a hash value for an object path entry.
+///
+/// Since names and parent entries are both interned, the hash only needs to combine their pointer values instead of
+/// walking the name strings of the entry and all of its parents.
 ///
 /// @param[in] rEntry  Asset path entry.
 ///
 /// @return  Hash value.
-size_t AssetPath::ComputeEntryStringHash( const Entry& rEntry )
+size_t AssetPath::ComputeEntryHash( const Entry& rEntry )
 {
-	size_t hash = StringHash( rEntry.name.GetDirect() );
-	hash = ( ( hash * 33 ) ^ rEntry.instanceIndex );
-	hash = ( ( hash * 33 ) ^
-		( rEntry.bPackage
-		? static_cast< size_t >( HELIUM_PACKAGE_PATH_CHAR )
-		: static_cast< size_t >( HELIUM_OBJECT_PATH_CHAR ) ) );
+	uint64_t hash = static_cast< uint64_t >( reinterpret_cast< uintptr_t >( rEntry.name.GetDirect() ) );
+	hash = ( hash * 0x9e3779b97f4a7c15ULL ) ^ static_cast< uint64_t >( reinterpret_cast< uintptr_t >( rEntry.pParent ) );
+	hash = ( hash * 0x9e3779b97f4a7c15ULL ) ^ ( ( static_cast< uint64_t >( rEntry.instanceIndex ) << 1 ) |
+		( rEntry.bPackage ? 1 : 0 ) );
+
+	// Final mix so that both the low bits (used for shard selection) and the high bits (used for slot indexing) depend
+	// on every input bit.
+	hash ^= ( hash >> 33 );
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= ( hash >> 33 );
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= ( hash >> 33 );
+
+	return static_cast< size_t >( hash );
+}
 
-	Entry* pParent = rEntry.pParent;
-	if( pParent )
+/// Get the number of hash table shards to create.
+///
+/// The shard count is scaled with the number of processors so that threads interning paths concurrently rarely
+/// contend on the same shard lock.
+///
+/// @return  Table shard count (always a power of two).
+size_t AssetPath::GetTableShardCount()
+{
+#if HELIUM_OS_WIN
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo( &systemInfo );
+	size_t processorCount = static_cast< size_t >( systemInfo.dwNumberOfProcessors );
+#else
+	long result = sysconf( _SC_NPROCESSORS_ONLN );
+	size_t processorCount = ( result > 0 ? static_cast< size_t >( result ) : 1 );
+#endif
+
+	size_t shardCount = TABLE_SHARD_COUNT_MIN;
+	while( shardCount < processorCount * 4 && shardCount < TABLE_SHARD_COUNT_MAX )
 	{
-		size_t parentHash = ComputeEntryStringHash( *pParent );
-		hash = ( ( hash * 33 ) ^ parentHash );
+		shardCount <<= 1;
 	}
 
-	return hash;
+	return shardCount;
 }
 
 /// Get whether the contents of the two given object path entries match.
@@ -965,72 +1003,174 @@ bool AssetPath::EntryContentsMatch( const Entry& rEntry0, const Entry& rEntry1 )
 		rEntry0.pParent == rEntry1.pParent );
 }
 
-/// Find an existing object path entry in this table.
+/// Constructor.
+AssetPath::TableShard::TableShard()
+: m_pSlots( AllocateSlots( TABLE_SHARD_CAPACITY_MIN ) )
+, m_entryCount( 0 )
+, m_entryHeap( STACK_HEAP_BLOCK_SIZE )
+{
+}
+
+/// Destructor.
+AssetPath::TableShard::~TableShard()
+{
+	TableSlots* pSlots = m_pSlots;
+	while( pSlots )
+	{
+		TableSlots* pPrevious = pSlots->pPrevious;
+		DefaultAllocator().Free( pSlots );
+		pSlots = pPrevious;
+	}
+}
+
+/// Find an existing object path entry in this shard.
+///
+/// This does not take any locks, and can be safely called while other threads are adding entries.  Entries added by
+/// other threads may not be found, in which case Add() should be used to perform a synchronized search.
 ///
-/// @param[in]  rEntry       Externally defined entry to match.
-/// @param[out] rEntryCount  Number of entries in this bucket when the search was performed.
+/// @param[in] rEntry  Externally defined entry to match.
+/// @param[in] hash    Entry hash value, with the bits used for shard selection removed.
 ///
 /// @return  Table entry if found, null if not found.
 ///
 /// @see Add()
-AssetPath::Entry* AssetPath::TableBucket::Find( const Entry& rEntry, size_t& rEntryCount )
+AssetPath::Entry* AssetPath::TableShard::Find( const Entry& rEntry, size_t hash ) const
 {
-	ScopeReadLock readLock( m_lock );
+	const TableSlots* pSlots = m_pSlots;
+	HELIUM_ASSERT( pSlots );
+
+	return FindInSlots( pSlots, rEntry, hash );
+}
 
-	Entry* const * ppTableEntries = m_entries.GetData();
-	size_t entryCount = m_entries.GetSize();
-	HELIUM_ASSERT( ppTableEntries || entryCount == 0 );
+/// Add an object path entry to this shard if it does not already exist.
+///
+/// @param[in] rEntry  Externally defined entry to locate or add.
+/// @param[in] hash    Entry hash value, with the bits used for shard selection removed.
+///
+/// @return  Pointer to the object path table entry.
+///
+/// @see Find()
+AssetPath::Entry* AssetPath::TableShard::Add( const Entry& rEntry, size_t hash )
+{
+	MutexScopeLock scopeLock( m_lock );
 
-	rEntryCount = entryCount;
+	// Check for the entry again, as it may have been added by another thread since the unlocked search.
+	Entry* pTableEntry = FindInSlots( m_pSlots, rEntry, hash );
+	if( pTableEntry )
+	{
+		return pTableEntry;
+	}
 
-	for( size_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+	// Keep the load factor at or below one half so that probe sequences stay short.
+	if( ( m_entryCount + 1 ) * 2 > m_pSlots->capacityMask + 1 )
 	{
-		Entry* pTableEntry = ppTableEntries[ entryIndex ];
-		HELIUM_ASSERT( pTableEntry );
-		if( EntryContentsMatch( rEntry, *pTableEntry ) )
+		Grow();
+	}
+
+	Entry* pNewEntry = static_cast< Entry* >( m_entryHeap.Allocate( sizeof( Entry ) ) );
+	HELIUM_ASSERT( pNewEntry );
+	new( pNewEntry ) Entry( rEntry );
+
+	InsertInSlots( m_pSlots, pNewEntry, hash );
+	++m_entryCount;
+
+	return pNewEntry;
+}
+
+/// Replace the slot array of this shard with one twice its size.
+///
+/// The old slot array is kept so that any threads still searching it are not affected.  This must only be called while
+/// the shard lock is held.
+void AssetPath::TableShard::Grow()
+{
+	TableSlots* pOldSlots = m_pSlots;
+	HELIUM_ASSERT( pOldSlots );
+
+	size_t oldCapacity = pOldSlots->capacityMask + 1;
+	TableSlots* pNewSlots = AllocateSlots( oldCapacity * 2 );
+	pNewSlots->pPrevious = pOldSlots;
+
+	for( size_t slotIndex = 0; slotIndex < oldCapacity; ++slotIndex )
+	{
+		Entry* pEntry = pOldSlots->slots[ slotIndex ];
+		if( pEntry )
 		{
-			return pTableEntry;
+			InsertInSlots( pNewSlots, pEntry, ComputeEntryHash( *pEntry ) >> sm_tableShardBits );
 		}
 	}
 
-	return NULL;
+	AtomicExchangeRelease( m_pSlots, pNewSlots );
 }
 
-/// Add an object path entry to this table if it does not already exist.
+/// Allocate and clear a slot array.
 ///
-/// @param[in] rEntry              Externally defined entry to locate or add.
-/// @param[in] previousEntryCount  Number of entries already checked during a previous Find() call (existing entries
-///                                are not expected to change).  In other words, the entry index from which to start
-///                                checking for any additional string entries that may have been added since the
-///                                previous Find() call.
+/// @param[in] capacity  Number of slots to allocate (must be a power of two).
 ///
-/// @return  Pointer to the object path table entry.
+/// @return  Newly allocated slot array.
+AssetPath::TableSlots* AssetPath::TableShard::AllocateSlots( size_t capacity )
+{
+	HELIUM_ASSERT( capacity != 0 && ( capacity & ( capacity - 1 ) ) == 0 );
+
+	TableSlots* pSlots = static_cast< TableSlots* >( DefaultAllocator().Allocate(
+		sizeof( TableSlots ) + sizeof( Entry* ) * ( capacity - 1 ) ) );
+	HELIUM_ASSERT( pSlots );
+
+	pSlots->capacityMask = capacity - 1;
+	pSlots->pPrevious = NULL;
+	for( size_t slotIndex = 0; slotIndex < capacity; ++slotIndex )
+	{
+		pSlots->slots[ slotIndex ] = NULL;
+	}
+
+	return pSlots;
+}
+
+/// Search a slot array for an entry using linear probing.
 ///
-/// @see Find()
-AssetPath::Entry* AssetPath::TableBucket::Add( const Entry& rEntry, size_t previousEntryCount )
+/// @param[in] pSlots  Slot array to search.
+/// @param[in] rEntry  Externally defined entry to match.
+/// @param[in] hash    Entry hash value, with the bits used for shard selection removed.
+///
+/// @return  Table entry if found, null if not found.
+AssetPath::Entry* AssetPath::TableShard::FindInSlots( const TableSlots* pSlots, const Entry& rEntry, size_t hash )
 {
-	ScopeWriteLock writeLock( m_lock );
+	HELIUM_ASSERT( pSlots );
 
-	Entry* const * ppTableEntries = m_entries.GetData();
-	size_t entryCount = m_entries.GetSize();
-	HELIUM_ASSERT( ppTableEntries || entryCount == 0 );
-	HELIUM_ASSERT( previousEntryCount <= entryCount );
-	for( size_t entryIndex = previousEntryCount; entryIndex < entryCount; ++entryIndex )
+	// Slot arrays are never more than half full, so this will always hit an empty slot if the entry is not present.
+	size_t capacityMask = pSlots->capacityMask;
+	for( size_t slotIndex = hash & capacityMask; ; slotIndex = ( slotIndex + 1 ) & capacityMask )
 	{
-		Entry* pTableEntry = ppTableEntries[ entryIndex ];
-		HELIUM_ASSERT( pTableEntry );
+		Entry* pTableEntry = pSlots->slots[ slotIndex ];
+		if( !pTableEntry )
+		{
+			return NULL;
+		}
+
 		if( EntryContentsMatch( rEntry, *pTableEntry ) )
 		{
 			return pTableEntry;
 		}
 	}
+}
 
-	HELIUM_ASSERT( sm_pEntryMemoryHeap );
-	Entry* pNewEntry = static_cast< Entry* >( sm_pEntryMemoryHeap->Allocate( sizeof( Entry ) ) );
-	HELIUM_ASSERT( pNewEntry );
-	new( pNewEntry ) Entry( rEntry );
+/// Store an entry in the first free slot of its probe sequence.
+///
+/// The slot is written with release semantics so that unlocked readers never see a partially constructed entry.
+///
+/// @param[in] pSlots  Slot array in which to store the entry.
+/// @param[in] pEntry  Entry to store.
+/// @param[in] hash    Entry hash value, with the bits used for shard selection removed.
+void AssetPath::TableShard::InsertInSlots( TableSlots* pSlots, Entry* pEntry, size_t hash )
+{
+	HELIUM_ASSERT( pSlots );
+	HELIUM_ASSERT( pEntry );
 
-	m_entries.Push( pNewEntry );
+	size_t capacityMask = pSlots->capacityMask;
+	size_t slotIndex = hash & capacityMask;
+	while( pSlots->slots[ slotIndex ] )
+	{
+		slotIndex = ( slotIndex + 1 ) & capacityMask;
+	}
 
-	return pNewEntry;
+	AtomicExchangeRelease( pSlots->slots[ slotIndex ], pEntry );
 }
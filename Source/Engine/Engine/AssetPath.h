@@ -35,8 +35,13 @@ namespace Helium
 	class HELIUM_ENGINE_API AssetPath
 	{
 	public:
-		/// Number of object path hash table buckets (prime numbers are recommended).
-		static const size_t TABLE_BUCKET_COUNT = 37;
+		/// Minimum number of object path hash table shards (must be a power of two).  The actual shard count is scaled up
+		/// based on the number of processors available.
+		static const size_t TABLE_SHARD_COUNT_MIN = 16;
+		/// Maximum number of object path hash table shards (must be a power of two).
+		static const size_t TABLE_SHARD_COUNT_MAX = 256;
+		/// Initial number of entry slots in each table shard (must be a power of two).
+		static const size_t TABLE_SHARD_CAPACITY_MIN = 64;
 		/// Asset path stack memory heap block size.
 		static const size_t STACK_HEAP_BLOCK_SIZE = sizeof( char ) * 8192;
 		/// Block size for pool of pending links
@@ -114,30 +119,69 @@ namespace Helium
 			bool bPackage;
 		};
 
-		/// Asset path hash table bucket.
-		class TableBucket
+		/// Open-addressed array of entry pointers for a single table shard.
+		struct TableSlots
+		{
+			/// Slot count minus one (slot counts are always powers of two).
+			size_t capacityMask;
+			/// Slot array replaced by this one when the shard was last grown.
+			TableSlots* pPrevious;
+			/// Entry slots (actually allocated with "capacityMask + 1" elements).
+			Entry* volatile slots[ 1 ];
+		};
+
+		/// Asset path hash table shard.
+		///
+		/// Lookups are performed without taking any locks.  Entries are only ever added to a shard (never removed), and a
+		/// slot array that has been replaced by a larger one is kept alive until shutdown, so readers can safely probe
+		/// whichever slot array they last saw.
+		class TableShard
 		{
 		public:
+			/// @name Construction/Destruction
+			//@{
+			TableShard();
+			~TableShard();
+			//@}
+
 			/// @name Access
 			//@{
-			Entry* Find( const Entry& rEntry, size_t& rEntryCount );
-			Entry* Add( const Entry& rEntry, size_t previousEntryCount );
+			Entry* Find( const Entry& rEntry, size_t hash ) const;
+			Entry* Add( const Entry& rEntry, size_t hash );
 			//@}
 
 		private:
-			/// Array of entry pointers.
-			DynamicArray< Entry* > m_entries;
-			/// Read-write lock for synchronizing access.
-			ReadWriteLock m_lock;
+			/// Current slot array.
+			TableSlots* volatile m_pSlots;
+			/// Number of entries stored in this shard.
+			size_t m_entryCount;
+			/// Stack-based memory heap for allocating entries added to this shard.
+			StackMemoryHeap<> m_entryHeap;
+			/// Mutex for synchronizing entry additions.
+			Mutex m_lock;
+
+			/// @name Private Utility Functions
+			//@{
+			void Grow();
+			//@}
+
+			/// @name Static Private Utility Functions
+			//@{
+			static TableSlots* AllocateSlots( size_t capacity );
+			static Entry* FindInSlots( const TableSlots* pSlots, const Entry& rEntry, size_t hash );
+			static void InsertInSlots( TableSlots* pSlots, Entry* pEntry, size_t hash );
+			//@}
 		};
 
 		/// Asset path entry.
 		Entry* m_pEntry;
 
-		/// Asset path hash table.
-		static TableBucket* sm_pTable;
-		/// Stack-based memory heap for object path entry allocations.
-		static StackMemoryHeap<>* sm_pEntryMemoryHeap;
+		/// Asset path hash table shards.
+		static TableShard* sm_pTable;
+		/// Number of table shards minus one.
+		static size_t sm_tableShardMask;
+		/// Number of bits used to select a table shard from an entry hash.
+		static size_t sm_tableShardBits;
 		static ObjectPool<PendingLink> *sm_pPendingLinksPool;
 
 		/// @name Private Utility Functions
@@ -156,7 +200,8 @@ namespace Helium
 		static void EntryToString( const Entry& rEntry, String& rString );
 		static void EntryToFilePathString( const Entry& rEntry, String& rString );
 
-		static size_t ComputeEntryStringHash( const Entry& rEntry );
+		static size_t ComputeEntryHash( const Entry& rEntry );
+		static size_t GetTableShardCount();
 		static bool EntryContentsMatch( const Entry& rEntry0, const Entry& rEntry1 );
 		//@}
 	};
@@ -0,0 +1,220 @@
+#include "Engine/AssetPath.h"
+
+#include "Platform/Thread.h"
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Number of distinct paths created by the benchmark.
+	const size_t BENCHMARK_PATH_COUNT = 1000000;
+	/// Number of threads used for the concurrent benchmark.
+	const size_t BENCHMARK_THREAD_COUNT = 8;
+
+	/// Build the string for a path in a tree of packages similar to a large project's asset layout.
+	void BuildPathString( const char* pRoot, size_t pathIndex, char* pBuffer, size_t bufferSize )
+	{
+		snprintf(
+			pBuffer,
+			bufferSize,
+			"/%s%u/Area%u/Set%u:Asset%u",
+			pRoot,
+			static_cast< uint32_t >( pathIndex % 7 ),
+			static_cast< uint32_t >( pathIndex % 251 ),
+			static_cast< uint32_t >( pathIndex % 4093 ),
+			static_cast< uint32_t >( pathIndex ) );
+	}
+
+	/// Set a range of paths from their strings.
+	class PathSetter : public Runnable
+	{
+	public:
+		PathSetter()
+			: m_pRoot( NULL )
+			, m_pPaths( NULL )
+			, m_start( 0 )
+			, m_end( 0 )
+		{
+		}
+
+		void Initialize( const char* pRoot, AssetPath* pPaths, size_t start, size_t end )
+		{
+			m_pRoot = pRoot;
+			m_pPaths = pPaths;
+			m_start = start;
+			m_end = end;
+		}
+
+		virtual void Run()
+		{
+			char pathString[ 128 ];
+			for( size_t pathIndex = m_start; pathIndex < m_end; ++pathIndex )
+			{
+				BuildPathString( m_pRoot, pathIndex, pathString, sizeof( pathString ) );
+				HELIUM_VERIFY( m_pPaths[ pathIndex ].Set( pathString ) );
+			}
+		}
+
+	private:
+		const char* m_pRoot;
+		AssetPath* m_pPaths;
+		size_t m_start;
+		size_t m_end;
+	};
+
+	/// Set every path across several threads at once.
+	///
+	/// @param[in]  pRoot         Root name of the paths.
+	/// @param[out] rPaths        Paths to set.
+	/// @param[out] pMirrorPaths  If not null, a second array in which to set the same paths, using a separate set of
+	///                           threads running at the same time.
+	///
+	/// @return  Time taken, in ticks.
+	uint64_t SetPathsConcurrently(
+		const char* pRoot,
+		DynamicArray< AssetPath >& rPaths,
+		DynamicArray< AssetPath >* pMirrorPaths = NULL )
+	{
+		PathSetter setters[ BENCHMARK_THREAD_COUNT * 2 ];
+		RunnableThread* pThreads[ BENCHMARK_THREAD_COUNT * 2 ];
+
+		size_t pathCount = rPaths.GetSize();
+		size_t threadCount = ( pMirrorPaths ? BENCHMARK_THREAD_COUNT * 2 : BENCHMARK_THREAD_COUNT );
+		for( size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+		{
+			size_t rangeIndex = threadIndex % BENCHMARK_THREAD_COUNT;
+			DynamicArray< AssetPath >& rTarget = ( threadIndex < BENCHMARK_THREAD_COUNT ? rPaths : *pMirrorPaths );
+			HELIUM_ASSERT( rTarget.GetSize() == pathCount );
+
+			setters[ threadIndex ].Initialize(
+				pRoot,
+				rTarget.GetData(),
+				pathCount * rangeIndex / BENCHMARK_THREAD_COUNT,
+				pathCount * ( rangeIndex + 1 ) / BENCHMARK_THREAD_COUNT );
+		}
+
+		uint64_t startTicks = Timer::GetTickCount();
+		for( size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+		{
+			pThreads[ threadIndex ] = new RunnableThread( &setters[ threadIndex ] );
+			HELIUM_VERIFY( pThreads[ threadIndex ]->Start( "AssetPathTests" ) );
+		}
+
+		for( size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+		{
+			pThreads[ threadIndex ]->Join();
+			delete pThreads[ threadIndex ];
+		}
+
+		return Timer::GetTickCount() - startTicks;
+	}
+}
+
+TEST( AssetPathTest, ParsesAndFormatsPaths )
+{
+	AssetPath path;
+	ASSERT_TRUE( path.Set( "/Game/Characters/Hero:Mesh" ) );
+	EXPECT_FALSE( path.IsPackage() );
+	EXPECT_EQ( String( "/Game/Characters/Hero:Mesh" ), path.ToString() );
+
+	AssetPath parent = path.GetParent();
+	EXPECT_TRUE( parent.IsPackage() );
+	EXPECT_EQ( String( "/Game/Characters/Hero" ), parent.ToString() );
+	EXPECT_TRUE( path.IsWithinAssetPath( parent ) );
+
+	AssetPath other;
+	ASSERT_TRUE( other.Set( "/Game/Characters/Hero:Mesh" ) );
+	EXPECT_TRUE( path == other );
+
+	ASSERT_TRUE( other.Set( "/Game/Characters/Hero:Material" ) );
+	EXPECT_TRUE( path != other );
+	EXPECT_TRUE( path.GetParent() == other.GetParent() );
+}
+
+TEST( AssetPathTest, BenchmarkMillionPaths )
+{
+	// Create one path up front so that the table is initialized before any other thread touches it.
+	AssetPath rootPath( "/Game0" );
+	ASSERT_FALSE( rootPath.IsEmpty() );
+
+	DynamicArray< AssetPath > paths;
+	paths.Resize( BENCHMARK_PATH_COUNT );
+
+	// Every path is new on the first pass and already in the table on the second.
+	char pathString[ 128 ];
+	uint64_t startTicks = Timer::GetTickCount();
+	for( size_t pathIndex = 0; pathIndex < BENCHMARK_PATH_COUNT; ++pathIndex )
+	{
+		BuildPathString( "Game", pathIndex, pathString, sizeof( pathString ) );
+		ASSERT_TRUE( paths[ pathIndex ].Set( pathString ) );
+	}
+	uint64_t insertTicks = Timer::GetTickCount() - startTicks;
+
+	DynamicArray< AssetPath > lookups;
+	lookups.Resize( BENCHMARK_PATH_COUNT );
+	startTicks = Timer::GetTickCount();
+	for( size_t pathIndex = 0; pathIndex < BENCHMARK_PATH_COUNT; ++pathIndex )
+	{
+		BuildPathString( "Game", pathIndex, pathString, sizeof( pathString ) );
+		ASSERT_TRUE( lookups[ pathIndex ].Set( pathString ) );
+	}
+	uint64_t lookupTicks = Timer::GetTickCount() - startTicks;
+
+	DynamicArray< AssetPath > concurrentLookups;
+	concurrentLookups.Resize( BENCHMARK_PATH_COUNT );
+	uint64_t concurrentLookupTicks = SetPathsConcurrently( "Game", concurrentLookups );
+
+	for( size_t pathIndex = 0; pathIndex < BENCHMARK_PATH_COUNT; ++pathIndex )
+	{
+		ASSERT_TRUE( paths[ pathIndex ] == lookups[ pathIndex ] );
+		ASSERT_TRUE( paths[ pathIndex ] == concurrentLookups[ pathIndex ] );
+	}
+
+	for( size_t pathIndex = 0; pathIndex < BENCHMARK_PATH_COUNT; pathIndex += 9973 )
+	{
+		BuildPathString( "Game", pathIndex, pathString, sizeof( pathString ) );
+		EXPECT_EQ( String( pathString ), paths[ pathIndex ].ToString() );
+	}
+
+	printf(
+		"%u paths: insert %.3f ms, lookup %.3f ms, lookup on %u threads %.3f ms\n",
+		static_cast< uint32_t >( BENCHMARK_PATH_COUNT ),
+		Timer::TicksToMilliseconds( insertTicks ),
+		Timer::TicksToMilliseconds( lookupTicks ),
+		static_cast< uint32_t >( BENCHMARK_THREAD_COUNT ),
+		Timer::TicksToMilliseconds( concurrentLookupTicks ) );
+}
+
+TEST( AssetPathTest, ConcurrentInsertsAgree )
+{
+	AssetPath rootPath( "/Concurrent" );
+	ASSERT_FALSE( rootPath.IsEmpty() );
+
+	// Two sets of threads race to add the same new paths, and must end up with the same entries.
+	const size_t pathCount = 100000;
+	DynamicArray< AssetPath > first;
+	DynamicArray< AssetPath > second;
+	first.Resize( pathCount );
+	second.Resize( pathCount );
+
+	SetPathsConcurrently( "Concurrent", first, &second );
+
+	char pathString[ 128 ];
+	for( size_t pathIndex = 0; pathIndex < pathCount; ++pathIndex )
+	{
+		ASSERT_TRUE( first[ pathIndex ] == second[ pathIndex ] );
+		ASSERT_FALSE( first[ pathIndex ].IsEmpty() );
+	}
+
+	for( size_t pathIndex = 0; pathIndex < pathCount; pathIndex += 997 )
+	{
+		BuildPathString( "Concurrent", pathIndex, pathString, sizeof( pathString ) );
+		EXPECT_EQ( String( pathString ), first[ pathIndex ].ToString() );
+	}
+}
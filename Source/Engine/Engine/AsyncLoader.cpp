@@ -3,17 +3,32 @@
 
 #include "Engine/FileLocations.h"
 #include "Foundation/FileStream.h"
+#include "Platform/Timer.h"
+
+#if HELIUM_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace Helium;
 
+#if HELIUM_OS_LINUX
+/// Positional reads leave the descriptor's file offset alone, so cached files can be read by several workers at once.
+static const bool g_ShareOpenFiles = true;
+#else
+static const bool g_ShareOpenFiles = false;
+#endif
+
 static uint32_t g_InitCount = 0;
 AsyncLoader* AsyncLoader::sm_pInstance = NULL;
 
 /// Constructor.
 AsyncLoader::AsyncLoader()
 	: m_requestPool( REQUEST_POOL_BLOCK_SIZE )
-	, m_pThread( NULL )
-	, m_pWorker( NULL )
+	, m_pendingRequestCount( 0 )
+	, m_completedRequestCounter( 0 )
+	, m_fileUseCounter( 0 )
 {
 }
 
@@ -25,20 +40,35 @@ AsyncLoader::~AsyncLoader()
 
 /// Initialize the async loader.
 ///
+/// @param[in] workerCount  Number of file loading threads to start.
+///
 /// @return  True if initialization was sucessful, false if not.
 ///
 /// @see Cleanup()
-bool AsyncLoader::Initialize()
+bool AsyncLoader::Initialize( uint32_t workerCount )
 {
 	Cleanup();
 
-	// Start up the async loading thread.
-	m_pWorker = new LoadWorker;
-	HELIUM_ASSERT( m_pWorker );
+	if( workerCount == 0 )
+	{
+		workerCount = 1;
+	}
 
-	m_pThread = new RunnableThread( m_pWorker );
-	HELIUM_ASSERT( m_pThread );
-	HELIUM_VERIFY( m_pThread->Start( "AsyncLoader - file loading" ) );
+	// Start up the async loading threads.
+	m_workers.Reserve( workerCount );
+	m_threads.Reserve( workerCount );
+
+	for( uint32_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+	{
+		LoadWorker* pWorker = new LoadWorker( this );
+		HELIUM_ASSERT( pWorker );
+		m_workers.Push( pWorker );
+
+		RunnableThread* pThread = new RunnableThread( pWorker );
+		HELIUM_ASSERT( pThread );
+		HELIUM_VERIFY( pThread->Start( "AsyncLoader - file loading" ) );
+		m_threads.Push( pThread );
+	}
 
 	return true;
 }
@@ -48,20 +78,31 @@ bool AsyncLoader::Initialize()
 /// @see Initialize()
 void AsyncLoader::Cleanup()
 {
-	if( m_pWorker )
+	size_t workerCount = m_workers.GetSize();
+	for( size_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+	{
+		m_workers[ workerIndex ]->Stop();
+	}
+
+	size_t threadCount = m_threads.GetSize();
+	for( size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex )
 	{
-		m_pWorker->Stop();
+		RunnableThread* pThread = m_threads[ threadIndex ];
+		HELIUM_ASSERT( pThread );
+		pThread->Join();
+		delete pThread;
 	}
 
-	if( m_pThread )
+	m_threads.Clear();
+
+	for( size_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
 	{
-		m_pThread->Join();
-		delete m_pThread;
-		m_pThread = NULL;
+		delete m_workers[ workerIndex ];
 	}
 
-	delete m_pWorker;
-	m_pWorker = NULL;
+	m_workers.Clear();
+
+	CloseFiles();
 }
 
 /// Queue an async load request.
@@ -74,19 +115,49 @@ void AsyncLoader::Cleanup()
 ///
 /// @return  ID identifying the load request if queued successfully, invalid index if the request queue failed.
 ///
-/// @see SyncRequest(), TrySyncRequest()
+/// @see QueueCompressedRequest(), SyncRequest(), TrySyncRequest()
 size_t AsyncLoader::QueueRequest(
 	void* pBuffer,
 	const String& rFileName,
 	uint64_t offset,
 	size_t size,
 	EPriority priority )
+{
+	return QueueCompressedRequest( pBuffer, rFileName, offset, size, Compression::TYPE_NONE, size, priority );
+}
+
+/// Queue an async load request for a block of data that may be stored compressed.
+///
+/// The stored data is read in full and decompressed on a load worker thread.  The number of bytes reported as read
+/// once the request completes is the number of decompressed bytes stored in the output buffer.
+///
+/// @param[in] pBuffer      Buffer in which to load data.
+/// @param[in] rFileName    FilePath name of the file from which to load.
+/// @param[in] offset       Byte offset within the file from which to load.
+/// @param[in] storedSize   Number of bytes occupied by the data in the file.
+/// @param[in] compression  Format in which the data is stored.
+/// @param[in] size         Number of bytes to store in the output buffer.  This may be less than the decompressed size
+///                         of the data, in which case only the start of the data is loaded.
+/// @param[in] priority     Load priority.
+///
+/// @return  ID identifying the load request if queued successfully, invalid index if the request queue failed.
+///
+/// @see QueueRequest(), SyncRequest(), TrySyncRequest()
+size_t AsyncLoader::QueueCompressedRequest(
+	void* pBuffer,
+	const String& rFileName,
+	uint64_t offset,
+	size_t storedSize,
+	Compression::EType compression,
+	size_t size,
+	EPriority priority )
 {
 	HELIUM_ASSERT( pBuffer );
+	HELIUM_ASSERT( static_cast< size_t >( compression ) < static_cast< size_t >( Compression::TYPE_MAX ) );
 	HELIUM_ASSERT( static_cast< size_t >( priority ) < static_cast< size_t >( PRIORITY_MAX ) );
 
-	// Make sure the load worker is running.
-	if( !m_pWorker )
+	// Make sure the load workers are running.
+	if( m_workers.IsEmpty() )
 	{
 		return Invalid< size_t >();
 	}
@@ -97,13 +168,36 @@ size_t AsyncLoader::QueueRequest(
 	pRequest->pBuffer = pBuffer;
 	pRequest->fileName = rFileName;
 	pRequest->offset = offset;
+	pRequest->storedSize = ( compression == Compression::TYPE_NONE ? size : storedSize );
+	pRequest->compression = compression;
 	pRequest->size = size;
 	pRequest->priority = priority;
+	pRequest->queueTicks = Timer::GetTickCount();
 
 	pRequest->bytesRead = 0;
 	AtomicExchangeRelease( pRequest->processedCounter, 0 );
 
-	m_pWorker->QueueRequest( pRequest );
+	{
+		// Prevent access to the load queue while an exclusive write lock is held.
+		ScopeReadLock nonExclusiveLock( m_writeLock );
+
+		AtomicIncrementAcquire( m_pendingRequestCount );
+
+		Locker< RequestQueue, SpinLock >::Handle handle( m_requestQueue );
+		handle->requests[ priority ].Push( pRequest );
+		++handle->count;
+		if( handle->count > handle->maxCount )
+		{
+			handle->maxCount = handle->count;
+		}
+	}
+
+	// Any idle worker can pick up the request.
+	size_t workerCount = m_workers.GetSize();
+	for( size_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+	{
+		m_workers[ workerIndex ]->WakeUp();
+	}
 
 	size_t requestIndex = m_requestPool.GetIndex( pRequest );
 	HELIUM_ASSERT( IsValid( requestIndex ) );
@@ -176,21 +270,29 @@ bool AsyncLoader::TrySyncRequest( size_t id, size_t& rBytesRead )
 /// pending requests in order to free any associated resources.
 void AsyncLoader::Flush()
 {
-	if( m_pWorker )
+	if( m_workers.IsEmpty() )
 	{
-		m_pWorker->Flush();
+		return;
+	}
+
+	while( m_pendingRequestCount != 0 )
+	{
+		Thread::Yield();
 	}
 }
 
 /// Lock async loading for writing to files that may be in use.
 ///
+/// This flushes all pending requests and closes any cached files.
+///
 /// @see Unlock()
 void AsyncLoader::Lock()
 {
-	if( m_pWorker )
-	{
-		m_pWorker->Lock();
-	}
+	// Prevent other threads from queueing requests or writing out data while we have a write lock.
+	m_writeLock.LockWrite();
+
+	Flush();
+	CloseFiles();
 }
 
 /// Unlock a previous loader lock.
@@ -198,10 +300,43 @@ void AsyncLoader::Lock()
 /// @see Lock()
 void AsyncLoader::Unlock()
 {
-	if( m_pWorker )
+	m_writeLock.UnlockWrite();
+}
+
+/// Get the current load statistics.
+///
+/// @param[out] rStatistics  Load statistics.
+///
+/// @see ResetStatistics()
+void AsyncLoader::GetStatistics( Statistics& rStatistics )
+{
 	{
-		m_pWorker->Unlock();
+		Locker< Statistics, SpinLock >::Handle handle( m_statistics );
+		rStatistics = *handle;
 	}
+
+	Locker< RequestQueue, SpinLock >::Handle handle( m_requestQueue );
+	for( size_t priority = PRIORITY_FIRST; priority < PRIORITY_MAX; ++priority )
+	{
+		rStatistics.queueDepth[ priority ] =
+			static_cast< uint32_t >( handle->requests[ priority ].GetSize() - handle->headIndices[ priority ] );
+	}
+
+	rStatistics.maxQueueDepth = static_cast< uint32_t >( handle->maxCount );
+}
+
+/// Reset the load statistics counters.
+///
+/// @see GetStatistics()
+void AsyncLoader::ResetStatistics()
+{
+	{
+		Locker< Statistics, SpinLock >::Handle handle( m_statistics );
+		*handle = Statistics();
+	}
+
+	Locker< RequestQueue, SpinLock >::Handle handle( m_requestQueue );
+	handle->maxCount = handle->count;
 }
 
 /// Get the singleton AsyncLoader instance.
@@ -245,138 +380,564 @@ void AsyncLoader::Shutdown()
 	}
 }
 
-/// Constructor.
-AsyncLoader::LoadWorker::LoadWorker()
-	: m_wakeUpCondition( false, false )
-	, m_stopCounter( 0 )
-	, m_processingCounter( 0 )
+/// Take the next request to service from the queue, along with any queued requests that continue on from it in the
+/// same file.
+///
+/// @param[out] rBatch  Requests to service with a single read, in file order.
+///
+/// @return  True if any requests were taken, false if the queue is empty.
+bool AsyncLoader::PopRequests( DynamicArray< Request* >& rBatch )
 {
-}
+	rBatch.Resize( 0 );
 
-/// Destructor.
-AsyncLoader::LoadWorker::~LoadWorker()
-{
+	Locker< RequestQueue, SpinLock >::Handle handle( m_requestQueue );
+	if( handle->count == 0 )
+	{
+		return false;
+	}
+
+	// Take the oldest request with the highest priority.
+	Request* pRequest = NULL;
+	for( size_t priority = PRIORITY_MAX; priority-- > PRIORITY_FIRST; )
+	{
+		DynamicArray< Request* >& rRequests = handle->requests[ priority ];
+		size_t& rHeadIndex = handle->headIndices[ priority ];
+		if( rHeadIndex < rRequests.GetSize() )
+		{
+			pRequest = rRequests[ rHeadIndex ];
+			++rHeadIndex;
+			if( rHeadIndex >= rRequests.GetSize() )
+			{
+				rRequests.Resize( 0 );
+				rHeadIndex = 0;
+			}
+
+			break;
+		}
+	}
+
+	HELIUM_ASSERT( pRequest );
+	--handle->count;
+	rBatch.Push( pRequest );
+
+	// Pull in queued requests that pick up where the batch leaves off, so they can share the same read.
+	uint64_t endOffset = pRequest->offset + pRequest->storedSize;
+	size_t batchSize = pRequest->storedSize;
+	bool bFound = ( batchSize < MERGE_SIZE_LIMIT );
+	while( bFound && handle->count != 0 )
+	{
+		bFound = false;
+		for( size_t priority = PRIORITY_MAX; !bFound && priority-- > PRIORITY_FIRST; )
+		{
+			DynamicArray< Request* >& rRequests = handle->requests[ priority ];
+			size_t requestCount = rRequests.GetSize();
+			for( size_t requestIndex = handle->headIndices[ priority ]; requestIndex < requestCount; ++requestIndex )
+			{
+				Request* pCandidate = rRequests[ requestIndex ];
+				if( pCandidate->offset != endOffset ||
+					batchSize + pCandidate->storedSize > MERGE_SIZE_LIMIT ||
+					pCandidate->fileName != pRequest->fileName )
+				{
+					continue;
+				}
+
+				rRequests.Remove( requestIndex );
+				if( handle->headIndices[ priority ] >= rRequests.GetSize() )
+				{
+					rRequests.Resize( 0 );
+					handle->headIndices[ priority ] = 0;
+				}
+
+				--handle->count;
+				rBatch.Push( pCandidate );
+				endOffset += pCandidate->storedSize;
+				batchSize += pCandidate->storedSize;
+				bFound = true;
+
+				break;
+			}
+		}
+	}
+
+	return true;
 }
 
-/// Execute the async loading work.
-void AsyncLoader::LoadWorker::Run()
+/// Publish the result of a load request and update the load statistics.
+///
+/// The request may be released by another thread as soon as this returns, so it must not be accessed afterward.
+///
+/// @param[in] pRequest            Completed request.
+/// @param[in] bytesRead           Number of bytes stored in the request buffer, or an invalid index if the file could
+///                                not be opened.
+/// @param[in] bMerged             True if the request was serviced by a read shared with other requests.
+/// @param[in] decompressionTicks  Time spent decompressing the request data, in ticks.
+void AsyncLoader::CompleteRequest( Request* pRequest, size_t bytesRead, bool bMerged, uint64_t decompressionTicks )
 {
-	BufferedStream* pBufferedStream = new BufferedStream;
-	HELIUM_ASSERT( pBufferedStream );
+	HELIUM_ASSERT( pRequest );
+
+	uint64_t latencyTicks = Timer::GetTickCount() - pRequest->queueTicks;
 
-	while( m_stopCounter == 0 )
 	{
-		AtomicExchangeAcquire( m_processingCounter, 1 );
+		Locker< Statistics, SpinLock >::Handle handle( m_statistics );
+		++handle->completedRequestCount;
+		if( bMerged )
+		{
+			++handle->mergedRequestCount;
+		}
 
-		Request* pRequest;
+		if( IsValid( bytesRead ) )
 		{
-			Locker< DynamicArray< Request* >, SpinLock >::Handle handle ( m_requestQueue );
-			pRequest = handle->IsEmpty() ? NULL : handle->Pop();
+			handle->bytesRead += bytesRead;
 		}
-		if( !pRequest )
+
+		if( pRequest->compression != Compression::TYPE_NONE )
 		{
-			// Queue is empty, so sleep until notified.
-			AtomicExchangeRelease( m_processingCounter, 0 );
-			m_wakeUpCondition.Wait();
+			++handle->decompressedRequestCount;
+			handle->compressedBytesRead += pRequest->storedSize;
+			handle->decompressionTicks += decompressionTicks;
+		}
 
-			continue;
+		handle->totalLatencyTicks += latencyTicks;
+		if( latencyTicks > handle->maxLatencyTicks )
+		{
+			handle->maxLatencyTicks = latencyTicks;
 		}
+	}
 
-		HELIUM_ASSERT( pRequest );
+	pRequest->bytesRead = bytesRead;
+	AtomicExchangeRelease( pRequest->processedCounter, 1 );
+
+	AtomicIncrementRelease( m_completedRequestCounter );
+	AtomicDecrementRelease( m_pendingRequestCount );
+}
+
+/// Get an open handle for reading from the given file, reusing a cached handle if one is available.
+///
+/// @param[in]  rFileName  File to open.
+/// @param[out] rHandle    Open file handle.  This must be returned by calling ReleaseFile().
+///
+/// @return  True if the file is open, false if it could not be opened.
+///
+/// @see ReleaseFile()
+bool AsyncLoader::AcquireFile( const String& rFileName, FileHandle& rHandle )
+{
+	{
+		MutexScopeLock scopeLock( m_fileLock );
 
-		FileStream* pFileStream = FileStream::OpenFileStream( pRequest->fileName, FileStream::MODE_READ );
-		if( !pFileStream )
+		size_t fileCount = m_files.GetSize();
+		for( size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex )
 		{
-			SetInvalid( pRequest->bytesRead );
+			CachedFile& rCachedFile = m_files[ fileIndex ];
+			if( ( g_ShareOpenFiles || rCachedFile.useCount == 0 ) && rCachedFile.fileName == rFileName )
+			{
+				++rCachedFile.useCount;
+				rHandle = rCachedFile.handle;
+
+				Locker< Statistics, SpinLock >::Handle handle( m_statistics );
+				++handle->fileStreamCacheHitCount;
+
+				return true;
+			}
 		}
-		else
-		{
-			pRequest->bytesRead = 0;
+	}
 
-			pBufferedStream->Open( pFileStream );
-			int64_t offset = pBufferedStream->Seek( pRequest->offset, SeekOrigins::Begin );
-			if( static_cast< uint64_t >( offset ) == pRequest->offset )
+	{
+		Locker< Statistics, SpinLock >::Handle handle( m_statistics );
+		++handle->fileStreamCacheMissCount;
+	}
+
+	// Open the file outside the lock so other workers aren't held up.
+	if( !OpenFile( rFileName, rHandle ) )
+	{
+		return false;
+	}
+
+	MutexScopeLock scopeLock( m_fileLock );
+
+	CachedFile* pCachedFile = NULL;
+	if( m_files.GetSize() < FILE_STREAM_LIMIT )
+	{
+		pCachedFile = m_files.New();
+		HELIUM_ASSERT( pCachedFile );
+	}
+	else
+	{
+		// Close the least recently used file that isn't being read from.
+		size_t fileCount = m_files.GetSize();
+		for( size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex )
+		{
+			CachedFile& rCachedFile = m_files[ fileIndex ];
+			if( rCachedFile.useCount == 0 && ( !pCachedFile || rCachedFile.lastUse < pCachedFile->lastUse ) )
 			{
-				pRequest->bytesRead = pBufferedStream->Read( pRequest->pBuffer, 1, pRequest->size );
+				pCachedFile = &rCachedFile;
 			}
+		}
+
+		// If every cached file is in use, the new handle will simply be closed once it is released.
+		if( !pCachedFile )
+		{
+			return true;
+		}
+
+		CloseFile( pCachedFile->handle );
+	}
 
-			pBufferedStream->Open( NULL );
+	pCachedFile->fileName = rFileName;
+	pCachedFile->handle = rHandle;
+	pCachedFile->lastUse = 0;
+	pCachedFile->useCount = 1;
 
-			delete pFileStream;
+	return true;
+}
+
+/// Return a file handle acquired with AcquireFile() to the cache.
+///
+/// @param[in] handle  Handle to release.
+///
+/// @see AcquireFile()
+void AsyncLoader::ReleaseFile( FileHandle handle )
+{
+	MutexScopeLock scopeLock( m_fileLock );
+
+	size_t fileCount = m_files.GetSize();
+	for( size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex )
+	{
+		CachedFile& rCachedFile = m_files[ fileIndex ];
+		if( rCachedFile.handle == handle )
+		{
+			HELIUM_ASSERT( rCachedFile.useCount != 0 );
+			--rCachedFile.useCount;
+			rCachedFile.lastUse = ++m_fileUseCounter;
+
+			return;
 		}
+	}
 
-		AtomicExchangeRelease( pRequest->processedCounter, 1 );
+	// Handle was never cached.
+	CloseFile( handle );
+}
 
-		Thread::Yield();
+/// Close all cached files.
+///
+/// This must only be called while no requests are being serviced.
+void AsyncLoader::CloseFiles()
+{
+	MutexScopeLock scopeLock( m_fileLock );
+
+	size_t fileCount = m_files.GetSize();
+	for( size_t fileIndex = 0; fileIndex < fileCount; ++fileIndex )
+	{
+		HELIUM_ASSERT( m_files[ fileIndex ].useCount == 0 );
+		CloseFile( m_files[ fileIndex ].handle );
 	}
 
-	AtomicExchangeRelease( m_processingCounter, 0 );
+	m_files.Clear();
+}
 
-	delete pBufferedStream;
+/// Open a file for reading.
+///
+/// @param[in]  rFileName  File to open.
+/// @param[out] rHandle    Open file handle.
+///
+/// @return  True if the file was opened, false if not.
+bool AsyncLoader::OpenFile( const String& rFileName, FileHandle& rHandle )
+{
+#if HELIUM_OS_LINUX
+	int fileDescriptor;
+	do
+	{
+		fileDescriptor = open( rFileName.GetData(), O_RDONLY | O_CLOEXEC );
+	} while( fileDescriptor < 0 && errno == EINTR );
+
+	if( fileDescriptor < 0 )
+	{
+		return false;
+	}
+
+	// Cache files are mostly read front to back, so let the kernel read ahead aggressively.
+	posix_fadvise( fileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL );
+
+	rHandle = fileDescriptor;
+#else
+	rHandle = FileStream::OpenFileStream( rFileName, FileStream::MODE_READ );
+	if( !rHandle )
+	{
+		return false;
+	}
+#endif
+
+	return true;
 }
 
-/// Request the load worker to stop processing and return at the next possible opportunity.
-void AsyncLoader::LoadWorker::Stop()
+/// Close a file opened with OpenFile().
+///
+/// @param[in] handle  Handle to close.
+void AsyncLoader::CloseFile( FileHandle handle )
 {
-	AtomicExchangeRelease( m_stopCounter, 1 );
-	m_wakeUpCondition.Signal();
+#if HELIUM_OS_LINUX
+	close( handle );
+#else
+	delete handle;
+#endif
 }
 
-/// Queue an async load request.
+/// Read from a file at a given offset.
 ///
-/// @param[in] pRequest  Request to queue.  Note that the @c processedCounter value should be set to 0 prior to
-///                      calling this function (the worker thread will set it to 1 once the request has been
-///                      processed).
+/// @param[in] handle   Open file handle.
+/// @param[in] offset   Offset from which to begin reading.
+/// @param[in] pBuffer  Buffer in which to store the data read.
+/// @param[in] size     Number of bytes to read.
 ///
-/// @see Flush()
-void AsyncLoader::LoadWorker::QueueRequest( Request* pRequest )
+/// @return  Number of bytes read, which will only be less than the requested size if the end of the file was reached
+///          or an error occurred.
+size_t AsyncLoader::ReadFile( FileHandle handle, uint64_t offset, void* pBuffer, size_t size )
 {
-	HELIUM_ASSERT( pRequest );
-	HELIUM_ASSERT( pRequest->processedCounter == 0 );
+#if HELIUM_OS_LINUX
+	// pread() does not touch the descriptor's file position, so no locking is needed for concurrent reads.
+	uint8_t* pBytes = static_cast< uint8_t* >( pBuffer );
+	size_t bytesRead = 0;
+	while( bytesRead < size )
+	{
+		ssize_t result = pread( handle, pBytes + bytesRead, size - bytesRead, static_cast< off_t >( offset + bytesRead ) );
+		if( result < 0 )
+		{
+			if( errno == EINTR )
+			{
+				continue;
+			}
 
-	// Prevent access to the load queue while an exclusive write lock is held.
-	ScopeReadLock nonExclusiveLock( m_writeLock );
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"AsyncLoader: Read of %" PRIuSZ " bytes at offset %" PRIu64 " failed (errno %d).\n",
+				size,
+				offset,
+				errno );
 
+			break;
+		}
+
+		if( result == 0 )
+		{
+			break;
+		}
+
+		bytesRead += static_cast< size_t >( result );
+	}
+
+	return bytesRead;
+#else
+	int64_t seekOffset = handle->Seek( static_cast< int64_t >( offset ), SeekOrigins::Begin );
+	if( static_cast< uint64_t >( seekOffset ) != offset )
 	{
-		Locker< DynamicArray< Request* >, SpinLock >::Handle handle ( m_requestQueue );
-		handle->Push( pRequest );
+		return 0;
 	}
 
-	m_wakeUpCondition.Signal();
+	return handle->Read( pBuffer, 1, size );
+#endif
 }
 
-/// Block the current thread until all pending load requests have completed.
-///
-/// @see QueueRequest()
-void AsyncLoader::LoadWorker::Flush()
+/// Constructor.
+AsyncLoader::Statistics::Statistics()
+	: maxQueueDepth( 0 )
+	, completedRequestCount( 0 )
+	, mergedRequestCount( 0 )
+	, bytesRead( 0 )
+	, decompressedRequestCount( 0 )
+	, compressedBytesRead( 0 )
+	, decompressionTicks( 0 )
+	, fileStreamCacheHitCount( 0 )
+	, fileStreamCacheMissCount( 0 )
+	, totalLatencyTicks( 0 )
+	, maxLatencyTicks( 0 )
 {
-	bool isEmpty;
+	for( size_t priority = PRIORITY_FIRST; priority < PRIORITY_MAX; ++priority )
 	{
-		Locker< DynamicArray< Request* >, SpinLock >::Handle handle ( m_requestQueue );
-		isEmpty = handle->IsEmpty();
+		queueDepth[ priority ] = 0;
 	}
+}
 
-	while( m_processingCounter != 0 && !isEmpty )
+/// Constructor.
+AsyncLoader::RequestQueue::RequestQueue()
+	: count( 0 )
+	, maxCount( 0 )
+{
+	for( size_t priority = PRIORITY_FIRST; priority < PRIORITY_MAX; ++priority )
 	{
-		Thread::Yield();
+		headIndices[ priority ] = 0;
 	}
 }
 
-/// Acquire an exclusive lock for writing to files and flush the async loader queue.
+/// Constructor.
 ///
-/// @see Unlock()
-void AsyncLoader::LoadWorker::Lock()
+/// @param[in] pLoader  Owning loader.
+AsyncLoader::LoadWorker::LoadWorker( AsyncLoader* pLoader )
+	: m_pLoader( pLoader )
+	, m_wakeUpCondition( false, false )
+	, m_stopCounter( 0 )
 {
-	// Prevent other threads from queueing requests or writing out data while we have a write lock.
-	m_writeLock.LockWrite();
+	HELIUM_ASSERT( pLoader );
+}
 
-	Flush();
+/// Destructor.
+AsyncLoader::LoadWorker::~LoadWorker()
+{
 }
 
-/// Release an exclusive lock for writing to files.
+/// Execute the async loading work.
+void AsyncLoader::LoadWorker::Run()
+{
+	while( m_stopCounter == 0 )
+	{
+		if( !m_pLoader->PopRequests( m_batch ) )
+		{
+			// Queue is empty, so sleep until notified.
+			m_wakeUpCondition.Wait();
+
+			continue;
+		}
+
+		ProcessBatch();
+	}
+}
+
+/// Request the load worker to stop processing and return at the next possible opportunity.
+void AsyncLoader::LoadWorker::Stop()
+{
+	AtomicExchangeRelease( m_stopCounter, 1 );
+	m_wakeUpCondition.Signal();
+}
+
+/// Wake up the worker thread if it is waiting for requests.
+void AsyncLoader::LoadWorker::WakeUp()
+{
+	m_wakeUpCondition.Signal();
+}
+
+/// Service the requests taken from the queue by the last call to PopRequests().
+void AsyncLoader::LoadWorker::ProcessBatch()
+{
+	size_t requestCount = m_batch.GetSize();
+	HELIUM_ASSERT( requestCount != 0 );
+
+	Request* pFirstRequest = m_batch[ 0 ];
+	Request* pLastRequest = m_batch[ requestCount - 1 ];
+	bool bMerged = ( requestCount > 1 );
+
+	FileHandle fileHandle;
+	if( !m_pLoader->AcquireFile( pFirstRequest->fileName, fileHandle ) )
+	{
+		for( size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex )
+		{
+			m_pLoader->CompleteRequest( m_batch[ requestIndex ], Invalid< size_t >(), bMerged );
+		}
+
+		return;
+	}
+
+	// A single uncompressed request is read straight into its own buffer, while merged and compressed requests are
+	// read into the scratch buffer first.
+	bool bDirect = ( !bMerged && pFirstRequest->compression == Compression::TYPE_NONE );
+
+	size_t bytesRead;
+	if( bDirect )
+	{
+		bytesRead = ReadFile( fileHandle, pFirstRequest->offset, pFirstRequest->pBuffer, pFirstRequest->size );
+	}
+	else
+	{
+		size_t totalSize = static_cast< size_t >(
+			pLastRequest->offset + pLastRequest->storedSize - pFirstRequest->offset );
+		m_mergeBuffer.Resize( totalSize );
+		bytesRead = ReadFile( fileHandle, pFirstRequest->offset, m_mergeBuffer.GetData(), totalSize );
+	}
+
+	m_pLoader->ReleaseFile( fileHandle );
+
+	if( bDirect )
+	{
+		m_pLoader->CompleteRequest( pFirstRequest, bytesRead, false );
+
+		return;
+	}
+
+	for( size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex )
+	{
+		Request* pRequest = m_batch[ requestIndex ];
+
+		size_t requestOffset = static_cast< size_t >( pRequest->offset - pFirstRequest->offset );
+		size_t bytesAvailable = ( bytesRead > requestOffset ? bytesRead - requestOffset : 0 );
+
+		uint64_t decompressionTicks = 0;
+		size_t requestBytesRead = FinishRequest(
+			pRequest,
+			m_mergeBuffer.GetData() + requestOffset,
+			bytesAvailable,
+			decompressionTicks );
+
+		m_pLoader->CompleteRequest( pRequest, requestBytesRead, bMerged, decompressionTicks );
+	}
+}
+
+/// Copy or decompress the data read for a request from the scratch buffer into the request buffer.
 ///
-/// @see Lock()
-void AsyncLoader::LoadWorker::Unlock()
+/// @param[in]  pRequest             Request being serviced.
+/// @param[in]  pData                Start of the data read for the request.
+/// @param[in]  bytesAvailable       Number of bytes read from the start of the request (may exceed the request size if
+///                                  the read was shared with other requests).
+/// @param[out] rDecompressionTicks  Time spent decompressing the data, in ticks.
+///
+/// @return  Number of bytes stored in the request buffer.
+size_t AsyncLoader::LoadWorker::FinishRequest(
+	Request* pRequest,
+	const uint8_t* pData,
+	size_t bytesAvailable,
+	uint64_t& rDecompressionTicks )
 {
-	m_writeLock.UnlockWrite();
+	HELIUM_ASSERT( pRequest );
+
+	rDecompressionTicks = 0;
+
+	if( pRequest->compression == Compression::TYPE_NONE )
+	{
+		size_t copySize = Min( bytesAvailable, pRequest->size );
+		MemoryCopy( pRequest->pBuffer, pData, copySize );
+
+		return copySize;
+	}
+
+	// A compressed block can't be decompressed at all unless it was read in full.
+	if( bytesAvailable < pRequest->storedSize )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"AsyncLoader: Only %" PRIuSZ " of %" PRIuSZ " compressed bytes could be read from \"%s\".\n",
+			bytesAvailable,
+			pRequest->storedSize,
+			*pRequest->fileName );
+
+		return 0;
+	}
+
+	uint64_t startTicks = Timer::GetTickCount();
+	size_t bytesDecompressed = Compression::Decompress(
+		pRequest->compression,
+		pData,
+		pRequest->storedSize,
+		pRequest->pBuffer,
+		pRequest->size );
+	rDecompressionTicks = Timer::GetTickCount() - startTicks;
+
+	if( IsInvalid( bytesDecompressed ) )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"AsyncLoader: Failed to decompress %" PRIuSZ " bytes at offset %" PRIu64 " of \"%s\".\n",
+			pRequest->storedSize,
+			pRequest->offset,
+			*pRequest->fileName );
+
+		return 0;
+	}
+
+	return bytesDecompressed;
 }
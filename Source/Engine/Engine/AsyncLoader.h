@@ -9,10 +9,21 @@
 #include "Foundation/String.h"
 
 #include "Engine/Engine.h"
+#include "Engine/Compression.h"
 
 namespace Helium
 {
+	class FileStream;
+
 	/// Async loading manager.
+	///
+	/// Requests are serviced by a set of worker threads in priority order (first-in, first-out within each priority).
+	/// File streams are kept open between requests, and requests for adjacent ranges of the same file that are
+	/// waiting in the queue together are serviced with a single read.  Compressed data is decompressed by the worker
+	/// that read it, so the thread waiting on the request only ever sees the decompressed result.
+	///
+	/// On Linux, files are read with pread() straight into the request buffers.  Positional reads let every worker
+	/// share the same descriptor, so more workers are started by default to keep more requests in flight.
 	class HELIUM_ENGINE_API AsyncLoader : NonCopyable
 	{
 	public:
@@ -20,6 +31,15 @@ namespace Helium
 		static const size_t REQUEST_POOL_BLOCK_SIZE = 128;
 		/// Maximum number of open file streams.
 		static const size_t FILE_STREAM_LIMIT = 16;
+#if HELIUM_OS_LINUX
+		/// Default number of worker threads.
+		static const uint32_t DEFAULT_WORKER_COUNT = 8;
+#else
+		/// Default number of worker threads.
+		static const uint32_t DEFAULT_WORKER_COUNT = 2;
+#endif
+		/// Maximum combined size of adjacent requests that will be merged into a single read.
+		static const size_t MERGE_SIZE_LIMIT = 256 * 1024;
 
 		/// Load request priority.
 		enum EPriority
@@ -35,9 +55,47 @@ namespace Helium
 			PRIORITY_LAST = PRIORITY_MAX - 1
 		};
 
+		/// Load statistics.
+		struct Statistics
+		{
+			/// Number of requests waiting in the queue for each priority.
+			uint32_t queueDepth[ PRIORITY_MAX ];
+			/// Highest total number of requests waiting in the queue.
+			uint32_t maxQueueDepth;
+
+			/// Number of requests completed.
+			uint32_t completedRequestCount;
+			/// Number of requests serviced by a read merged with an adjacent request.
+			uint32_t mergedRequestCount;
+			/// Number of bytes read.
+			uint64_t bytesRead;
+
+			/// Number of requests for compressed data.
+			uint32_t decompressedRequestCount;
+			/// Number of compressed bytes read for those requests.
+			uint64_t compressedBytesRead;
+			/// Total time spent decompressing data, in ticks.
+			uint64_t decompressionTicks;
+
+			/// Number of reads that found their file already open.
+			uint32_t fileStreamCacheHitCount;
+			/// Number of reads that had to open their file.
+			uint32_t fileStreamCacheMissCount;
+
+			/// Sum of the time between queueing and completion of each request, in ticks.
+			uint64_t totalLatencyTicks;
+			/// Longest time between queueing and completion of a request, in ticks.
+			uint64_t maxLatencyTicks;
+
+			/// @name Construction/Destruction
+			//@{
+			Statistics();
+			//@}
+		};
+
 		/// @name Initialization
 		//@{
-		bool Initialize();
+		bool Initialize( uint32_t workerCount = DEFAULT_WORKER_COUNT );
 		void Cleanup();
 		//@}
 
@@ -46,6 +104,9 @@ namespace Helium
 		size_t QueueRequest(
 			void* pBuffer, const String& rFileName, uint64_t offset, size_t size,
 			EPriority priority = PRIORITY_NORMAL );
+		size_t QueueCompressedRequest(
+			void* pBuffer, const String& rFileName, uint64_t offset, size_t storedSize,
+			Compression::EType compression, size_t size, EPriority priority = PRIORITY_NORMAL );
 		size_t SyncRequest( size_t id );
 		bool TrySyncRequest( size_t id, size_t& rBytesRead );
 
@@ -55,6 +116,15 @@ namespace Helium
 		void Unlock();
 		//@}
 
+		/// @name Statistics
+		//@{
+		void GetStatistics( Statistics& rStatistics );
+		void ResetStatistics();
+
+		inline uint32_t GetWorkerCount() const;
+		inline uint32_t GetCompletedRequestCounter() const;
+		//@}
+
 		/// @name Static Access
 		//@{
 		static AsyncLoader* GetInstance();
@@ -63,6 +133,14 @@ namespace Helium
 		//@}
 
 	private:
+#if HELIUM_OS_LINUX
+		/// Open file handle (read with pread(), so it can be used by several workers at once).
+		typedef int FileHandle;
+#else
+		/// Open file handle.
+		typedef FileStream* FileHandle;
+#endif
+
 		/// Async load request data.
 		struct Request
 		{
@@ -72,24 +150,62 @@ namespace Helium
 			String fileName;
 			/// Offset from which to begin reading.
 			uint64_t offset;
-			/// Number of bytes to read.
+			/// Number of bytes to read from the file.
+			size_t storedSize;
+			/// Format in which the data is stored in the file.
+			Compression::EType compression;
+			/// Number of bytes to store in the output buffer (after decompression).
 			size_t size;
 			/// Priority.
 			EPriority priority;
 
+			/// Tick count at which the request was queued.
+			uint64_t queueTicks;
+
 			/// Number of bytes read.
 			volatile size_t bytesRead;
 			/// Set to a non-zero value once this request has been processed.
 			volatile int32_t processedCounter;
 		};
 
+		/// Requests waiting to be processed.
+		struct RequestQueue
+		{
+			/// Queued requests for each priority (only entries at or after the corresponding head index are valid).
+			DynamicArray< Request* > requests[ PRIORITY_MAX ];
+			/// Index of the oldest request for each priority.
+			size_t headIndices[ PRIORITY_MAX ];
+			/// Total number of queued requests.
+			size_t count;
+			/// Highest number of queued requests since the statistics were last reset.
+			size_t maxCount;
+
+			/// @name Construction/Destruction
+			//@{
+			RequestQueue();
+			//@}
+		};
+
+		/// Open file cache entry.
+		struct CachedFile
+		{
+			/// File name.
+			String fileName;
+			/// Open file handle.
+			FileHandle handle;
+			/// Value of the use counter when this file was last released, used to pick files to close.
+			uint32_t lastUse;
+			/// Number of workers currently reading from this file.
+			uint32_t useCount;
+		};
+
 		/// Async loading thread runnable.
 		class LoadWorker : public Runnable
 		{
 		public:
 			/// @name Construction/Destruction
 			//@{
-			LoadWorker();
+			LoadWorker( AsyncLoader* pLoader );
 			virtual ~LoadWorker();
 			//@}
 
@@ -101,39 +217,57 @@ namespace Helium
 			/// @name External Thread Control
 			//@{
 			void Stop();
-			//@}
-
-			/// @name External Request Queue Control
-			//@{
-			void QueueRequest( Request* pRequest );
-			void Flush();
-
-			void Lock();
-			void Unlock();
+			void WakeUp();
 			//@}
 
 		private:
-			/// Async load request queue.
-			Locker< DynamicArray< Request* >, SpinLock > m_requestQueue;
+			/// Owning loader.
+			AsyncLoader* m_pLoader;
 			/// Condition used to wake up the worker thread when load requests are queued (or when it should shut down).
 			Condition m_wakeUpCondition;
 
-			/// Read-write lock used for synchronization of external file writes.
-			ReadWriteLock m_writeLock;
+			/// Requests being serviced by the current read.
+			DynamicArray< Request* > m_batch;
+			/// Scratch buffer for merged and compressed reads.
+			DynamicArray< uint8_t > m_mergeBuffer;
 
 			/// Non-zero if this thread should stop when next possible, zero if it should continue.
 			volatile int32_t m_stopCounter;
-			/// Non-zero if this thread is currently processing a load request.
-			volatile int32_t m_processingCounter;
+
+			/// @name Private Utility Functions
+			//@{
+			void ProcessBatch();
+			size_t FinishRequest(
+				Request* pRequest, const uint8_t* pData, size_t bytesAvailable, uint64_t& rDecompressionTicks );
+			//@}
 		};
 
 		/// Pool of async load request objects.
 		ObjectPool< Request > m_requestPool;
 
-		/// Async loading thread.
-		RunnableThread* m_pThread;
-		/// Async loading thread worker.
-		LoadWorker* m_pWorker;
+		/// Async loading threads.
+		DynamicArray< RunnableThread* > m_threads;
+		/// Async loading thread workers.
+		DynamicArray< LoadWorker* > m_workers;
+
+		/// Async load request queue.
+		Locker< RequestQueue, SpinLock > m_requestQueue;
+		/// Number of requests queued or in progress.
+		volatile int32_t m_pendingRequestCount;
+		/// Counter incremented each time a request completes.
+		volatile int32_t m_completedRequestCounter;
+		/// Read-write lock used for synchronization of external file writes.
+		ReadWriteLock m_writeLock;
+
+		/// Open files.
+		DynamicArray< CachedFile > m_files;
+		/// Counter incremented each time a file is released.
+		uint32_t m_fileUseCounter;
+		/// Mutex protecting the open file cache.
+		Mutex m_fileLock;
+
+		/// Load statistics.
+		Locker< Statistics, SpinLock > m_statistics;
 
 		/// Singleton instance.
 		static AsyncLoader* sm_pInstance;
@@ -143,5 +277,21 @@ namespace Helium
 		AsyncLoader();
 		~AsyncLoader();
 		//@}
+
+		/// @name Private Utility Functions
+		//@{
+		bool PopRequests( DynamicArray< Request* >& rBatch );
+		void CompleteRequest( Request* pRequest, size_t bytesRead, bool bMerged, uint64_t decompressionTicks = 0 );
+
+		bool AcquireFile( const String& rFileName, FileHandle& rHandle );
+		void ReleaseFile( FileHandle handle );
+		void CloseFiles();
+
+		static bool OpenFile( const String& rFileName, FileHandle& rHandle );
+		static void CloseFile( FileHandle handle );
+		static size_t ReadFile( FileHandle handle, uint64_t offset, void* pBuffer, size_t size );
+		//@}
 	};
 }
+
+#include "Engine/AsyncLoader.inl"
@@ -0,0 +1,18 @@
+/// Get the number of worker threads servicing load requests.
+///
+/// @return  Worker thread count.
+uint32_t Helium::AsyncLoader::GetWorkerCount() const
+{
+    return static_cast< uint32_t >( m_workers.GetSize() );
+}
+
+/// Get a counter that is incremented each time a load request completes.
+///
+/// This can be compared against a previously sampled value to cheaply detect whether any requests have completed in
+/// the meantime.  The counter may wrap around.
+///
+/// @return  Request completion counter.
+uint32_t Helium::AsyncLoader::GetCompletedRequestCounter() const
+{
+    return static_cast< uint32_t >( m_completedRequestCounter );
+}
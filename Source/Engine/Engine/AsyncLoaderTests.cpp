@@ -0,0 +1,290 @@
+#include "Engine/AsyncLoader.h"
+
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+#include "Foundation/FileStream.h"
+#include "Foundation/Stream.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Name of the scratch file read by the tests.
+	const char TEST_FILE_NAME[] = "AsyncLoaderTests.tmp";
+	/// Size of the scratch file, in bytes.
+	const size_t TEST_FILE_SIZE = 32 * 1024 * 1024;
+	/// Name of the cache-sized file read by the benchmark.
+	const char BENCHMARK_FILE_NAME[] = "AsyncLoaderBenchmark.tmp";
+	/// Size of the benchmark file, in bytes (on the order of a real cache file).
+	const size_t BENCHMARK_FILE_SIZE = 256 * 1024 * 1024;
+	/// Size of each benchmark request, in bytes.
+	const size_t BENCHMARK_REQUEST_SIZE = 16 * 1024;
+	/// Number of requests queued by each benchmark run.
+	const size_t BENCHMARK_REQUEST_COUNT = 4096;
+	/// Number of times the adjacent request test is repeated while waiting for the requests to be merged.
+	const size_t MERGE_ATTEMPT_COUNT = 8;
+
+	/// Byte expected at the given offset of the scratch file.
+	uint8_t GetTestFileByte( uint64_t offset )
+	{
+		return static_cast< uint8_t >( ( offset * 2654435761ULL ) >> 13 );
+	}
+
+	/// Fill a file with the bytes given by GetTestFileByte().
+	void WriteTestFile( const char* pFileName, size_t size )
+	{
+		FILE* pFile = fopen( pFileName, "wb" );
+		ASSERT_TRUE( pFile != NULL );
+
+		DynamicArray< uint8_t > block;
+		block.Resize( 64 * 1024 );
+		for( uint64_t blockOffset = 0; blockOffset < size; blockOffset += block.GetSize() )
+		{
+			for( size_t byteIndex = 0; byteIndex < block.GetSize(); ++byteIndex )
+			{
+				block[ byteIndex ] = GetTestFileByte( blockOffset + byteIndex );
+			}
+
+			ASSERT_EQ( block.GetSize(), fwrite( block.GetData(), 1, block.GetSize(), pFile ) );
+		}
+
+		fclose( pFile );
+	}
+
+	/// Offset of a benchmark request.  Requests stride through the file so that consecutive requests are never
+	/// adjacent and cannot be merged.
+	uint64_t GetScatteredOffset( size_t requestIndex, size_t fileSize )
+	{
+		size_t slotCount = fileSize / BENCHMARK_REQUEST_SIZE;
+
+		return static_cast< uint64_t >( ( requestIndex * 977 ) % slotCount ) * BENCHMARK_REQUEST_SIZE;
+	}
+
+	/// Check the data read by a benchmark run.
+	void CheckScatteredData( const DynamicArray< uint8_t >& rBuffer, size_t fileSize )
+	{
+		for( size_t requestIndex = 0; requestIndex < BENCHMARK_REQUEST_COUNT; ++requestIndex )
+		{
+			uint64_t offset = GetScatteredOffset( requestIndex, fileSize );
+			const uint8_t* pData = rBuffer.GetData() + requestIndex * BENCHMARK_REQUEST_SIZE;
+			for( size_t byteIndex = 0; byteIndex < BENCHMARK_REQUEST_SIZE; byteIndex += 1021 )
+			{
+				if( pData[ byteIndex ] != GetTestFileByte( offset + byteIndex ) )
+				{
+					ADD_FAILURE() << "Wrong data at offset " << offset + byteIndex;
+
+					return;
+				}
+			}
+		}
+	}
+
+	/// Read the benchmark requests one at a time the way the loader did before it kept files open, opening a
+	/// FileStream for each request and reading it through a BufferedStream.
+	///
+	/// @return  Time taken to read all requests, in ticks.
+	uint64_t ReadScatteredFromFileStream( DynamicArray< uint8_t >& rBuffer, const String& rFileName, size_t fileSize )
+	{
+		rBuffer.Resize( BENCHMARK_REQUEST_COUNT * BENCHMARK_REQUEST_SIZE );
+
+		BufferedStream bufferedStream;
+		uint64_t startTicks = Timer::GetTickCount();
+		for( size_t requestIndex = 0; requestIndex < BENCHMARK_REQUEST_COUNT; ++requestIndex )
+		{
+			FileStream* pFileStream = FileStream::OpenFileStream( rFileName, FileStream::MODE_READ );
+			if( !pFileStream )
+			{
+				ADD_FAILURE() << "Failed to open " << *rFileName;
+
+				return 0;
+			}
+
+			uint64_t offset = GetScatteredOffset( requestIndex, fileSize );
+			bufferedStream.Open( pFileStream );
+			EXPECT_EQ( static_cast< int64_t >( offset ), bufferedStream.Seek( offset, SeekOrigins::Begin ) );
+			EXPECT_EQ(
+				BENCHMARK_REQUEST_SIZE,
+				bufferedStream.Read( rBuffer.GetData() + requestIndex * BENCHMARK_REQUEST_SIZE, 1, BENCHMARK_REQUEST_SIZE ) );
+			bufferedStream.Open( NULL );
+
+			delete pFileStream;
+		}
+
+		uint64_t ticks = Timer::GetTickCount() - startTicks;
+		CheckScatteredData( rBuffer, fileSize );
+
+		return ticks;
+	}
+
+	class AsyncLoaderTest : public testing::Test
+	{
+	protected:
+		String m_fileName;
+
+		AsyncLoaderTest()
+			: m_fileName( TEST_FILE_NAME )
+		{
+		}
+
+		void SetUp()
+		{
+			WriteTestFile( TEST_FILE_NAME, TEST_FILE_SIZE );
+
+			AsyncLoader::Startup();
+			ASSERT_TRUE( AsyncLoader::GetInstance() != NULL );
+		}
+
+		void TearDown()
+		{
+			AsyncLoader::Shutdown();
+			remove( TEST_FILE_NAME );
+		}
+
+		/// Queue scattered reads over a whole test file, wait for them all, and check their contents.
+		///
+		/// @return  Time taken to service all requests, in ticks.
+		uint64_t ReadScattered( DynamicArray< uint8_t >& rBuffer, const String& rFileName, size_t fileSize )
+		{
+			AsyncLoader* pLoader = AsyncLoader::GetInstance();
+			HELIUM_ASSERT( pLoader );
+
+			rBuffer.Resize( BENCHMARK_REQUEST_COUNT * BENCHMARK_REQUEST_SIZE );
+
+			DynamicArray< size_t > requestIds;
+			requestIds.Reserve( BENCHMARK_REQUEST_COUNT );
+
+			uint64_t startTicks = Timer::GetTickCount();
+			for( size_t requestIndex = 0; requestIndex < BENCHMARK_REQUEST_COUNT; ++requestIndex )
+			{
+				requestIds.Push( pLoader->QueueRequest(
+					rBuffer.GetData() + requestIndex * BENCHMARK_REQUEST_SIZE,
+					rFileName,
+					GetScatteredOffset( requestIndex, fileSize ),
+					BENCHMARK_REQUEST_SIZE ) );
+			}
+
+			for( size_t requestIndex = 0; requestIndex < BENCHMARK_REQUEST_COUNT; ++requestIndex )
+			{
+				EXPECT_EQ( BENCHMARK_REQUEST_SIZE, pLoader->SyncRequest( requestIds[ requestIndex ] ) );
+			}
+
+			uint64_t ticks = Timer::GetTickCount() - startTicks;
+			CheckScatteredData( rBuffer, fileSize );
+
+			return ticks;
+		}
+	};
+}
+
+TEST_F( AsyncLoaderTest, ReadsRequestedRanges )
+{
+	AsyncLoader* pLoader = AsyncLoader::GetInstance();
+
+	uint8_t buffer[ 256 ];
+	size_t id = pLoader->QueueRequest( buffer, m_fileName, 12345, sizeof( buffer ) );
+	ASSERT_EQ( sizeof( buffer ), pLoader->SyncRequest( id ) );
+	for( size_t byteIndex = 0; byteIndex < sizeof( buffer ); ++byteIndex )
+	{
+		EXPECT_EQ( GetTestFileByte( 12345 + byteIndex ), buffer[ byteIndex ] );
+	}
+
+	// Reads past the end of the file are clipped.
+	id = pLoader->QueueRequest( buffer, m_fileName, TEST_FILE_SIZE - 100, sizeof( buffer ) );
+	EXPECT_EQ( 100u, pLoader->SyncRequest( id ) );
+
+	// Reads from files that do not exist fail.
+	id = pLoader->QueueRequest( buffer, String( "AsyncLoaderTests.missing" ), 0, sizeof( buffer ) );
+	EXPECT_TRUE( IsInvalid( pLoader->SyncRequest( id ) ) );
+}
+
+TEST_F( AsyncLoaderTest, ReadsAdjacentRequests )
+{
+	AsyncLoader* pLoader = AsyncLoader::GetInstance();
+
+	// Keep a single worker busy with a large read so that the adjacent requests queued behind it are serviced
+	// together.  The worker could in principle finish the large read before all of them are queued, so the test is
+	// repeated until the statistics show a merged read.
+	HELIUM_VERIFY( pLoader->Initialize( 1 ) );
+
+	DynamicArray< uint8_t > largeBuffer;
+	largeBuffer.Resize( TEST_FILE_SIZE / 2 );
+
+	AsyncLoader::Statistics statistics;
+	for( size_t attemptIndex = 0; attemptIndex < MERGE_ATTEMPT_COUNT; ++attemptIndex )
+	{
+		pLoader->ResetStatistics();
+
+		size_t largeId = pLoader->QueueRequest(
+			largeBuffer.GetData(),
+			m_fileName,
+			TEST_FILE_SIZE / 2,
+			largeBuffer.GetSize() );
+
+		uint8_t buffers[ 8 ][ 1024 ];
+		size_t ids[ 8 ];
+		for( size_t requestIndex = 0; requestIndex < 8; ++requestIndex )
+		{
+			ids[ requestIndex ] = pLoader->QueueRequest( buffers[ requestIndex ], m_fileName, requestIndex * 1024, 1024 );
+		}
+
+		// Each request gets its own data back whether or not it was merged.
+		EXPECT_EQ( largeBuffer.GetSize(), pLoader->SyncRequest( largeId ) );
+		for( size_t requestIndex = 0; requestIndex < 8; ++requestIndex )
+		{
+			ASSERT_EQ( 1024u, pLoader->SyncRequest( ids[ requestIndex ] ) );
+			for( size_t byteIndex = 0; byteIndex < 1024; ++byteIndex )
+			{
+				ASSERT_EQ( GetTestFileByte( requestIndex * 1024 + byteIndex ), buffers[ requestIndex ][ byteIndex ] );
+			}
+		}
+
+		pLoader->GetStatistics( statistics );
+		ASSERT_EQ( 9u, statistics.completedRequestCount );
+		if( statistics.mergedRequestCount != 0 )
+		{
+			break;
+		}
+	}
+
+	// Only the small requests are adjacent, so at least two of them shared a read and the large one never did.
+	EXPECT_GE( statistics.mergedRequestCount, 2u );
+	EXPECT_LE( statistics.mergedRequestCount, 8u );
+}
+
+TEST_F( AsyncLoaderTest, BenchmarkScatteredReads )
+{
+	AsyncLoader* pLoader = AsyncLoader::GetInstance();
+	DynamicArray< uint8_t > buffer;
+
+	WriteTestFile( BENCHMARK_FILE_NAME, BENCHMARK_FILE_SIZE );
+	String fileName( BENCHMARK_FILE_NAME );
+
+	// Warm the page cache so that every run measures request servicing rather than the disk.
+	ReadScattered( buffer, fileName, BENCHMARK_FILE_SIZE );
+
+	uint64_t fileStreamTicks = ReadScatteredFromFileStream( buffer, fileName, BENCHMARK_FILE_SIZE );
+
+	HELIUM_VERIFY( pLoader->Initialize( 1 ) );
+	uint64_t singleWorkerTicks = ReadScattered( buffer, fileName, BENCHMARK_FILE_SIZE );
+
+	HELIUM_VERIFY( pLoader->Initialize( AsyncLoader::DEFAULT_WORKER_COUNT ) );
+	uint64_t defaultWorkerTicks = ReadScattered( buffer, fileName, BENCHMARK_FILE_SIZE );
+
+	// Drop the loader's open handle before deleting the file.
+	pLoader->Cleanup();
+	remove( BENCHMARK_FILE_NAME );
+
+	printf(
+		"%u x %u-byte reads from a %u MiB file: FileStream/BufferedStream %.3f ms, 1 worker %.3f ms, %u workers %.3f ms\n",
+		static_cast< uint32_t >( BENCHMARK_REQUEST_COUNT ),
+		static_cast< uint32_t >( BENCHMARK_REQUEST_SIZE ),
+		static_cast< uint32_t >( BENCHMARK_FILE_SIZE / ( 1024 * 1024 ) ),
+		Timer::TicksToMilliseconds( fileStreamTicks ),
+		Timer::TicksToMilliseconds( singleWorkerTicks ),
+		AsyncLoader::DEFAULT_WORKER_COUNT,
+		Timer::TicksToMilliseconds( defaultWorkerTicks ) );
+}
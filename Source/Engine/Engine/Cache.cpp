@@ -8,6 +8,21 @@
 #include "Engine/Asset.h"
 #include "Engine/FileLocations.h"
 #include "Engine/AsyncLoader.h"
+#include "Engine/LoadTrace.h"
+#include "Engine/StableHash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if HELIUM_OS_WIN
+#include "Platform/SystemWin.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define USE_BSON_FOR_CACHE_FORMAT 0
 #define USE_JSON_FOR_CACHE_FORMAT 1
@@ -32,8 +47,184 @@ using namespace Helium;
 static const uint32_t TOC_MAGIC = 0xcac4e70c;
 /// TOC header magic number (byte-swapped).
 static const uint32_t TOC_MAGIC_SWAPPED = 0x0ce7c4ca;
+/// TOC journal record magic number.
+static const uint32_t TOC_JOURNAL_MAGIC = 0x70c1a9e5;
+/// Version number of the original TOC format (a flat list of variable-length entries).
+static const uint32_t TOC_VERSION_LEGACY = 0;
+/// Alignment of the sections and journal records within the TOC file.
+static const size_t TOC_ALIGNMENT = 8;
 /// Cache format version number.
-const uint32_t Cache::sm_Version = 0;
+const uint32_t Cache::sm_Version = 3;
+
+/// TOC file header.
+struct TocHeader
+{
+	/// TOC magic number.
+	uint32_t magic;
+	/// Cache format version number.
+	uint32_t version;
+	/// Number of records in the sorted table.
+	uint32_t recordCount;
+	/// Size of the path string pool, in bytes.
+	uint32_t stringPoolSize;
+};
+
+/// Sorted TOC table record.
+struct Cache::TocRecord
+{
+	/// Hash of the entry path string.
+	uint64_t pathHash;
+	/// Entry offset.
+	uint64_t offset;
+	/// Entry timestamp.
+	int64_t timestamp;
+	/// Entry content hash.
+	uint64_t contentHash;
+	/// Offset of the null-terminated entry path string within the string pool.
+	uint32_t pathOffset;
+	/// Length of the entry path string, not including the null terminator.
+	uint32_t pathSize;
+	/// Sub-data index.
+	uint32_t subDataIndex;
+	/// Entry size (after decompression).
+	uint32_t size;
+	/// Number of bytes occupied by the entry in the cache file.
+	uint32_t storedSize;
+	/// Entry compression format.
+	uint32_t compression;
+};
+
+/// TOC journal record header (followed by the null-terminated entry path string, padded to the TOC alignment).
+struct TocJournalRecord
+{
+	/// Journal record magic number.
+	uint32_t magic;
+	/// Length of the entry path string, not including the null terminator.
+	uint32_t pathSize;
+	/// Sub-data index.
+	uint32_t subDataIndex;
+	/// Entry size (after decompression).
+	uint32_t size;
+	/// Entry offset.
+	uint64_t offset;
+	/// Entry timestamp.
+	int64_t timestamp;
+	/// Entry content hash.
+	uint64_t contentHash;
+	/// Number of bytes occupied by the entry in the cache file.
+	uint32_t storedSize;
+	/// Entry compression format.
+	uint32_t compression;
+};
+
+/// Round an offset within the TOC file up to the TOC alignment.
+///
+/// @param[in] offset  Offset to align.
+///
+/// @return  Aligned offset.
+static size_t AlignTocOffset( size_t offset )
+{
+	return ( offset + TOC_ALIGNMENT - 1 ) & ~( TOC_ALIGNMENT - 1 );
+}
+
+/// Sort comparison function for TOC table records.
+///
+/// @param[in] rRecord0  First record.
+/// @param[in] rRecord1  Second record.
+///
+/// @return  True if the first record should be sorted before the second, false if not.
+template< typename T >
+static bool TocRecordLess( const T& rRecord0, const T& rRecord1 )
+{
+	return ( rRecord0.pathHash < rRecord1.pathHash ||
+		( rRecord0.pathHash == rRecord1.pathHash && rRecord0.subDataIndex < rRecord1.subDataIndex ) );
+}
+
+/// Sort comparison function for ordering cache entries by their location in the cache file.
+///
+/// @param[in] pEntry0  First entry.
+/// @param[in] pEntry1  Second entry.
+///
+/// @return  True if the first entry is stored before the second, false if not.
+static bool EntryOffsetLess( const Cache::Entry* pEntry0, const Cache::Entry* pEntry1 )
+{
+	return ( pEntry0->offset < pEntry1->offset );
+}
+
+/// Mark a cache entry as read while simulating a load trace.
+///
+/// @param[in]     pEntry        Entry being read.
+/// @param[in,out] rReadEntries  Set of entries already read.
+///
+/// @return  True if the entry was not read before, false if it was.
+static bool MarkReplayRead( const Cache::Entry* pEntry, HashMap< const Cache::Entry*, bool >& rReadEntries )
+{
+	HashMap< const Cache::Entry*, bool >::Iterator readIterator;
+
+	return rReadEntries.Insert( readIterator, HashMap< const Cache::Entry*, bool >::ValueType( pEntry, true ) );
+}
+
+/// Tally the reads issued for a group of requests queued together while replaying a load trace.
+///
+/// Requests are merged in the same way as by the AsyncLoader: starting with the oldest request, any queued request
+/// that begins where the read currently ends is pulled into the same read, up to AsyncLoader::MERGE_SIZE_LIMIT bytes.
+///
+/// @param[in]     ppEntries     Entries requested, in the order in which the requests were queued.
+/// @param[in]     entryCount    Number of entries requested.
+/// @param[in,out] rPosition     Offset at which the previous read ended.
+/// @param[in,out] rStatistics   Replay statistics to update.
+static void ReplayReadGroup(
+	const Cache::Entry* const* ppEntries,
+	size_t entryCount,
+	uint64_t& rPosition,
+	Cache::ReplayStatistics& rStatistics )
+{
+	DynamicArray< const Cache::Entry* > queue;
+	queue.Reserve( entryCount );
+	for( size_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+	{
+		queue.Push( ppEntries[ entryIndex ] );
+	}
+
+	while( !queue.IsEmpty() )
+	{
+		const Cache::Entry* pFirstEntry = queue[ 0 ];
+		queue.Remove( 0 );
+
+		uint64_t endOffset = pFirstEntry->offset + pFirstEntry->storedSize;
+		size_t readSize = pFirstEntry->storedSize;
+		bool bFound = ( readSize < AsyncLoader::MERGE_SIZE_LIMIT );
+		while( bFound )
+		{
+			bFound = false;
+
+			size_t queueSize = queue.GetSize();
+			for( size_t queueIndex = 0; queueIndex < queueSize; ++queueIndex )
+			{
+				const Cache::Entry* pCandidate = queue[ queueIndex ];
+				if( pCandidate->offset == endOffset &&
+					readSize + pCandidate->storedSize <= AsyncLoader::MERGE_SIZE_LIMIT )
+				{
+					queue.Remove( queueIndex );
+					endOffset += pCandidate->storedSize;
+					readSize += pCandidate->storedSize;
+					bFound = true;
+
+					break;
+				}
+			}
+		}
+
+		++rStatistics.readCount;
+		if( pFirstEntry->offset != rPosition )
+		{
+			++rStatistics.seekCount;
+		}
+
+		rStatistics.bytesRead += readSize;
+		rPosition = endOffset;
+	}
+}
 
 /// Constructor.
 Cache::Cache()
@@ -44,6 +235,13 @@ Cache::Cache()
 , m_pTocBuffer( NULL )
 , m_tocSize( Invalid< uint32_t >() )
 , m_pEntryPool( NULL )
+, m_pTocRecords( NULL )
+, m_tocRecordCount( 0 )
+, m_pTocStringPool( NULL )
+, m_tocStringPoolSize( 0 )
+, m_bAllTocEntriesLoaded( true )
+, m_tocJournalRecordCount( Invalid< uint32_t >() )
+, m_bMemoryMapped( false )
 {
 }
 
@@ -64,11 +262,18 @@ Cache::~Cache()
 /// @param[in] platform        Cache platform identifier.
 /// @param[in] pTocFileName    FilePath name of the table of contents file.
 /// @param[in] pCacheFileName  FilePath name of the cache file.
+/// @param[in] bMemoryMapped   True to access the TOC and cache files through memory mappings instead of reading
+///                            them through the AsyncLoader.
 ///
 /// @return  True if initialization was successful, false if not.
 ///
 /// @see Shutdown(), BeginLoadToc()
-bool Cache::Initialize( Name name, EPlatform platform, const char* pTocFileName, const char* pCacheFileName )
+bool Cache::Initialize(
+	Name name,
+	EPlatform platform,
+	const char* pTocFileName,
+	const char* pCacheFileName,
+	bool bMemoryMapped )
 {
 	HELIUM_ASSERT( !name.IsEmpty() );
 	HELIUM_ASSERT( static_cast< size_t >( platform ) < static_cast< size_t >( PLATFORM_MAX ) );
@@ -98,6 +303,8 @@ bool Cache::Initialize( Name name, EPlatform platform, const char* pTocFileName,
 
 	m_tocSize = static_cast< uint32_t >( tocSize64 );
 
+	m_bMemoryMapped = bMemoryMapped;
+
 	HELIUM_ASSERT( !m_pEntryPool );
 	m_pEntryPool = new ObjectPool< Entry >( ENTRY_POOL_BLOCK_SIZE );
 	HELIUM_ASSERT( m_pEntryPool );
@@ -125,6 +332,10 @@ void Cache::Shutdown()
 		SetInvalid( m_asyncLoadId );
 	}
 
+	ReleaseTocTable();
+	m_bAllTocEntriesLoaded = true;
+	SetInvalid( m_tocJournalRecordCount );
+
 	DefaultAllocator().Free( m_pTocBuffer );
 	m_pTocBuffer = NULL;
 	SetInvalid( m_tocSize );
@@ -136,6 +347,18 @@ void Cache::Shutdown()
 
 	delete m_pEntryPool;
 	m_pEntryPool = NULL;
+
+	UnmapFile( m_cacheMapping );
+
+	size_t retiredMappingCount = m_retiredCacheMappings.GetSize();
+	for( size_t mappingIndex = 0; mappingIndex < retiredMappingCount; ++mappingIndex )
+	{
+		UnmapFile( m_retiredCacheMappings[ mappingIndex ] );
+	}
+
+	m_retiredCacheMappings.Clear();
+
+	m_bMemoryMapped = false;
 }
 
 /// Begin asynchronous loading of the cache table of contents.
@@ -175,6 +398,39 @@ bool Cache::BeginLoadToc()
 	}
 
 	HELIUM_ASSERT( !m_pTocBuffer );
+
+	if( m_bMemoryMapped )
+	{
+		// Parse the TOC straight out of the file mapping.  This completes synchronously, so there is no async load to
+		// wait on.
+		MappedFile tocMapping;
+		if( MapFile( m_tocFileName, tocMapping ) )
+		{
+			m_pTocBuffer = tocMapping.pData;
+			ProcessLoadedToc( static_cast< size_t >( tocMapping.size ) );
+			m_pTocBuffer = NULL;
+
+			// Keep the mapping if the sorted table is being searched in place.
+			if( m_pTocRecords )
+			{
+				m_tocMapping = tocMapping;
+			}
+			else
+			{
+				UnmapFile( tocMapping );
+			}
+
+			m_bTocLoaded = true;
+
+			return true;
+		}
+
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"Cache::BeginLoadToc(): Failed to map TOC file \"%s\".  Falling back to an async load.\n",
+			*m_tocFileName );
+	}
+
 	DefaultAllocator allocator;
 	m_pTocBuffer = static_cast< uint8_t* >( allocator.Allocate( m_tocSize ) );
 	HELIUM_ASSERT( m_pTocBuffer );
@@ -247,36 +503,13 @@ bool Cache::TryFinishLoadToc()
 	}
 	else
 	{
-		if( m_tocSize != bytesRead )
-		{
-			HELIUM_TRACE(
-				TraceLevels::Warning,
-				"Cache::TryFinishLoadToc(): TOC file \"%s\" size (%" PRIu32 ") does not match the number of bytes read (%" PRIuSZ ").\n",
-				m_tocSize,
-				bytesRead );
-
-			m_tocSize = static_cast< uint32_t >( bytesRead );
-		}
-
-		bool bFinalizeResult = FinalizeTocLoad();
-
-		DefaultAllocator().Free( m_pTocBuffer );
-		m_pTocBuffer = NULL;
+		ProcessLoadedToc( bytesRead );
 
-		if( !bFinalizeResult )
+		// Keep the buffer if the sorted table is being searched in place.
+		if( !m_pTocRecords )
 		{
-			HELIUM_ASSERT( m_pEntryPool );
-
-			size_t entryCount = m_entries.GetSize();
-			for( size_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
-			{
-				Entry* pEntry = m_entries[ entryIndex ];
-				HELIUM_ASSERT( pEntry );
-				m_pEntryPool->Release( pEntry );
-			}
-
-			m_entries.Clear();
-			m_entryMap.Clear();
+			DefaultAllocator().Free( m_pTocBuffer );
+			m_pTocBuffer = NULL;
 		}
 	}
 
@@ -296,7 +529,7 @@ void Cache::EnforceTocLoad()
 
 		if( BeginLoadToc() )
 		{
-			while( !TryFinishLoadToc() )
+			while( !IsTocLoaded() && !TryFinishLoadToc() )
 			{
 				Thread::Yield();
 			}
@@ -319,7 +552,8 @@ const Cache::Entry* Cache::FindEntry( AssetPath path, uint32_t subDataIndex ) co
 	EntryMapType::ConstAccessor mapAccessor;
 	if( !m_entryMap.Find( mapAccessor, key ) )
 	{
-		return NULL;
+		// Entries are only created from the TOC table once they are first requested.
+		return ( m_bAllTocEntriesLoaded ? NULL : LoadTocEntry( key ) );
 	}
 
 	Entry* pEntry = mapAccessor->Second();
@@ -328,13 +562,36 @@ const Cache::Entry* Cache::FindEntry( AssetPath path, uint32_t subDataIndex ) co
 	return pEntry;
 }
 
+/// Create entries for all records in the TOC table and release the table.
+///
+/// Once this has been called, entries are no longer created lazily on lookup, so the entry list remains stable while
+/// the cache is only read (cache updates still add entries).  Tools should call this on the thread that owns the cache
+/// before looking up or updating entries from multiple threads.
+void Cache::LoadAllEntries()
+{
+	if( !m_bAllTocEntriesLoaded )
+	{
+		LoadAllTocEntries();
+	}
+
+	MutexScopeLock scopeLock( m_entryLock );
+	ReleaseTocTable();
+}
+
 /// Add or update an entry in the cache.
 ///
+/// Updated entries normally reuse their existing space in the cache file if the new data fits.  When memory mapping is
+/// enabled, they are always appended instead, as views of the old data returned by GetEntryData() remain in use.
+///
 /// @param[in] path          Asset path.
 /// @param[in] subDataIndex  Sub-data index associated with the cached data.
 /// @param[in] pData         Data to cache.
 /// @param[in] timestamp     Timestamp value to associate with the entry in the cache.
 /// @param[in] size          Number of bytes to cache.
+/// @param[in] contentHash   Hash of the inputs from which the data was built, used by tools to determine whether the
+///                          entry is up-to-date (zero if unknown).
+/// @param[in] compression   Format in which to store the data.  The data is stored uncompressed instead if compressing
+///                          it does not reduce its size.
 ///
 /// @return  True if the cache was updated successfully, false if not.
 bool Cache::CacheEntry(
@@ -342,64 +599,114 @@ bool Cache::CacheEntry(
 					   uint32_t subDataIndex,
 					   const void* pData,
 					   int64_t timestamp,
-					   uint32_t size )
+					   uint32_t size,
+					   uint64_t contentHash,
+					   Compression::EType compression )
 {
 	HELIUM_ASSERT( pData || size == 0 );
 
+	// Compress the data before taking the update lock so that entries cached from multiple threads are compressed in
+	// parallel.
+	DynamicArray< uint8_t > compressedData;
+	if( compression != Compression::TYPE_NONE && !Compression::Compress( compression, pData, size, compressedData ) )
+	{
+		compression = Compression::TYPE_NONE;
+	}
+
+	const void* pStoredData = pData;
+	uint32_t storedSize = size;
+	if( compression != Compression::TYPE_NONE )
+	{
+		pStoredData = compressedData.GetData();
+		storedSize = static_cast< uint32_t >( compressedData.GetSize() );
+	}
+
+	// Entries may be cached from multiple threads during batch preprocessing.
+	MutexScopeLock updateLock( m_updateLock );
+
 	Status status;
 	status.Read( m_cacheFileName.GetData() );
 	int64_t cacheFileSize = status.m_Size;
 	uint64_t entryOffset = ( cacheFileSize == -1 ? 0 : static_cast< uint64_t >( cacheFileSize ) );
 
-	HELIUM_ASSERT( m_pEntryPool );
-	Entry* pEntryUpdate = m_pEntryPool->Allocate();
-	HELIUM_ASSERT( pEntryUpdate );
-	pEntryUpdate->offset = entryOffset;
-	pEntryUpdate->timestamp = timestamp;
-	pEntryUpdate->path = path;
-	pEntryUpdate->subDataIndex = subDataIndex;
-	pEntryUpdate->size = size;
-
 	uint64_t originalOffset = 0;
 	int64_t originalTimestamp = 0;
+	uint64_t originalContentHash = 0;
 	uint32_t originalSize = 0;
+	uint32_t originalStoredSize = 0;
+	Compression::EType originalCompression = Compression::TYPE_NONE;
 
 	EntryKey key;
 	key.path = path;
 	key.subDataIndex = subDataIndex;
 
-	EntryMapType::Accessor entryAccessor;
-	bool bNewEntry = m_entryMap.Insert( entryAccessor, KeyValue< EntryKey, Entry* >( key, pEntryUpdate ) );
-	if( bNewEntry )
+	// Make sure an existing entry still only in the TOC table is updated rather than duplicated.
+	if( !m_bAllTocEntriesLoaded )
 	{
-		HELIUM_TRACE( TraceLevels::Info, "Cache: Adding \"%s\" to cache \"%s\".\n", *path.ToString(), *m_cacheFileName );
-
-		m_entries.Push( pEntryUpdate );
+		LoadTocEntry( key );
 	}
-	else
-	{
-		HELIUM_TRACE( TraceLevels::Info, "Cache: Updating \"%s\" in cache \"%s\".\n", *path.ToString(), *m_cacheFileName );
 
-		m_pEntryPool->Release( pEntryUpdate );
+	Entry* pEntryUpdate;
+	bool bNewEntry;
+	{
+		// Entries may be looked up and created from the TOC table by other threads at the same time (see
+		// LoadTocEntry()), so the entry list and pool are only changed with the entry lock held.
+		MutexScopeLock entryLock( m_entryLock );
 
-		pEntryUpdate = entryAccessor->Second();
+		HELIUM_ASSERT( m_pEntryPool );
+		pEntryUpdate = m_pEntryPool->Allocate();
 		HELIUM_ASSERT( pEntryUpdate );
+		pEntryUpdate->offset = entryOffset;
+		pEntryUpdate->timestamp = timestamp;
+		pEntryUpdate->contentHash = contentHash;
+		pEntryUpdate->path = path;
+		pEntryUpdate->subDataIndex = subDataIndex;
+		pEntryUpdate->size = size;
+		pEntryUpdate->storedSize = storedSize;
+		pEntryUpdate->compression = compression;
 
-		originalOffset = pEntryUpdate->offset;
-		originalTimestamp = pEntryUpdate->timestamp;
-		originalSize = pEntryUpdate->size;
-
-		if( originalSize < size )
+		EntryMapType::Accessor entryAccessor;
+		bNewEntry = m_entryMap.Insert( entryAccessor, KeyValue< EntryKey, Entry* >( key, pEntryUpdate ) );
+		if( bNewEntry )
 		{
-			pEntryUpdate->offset = entryOffset;
+			HELIUM_TRACE( TraceLevels::Info, "Cache: Adding \"%s\" to cache \"%s\".\n", *path.ToString(), *m_cacheFileName );
+
+			m_entries.Push( pEntryUpdate );
 		}
 		else
 		{
-			entryOffset = originalOffset;
-		}
+			HELIUM_TRACE( TraceLevels::Info, "Cache: Updating \"%s\" in cache \"%s\".\n", *path.ToString(), *m_cacheFileName );
 
-		pEntryUpdate->timestamp = timestamp;
-		pEntryUpdate->size = size;
+			m_pEntryPool->Release( pEntryUpdate );
+
+			pEntryUpdate = entryAccessor->Second();
+			HELIUM_ASSERT( pEntryUpdate );
+
+			originalOffset = pEntryUpdate->offset;
+			originalTimestamp = pEntryUpdate->timestamp;
+			originalContentHash = pEntryUpdate->contentHash;
+			originalSize = pEntryUpdate->size;
+			originalStoredSize = pEntryUpdate->storedSize;
+			originalCompression = pEntryUpdate->compression;
+
+			// Data views returned by GetEntryData() must stay valid until shutdown, and pages of a copy-on-write mapping
+			// that have not been touched still follow changes to the file, so mapped caches never overwrite entry data
+			// in place.
+			if( m_bMemoryMapped || originalStoredSize < storedSize )
+			{
+				pEntryUpdate->offset = entryOffset;
+			}
+			else
+			{
+				entryOffset = originalOffset;
+			}
+
+			pEntryUpdate->timestamp = timestamp;
+			pEntryUpdate->contentHash = contentHash;
+			pEntryUpdate->size = size;
+			pEntryUpdate->storedSize = storedSize;
+			pEntryUpdate->compression = compression;
+		}
 	}
 
 	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
@@ -407,23 +714,23 @@ bool Cache::CacheEntry(
 
 	pAsyncLoader->Lock();
 
-	bool bCacheSuccess = true;
+	bool bCacheSuccess = false;
 
 	FileStream* pCacheStream = FileStream::OpenFileStream( m_cacheFileName, FileStream::MODE_WRITE, false );
 	if( !pCacheStream )
 	{
 		HELIUM_TRACE( TraceLevels::Error, "Cache: Failed to open cache \"%s\" for writing.\n", *m_cacheFileName );
-
-		bCacheSuccess = false;
 	}
 	else
 	{
 		HELIUM_TRACE(
 			TraceLevels::Info,
-			"Cache: Caching \"%s\" to \"%s\" (%" PRIu32 " bytes @ offset %" PRIu64 ").\n",
+			"Cache: Caching \"%s\" to \"%s\" (%" PRIu32 " bytes stored as %" PRIu32 " bytes (%s) @ offset %" PRIu64 ").\n",
 			*path.ToString(),
 			*m_cacheFileName,
 			size,
+			storedSize,
+			Compression::GetTypeName( compression ),
 			entryOffset );
 
 		uint64_t seekOffset = static_cast< uint64_t >( pCacheStream->Seek(
@@ -432,97 +739,71 @@ bool Cache::CacheEntry(
 		if( seekOffset != entryOffset )
 		{
 			HELIUM_TRACE( TraceLevels::Error, "Cache: Cache file offset seek failed.\n" );
-
-			if( bNewEntry )
-			{
-				m_entries.Pop();
-				m_entryMap.Remove( entryAccessor );
-				m_pEntryPool->Release( pEntryUpdate );
-			}
-			else
-			{
-				pEntryUpdate->offset = originalOffset;
-				pEntryUpdate->timestamp = originalTimestamp;
-				pEntryUpdate->size = originalSize;
-			}
-
-			bCacheSuccess = false;
 		}
 		else
 		{
-			size_t writeSize = pCacheStream->Write( pData, 1, size );
-			if( writeSize != size )
+			size_t writeSize = pCacheStream->Write( pStoredData, 1, storedSize );
+			if( writeSize != storedSize )
 			{
 				HELIUM_TRACE(
 					TraceLevels::Error,
 					"Cache: Failed to write %" PRIu32 " bytes to cache \"%s\" (%" PRIuSZ " bytes written).\n",
-					size,
+					storedSize,
 					*m_cacheFileName,
 					writeSize );
-
-				if( bNewEntry )
-				{
-					m_entries.Pop();
-					m_entryMap.Remove( entryAccessor );
-					m_pEntryPool->Release( pEntryUpdate );
-				}
-				else
-				{
-					pEntryUpdate->offset = originalOffset;
-					pEntryUpdate->timestamp = originalTimestamp;
-					pEntryUpdate->size = originalSize;
-				}
-
-				bCacheSuccess = false;
 			}
 			else
 			{
-				HELIUM_TRACE( TraceLevels::Info, "Cache: Rewriting TOC file \"%s\".\n", *m_tocFileName );
-
-				FileStream* pTocStream = FileStream::OpenFileStream( m_tocFileName, FileStream::MODE_WRITE, true );
-				if( !pTocStream )
-				{
-					HELIUM_TRACE( TraceLevels::Error, "Cache: Failed to open TOC \"%s\" for writing.\n", *m_tocFileName );
-				}
-				else
-				{
-					BufferedStream* pBufferedStream = new BufferedStream( pTocStream );
-					HELIUM_ASSERT( pBufferedStream );
-
-					pBufferedStream->Write( &TOC_MAGIC, sizeof( TOC_MAGIC ), 1 );
-					pBufferedStream->Write( &sm_Version, sizeof( sm_Version ), 1 );
-
-					uint32_t entryCount = static_cast< uint32_t >( m_entries.GetSize() );
-					pBufferedStream->Write( &entryCount, sizeof( entryCount ), 1 );
-
-					String entryPath;
-					uint_fast32_t entryCountFast = entryCount;
-					for( uint_fast32_t entryIndex = 0; entryIndex < entryCountFast; ++entryIndex )
-					{
-						Entry* pEntry = m_entries[ entryIndex ];
-						HELIUM_ASSERT( pEntry );
-
-						pEntry->path.ToString( entryPath );
-						HELIUM_ASSERT( entryPath.GetSize() < UINT16_MAX );
-						uint16_t pathSize = static_cast< uint16_t >( entryPath.GetSize() );
-						pBufferedStream->Write( &pathSize, sizeof( pathSize ), 1 );
-
-						pBufferedStream->Write( *entryPath, sizeof( char ), pathSize );
+				bCacheSuccess = true;
+			}
+		}
 
-						pBufferedStream->Write( &pEntry->subDataIndex, sizeof( pEntry->subDataIndex ), 1 );
+		delete pCacheStream;
+	}
 
-						pBufferedStream->Write( &pEntry->offset, sizeof( pEntry->offset ), 1 );
-						pBufferedStream->Write( &pEntry->timestamp, sizeof( pEntry->timestamp ), 1 );
-						pBufferedStream->Write( &pEntry->size, sizeof( pEntry->size ), 1 );
-					}
+	if( bCacheSuccess )
+	{
+		// Append the entry to the TOC journal, only rewriting the full TOC once the journal has grown too large.
+		size_t entryCount = Max< size_t >( m_entries.GetSize(), m_tocRecordCount );
+		uint32_t journalLimit = Max( TOC_JOURNAL_LIMIT_MIN, static_cast< uint32_t >( entryCount / 8 ) );
+		if( IsInvalid( m_tocJournalRecordCount ) ||
+			m_tocJournalRecordCount >= journalLimit ||
+			!AppendTocJournal( *pEntryUpdate ) )
+		{
+			WriteToc();
+		}
+	}
+	else
+	{
+		MutexScopeLock entryLock( m_entryLock );
 
-					delete pBufferedStream;
-					delete pTocStream;
-				}
+		if( bNewEntry )
+		{
+			EntryMapType::Accessor entryAccessor;
+			HELIUM_VERIFY( m_entryMap.Find( entryAccessor, key ) );
+			m_entryMap.Remove( entryAccessor );
+			entryAccessor.Release();
+
+			// Other threads may have created entries from the TOC table since, so this isn't necessarily the last one.
+			size_t entryIndex = m_entries.GetSize();
+			while( entryIndex != 0 && m_entries[ entryIndex - 1 ] != pEntryUpdate )
+			{
+				--entryIndex;
 			}
-		}
 
-		delete pCacheStream;
+			HELIUM_ASSERT( entryIndex != 0 );
+			m_entries.Remove( entryIndex - 1 );
+			m_pEntryPool->Release( pEntryUpdate );
+		}
+		else
+		{
+			pEntryUpdate->offset = originalOffset;
+			pEntryUpdate->timestamp = originalTimestamp;
+			pEntryUpdate->contentHash = originalContentHash;
+			pEntryUpdate->size = originalSize;
+			pEntryUpdate->storedSize = originalStoredSize;
+			pEntryUpdate->compression = originalCompression;
+		}
 	}
 
 	pAsyncLoader->Unlock();
@@ -530,202 +811,1423 @@ bool Cache::CacheEntry(
 	return bCacheSuccess;
 }
 
-/// Finalize the TOC loading process.
+/// Queue an async load request for the data of a cache entry.
 ///
-/// Note that this does not free any resources on a failed load (the caller is responsible for such clean-up work).
+/// Compressed entries are decompressed by the AsyncLoader worker that reads them, so the data is ready to use as soon
+/// as the request completes.
 ///
-/// @return  True if the TOC load was successful, false if not.
-bool Cache::FinalizeTocLoad()
+/// @param[in] rEntry   Cache entry.
+/// @param[in] pBuffer  Buffer in which to load the entry data.
+/// @param[in] size     Number of bytes to load.  This may be less than the entry size, in which case only the start of
+///                     the entry data is loaded.
+///
+/// @return  AsyncLoader ID of the load request if queued successfully, invalid index if not.
+///
+/// @see ReadEntryData()
+size_t Cache::QueueEntryLoad( const Entry& rEntry, void* pBuffer, size_t size ) const
 {
-	HELIUM_ASSERT( m_pTocBuffer );
+	HELIUM_ASSERT( size <= rEntry.size );
 
-	const uint8_t* pTocCurrent = m_pTocBuffer;
-	const uint8_t* pTocMax = pTocCurrent + m_tocSize;
-
-	StackMemoryHeap<>& rStackHeap = ThreadLocalStackAllocator::GetMemoryHeap();
+	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+	HELIUM_ASSERT( pAsyncLoader );
 
-	// Validate the TOC header.
-	uint32_t magic;
-	if( !CheckedTocRead( MemoryCopy, magic, "the header magic", pTocCurrent, pTocMax ) )
+	if( rEntry.compression == Compression::TYPE_NONE )
 	{
-		return false;
+		return pAsyncLoader->QueueRequest( pBuffer, m_cacheFileName, rEntry.offset, size );
 	}
 
-	LOAD_VALUE_CALLBACK* pLoadFunction = NULL;
-	if( magic == TOC_MAGIC )
-	{
-		HELIUM_TRACE(
-			TraceLevels::Info,
-			"Cache::FinalizeTocLoad(): TOC \"%s\" identified (no byte swapping).\n",
-			*m_tocFileName );
+	return pAsyncLoader->QueueCompressedRequest(
+		pBuffer,
+		m_cacheFileName,
+		rEntry.offset,
+		rEntry.storedSize,
+		rEntry.compression,
+		size );
+}
 
-		pLoadFunction = MemoryCopy;
-	}
-	else if( magic == TOC_MAGIC_SWAPPED )
-	{
-		HELIUM_TRACE(
-			TraceLevels::Info,
-			"Cache::FinalizeTocLoad(): TOC \"%s\" identified (byte swapping is necessary).\n",
-			*m_tocFileName );
-		HELIUM_TRACE(
-			TraceLevels::Warning,
-			"Cache::TryFinishLoadToc(): Cache for TOC \"%s\" uses byte swapping, which may incur performance penalties.\n",
-			*m_tocFileName );
+/// Synchronously read and decompress the data of a cache entry.
+///
+/// @param[in]  rEntry        Cache entry.
+/// @param[in]  pCacheStream  Stream from which to read the entry (opened on the cache file).
+/// @param[out] rData         Entry data.
+///
+/// @return  True if the entry data was read successfully, false if not.
+///
+/// @see QueueEntryLoad()
+bool Cache::ReadEntryData( const Entry& rEntry, FileStream* pCacheStream, DynamicArray< uint8_t >& rData ) const
+{
+	HELIUM_ASSERT( pCacheStream );
 
-		pLoadFunction = ReverseByteOrder;
-	}
-	else
-	{
-		HELIUM_TRACE(
-			TraceLevels::Error,
-			"Cache::FinalizeTocLoad(): TOC \"%s\" has invalid file magic.\n",
-			*m_tocFileName );
+	rData.Resize( rEntry.size );
 
+	if( static_cast< uint64_t >( pCacheStream->Seek(
+		static_cast< int64_t >( rEntry.offset ),
+		SeekOrigins::Begin ) ) != rEntry.offset )
+	{
 		return false;
 	}
 
-	uint32_t version;
-	if( !CheckedTocRead( pLoadFunction, version, "the cache version number", pTocCurrent, pTocMax ) )
+	if( rEntry.compression == Compression::TYPE_NONE )
 	{
-		return false;
+		return ( pCacheStream->Read( rData.GetData(), 1, rEntry.size ) == rEntry.size );
 	}
 
-	if( version > sm_Version )
+	DynamicArray< uint8_t > storedData;
+	storedData.Resize( rEntry.storedSize );
+	if( pCacheStream->Read( storedData.GetData(), 1, rEntry.storedSize ) != rEntry.storedSize )
 	{
-		HELIUM_TRACE(
-			TraceLevels::Error,
-			"Cache::FinalizeTocLoad(): Cache version number (%" PRIu32 ") exceeds the maximum supported version (%" PRIu32 ").\n",
-			version,
-			sm_Version );
-
 		return false;
 	}
 
-	// Read the numbers of entries in the cache.
-	uint32_t entryCount;
-	bool bReadResult = CheckedTocRead(
-		pLoadFunction,
-		entryCount,
-		"the number of entries in the cache",
-		pTocCurrent,
-		pTocMax );
-	if( !bReadResult )
+	size_t bytesDecompressed = Compression::Decompress(
+		rEntry.compression,
+		storedData.GetData(),
+		storedData.GetSize(),
+		rData.GetData(),
+		rData.GetSize() );
+
+	return ( bytesDecompressed == rEntry.size );
+}
+
+/// Get a view of the data for a cache entry within the memory mapped cache file.
+///
+/// The returned pointer remains valid until the cache is shut down.  Note that the data is mapped copy-on-write, so
+/// it may be modified in place by the caller without affecting the cache file or other views.
+///
+/// @param[in]  rEntry  Cache entry.
+/// @param[out] rpData  Pointer to the start of the entry data.
+///
+/// @return  True if the entry data is available in memory, false if memory mapping is disabled, the entry is
+///          compressed, or the cache file could not be mapped (in which case the data must be loaded through the
+///          AsyncLoader).
+bool Cache::GetEntryData( const Entry& rEntry, const uint8_t*& rpData )
+{
+	if( !m_bMemoryMapped || rEntry.compression != Compression::TYPE_NONE )
 	{
 		return false;
 	}
 
-	// Load the entry information.
-	EntryKey key;
+	MutexScopeLock scopeLock( m_mappingLock );
 
-	uint_fast32_t entryCountFast = entryCount;
+	uint64_t entryEnd = rEntry.offset + rEntry.storedSize;
+	if( entryEnd > m_cacheMapping.size )
+	{
+		// The cache file may have grown since it was mapped.  Existing views may still reference the old mapping, so it
+		// is retired rather than unmapped.
+		MappedFile cacheMapping;
+		if( !MapFile( m_cacheFileName, cacheMapping ) )
+		{
+			return false;
+		}
+
+		if( cacheMapping.size <= m_cacheMapping.size )
+		{
+			UnmapFile( cacheMapping );
+
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"Cache::GetEntryData(): Entry for \"%s\" lies outside the bounds of cache file \"%s\".\n",
+				*rEntry.path.ToString(),
+				*m_cacheFileName );
+
+			return false;
+		}
+
+		if( m_cacheMapping.pData )
+		{
+			m_retiredCacheMappings.Push( m_cacheMapping );
+		}
+
+		m_cacheMapping = cacheMapping;
+
+		if( entryEnd > m_cacheMapping.size )
+		{
+			return false;
+		}
+	}
+
+	rpData = m_cacheMapping.pData + rEntry.offset;
+
+	return true;
+}
+
+/// Measure how well the current layout of this cache suits a recorded load.
+///
+/// The reads that the CachePackageLoader and resources would issue in order to load the entries requested from this
+/// cache in the given trace are simulated (including dependency manifest prefetching and the merging of adjacent
+/// reads by the AsyncLoader), and the resulting reads are tallied.  As the simulation does not depend on timing, the
+/// results are repeatable, allowing the effect of OptimizeLayout() to be measured by replaying the same trace before
+/// and after.
+///
+/// @param[in]  rTrace       Load trace to replay.  Requests for entries in other caches are ignored.
+/// @param[out] rStatistics  Replay results.
+///
+/// @return  True if the trace was replayed successfully, false if the cache file could not be opened.
+///
+/// @see OptimizeLayout()
+bool Cache::ReplayLoadTrace( const LoadTrace& rTrace, ReplayStatistics& rStatistics ) const
+{
+	rStatistics = ReplayStatistics();
+
+	FileStream* pCacheStream = FileStream::OpenFileStream( m_cacheFileName, FileStream::MODE_READ );
+	if( !pCacheStream )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"Cache::ReplayLoadTrace(): Failed to open cache \"%s\" for reading.\n",
+			*m_cacheFileName );
+
+		return false;
+	}
+
+	DynamicArray< const Entry* > reads;
+	DynamicArray< ReplayBatch > batches;
+	SimulateLoadTrace( rTrace, pCacheStream, NULL, reads, batches );
+
+	delete pCacheStream;
+
+	size_t recordCount = rTrace.GetRecordCount();
+	for( size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex )
+	{
+		if( rTrace.GetRecord( recordIndex ).cacheName == m_name )
+		{
+			++rStatistics.requestCount;
+		}
+	}
+
+	uint64_t position = Invalid< uint64_t >();
+
+	size_t batchCount = batches.GetSize();
+	for( size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex )
+	{
+		const ReplayBatch& rBatch = batches[ batchIndex ];
+		const Entry* const* ppBatchReads = reads.GetData() + rBatch.readIndex;
+
+		ReplayReadGroup( ppBatchReads, rBatch.demandReadCount, position, rStatistics );
+		ReplayReadGroup( ppBatchReads + rBatch.demandReadCount, rBatch.prefetchReadCount, position, rStatistics );
+	}
+
+	return true;
+}
+
+#if HELIUM_TOOLS
+/// Rewrite the cache file so that the entries requested in a recorded load are stored in the order in which they are
+/// read.
+///
+/// The reads issued when loading the traced requests are simulated as in ReplayLoadTrace(), and each entry is moved to
+/// the position at which it is first read.  Every group of reads issued together then covers a contiguous range of the
+/// file, which the AsyncLoader services with a single read, and successive groups follow on from each other.  Entries
+/// that are not part of the trace are kept in their existing order after the traced entries.
+///
+/// In bundle mode, objects that are requested on demand in quick succession (see BUNDLE_REQUEST_INTERVAL_MAX) are also
+/// packed together into bundles of up to BUNDLE_SIZE_MAX bytes.  The objects of each bundle, along with the objects
+/// from their own dependency manifests, are appended to the dependency manifest of the first object in the bundle, so
+/// the whole bundle is prefetched with one contiguous read once the first object is requested.  Bundles are lost for
+/// any object that is cached again afterward, as recaching an object rewrites its dependency manifest.
+///
+/// @param[in] rTrace   Load trace to optimize for.  Requests for entries in other caches are ignored.
+/// @param[in] bBundle  True to group objects that are loaded together into bundles.
+///
+/// @return  True if the cache file was rewritten successfully, false if not (in which case it is left unchanged).
+///
+/// @see ReplayLoadTrace()
+bool Cache::OptimizeLayout( const LoadTrace& rTrace, bool bBundle )
+{
+	MutexScopeLock updateLock( m_updateLock );
+
+	// All entries are needed for rewriting the TOC (see WriteToc()).
+	LoadAllEntries();
+
+	if( m_entries.IsEmpty() )
+	{
+		return true;
+	}
+
+	FileStream* pSourceStream = FileStream::OpenFileStream( m_cacheFileName, FileStream::MODE_READ );
+	if( !pSourceStream )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"Cache::OptimizeLayout(): Failed to open cache \"%s\" for reading.\n",
+			*m_cacheFileName );
+
+		return false;
+	}
+
+	DynamicArray< const Entry* > layout;
+	DynamicArray< ReplayBatch > batches;
+	SimulateLoadTrace( rTrace, pSourceStream, NULL, layout, batches );
+
+	BundleMap bundles;
+	if( bBundle )
+	{
+		BuildBundles( layout, batches, bundles );
+		if( !bundles.IsEmpty() )
+		{
+			// Objects prefetched through bundles are read in a different order, so simulate the load again.
+			SimulateLoadTrace( rTrace, pSourceStream, &bundles, layout, batches );
+		}
+	}
+
+	size_t tracedEntryCount = layout.GetSize();
+
+	// Keep the remaining entries in their current order.
+	HashMap< const Entry*, bool > tracedEntries;
+	for( size_t layoutIndex = 0; layoutIndex < tracedEntryCount; ++layoutIndex )
+	{
+		MarkReplayRead( layout[ layoutIndex ], tracedEntries );
+	}
+
+	size_t entryCount = m_entries.GetSize();
+	layout.Reserve( entryCount );
+	for( size_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+	{
+		const Entry* pEntry = m_entries[ entryIndex ];
+		HELIUM_ASSERT( pEntry );
+		if( tracedEntries.Find( pEntry ) == tracedEntries.End() )
+		{
+			layout.Push( pEntry );
+		}
+	}
+
+	std::sort( layout.GetData() + tracedEntryCount, layout.GetData() + layout.GetSize(), EntryOffsetLess );
+	HELIUM_ASSERT( layout.GetSize() == entryCount );
+
+	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+	HELIUM_ASSERT( pAsyncLoader );
+
+	// Locking the loader also closes any file handles it has cached for the current cache file.
+	pAsyncLoader->Lock();
+
+	String layoutFileName( m_cacheFileName );
+	layoutFileName += ".layout";
+
+	bool bSuccess = false;
+
+	DynamicArray< uint64_t > newOffsets;
+	DynamicArray< uint32_t > newSizes;
+	newOffsets.Reserve( entryCount );
+	newSizes.Reserve( entryCount );
+
+	FileStream* pLayoutStream = FileStream::OpenFileStream( layoutFileName, FileStream::MODE_WRITE, true );
+	if( !pLayoutStream )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"Cache::OptimizeLayout(): Failed to open \"%s\" for writing.\n",
+			*layoutFileName );
+	}
+	else
+	{
+		bSuccess = true;
+
+		DynamicArray< uint8_t > entryData;
+		DynamicArray< AssetPath > dependencies;
+		uint64_t offset = 0;
+		for( size_t layoutIndex = 0; bSuccess && layoutIndex < entryCount; ++layoutIndex )
+		{
+			const Entry* pEntry = layout[ layoutIndex ];
+
+			if( bundles.Find( pEntry ) != bundles.End() )
+			{
+				bSuccess = ReadReplayManifest( *pEntry, pSourceStream, &bundles, dependencies );
+				if( bSuccess )
+				{
+					WriteDependencyManifest( dependencies, entryData );
+				}
+			}
+			else
+			{
+				// Entries are copied as stored, without recompressing them.
+				entryData.Resize( pEntry->storedSize );
+				bSuccess =
+					static_cast< uint64_t >( pSourceStream->Seek(
+						static_cast< int64_t >( pEntry->offset ),
+						SeekOrigins::Begin ) ) == pEntry->offset &&
+					pSourceStream->Read( entryData.GetData(), 1, pEntry->storedSize ) == pEntry->storedSize;
+			}
+
+			size_t entrySize = entryData.GetSize();
+			bSuccess = bSuccess &&
+				entrySize <= UINT32_MAX &&
+				pLayoutStream->Write( entryData.GetData(), 1, entrySize ) == entrySize;
+			if( !bSuccess )
+			{
+				HELIUM_TRACE(
+					TraceLevels::Error,
+					"Cache::OptimizeLayout(): Failed to copy \"%s\" to \"%s\".\n",
+					*pEntry->path.ToString(),
+					*layoutFileName );
+
+				break;
+			}
+
+			newOffsets.Push( offset );
+			newSizes.Push( static_cast< uint32_t >( entrySize ) );
+			offset += entrySize;
+		}
+
+		delete pLayoutStream;
+	}
+
+	delete pSourceStream;
+
+	if( bSuccess )
+	{
+		// Views into the current mapping of the cache file must remain valid, but all further access needs to use the
+		// new file.
+		if( m_bMemoryMapped )
+		{
+			MutexScopeLock mappingLock( m_mappingLock );
+
+			if( m_cacheMapping.pData )
+			{
+				m_retiredCacheMappings.Push( m_cacheMapping );
+				m_cacheMapping = MappedFile();
+			}
+		}
+
+		// Renaming over an existing file fails on some platforms, so fall back to removing the old file first.
+		if( std::rename( *layoutFileName, *m_cacheFileName ) != 0 &&
+			( std::remove( *m_cacheFileName ) != 0 || std::rename( *layoutFileName, *m_cacheFileName ) != 0 ) )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"Cache::OptimizeLayout(): Failed to replace cache \"%s\" with \"%s\".\n",
+				*m_cacheFileName,
+				*layoutFileName );
+
+			bSuccess = false;
+		}
+	}
+	else
+	{
+		std::remove( *layoutFileName );
+	}
+
+	if( bSuccess )
+	{
+		for( size_t layoutIndex = 0; layoutIndex < entryCount; ++layoutIndex )
+		{
+			// Entries are owned by this cache, so they can be updated in place.  Rewritten dependency manifests are
+			// stored uncompressed.
+			Entry* pEntry = const_cast< Entry* >( layout[ layoutIndex ] );
+			pEntry->offset = newOffsets[ layoutIndex ];
+			pEntry->storedSize = newSizes[ layoutIndex ];
+			if( bundles.Find( pEntry ) != bundles.End() )
+			{
+				pEntry->size = pEntry->storedSize;
+				pEntry->compression = Compression::TYPE_NONE;
+			}
+		}
+
+		bSuccess = WriteToc();
+
+		HELIUM_TRACE(
+			TraceLevels::Info,
+			"Cache: Rewrote \"%s\" with %" PRIuSZ " of %" PRIuSZ " entries in load order (%" PRIuSZ " bundles).\n",
+			*m_cacheFileName,
+			tracedEntryCount,
+			entryCount,
+			bundles.GetSize() );
+	}
+
+	pAsyncLoader->Unlock();
+
+	return bSuccess;
+}
+#endif  // HELIUM_TOOLS
+
+/// Parse a TOC that has been loaded into the TOC buffer, discarding any partially parsed entries on failure.
+///
+/// @param[in] bytesRead  Number of bytes loaded into the TOC buffer.
+void Cache::ProcessLoadedToc( size_t bytesRead )
+{
+	HELIUM_ASSERT( m_pTocBuffer );
+
+	if( m_tocSize != bytesRead )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"Cache::ProcessLoadedToc(): TOC file \"%s\" size (%" PRIu32 ") does not match the number of bytes read (%" PRIuSZ ").\n",
+			*m_tocFileName,
+			m_tocSize,
+			bytesRead );
+
+		m_tocSize = static_cast< uint32_t >( bytesRead );
+	}
+
+	if( !FinalizeTocLoad() )
+	{
+		HELIUM_ASSERT( m_pEntryPool );
+
+		// The caller still owns the TOC buffer, so only forget about the table here.
+		m_pTocRecords = NULL;
+		m_tocRecordCount = 0;
+		m_pTocStringPool = NULL;
+		m_tocStringPoolSize = 0;
+		m_bAllTocEntriesLoaded = true;
+		SetInvalid( m_tocJournalRecordCount );
+
+		size_t entryCount = m_entries.GetSize();
+		for( size_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+		{
+			Entry* pEntry = m_entries[ entryIndex ];
+			HELIUM_ASSERT( pEntry );
+			m_pEntryPool->Release( pEntry );
+		}
+
+		m_entries.Clear();
+		m_entryMap.Clear();
+	}
+}
+
+/// Finalize the TOC loading process.
+///
+/// Note that this does not free any resources on a failed load (the caller is responsible for such clean-up work).
+///
+/// @return  True if the TOC load was successful, false if not.
+bool Cache::FinalizeTocLoad()
+{
+	HELIUM_ASSERT( m_pTocBuffer );
+
+	const uint8_t* pTocCurrent = m_pTocBuffer;
+	const uint8_t* pTocMax = pTocCurrent + m_tocSize;
+
+	StackMemoryHeap<>& rStackHeap = ThreadLocalStackAllocator::GetMemoryHeap();
+
+	// Validate the TOC header.
+	uint32_t magic;
+	if( !CheckedTocRead( MemoryCopy, magic, "the header magic", pTocCurrent, pTocMax ) )
+	{
+		return false;
+	}
+
+	LOAD_VALUE_CALLBACK* pLoadFunction = NULL;
+	if( magic == TOC_MAGIC )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Info,
+			"Cache::FinalizeTocLoad(): TOC \"%s\" identified (no byte swapping).\n",
+			*m_tocFileName );
+
+		pLoadFunction = MemoryCopy;
+	}
+	else if( magic == TOC_MAGIC_SWAPPED )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Info,
+			"Cache::FinalizeTocLoad(): TOC \"%s\" identified (byte swapping is necessary).\n",
+			*m_tocFileName );
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"Cache::TryFinishLoadToc(): Cache for TOC \"%s\" uses byte swapping, which may incur performance penalties.\n",
+			*m_tocFileName );
+
+		pLoadFunction = ReverseByteOrder;
+	}
+	else
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"Cache::FinalizeTocLoad(): TOC \"%s\" has invalid file magic.\n",
+			*m_tocFileName );
+
+		return false;
+	}
+
+	uint32_t version;
+	if( !CheckedTocRead( pLoadFunction, version, "the cache version number", pTocCurrent, pTocMax ) )
+	{
+		return false;
+	}
+
+	if( version > sm_Version )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"Cache::FinalizeTocLoad(): Cache version number (%" PRIu32 ") exceeds the maximum supported version (%" PRIu32 ").\n",
+			version,
+			sm_Version );
+
+		return false;
+	}
+
+	if( version != TOC_VERSION_LEGACY )
+	{
+		// Earlier table formats are not converted; the cache is treated as empty and rebuilt instead.
+		if( version != sm_Version )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Warning,
+				"Cache::FinalizeTocLoad(): TOC \"%s\" uses an outdated table format (version %" PRIu32 ") and will be rebuilt.\n",
+				*m_tocFileName,
+				version );
+
+			return false;
+		}
+
+		if( pLoadFunction != MemoryCopy )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"Cache::FinalizeTocLoad(): TOC \"%s\" is byte swapped, which is only supported by the legacy TOC format.\n",
+				*m_tocFileName );
+
+			return false;
+		}
+
+		return FinalizeTocTableLoad();
+	}
+
+	// Legacy TOC files are rewritten in full the next time an entry is cached.
+	SetInvalid( m_tocJournalRecordCount );
+
+	// Read the numbers of entries in the cache.
+	uint32_t entryCount;
+	bool bReadResult = CheckedTocRead(
+		pLoadFunction,
+		entryCount,
+		"the number of entries in the cache",
+		pTocCurrent,
+		pTocMax );
+	if( !bReadResult )
+	{
+		return false;
+	}
+
+	// Load the entry information.
+	EntryKey key;
+
+	uint_fast32_t entryCountFast = entryCount;
 	m_entries.Reserve( entryCountFast );
 	for( uint_fast32_t entryIndex = 0; entryIndex < entryCountFast; ++entryIndex )
 	{
-		uint16_t entryPathSize;
-		bReadResult = CheckedTocRead(
-			pLoadFunction,
-			entryPathSize,
-			"entry AssetPath string size",
-			pTocCurrent,
-			pTocMax );
-		if( !bReadResult )
+		uint16_t entryPathSize;
+		bReadResult = CheckedTocRead(
+			pLoadFunction,
+			entryPathSize,
+			"entry AssetPath string size",
+			pTocCurrent,
+			pTocMax );
+		if( !bReadResult )
+		{
+			return false;
+		}
+
+		uint_fast16_t entryPathSizeFast = entryPathSize;
+
+		StackMemoryHeap<>::Marker stackMarker( rStackHeap );
+		char* pPathString = static_cast< char* >( rStackHeap.Allocate(
+			sizeof( char ) * ( entryPathSizeFast + 1 ) ) );
+		HELIUM_ASSERT( pPathString );
+		pPathString[ entryPathSizeFast ] = '\0';
+
+		for( uint_fast16_t characterIndex = 0; characterIndex < entryPathSizeFast; ++characterIndex )
+		{
+			bReadResult = CheckedTocRead(
+				pLoadFunction,
+				pPathString[ characterIndex ],
+				"entry AssetPath string character",
+				pTocCurrent,
+				pTocMax );
+			if( !bReadResult )
+			{
+				return false;
+			}
+		}
+
+		AssetPath entryPath;
+		if( !entryPath.Set( pPathString ) )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"Cache::FinalizeTocLoad(): Failed to set AssetPath for entry %" PRIuFAST16 ".\n",
+				entryIndex );
+
+			return false;
+		}
+
+		uint32_t entrySubDataIndex;
+		bReadResult = CheckedTocRead(
+			pLoadFunction,
+			entrySubDataIndex,
+			"entry sub-data index",
+			pTocCurrent,
+			pTocMax );
+		if( !bReadResult )
+		{
+			return false;
+		}
+
+		key.path = entryPath;
+		key.subDataIndex = entrySubDataIndex;
+
+		EntryMapType::ConstAccessor entryAccessor;
+		if( m_entryMap.Find( entryAccessor, key ) )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"Cache::FinalizeTocLoad(): Duplicate entry found for AssetPath \"%s\", sub-data %" PRIu32 ".\n",
+				pPathString,
+				entrySubDataIndex );
+
+			return false;
+		}
+
+		uint64_t entryOffset;
+		if( !CheckedTocRead( pLoadFunction, entryOffset, "entry offset", pTocCurrent, pTocMax ) )
+		{
+			return false;
+		}
+
+		int64_t entryTimestamp;
+		if( !CheckedTocRead( pLoadFunction, entryTimestamp, "entry timestamp", pTocCurrent, pTocMax ) )
+		{
+			return false;
+		}
+
+		uint32_t entrySize;
+		if( !CheckedTocRead( pLoadFunction, entrySize, "entry size", pTocCurrent, pTocMax ) )
+		{
+			return false;
+		}
+
+		Entry* pEntry = m_pEntryPool->Allocate();
+		HELIUM_ASSERT( pEntry );
+		pEntry->path = entryPath;
+		pEntry->subDataIndex = entrySubDataIndex;
+		pEntry->offset = entryOffset;
+		pEntry->timestamp = entryTimestamp;
+		pEntry->contentHash = 0;
+		pEntry->size = entrySize;
+		pEntry->storedSize = entrySize;
+		pEntry->compression = Compression::TYPE_NONE;
+
+		m_entries.Add( pEntry );
+
+		HELIUM_VERIFY( m_entryMap.Insert( entryAccessor, KeyValue< EntryKey, Entry* >( key, pEntry ) ) );
+	}
+
+	return true;
+}
+
+/// Finalize loading of a TOC stored as a sorted table.
+///
+/// The table itself is left in the TOC buffer to be searched as entries are requested.  Only entries in the journal
+/// are created up front.
+///
+/// @return  True if the TOC load was successful, false if not.
+bool Cache::FinalizeTocTableLoad()
+{
+	HELIUM_ASSERT( m_pTocBuffer );
+	HELIUM_ASSERT( m_pEntryPool );
+
+	TocHeader header;
+	if( m_tocSize < sizeof( header ) )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"Cache::FinalizeTocTableLoad(): Not enough bytes in TOC \"%s\" for the header.\n",
+			*m_tocFileName );
+
+		return false;
+	}
+
+	MemoryCopy( &header, m_pTocBuffer, sizeof( header ) );
+
+	uint64_t tableEnd = sizeof( header ) + static_cast< uint64_t >( header.recordCount ) * sizeof( TocRecord );
+	uint64_t stringPoolEnd = tableEnd + header.stringPoolSize;
+	if( stringPoolEnd > m_tocSize )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"Cache::FinalizeTocTableLoad(): TOC \"%s\" is too small for %" PRIu32 " entries.\n",
+			*m_tocFileName,
+			header.recordCount );
+
+		return false;
+	}
+
+	m_pTocRecords = reinterpret_cast< const TocRecord* >( m_pTocBuffer + sizeof( header ) );
+	m_tocRecordCount = header.recordCount;
+	m_pTocStringPool = reinterpret_cast< const char* >( m_pTocBuffer + tableEnd );
+	m_tocStringPoolSize = header.stringPoolSize;
+	m_bAllTocEntriesLoaded = ( m_tocRecordCount == 0 );
+
+	// Apply entries added or updated since the table was written.
+	const uint8_t* pTocCurrent = m_pTocBuffer + AlignTocOffset( static_cast< size_t >( stringPoolEnd ) );
+	const uint8_t* pTocMax = m_pTocBuffer + m_tocSize;
+
+	uint32_t journalRecordCount = 0;
+	while( pTocCurrent < pTocMax )
+	{
+		TocJournalRecord record;
+		const char* pPathString = reinterpret_cast< const char* >( pTocCurrent + sizeof( record ) );
+		if( static_cast< size_t >( pTocMax - pTocCurrent ) < sizeof( record ) )
+		{
+			record.magic = 0;
+		}
+		else
+		{
+			MemoryCopy( &record, pTocCurrent, sizeof( record ) );
+		}
+
+		if( record.magic != TOC_JOURNAL_MAGIC ||
+			record.pathSize >= static_cast< size_t >( pTocMax - reinterpret_cast< const uint8_t* >( pPathString ) ) ||
+			pPathString[ record.pathSize ] != '\0' )
+		{
+			// Most likely the result of an interrupted write.  Everything up to this point is still usable, but the TOC
+			// will need to be rewritten before anything else can be appended to the journal.
+			HELIUM_TRACE(
+				TraceLevels::Warning,
+				"Cache::FinalizeTocTableLoad(): Ignoring invalid journal data at the end of TOC \"%s\".\n",
+				*m_tocFileName );
+
+			SetInvalid( journalRecordCount );
+
+			break;
+		}
+
+		EntryKey key;
+		if( !key.path.Set( pPathString ) )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"Cache::FinalizeTocTableLoad(): Failed to set AssetPath for journal entry \"%s\".\n",
+				pPathString );
+
+			return false;
+		}
+
+		key.subDataIndex = record.subDataIndex;
+
+		EntryMapType::ConstAccessor entryAccessor;
+		Entry* pEntry = NULL;
+		if( m_entryMap.Find( entryAccessor, key ) )
+		{
+			pEntry = entryAccessor->Second();
+			HELIUM_ASSERT( pEntry );
+		}
+		else
+		{
+			pEntry = m_pEntryPool->Allocate();
+			HELIUM_ASSERT( pEntry );
+			pEntry->path = key.path;
+			pEntry->subDataIndex = key.subDataIndex;
+
+			m_entries.Push( pEntry );
+			HELIUM_VERIFY( m_entryMap.Insert( entryAccessor, KeyValue< EntryKey, Entry* >( key, pEntry ) ) );
+		}
+
+		pEntry->offset = record.offset;
+		pEntry->timestamp = record.timestamp;
+		pEntry->contentHash = record.contentHash;
+		pEntry->size = record.size;
+		pEntry->storedSize = record.storedSize;
+		pEntry->compression = static_cast< Compression::EType >( record.compression );
+
+		++journalRecordCount;
+		pTocCurrent = reinterpret_cast< const uint8_t* >( pPathString ) + AlignTocOffset( record.pathSize + 1 );
+	}
+
+	m_tocJournalRecordCount = journalRecordCount;
+
+	return true;
+}
+
+/// Release the TOC table once entries no longer need to be looked up from it.
+void Cache::ReleaseTocTable()
+{
+	// A table in the TOC buffer keeps the buffer alive, while a table in a mapping keeps the mapping alive.
+	if( m_pTocRecords && !m_tocMapping.pData )
+	{
+		DefaultAllocator().Free( m_pTocBuffer );
+		m_pTocBuffer = NULL;
+	}
+
+	UnmapFile( m_tocMapping );
+
+	m_pTocRecords = NULL;
+	m_tocRecordCount = 0;
+	m_pTocStringPool = NULL;
+	m_tocStringPoolSize = 0;
+}
+
+/// Create the entry for the given key from the TOC table.
+///
+/// @param[in] rKey  Entry key.
+///
+/// @return  Entry for the given key, or null if the TOC table does not contain it.
+Cache::Entry* Cache::LoadTocEntry( const EntryKey& rKey ) const
+{
+	String pathString;
+	rKey.path.ToString( pathString );
+
+	uint64_t pathHash = StableHash64( pathString.GetData(), pathString.GetSize() );
+
+	// The TOC table may be released by another thread (see LoadAllEntries()), so it is only searched with the entry
+	// lock held.
+	MutexScopeLock scopeLock( m_entryLock );
+
+	// Another thread may have created the entry already.
+	EntryMapType::ConstAccessor entryAccessor;
+	if( m_entryMap.Find( entryAccessor, rKey ) )
+	{
+		return entryAccessor->Second();
+	}
+
+	if( !m_pTocRecords )
+	{
+		return NULL;
+	}
+
+	uint32_t recordIndex = FindTocRecord( pathHash, rKey.subDataIndex, pathString );
+	if( IsInvalid( recordIndex ) )
+	{
+		return NULL;
+	}
+
+	const TocRecord& rRecord = m_pTocRecords[ recordIndex ];
+
+	Entry* pEntry = m_pEntryPool->Allocate();
+	HELIUM_ASSERT( pEntry );
+	pEntry->path = rKey.path;
+	pEntry->subDataIndex = rKey.subDataIndex;
+	pEntry->offset = rRecord.offset;
+	pEntry->timestamp = rRecord.timestamp;
+	pEntry->contentHash = rRecord.contentHash;
+	pEntry->size = rRecord.size;
+	pEntry->storedSize = rRecord.storedSize;
+	pEntry->compression = static_cast< Compression::EType >( rRecord.compression );
+
+	m_entries.Push( pEntry );
+	HELIUM_VERIFY( m_entryMap.Insert( entryAccessor, KeyValue< EntryKey, Entry* >( rKey, pEntry ) ) );
+
+	return pEntry;
+}
+
+/// Create entries for all records in the TOC table that haven't been created yet.
+///
+/// This is needed before the full list of entries can be accessed.
+///
+/// @see GetEntryCount(), GetEntry()
+void Cache::LoadAllTocEntries() const
+{
+	MutexScopeLock scopeLock( m_entryLock );
+
+	if( m_bAllTocEntriesLoaded )
+	{
+		return;
+	}
+
+	HELIUM_ASSERT( m_pEntryPool );
+
+	m_entries.Reserve( m_entries.GetSize() + m_tocRecordCount );
+
+	EntryKey key;
+	for( uint32_t recordIndex = 0; recordIndex < m_tocRecordCount; ++recordIndex )
+	{
+		const TocRecord& rRecord = m_pTocRecords[ recordIndex ];
+
+		const char* pPathString = GetTocRecordPath( rRecord );
+		if( !pPathString || !key.path.Set( pPathString ) )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"Cache::LoadAllTocEntries(): Invalid path for entry %" PRIu32 " in TOC \"%s\".\n",
+				recordIndex,
+				*m_tocFileName );
+
+			continue;
+		}
+
+		key.subDataIndex = rRecord.subDataIndex;
+
+		EntryMapType::ConstAccessor entryAccessor;
+		if( m_entryMap.Find( entryAccessor, key ) )
+		{
+			continue;
+		}
+
+		Entry* pEntry = m_pEntryPool->Allocate();
+		HELIUM_ASSERT( pEntry );
+		pEntry->path = key.path;
+		pEntry->subDataIndex = key.subDataIndex;
+		pEntry->offset = rRecord.offset;
+		pEntry->timestamp = rRecord.timestamp;
+		pEntry->contentHash = rRecord.contentHash;
+		pEntry->size = rRecord.size;
+		pEntry->storedSize = rRecord.storedSize;
+		pEntry->compression = static_cast< Compression::EType >( rRecord.compression );
+
+		m_entries.Push( pEntry );
+		HELIUM_VERIFY( m_entryMap.Insert( entryAccessor, KeyValue< EntryKey, Entry* >( key, pEntry ) ) );
+	}
+
+	m_bAllTocEntriesLoaded = true;
+}
+
+/// Search the TOC table for a record.
+///
+/// @param[in] pathHash      Hash of the entry path string.
+/// @param[in] subDataIndex  Sub-data index.
+/// @param[in] rPath         Entry path string.
+///
+/// @return  Index of the matching record, or an invalid index if no match was found.
+uint32_t Cache::FindTocRecord( uint64_t pathHash, uint32_t subDataIndex, const String& rPath ) const
+{
+	HELIUM_ASSERT( m_pTocRecords || m_tocRecordCount == 0 );
+
+	// Find the first record that does not sort before the search key.
+	uint32_t lowIndex = 0;
+	uint32_t highIndex = m_tocRecordCount;
+	while( lowIndex < highIndex )
+	{
+		uint32_t middleIndex = lowIndex + ( highIndex - lowIndex ) / 2;
+		const TocRecord& rRecord = m_pTocRecords[ middleIndex ];
+		if( rRecord.pathHash < pathHash || ( rRecord.pathHash == pathHash && rRecord.subDataIndex < subDataIndex ) )
+		{
+			lowIndex = middleIndex + 1;
+		}
+		else
+		{
+			highIndex = middleIndex;
+		}
+	}
+
+	// Records with colliding path hashes are adjacent, so compare the path of each record with a matching key.
+	size_t pathSize = rPath.GetSize();
+	for( uint32_t recordIndex = lowIndex; recordIndex < m_tocRecordCount; ++recordIndex )
+	{
+		const TocRecord& rRecord = m_pTocRecords[ recordIndex ];
+		if( rRecord.pathHash != pathHash || rRecord.subDataIndex != subDataIndex )
+		{
+			break;
+		}
+
+		const char* pRecordPath = GetTocRecordPath( rRecord );
+		if( pRecordPath && rRecord.pathSize == pathSize && memcmp( pRecordPath, rPath.GetData(), pathSize ) == 0 )
+		{
+			return recordIndex;
+		}
+	}
+
+	return Invalid< uint32_t >();
+}
+
+/// Get the path string of a TOC table record.
+///
+/// @param[in] rRecord  TOC table record.
+///
+/// @return  Null-terminated path string, or null if the record references data outside the string pool.
+const char* Cache::GetTocRecordPath( const TocRecord& rRecord ) const
+{
+	uint64_t pathEnd = static_cast< uint64_t >( rRecord.pathOffset ) + rRecord.pathSize;
+	if( pathEnd >= m_tocStringPoolSize || m_pTocStringPool[ pathEnd ] != '\0' )
+	{
+		return NULL;
+	}
+
+	return m_pTocStringPool + rRecord.pathOffset;
+}
+
+/// Rewrite the TOC file in full, clearing the journal.
+///
+/// @return  True if the TOC was written successfully, false if not.
+bool Cache::WriteToc()
+{
+	HELIUM_TRACE( TraceLevels::Info, "Cache: Rewriting TOC file \"%s\".\n", *m_tocFileName );
+
+	// All entries need to be available for rewriting the TOC, at which point the old TOC table is no longer needed
+	// (releasing it also allows a mapped TOC file to be rewritten).
+	LoadAllEntries();
+
+	// Build the sorted table and the string pool.
+	size_t entryCount = m_entries.GetSize();
+	HELIUM_ASSERT( entryCount <= UINT32_MAX );
+
+	DynamicArray< TocRecord > records;
+	records.Reserve( entryCount );
+
+	DynamicArray< char > stringPool;
+
+	String entryPath;
+	for( size_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+	{
+		const Entry* pEntry = m_entries[ entryIndex ];
+		HELIUM_ASSERT( pEntry );
+
+		pEntry->path.ToString( entryPath );
+		size_t pathSize = entryPath.GetSize();
+
+		TocRecord* pRecord = records.New();
+		HELIUM_ASSERT( pRecord );
+		pRecord->pathHash = StableHash64( entryPath.GetData(), pathSize );
+		pRecord->offset = pEntry->offset;
+		pRecord->timestamp = pEntry->timestamp;
+		pRecord->contentHash = pEntry->contentHash;
+		pRecord->pathOffset = static_cast< uint32_t >( stringPool.GetSize() );
+		pRecord->pathSize = static_cast< uint32_t >( pathSize );
+		pRecord->subDataIndex = pEntry->subDataIndex;
+		pRecord->size = pEntry->size;
+		pRecord->storedSize = pEntry->storedSize;
+		pRecord->compression = static_cast< uint32_t >( pEntry->compression );
+
+		for( size_t characterIndex = 0; characterIndex < pathSize; ++characterIndex )
+		{
+			stringPool.Push( entryPath.GetData()[ characterIndex ] );
+		}
+
+		stringPool.Push( '\0' );
+	}
+
+	// Pad the string pool so that journal records appended after it remain aligned.
+	while( stringPool.GetSize() != AlignTocOffset( stringPool.GetSize() ) )
+	{
+		stringPool.Push( '\0' );
+	}
+
+	std::sort( records.GetData(), records.GetData() + records.GetSize(), TocRecordLess< TocRecord > );
+
+	TocHeader header;
+	header.magic = TOC_MAGIC;
+	header.version = sm_Version;
+	header.recordCount = static_cast< uint32_t >( records.GetSize() );
+	header.stringPoolSize = static_cast< uint32_t >( stringPool.GetSize() );
+
+	FileStream* pTocStream = FileStream::OpenFileStream( m_tocFileName, FileStream::MODE_WRITE, true );
+	if( !pTocStream )
+	{
+		HELIUM_TRACE( TraceLevels::Error, "Cache: Failed to open TOC \"%s\" for writing.\n", *m_tocFileName );
+		SetInvalid( m_tocJournalRecordCount );
+
+		return false;
+	}
+
+	BufferedStream* pBufferedStream = new BufferedStream( pTocStream );
+	HELIUM_ASSERT( pBufferedStream );
+
+	bool bSuccess = ( pBufferedStream->Write( &header, sizeof( header ), 1 ) == 1 );
+	if( bSuccess && !records.IsEmpty() )
+	{
+		bSuccess = ( pBufferedStream->Write( records.GetData(), sizeof( TocRecord ), records.GetSize() ) == records.GetSize() );
+	}
+
+	if( bSuccess && !stringPool.IsEmpty() )
+	{
+		bSuccess = ( pBufferedStream->Write( stringPool.GetData(), 1, stringPool.GetSize() ) == stringPool.GetSize() );
+	}
+
+	delete pBufferedStream;
+	delete pTocStream;
+
+	if( !bSuccess )
+	{
+		HELIUM_TRACE( TraceLevels::Error, "Cache: Failed to write TOC \"%s\".\n", *m_tocFileName );
+		SetInvalid( m_tocJournalRecordCount );
+
+		return false;
+	}
+
+	m_tocJournalRecordCount = 0;
+
+	return true;
+}
+
+/// Append a record for an added or updated entry to the TOC journal.
+///
+/// @param[in] rEntry  Entry to record.
+///
+/// @return  True if the record was appended successfully, false if not (in which case the TOC should be rewritten).
+bool Cache::AppendTocJournal( const Entry& rEntry )
+{
+	HELIUM_ASSERT( IsValid( m_tocJournalRecordCount ) );
+
+	Status status;
+	status.Read( m_tocFileName.GetData() );
+	if( status.m_Size <= 0 || static_cast< uint64_t >( status.m_Size ) % TOC_ALIGNMENT != 0 )
+	{
+		return false;
+	}
+
+	FileStream* pTocStream = FileStream::OpenFileStream( m_tocFileName, FileStream::MODE_WRITE, false );
+	if( !pTocStream )
+	{
+		return false;
+	}
+
+	String entryPath;
+	rEntry.path.ToString( entryPath );
+
+	TocJournalRecord record;
+	record.magic = TOC_JOURNAL_MAGIC;
+	record.pathSize = static_cast< uint32_t >( entryPath.GetSize() );
+	record.subDataIndex = rEntry.subDataIndex;
+	record.size = rEntry.size;
+	record.offset = rEntry.offset;
+	record.timestamp = rEntry.timestamp;
+	record.contentHash = rEntry.contentHash;
+	record.storedSize = rEntry.storedSize;
+	record.compression = static_cast< uint32_t >( rEntry.compression );
+
+	// Path string, null terminator, and padding.
+	static const uint8_t padding[ TOC_ALIGNMENT ] = {};
+	size_t paddingSize = AlignTocOffset( record.pathSize + 1 ) - record.pathSize;
+
+	bool bSuccess = ( pTocStream->Seek( status.m_Size, SeekOrigins::Begin ) == status.m_Size );
+	bSuccess = bSuccess && ( pTocStream->Write( &record, sizeof( record ), 1 ) == 1 );
+	bSuccess = bSuccess && ( pTocStream->Write( *entryPath, 1, record.pathSize ) == record.pathSize );
+	bSuccess = bSuccess && ( pTocStream->Write( padding, 1, paddingSize ) == paddingSize );
+
+	delete pTocStream;
+
+	if( !bSuccess )
+	{
+		HELIUM_TRACE( TraceLevels::Warning, "Cache: Failed to append to the journal of TOC \"%s\".\n", *m_tocFileName );
+
+		return false;
+	}
+
+	++m_tocJournalRecordCount;
+
+	return true;
+}
+
+/// Simulate the reads issued when loading the entries of this cache requested in a load trace.
+///
+/// This mirrors the CachePackageLoader: an object that was not prefetched is read along with its dependency manifest,
+/// after which the objects listed in the manifest are read in the order in which they are stored.  Other entries (such
+/// as resource sub-data) are read individually.  Entries already read earlier in the trace are assumed to still be
+/// available.
+///
+/// @param[in]  rTrace        Load trace.
+/// @param[in]  pCacheStream  Stream from which to read dependency manifests.
+/// @param[in]  pBundles      Object paths to append to dependency manifests, or null.
+/// @param[out] rReads        Entries read, in the order in which they are requested.
+/// @param[out] rBatches      Groups of reads issued for each request.
+void Cache::SimulateLoadTrace(
+	const LoadTrace& rTrace,
+	FileStream* pCacheStream,
+	const BundleMap* pBundles,
+	DynamicArray< const Entry* >& rReads,
+	DynamicArray< ReplayBatch >& rBatches ) const
+{
+	HELIUM_ASSERT( pCacheStream );
+
+	rReads.Resize( 0 );
+	rBatches.Resize( 0 );
+
+	HashMap< const Entry*, bool > readEntries;
+	DynamicArray< AssetPath > dependencies;
+	DynamicArray< const Entry* > prefetchEntries;
+
+	size_t recordCount = rTrace.GetRecordCount();
+	for( size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex )
+	{
+		const LoadTrace::Record& rRecord = rTrace.GetRecord( recordIndex );
+		if( rRecord.cacheName != m_name )
 		{
-			return false;
+			continue;
 		}
 
-		uint_fast16_t entryPathSizeFast = entryPathSize;
+		const Entry* pEntry = FindEntry( rRecord.path, rRecord.subDataIndex );
+		if( !pEntry || !MarkReplayRead( pEntry, readEntries ) )
+		{
+			continue;
+		}
 
-		StackMemoryHeap<>::Marker stackMarker( rStackHeap );
-		char* pPathString = static_cast< char* >( rStackHeap.Allocate(
-			sizeof( char ) * ( entryPathSizeFast + 1 ) ) );
-		HELIUM_ASSERT( pPathString );
-		pPathString[ entryPathSizeFast ] = '\0';
+		ReplayBatch batch;
+		batch.readIndex = rReads.GetSize();
+		batch.prefetchReadCount = 0;
+		batch.time = rRecord.time;
+		batch.pObjectEntry = NULL;
+		batch.pManifestEntry = NULL;
 
-		for( uint_fast16_t characterIndex = 0; characterIndex < entryPathSizeFast; ++characterIndex )
+		if( rRecord.subDataIndex == 0 )
 		{
-			bReadResult = CheckedTocRead(
-				pLoadFunction,
-				pPathString[ characterIndex ],
-				"entry AssetPath string character",
-				pTocCurrent,
-				pTocMax );
-			if( !bReadResult )
+			const Entry* pManifestEntry = FindEntry( rRecord.path, DEPENDENCY_MANIFEST_SUB_DATA_INDEX );
+			if( pManifestEntry && pManifestEntry->size != 0 && MarkReplayRead( pManifestEntry, readEntries ) )
 			{
-				return false;
+				rReads.Push( pManifestEntry );
+
+				batch.pObjectEntry = pEntry;
+				batch.pManifestEntry = pManifestEntry;
 			}
 		}
 
-		AssetPath entryPath;
-		if( !entryPath.Set( pPathString ) )
+		rReads.Push( pEntry );
+		batch.demandReadCount = rReads.GetSize() - batch.readIndex;
+
+		if( batch.pManifestEntry )
 		{
-			HELIUM_TRACE(
-				TraceLevels::Error,
-				"Cache::FinalizeTocLoad(): Failed to set AssetPath for entry %" PRIuFAST16 ".\n",
-				entryIndex );
+			ReadReplayManifest( *batch.pManifestEntry, pCacheStream, pBundles, dependencies );
 
-			return false;
-		}
+			prefetchEntries.Resize( 0 );
 
-		uint32_t entrySubDataIndex;
-		bReadResult = CheckedTocRead(
-			pLoadFunction,
-			entrySubDataIndex,
-			"entry sub-data index",
-			pTocCurrent,
-			pTocMax );
-		if( !bReadResult )
-		{
-			return false;
+			size_t dependencyCount = dependencies.GetSize();
+			for( size_t dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex )
+			{
+				AssetPath dependencyPath = dependencies[ dependencyIndex ];
+				if( dependencyPath.IsPackage() )
+				{
+					continue;
+				}
+
+				const Entry* pDependencyEntry = FindEntry( dependencyPath, 0 );
+				if( pDependencyEntry &&
+					pDependencyEntry->size != 0 &&
+					MarkReplayRead( pDependencyEntry, readEntries ) )
+				{
+					prefetchEntries.Push( pDependencyEntry );
+				}
+			}
+
+			std::sort( prefetchEntries.GetData(), prefetchEntries.GetData() + prefetchEntries.GetSize(), EntryOffsetLess );
+
+			size_t prefetchCount = prefetchEntries.GetSize();
+			for( size_t prefetchIndex = 0; prefetchIndex < prefetchCount; ++prefetchIndex )
+			{
+				rReads.Push( prefetchEntries[ prefetchIndex ] );
+			}
+
+			batch.prefetchReadCount = prefetchCount;
 		}
 
-		key.path = entryPath;
-		key.subDataIndex = entrySubDataIndex;
+		rBatches.Push( batch );
+	}
+}
 
-		EntryMapType::ConstAccessor entryAccessor;
-		if( m_entryMap.Find( entryAccessor, key ) )
+/// Read a dependency manifest from the cache file for simulating a load trace.
+///
+/// @param[in]  rManifestEntry  Dependency manifest entry.
+/// @param[in]  pCacheStream    Stream from which to read the manifest.
+/// @param[in]  pBundles        Object paths to append to dependency manifests, or null.
+/// @param[out] rDependencies   Paths listed in the manifest, followed by any paths appended for the manifest.
+///
+/// @return  True if the manifest was read successfully, false if not.  Any appended paths are still returned on
+///          failure.
+bool Cache::ReadReplayManifest(
+	const Entry& rManifestEntry,
+	FileStream* pCacheStream,
+	const BundleMap* pBundles,
+	DynamicArray< AssetPath >& rDependencies ) const
+{
+	HELIUM_ASSERT( pCacheStream );
+
+	rDependencies.Resize( 0 );
+
+	DynamicArray< uint8_t > manifestData;
+	bool bSuccess =
+		ReadEntryData( rManifestEntry, pCacheStream, manifestData ) &&
+		ReadDependencyManifest( manifestData.GetData(), manifestData.GetSize(), rDependencies );
+	if( !bSuccess )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"Cache: Failed to read the dependency manifest for \"%s\" from cache \"%s\".\n",
+			*rManifestEntry.path.ToString(),
+			*m_cacheFileName );
+	}
+
+	if( pBundles )
+	{
+		BundleMap::ConstIterator bundleIterator = pBundles->Find( &rManifestEntry );
+		if( bundleIterator != pBundles->End() )
 		{
-			HELIUM_TRACE(
-				TraceLevels::Error,
-				"Cache::FinalizeTocLoad(): Duplicate entry found for AssetPath \"%s\", sub-data %" PRIu32 ".\n",
-				pPathString,
-				entrySubDataIndex );
+			const DynamicArray< AssetPath >& rBundlePaths = bundleIterator->Second();
 
-			return false;
+			size_t bundlePathCount = rBundlePaths.GetSize();
+			for( size_t bundlePathIndex = 0; bundlePathIndex < bundlePathCount; ++bundlePathIndex )
+			{
+				AssetPath bundlePath = rBundlePaths[ bundlePathIndex ];
+
+				size_t dependencyCount = rDependencies.GetSize();
+				size_t dependencyIndex;
+				for( dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex )
+				{
+					if( rDependencies[ dependencyIndex ] == bundlePath )
+					{
+						break;
+					}
+				}
+
+				if( dependencyIndex == dependencyCount )
+				{
+					rDependencies.Push( bundlePath );
+				}
+			}
 		}
+	}
 
-		uint64_t entryOffset;
-		if( !CheckedTocRead( pLoadFunction, entryOffset, "entry offset", pTocCurrent, pTocMax ) )
+	return bSuccess;
+}
+
+#if HELIUM_TOOLS
+/// Group objects requested on demand in quick succession into bundles for OptimizeLayout().
+///
+/// @param[in]  rReads    Simulated reads, as returned by SimulateLoadTrace().
+/// @param[in]  rBatches  Simulated read batches, as returned by SimulateLoadTrace().
+/// @param[out] rBundles  Object paths to append to the dependency manifest of the first object in each bundle.
+void Cache::BuildBundles(
+	const DynamicArray< const Entry* >& rReads,
+	const DynamicArray< ReplayBatch >& rBatches,
+	BundleMap& rBundles ) const
+{
+	rBundles.Clear();
+
+	const ReplayBatch* pLeaderBatch = NULL;
+	uint64_t bundleSize = 0;
+	uint64_t previousTime = 0;
+
+	size_t batchCount = rBatches.GetSize();
+	for( size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex )
+	{
+		const ReplayBatch& rBatch = rBatches[ batchIndex ];
+		if( !rBatch.pManifestEntry )
 		{
-			return false;
+			continue;
 		}
 
-		int64_t entryTimestamp;
-		if( !CheckedTocRead( pLoadFunction, entryTimestamp, "entry timestamp", pTocCurrent, pTocMax ) )
+		// Only the object itself and its prefetched dependencies move into the bundle.
+		uint64_t batchSize = rBatch.pObjectEntry->storedSize;
+		const Entry* const* ppPrefetchReads = rReads.GetData() + rBatch.readIndex + rBatch.demandReadCount;
+		for( size_t prefetchIndex = 0; prefetchIndex < rBatch.prefetchReadCount; ++prefetchIndex )
 		{
-			return false;
+			batchSize += ppPrefetchReads[ prefetchIndex ]->storedSize;
 		}
 
-		uint32_t entrySize;
-		if( !CheckedTocRead( pLoadFunction, entrySize, "entry size", pTocCurrent, pTocMax ) )
+		if( pLeaderBatch &&
+			rBatch.time <= previousTime + BUNDLE_REQUEST_INTERVAL_MAX &&
+			bundleSize + batchSize <= BUNDLE_SIZE_MAX )
 		{
-			return false;
-		}
+			BundleMap::Iterator bundleIterator = rBundles.Find( pLeaderBatch->pManifestEntry );
+			if( bundleIterator == rBundles.End() )
+			{
+				HELIUM_VERIFY( rBundles.Insert(
+					bundleIterator,
+					BundleMap::ValueType( pLeaderBatch->pManifestEntry, DynamicArray< AssetPath >() ) ) );
+			}
 
-		Entry* pEntry = m_pEntryPool->Allocate();
-		HELIUM_ASSERT( pEntry );
-		pEntry->path = entryPath;
-		pEntry->subDataIndex = entrySubDataIndex;
-		pEntry->offset = entryOffset;
-		pEntry->timestamp = entryTimestamp;
-		pEntry->size = entrySize;
+			DynamicArray< AssetPath >& rBundlePaths = bundleIterator->Second();
+			rBundlePaths.Push( rBatch.pObjectEntry->path );
+			for( size_t prefetchIndex = 0; prefetchIndex < rBatch.prefetchReadCount; ++prefetchIndex )
+			{
+				rBundlePaths.Push( ppPrefetchReads[ prefetchIndex ]->path );
+			}
 
-		m_entries.Add( pEntry );
+			bundleSize += batchSize;
+		}
+		else
+		{
+			pLeaderBatch = &rBatch;
+			bundleSize = batchSize - rBatch.pObjectEntry->storedSize;
+		}
 
-		HELIUM_VERIFY( m_entryMap.Insert( entryAccessor, KeyValue< EntryKey, Entry* >( key, pEntry ) ) );
+		previousTime = rBatch.time;
 	}
-
-	return true;
 }
+#endif  // HELIUM_TOOLS
 
 /// Read a value from the cache TOC, check the TOC bounds in the process.
 ///
@@ -767,6 +2269,115 @@ bool Cache::CheckedTocRead(
 	return true;
 }
 
+/// Map the contents of a file into memory.
+///
+/// @param[in]  rFileName    File to map.
+/// @param[out] rMappedFile  File mapping.
+///
+/// @return  True if the file was mapped successfully, false if not (empty files cannot be mapped).
+///
+/// @see UnmapFile()
+bool Cache::MapFile( const String& rFileName, MappedFile& rMappedFile )
+{
+	rMappedFile = MappedFile();
+
+#if HELIUM_OS_WIN
+	HANDLE hFile = CreateFileA(
+		rFileName.GetData(),
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+		NULL );
+	if( hFile == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( hFile, &fileSize ) || fileSize.QuadPart <= 0 )
+	{
+		CloseHandle( hFile );
+
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if( !hMapping )
+	{
+		CloseHandle( hFile );
+
+		return false;
+	}
+
+	void* pData = MapViewOfFile( hMapping, FILE_MAP_COPY, 0, 0, 0 );
+	if( !pData )
+	{
+		CloseHandle( hMapping );
+		CloseHandle( hFile );
+
+		return false;
+	}
+
+	rMappedFile.hFile = hFile;
+	rMappedFile.hMapping = hMapping;
+	rMappedFile.size = static_cast< uint64_t >( fileSize.QuadPart );
+#else
+	int fileDescriptor = open( rFileName.GetData(), O_RDONLY | O_CLOEXEC );
+	if( fileDescriptor < 0 )
+	{
+		return false;
+	}
+
+	struct stat fileStatus;
+	if( fstat( fileDescriptor, &fileStatus ) != 0 || fileStatus.st_size <= 0 )
+	{
+		close( fileDescriptor );
+
+		return false;
+	}
+
+	size_t mappingSize = static_cast< size_t >( fileStatus.st_size );
+	void* pData = mmap( NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0 );
+
+	// The mapping holds its own reference to the file.
+	close( fileDescriptor );
+
+	if( pData == MAP_FAILED )
+	{
+		return false;
+	}
+
+	rMappedFile.size = static_cast< uint64_t >( mappingSize );
+#endif
+
+	rMappedFile.pData = static_cast< uint8_t* >( pData );
+
+	return true;
+}
+
+/// Release a file mapping created with MapFile().
+///
+/// @param[in] rMappedFile  File mapping to release.  This is reset to an empty mapping.
+///
+/// @see MapFile()
+void Cache::UnmapFile( MappedFile& rMappedFile )
+{
+	if( rMappedFile.pData )
+	{
+#if HELIUM_OS_WIN
+		UnmapViewOfFile( rMappedFile.pData );
+		CloseHandle( rMappedFile.hMapping );
+		CloseHandle( rMappedFile.hFile );
+#else
+		munmap( rMappedFile.pData, static_cast< size_t >( rMappedFile.size ) );
+#endif
+	}
+
+	rMappedFile = MappedFile();
+}
+
 /// Equality comparison.
 ///
 /// @param[in] rOther  Entry key with which to compare.
@@ -791,16 +2402,131 @@ size_t Cache::EntryKeyHash::operator()( const EntryKey& rKey ) const
 	return hash;
 }
 
+/// Constructor.
+Cache::MappedFile::MappedFile()
+: pData( NULL )
+, size( 0 )
+#if HELIUM_OS_WIN
+, hFile( NULL )
+, hMapping( NULL )
+#endif
+{
+}
+
+/// Constructor.
+Cache::ReplayStatistics::ReplayStatistics()
+: requestCount( 0 )
+, readCount( 0 )
+, seekCount( 0 )
+, bytesRead( 0 )
+{
+}
+
 #if HELIUM_TOOLS
-void Helium::Cache::WriteCacheObjectToBuffer( Reflect::Object* _object, DynamicArray< uint8_t > &_buffer )
+void Helium::Cache::WriteCacheObjectToBuffer(
+	Reflect::Object* _object,
+	DynamicArray< uint8_t > &_buffer,
+	DynamicArray< AssetPath >* pDependencies )
 {
-	AssetIdentifier identifier;
+	AssetIdentifier identifier( pDependencies );
 
 	DynamicMemoryStream archiveStream ( &_buffer );
 	CacheArchiveWriter::WriteToStream( _object, archiveStream, &identifier );
 }
+
+/// Serialize a list of object dependencies for storage under DEPENDENCY_MANIFEST_SUB_DATA_INDEX.
+///
+/// The manifest consists of a path count followed by each path as a length-prefixed, null-terminated string.
+///
+/// @param[in]  rDependencies  Paths of the objects on which an object depends.
+/// @param[out] rBuffer        Buffer in which to store the serialized manifest.
+///
+/// @see ReadDependencyManifest()
+void Helium::Cache::WriteDependencyManifest(
+	const DynamicArray< AssetPath >& rDependencies,
+	DynamicArray< uint8_t >& rBuffer )
+{
+	rBuffer.Resize( 0 );
+
+	DynamicMemoryStream manifestStream( &rBuffer );
+
+	size_t dependencyCount = rDependencies.GetSize();
+	HELIUM_ASSERT( dependencyCount <= UINT32_MAX );
+	uint32_t dependencyCount32 = static_cast< uint32_t >( dependencyCount );
+	manifestStream.Write( &dependencyCount32, sizeof( dependencyCount32 ), 1 );
+
+	String pathString;
+	for( size_t dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex )
+	{
+		rDependencies[ dependencyIndex ].ToString( pathString );
+
+		uint32_t pathSize = static_cast< uint32_t >( pathString.GetSize() + 1 );
+		manifestStream.Write( &pathSize, sizeof( pathSize ), 1 );
+		manifestStream.Write( *pathString, 1, pathSize );
+	}
+
+	manifestStream.Close();
+}
 #endif
 
+/// Parse a dependency manifest previously written using WriteDependencyManifest().
+///
+/// @param[in]  pData          Manifest data.
+/// @param[in]  size           Size of the manifest data, in bytes.
+/// @param[out] rDependencies  Paths of the objects listed in the manifest.
+///
+/// @return  True if the manifest was parsed successfully, false if it was malformed.  Any paths read up to the
+///          point of an error are still returned.
+bool Helium::Cache::ReadDependencyManifest(
+	const uint8_t* pData,
+	size_t size,
+	DynamicArray< AssetPath >& rDependencies )
+{
+	HELIUM_ASSERT( pData || size == 0 );
+
+	rDependencies.Resize( 0 );
+
+	const uint8_t* pDataEnd = pData + size;
+
+	uint32_t dependencyCount;
+	if( size < sizeof( dependencyCount ) )
+	{
+		return false;
+	}
+
+	MemoryCopy( &dependencyCount, pData, sizeof( dependencyCount ) );
+	pData += sizeof( dependencyCount );
+
+	rDependencies.Reserve( dependencyCount );
+
+	for( uint32_t dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex )
+	{
+		uint32_t pathSize;
+		if( static_cast< size_t >( pDataEnd - pData ) < sizeof( pathSize ) )
+		{
+			return false;
+		}
+
+		MemoryCopy( &pathSize, pData, sizeof( pathSize ) );
+		pData += sizeof( pathSize );
+
+		if( pathSize == 0 || pathSize > static_cast< size_t >( pDataEnd - pData ) || pData[ pathSize - 1 ] != '\0' )
+		{
+			return false;
+		}
+
+		AssetPath path;
+		if( path.Set( reinterpret_cast< const char* >( pData ) ) )
+		{
+			rDependencies.Push( path );
+		}
+
+		pData += pathSize;
+	}
+
+	return true;
+}
+
 Reflect::ObjectPtr Helium::Cache::ReadCacheObjectFromBuffer( const DynamicArray< uint8_t > &_buffer, Reflect::ObjectResolver *_resolver )
 {
 	if (_buffer.GetSize() == 0)
@@ -3,14 +3,33 @@
 #include "Engine/Engine.h"
 #include "Reflect/Translator.h"
 
+#include "Platform/Locks.h"
+
 #include "Foundation/ConcurrentHashMap.h"
+#include "Foundation/HashMap.h"
 #include "Foundation/ObjectPool.h"
 #include "Engine/AssetPath.h"
+#include "Engine/Compression.h"
 #include "Reflect/Object.h"
 
 namespace Helium
 {
+	class FileStream;
+	class LoadTrace;
+
 	/// Serialization cache interface.
+	///
+	/// When memory mapping is enabled, the TOC is parsed directly out of a mapping of the TOC file, and the cache file
+	/// itself is mapped so that entry data can be accessed in place through GetEntryData() rather than read through
+	/// the AsyncLoader into a separate buffer.
+	///
+	/// The TOC is stored as a table of fixed-size records sorted by a hash of the entry path, followed by a pool of
+	/// path strings and a journal of entries appended since the table was last written.  The table is searched in
+	/// place, so entries are only created (and their paths only added to the AssetPath table) when first looked up.
+	///
+	/// Entries may be stored compressed, in which case the TOC records both their stored and uncompressed sizes.
+	/// Compressed entries are always loaded through the AsyncLoader (see QueueEntryLoad()), which decompresses them on
+	/// its worker threads.
 	class HELIUM_ENGINE_API Cache : NonCopyable
 	{
 	public:
@@ -19,6 +38,15 @@ namespace Helium
 
 		/// Default Entry pool block size (for use with modifiable caches on the PC).
 		static const size_t ENTRY_POOL_BLOCK_SIZE = 64;
+		/// Minimum number of TOC journal records allowed before the TOC is rewritten in full.
+		static const uint32_t TOC_JOURNAL_LIMIT_MIN = 256;
+		/// Sub-data index under which the dependency manifest of an object is stored.
+		static const uint32_t DEPENDENCY_MANIFEST_SUB_DATA_INDEX = 0xfffffffe;
+		/// Maximum time between the on-demand object requests grouped into a bundle by OptimizeLayout(), in
+		/// microseconds.
+		static const uint32_t BUNDLE_REQUEST_INTERVAL_MAX = 5000;
+		/// Maximum amount of data prefetched through a single bundle laid out by OptimizeLayout(), in bytes.
+		static const uint32_t BUNDLE_SIZE_MAX = 256 * 1024;
 
 		/// Cache platforms.
 		enum EPlatform
@@ -41,14 +69,38 @@ namespace Helium
 			uint64_t offset;
 			/// Entry timestamp.
 			int64_t timestamp;
+			/// Hash of the inputs from which the entry data was built (zero if unknown).
+			uint64_t contentHash;
 
 			/// Entry path name.
 			AssetPath path;
 			/// Sub-data index.
 			uint32_t subDataIndex;
 
-			/// Entry size.
+			/// Entry size (after decompression).
 			uint32_t size;
+			/// Number of bytes occupied by the entry in the cache file.
+			uint32_t storedSize;
+			/// Format in which the entry is stored.
+			Compression::EType compression;
+		};
+
+		/// Results of replaying a load trace against the layout of a cache.
+		struct ReplayStatistics
+		{
+			/// Number of requests for entries in the cache.
+			uint32_t requestCount;
+			/// Number of reads issued, counting adjacent reads that would be merged by the AsyncLoader as one.
+			uint32_t readCount;
+			/// Number of reads that did not start where the previous read ended.
+			uint32_t seekCount;
+			/// Number of bytes read.
+			uint64_t bytesRead;
+
+			/// @name Construction/Destruction
+			//@{
+			ReplayStatistics();
+			//@}
 		};
 
 		/// @name Construction/Destruction
@@ -59,7 +111,9 @@ namespace Helium
 
 		/// @name Initialization
 		//@{
-		bool Initialize( Name name, EPlatform platform, const char* pTocFileName, const char* pCacheFileName );
+		bool Initialize(
+			Name name, EPlatform platform, const char* pTocFileName, const char* pCacheFileName,
+			bool bMemoryMapped = false );
 		void Shutdown();
 		//@}
 
@@ -83,13 +137,39 @@ namespace Helium
 		inline uint32_t GetEntryCount() const;
 		inline const Entry& GetEntry( uint32_t index ) const;
 		const Entry* FindEntry( AssetPath path, uint32_t subDataIndex ) const;
+		void LoadAllEntries();
+
+		bool CacheEntry(
+			AssetPath path, uint32_t subDataIndex, const void* pData, int64_t timestamp, uint32_t size,
+			uint64_t contentHash = 0, Compression::EType compression = Compression::TYPE_NONE );
 
-		bool CacheEntry( AssetPath path, uint32_t subDataIndex, const void* pData, int64_t timestamp, uint32_t size );
+		size_t QueueEntryLoad( const Entry& rEntry, void* pBuffer, size_t size ) const;
+		bool ReadEntryData( const Entry& rEntry, FileStream* pCacheStream, DynamicArray< uint8_t >& rData ) const;
 		//@}
 
+		/// @name Memory Mapping
+		//@{
+		inline bool IsMemoryMapped() const;
+		bool GetEntryData( const Entry& rEntry, const uint8_t*& rpData );
+		//@}
+
+		/// @name Layout Optimization
+		//@{
+		bool ReplayLoadTrace( const LoadTrace& rTrace, ReplayStatistics& rStatistics ) const;
 #if HELIUM_TOOLS
-		static void WriteCacheObjectToBuffer( Helium::Reflect::Object* _object, DynamicArray< uint8_t > &_buffer );
+		bool OptimizeLayout( const LoadTrace& rTrace, bool bBundle = false );
 #endif
+		//@}
+
+#if HELIUM_TOOLS
+		static void WriteCacheObjectToBuffer(
+			Helium::Reflect::Object* _object, DynamicArray< uint8_t > &_buffer,
+			DynamicArray< AssetPath >* pDependencies = NULL );
+		static void WriteDependencyManifest(
+			const DynamicArray< AssetPath >& rDependencies, DynamicArray< uint8_t >& rBuffer );
+#endif
+		static bool ReadDependencyManifest(
+			const uint8_t* pData, size_t size, DynamicArray< AssetPath >& rDependencies );
 		static Reflect::ObjectPtr ReadCacheObjectFromBuffer( const DynamicArray< uint8_t > &_buffer, Reflect::ObjectResolver *pResolver = 0 );
 		static Reflect::ObjectPtr ReadCacheObjectFromBuffer( const uint8_t *_buffer, const size_t _offset, const size_t _count, Reflect::ObjectResolver *pResolver = 0 );
 
@@ -124,6 +204,49 @@ namespace Helium
 		/// Cache entry hash map type.
 		typedef ConcurrentHashMap< EntryKey, Entry*, EntryKeyHash > EntryMapType;
 
+		/// Sorted TOC table record.
+		struct TocRecord;
+
+		/// Group of reads issued together while simulating a load trace.
+		struct ReplayBatch
+		{
+			/// Index of the first read in the batch.
+			size_t readIndex;
+			/// Number of reads issued immediately for the request that started the batch.
+			size_t demandReadCount;
+			/// Number of reads issued afterward for the dependencies listed in a dependency manifest.
+			size_t prefetchReadCount;
+			/// Time of the request that started the batch, in microseconds since the start of the trace.
+			uint64_t time;
+			/// Object loaded along with its dependency manifest, if any.
+			const Entry* pObjectEntry;
+			/// Dependency manifest of the object, if any.
+			const Entry* pManifestEntry;
+		};
+
+		/// Object paths to append to dependency manifests, keyed on the manifest entry.
+		typedef HashMap< const Entry*, DynamicArray< AssetPath > > BundleMap;
+
+		/// Memory mapped file view.
+		struct MappedFile
+		{
+			/// Mapped file contents (mapped copy-on-write, so the file itself is never modified).
+			uint8_t* pData;
+			/// Size of the mapping, in bytes.
+			uint64_t size;
+#if HELIUM_OS_WIN
+			/// File handle.
+			void* hFile;
+			/// File mapping object handle.
+			void* hMapping;
+#endif
+
+			/// @name Construction/Destruction
+			//@{
+			MappedFile();
+			//@}
+		};
+
 		/// Cache name.
 		Name m_name;
 		/// Cache platform.
@@ -148,13 +271,70 @@ namespace Helium
 		/// Cache entry pool.
 		ObjectPool< Entry >* m_pEntryPool;
 		/// Cache entry information.
-		DynamicArray< Entry* > m_entries;
+		mutable DynamicArray< Entry* > m_entries;
 		/// Entry lookup hash map.
-		EntryMapType m_entryMap;
+		mutable EntryMapType m_entryMap;
+		/// Mutex protecting entry creation and removal, and the TOC table while entries are still looked up from it.
+		mutable Mutex m_entryLock;
+		/// Mutex serializing cache updates.
+		Mutex m_updateLock;
+
+		/// Sorted TOC table records (within the TOC buffer or mapping), if entries are still being looked up from it.
+		const TocRecord* m_pTocRecords;
+		/// Number of sorted TOC table records.
+		uint32_t m_tocRecordCount;
+		/// TOC path string pool.
+		const char* m_pTocStringPool;
+		/// Size of the TOC path string pool, in bytes.
+		uint32_t m_tocStringPoolSize;
+		/// Mapping of the TOC file, if the TOC table is being searched in place from a mapping.
+		MappedFile m_tocMapping;
+		/// True once an entry has been created for every record in the TOC table.
+		mutable volatile bool m_bAllTocEntriesLoaded;
+		/// Number of records in the TOC journal, or an invalid index if the TOC file can't be appended to.
+		uint32_t m_tocJournalRecordCount;
+
+		/// True if the TOC and cache files should be accessed through memory mappings.
+		bool m_bMemoryMapped;
+		/// Current mapping of the cache file.
+		MappedFile m_cacheMapping;
+		/// Previous mappings of the cache file, kept alive until shutdown as entry data views may still reference them.
+		DynamicArray< MappedFile > m_retiredCacheMappings;
+		/// Mutex protecting the cache file mappings.
+		Mutex m_mappingLock;
 
 		/// @name Loading Utility Functions
 		//@{
 		bool FinalizeTocLoad();
+		bool FinalizeTocTableLoad();
+		void ProcessLoadedToc( size_t bytesRead );
+		void ReleaseTocTable();
+
+		Entry* LoadTocEntry( const EntryKey& rKey ) const;
+		void LoadAllTocEntries() const;
+		uint32_t FindTocRecord( uint64_t pathHash, uint32_t subDataIndex, const String& rPath ) const;
+		const char* GetTocRecordPath( const TocRecord& rRecord ) const;
+		//@}
+
+		/// @name TOC Writing Utility Functions
+		//@{
+		bool WriteToc();
+		bool AppendTocJournal( const Entry& rEntry );
+		//@}
+
+		/// @name Layout Utility Functions
+		//@{
+		void SimulateLoadTrace(
+			const LoadTrace& rTrace, FileStream* pCacheStream, const BundleMap* pBundles,
+			DynamicArray< const Entry* >& rReads, DynamicArray< ReplayBatch >& rBatches ) const;
+		bool ReadReplayManifest(
+			const Entry& rManifestEntry, FileStream* pCacheStream, const BundleMap* pBundles,
+			DynamicArray< AssetPath >& rDependencies ) const;
+#if HELIUM_TOOLS
+		void BuildBundles(
+			const DynamicArray< const Entry* >& rReads, const DynamicArray< ReplayBatch >& rBatches,
+			BundleMap& rBundles ) const;
+#endif
 		//@}
 
 		/// @name Private Static Utility Functions
@@ -162,6 +342,9 @@ namespace Helium
 		template< typename T > static bool CheckedTocRead(
 			LOAD_VALUE_CALLBACK* pLoadFunction, T& rValue, const char* pDescription, const uint8_t*& rpTocCurrent,
 			const uint8_t* pTocMax );
+
+		static bool MapFile( const String& rFileName, MappedFile& rMappedFile );
+		static void UnmapFile( MappedFile& rMappedFile );
 		//@}
 	};
 }
@@ -8,6 +8,16 @@ bool Helium::Cache::IsTocLoaded() const
     return m_bTocLoaded;
 }
 
+/// Get whether the TOC and cache files of this cache are accessed through memory mappings.
+///
+/// @return  True if memory mapping is enabled, false if not.
+///
+/// @see GetEntryData()
+bool Helium::Cache::IsMemoryMapped() const
+{
+    return m_bMemoryMapped;
+}
+
 /// Get the name used to identify this cache.
 ///
 /// @return  Cache name.
@@ -51,6 +61,11 @@ const Helium::String& Helium::Cache::GetCacheFileName() const
 /// @see GetEntry()
 uint32_t Helium::Cache::GetEntryCount() const
 {
+    if( !m_bAllTocEntriesLoaded )
+    {
+        LoadAllTocEntries();
+    }
+
     size_t entryCount = m_entries.GetSize();
     HELIUM_ASSERT( entryCount <= UINT32_MAX );
 
@@ -66,6 +81,11 @@ uint32_t Helium::Cache::GetEntryCount() const
 /// @see GetEntryCount()
 const Helium::Cache::Entry& Helium::Cache::GetEntry( uint32_t index ) const
 {
+    if( !m_bAllTocEntriesLoaded )
+    {
+        LoadAllTocEntries();
+    }
+
     HELIUM_ASSERT( index < m_entries.GetSize() );
 
     Entry* pEntry = m_entries[ index ];
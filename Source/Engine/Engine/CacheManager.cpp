@@ -14,6 +14,7 @@ CacheManager* CacheManager::sm_pInstance = NULL;
 /// Constructor.
 CacheManager::CacheManager( const FilePath& rBaseDirectory )
 	: m_cachePool( CACHE_POOL_BLOCK_SIZE )
+	, m_bMemoryMappingEnabled( false )
 {
 	m_platformDataDirectories[ Cache::PLATFORM_PC ] = rBaseDirectory.Data();
 	m_platformDataDirectories[ Cache::PLATFORM_PC ] += "DataPC/";
@@ -73,7 +74,7 @@ Cache* CacheManager::GetCache( Name name, Cache::EPlatform platform )
 
 	cacheFileName += "." HELIUM_CACHE_EXTENSION;
 
-	if( !pCache->Initialize( name, platform, *tocFileName, *cacheFileName ) )
+	if( !pCache->Initialize( name, platform, *tocFileName, *cacheFileName, m_bMemoryMappingEnabled ) )
 	{
 		HELIUM_TRACE( TraceLevels::Error, "CacheManager: Failed to initialize cache \"%s\".\n", *name );
 
@@ -94,6 +95,28 @@ Cache* CacheManager::GetCache( Name name, Cache::EPlatform platform )
 	return pCache;
 }
 
+/// Set whether caches should access their TOC and cache files through memory mappings.
+///
+/// This only affects caches that have not yet been created, so it should be set before any loading begins.
+///
+/// @param[in] bEnabled  True to memory map caches, false to load them through the AsyncLoader.
+///
+/// @see IsMemoryMappingEnabled()
+void CacheManager::SetMemoryMappingEnabled( bool bEnabled )
+{
+	m_bMemoryMappingEnabled = bEnabled;
+}
+
+/// Get whether newly created caches will access their TOC and cache files through memory mappings.
+///
+/// @return  True if memory mapping is enabled, false if not.
+///
+/// @see SetMemoryMappingEnabled()
+bool CacheManager::IsMemoryMappingEnabled() const
+{
+	return m_bMemoryMappingEnabled;
+}
+
 /// Get the cache data directory for the specified platform.
 ///
 /// @param[in] platform  Target platform, or Cache::PLATFORM_INVALID name to use the current platform.
@@ -21,6 +21,9 @@ namespace Helium
 		/// @name Cache Access
 		//@{
 		Cache* GetCache( Name name, Cache::EPlatform platform = Cache::PLATFORM_INVALID );
+
+		void SetMemoryMappingEnabled( bool bEnabled );
+		bool IsMemoryMappingEnabled() const;
 		//@}
 
 		/// @name Filesystem Information
@@ -48,6 +51,8 @@ namespace Helium
 		ObjectPool< Cache > m_cachePool;
 		/// Cache lookup tables.
 		ConcurrentHashMap< Name, Cache* > m_cacheMaps[ Cache::PLATFORM_MAX ];
+		/// True if caches created from here on should be memory mapped.
+		bool m_bMemoryMappingEnabled;
 
 		/// Singleton instance.
 		static CacheManager* sm_pInstance;
@@ -7,13 +7,27 @@
 #include "Engine/CacheManager.h"
 #include "Engine/Resource.h"
 
+#include <algorithm>
+
 using namespace Helium;
 
+/// Sort comparison function for ordering cache entries by their location in the cache file.
+///
+/// @param[in] pEntry0  First entry.
+/// @param[in] pEntry1  Second entry.
+///
+/// @return  True if the first entry is stored before the second, false if not.
+static bool EntryOffsetLess( const Cache::Entry* pEntry0, const Cache::Entry* pEntry1 )
+{
+	return ( pEntry0->offset < pEntry1->offset );
+}
+
 /// Constructor.
 CachePackageLoader::CachePackageLoader()
 : m_pCache( NULL )
 , m_bFinishedCacheTocLoad( false )
 , m_loadRequestPool( LOAD_REQUEST_POOL_BLOCK_SIZE )
+, m_prefetchBufferSize( 0 )
 {
 }
 
@@ -84,6 +98,20 @@ void CachePackageLoader::Shutdown()
 
 	m_loadRequests.Clear();
 
+	size_t manifestRequestCount = m_manifestRequests.GetSize();
+	for( size_t requestIndex = 0; requestIndex < manifestRequestCount; ++requestIndex )
+	{
+		PrefetchRequest& rManifestRequest = m_manifestRequests[ requestIndex ];
+		pAsyncLoader->SyncRequest( rManifestRequest.asyncLoadId );
+		allocator.Free( rManifestRequest.pAsyncLoadBuffer );
+	}
+
+	m_manifestRequests.Clear();
+
+	ReleasePrefetches( true );
+	HELIUM_ASSERT( m_prefetchRequests.IsEmpty() );
+	HELIUM_ASSERT( m_prefetchBufferSize == 0 );
+
 	m_pCache = NULL;
 	m_bFinishedCacheTocLoad = false;
 }
@@ -149,6 +177,7 @@ size_t CachePackageLoader::BeginLoadObject( AssetPath path, Reflect::ObjectResol
 
 		SetInvalid( pRequest->asyncLoadId );
 		pRequest->pAsyncLoadBuffer = NULL;
+		pRequest->pCacheData = NULL;
 		pRequest->pPropertyDataBegin = NULL;
 		pRequest->pPropertyDataEnd = NULL;
 		pRequest->pPersistentResourceDataBegin = NULL;
@@ -175,6 +204,12 @@ size_t CachePackageLoader::BeginLoadObject( AssetPath path, Reflect::ObjectResol
 		return Invalid< size_t >();
 	}
 
+	AssetLoader* pAssetLoader = AssetLoader::GetInstance();
+	if( pAssetLoader )
+	{
+		pAssetLoader->RecordLoadTraceRequest( m_pCache->GetName(), path, 0 );
+	}
+
 #ifndef NDEBUG
 	size_t loadRequestSize = m_loadRequests.GetSize();
 	for( size_t loadRequestIndex = 0; loadRequestIndex < loadRequestSize; ++loadRequestIndex )
@@ -206,6 +241,7 @@ size_t CachePackageLoader::BeginLoadObject( AssetPath path, Reflect::ObjectResol
 	HELIUM_ASSERT( !pRequest->spObject );
 	SetInvalid( pRequest->asyncLoadId );
 	pRequest->pAsyncLoadBuffer = NULL;
+	pRequest->pCacheData = NULL;
 	pRequest->pPropertyDataBegin = NULL;
 	pRequest->pPropertyDataEnd = NULL;
 	pRequest->pPersistentResourceDataBegin = NULL;
@@ -233,25 +269,38 @@ size_t CachePackageLoader::BeginLoadObject( AssetPath path, Reflect::ObjectResol
 	else
 	{
 		HELIUM_ASSERT( !pObject || !pObject->GetAnyFlagSet( Asset::FLAG_LOADED | Asset::FLAG_LINKED ) );
+	}
 
-		HELIUM_TRACE(
-			TraceLevels::Debug,
-			"CachePackageLoader::BeginLoadObject(): Issuing async load of property data for \"%s\".\n",
-			*path.ToString() );
+	// If the cache is memory mapped, the property data can be used in place and is picked up on the next tick.
+	if( !( pRequest->flags & LOAD_FLAG_PRELOADED ) && !m_pCache->GetEntryData( *pEntry, pRequest->pCacheData ) )
+	{
+		if( ClaimPrefetch( pRequest ) )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Debug,
+				"CachePackageLoader::BeginLoadObject(): Using prefetched property data for \"%s\".\n",
+				*path.ToString() );
+		}
+		else
+		{
+			HELIUM_TRACE(
+				TraceLevels::Debug,
+				"CachePackageLoader::BeginLoadObject(): Issuing async load of property data for \"%s\".\n",
+				*path.ToString() );
 
-		size_t entrySize = pEntry->size;
-		pRequest->pAsyncLoadBuffer = static_cast< uint8_t* >( DefaultAllocator().Allocate( entrySize ) );
-		HELIUM_ASSERT( pRequest->pAsyncLoadBuffer );
+			// This object was not listed in the dependency manifest of an object already being loaded, so read its
+			// own manifest first in order to request all of its dependencies at once.
+			BeginLoadDependencyManifest( pEntry );
 
-		AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
-		HELIUM_ASSERT( pAsyncLoader );
+			size_t entrySize = pEntry->size;
+			pRequest->pAsyncLoadBuffer = static_cast< uint8_t* >( DefaultAllocator().Allocate( entrySize ) );
+			HELIUM_ASSERT( pRequest->pAsyncLoadBuffer );
+
+			pRequest->asyncLoadId = m_pCache->QueueEntryLoad( *pEntry, pRequest->pAsyncLoadBuffer, entrySize );
+			HELIUM_ASSERT( IsValid( pRequest->asyncLoadId ) );
 
-		pRequest->asyncLoadId = pAsyncLoader->QueueRequest(
-			pRequest->pAsyncLoadBuffer,
-			m_pCache->GetCacheFileName(),
-			pEntry->offset,
-			entrySize );
-		HELIUM_ASSERT( IsValid( pRequest->asyncLoadId ) );
+			pRequest->pCacheData = pRequest->pAsyncLoadBuffer;
+		}
 	}
 
 	size_t requestId = m_loadRequests.Add( pRequest );
@@ -333,7 +382,12 @@ bool CachePackageLoader::TryFinishLoadObject( size_t requestId, AssetPtr& rspObj
 /// Update this package loader.
 void CachePackageLoader::Tick()
 {
+	// Issue prefetches for the dependencies listed in any manifests that have finished loading.
+	TickDependencyManifests();
+
 	// Process pending load requests.
+	bool bHasPendingLoads = false;
+
 	size_t loadRequestSize = m_loadRequests.GetSize();
 	for( size_t loadRequestIndex = 0; loadRequestIndex < loadRequestSize; ++loadRequestIndex )
 	{
@@ -342,12 +396,14 @@ void CachePackageLoader::Tick()
 			continue;
 		}
 
+		bHasPendingLoads = true;
+
 		LoadRequest* pRequest = m_loadRequests[ loadRequestIndex ];
 		HELIUM_ASSERT( pRequest );
 
 		if( !( pRequest->flags & LOAD_FLAG_PRELOADED ) )
 		{
-			if( IsValid( pRequest->asyncLoadId ) )
+			if( !pRequest->pPropertyDataBegin )
 			{
 				if( !TickCacheLoad( pRequest ) )
 				{
@@ -363,11 +419,26 @@ void CachePackageLoader::Tick()
 					continue;
 				}
 			}
+
+			// Let the asset loader know that the object is ready to be picked up.
+			AssetLoader* pAssetLoader = AssetLoader::GetInstance();
+			if( pAssetLoader )
+			{
+				HELIUM_ASSERT( pRequest->pEntry );
+				pAssetLoader->WakeLoadRequest( pRequest->pEntry->path );
+			}
 		}
 
 		HELIUM_ASSERT( IsInvalid( pRequest->asyncLoadId ) );
 		HELIUM_ASSERT( pRequest->pAsyncLoadBuffer == NULL );
 	}
+
+	// Once nothing is left loading, any prefetched data that wasn't claimed (such as for objects that turned out to
+	// already be in memory) will not be needed.
+	if( !bHasPendingLoads && m_manifestRequests.IsEmpty() )
+	{
+		ReleasePrefetches( false );
+	}
 }
 
 /// @copydoc PackageLoader::GetObjectCount()
@@ -399,16 +470,26 @@ bool CachePackageLoader::TickCacheLoad( LoadRequest* pRequest )
 	HELIUM_ASSERT( pRequest );
 	HELIUM_ASSERT( !( pRequest->flags & LOAD_FLAG_PRELOADED ) );
 
-	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
-	HELIUM_ASSERT( pAsyncLoader );
-
 	size_t bytesRead = 0;
-	if( !pAsyncLoader->TrySyncRequest( pRequest->asyncLoadId, bytesRead ) )
+	if( IsValid( pRequest->asyncLoadId ) )
 	{
-		return false;
-	}
+		AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+		HELIUM_ASSERT( pAsyncLoader );
 
-	SetInvalid( pRequest->asyncLoadId );
+		if( !pAsyncLoader->TrySyncRequest( pRequest->asyncLoadId, bytesRead ) )
+		{
+			return false;
+		}
+
+		SetInvalid( pRequest->asyncLoadId );
+	}
+	else
+	{
+		// Data is already available in the memory mapped cache file.
+		HELIUM_ASSERT( pRequest->pCacheData );
+		HELIUM_ASSERT( pRequest->pEntry );
+		bytesRead = pRequest->pEntry->size;
+	}
 
 	if( bytesRead == 0 || IsInvalid( bytesRead ) )
 	{
@@ -421,7 +502,7 @@ bool CachePackageLoader::TickCacheLoad( LoadRequest* pRequest )
 	}
 	else
 	{
-		uint8_t* pBufferEnd = pRequest->pAsyncLoadBuffer + bytesRead;
+		const uint8_t* pBufferEnd = pRequest->pCacheData + bytesRead;
 		pRequest->pPropertyDataEnd = pBufferEnd;
 		pRequest->pPersistentResourceDataEnd = pBufferEnd;
 
@@ -435,6 +516,7 @@ bool CachePackageLoader::TickCacheLoad( LoadRequest* pRequest )
 	// else will be done with the object itself from here on out).
 	DefaultAllocator().Free( pRequest->pAsyncLoadBuffer );
 	pRequest->pAsyncLoadBuffer = NULL;
+	pRequest->pCacheData = NULL;
 
 	Asset* pObject = pRequest->spObject;
 	if( pObject )
@@ -486,6 +568,7 @@ bool CachePackageLoader::TickDeserialize( LoadRequest* pRequest )
 
 			DefaultAllocator().Free( pRequest->pAsyncLoadBuffer );
 			pRequest->pAsyncLoadBuffer = NULL;
+			pRequest->pCacheData = NULL;
 
 			pRequest->flags |= LOAD_FLAG_PRELOADED | LOAD_FLAG_ERROR;
 
@@ -561,6 +644,7 @@ bool CachePackageLoader::TickDeserialize( LoadRequest* pRequest )
 
 	DefaultAllocator().Free( pRequest->pAsyncLoadBuffer );
 	pRequest->pAsyncLoadBuffer = NULL;
+	pRequest->pCacheData = NULL;
 
 	pObject->SetFlags( Asset::FLAG_PRELOADED );
 
@@ -570,6 +654,239 @@ bool CachePackageLoader::TickDeserialize( LoadRequest* pRequest )
 	return true;
 }
 
+/// Begin reading the dependency manifest cached for an object.
+///
+/// @param[in] pObjectEntry  Cache entry of the object being loaded.
+///
+/// @see TickDependencyManifests()
+void CachePackageLoader::BeginLoadDependencyManifest( const Cache::Entry* pObjectEntry )
+{
+	HELIUM_ASSERT( m_pCache );
+	HELIUM_ASSERT( pObjectEntry );
+
+	const Cache::Entry* pManifestEntry = m_pCache->FindEntry(
+		pObjectEntry->path,
+		Cache::DEPENDENCY_MANIFEST_SUB_DATA_INDEX );
+	if( !pManifestEntry || pManifestEntry->size == 0 )
+	{
+		return;
+	}
+
+	PrefetchRequest* pManifestRequest = m_manifestRequests.New();
+	HELIUM_ASSERT( pManifestRequest );
+	pManifestRequest->pEntry = pManifestEntry;
+	pManifestRequest->pAsyncLoadBuffer = static_cast< uint8_t* >(
+		DefaultAllocator().Allocate( pManifestEntry->size ) );
+	HELIUM_ASSERT( pManifestRequest->pAsyncLoadBuffer );
+	pManifestRequest->asyncLoadId = m_pCache->QueueEntryLoad(
+		*pManifestEntry,
+		pManifestRequest->pAsyncLoadBuffer,
+		pManifestEntry->size );
+	HELIUM_ASSERT( IsValid( pManifestRequest->asyncLoadId ) );
+}
+
+/// Prefetch the dependencies listed in each dependency manifest that has finished loading.
+///
+/// @see BeginLoadDependencyManifest()
+void CachePackageLoader::TickDependencyManifests()
+{
+	if( m_manifestRequests.IsEmpty() )
+	{
+		return;
+	}
+
+	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+	HELIUM_ASSERT( pAsyncLoader );
+
+	DynamicArray< AssetPath > dependencies;
+	DynamicArray< const Cache::Entry* > dependencyEntries;
+
+	size_t requestIndex = 0;
+	while( requestIndex < m_manifestRequests.GetSize() )
+	{
+		PrefetchRequest& rManifestRequest = m_manifestRequests[ requestIndex ];
+
+		size_t bytesRead = 0;
+		if( !pAsyncLoader->TrySyncRequest( rManifestRequest.asyncLoadId, bytesRead ) )
+		{
+			++requestIndex;
+
+			continue;
+		}
+
+		if( IsValid( bytesRead ) && bytesRead != 0 )
+		{
+			if( !Cache::ReadDependencyManifest( rManifestRequest.pAsyncLoadBuffer, bytesRead, dependencies ) )
+			{
+				HELIUM_TRACE(
+					TraceLevels::Warning,
+					"CachePackageLoader: Dependency manifest for \"%s\" is malformed.\n",
+					*rManifestRequest.pEntry->path.ToString() );
+			}
+
+			dependencyEntries.Resize( 0 );
+
+			size_t dependencyCount = dependencies.GetSize();
+			for( size_t dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex )
+			{
+				AssetPath dependencyPath = dependencies[ dependencyIndex ];
+				if( dependencyPath.IsPackage() )
+				{
+					continue;
+				}
+
+				// Objects stored in other caches are left to be loaded on demand.
+				const Cache::Entry* pEntry = m_pCache->FindEntry( dependencyPath, 0 );
+				if( pEntry )
+				{
+					dependencyEntries.Push( pEntry );
+				}
+			}
+
+			// Issue the reads in the order in which the objects are stored, so that the AsyncLoader can service
+			// objects stored next to each other (see Cache::OptimizeLayout()) with a single read.
+			std::sort(
+				dependencyEntries.GetData(),
+				dependencyEntries.GetData() + dependencyEntries.GetSize(),
+				EntryOffsetLess );
+
+			size_t dependencyEntryCount = dependencyEntries.GetSize();
+			for( size_t entryIndex = 0; entryIndex < dependencyEntryCount; ++entryIndex )
+			{
+				PrefetchObject( dependencyEntries[ entryIndex ] );
+			}
+		}
+
+		DefaultAllocator().Free( rManifestRequest.pAsyncLoadBuffer );
+		m_manifestRequests.RemoveSwap( requestIndex );
+	}
+}
+
+/// Issue the read of an object's cached data ahead of its load request.
+///
+/// @param[in] pEntry  Cache entry of the object to prefetch.
+///
+/// @see ClaimPrefetch()
+void CachePackageLoader::PrefetchObject( const Cache::Entry* pEntry )
+{
+	HELIUM_ASSERT( m_pCache );
+	HELIUM_ASSERT( pEntry );
+
+	if( pEntry->size == 0 )
+	{
+		return;
+	}
+
+	if( m_prefetchBufferSize + pEntry->size > PREFETCH_BUFFER_SIZE_MAX )
+	{
+		return;
+	}
+
+	HashMap< const Cache::Entry*, PrefetchRequest >::Iterator prefetchIterator = m_prefetchRequests.Find( pEntry );
+	if( prefetchIterator != m_prefetchRequests.End() )
+	{
+		return;
+	}
+
+	// Skip objects already in memory.  Objects whose load has started but that haven't been deserialized yet are not
+	// detected here; their prefetched data is simply released once loading goes idle.
+	if( Asset::FindObject( pEntry->path ) )
+	{
+		return;
+	}
+
+	PrefetchRequest prefetchRequest;
+	prefetchRequest.pEntry = pEntry;
+	prefetchRequest.pAsyncLoadBuffer = static_cast< uint8_t* >( DefaultAllocator().Allocate( pEntry->size ) );
+	HELIUM_ASSERT( prefetchRequest.pAsyncLoadBuffer );
+	prefetchRequest.asyncLoadId = m_pCache->QueueEntryLoad( *pEntry, prefetchRequest.pAsyncLoadBuffer, pEntry->size );
+	HELIUM_ASSERT( IsValid( prefetchRequest.asyncLoadId ) );
+
+	HELIUM_VERIFY( m_prefetchRequests.Insert(
+		prefetchIterator,
+		HashMap< const Cache::Entry*, PrefetchRequest >::ValueType( pEntry, prefetchRequest ) ) );
+	m_prefetchBufferSize += pEntry->size;
+}
+
+/// Hand any prefetched data for the entry being loaded over to a load request.
+///
+/// @param[in] pRequest  Load request.
+///
+/// @return  True if prefetched data was found (the load request takes ownership of the pending read), false if not.
+///
+/// @see PrefetchObject()
+bool CachePackageLoader::ClaimPrefetch( LoadRequest* pRequest )
+{
+	HELIUM_ASSERT( pRequest );
+	HELIUM_ASSERT( pRequest->pEntry );
+
+	HashMap< const Cache::Entry*, PrefetchRequest >::Iterator prefetchIterator =
+		m_prefetchRequests.Find( pRequest->pEntry );
+	if( prefetchIterator == m_prefetchRequests.End() )
+	{
+		return false;
+	}
+
+	const PrefetchRequest& rPrefetchRequest = prefetchIterator->Second();
+	pRequest->asyncLoadId = rPrefetchRequest.asyncLoadId;
+	pRequest->pAsyncLoadBuffer = rPrefetchRequest.pAsyncLoadBuffer;
+	pRequest->pCacheData = rPrefetchRequest.pAsyncLoadBuffer;
+
+	HELIUM_ASSERT( m_prefetchBufferSize >= pRequest->pEntry->size );
+	m_prefetchBufferSize -= pRequest->pEntry->size;
+
+	HELIUM_VERIFY( m_prefetchRequests.Remove( pRequest->pEntry ) );
+
+	return true;
+}
+
+/// Free prefetched data that has not been claimed by a load request.
+///
+/// @param[in] bSync  True to wait for reads still in progress, false to leave them for a later call.
+void CachePackageLoader::ReleasePrefetches( bool bSync )
+{
+	if( m_prefetchRequests.IsEmpty() )
+	{
+		return;
+	}
+
+	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+	HELIUM_ASSERT( pAsyncLoader );
+
+	DefaultAllocator allocator;
+
+	DynamicArray< const Cache::Entry* > releasedEntries;
+
+	HashMap< const Cache::Entry*, PrefetchRequest >::Iterator prefetchIterator = m_prefetchRequests.Begin();
+	for( ; prefetchIterator != m_prefetchRequests.End(); ++prefetchIterator )
+	{
+		PrefetchRequest& rPrefetchRequest = prefetchIterator->Second();
+		if( bSync )
+		{
+			pAsyncLoader->SyncRequest( rPrefetchRequest.asyncLoadId );
+		}
+		else
+		{
+			size_t bytesRead = 0;
+			if( !pAsyncLoader->TrySyncRequest( rPrefetchRequest.asyncLoadId, bytesRead ) )
+			{
+				continue;
+			}
+		}
+
+		allocator.Free( rPrefetchRequest.pAsyncLoadBuffer );
+		m_prefetchBufferSize -= rPrefetchRequest.pEntry->size;
+
+		releasedEntries.Push( rPrefetchRequest.pEntry );
+	}
+
+	size_t releasedEntryCount = releasedEntries.GetSize();
+	for( size_t entryIndex = 0; entryIndex < releasedEntryCount; ++entryIndex )
+	{
+		HELIUM_VERIFY( m_prefetchRequests.Remove( releasedEntries[ entryIndex ] ) );
+	}
+}
+
 /// Recursive function for resolving a package request.
 ///
 /// @param[out] rspPackage   Resolved package.
@@ -608,8 +925,8 @@ bool CachePackageLoader::ReadCacheData( LoadRequest* pRequest )
 {
 	HELIUM_ASSERT( pRequest );
 
-	uint8_t* pBufferCurrent = pRequest->pAsyncLoadBuffer;
-	uint8_t* pPropertyDataEnd = pRequest->pPropertyDataEnd;
+	const uint8_t* pBufferCurrent = pRequest->pCacheData;
+	const uint8_t* pPropertyDataEnd = pRequest->pPropertyDataEnd;
 	HELIUM_ASSERT( pBufferCurrent );
 	HELIUM_ASSERT( pPropertyDataEnd );
 	HELIUM_ASSERT( pBufferCurrent <= pPropertyDataEnd );
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Foundation/HashMap.h"
 #include "Engine/Asset.h"
 #include "Engine/PackageLoader.h"
 
@@ -13,6 +14,8 @@ namespace Helium
 	public:
 		/// Load request pool block size.
 		static const size_t LOAD_REQUEST_POOL_BLOCK_SIZE = 16;
+		/// Maximum number of bytes of prefetched object data that may be waiting to be claimed by load requests.
+		static const size_t PREFETCH_BUFFER_SIZE_MAX = 16 * 1024 * 1024;
 
 		/// @name Construction/Destruction
 		//@{
@@ -45,6 +48,12 @@ namespace Helium
 		inline Cache* GetCache() const;
 		//@}
 
+		/// @name Dependency Prefetching
+		//@{
+		inline size_t GetPrefetchCount() const;
+		inline size_t GetPrefetchBufferSize() const;
+		//@}
+
 	private:
 		/// Load request flags.
 		enum ELoadFlag
@@ -69,15 +78,17 @@ namespace Helium
 			size_t asyncLoadId;
 			/// Async load buffer.
 			uint8_t* pAsyncLoadBuffer;
+			/// Cached data (either the async load buffer or a view into the memory mapped cache file).
+			const uint8_t* pCacheData;
 
-			/// Pointer to where the property data begins within the pAsyncLoadBuffer
-			uint8_t* pPropertyDataBegin;
+			/// Pointer to where the property data begins within the cached data
+			const uint8_t* pPropertyDataBegin;
 			/// End of the property data
-			uint8_t* pPropertyDataEnd;
-			/// Pointer to where the persistent resource data begins within the pAsyncLoadBuffer
-			uint8_t* pPersistentResourceDataBegin;
+			const uint8_t* pPropertyDataEnd;
+			/// Pointer to where the persistent resource data begins within the cached data
+			const uint8_t* pPersistentResourceDataBegin;
 			/// End of the persistent resource data.
-			uint8_t* pPersistentResourceDataEnd;
+			const uint8_t* pPersistentResourceDataEnd;
 
 			// Load index for the owning asset
 			size_t ownerLoadIndex;
@@ -91,6 +102,17 @@ namespace Helium
 			bool forceReload;
 		};
 
+		/// Read of object data issued ahead of the object's load request.
+		struct PrefetchRequest
+		{
+			/// Cache entry being read.
+			const Cache::Entry* pEntry;
+			/// Async load ID.
+			size_t asyncLoadId;
+			/// Async load buffer.
+			uint8_t* pAsyncLoadBuffer;
+		};
+
 		/// Cache from which objects will be loaded.
 		Cache* m_pCache;
 		/// True if we've synced the cache TOC load process.
@@ -101,12 +123,28 @@ namespace Helium
 		/// Load request pool.
 		ObjectPool< LoadRequest > m_loadRequestPool;
 
+		/// Pending dependency manifest reads.
+		DynamicArray< PrefetchRequest > m_manifestRequests;
+		/// Prefetched object data, keyed on the cache entry.
+		HashMap< const Cache::Entry*, PrefetchRequest > m_prefetchRequests;
+		/// Total size of the prefetch buffers currently allocated.
+		size_t m_prefetchBufferSize;
+
 		/// @name Load Ticking Functions
 		//@{
 		bool TickCacheLoad( LoadRequest* pRequest );
 		bool TickDeserialize( LoadRequest* pRequest );
 		//@}
 
+		/// @name Dependency Prefetching
+		//@{
+		void BeginLoadDependencyManifest( const Cache::Entry* pObjectEntry );
+		void TickDependencyManifests();
+		void PrefetchObject( const Cache::Entry* pEntry );
+		bool ClaimPrefetch( LoadRequest* pRequest );
+		void ReleasePrefetches( bool bSync );
+		//@}
+
 		/// @name Static Private Utility Functions
 		//@{
 		static void ResolvePackage( AssetPtr& spPackage, AssetPath packagePath );
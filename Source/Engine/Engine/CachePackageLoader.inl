@@ -5,3 +5,23 @@ Helium::Cache* Helium::CachePackageLoader::GetCache() const
 {
     return m_pCache;
 }
+
+/// Get the number of objects whose data has been prefetched but not yet claimed by a load request.
+///
+/// @return  Number of unclaimed prefetches.
+///
+/// @see GetPrefetchBufferSize()
+size_t Helium::CachePackageLoader::GetPrefetchCount() const
+{
+    return m_prefetchRequests.GetSize();
+}
+
+/// Get the total size of the buffers held for unclaimed prefetches.
+///
+/// @return  Prefetch buffer size, in bytes.  This never exceeds PREFETCH_BUFFER_SIZE_MAX.
+///
+/// @see GetPrefetchCount()
+size_t Helium::CachePackageLoader::GetPrefetchBufferSize() const
+{
+    return m_prefetchBufferSize;
+}
@@ -0,0 +1,478 @@
+#include "Engine/CachePackageLoader.h"
+
+#include "Foundation/DynamicArray.h"
+#include "Foundation/FilePath.h"
+#include "Reflect/Registry.h"
+#include "Persist/Archive.h"
+#include "Engine/AssetLoader.h"
+#include "Engine/AsyncLoader.h"
+#include "Engine/CacheManager.h"
+#include "Engine/FileLocations.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if HELIUM_OS_LINUX && HELIUM_TOOLS
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace CachePackageLoaderTests
+{
+	/// Asset holding a block of data, so that its cache entry can be made as large as a test needs.
+	class PayloadAsset : public Helium::Asset
+	{
+		HELIUM_DECLARE_ASSET( PayloadAsset, Asset );
+		static void PopulateMetaType( Helium::Reflect::MetaStruct& comp );
+
+	public:
+		std::string m_Payload;
+	};
+	typedef Helium::StrongPtr< PayloadAsset > PayloadAssetPtr;
+}
+
+using namespace Helium;
+using namespace CachePackageLoaderTests;
+
+HELIUM_IMPLEMENT_ASSET( CachePackageLoaderTests::PayloadAsset, EngineTests, 0 );
+
+void PayloadAsset::PopulateMetaType( Reflect::MetaStruct& comp )
+{
+	comp.AddField( &PayloadAsset::m_Payload, "m_Payload" );
+}
+
+namespace
+{
+	/// Payload size of objects whose size doesn't matter to a test, in bytes.
+	const size_t SMALL_PAYLOAD_SIZE = 4 * 1024;
+	/// Payload size of objects used to fill the prefetch buffer, in bytes.
+	const size_t LARGE_PAYLOAD_SIZE = 4 * 1024 * 1024;
+
+	/// Base directory holding the cache files written by the tests.
+	char g_BaseDirectory[ 256 ];
+
+	int RemoveDirectoryEntry( const char* pPath, const struct stat* /*pStat*/, int /*type*/, struct FTW* /*pFtw*/ )
+	{
+		return remove( pPath );
+	}
+
+	/// Asset loader that loads everything through a single cache package loader.
+	class TestAssetLoader : public AssetLoader
+	{
+	public:
+		static void Startup( CachePackageLoader* pPackageLoader )
+		{
+			AssetLoader::Startup();
+
+			HELIUM_ASSERT( !sm_pInstance );
+			sm_pInstance = new TestAssetLoader( pPackageLoader );
+			HELIUM_ASSERT( sm_pInstance );
+		}
+
+		static void Shutdown()
+		{
+			HELIUM_ASSERT( sm_pInstance );
+			delete sm_pInstance;
+			sm_pInstance = NULL;
+
+			AssetLoader::Shutdown();
+		}
+
+	protected:
+		TestAssetLoader( CachePackageLoader* pPackageLoader )
+			: m_pPackageLoader( pPackageLoader )
+		{
+		}
+
+		virtual PackageLoader* GetPackageLoader( AssetPath /*path*/ )
+		{
+			return m_pPackageLoader;
+		}
+
+		virtual void TickPackageLoaders()
+		{
+			m_pPackageLoader->Tick();
+		}
+
+	private:
+		CachePackageLoader* m_pPackageLoader;
+	};
+
+	class CachePackageLoaderTest : public testing::Test
+	{
+	protected:
+		char m_packageName[ 64 ];
+		Cache* m_pCache;
+		PackagePtr m_spSourcePackage;
+		PayloadAssetPtr m_spSourceObject;
+		CachePackageLoader m_packageLoader;
+		bool m_bLoaderStarted;
+
+		CachePackageLoaderTest()
+			: m_pCache( NULL )
+			, m_bLoaderStarted( false )
+		{
+			m_packageName[ 0 ] = '\0';
+		}
+
+		static void SetUpTestCase()
+		{
+			strcpy( g_BaseDirectory, "/tmp/CachePackageLoaderTests.XXXXXX" );
+			ASSERT_TRUE( mkdtemp( g_BaseDirectory ) != NULL );
+
+			FileLocations::SetBaseDirectory( FilePath( std::string( g_BaseDirectory ) + "/" ) );
+
+			AsyncLoader::Startup();
+			CacheManager::Startup();
+			Reflect::Startup();
+			Persist::Startup();
+		}
+
+		static void TearDownTestCase()
+		{
+			Persist::Shutdown();
+			Reflect::Shutdown();
+			AssetType::Shutdown();
+			Asset::Shutdown();
+			Reflect::ObjectRefCountSupport::Shutdown();
+			CacheManager::Shutdown();
+			AsyncLoader::Shutdown();
+			FileLocations::Shutdown();
+
+			nftw( g_BaseDirectory, RemoveDirectoryEntry, 16, FTW_DEPTH | FTW_PHYS );
+		}
+
+		void TearDown()
+		{
+			if ( m_bLoaderStarted )
+			{
+				TestAssetLoader::Shutdown();
+			}
+
+			m_packageLoader.Shutdown();
+
+			m_spSourceObject.Release();
+			m_spSourcePackage.Release();
+
+			AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+			HELIUM_ASSERT( pAsyncLoader );
+			HELIUM_VERIFY( pAsyncLoader->Initialize( AsyncLoader::DEFAULT_WORKER_COUNT ) );
+		}
+
+		/// Create the cache for a test, named after the package its objects are loaded into.  Each test uses its own
+		/// package, as loaded objects stay in memory for the rest of the run.
+		void CreateCache( const char* pPackageName )
+		{
+			strcpy( m_packageName, pPackageName );
+
+			m_pCache = CacheManager::GetInstance()->GetCache( Name( pPackageName ) );
+			ASSERT_TRUE( m_pCache != NULL );
+			m_pCache->EnforceTocLoad();
+
+			// Prefetching only applies when entries are read through the async loader.
+			ASSERT_FALSE( m_pCache->IsMemoryMapped() );
+
+			char sourcePackageName[ 64 ];
+			snprintf( sourcePackageName, sizeof( sourcePackageName ), "%sSource", pPackageName );
+			ASSERT_TRUE( Asset::Create< Package >( m_spSourcePackage, Name( sourcePackageName ), NULL ) );
+			ASSERT_TRUE( Asset::Create< PayloadAsset >( m_spSourceObject, Name( "Source" ), m_spSourcePackage ) );
+		}
+
+		AssetPath GetObjectPath( uint32_t objectIndex )
+		{
+			char pathString[ 128 ];
+			snprintf( pathString, sizeof( pathString ), "/%s:Object%u", m_packageName, objectIndex );
+
+			AssetPath path;
+			HELIUM_VERIFY( path.Set( pathString ) );
+
+			return path;
+		}
+
+		static char GetPayloadCharacter( uint32_t objectIndex )
+		{
+			return static_cast< char >( 'A' + objectIndex % 26 );
+		}
+
+		/// Cache an object the way the asset preprocessor does, along with a dependency manifest listing a range of
+		/// other objects if any are given.
+		void CacheObject( uint32_t objectIndex, size_t payloadSize, uint32_t firstDependency = 0, uint32_t dependencyCount = 0 )
+		{
+			m_spSourceObject->m_Payload.assign( payloadSize, GetPayloadCharacter( objectIndex ) );
+
+			DynamicArray< uint8_t > objectData;
+			Cache::WriteCacheObjectToBuffer( m_spSourceObject, objectData );
+
+			DynamicArray< uint8_t > entryData;
+			uint32_t objectDataSize = static_cast< uint32_t >( objectData.GetSize() ) + 1;
+			entryData.Resize( sizeof( objectDataSize ) );
+			memcpy( entryData.GetData(), &objectDataSize, sizeof( objectDataSize ) );
+			entryData.AddArray( objectData.GetData(), objectData.GetSize() );
+			entryData.Push( 0 );
+
+			AssetPath path = GetObjectPath( objectIndex );
+			ASSERT_TRUE( m_pCache->CacheEntry( path, 0, entryData.GetData(), 0, static_cast< uint32_t >( entryData.GetSize() ) ) );
+
+			if ( dependencyCount != 0 )
+			{
+				DynamicArray< AssetPath > dependencies;
+				for ( uint32_t dependencyIndex = firstDependency; dependencyIndex < firstDependency + dependencyCount; ++dependencyIndex )
+				{
+					dependencies.Push( GetObjectPath( dependencyIndex ) );
+				}
+
+				DynamicArray< uint8_t > manifestData;
+				Cache::WriteDependencyManifest( dependencies, manifestData );
+				ASSERT_TRUE( m_pCache->CacheEntry(
+					path,
+					Cache::DEPENDENCY_MANIFEST_SUB_DATA_INDEX,
+					manifestData.GetData(),
+					0,
+					static_cast< uint32_t >( manifestData.GetSize() ) ) );
+			}
+		}
+
+		/// Start loading from the cache written by the test.
+		void StartLoader()
+		{
+			ASSERT_TRUE( m_packageLoader.Initialize( Name( m_packageName ) ) );
+			ASSERT_TRUE( m_packageLoader.BeginPreload() );
+			while ( !m_packageLoader.TryFinishPreload() )
+			{
+				m_packageLoader.Tick();
+			}
+
+			TestAssetLoader::Startup( &m_packageLoader );
+			m_bLoaderStarted = true;
+		}
+
+		size_t BeginLoad( uint32_t objectIndex )
+		{
+			return AssetLoader::GetInstance()->BeginLoadObject( GetObjectPath( objectIndex ) );
+		}
+
+		/// Check that a loaded object holds the payload it was cached with.
+		void CheckObject( Asset* pObject, uint32_t objectIndex, size_t payloadSize )
+		{
+			PayloadAsset* pPayloadObject = Reflect::SafeCast< PayloadAsset >( pObject );
+			ASSERT_TRUE( pPayloadObject != NULL ) << "Object " << objectIndex << " failed to load";
+			EXPECT_TRUE( pPayloadObject->GetPath() == GetObjectPath( objectIndex ) );
+			EXPECT_EQ( std::string( payloadSize, GetPayloadCharacter( objectIndex ) ), pPayloadObject->m_Payload );
+		}
+
+		void FinishLoad( size_t loadId, uint32_t objectIndex, size_t payloadSize )
+		{
+			ASSERT_TRUE( IsValid( loadId ) );
+
+			AssetPtr spObject;
+			AssetLoader::GetInstance()->FinishLoad( loadId, spObject );
+			CheckObject( spObject, objectIndex, payloadSize );
+		}
+	};
+}
+
+TEST_F( CachePackageLoaderTest, ClaimsPrefetchBeforeReadFinishes )
+{
+	CreateCache( "PrefetchClaim" );
+	CacheObject( 0, SMALL_PAYLOAD_SIZE, 1, 1 );
+	CacheObject( 1, SMALL_PAYLOAD_SIZE );
+	StartLoader();
+
+	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+	HELIUM_VERIFY( pAsyncLoader->Initialize( 1 ) );
+
+	size_t rootLoadId = BeginLoad( 0 );
+	ASSERT_TRUE( IsValid( rootLoadId ) );
+	pAsyncLoader->Flush();
+
+	// Hold the only worker on the open of a FIFO nothing is writing to, so that every read queued from here on stays
+	// pending until the test lets it go.
+	char fifoPath[ 512 ];
+	snprintf( fifoPath, sizeof( fifoPath ), "%s/Blocker", g_BaseDirectory );
+	ASSERT_EQ( 0, mkfifo( fifoPath, 0600 ) );
+
+	pAsyncLoader->ResetStatistics();
+	uint8_t blockerBuffer[ 16 ];
+	size_t blockerId = pAsyncLoader->QueueRequest(
+		blockerBuffer,
+		String( fifoPath ),
+		0,
+		sizeof( blockerBuffer ),
+		AsyncLoader::PRIORITY_HIGH );
+
+	// The root's manifest has been read, so the next tick prefetches the dependency.
+	AssetLoader::GetInstance()->Tick();
+
+	const Cache::Entry* pDependencyEntry = m_pCache->FindEntry( GetObjectPath( 1 ), 0 );
+	ASSERT_TRUE( pDependencyEntry != NULL );
+	EXPECT_EQ( 1u, m_packageLoader.GetPrefetchCount() );
+	EXPECT_EQ( pDependencyEntry->size, m_packageLoader.GetPrefetchBufferSize() );
+
+	// Requesting the dependency takes over the pending read rather than queueing another one.
+	size_t dependencyLoadId = BeginLoad( 1 );
+	EXPECT_EQ( 0u, m_packageLoader.GetPrefetchCount() );
+	EXPECT_EQ( 0u, m_packageLoader.GetPrefetchBufferSize() );
+
+	AsyncLoader::Statistics statistics;
+	pAsyncLoader->GetStatistics( statistics );
+	EXPECT_EQ( 0u, statistics.completedRequestCount );
+	EXPECT_EQ( 1u, statistics.queueDepth[ AsyncLoader::PRIORITY_NORMAL ] );
+
+	int fifoDescriptor = open( fifoPath, O_WRONLY );
+	ASSERT_GE( fifoDescriptor, 0 );
+	close( fifoDescriptor );
+	pAsyncLoader->SyncRequest( blockerId );
+
+	FinishLoad( dependencyLoadId, 1, SMALL_PAYLOAD_SIZE );
+	FinishLoad( rootLoadId, 0, SMALL_PAYLOAD_SIZE );
+
+	// The dependency was read once, by the prefetch.
+	pAsyncLoader->Flush();
+	pAsyncLoader->GetStatistics( statistics );
+	EXPECT_EQ( 2u, statistics.completedRequestCount );
+}
+
+TEST_F( CachePackageLoaderTest, PrefetchBufferIsCapped )
+{
+	const uint32_t dependencyCount = 6;
+	HELIUM_COMPILE_ASSERT( dependencyCount * LARGE_PAYLOAD_SIZE > CachePackageLoader::PREFETCH_BUFFER_SIZE_MAX );
+
+	CreateCache( "PrefetchCap" );
+	CacheObject( 0, SMALL_PAYLOAD_SIZE, 1, dependencyCount );
+	for ( uint32_t objectIndex = 1; objectIndex <= dependencyCount; ++objectIndex )
+	{
+		CacheObject( objectIndex, LARGE_PAYLOAD_SIZE );
+	}
+
+	StartLoader();
+
+	size_t rootLoadId = BeginLoad( 0 );
+	ASSERT_TRUE( IsValid( rootLoadId ) );
+	AsyncLoader::GetInstance()->Flush();
+	AssetLoader::GetInstance()->Tick();
+
+	// Dependencies are prefetched in cache order until the next one would overflow the buffer.
+	size_t expectedCount = 0;
+	size_t expectedSize = 0;
+	for ( uint32_t objectIndex = 1; objectIndex <= dependencyCount; ++objectIndex )
+	{
+		const Cache::Entry* pEntry = m_pCache->FindEntry( GetObjectPath( objectIndex ), 0 );
+		ASSERT_TRUE( pEntry != NULL );
+		if ( expectedSize + pEntry->size <= CachePackageLoader::PREFETCH_BUFFER_SIZE_MAX )
+		{
+			expectedSize += pEntry->size;
+			++expectedCount;
+		}
+	}
+
+	EXPECT_LT( expectedCount, dependencyCount );
+	EXPECT_EQ( expectedCount, m_packageLoader.GetPrefetchCount() );
+	EXPECT_EQ( expectedSize, m_packageLoader.GetPrefetchBufferSize() );
+	EXPECT_LE( m_packageLoader.GetPrefetchBufferSize(), CachePackageLoader::PREFETCH_BUFFER_SIZE_MAX );
+
+	// Dependencies past the cap are read on demand instead.
+	DynamicArray< size_t > loadIds;
+	for ( uint32_t objectIndex = 1; objectIndex <= dependencyCount; ++objectIndex )
+	{
+		loadIds.Push( BeginLoad( objectIndex ) );
+		EXPECT_LE( m_packageLoader.GetPrefetchBufferSize(), CachePackageLoader::PREFETCH_BUFFER_SIZE_MAX );
+	}
+
+	EXPECT_EQ( 0u, m_packageLoader.GetPrefetchCount() );
+
+	for ( uint32_t objectIndex = 1; objectIndex <= dependencyCount; ++objectIndex )
+	{
+		FinishLoad( loadIds[ objectIndex - 1 ], objectIndex, LARGE_PAYLOAD_SIZE );
+	}
+
+	FinishLoad( rootLoadId, 0, SMALL_PAYLOAD_SIZE );
+}
+
+TEST_F( CachePackageLoaderTest, UnclaimedPrefetchesAreReleasedWhenIdle )
+{
+	const uint32_t dependencyCount = 4;
+
+	CreateCache( "PrefetchIdle" );
+	CacheObject( 0, SMALL_PAYLOAD_SIZE, 1, dependencyCount );
+	for ( uint32_t objectIndex = 1; objectIndex <= dependencyCount; ++objectIndex )
+	{
+		CacheObject( objectIndex, SMALL_PAYLOAD_SIZE );
+	}
+
+	StartLoader();
+
+	size_t rootLoadId = BeginLoad( 0 );
+	ASSERT_TRUE( IsValid( rootLoadId ) );
+	AsyncLoader::GetInstance()->Flush();
+	AssetLoader::GetInstance()->Tick();
+	EXPECT_EQ( dependencyCount, m_packageLoader.GetPrefetchCount() );
+
+	// Nothing ends up requesting the dependencies, so their data is dropped once the root has loaded.
+	FinishLoad( rootLoadId, 0, SMALL_PAYLOAD_SIZE );
+	AsyncLoader::GetInstance()->Flush();
+	AssetLoader::GetInstance()->Tick();
+
+	EXPECT_EQ( 0u, m_packageLoader.GetPrefetchCount() );
+	EXPECT_EQ( 0u, m_packageLoader.GetPrefetchBufferSize() );
+
+	for ( uint32_t objectIndex = 1; objectIndex <= dependencyCount; ++objectIndex )
+	{
+		EXPECT_TRUE( Asset::FindObject( GetObjectPath( objectIndex ) ) == NULL );
+	}
+}
+
+TEST_F( CachePackageLoaderTest, LoadsCacheWithoutManifests )
+{
+	const uint32_t objectCount = 4;
+
+	CreateCache( "NoManifest" );
+	for ( uint32_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+	{
+		CacheObject( objectIndex, SMALL_PAYLOAD_SIZE );
+		EXPECT_TRUE( m_pCache->FindEntry( GetObjectPath( objectIndex ), Cache::DEPENDENCY_MANIFEST_SUB_DATA_INDEX ) == NULL );
+	}
+
+	StartLoader();
+
+	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
+	pAsyncLoader->Flush();
+	pAsyncLoader->ResetStatistics();
+
+	DynamicArray< size_t > loadIds;
+	for ( uint32_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+	{
+		loadIds.Push( BeginLoad( objectIndex ) );
+		ASSERT_TRUE( IsValid( loadIds[ objectIndex ] ) );
+	}
+
+	AssetLoader* pAssetLoader = AssetLoader::GetInstance();
+	size_t remainingCount = objectCount;
+	while ( remainingCount != 0 )
+	{
+		pAssetLoader->Tick();
+		EXPECT_EQ( 0u, m_packageLoader.GetPrefetchCount() );
+
+		for ( uint32_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+		{
+			AssetPtr spObject;
+			if ( IsValid( loadIds[ objectIndex ] ) && pAssetLoader->TryFinishLoad( loadIds[ objectIndex ], spObject ) )
+			{
+				CheckObject( spObject, objectIndex, SMALL_PAYLOAD_SIZE );
+				SetInvalid( loadIds[ objectIndex ] );
+				--remainingCount;
+			}
+		}
+	}
+
+	// Each object was read once, with no manifest reads alongside.
+	pAsyncLoader->Flush();
+	AsyncLoader::Statistics statistics;
+	pAsyncLoader->GetStatistics( statistics );
+	EXPECT_EQ( objectCount, statistics.completedRequestCount );
+}
+
+#endif // HELIUM_OS_LINUX && HELIUM_TOOLS
@@ -0,0 +1,95 @@
+#include "Engine/Cache.h"
+
+#include "Foundation/DynamicArray.h"
+#include "Engine/AsyncLoader.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Names of the scratch files written by the tests.
+	const char TOC_FILE_NAME[] = "CacheTests.toc";
+	const char CACHE_FILE_NAME[] = "CacheTests.cache";
+
+	/// Size of the entry data first cached, in bytes.
+	const uint32_t ENTRY_SIZE = 64 * 1024;
+
+	void FillEntryData( uint8_t value, uint32_t size, DynamicArray< uint8_t >& rData )
+	{
+		rData.Resize( size );
+		for( uint32_t offset = 0; offset < size; ++offset )
+		{
+			rData[ offset ] = static_cast< uint8_t >( value + offset );
+		}
+	}
+
+	class CacheTest : public testing::Test
+	{
+	protected:
+		Cache m_cache;
+
+		void SetUp()
+		{
+			AsyncLoader::Startup();
+			ASSERT_TRUE( AsyncLoader::GetInstance() != NULL );
+
+			RemoveFiles();
+		}
+
+		void TearDown()
+		{
+			m_cache.Shutdown();
+			AsyncLoader::Shutdown();
+
+			RemoveFiles();
+		}
+
+		void RemoveFiles()
+		{
+			remove( TOC_FILE_NAME );
+			remove( CACHE_FILE_NAME );
+		}
+	};
+}
+
+TEST_F( CacheTest, MappedEntryViewsSurviveUpdates )
+{
+	ASSERT_TRUE( m_cache.Initialize( Name( "CacheTests" ), Cache::PLATFORM_PC, TOC_FILE_NAME, CACHE_FILE_NAME, true ) );
+	m_cache.EnforceTocLoad();
+	ASSERT_TRUE( m_cache.IsMemoryMapped() );
+
+	AssetPath path;
+	ASSERT_TRUE( path.Set( "/CacheTests:Entry" ) );
+
+	DynamicArray< uint8_t > originalData;
+	FillEntryData( 1, ENTRY_SIZE, originalData );
+	ASSERT_TRUE( m_cache.CacheEntry( path, 0, originalData.GetData(), 1, ENTRY_SIZE ) );
+
+	const Cache::Entry* pEntry = m_cache.FindEntry( path, 0 );
+	ASSERT_TRUE( pEntry != NULL );
+	const uint8_t* pOriginalView = NULL;
+	ASSERT_TRUE( m_cache.GetEntryData( *pEntry, pOriginalView ) );
+	ASSERT_EQ( 0, memcmp( pOriginalView, originalData.GetData(), ENTRY_SIZE ) );
+
+	// Update the entry with smaller data that would fit over the original.  The view handed out above must still see
+	// the original data, so the update has to go elsewhere in the file.
+	DynamicArray< uint8_t > updatedData;
+	FillEntryData( 100, ENTRY_SIZE / 2, updatedData );
+	ASSERT_TRUE( m_cache.CacheEntry( path, 0, updatedData.GetData(), 2, ENTRY_SIZE / 2 ) );
+
+	EXPECT_EQ( 0, memcmp( pOriginalView, originalData.GetData(), ENTRY_SIZE ) );
+
+	pEntry = m_cache.FindEntry( path, 0 );
+	ASSERT_TRUE( pEntry != NULL );
+	EXPECT_EQ( ENTRY_SIZE / 2, pEntry->size );
+
+	const uint8_t* pUpdatedView = NULL;
+	ASSERT_TRUE( m_cache.GetEntryData( *pEntry, pUpdatedView ) );
+	EXPECT_NE( pOriginalView, pUpdatedView );
+	EXPECT_EQ( 0, memcmp( pUpdatedView, updatedData.GetData(), ENTRY_SIZE / 2 ) );
+}
@@ -0,0 +1,141 @@
+#include "Precompile.h"
+#include "Engine/Compression.h"
+
+#include <zlib.h>
+
+using namespace Helium;
+
+/// Compress a block of data.
+///
+/// Compression is only considered successful if it actually reduces the size of the data, as there is no point in
+/// paying for decompression at load time otherwise.
+///
+/// @param[in]  type          Compression format to use.
+/// @param[in]  pSource       Data to compress.
+/// @param[in]  sourceSize    Size of the data to compress, in bytes.
+/// @param[out] rDestination  Compressed data.
+///
+/// @return  True if the data was compressed to a smaller size than the original, false if not (in which case the
+///          data should be stored uncompressed).
+///
+/// @see Decompress()
+bool Compression::Compress( EType type, const void* pSource, size_t sourceSize, DynamicArray< uint8_t >& rDestination )
+{
+	HELIUM_ASSERT( pSource || sourceSize == 0 );
+
+	rDestination.Resize( 0 );
+
+	if( type != TYPE_ZLIB || sourceSize == 0 || sourceSize > UINT32_MAX )
+	{
+		return false;
+	}
+
+	uLongf compressedSize = compressBound( static_cast< uLong >( sourceSize ) );
+	rDestination.Resize( compressedSize );
+
+	int result = compress2(
+		rDestination.GetData(),
+		&compressedSize,
+		static_cast< const Bytef* >( pSource ),
+		static_cast< uLong >( sourceSize ),
+		Z_DEFAULT_COMPRESSION );
+	if( result != Z_OK || compressedSize >= sourceSize )
+	{
+		rDestination.Resize( 0 );
+
+		return false;
+	}
+
+	rDestination.Resize( compressedSize );
+
+	return true;
+}
+
+/// Decompress a block of data.
+///
+/// The destination buffer may be smaller than the uncompressed data, in which case only the start of the data is
+/// decompressed.
+///
+/// @param[in] type             Compression format of the data.
+/// @param[in] pSource          Compressed data.
+/// @param[in] sourceSize       Size of the compressed data, in bytes.
+/// @param[in] pDestination     Buffer in which to store the decompressed data.
+/// @param[in] destinationSize  Size of the destination buffer, in bytes.
+///
+/// @return  Number of bytes decompressed, or an invalid index if the data could not be decompressed.
+///
+/// @see Compress()
+size_t Compression::Decompress(
+	EType type,
+	const void* pSource,
+	size_t sourceSize,
+	void* pDestination,
+	size_t destinationSize )
+{
+	HELIUM_ASSERT( pSource || sourceSize == 0 );
+	HELIUM_ASSERT( pDestination || destinationSize == 0 );
+
+	if( type == TYPE_NONE )
+	{
+		size_t copySize = Min( sourceSize, destinationSize );
+		MemoryCopy( pDestination, pSource, copySize );
+
+		return copySize;
+	}
+
+	if( type != TYPE_ZLIB || sourceSize > UINT32_MAX || destinationSize > UINT32_MAX )
+	{
+		return Invalid< size_t >();
+	}
+
+	z_stream stream;
+	MemoryZero( &stream, sizeof( stream ) );
+	stream.next_in = static_cast< Bytef* >( const_cast< void* >( pSource ) );
+	stream.avail_in = static_cast< uInt >( sourceSize );
+	stream.next_out = static_cast< Bytef* >( pDestination );
+	stream.avail_out = static_cast< uInt >( destinationSize );
+
+	if( inflateInit( &stream ) != Z_OK )
+	{
+		return Invalid< size_t >();
+	}
+
+	int result = inflate( &stream, Z_FINISH );
+	size_t bytesDecompressed = destinationSize - stream.avail_out;
+
+	inflateEnd( &stream );
+
+	// Running out of output space is only an error if the caller expected the full block.
+	if( result != Z_STREAM_END && !( ( result == Z_OK || result == Z_BUF_ERROR ) && stream.avail_out == 0 ) )
+	{
+		return Invalid< size_t >();
+	}
+
+	return bytesDecompressed;
+}
+
+/// Get the display name of a compression format.
+///
+/// @param[in] type  Compression format.
+///
+/// @return  Format name.
+const char* Compression::GetTypeName( EType type )
+{
+	switch( type )
+	{
+		case TYPE_NONE:
+		{
+			return "none";
+		}
+
+		case TYPE_ZLIB:
+		{
+			return "zlib";
+		}
+
+		default:
+		{
+			return "unknown";
+		}
+	}
+}
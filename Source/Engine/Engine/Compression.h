@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Engine/Engine.h"
+
+#include "Foundation/DynamicArray.h"
+
+namespace Helium
+{
+	/// Block compression utilities for cached data.
+	///
+	/// Each block is compressed independently, so any block can be decompressed on its own (and on any thread) given
+	/// only its stored bytes and its uncompressed size.
+	class HELIUM_ENGINE_API Compression
+	{
+	public:
+		/// Compression formats.
+		enum EType
+		{
+			TYPE_FIRST   =  0,
+			TYPE_INVALID = -1,
+
+			/// Data is stored as-is.
+			TYPE_NONE,
+			/// Data is stored as a zlib stream.
+			TYPE_ZLIB,
+
+			TYPE_MAX,
+			TYPE_LAST = TYPE_MAX - 1
+		};
+
+		/// @name Compression
+		//@{
+		static bool Compress( EType type, const void* pSource, size_t sourceSize, DynamicArray< uint8_t >& rDestination );
+		static size_t Decompress(
+			EType type, const void* pSource, size_t sourceSize, void* pDestination, size_t destinationSize );
+		//@}
+
+		/// @name Data Access
+		//@{
+		static const char* GetTypeName( EType type );
+		//@}
+	};
+}
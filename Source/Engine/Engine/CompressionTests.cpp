@@ -0,0 +1,319 @@
+#include "Engine/Compression.h"
+
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+#include "Foundation/FileStream.h"
+#include "Engine/AsyncLoader.h"
+#include "Engine/Cache.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Names of the scratch files written by the benchmark, for the raw and compressed caches.
+	const char* const TOC_FILE_NAMES[] = { "CompressionTests.raw.toc", "CompressionTests.zlib.toc" };
+	const char* const CACHE_FILE_NAMES[] = { "CompressionTests.raw.cache", "CompressionTests.zlib.cache" };
+
+	/// Number of entries of each kind in the synthetic cache.
+	const uint32_t TEXTURE_COUNT = 256;
+	const uint32_t MESH_COUNT = 768;
+	/// Entry sizes, in bytes.
+	const uint32_t TEXTURE_SIZE = 256 * 1024;
+	const uint32_t MESH_SIZE = 48 * 1024;
+
+	/// Simple deterministic pseudo-random sequence for test data.
+	uint32_t NextRandom( uint32_t& rState )
+	{
+		rState ^= rState << 13;
+		rState ^= rState >> 17;
+		rState ^= rState << 5;
+
+		return rState;
+	}
+
+	/// Fill a buffer with data resembling an uncompressed texture: smooth gradients with a little noise.
+	void FillTextureData( uint32_t entryIndex, DynamicArray< uint8_t >& rData )
+	{
+		rData.Resize( TEXTURE_SIZE );
+
+		uint32_t state = entryIndex * 2654435761U + 1;
+		for( uint32_t offset = 0; offset < TEXTURE_SIZE; offset += 4 )
+		{
+			uint32_t x = ( offset / 4 ) % 256;
+			uint32_t y = ( offset / 4 ) / 256;
+			uint32_t noise = NextRandom( state ) & 7;
+			rData[ offset ] = static_cast< uint8_t >( x + entryIndex + noise );
+			rData[ offset + 1 ] = static_cast< uint8_t >( y + noise );
+			rData[ offset + 2 ] = static_cast< uint8_t >( ( x + y ) / 2 );
+			rData[ offset + 3 ] = 255;
+		}
+	}
+
+	/// Fill a buffer with data resembling a vertex buffer: positions on a grid, constant normals, and texture
+	/// coordinates.
+	void FillMeshData( uint32_t entryIndex, DynamicArray< uint8_t >& rData )
+	{
+		const size_t floatCount = MESH_SIZE / sizeof( float32_t );
+		rData.Resize( MESH_SIZE );
+		float32_t* pFloats = reinterpret_cast< float32_t* >( rData.GetData() );
+
+		for( size_t vertexIndex = 0; vertexIndex < floatCount / 8; ++vertexIndex )
+		{
+			float32_t* pVertex = pFloats + vertexIndex * 8;
+			pVertex[ 0 ] = static_cast< float32_t >( vertexIndex % 64 ) * 0.25f;
+			pVertex[ 1 ] = static_cast< float32_t >( entryIndex );
+			pVertex[ 2 ] = static_cast< float32_t >( vertexIndex / 64 ) * 0.25f;
+			pVertex[ 3 ] = 0.0f;
+			pVertex[ 4 ] = 1.0f;
+			pVertex[ 5 ] = 0.0f;
+			pVertex[ 6 ] = static_cast< float32_t >( vertexIndex % 64 ) / 64.0f;
+			pVertex[ 7 ] = static_cast< float32_t >( vertexIndex / 64 ) / 64.0f;
+		}
+	}
+
+	void FillEntryData( uint32_t entryIndex, DynamicArray< uint8_t >& rData )
+	{
+		if( entryIndex < TEXTURE_COUNT )
+		{
+			FillTextureData( entryIndex, rData );
+		}
+		else
+		{
+			FillMeshData( entryIndex, rData );
+		}
+	}
+
+	void GetEntryPath( uint32_t entryIndex, AssetPath& rPath )
+	{
+		char pathString[ 64 ];
+		snprintf( pathString, sizeof( pathString ), "/Compression:Entry%u", entryIndex );
+		HELIUM_VERIFY( rPath.Set( pathString ) );
+	}
+
+	class CompressionTest : public testing::Test
+	{
+	protected:
+		Cache m_caches[ 2 ];
+
+		void SetUp()
+		{
+			AsyncLoader::Startup();
+			ASSERT_TRUE( AsyncLoader::GetInstance() != NULL );
+
+			RemoveFiles();
+		}
+
+		void TearDown()
+		{
+			m_caches[ 0 ].Shutdown();
+			m_caches[ 1 ].Shutdown();
+			AsyncLoader::Shutdown();
+
+			RemoveFiles();
+		}
+
+		void RemoveFiles()
+		{
+			for( size_t fileIndex = 0; fileIndex < HELIUM_ARRAY_COUNT( TOC_FILE_NAMES ); ++fileIndex )
+			{
+				remove( TOC_FILE_NAMES[ fileIndex ] );
+				remove( CACHE_FILE_NAMES[ fileIndex ] );
+			}
+		}
+
+		/// Write the synthetic entries to a cache, either raw or compressed.
+		void WriteCache( size_t cacheIndex, Compression::EType compression )
+		{
+			Cache& rCache = m_caches[ cacheIndex ];
+			ASSERT_TRUE( rCache.Initialize(
+				Name( "CompressionTests" ),
+				Cache::PLATFORM_PC,
+				TOC_FILE_NAMES[ cacheIndex ],
+				CACHE_FILE_NAMES[ cacheIndex ] ) );
+			rCache.EnforceTocLoad();
+
+			DynamicArray< uint8_t > data;
+			AssetPath path;
+			for( uint32_t entryIndex = 0; entryIndex < TEXTURE_COUNT + MESH_COUNT; ++entryIndex )
+			{
+				FillEntryData( entryIndex, data );
+				GetEntryPath( entryIndex, path );
+				ASSERT_TRUE( rCache.CacheEntry(
+					path,
+					0,
+					data.GetData(),
+					0,
+					static_cast< uint32_t >( data.GetSize() ),
+					0,
+					compression ) );
+			}
+		}
+
+		uint64_t GetCacheFileSize( size_t cacheIndex )
+		{
+			FileStream* pStream = FileStream::OpenFileStream( CACHE_FILE_NAMES[ cacheIndex ], FileStream::MODE_READ );
+			if( !pStream )
+			{
+				ADD_FAILURE() << "Failed to open " << CACHE_FILE_NAMES[ cacheIndex ];
+
+				return 0;
+			}
+
+			int64_t size = pStream->GetSize();
+			delete pStream;
+
+			return static_cast< uint64_t >( size );
+		}
+
+		/// Load every entry of a cache through the AsyncLoader and check its contents.
+		///
+		/// @return  Time taken to load all entries, in ticks.
+		uint64_t LoadCache( size_t cacheIndex, DynamicArray< uint8_t >& rBuffer )
+		{
+			AsyncLoader* pLoader = AsyncLoader::GetInstance();
+			HELIUM_ASSERT( pLoader );
+
+			const Cache& rCache = m_caches[ cacheIndex ];
+			const uint32_t entryCount = TEXTURE_COUNT + MESH_COUNT;
+
+			DynamicArray< const Cache::Entry* > entries;
+			DynamicArray< size_t > offsets;
+			size_t bufferSize = 0;
+			AssetPath path;
+			for( uint32_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+			{
+				GetEntryPath( entryIndex, path );
+				const Cache::Entry* pEntry = rCache.FindEntry( path, 0 );
+				if( !pEntry )
+				{
+					ADD_FAILURE() << "Missing entry " << *path.ToString();
+
+					return 0;
+				}
+
+				entries.Push( pEntry );
+				offsets.Push( bufferSize );
+				bufferSize += pEntry->size;
+			}
+
+			rBuffer.Resize( bufferSize );
+
+			DynamicArray< size_t > requestIds;
+			requestIds.Reserve( entryCount );
+
+			uint64_t startTicks = Timer::GetTickCount();
+			for( uint32_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+			{
+				const Cache::Entry& rEntry = *entries[ entryIndex ];
+				requestIds.Push( rCache.QueueEntryLoad( rEntry, rBuffer.GetData() + offsets[ entryIndex ], rEntry.size ) );
+			}
+
+			for( uint32_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+			{
+				EXPECT_EQ( entries[ entryIndex ]->size, pLoader->SyncRequest( requestIds[ entryIndex ] ) );
+			}
+
+			uint64_t ticks = Timer::GetTickCount() - startTicks;
+
+			DynamicArray< uint8_t > expected;
+			for( uint32_t entryIndex = 0; entryIndex < entryCount; ++entryIndex )
+			{
+				FillEntryData( entryIndex, expected );
+				if( memcmp( expected.GetData(), rBuffer.GetData() + offsets[ entryIndex ], expected.GetSize() ) != 0 )
+				{
+					ADD_FAILURE() << "Wrong data for entry " << entryIndex;
+
+					return ticks;
+				}
+			}
+
+			return ticks;
+		}
+	};
+}
+
+TEST_F( CompressionTest, CompressesBlocks )
+{
+	DynamicArray< uint8_t > source;
+	FillTextureData( 0, source );
+
+	DynamicArray< uint8_t > compressed;
+	ASSERT_TRUE( Compression::Compress( Compression::TYPE_ZLIB, source.GetData(), source.GetSize(), compressed ) );
+	EXPECT_LT( compressed.GetSize(), source.GetSize() );
+
+	DynamicArray< uint8_t > decompressed;
+	decompressed.Resize( source.GetSize() );
+	ASSERT_EQ( source.GetSize(), Compression::Decompress(
+		Compression::TYPE_ZLIB,
+		compressed.GetData(),
+		compressed.GetSize(),
+		decompressed.GetData(),
+		decompressed.GetSize() ) );
+	EXPECT_EQ( 0, memcmp( source.GetData(), decompressed.GetData(), source.GetSize() ) );
+
+	// The start of a block can be decompressed on its own.
+	uint8_t start[ 100 ];
+	ASSERT_EQ( sizeof( start ), Compression::Decompress(
+		Compression::TYPE_ZLIB,
+		compressed.GetData(),
+		compressed.GetSize(),
+		start,
+		sizeof( start ) ) );
+	EXPECT_EQ( 0, memcmp( source.GetData(), start, sizeof( start ) ) );
+
+	// Data that does not shrink is left to be stored uncompressed.
+	uint32_t state = 12345;
+	for( size_t byteIndex = 0; byteIndex < source.GetSize(); ++byteIndex )
+	{
+		source[ byteIndex ] = static_cast< uint8_t >( NextRandom( state ) );
+	}
+
+	EXPECT_FALSE( Compression::Compress( Compression::TYPE_ZLIB, source.GetData(), source.GetSize(), compressed ) );
+	EXPECT_FALSE( Compression::Compress( Compression::TYPE_NONE, source.GetData(), source.GetSize(), compressed ) );
+}
+
+TEST_F( CompressionTest, BenchmarkSyntheticCache )
+{
+	WriteCache( 0, Compression::TYPE_NONE );
+	WriteCache( 1, Compression::TYPE_ZLIB );
+
+	AssetPath path;
+	GetEntryPath( 0, path );
+	const Cache::Entry* pRawEntry = m_caches[ 0 ].FindEntry( path, 0 );
+	const Cache::Entry* pCompressedEntry = m_caches[ 1 ].FindEntry( path, 0 );
+	ASSERT_TRUE( pRawEntry != NULL );
+	ASSERT_TRUE( pCompressedEntry != NULL );
+	EXPECT_EQ( Compression::TYPE_NONE, pRawEntry->compression );
+	EXPECT_EQ( pRawEntry->size, pRawEntry->storedSize );
+	EXPECT_EQ( Compression::TYPE_ZLIB, pCompressedEntry->compression );
+	EXPECT_EQ( pRawEntry->size, pCompressedEntry->size );
+	EXPECT_LT( pCompressedEntry->storedSize, pCompressedEntry->size );
+
+	uint64_t rawSize = GetCacheFileSize( 0 );
+	uint64_t compressedSize = GetCacheFileSize( 1 );
+	EXPECT_LT( compressedSize, rawSize );
+
+	DynamicArray< uint8_t > buffer;
+
+	// Warm the page cache so that both runs measure reading and decompression rather than the disk.
+	LoadCache( 0, buffer );
+	LoadCache( 1, buffer );
+
+	uint64_t rawTicks = LoadCache( 0, buffer );
+	uint64_t compressedTicks = LoadCache( 1, buffer );
+
+	printf(
+		"%u entries: raw %.1f KiB loaded in %.3f ms, %s %.1f KiB (%.1f%%) loaded in %.3f ms\n",
+		TEXTURE_COUNT + MESH_COUNT,
+		static_cast< double >( rawSize ) / 1024.0,
+		Timer::TicksToMilliseconds( rawTicks ),
+		Compression::GetTypeName( Compression::TYPE_ZLIB ),
+		static_cast< double >( compressedSize ) / 1024.0,
+		100.0 * static_cast< double >( compressedSize ) / static_cast< double >( rawSize ),
+		Timer::TicksToMilliseconds( compressedTicks ) );
+}
@@ -0,0 +1,247 @@
+#include "Precompile.h"
+#include "Engine/LoadTrace.h"
+
+#include "Platform/Timer.h"
+#include "Foundation/FileStream.h"
+
+using namespace Helium;
+
+/// Trace file header tag.
+#define LOAD_TRACE_HEADER_TAG "HeliumLoadTrace"
+
+/// Constructor.
+LoadTrace::LoadTrace()
+: m_startTickCount( 0 )
+{
+}
+
+/// Destructor.
+LoadTrace::~LoadTrace()
+{
+}
+
+/// Clear any existing records and start timing requests from now on.
+///
+/// @see Add()
+void LoadTrace::Start()
+{
+	MutexScopeLock scopeLock( m_lock );
+
+	m_records.Clear();
+	m_startTickCount = Timer::GetTickCount();
+}
+
+/// Record a cache entry request.
+///
+/// @param[in] cacheName     Name of the cache from which the entry was requested.
+/// @param[in] path          Entry path.
+/// @param[in] subDataIndex  Entry sub-data index.
+///
+/// @see Start()
+void LoadTrace::Add( Name cacheName, AssetPath path, uint32_t subDataIndex )
+{
+	uint64_t tickCount = Timer::GetTickCount();
+
+	MutexScopeLock scopeLock( m_lock );
+
+	uint64_t elapsedTicks = ( tickCount > m_startTickCount ? tickCount - m_startTickCount : 0 );
+
+	Record* pRecord = m_records.New();
+	HELIUM_ASSERT( pRecord );
+	pRecord->time = static_cast< uint64_t >(
+		static_cast< float64_t >( elapsedTicks ) * 1000000.0 / static_cast< float64_t >( Timer::GetTicksPerSecond() ) );
+	pRecord->cacheName = cacheName;
+	pRecord->path = path;
+	pRecord->subDataIndex = subDataIndex;
+}
+
+/// Remove all recorded requests.
+void LoadTrace::Clear()
+{
+	MutexScopeLock scopeLock( m_lock );
+
+	m_records.Clear();
+}
+
+/// Write this trace to a file.
+///
+/// @param[in] pFileName  Name of the file to write.
+///
+/// @return  True if the trace was saved successfully, false if not.
+///
+/// @see Load()
+bool LoadTrace::Save( const char* pFileName ) const
+{
+	HELIUM_ASSERT( pFileName );
+
+	MutexScopeLock scopeLock( m_lock );
+
+	char lineBuffer[ 128 ];
+	StringPrint( lineBuffer, "%s %" PRIu32 "\n", LOAD_TRACE_HEADER_TAG, sm_Version );
+	lineBuffer[ HELIUM_ARRAY_COUNT( lineBuffer ) - 1 ] = '\0';
+
+	String traceText( lineBuffer );
+
+	String pathString;
+	size_t recordCount = m_records.GetSize();
+	for( size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex )
+	{
+		const Record& rRecord = m_records[ recordIndex ];
+
+		// The path is written last, as it is the only field that may contain spaces.
+		StringPrint(
+			lineBuffer,
+			"%" PRIu64 "\t%s\t%" PRIu32 "\t",
+			rRecord.time,
+			*rRecord.cacheName,
+			rRecord.subDataIndex );
+		lineBuffer[ HELIUM_ARRAY_COUNT( lineBuffer ) - 1 ] = '\0';
+
+		rRecord.path.ToString( pathString );
+
+		traceText += lineBuffer;
+		traceText += pathString;
+		traceText += "\n";
+	}
+
+	FileStream* pStream = FileStream::OpenFileStream( pFileName, FileStream::MODE_WRITE, true );
+	if( !pStream )
+	{
+		HELIUM_TRACE( TraceLevels::Error, "LoadTrace::Save(): Failed to open \"%s\" for writing.\n", pFileName );
+
+		return false;
+	}
+
+	size_t traceSize = traceText.GetSize();
+	bool bSuccess = ( pStream->Write( traceText.GetData(), 1, traceSize ) == traceSize );
+
+	delete pStream;
+
+	if( !bSuccess )
+	{
+		HELIUM_TRACE( TraceLevels::Error, "LoadTrace::Save(): Failed to write \"%s\".\n", pFileName );
+
+		return false;
+	}
+
+	HELIUM_TRACE(
+		TraceLevels::Info,
+		"LoadTrace: Saved %" PRIuSZ " requests to \"%s\".\n",
+		recordCount,
+		pFileName );
+
+	return true;
+}
+
+/// Replace the contents of this trace with those of a trace file.
+///
+/// Malformed records are skipped.
+///
+/// @param[in] pFileName  Name of the file to read.
+///
+/// @return  True if the trace was loaded successfully, false if the file could not be read or is not a trace file.
+///
+/// @see Save()
+bool LoadTrace::Load( const char* pFileName )
+{
+	HELIUM_ASSERT( pFileName );
+
+	MutexScopeLock scopeLock( m_lock );
+
+	m_records.Clear();
+
+	FileStream* pStream = FileStream::OpenFileStream( pFileName, FileStream::MODE_READ );
+	if( !pStream )
+	{
+		HELIUM_TRACE( TraceLevels::Error, "LoadTrace::Load(): Failed to open \"%s\" for reading.\n", pFileName );
+
+		return false;
+	}
+
+	int64_t fileSize = pStream->GetSize();
+	DynamicArray< char > traceText;
+	if( fileSize > 0 )
+	{
+		traceText.Resize( static_cast< size_t >( fileSize ) );
+		traceText.Resize( pStream->Read( traceText.GetData(), 1, traceText.GetSize() ) );
+	}
+
+	delete pStream;
+
+	traceText.Push( '\0' );
+
+	// Split the text into lines and fields in place.
+	char* pLine = traceText.GetData();
+	size_t lineIndex = 0;
+	while( *pLine )
+	{
+		char* pLineEnd = pLine;
+		while( *pLineEnd && *pLineEnd != '\n' )
+		{
+			++pLineEnd;
+		}
+
+		char* pNextLine = ( *pLineEnd ? pLineEnd + 1 : pLineEnd );
+		*pLineEnd = '\0';
+		if( pLineEnd != pLine && pLineEnd[ -1 ] == '\r' )
+		{
+			pLineEnd[ -1 ] = '\0';
+		}
+
+		if( lineIndex == 0 )
+		{
+			uint32_t version = 0;
+			if( StringScan( pLine, LOAD_TRACE_HEADER_TAG " %" SCNu32, &version ) != 1 || version != sm_Version )
+			{
+				HELIUM_TRACE(
+					TraceLevels::Error,
+					"LoadTrace::Load(): \"%s\" is not a load trace file (version %" PRIu32 ").\n",
+					pFileName,
+					sm_Version );
+
+				return false;
+			}
+		}
+		else if( *pLine )
+		{
+			char* pFields[ 4 ] = { pLine, NULL, NULL, NULL };
+			size_t fieldCount = 1;
+			for( char* pCharacter = pLine; *pCharacter && fieldCount < HELIUM_ARRAY_COUNT( pFields ); ++pCharacter )
+			{
+				if( *pCharacter == '\t' )
+				{
+					*pCharacter = '\0';
+					pFields[ fieldCount++ ] = pCharacter + 1;
+				}
+			}
+
+			Record record;
+			bool bValid =
+				fieldCount == HELIUM_ARRAY_COUNT( pFields ) &&
+				StringScan( pFields[ 0 ], "%" SCNu64, &record.time ) == 1 &&
+				*pFields[ 1 ] != '\0' &&
+				StringScan( pFields[ 2 ], "%" SCNu32, &record.subDataIndex ) == 1 &&
+				record.path.Set( pFields[ 3 ] );
+			if( bValid )
+			{
+				record.cacheName = Name( pFields[ 1 ] );
+				m_records.Push( record );
+			}
+			else
+			{
+				HELIUM_TRACE(
+					TraceLevels::Warning,
+					"LoadTrace::Load(): Skipping malformed record on line %" PRIuSZ " of \"%s\".\n",
+					lineIndex + 1,
+					pFileName );
+			}
+		}
+
+		pLine = pNextLine;
+		++lineIndex;
+	}
+
+	m_records.Trim();
+
+	return true;
+}
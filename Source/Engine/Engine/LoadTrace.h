@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Engine/Engine.h"
+
+#include "Platform/Locks.h"
+
+#include "Foundation/DynamicArray.h"
+#include "Engine/AssetPath.h"
+
+namespace Helium
+{
+	/// Record of the cache entries requested during a loading session, in the order in which they were requested.
+	///
+	/// Traces are recorded by the AssetLoader (see AssetLoader::BeginLoadTrace()) and saved as plain text, one request
+	/// per line.  A recorded trace can be used to lay out cache files so that a typical load reads them sequentially
+	/// (see Cache::OptimizeLayout()), and can be replayed against a cache to measure how well its layout suits that load
+	/// (see Cache::ReplayLoadTrace()).
+	class HELIUM_ENGINE_API LoadTrace : NonCopyable
+	{
+	public:
+		/// Trace file format version.
+		static const uint32_t sm_Version = 1;
+
+		/// Cache entry request.
+		struct Record
+		{
+			/// Time at which the entry was requested, in microseconds since the trace was started.
+			uint64_t time;
+			/// Name of the cache from which the entry was requested.
+			Name cacheName;
+			/// Entry path.
+			AssetPath path;
+			/// Entry sub-data index.
+			uint32_t subDataIndex;
+		};
+
+		/// @name Construction/Destruction
+		//@{
+		LoadTrace();
+		~LoadTrace();
+		//@}
+
+		/// @name Recording
+		//@{
+		void Start();
+		void Add( Name cacheName, AssetPath path, uint32_t subDataIndex );
+		void Clear();
+		//@}
+
+		/// @name Data Access
+		//@{
+		inline size_t GetRecordCount() const;
+		inline const Record& GetRecord( size_t index ) const;
+		//@}
+
+		/// @name Serialization
+		//@{
+		bool Save( const char* pFileName ) const;
+		bool Load( const char* pFileName );
+		//@}
+
+	private:
+		/// Recorded requests.
+		DynamicArray< Record > m_records;
+		/// Tick count at which recording was started.
+		uint64_t m_startTickCount;
+		/// Mutex protecting the record list (requests may be recorded from any thread).
+		mutable Mutex m_lock;
+	};
+}
+
+#include "Engine/LoadTrace.inl"
@@ -0,0 +1,27 @@
+/// Get the number of requests recorded in this trace.
+///
+/// This should not be called while requests are still being recorded from other threads.
+///
+/// @return  Record count.
+///
+/// @see GetRecord()
+size_t Helium::LoadTrace::GetRecordCount() const
+{
+    return m_records.GetSize();
+}
+
+/// Get a recorded request.
+///
+/// This should not be called while requests are still being recorded from other threads.
+///
+/// @param[in] index  Record index.
+///
+/// @return  Recorded request.
+///
+/// @see GetRecordCount()
+const Helium::LoadTrace::Record& Helium::LoadTrace::GetRecord( size_t index ) const
+{
+    HELIUM_ASSERT( index < m_records.GetSize() );
+
+    return m_records[ index ];
+}
@@ -0,0 +1,328 @@
+#include "Engine/LoadTrace.h"
+
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+#include "Foundation/FileStream.h"
+#include "Engine/AsyncLoader.h"
+#include "Engine/Cache.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Names of the scratch files written by the tests.
+	const char TOC_FILE_NAME[] = "LoadTraceTests.toc";
+	const char CACHE_FILE_NAME[] = "LoadTraceTests.cache";
+	const char TRACE_FILE_NAME[] = "LoadTraceTests.trace";
+
+	/// Number of objects in the synthetic cache.
+	const uint32_t OBJECT_COUNT = 4096;
+	/// Number of objects loaded together as a group (a level section, for instance).
+	const uint32_t GROUP_SIZE = 64;
+	/// Every object at a multiple of this index is requested on demand and lists the objects up to the next one as its
+	/// dependencies.
+	const uint32_t ROOT_INTERVAL = 4;
+	/// Every object at a multiple of this index also has resource sub-data.
+	const uint32_t RESOURCE_INTERVAL = 8;
+	/// Size of the resource sub-data, in bytes.
+	const uint32_t RESOURCE_SIZE = 16 * 1024;
+
+	/// Time between the on-demand requests within a group, and between groups, in microseconds.
+	const uint64_t REQUEST_INTERVAL = 1000;
+	const uint64_t GROUP_INTERVAL = 100000;
+
+	void GetObjectPath( uint32_t objectIndex, AssetPath& rPath )
+	{
+		char pathString[ 64 ];
+		snprintf(
+			pathString,
+			sizeof( pathString ),
+			"/LoadTrace/Group%u:Object%u",
+			objectIndex / GROUP_SIZE,
+			objectIndex );
+		HELIUM_VERIFY( rPath.Set( pathString ) );
+	}
+
+	uint32_t GetEntrySize( uint32_t objectIndex, uint32_t subDataIndex )
+	{
+		return ( subDataIndex == 0 ? 512 + ( ( objectIndex * 7919 ) % 8 ) * 1024 : RESOURCE_SIZE );
+	}
+
+	uint8_t GetEntryByte( uint32_t objectIndex, uint32_t subDataIndex, uint32_t offset )
+	{
+		return static_cast< uint8_t >( ( ( objectIndex * 31 + subDataIndex ) * 2654435761U + offset * 40503U ) >> 11 );
+	}
+
+	class LoadTraceTest : public testing::Test
+	{
+	protected:
+		Name m_cacheName;
+		Cache m_cache;
+		LoadTrace m_trace;
+
+		LoadTraceTest()
+			: m_cacheName( "LoadTraceTests" )
+		{
+		}
+
+		void SetUp()
+		{
+			AsyncLoader::Startup();
+			ASSERT_TRUE( AsyncLoader::GetInstance() != NULL );
+
+			remove( TOC_FILE_NAME );
+			remove( CACHE_FILE_NAME );
+		}
+
+		void TearDown()
+		{
+			m_cache.Shutdown();
+			AsyncLoader::Shutdown();
+
+			remove( TOC_FILE_NAME );
+			remove( CACHE_FILE_NAME );
+			remove( TRACE_FILE_NAME );
+		}
+
+		/// Initialize the cache from the scratch files and load its TOC, as a new run of the loader would.
+		void OpenCache()
+		{
+			ASSERT_TRUE( m_cache.Initialize( m_cacheName, Cache::PLATFORM_PC, TOC_FILE_NAME, CACHE_FILE_NAME ) );
+			m_cache.EnforceTocLoad();
+		}
+
+		/// Write every object to a new cache in an order unrelated to the order in which they are loaded, as happens
+		/// when assets are cached as they are edited.
+		void WriteCache()
+		{
+			OpenCache();
+
+			DynamicArray< uint8_t > data;
+			AssetPath path;
+			for( uint32_t writeIndex = 0; writeIndex < OBJECT_COUNT; ++writeIndex )
+			{
+				uint32_t objectIndex = ( writeIndex * 2749 ) % OBJECT_COUNT;
+				GetObjectPath( objectIndex, path );
+
+				for( uint32_t subDataIndex = 0; subDataIndex < 2; ++subDataIndex )
+				{
+					if( subDataIndex == 1 && objectIndex % RESOURCE_INTERVAL != 0 )
+					{
+						continue;
+					}
+
+					uint32_t size = GetEntrySize( objectIndex, subDataIndex );
+					data.Resize( size );
+					for( uint32_t offset = 0; offset < size; ++offset )
+					{
+						data[ offset ] = GetEntryByte( objectIndex, subDataIndex, offset );
+					}
+
+					ASSERT_TRUE( m_cache.CacheEntry( path, subDataIndex, data.GetData(), 0, size ) );
+				}
+
+#if HELIUM_TOOLS
+				if( objectIndex % ROOT_INTERVAL == 0 )
+				{
+					DynamicArray< AssetPath > dependencies;
+					for( uint32_t dependencyIndex = objectIndex + 1; dependencyIndex < objectIndex + ROOT_INTERVAL; ++dependencyIndex )
+					{
+						GetObjectPath( dependencyIndex, *dependencies.New() );
+					}
+
+					Cache::WriteDependencyManifest( dependencies, data );
+					ASSERT_TRUE( m_cache.CacheEntry(
+						path,
+						Cache::DEPENDENCY_MANIFEST_SUB_DATA_INDEX,
+						data.GetData(),
+						0,
+						static_cast< uint32_t >( data.GetSize() ) ) );
+				}
+#endif
+			}
+		}
+
+		/// Write a trace of loading every group in turn, and load it back.  The requests for dependencies follow the
+		/// request for the object that lists them, as the loader records them once the dependency manifest is read.
+		void WriteTrace()
+		{
+			FILE* pFile = fopen( TRACE_FILE_NAME, "wb" );
+			ASSERT_TRUE( pFile != NULL );
+
+			fprintf( pFile, "HeliumLoadTrace %u\n", LoadTrace::sm_Version );
+
+			AssetPath path;
+			uint64_t time = 0;
+			for( uint32_t objectIndex = 0; objectIndex < OBJECT_COUNT; ++objectIndex )
+			{
+				if( objectIndex % ROOT_INTERVAL == 0 )
+				{
+					time += ( objectIndex % GROUP_SIZE == 0 ? GROUP_INTERVAL : REQUEST_INTERVAL );
+				}
+
+				GetObjectPath( objectIndex, path );
+				fprintf( pFile, "%llu\t%s\t0\t%s\n", static_cast< unsigned long long >( time ), *m_cacheName, *path.ToString() );
+
+				if( objectIndex % RESOURCE_INTERVAL == 0 )
+				{
+					fprintf( pFile, "%llu\t%s\t1\t%s\n", static_cast< unsigned long long >( time ), *m_cacheName, *path.ToString() );
+				}
+			}
+
+			fclose( pFile );
+
+			ASSERT_TRUE( m_trace.Load( TRACE_FILE_NAME ) );
+		}
+
+		/// Check that every entry still holds the data written by WriteCache().
+		bool CheckEntryData()
+		{
+			FileStream* pStream = FileStream::OpenFileStream( CACHE_FILE_NAME, FileStream::MODE_READ );
+			if( !pStream )
+			{
+				ADD_FAILURE() << "Failed to open " << CACHE_FILE_NAME;
+
+				return false;
+			}
+
+			bool bSuccess = true;
+			DynamicArray< uint8_t > data;
+			AssetPath path;
+			for( uint32_t objectIndex = 0; objectIndex < OBJECT_COUNT && bSuccess; ++objectIndex )
+			{
+				GetObjectPath( objectIndex, path );
+
+				for( uint32_t subDataIndex = 0; subDataIndex < 2 && bSuccess; ++subDataIndex )
+				{
+					if( subDataIndex == 1 && objectIndex % RESOURCE_INTERVAL != 0 )
+					{
+						continue;
+					}
+
+					const Cache::Entry* pEntry = m_cache.FindEntry( path, subDataIndex );
+					bSuccess = ( pEntry && m_cache.ReadEntryData( *pEntry, pStream, data ) );
+					bSuccess = bSuccess && data.GetSize() == GetEntrySize( objectIndex, subDataIndex );
+					for( uint32_t offset = 0; offset < data.GetSize() && bSuccess; offset += 97 )
+					{
+						bSuccess = ( data[ offset ] == GetEntryByte( objectIndex, subDataIndex, offset ) );
+					}
+
+					if( !bSuccess )
+					{
+						ADD_FAILURE() << "Wrong data for " << *path.ToString() << " sub-data " << subDataIndex;
+					}
+				}
+			}
+
+			delete pStream;
+
+			return bSuccess;
+		}
+
+		Cache::ReplayStatistics Replay( const char* pLayoutName )
+		{
+			Cache::ReplayStatistics statistics;
+			EXPECT_TRUE( m_cache.ReplayLoadTrace( m_trace, statistics ) );
+
+			printf(
+				"%-10s %u requests, %u reads, %u seeks, %.1f KiB read\n",
+				pLayoutName,
+				statistics.requestCount,
+				statistics.readCount,
+				statistics.seekCount,
+				static_cast< double >( statistics.bytesRead ) / 1024.0 );
+
+			return statistics;
+		}
+	};
+}
+
+TEST_F( LoadTraceTest, SavesAndLoadsRecords )
+{
+	AssetPath objectPath( "/LoadTrace/Group0:Object0" );
+	AssetPath packagePath( "/LoadTrace/Group0" );
+
+	LoadTrace trace;
+	trace.Start();
+	trace.Add( m_cacheName, objectPath, 0 );
+	trace.Add( Name( "Other" ), packagePath, 3 );
+	ASSERT_TRUE( trace.Save( TRACE_FILE_NAME ) );
+
+	LoadTrace loadedTrace;
+	ASSERT_TRUE( loadedTrace.Load( TRACE_FILE_NAME ) );
+	ASSERT_EQ( trace.GetRecordCount(), loadedTrace.GetRecordCount() );
+	for( size_t recordIndex = 0; recordIndex < trace.GetRecordCount(); ++recordIndex )
+	{
+		const LoadTrace::Record& rRecord = trace.GetRecord( recordIndex );
+		const LoadTrace::Record& rLoadedRecord = loadedTrace.GetRecord( recordIndex );
+		EXPECT_EQ( rRecord.time, rLoadedRecord.time );
+		EXPECT_TRUE( rRecord.cacheName == rLoadedRecord.cacheName );
+		EXPECT_TRUE( rRecord.path == rLoadedRecord.path );
+		EXPECT_EQ( rRecord.subDataIndex, rLoadedRecord.subDataIndex );
+	}
+
+	// Files that are not traces are rejected.
+	FILE* pFile = fopen( TRACE_FILE_NAME, "wb" );
+	ASSERT_TRUE( pFile != NULL );
+	fputs( "0\tLoadTraceTests\t0\t/LoadTrace/Group0:Object0\n", pFile );
+	fclose( pFile );
+	EXPECT_FALSE( loadedTrace.Load( TRACE_FILE_NAME ) );
+}
+
+#if HELIUM_TOOLS
+
+TEST_F( LoadTraceTest, BenchmarkReplay )
+{
+	WriteCache();
+	WriteTrace();
+	ASSERT_EQ( OBJECT_COUNT + OBJECT_COUNT / RESOURCE_INTERVAL, m_trace.GetRecordCount() );
+
+	Cache::ReplayStatistics original = Replay( "original" );
+	EXPECT_EQ( m_trace.GetRecordCount(), original.requestCount );
+
+	// Replaying does not depend on timing, so the results are the same every time.
+	Cache::ReplayStatistics repeated = Replay( "repeated" );
+	EXPECT_EQ( original.readCount, repeated.readCount );
+	EXPECT_EQ( original.seekCount, repeated.seekCount );
+	EXPECT_EQ( original.bytesRead, repeated.bytesRead );
+
+	uint64_t startTicks = Timer::GetTickCount();
+	ASSERT_TRUE( m_cache.OptimizeLayout( m_trace ) );
+	uint64_t optimizeTicks = Timer::GetTickCount() - startTicks;
+
+	Cache::ReplayStatistics optimized = Replay( "optimized" );
+	EXPECT_EQ( original.requestCount, optimized.requestCount );
+	EXPECT_EQ( original.bytesRead, optimized.bytesRead );
+	EXPECT_LT( optimized.seekCount, original.seekCount );
+	EXPECT_TRUE( CheckEntryData() );
+
+	// The new layout is picked up by the next run.
+	m_cache.Shutdown();
+	OpenCache();
+	Cache::ReplayStatistics reopened = Replay( "reopened" );
+	EXPECT_EQ( optimized.readCount, reopened.readCount );
+	EXPECT_EQ( optimized.seekCount, reopened.seekCount );
+	EXPECT_TRUE( CheckEntryData() );
+
+	startTicks = Timer::GetTickCount();
+	ASSERT_TRUE( m_cache.OptimizeLayout( m_trace, true ) );
+	uint64_t bundleTicks = Timer::GetTickCount() - startTicks;
+
+	// Bundling prefetches whole groups with one read per group rather than one per object requested on demand.
+	Cache::ReplayStatistics bundled = Replay( "bundled" );
+	EXPECT_EQ( original.requestCount, bundled.requestCount );
+	EXPECT_LT( bundled.readCount, optimized.readCount );
+	EXPECT_TRUE( CheckEntryData() );
+
+	printf(
+		"%u objects: layout %.3f ms, bundled layout %.3f ms\n",
+		OBJECT_COUNT,
+		Timer::TicksToMilliseconds( optimizeTicks ),
+		Timer::TicksToMilliseconds( bundleTicks ) );
+}
+
+#endif  // HELIUM_TOOLS
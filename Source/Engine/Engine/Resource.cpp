@@ -4,6 +4,7 @@
 #include "Engine/AsyncLoader.h"
 #include "Reflect/MetaClass.h"
 #include "Engine/Asset.h"
+#include "Engine/AssetLoader.h"
 #include "Engine/CacheManager.h"
 
 HELIUM_IMPLEMENT_ASSET( Helium::Resource, Engine, 0 );
@@ -76,6 +77,74 @@ size_t Resource::GetSubDataSize( uint32_t subDataIndex ) const
 	return ( pCacheEntry ? pCacheEntry->size : Invalid< size_t >() );
 }
 
+/// Get direct access to the specified resource sub-data if it is already available in memory.
+///
+/// This succeeds for in-memory preprocessed data and for data in memory mapped caches, allowing the sub-data to be
+/// consumed in place without allocating a buffer and issuing a load request.  The data remains valid until the
+/// resource cache is shut down (or, for in-memory preprocessed data, until the resource is re-preprocessed).
+///
+/// @param[in]  subDataIndex  Resource sub-data index.
+/// @param[out] rpData        Pointer to the sub-data.
+/// @param[out] rSize         Sub-data size, in bytes.
+///
+/// @return  True if the sub-data is available in memory, false if it must be loaded using BeginLoadSubData().
+///
+/// @see BeginLoadSubData(), GetSubDataSize()
+bool Resource::GetSubDataView( uint32_t subDataIndex, const uint8_t*& rpData, size_t& rSize )
+{
+	CacheManager* pCacheManager = CacheManager::GetInstance();
+	HELIUM_ASSERT( pCacheManager );
+
+#if HELIUM_TOOLS
+	// Check for in-memory data first.
+	Cache::EPlatform platform = pCacheManager->GetCurrentPlatform();
+	const PreprocessedData& rPreprocessedData = GetPreprocessedData( platform );
+	if( rPreprocessedData.bLoaded )
+	{
+		const DynamicArray< DynamicArray< uint8_t > >& rSubDataBuffers = rPreprocessedData.subDataBuffers;
+		if( subDataIndex >= rSubDataBuffers.GetSize() )
+		{
+			return false;
+		}
+
+		const DynamicArray< uint8_t >& rSubData = rSubDataBuffers[ subDataIndex ];
+		rpData = rSubData.GetData();
+		rSize = rSubData.GetSize();
+
+		return true;
+	}
+#endif
+
+	Name cacheName = GetCacheName();
+	HELIUM_ASSERT( !cacheName.IsEmpty() );
+
+	Cache* pCache = pCacheManager->GetCache( cacheName );
+	HELIUM_ASSERT( pCache );
+	if( !pCache->IsMemoryMapped() )
+	{
+		return false;
+	}
+
+	pCache->EnforceTocLoad();
+
+	const Cache::Entry* pCacheEntry = pCache->FindEntry( GetPath(), subDataIndex );
+	if( !pCacheEntry )
+	{
+		return false;
+	}
+
+	RecordSubDataRequest( pCache, subDataIndex );
+
+	if( !pCache->GetEntryData( *pCacheEntry, rpData ) )
+	{
+		return false;
+	}
+
+	rSize = pCacheEntry->size;
+
+	return true;
+}
+
 /// Begin asynchronous loading of the specified resource sub-data.
 ///
 /// @param[in] pBuffer       Buffer in which to load the resource sub-data.  This must be at least as large as the
@@ -133,14 +202,22 @@ size_t Resource::BeginLoadSubData( void* pBuffer, uint32_t subDataIndex, size_t
 		return Invalid< size_t >();
 	}
 
-	// Begin an asynchronous load.
+	RecordSubDataRequest( pCache, subDataIndex );
+
 	size_t subDataSize = pCacheEntry->size;
 	size_t loadSize = Min( subDataSize, loadSizeMax );
 
-	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
-	HELIUM_ASSERT( pAsyncLoader );
+	// If the cache is memory mapped, copy the sub-data immediately and assign a dummy ID.
+	const uint8_t* pMappedData;
+	if( pCache->GetEntryData( *pCacheEntry, pMappedData ) )
+	{
+		MemoryCopy( pBuffer, pMappedData, loadSize );
+
+		return static_cast< size_t >( -2 );
+	}
 
-	size_t loadId = pAsyncLoader->QueueRequest( pBuffer, pCache->GetCacheFileName(), pCacheEntry->offset, loadSize );
+	// Begin an asynchronous load (compressed sub-data is decompressed by the AsyncLoader).
+	size_t loadId = pCache->QueueEntryLoad( *pCacheEntry, pBuffer, loadSize );
 
 	return loadId;
 }
@@ -154,13 +231,11 @@ bool Resource::TryFinishLoadSubData( size_t loadId )
 {
 	HELIUM_ASSERT( IsValid( loadId ) );
 
-#if HELIUM_TOOLS
 	// If the load request was an in-memory request, we don't need to sync as they are performed immediately.
 	if( loadId == static_cast< size_t >( -2 ) )
 	{
 		return true;
 	}
-#endif
 
 	// Check the async load request.
 	AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
@@ -171,3 +246,20 @@ bool Resource::TryFinishLoadSubData( size_t loadId )
 
 	return bFinished;
 }
+
+/// Record a sub-data request from the resource cache in the active load trace, if any.
+///
+/// @param[in] pCache        Resource cache.
+/// @param[in] subDataIndex  Resource sub-data index.
+///
+/// @see AssetLoader::BeginLoadTrace()
+void Resource::RecordSubDataRequest( Cache* pCache, uint32_t subDataIndex ) const
+{
+	HELIUM_ASSERT( pCache );
+
+	AssetLoader* pAssetLoader = AssetLoader::GetInstance();
+	if( pAssetLoader )
+	{
+		pAssetLoader->RecordLoadTraceRequest( pCache->GetName(), GetPath(), subDataIndex );
+	}
+}
@@ -64,11 +64,17 @@ namespace Helium
 		/// @name Resource Loading Utility Functions
 		//@{
 		size_t GetSubDataSize( uint32_t subDataIndex ) const;
+		bool GetSubDataView( uint32_t subDataIndex, const uint8_t*& rpData, size_t& rSize );
 		size_t BeginLoadSubData( void* pBuffer, uint32_t subDataIndex, size_t loadSizeMax = Invalid< size_t >() );
 		bool TryFinishLoadSubData( size_t loadId );
 		//@}
 
 	private:
+		/// @name Private Utility Functions
+		//@{
+		void RecordSubDataRequest( Cache* pCache, uint32_t subDataIndex ) const;
+		//@}
+
 #if HELIUM_TOOLS
 		/// In-memory preprocessed resource data for each platform.
 		PreprocessedData m_preprocessedData[ Cache::PLATFORM_MAX ];
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Engine/Engine.h"
+
+namespace Helium
+{
+	/// Initial value for StableHash64() (the 64-bit FNV-1a offset basis).
+	static const uint64_t STABLE_HASH_64_BASIS = 14695981039346656037ULL;
+
+	inline uint64_t StableHash64( uint64_t hash, const void* pData, size_t size );
+	inline uint64_t StableHash64( const void* pData, size_t size );
+}
+
+#include "Engine/StableHash.inl"
@@ -0,0 +1,34 @@
+/// Add a block of data to a 64-bit hash that remains stable between runs, builds, and platforms.
+///
+/// This uses 64-bit FNV-1a, and is intended for hashes that are written to disk (cache TOC path hashes, content
+/// hashes, and shader cache keys), where std::hash or pointer-based hashes cannot be used.
+///
+/// @param[in] hash   Current hash value (STABLE_HASH_64_BASIS for a new hash).
+/// @param[in] pData  Data to hash.
+/// @param[in] size   Number of bytes to hash.
+///
+/// @return  Updated hash value.
+uint64_t Helium::StableHash64( uint64_t hash, const void* pData, size_t size )
+{
+    HELIUM_ASSERT( pData || size == 0 );
+
+    const uint8_t* pBytes = static_cast< const uint8_t* >( pData );
+    for( size_t byteIndex = 0; byteIndex < size; ++byteIndex )
+    {
+        hash ^= pBytes[ byteIndex ];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/// Compute a 64-bit hash of a block of data that remains stable between runs, builds, and platforms.
+///
+/// @param[in] pData  Data to hash.
+/// @param[in] size   Number of bytes to hash.
+///
+/// @return  Hash value.
+uint64_t Helium::StableHash64( const void* pData, size_t size )
+{
+    return StableHash64( STABLE_HASH_64_BASIS, pData, size );
+}
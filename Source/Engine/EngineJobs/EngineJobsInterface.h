@@ -54,6 +54,60 @@ private:
     Parameters m_parameters;
 };
 
+/// Parallel least-significant-digit radix sort of 64-bit keys, with optional 32-bit values carried alongside.
+///
+/// The sort is stable and orders keys in ascending order.  Keys are sorted eight bits at a time, and any digit that
+/// holds the same value in every key is skipped, so fields that are constant across the whole array (or unused high
+/// bits) cost nothing.  Larger arrays are split into blocks that are counted and scattered across the job manager's
+/// worker threads.
+class HELIUM_ENGINE_JOBS_API RadixSortJob : Helium::NonCopyable
+{
+public:
+    class Parameters
+    {
+    public:
+        /// [inout] Keys to sort.
+        uint64_t* pKeys;
+        /// [inout] Values to reorder along with their keys (may be null if no values need to be sorted).
+        uint32_t* pValues;
+        /// [in] Scratch buffer large enough to hold "count" keys.
+        uint64_t* pScratchKeys;
+        /// [in] Scratch buffer large enough to hold "count" values (may be null if "pValues" is null).
+        uint32_t* pScratchValues;
+        /// [in] Number of elements to sort.
+        size_t count;
+        /// [in] Minimum number of elements to handle within each child job.
+        size_t singleJobCount;
+
+        /// @name Construction/Destruction
+        //@{
+        inline Parameters();
+        //@}
+    };
+
+    /// @name Construction/Destruction
+    //@{
+    inline RadixSortJob();
+    inline ~RadixSortJob();
+    //@}
+
+    /// @name Parameters
+    //@{
+    inline Parameters& GetParameters();
+    inline const Parameters& GetParameters() const;
+    inline void SetParameters( const Parameters& rParameters );
+    //@}
+
+    /// @name Job Execution
+    //@{
+    void Run();
+    inline static void RunCallback( void* pJob );
+    //@}
+
+private:
+    Parameters m_parameters;
+};
+
 }  // namespace Helium
 
 #include "EngineJobs/EngineJobsInterface.inl"
@@ -64,5 +64,66 @@ namespace Helium
 	{
 	}
 
+	/// Constructor.
+	RadixSortJob::RadixSortJob()
+	{
+	}
+
+	/// Destructor.
+	RadixSortJob::~RadixSortJob()
+	{
+	}
+
+	/// Get the parameters for this job.
+	///
+	/// @return  Reference to the structure containing the job parameters.
+	///
+	/// @see SetParameters()
+	RadixSortJob::Parameters& RadixSortJob::GetParameters()
+	{
+		return m_parameters;
+	}
+
+	/// Get the parameters for this job.
+	///
+	/// @return  Constant reference to the structure containing the job parameters.
+	///
+	/// @see SetParameters()
+	const RadixSortJob::Parameters& RadixSortJob::GetParameters() const
+	{
+		return m_parameters;
+	}
+
+	/// Set the job parameters.
+	///
+	/// @param[in] rParameters  MetaStruct containing the job parameters.
+	///
+	/// @see GetParameters()
+	void RadixSortJob::SetParameters( const Parameters& rParameters )
+	{
+		m_parameters = rParameters;
+	}
+
+	/// Callback executed to run the job.
+	///
+	/// @param[in] pJob      Job to run.
+	/// @param[in] pContext  Context associated with the running job instance.
+	void RadixSortJob::RunCallback( void* pJob )
+	{
+		HELIUM_ASSERT( pJob );
+		static_cast< RadixSortJob* >( pJob )->Run();
+	}
+
+	/// Constructor.
+	RadixSortJob::Parameters::Parameters()
+		: pKeys( NULL )
+		, pValues( NULL )
+		, pScratchKeys( NULL )
+		, pScratchValues( NULL )
+		, count( 0 )
+		, singleJobCount( 4096 )
+	{
+	}
+
 }  // namespace Helium
 
@@ -0,0 +1,422 @@
+#include "Precompile.h"
+#include "EngineJobs/JobManager.h"
+
+#include "Platform/Atomic.h"
+
+#if HELIUM_OS_WIN
+#include "Platform/SystemWin.h"
+#else
+#include <unistd.h>
+#endif
+
+using namespace Helium;
+
+static uint32_t g_InitCount = 0;
+JobManager* JobManager::sm_pInstance = NULL;
+
+/// Constructor.
+JobManager::JobManager()
+	: m_pendingJobCount( 0 )
+	, m_nextQueueIndex( 0 )
+	, m_executedJobCount( 0 )
+	, m_stolenJobCount( 0 )
+{
+}
+
+/// Destructor.
+JobManager::~JobManager()
+{
+	Cleanup();
+}
+
+/// Initialize the job manager and start its worker threads.
+///
+/// @param[in] workerCount  Number of worker threads to create, or zero to create one worker for each processor other
+///                         than the one running the calling thread.
+///
+/// @return  True if initialization was successful, false if not.
+///
+/// @see Cleanup()
+bool JobManager::Initialize( uint32_t workerCount )
+{
+	Cleanup();
+
+	if( workerCount == 0 )
+	{
+		uint32_t processorCount = GetProcessorCount();
+		workerCount = ( processorCount > 1 ? processorCount - 1 : 1 );
+	}
+
+	m_workers.Reserve( workerCount );
+	m_threads.Reserve( workerCount );
+
+	// Create all of the workers before starting any threads, as workers will attempt to steal from each other as soon
+	// as they start running.
+	for( uint32_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+	{
+		Worker* pWorker = new Worker( this, workerIndex );
+		HELIUM_ASSERT( pWorker );
+		m_workers.Push( pWorker );
+	}
+
+	for( uint32_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+	{
+		RunnableThread* pThread = new RunnableThread( m_workers[ workerIndex ] );
+		HELIUM_ASSERT( pThread );
+		HELIUM_VERIFY( pThread->Start( "JobManager - worker" ) );
+		m_threads.Push( pThread );
+	}
+
+	HELIUM_TRACE( TraceLevels::Info, "JobManager: Started %" PRIu32 " worker threads.\n", workerCount );
+
+	return true;
+}
+
+/// Stop all worker threads and shut down the job manager.
+///
+/// Any jobs still queued when this is called are discarded.
+///
+/// @see Initialize()
+void JobManager::Cleanup()
+{
+	size_t workerCount = m_workers.GetSize();
+	for( size_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+	{
+		m_workers[ workerIndex ]->Stop();
+	}
+
+	size_t threadCount = m_threads.GetSize();
+	for( size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+	{
+		RunnableThread* pThread = m_threads[ threadIndex ];
+		HELIUM_ASSERT( pThread );
+		pThread->Join();
+		delete pThread;
+	}
+
+	m_threads.Clear();
+
+	for( size_t workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+	{
+		delete m_workers[ workerIndex ];
+	}
+
+	m_workers.Clear();
+
+	AtomicExchangeRelease( m_pendingJobCount, 0 );
+	AtomicExchangeRelease( m_nextQueueIndex, 0 );
+}
+
+/// Queue a job for execution on the worker threads.
+///
+/// @param[in] pFunction  Function to execute.
+/// @param[in] pData      User data to pass to the job function.
+/// @param[in] rCounter   Counter to increment now and decrement once the job has completed.
+///
+/// @see Wait()
+void JobManager::Spawn( JOB_FUNC pFunction, void* pData, JobCounter& rCounter )
+{
+	HELIUM_ASSERT( pFunction );
+
+	AtomicIncrementAcquire( rCounter.m_count );
+
+	Job job;
+	job.pFunction = pFunction;
+	job.pData = pData;
+	job.pCounter = &rCounter;
+
+	// Without any workers, run the job immediately on the calling thread.
+	uint32_t workerCount = static_cast< uint32_t >( m_workers.GetSize() );
+	if( workerCount == 0 )
+	{
+		RunJob( job );
+
+		return;
+	}
+
+	uint32_t queueIndex = static_cast< uint32_t >( AtomicIncrementUnsafe( m_nextQueueIndex ) ) % workerCount;
+	Worker* pWorker = m_workers[ queueIndex ];
+	HELIUM_ASSERT( pWorker );
+
+	AtomicIncrementAcquire( m_pendingJobCount );
+	pWorker->Push( job );
+	pWorker->WakeUp();
+}
+
+/// Block the current thread until all jobs spawned against the given counter have completed.
+///
+/// The calling thread runs queued jobs while waiting, so this is safe to call from within a job.
+///
+/// @param[in] rCounter  Counter on which to wait.
+///
+/// @see Spawn()
+void JobManager::Wait( JobCounter& rCounter )
+{
+	while( !rCounter.IsDone() )
+	{
+		if( !TryRunJob() )
+		{
+			Thread::Yield();
+		}
+	}
+}
+
+/// Run a single queued job on the calling thread, if one is available.
+///
+/// @return  True if a job was run, false if no jobs were queued.
+bool JobManager::TryRunJob()
+{
+	uint32_t workerCount = static_cast< uint32_t >( m_workers.GetSize() );
+	if( workerCount == 0 )
+	{
+		return false;
+	}
+
+	Job job;
+	if( !TryGetJob( static_cast< uint32_t >( m_nextQueueIndex ) % workerCount, job ) )
+	{
+		return false;
+	}
+
+	RunJob( job );
+
+	return true;
+}
+
+/// Reset the job statistics counters.
+///
+/// @see GetExecutedJobCount(), GetStolenJobCount()
+void JobManager::ResetStatistics()
+{
+	AtomicExchangeRelease( m_executedJobCount, 0 );
+	AtomicExchangeRelease( m_stolenJobCount, 0 );
+}
+
+/// Get the number of logical processors available to the application.
+///
+/// @return  Logical processor count (always at least one).
+uint32_t JobManager::GetProcessorCount()
+{
+#if HELIUM_OS_WIN
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo( &systemInfo );
+	uint32_t processorCount = static_cast< uint32_t >( systemInfo.dwNumberOfProcessors );
+#else
+	long result = sysconf( _SC_NPROCESSORS_ONLN );
+	uint32_t processorCount = ( result > 0 ? static_cast< uint32_t >( result ) : 1 );
+#endif
+
+	return ( processorCount > 0 ? processorCount : 1 );
+}
+
+/// Get the singleton JobManager instance.
+///
+/// @return  Pointer to the JobManager instance, or null if it has not been started.
+///
+/// @see Startup(), Shutdown()
+JobManager* JobManager::GetInstance()
+{
+	return sm_pInstance;
+}
+
+/// Create the singleton JobManager instance.
+///
+/// @param[in] workerCount  Number of worker threads to create, or zero to choose based on the processor count.
+///
+/// @see GetInstance(), Shutdown()
+void JobManager::Startup( uint32_t workerCount )
+{
+	if ( ++g_InitCount == 1 )
+	{
+		HELIUM_ASSERT( !sm_pInstance );
+		sm_pInstance = new JobManager;
+		HELIUM_ASSERT( sm_pInstance );
+		if ( !HELIUM_VERIFY( sm_pInstance->Initialize( workerCount ) ) )
+		{
+			Shutdown();
+		}
+	}
+}
+
+/// Destroy the singleton JobManager instance.
+///
+/// @see GetInstance(), Startup()
+void JobManager::Shutdown()
+{
+	if ( --g_InitCount == 0 )
+	{
+		HELIUM_ASSERT( sm_pInstance );
+		sm_pInstance->Cleanup();
+		delete sm_pInstance;
+		sm_pInstance = NULL;
+	}
+}
+
+/// Take a job from the queue of the given worker, or steal one from any other worker if that queue is empty.
+///
+/// @param[in]  workerIndex  Index of the worker whose queue should be checked first.
+/// @param[out] rJob         Job taken from a queue.
+///
+/// @return  True if a job was found, false if all queues are empty.
+bool JobManager::TryGetJob( uint32_t workerIndex, Job& rJob )
+{
+	if( m_pendingJobCount == 0 )
+	{
+		return false;
+	}
+
+	uint32_t workerCount = static_cast< uint32_t >( m_workers.GetSize() );
+	HELIUM_ASSERT( workerIndex < workerCount );
+
+	// Prefer the most recently queued job on our own queue, as its data is most likely to still be in the cache.
+	if( m_workers[ workerIndex ]->PopBack( rJob ) )
+	{
+		AtomicDecrementRelease( m_pendingJobCount );
+
+		return true;
+	}
+
+	// Steal the oldest job from the next busy worker.
+	for( uint32_t offset = 1; offset < workerCount; ++offset )
+	{
+		if( m_workers[ ( workerIndex + offset ) % workerCount ]->PopFront( rJob ) )
+		{
+			AtomicDecrementRelease( m_pendingJobCount );
+			AtomicIncrementRelease( m_stolenJobCount );
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// Run a job on the calling thread and signal its completion.
+///
+/// @param[in] rJob  Job to run.
+void JobManager::RunJob( const Job& rJob )
+{
+	HELIUM_ASSERT( rJob.pFunction );
+	HELIUM_ASSERT( rJob.pCounter );
+
+	rJob.pFunction( rJob.pData );
+
+	AtomicIncrementRelease( m_executedJobCount );
+	AtomicDecrementRelease( rJob.pCounter->m_count );
+}
+
+/// Constructor.
+///
+/// @param[in] pManager     Owning job manager.
+/// @param[in] workerIndex  Index of this worker within the manager's worker list.
+JobManager::Worker::Worker( JobManager* pManager, uint32_t workerIndex )
+	: m_pManager( pManager )
+	, m_workerIndex( workerIndex )
+	, m_wakeUpCondition( false, false )
+	, m_stopCounter( 0 )
+{
+	HELIUM_ASSERT( pManager );
+}
+
+/// Destructor.
+JobManager::Worker::~Worker()
+{
+}
+
+/// Execute queued jobs until asked to stop.
+void JobManager::Worker::Run()
+{
+	JobManager* pManager = m_pManager;
+	HELIUM_ASSERT( pManager );
+
+	uint32_t workerCount = static_cast< uint32_t >( pManager->m_workers.GetSize() );
+
+	while( m_stopCounter == 0 )
+	{
+		Job job;
+		if( !pManager->TryGetJob( m_workerIndex, job ) )
+		{
+			// All queues are empty, so sleep until notified.
+			m_wakeUpCondition.Wait();
+
+			continue;
+		}
+
+		// If there is still more work available, make sure the next worker is awake to help with it.
+		if( pManager->m_pendingJobCount != 0 && workerCount > 1 )
+		{
+			pManager->m_workers[ ( m_workerIndex + 1 ) % workerCount ]->WakeUp();
+		}
+
+		pManager->RunJob( job );
+	}
+}
+
+/// Request the worker to stop processing and return at the next possible opportunity.
+void JobManager::Worker::Stop()
+{
+	AtomicExchangeRelease( m_stopCounter, 1 );
+	m_wakeUpCondition.Signal();
+}
+
+/// Wake up the worker thread if it is waiting for jobs.
+void JobManager::Worker::WakeUp()
+{
+	m_wakeUpCondition.Signal();
+}
+
+/// Add a job to the back of this worker's queue.
+///
+/// @param[in] rJob  Job to queue.
+void JobManager::Worker::Push( const Job& rJob )
+{
+	Locker< JobQueue, SpinLock >::Handle handle( m_queue );
+	handle->jobs.Push( rJob );
+}
+
+/// Take the most recently queued job from this worker's queue.
+///
+/// @param[out] rJob  Job taken from the queue.
+///
+/// @return  True if a job was taken, false if the queue was empty.
+bool JobManager::Worker::PopBack( Job& rJob )
+{
+	Locker< JobQueue, SpinLock >::Handle handle( m_queue );
+	if( handle->headIndex >= handle->jobs.GetSize() )
+	{
+		return false;
+	}
+
+	rJob = handle->jobs.Pop();
+	if( handle->headIndex >= handle->jobs.GetSize() )
+	{
+		handle->jobs.Resize( 0 );
+		handle->headIndex = 0;
+	}
+
+	return true;
+}
+
+/// Take the oldest job from this worker's queue.
+///
+/// @param[out] rJob  Job taken from the queue.
+///
+/// @return  True if a job was taken, false if the queue was empty.
+bool JobManager::Worker::PopFront( Job& rJob )
+{
+	Locker< JobQueue, SpinLock >::Handle handle( m_queue );
+	if( handle->headIndex >= handle->jobs.GetSize() )
+	{
+		return false;
+	}
+
+	rJob = handle->jobs[ handle->headIndex ];
+	++handle->headIndex;
+	if( handle->headIndex >= handle->jobs.GetSize() )
+	{
+		handle->jobs.Resize( 0 );
+		handle->headIndex = 0;
+	}
+
+	return true;
+}
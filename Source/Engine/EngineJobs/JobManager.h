@@ -0,0 +1,183 @@
+#pragma once
+
+#include "Platform/Condition.h"
+#include "Platform/Locks.h"
+#include "Platform/Thread.h"
+
+#include "Foundation/DynamicArray.h"
+
+#include "EngineJobs/EngineJobs.h"
+
+namespace Helium
+{
+	/// Job entry point.
+	///
+	/// @param[in] pData  User data provided when the job was spawned.
+	typedef void ( *JOB_FUNC )( void* pData );
+
+	/// Counter tracking the completion of a group of jobs.
+	///
+	/// The count is incremented when a job is spawned against the counter and decremented once that job has finished
+	/// running.  Jobs may spawn further jobs against the same counter, in which case the counter will not reach zero
+	/// until the entire tree of work has completed.
+	class JobCounter : NonCopyable
+	{
+	public:
+		/// @name Construction/Destruction
+		//@{
+		inline JobCounter();
+		//@}
+
+		/// @name Status
+		//@{
+		inline bool IsDone() const;
+		//@}
+
+	private:
+		friend class JobManager;
+
+		/// Number of outstanding jobs.
+		volatile int32_t m_count;
+	};
+
+	/// Work-stealing job thread pool.
+	///
+	/// Each worker thread owns a job queue.  Workers pop jobs from the back of their own queue and, once their own queue
+	/// runs dry, steal jobs from the front of the queues owned by the other workers.  Threads waiting on a JobCounter
+	/// help run queued jobs rather than blocking, so jobs can safely spawn and wait on other jobs.
+	class HELIUM_ENGINE_JOBS_API JobManager : NonCopyable
+	{
+	public:
+		/// @name Initialization
+		//@{
+		bool Initialize( uint32_t workerCount = 0 );
+		void Cleanup();
+		//@}
+
+		/// @name Job Execution
+		//@{
+		void Spawn( JOB_FUNC pFunction, void* pData, JobCounter& rCounter );
+		void Wait( JobCounter& rCounter );
+		bool TryRunJob();
+
+		inline uint32_t GetWorkerCount() const;
+		//@}
+
+		/// @name Statistics
+		//@{
+		inline uint32_t GetExecutedJobCount() const;
+		inline uint32_t GetStolenJobCount() const;
+		void ResetStatistics();
+		//@}
+
+		/// @name Static Access
+		//@{
+		static uint32_t GetProcessorCount();
+
+		static JobManager* GetInstance();
+		static void Startup( uint32_t workerCount = 0 );
+		static void Shutdown();
+		//@}
+
+	private:
+		/// Queued job.
+		struct Job
+		{
+			/// Function to execute.
+			JOB_FUNC pFunction;
+			/// User data passed to the job function.
+			void* pData;
+			/// Counter to decrement once the job has completed.
+			JobCounter* pCounter;
+		};
+
+		/// Job queue owned by a single worker.
+		struct JobQueue
+		{
+			/// Queued jobs (only entries at or after the head index are valid).
+			DynamicArray< Job > jobs;
+			/// Index of the oldest job in the queue.
+			size_t headIndex;
+
+			/// @name Construction/Destruction
+			//@{
+			inline JobQueue();
+			//@}
+		};
+
+		/// Worker thread runnable.
+		class Worker : public Runnable
+		{
+		public:
+			/// @name Construction/Destruction
+			//@{
+			Worker( JobManager* pManager, uint32_t workerIndex );
+			virtual ~Worker();
+			//@}
+
+			/// @name Runnable Interface
+			//@{
+			virtual void Run();
+			//@}
+
+			/// @name External Thread Control
+			//@{
+			void Stop();
+			void WakeUp();
+			//@}
+
+			/// @name Job Queue Access
+			//@{
+			void Push( const Job& rJob );
+			bool PopBack( Job& rJob );
+			bool PopFront( Job& rJob );
+			//@}
+
+		private:
+			/// Owning job manager.
+			JobManager* m_pManager;
+			/// Index of this worker within the manager's worker list.
+			uint32_t m_workerIndex;
+
+			/// Queue of jobs assigned to this worker.
+			Locker< JobQueue, SpinLock > m_queue;
+			/// Condition used to wake up the worker thread when jobs are queued (or when it should shut down).
+			Condition m_wakeUpCondition;
+
+			/// Non-zero if this thread should stop when next possible, zero if it should continue.
+			volatile int32_t m_stopCounter;
+		};
+
+		/// Worker thread runnables.
+		DynamicArray< Worker* > m_workers;
+		/// Worker threads.
+		DynamicArray< RunnableThread* > m_threads;
+
+		/// Number of jobs queued but not yet picked up by any thread.
+		volatile int32_t m_pendingJobCount;
+		/// Index of the worker queue to which the next job spawned from outside the pool will be pushed.
+		volatile int32_t m_nextQueueIndex;
+
+		/// Number of jobs run since the statistics were last reset.
+		volatile int32_t m_executedJobCount;
+		/// Number of jobs taken from the queue of a different worker since the statistics were last reset.
+		volatile int32_t m_stolenJobCount;
+
+		/// Singleton instance.
+		static JobManager* sm_pInstance;
+
+		/// @name Construction/Destruction
+		//@{
+		JobManager();
+		~JobManager();
+		//@}
+
+		/// @name Private Utility Functions
+		//@{
+		bool TryGetJob( uint32_t workerIndex, Job& rJob );
+		void RunJob( const Job& rJob );
+		//@}
+	};
+}
+
+#include "EngineJobs/JobManager.inl"
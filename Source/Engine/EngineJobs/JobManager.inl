@@ -0,0 +1,50 @@
+namespace Helium
+{
+	/// Constructor.
+	JobCounter::JobCounter()
+		: m_count( 0 )
+	{
+	}
+
+	/// Get whether all jobs spawned against this counter have completed.
+	///
+	/// @return  True if no jobs are outstanding, false if not.
+	bool JobCounter::IsDone() const
+	{
+		return ( m_count == 0 );
+	}
+
+	/// Constructor.
+	JobManager::JobQueue::JobQueue()
+		: headIndex( 0 )
+	{
+	}
+
+	/// Get the number of worker threads owned by this manager.
+	///
+	/// @return  Worker thread count.
+	uint32_t JobManager::GetWorkerCount() const
+	{
+		return static_cast< uint32_t >( m_workers.GetSize() );
+	}
+
+	/// Get the number of jobs run since the statistics were last reset.
+	///
+	/// @return  Executed job count.
+	///
+	/// @see GetStolenJobCount(), ResetStatistics()
+	uint32_t JobManager::GetExecutedJobCount() const
+	{
+		return static_cast< uint32_t >( m_executedJobCount );
+	}
+
+	/// Get the number of jobs that were run by a thread other than the worker to whose queue they were assigned.
+	///
+	/// @return  Stolen job count.
+	///
+	/// @see GetExecutedJobCount(), ResetStatistics()
+	uint32_t JobManager::GetStolenJobCount() const
+	{
+		return static_cast< uint32_t >( m_stolenJobCount );
+	}
+}
@@ -0,0 +1,271 @@
+#include "Precompile.h"
+#include "EngineJobs/EngineJobsInterface.h"
+
+#include "EngineJobs/JobManager.h"
+
+using namespace Helium;
+
+/// Number of key bits sorted in each radix sort pass.
+static const size_t RADIX_SORT_DIGIT_BITS = 8;
+/// Number of buckets for each radix sort digit.
+static const size_t RADIX_SORT_BUCKET_COUNT = 1 << RADIX_SORT_DIGIT_BITS;
+/// Number of digits in each radix sort key.
+static const size_t RADIX_SORT_DIGIT_COUNT = 64 / RADIX_SORT_DIGIT_BITS;
+/// Maximum number of blocks into which an array is split for sorting in parallel.
+static const size_t RADIX_SORT_BLOCK_MAX = 32;
+
+/// Radix sort state shared by all blocks of an array.
+struct RadixSortContext
+{
+	/// Keys to read in the current pass.
+	uint64_t* pSourceKeys;
+	/// Values to read in the current pass (null if no values are being sorted).
+	uint32_t* pSourceValues;
+	/// Keys to write in the current pass.
+	uint64_t* pDestKeys;
+	/// Values to write in the current pass (null if no values are being sorted).
+	uint32_t* pDestValues;
+	/// Index of the digit sorted in the current pass.
+	size_t digitIndex;
+};
+
+/// Range of elements counted and scattered by a single job during each radix sort pass.
+struct RadixSortBlock
+{
+	/// Shared sort state.
+	RadixSortContext* pContext;
+	/// Index of the first element in this block.
+	size_t start;
+	/// Number of elements in this block.
+	size_t count;
+
+	/// Number of elements in this block falling into each bucket of each digit.
+	uint32_t histograms[ RADIX_SORT_DIGIT_COUNT ][ RADIX_SORT_BUCKET_COUNT ];
+	/// Output index of the next element of this block in each bucket of the current digit.
+	uint32_t offsets[ RADIX_SORT_BUCKET_COUNT ];
+};
+
+/// Count the elements of a block falling into each bucket of every digit.
+///
+/// @param[in] pData  Block to count.
+static void CountAllDigits( void* pData )
+{
+	RadixSortBlock* pBlock = static_cast< RadixSortBlock* >( pData );
+	HELIUM_ASSERT( pBlock );
+
+	MemoryZero( pBlock->histograms, sizeof( pBlock->histograms ) );
+
+	const uint64_t* pKeys = pBlock->pContext->pSourceKeys + pBlock->start;
+	size_t count = pBlock->count;
+	for( size_t elementIndex = 0; elementIndex < count; ++elementIndex )
+	{
+		uint64_t key = pKeys[ elementIndex ];
+		for( size_t digitIndex = 0; digitIndex < RADIX_SORT_DIGIT_COUNT; ++digitIndex )
+		{
+			size_t bucket = static_cast< size_t >( key >> ( digitIndex * RADIX_SORT_DIGIT_BITS ) ) &
+				( RADIX_SORT_BUCKET_COUNT - 1 );
+			++pBlock->histograms[ digitIndex ][ bucket ];
+		}
+	}
+}
+
+/// Count the elements of a block falling into each bucket of the current digit.
+///
+/// @param[in] pData  Block to count.
+static void CountDigit( void* pData )
+{
+	RadixSortBlock* pBlock = static_cast< RadixSortBlock* >( pData );
+	HELIUM_ASSERT( pBlock );
+
+	const RadixSortContext* pContext = pBlock->pContext;
+	size_t digitIndex = pContext->digitIndex;
+	size_t shift = digitIndex * RADIX_SORT_DIGIT_BITS;
+
+	uint32_t* pHistogram = pBlock->histograms[ digitIndex ];
+	MemoryZero( pHistogram, sizeof( pBlock->histograms[ digitIndex ] ) );
+
+	const uint64_t* pKeys = pContext->pSourceKeys + pBlock->start;
+	size_t count = pBlock->count;
+	for( size_t elementIndex = 0; elementIndex < count; ++elementIndex )
+	{
+		++pHistogram[ static_cast< size_t >( pKeys[ elementIndex ] >> shift ) & ( RADIX_SORT_BUCKET_COUNT - 1 ) ];
+	}
+}
+
+/// Move the elements of a block to their sorted positions for the current digit.
+///
+/// @param[in] pData  Block to scatter.
+static void ScatterDigit( void* pData )
+{
+	RadixSortBlock* pBlock = static_cast< RadixSortBlock* >( pData );
+	HELIUM_ASSERT( pBlock );
+
+	const RadixSortContext* pContext = pBlock->pContext;
+	size_t shift = pContext->digitIndex * RADIX_SORT_DIGIT_BITS;
+
+	const uint64_t* pSourceKeys = pContext->pSourceKeys + pBlock->start;
+	uint64_t* pDestKeys = pContext->pDestKeys;
+	uint32_t* pOffsets = pBlock->offsets;
+	size_t count = pBlock->count;
+
+	const uint32_t* pSourceValues = pContext->pSourceValues;
+	if( pSourceValues )
+	{
+		pSourceValues += pBlock->start;
+		uint32_t* pDestValues = pContext->pDestValues;
+		for( size_t elementIndex = 0; elementIndex < count; ++elementIndex )
+		{
+			uint64_t key = pSourceKeys[ elementIndex ];
+			uint32_t destIndex = pOffsets[ static_cast< size_t >( key >> shift ) & ( RADIX_SORT_BUCKET_COUNT - 1 ) ]++;
+			pDestKeys[ destIndex ] = key;
+			pDestValues[ destIndex ] = pSourceValues[ elementIndex ];
+		}
+	}
+	else
+	{
+		for( size_t elementIndex = 0; elementIndex < count; ++elementIndex )
+		{
+			uint64_t key = pSourceKeys[ elementIndex ];
+			uint32_t destIndex = pOffsets[ static_cast< size_t >( key >> shift ) & ( RADIX_SORT_BUCKET_COUNT - 1 ) ]++;
+			pDestKeys[ destIndex ] = key;
+		}
+	}
+}
+
+/// Run a function on each radix sort block, spreading the blocks across the job manager's worker threads.
+///
+/// @param[in] pFunction   Function to run.
+/// @param[in] pBlocks     Blocks on which to run the function.
+/// @param[in] blockCount  Number of blocks.
+static void RunBlocks( JOB_FUNC pFunction, RadixSortBlock* pBlocks, size_t blockCount )
+{
+	JobManager* pJobManager = ( blockCount > 1 ? JobManager::GetInstance() : NULL );
+	if( !pJobManager )
+	{
+		for( size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex )
+		{
+			pFunction( pBlocks + blockIndex );
+		}
+
+		return;
+	}
+
+	// The first block is handled on the calling thread while the workers pick up the rest.
+	JobCounter counter;
+	for( size_t blockIndex = 1; blockIndex < blockCount; ++blockIndex )
+	{
+		pJobManager->Spawn( pFunction, pBlocks + blockIndex, counter );
+	}
+
+	pFunction( pBlocks );
+	pJobManager->Wait( counter );
+}
+
+/// Sort an array of keys and their values.
+void RadixSortJob::Run()
+{
+	size_t count = m_parameters.count;
+	if( count <= 1 )
+	{
+		return;
+	}
+
+	uint64_t* pKeys = m_parameters.pKeys;
+	uint32_t* pValues = m_parameters.pValues;
+	HELIUM_ASSERT( pKeys );
+	HELIUM_ASSERT( m_parameters.pScratchKeys );
+	HELIUM_ASSERT( !pValues || m_parameters.pScratchValues );
+	HELIUM_ASSERT( count <= UINT32_MAX );
+
+	// Only split the array when there is enough work to share with other threads.
+	size_t blockCount = 1;
+	JobManager* pJobManager = JobManager::GetInstance();
+	if( pJobManager )
+	{
+		size_t singleJobCount = Max< size_t >( m_parameters.singleJobCount, 1 );
+		size_t blockCountMax = Min< size_t >( pJobManager->GetWorkerCount() + 1, RADIX_SORT_BLOCK_MAX );
+		blockCount = Min( ( count + singleJobCount - 1 ) / singleJobCount, blockCountMax );
+	}
+
+	size_t blockSize = ( count + blockCount - 1 ) / blockCount;
+	blockCount = ( count + blockSize - 1 ) / blockSize;
+
+	RadixSortContext context;
+	context.pSourceKeys = pKeys;
+	context.pSourceValues = pValues;
+	context.pDestKeys = m_parameters.pScratchKeys;
+	context.pDestValues = ( pValues ? m_parameters.pScratchValues : NULL );
+	context.digitIndex = 0;
+
+	DefaultAllocator allocator;
+	RadixSortBlock* pBlocks = static_cast< RadixSortBlock* >(
+		allocator.Allocate( sizeof( RadixSortBlock ) * blockCount ) );
+	HELIUM_ASSERT( pBlocks );
+
+	for( size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex )
+	{
+		RadixSortBlock& rBlock = pBlocks[ blockIndex ];
+		rBlock.pContext = &context;
+		rBlock.start = blockIndex * blockSize;
+		rBlock.count = Min( count - rBlock.start, blockSize );
+	}
+
+	// Count every digit up front so that digits shared by all keys can be skipped entirely.
+	RunBlocks( CountAllDigits, pBlocks, blockCount );
+
+	bool bHistogramsCurrent = true;
+	for( size_t digitIndex = 0; digitIndex < RADIX_SORT_DIGIT_COUNT; ++digitIndex )
+	{
+		// Every key shares this digit if the bucket of any one key holds all of them.
+		size_t keyBucket = static_cast< size_t >( pKeys[ 0 ] >> ( digitIndex * RADIX_SORT_DIGIT_BITS ) ) &
+			( RADIX_SORT_BUCKET_COUNT - 1 );
+		size_t keyBucketCount = 0;
+		for( size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex )
+		{
+			keyBucketCount += pBlocks[ blockIndex ].histograms[ digitIndex ][ keyBucket ];
+		}
+
+		if( keyBucketCount == count )
+		{
+			continue;
+		}
+
+		// The initial counts only describe the block contents up until the first pass has reordered the elements.
+		context.digitIndex = digitIndex;
+		if( !bHistogramsCurrent )
+		{
+			RunBlocks( CountDigit, pBlocks, blockCount );
+		}
+
+		bHistogramsCurrent = false;
+
+		// Elements of each bucket are laid out in block order, keeping the sort stable.
+		uint32_t offset = 0;
+		for( size_t bucket = 0; bucket < RADIX_SORT_BUCKET_COUNT; ++bucket )
+		{
+			for( size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex )
+			{
+				RadixSortBlock& rBlock = pBlocks[ blockIndex ];
+				rBlock.offsets[ bucket ] = offset;
+				offset += rBlock.histograms[ digitIndex ][ bucket ];
+			}
+		}
+
+		RunBlocks( ScatterDigit, pBlocks, blockCount );
+
+		Swap( context.pSourceKeys, context.pDestKeys );
+		Swap( context.pSourceValues, context.pDestValues );
+	}
+
+	allocator.Free( pBlocks );
+
+	// Copy the results back if the last pass left them in the scratch buffers.
+	if( context.pSourceKeys != pKeys )
+	{
+		MemoryCopy( pKeys, context.pSourceKeys, count * sizeof( uint64_t ) );
+		if( pValues )
+		{
+			MemoryCopy( pValues, context.pSourceValues, count * sizeof( uint32_t ) );
+		}
+	}
+}
@@ -0,0 +1,214 @@
+#include "EngineJobs/EngineJobsInterface.h"
+#include "EngineJobs/JobManager.h"
+
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Number of keys sorted by each benchmark (about the number of visible sub-meshes in a busy scene).
+	const size_t BENCHMARK_KEY_COUNT = 100000;
+	/// Number of times each benchmark sort is repeated.
+	const size_t BENCHMARK_ITERATION_COUNT = 20;
+
+	/// Draw key paired with the index of the sub-mesh it was built for, as previously sorted with SortJob.
+	struct KeyedIndex
+	{
+		uint64_t key;
+		uint32_t index;
+
+		bool operator<( const KeyedIndex& rOther ) const
+		{
+			return ( key < rOther.key || ( key == rOther.key && index < rOther.index ) );
+		}
+	};
+
+	/// Deterministic xorshift random number generator.
+	class Random
+	{
+	public:
+		explicit Random( uint64_t seed ) : m_state( seed ) {}
+
+		uint64_t Next()
+		{
+			m_state ^= m_state << 13;
+			m_state ^= m_state >> 7;
+			m_state ^= m_state << 17;
+
+			return m_state;
+		}
+
+	private:
+		uint64_t m_state;
+	};
+
+	/// Fill an array with keys laid out like base pass draw keys: a constant pass, a few dozen shader variants and
+	/// materials, a few hundred meshes, and coarse depth.
+	void BuildDrawKeys( DynamicArray< uint64_t >& rKeys, size_t count, uint64_t seed )
+	{
+		Random random( seed );
+
+		rKeys.Resize( count );
+		for( size_t keyIndex = 0; keyIndex < count; ++keyIndex )
+		{
+			uint64_t material = random.Next() % 64;
+			rKeys[ keyIndex ] =
+				( static_cast< uint64_t >( 2 ) << 60 ) |
+				( ( material % 8 ) << 48 ) |
+				( ( material % 16 ) << 36 ) |
+				( material << 24 ) |
+				( ( random.Next() % 512 ) << 12 ) |
+				( random.Next() % 4096 );
+		}
+	}
+
+	void RadixSort(
+		DynamicArray< uint64_t >& rKeys,
+		DynamicArray< uint32_t >& rValues,
+		DynamicArray< uint64_t >& rScratchKeys,
+		DynamicArray< uint32_t >& rScratchValues )
+	{
+		size_t count = rKeys.GetSize();
+		rScratchKeys.Resize( count );
+		rScratchValues.Resize( count );
+
+		RadixSortJob job;
+		RadixSortJob::Parameters& rParameters = job.GetParameters();
+		rParameters.pKeys = rKeys.GetData();
+		rParameters.pValues = rValues.GetData();
+		rParameters.pScratchKeys = rScratchKeys.GetData();
+		rParameters.pScratchValues = rScratchValues.GetData();
+		rParameters.count = count;
+		job.Run();
+	}
+
+	void ComparisonSort( DynamicArray< KeyedIndex >& rEntries )
+	{
+		SortJob< KeyedIndex > job;
+		SortJob< KeyedIndex >::Parameters& rParameters = job.GetParameters();
+		rParameters.pBase = rEntries.GetData();
+		rParameters.count = rEntries.GetSize();
+		job.Run();
+	}
+
+	class RadixSortJobTest : public testing::Test
+	{
+	protected:
+		void SetUp()
+		{
+			JobManager::Startup();
+		}
+
+		void TearDown()
+		{
+			JobManager::Shutdown();
+		}
+	};
+}
+
+TEST_F( RadixSortJobTest, SortsKeysAndValuesStably )
+{
+	DynamicArray< uint64_t > keys;
+	BuildDrawKeys( keys, BENCHMARK_KEY_COUNT, 0x2545f4914f6cdd1dULL );
+
+	DynamicArray< uint32_t > values;
+	DynamicArray< KeyedIndex > expected;
+	values.Resize( keys.GetSize() );
+	expected.Resize( keys.GetSize() );
+	for( size_t keyIndex = 0; keyIndex < keys.GetSize(); ++keyIndex )
+	{
+		values[ keyIndex ] = static_cast< uint32_t >( keyIndex );
+		expected[ keyIndex ].key = keys[ keyIndex ];
+		expected[ keyIndex ].index = static_cast< uint32_t >( keyIndex );
+	}
+
+	// Ordering equal keys by their original index gives the result a stable sort must produce.
+	ComparisonSort( expected );
+
+	DynamicArray< uint64_t > scratchKeys;
+	DynamicArray< uint32_t > scratchValues;
+	RadixSort( keys, values, scratchKeys, scratchValues );
+
+	for( size_t keyIndex = 0; keyIndex < keys.GetSize(); ++keyIndex )
+	{
+		ASSERT_EQ( expected[ keyIndex ].key, keys[ keyIndex ] );
+		ASSERT_EQ( expected[ keyIndex ].index, values[ keyIndex ] );
+	}
+}
+
+TEST_F( RadixSortJobTest, HandlesSmallAndConstantArrays )
+{
+	DynamicArray< uint64_t > keys;
+	DynamicArray< uint32_t > values;
+	DynamicArray< uint64_t > scratchKeys;
+	DynamicArray< uint32_t > scratchValues;
+
+	RadixSort( keys, values, scratchKeys, scratchValues );
+	EXPECT_TRUE( keys.IsEmpty() );
+
+	for( uint32_t index = 0; index < 1000; ++index )
+	{
+		keys.Push( 42 );
+		values.Push( index );
+	}
+
+	RadixSort( keys, values, scratchKeys, scratchValues );
+	for( uint32_t index = 0; index < 1000; ++index )
+	{
+		ASSERT_EQ( 42u, keys[ index ] );
+		ASSERT_EQ( index, values[ index ] );
+	}
+}
+
+TEST_F( RadixSortJobTest, BenchmarkAgainstSortJob )
+{
+	DynamicArray< uint64_t > sourceKeys;
+	BuildDrawKeys( sourceKeys, BENCHMARK_KEY_COUNT, 0x9e3779b97f4a7c15ULL );
+
+	DynamicArray< uint64_t > keys;
+	DynamicArray< uint32_t > values;
+	DynamicArray< uint64_t > scratchKeys;
+	DynamicArray< uint32_t > scratchValues;
+	DynamicArray< KeyedIndex > entries;
+
+	uint64_t radixTicks = 0;
+	uint64_t comparisonTicks = 0;
+	for( size_t iteration = 0; iteration < BENCHMARK_ITERATION_COUNT; ++iteration )
+	{
+		keys = sourceKeys;
+		values.Resize( keys.GetSize() );
+		entries.Resize( keys.GetSize() );
+		for( size_t keyIndex = 0; keyIndex < keys.GetSize(); ++keyIndex )
+		{
+			values[ keyIndex ] = static_cast< uint32_t >( keyIndex );
+			entries[ keyIndex ].key = keys[ keyIndex ];
+			entries[ keyIndex ].index = static_cast< uint32_t >( keyIndex );
+		}
+
+		uint64_t startTicks = Timer::GetTickCount();
+		RadixSort( keys, values, scratchKeys, scratchValues );
+		radixTicks += Timer::GetTickCount() - startTicks;
+
+		startTicks = Timer::GetTickCount();
+		ComparisonSort( entries );
+		comparisonTicks += Timer::GetTickCount() - startTicks;
+
+		for( size_t keyIndex = 0; keyIndex < keys.GetSize(); ++keyIndex )
+		{
+			ASSERT_EQ( entries[ keyIndex ].key, keys[ keyIndex ] );
+		}
+	}
+
+	printf(
+		"%" PRIuSZ " keys x %" PRIuSZ ": RadixSortJob %.3f ms, SortJob %.3f ms\n",
+		BENCHMARK_KEY_COUNT,
+		BENCHMARK_ITERATION_COUNT,
+		Timer::TicksToMilliseconds( radixTicks ) / static_cast< float32_t >( BENCHMARK_ITERATION_COUNT ),
+		Timer::TicksToMilliseconds( comparisonTicks ) / static_cast< float32_t >( BENCHMARK_ITERATION_COUNT ) );
+}
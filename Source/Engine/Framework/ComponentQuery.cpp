@@ -1,6 +1,8 @@
 
 #include "Precompile.h"
 #include "Framework/ComponentQuery.h"
+#include "Platform/Atomic.h"
+#include "EngineJobs/JobManager.h"
 #include <limits>
 #include <vector>
 
@@ -46,7 +48,7 @@ void Helium::QueryComponentsInternal(ComponentManager &rManager, const Component
 	{
 		return;
 	}
-	
+
 	// Prepare the structure that will help us emit all permutations of found components
 	std::vector<FoundComponentList> found_components;
 	found_components.resize(typesCount);
@@ -101,3 +103,616 @@ void Helium::QueryComponentsInternal(ComponentManager &rManager, const Component
 		}
 	}
 }
+
+struct SnapshotTupleSink
+{
+	DynamicArray<Component *> *m_Components;
+	DynamicArray<Components::GenerationIndex> *m_Generations;
+
+	void operator()(DynamicArray<Component *> &tuple)
+	{
+		for (size_t type_index = 0; type_index < tuple.GetSize(); ++type_index)
+		{
+			m_Components->Push( tuple[type_index] );
+			m_Generations->Push( tuple[type_index]->GetInlineData().m_Generation );
+		}
+	}
+};
+
+struct ParallelTupleSink
+{
+	ParallelComponentTupleCallback m_Callback;
+	ComponentCommandBuffer *m_Commands;
+	void *m_Data;
+
+	void operator()(DynamicArray<Component *> &tuple)
+	{
+		m_Callback( tuple, *m_Commands, m_Data );
+	}
+};
+
+struct ParallelComponentBatch
+{
+	Component * const *m_Components;
+	size_t m_Count;
+	ParallelComponentCallback m_Callback;
+	void *m_Data;
+	ComponentCommandBuffer m_Commands;
+};
+
+struct ParallelTupleBatch
+{
+	const CachedComponentQuery *m_Query;
+	size_t m_FirstMatch;
+	size_t m_MatchCount;
+	ParallelComponentTupleCallback m_Callback;
+	void *m_Data;
+	DynamicArray<Component *> m_Tuple;
+	ComponentCommandBuffer m_Commands;
+};
+
+void RunParallelComponentBatch( void *pData )
+{
+	ParallelComponentBatch *pBatch = static_cast<ParallelComponentBatch *>( pData );
+	HELIUM_ASSERT( pBatch );
+
+	for (size_t index = 0; index < pBatch->m_Count; ++index)
+	{
+		pBatch->m_Callback( pBatch->m_Components[index], pBatch->m_Commands, pBatch->m_Data );
+	}
+}
+
+void RunParallelTupleBatch( void *pData )
+{
+	ParallelTupleBatch *pBatch = static_cast<ParallelTupleBatch *>( pData );
+	HELIUM_ASSERT( pBatch );
+
+	pBatch->m_Query->RunMatches( pBatch->m_FirstMatch, pBatch->m_MatchCount, pBatch->m_Tuple, pBatch->m_Callback, pBatch->m_Commands, pBatch->m_Data );
+}
+
+template <class Batch>
+void RunParallelBatches( DynamicArray<Batch> &batches, JOB_FUNC pFunction )
+{
+	JobManager *pJobManager = JobManager::GetInstance();
+	if (!pJobManager || batches.GetSize() < 2)
+	{
+		for (size_t batch = 0; batch < batches.GetSize(); ++batch)
+		{
+			pFunction( &batches[batch] );
+		}
+
+		return;
+	}
+
+	JobCounter counter;
+	for (size_t batch = 0; batch < batches.GetSize(); ++batch)
+	{
+		pJobManager->Spawn( pFunction, &batches[batch], counter );
+	}
+
+	pJobManager->Wait( counter );
+}
+
+CachedComponentQuery::CachedComponentQuery( ComponentManager &rManager, const Components::TypeId *types, size_t typesCount )
+	: m_Manager( rManager )
+	, m_UseArchetypes( false )
+	, m_RunDepth( 0 )
+	, m_SnapshotUsers( 0 )
+	, m_Dirty( false )
+	, m_RebuildCount( 0 )
+	, m_UpdateCount( 0 )
+{
+	HELIUM_ASSERT( typesCount );
+
+	m_Types.Reserve( typesCount );
+	m_FirstSlot.Reserve( typesCount + 1 );
+	for (size_t type_index = 0; type_index < typesCount; ++type_index)
+	{
+		m_Types.Push( types[type_index] );
+		m_FirstSlot.Push( m_SlotTypes.GetSize() );
+
+		const DynamicArray< Components::TypeId > &implementing_types = Components::GetTypeData( types[type_index] )->m_ImplementingTypes;
+		for (DynamicArray< Components::TypeId >::ConstIterator iter = implementing_types.Begin();
+			iter != implementing_types.End(); ++iter)
+		{
+			m_SlotTypes.Push( *iter );
+		}
+	}
+
+	m_FirstSlot.Push( m_SlotTypes.GetSize() );
+}
+
+bool CachedComponentQuery::Matches( const Components::TypeId *types, size_t typesCount ) const
+{
+	if (typesCount != m_Types.GetSize())
+	{
+		return false;
+	}
+
+	for (size_t type_index = 0; type_index < typesCount; ++type_index)
+	{
+		if (types[type_index] != m_Types[type_index])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CachedComponentQuery::Run( ComponentTupleCallback callback )
+{
+	if (m_Dirty && !m_RunDepth)
+	{
+		Rebuild();
+	}
+
+	size_t type_count = m_Types.GetSize();
+	size_t match_count = GetMatchCount();
+
+	// One tuple per run rather than one per match
+	DynamicArray<Component *> tuple;
+	tuple.Resize( type_count );
+
+	// Callbacks may allocate and free components, which changes the matches (and moves archetype rows) under the
+	// walk, so take a snapshot first and skip any tuple holding a component that has been freed since. The snapshot
+	// buffers are kept between runs; a run that starts while they are in use (a callback running this query again,
+	// or another task on the same world) takes its own.
+	DynamicArray<Component *> localComponents;
+	DynamicArray<Components::GenerationIndex> localGenerations;
+	bool ownsSnapshot = ( AtomicIncrementAcquire( m_SnapshotUsers ) == 1 );
+	DynamicArray<Component *> &components = ownsSnapshot ? m_SnapshotComponents : localComponents;
+	DynamicArray<Components::GenerationIndex> &generations = ownsSnapshot ? m_SnapshotGenerations : localGenerations;
+	components.Resize( 0 );
+	generations.Resize( 0 );
+	components.Reserve( match_count * type_count );
+	generations.Reserve( match_count * type_count );
+
+	SnapshotTupleSink sink = { &components, &generations };
+	VisitMatches( 0, match_count, tuple, sink );
+
+	for (size_t first = 0; first < components.GetSize(); first += type_count)
+	{
+		bool alive = true;
+		for (size_t type_index = 0; alive && type_index < type_count; ++type_index)
+		{
+			Component *c = components[first + type_index];
+			alive = ( c->GetInlineData().m_Generation == generations[first + type_index] );
+			tuple[type_index] = c;
+		}
+
+		if (alive)
+		{
+			callback( tuple );
+		}
+	}
+
+	AtomicDecrementRelease( m_SnapshotUsers );
+}
+
+size_t CachedComponentQuery::GetMatchCount() const
+{
+	if (!m_UseArchetypes)
+	{
+		return m_Matches.GetSize();
+	}
+
+	size_t match_count = 0;
+	for (size_t archetype = 0; archetype < m_Archetypes.GetSize(); ++archetype)
+	{
+		match_count += m_Archetypes[archetype]->GetRowCount();
+	}
+
+	return match_count;
+}
+
+void CachedComponentQuery::Rebuild()
+{
+	HELIUM_ASSERT( !m_RunDepth );
+
+	m_Matches.Clear();
+	m_Heads.Clear();
+	m_MatchIndices.Clear();
+	m_Archetypes.Clear();
+	m_ArchetypeColumns.Clear();
+	m_UseArchetypes = m_Manager.IsArchetypeStorageEnabled();
+	m_Dirty = false;
+	++m_RebuildCount;
+
+	// The manager keeps archetype rows up to date itself, so only the archetypes need finding
+	if (m_UseArchetypes)
+	{
+		const DynamicArray<Components::Archetype *> &archetypes = m_Manager.GetArchetypes();
+		for (DynamicArray<Components::Archetype *>::ConstIterator iter = archetypes.Begin();
+			iter != archetypes.End(); ++iter)
+		{
+			AddArchetype( **iter );
+		}
+
+		return;
+	}
+
+	// Every match holds an implementation of the first queried type, so only those collections need visiting
+	for (size_t slot = m_FirstSlot[0]; slot < m_FirstSlot[1]; ++slot)
+	{
+		const Components::Pool *pPool = m_Manager.GetPool( m_SlotTypes[slot] );
+		if (!pPool)
+		{
+			continue;
+		}
+
+		for (Components::ComponentIndex i = 0; i < pPool->GetAllocatedCount(); ++i)
+		{
+			ComponentCollection *pCollection = pPool->GetComponentCollection( pPool->GetComponentByRosterIndex( i ) );
+			HELIUM_ASSERT( pCollection );
+			UpdateCollection( *pCollection );
+		}
+	}
+}
+
+void CachedComponentQuery::UpdateCollection( ComponentCollection &rCollection )
+{
+	if (m_UseArchetypes)
+	{
+		return;
+	}
+
+	// Changing the match list under a running callback would invalidate the walk, so catch up afterwards
+	if (m_RunDepth)
+	{
+		m_Dirty = true;
+		return;
+	}
+
+	++m_UpdateCount;
+
+	bool matches = true;
+	for (size_t type_index = 0; matches && type_index < m_Types.GetSize(); ++type_index)
+	{
+		matches = false;
+		for (size_t slot = m_FirstSlot[type_index]; !matches && slot < m_FirstSlot[type_index + 1]; ++slot)
+		{
+			matches = ( rCollection.GetFirst( m_SlotTypes[slot] ) != NULL );
+		}
+	}
+
+	HashMap<ComponentCollection *, size_t>::Iterator iter = m_MatchIndices.Find( &rCollection );
+	if (!matches)
+	{
+		if (iter != m_MatchIndices.End())
+		{
+			RemoveMatch( iter->Second() );
+		}
+
+		return;
+	}
+
+	size_t slot_count = m_SlotTypes.GetSize();
+	size_t match;
+	if (iter != m_MatchIndices.End())
+	{
+		match = iter->Second();
+	}
+	else
+	{
+		match = m_Matches.GetSize();
+		m_Matches.Push( &rCollection );
+		m_Heads.Resize( m_Heads.GetSize() + slot_count );
+		m_MatchIndices.Insert( iter, HashMap<ComponentCollection *, size_t>::ValueType( &rCollection, match ) );
+	}
+
+	// Chain heads change as components of an existing type come and go, so refresh every slot
+	Component **heads = m_Heads.GetData() + match * slot_count;
+	for (size_t slot = 0; slot < slot_count; ++slot)
+	{
+		heads[slot] = rCollection.GetFirst( m_SlotTypes[slot] );
+	}
+}
+
+void CachedComponentQuery::RemoveMatch( size_t match )
+{
+	size_t slot_count = m_SlotTypes.GetSize();
+	size_t last_match = m_Matches.GetSize() - 1;
+
+	HELIUM_VERIFY( m_MatchIndices.Remove( m_Matches[match] ) );
+
+	// Move the last match into the vacated slot to keep the list dense
+	if (match != last_match)
+	{
+		ComponentCollection *pMoved = m_Matches[last_match];
+		m_Matches[match] = pMoved;
+		MemoryCopy( m_Heads.GetData() + match * slot_count, m_Heads.GetData() + last_match * slot_count, slot_count * sizeof( Component * ) );
+
+		HashMap<ComponentCollection *, size_t>::Iterator iter = m_MatchIndices.Find( pMoved );
+		HELIUM_ASSERT( iter != m_MatchIndices.End() );
+		iter->Second() = match;
+	}
+
+	m_Matches.Pop();
+	m_Heads.Resize( last_match * slot_count );
+}
+
+void CachedComponentQuery::OnArchetypeCreated( const Components::Archetype &rArchetype )
+{
+	if (!m_UseArchetypes)
+	{
+		return;
+	}
+
+	if (m_RunDepth)
+	{
+		m_Dirty = true;
+		return;
+	}
+
+	AddArchetype( rArchetype );
+}
+
+void CachedComponentQuery::AddArchetype( const Components::Archetype &rArchetype )
+{
+	size_t slot_count = m_SlotTypes.GetSize();
+	size_t first_column = m_ArchetypeColumns.GetSize();
+	m_ArchetypeColumns.Resize( first_column + slot_count );
+
+	bool matches = true;
+	for (size_t type_index = 0; matches && type_index < m_Types.GetSize(); ++type_index)
+	{
+		matches = false;
+		for (size_t slot = m_FirstSlot[type_index]; slot < m_FirstSlot[type_index + 1]; ++slot)
+		{
+			size_t column = rArchetype.FindColumn( m_SlotTypes[slot] );
+			m_ArchetypeColumns[first_column + slot] = column;
+			matches |= IsValid( column );
+		}
+	}
+
+	if (!matches)
+	{
+		m_ArchetypeColumns.Resize( first_column );
+		return;
+	}
+
+	m_Archetypes.Push( &rArchetype );
+}
+
+template <class Sink>
+void CachedComponentQuery::VisitMatches( size_t firstMatch, size_t matchCount, DynamicArray<Component *> &tuple, Sink &rSink ) const
+{
+	size_t slot_count = m_SlotTypes.GetSize();
+	if (!m_UseArchetypes)
+	{
+		for (size_t match = firstMatch; match < firstMatch + matchCount; ++match)
+		{
+			EmitTuples( tuple, m_Heads.GetData() + match * slot_count, 0, rSink );
+		}
+
+		return;
+	}
+
+	// Archetype matches are numbered row by row through each matching archetype in turn
+	size_t archetype = 0;
+	size_t row = firstMatch;
+	while (archetype < m_Archetypes.GetSize() && row >= m_Archetypes[archetype]->GetRowCount())
+	{
+		row -= m_Archetypes[archetype]->GetRowCount();
+		++archetype;
+	}
+
+	DynamicArray<Component *> heads;
+	heads.Resize( slot_count );
+
+	for (size_t remaining = matchCount; remaining; --remaining)
+	{
+		HELIUM_ASSERT( archetype < m_Archetypes.GetSize() );
+		const Components::Archetype *pArchetype = m_Archetypes[archetype];
+		const size_t *columns = m_ArchetypeColumns.GetData() + archetype * slot_count;
+		for (size_t slot = 0; slot < slot_count; ++slot)
+		{
+			heads[slot] = IsValid( columns[slot] ) ? pArchetype->m_Columns[columns[slot]][row] : NULL;
+		}
+
+		EmitTuples( tuple, heads.GetData(), 0, rSink );
+
+		if (++row == pArchetype->GetRowCount())
+		{
+			row = 0;
+			do
+			{
+				++archetype;
+			}
+			while (archetype < m_Archetypes.GetSize() && !m_Archetypes[archetype]->GetRowCount());
+		}
+	}
+}
+
+template <class Sink>
+void CachedComponentQuery::EmitTuples( DynamicArray<Component *> &tuple, Component * const *heads, size_t typeIndex, Sink &rSink ) const
+{
+	for (size_t slot = m_FirstSlot[typeIndex]; slot < m_FirstSlot[typeIndex + 1]; ++slot)
+	{
+		for (Component *c = heads[slot]; c; c = c->GetNextComponent())
+		{
+			tuple[typeIndex] = c;
+
+			if (typeIndex < m_Types.GetSize() - 1)
+			{
+				EmitTuples( tuple, heads, typeIndex + 1, rSink );
+			}
+			else
+			{
+				rSink( tuple );
+			}
+		}
+	}
+}
+
+void CachedComponentQuery::RunMatches( size_t firstMatch, size_t matchCount, DynamicArray<Component *> &tuple, ParallelComponentTupleCallback callback, ComponentCommandBuffer &rCommands, void *pData ) const
+{
+	HELIUM_ASSERT( firstMatch + matchCount <= GetMatchCount() );
+	HELIUM_ASSERT( tuple.GetSize() == m_Types.GetSize() );
+
+	ParallelTupleSink sink = { callback, &rCommands, pData };
+	VisitMatches( firstMatch, matchCount, tuple, sink );
+}
+
+void CachedComponentQuery::RunParallel( ParallelComponentTupleCallback callback, void *pData, size_t batchSize )
+{
+	HELIUM_ASSERT( batchSize );
+
+	if (m_Dirty && !m_RunDepth)
+	{
+		Rebuild();
+	}
+
+	size_t match_count = GetMatchCount();
+	if (!match_count)
+	{
+		return;
+	}
+
+	// Permutations of one collection always land in the same batch, so a batch owns its collections outright
+	DynamicArray<ParallelTupleBatch> batches;
+	batches.Resize( ( match_count + batchSize - 1 ) / batchSize );
+	for (size_t batch = 0; batch < batches.GetSize(); ++batch)
+	{
+		ParallelTupleBatch &rBatch = batches[batch];
+		rBatch.m_Query = this;
+		rBatch.m_FirstMatch = batch * batchSize;
+		rBatch.m_MatchCount = Min( batchSize, match_count - rBatch.m_FirstMatch );
+		rBatch.m_Callback = callback;
+		rBatch.m_Data = pData;
+		rBatch.m_Tuple.Resize( m_Types.GetSize() );
+	}
+
+	AtomicIncrementAcquire( m_RunDepth );
+	RunParallelBatches( batches, RunParallelTupleBatch );
+	AtomicDecrementRelease( m_RunDepth );
+
+	// Apply structural changes in batch order so the result doesn't depend on which thread ran what
+	for (size_t batch = 0; batch < batches.GetSize(); ++batch)
+	{
+		batches[batch].m_Commands.Execute( m_Manager );
+	}
+
+	if (m_Dirty && !m_RunDepth)
+	{
+		Rebuild();
+	}
+}
+
+void ComponentCommandBuffer::Allocate( Components::TypeId type, Components::IHasComponents *pOwner, ComponentCollection &rCollection, AllocateCallback callback, void *pData )
+{
+	Command &rCommand = *m_Commands.New();
+	rCommand.m_Component = NULL;
+	rCommand.m_Generation = 0;
+	rCommand.m_Type = type;
+	rCommand.m_Owner = pOwner;
+	rCommand.m_Collection = &rCollection;
+	rCommand.m_Callback = callback;
+	rCommand.m_Data = pData;
+}
+
+void ComponentCommandBuffer::Free( Component *pComponent )
+{
+	HELIUM_ASSERT( pComponent );
+
+	Command &rCommand = *m_Commands.New();
+	rCommand.m_Component = pComponent;
+	rCommand.m_Generation = pComponent->GetInlineData().m_Generation;
+	rCommand.m_Type = Invalid<Components::TypeId>();
+	rCommand.m_Owner = NULL;
+	rCommand.m_Collection = NULL;
+	rCommand.m_Callback = NULL;
+	rCommand.m_Data = NULL;
+}
+
+void ComponentCommandBuffer::Execute( ComponentManager &rManager )
+{
+	for (DynamicArray<Command>::Iterator iter = m_Commands.Begin(); iter != m_Commands.End(); ++iter)
+	{
+		if (iter->m_Component)
+		{
+			// The component may have been freed (and even reused) since the free was recorded
+			if (iter->m_Component->GetInlineData().m_Generation == iter->m_Generation)
+			{
+				iter->m_Component->FreeComponent();
+			}
+		}
+		else
+		{
+			Component *pComponent = rManager.Allocate( iter->m_Type, iter->m_Owner, *iter->m_Collection );
+			if (pComponent && iter->m_Callback)
+			{
+				iter->m_Callback( pComponent, iter->m_Data );
+			}
+		}
+	}
+
+	m_Commands.Clear();
+}
+
+void Helium::ParallelQueryComponentsInternal(ComponentManager &rManager, Components::TypeId type, ParallelComponentCallback callback, void *pData, size_t batchSize)
+{
+	HELIUM_ASSERT( batchSize );
+
+	const DynamicArray< Components::TypeId > &implementing_types = Components::GetTypeData( type )->m_ImplementingTypes;
+
+	size_t batch_count = 0;
+	for (DynamicArray< Components::TypeId >::ConstIterator iter = implementing_types.Begin();
+		iter != implementing_types.End(); ++iter)
+	{
+		const Components::Pool *pPool = rManager.GetPool( *iter );
+		if (pPool)
+		{
+			batch_count += ( pPool->GetAllocatedCount() + batchSize - 1 ) / batchSize;
+		}
+	}
+
+	if (!batch_count)
+	{
+		return;
+	}
+
+	// Rosters can't be reallocated while the batches run because allocations are deferred to the command buffers
+	DynamicArray<ParallelComponentBatch> batches;
+	batches.Resize( batch_count );
+
+	size_t batch = 0;
+	for (DynamicArray< Components::TypeId >::ConstIterator iter = implementing_types.Begin();
+		iter != implementing_types.End(); ++iter)
+	{
+		const Components::Pool *pPool = rManager.GetPool( *iter );
+		if (!pPool)
+		{
+			continue;
+		}
+
+		size_t component_count = pPool->GetAllocatedCount();
+		for (size_t first = 0; first < component_count; first += batchSize)
+		{
+			ParallelComponentBatch &rBatch = batches[batch++];
+			rBatch.m_Components = pPool->GetAllocatedComponents() + first;
+			rBatch.m_Count = Min( batchSize, component_count - first );
+			rBatch.m_Callback = callback;
+			rBatch.m_Data = pData;
+		}
+	}
+
+	HELIUM_ASSERT( batch == batch_count );
+	RunParallelBatches( batches, RunParallelComponentBatch );
+
+	for (batch = 0; batch < batch_count; ++batch)
+	{
+		batches[batch].m_Commands.Execute( rManager );
+	}
+}
+
+void Helium::ParallelQueryComponentsInternal(ComponentManager &rManager, const Components::TypeId *types, size_t typesCount, ParallelComponentTupleCallback callback, void *pData, size_t batchSize)
+{
+	if (!typesCount)
+	{
+		return;
+	}
+
+	rManager.GetCachedQuery( types, typesCount )->RunParallel( callback, pData, batchSize );
+}
@@ -3,13 +3,148 @@
 
 #include "Framework/Framework.h"
 #include "Foundation/DynamicArray.h"
+#include "Foundation/HashMap.h"
 #include "Framework/Components.h"
 
+#define HELIUM_PARALLEL_QUERY_BATCH_SIZE (256)
+
 namespace Helium
 {
+	//! Allocations and frees requested while components are being processed in parallel. Pools are not thread safe, so
+	//! each batch records its changes here and they are applied once every batch has finished, in batch order.
+	class HELIUM_FRAMEWORK_API ComponentCommandBuffer
+	{
+	public:
+		typedef void (*AllocateCallback)(Component *pComponent, void *pData);
+
+		void          Allocate( Components::TypeId type, Components::IHasComponents *pOwner, ComponentCollection &rCollection, AllocateCallback callback = NULL, void *pData = NULL );
+		void          Free( Component *pComponent );
+		void          Execute( ComponentManager &rManager );
+
+		inline bool   IsEmpty() const;
+		inline size_t GetCommandCount() const;
+
+		template <class T> void Allocate( Components::IHasComponents *pOwner, ComponentCollection &rCollection, AllocateCallback callback = NULL, void *pData = NULL )
+		{
+			Allocate( Components::GetType<T>(), pOwner, rCollection, callback, pData );
+		}
+
+	private:
+		struct Command
+		{
+			Component                   *m_Component;    // Component to free, or NULL to allocate
+			Components::GenerationIndex  m_Generation;   // Generation of m_Component when the free was recorded
+			Components::TypeId           m_Type;
+			Components::IHasComponents  *m_Owner;
+			ComponentCollection         *m_Collection;
+			AllocateCallback             m_Callback;
+			void                        *m_Data;
+		};
+
+		DynamicArray<Command> m_Commands;
+	};
+
 	typedef void (*ComponentTupleCallback)(DynamicArray<Component *> &tuple);
+	typedef void (*ParallelComponentCallback)(Component *pComponent, ComponentCommandBuffer &rCommands, void *pData);
+	typedef void (*ParallelComponentTupleCallback)(DynamicArray<Component *> &tuple, ComponentCommandBuffer &rCommands, void *pData);
 	
 	void HELIUM_FRAMEWORK_API QueryComponentsInternal(ComponentManager &rManager, const Components::TypeId *types, size_t typesCount, ComponentTupleCallback callback);
+
+	// Split the matching components into batches and run them on the job manager (or serially if there isn't one)
+	void HELIUM_FRAMEWORK_API ParallelQueryComponentsInternal(ComponentManager &rManager, Components::TypeId type, ParallelComponentCallback callback, void *pData = NULL, size_t batchSize = HELIUM_PARALLEL_QUERY_BATCH_SIZE);
+	void HELIUM_FRAMEWORK_API ParallelQueryComponentsInternal(ComponentManager &rManager, const Components::TypeId *types, size_t typesCount, ParallelComponentTupleCallback callback, void *pData = NULL, size_t batchSize = HELIUM_PARALLEL_QUERY_BATCH_SIZE);
+
+	//! Persistent query owned by a ComponentManager (see ComponentManager::GetCachedQuery). It keeps a dense list of
+	//! the collections that hold every queried type, which Pool::Allocate and Pool::Free keep up to date, so running
+	//! the query is a linear walk over matches rather than a search of every pool. When the manager uses archetype
+	//! storage the query keeps the matching archetypes instead and walks their rows, since the manager already
+	//! groups collections by the types they hold.
+	class HELIUM_FRAMEWORK_API CachedComponentQuery
+	{
+	public:
+		CachedComponentQuery( ComponentManager &rManager, const Components::TypeId *types, size_t typesCount );
+
+		void                                Run( ComponentTupleCallback callback );
+		void                                RunParallel( ParallelComponentTupleCallback callback, void *pData = NULL, size_t batchSize = HELIUM_PARALLEL_QUERY_BATCH_SIZE );
+		void                                RunMatches( size_t firstMatch, size_t matchCount, DynamicArray<Component *> &tuple, ParallelComponentTupleCallback callback, ComponentCommandBuffer &rCommands, void *pData ) const;
+		void                                Rebuild();
+		void                                UpdateCollection( ComponentCollection &rCollection );
+		void                                OnArchetypeCreated( const Components::Archetype &rArchetype );
+
+		bool                                Matches( const Components::TypeId *types, size_t typesCount ) const;
+		inline const DynamicArray<Components::TypeId> &GetTypes() const;
+		inline const DynamicArray<Components::TypeId> &GetSlotTypes() const;
+
+		// Stats for profiling
+		size_t                              GetMatchCount() const;
+		inline uint32_t                     GetRebuildCount() const;
+		inline uint32_t                     GetUpdateCount() const;
+		inline void                         ResetStats();
+
+	private:
+		template <class Sink> void          VisitMatches( size_t firstMatch, size_t matchCount, DynamicArray<Component *> &tuple, Sink &rSink ) const;
+		template <class Sink> void          EmitTuples( DynamicArray<Component *> &tuple, Component * const *heads, size_t typeIndex, Sink &rSink ) const;
+		void                                RemoveMatch( size_t match );
+		void                                AddArchetype( const Components::Archetype &rArchetype );
+
+		ComponentManager                   &m_Manager;
+		DynamicArray<Components::TypeId>    m_Types;           // Queried types, in callback argument order
+		DynamicArray<Components::TypeId>    m_SlotTypes;       // Every type implementing a queried type, grouped by queried type
+		DynamicArray<size_t>                m_FirstSlot;       // Index into m_SlotTypes for each queried type, plus an end marker
+
+		DynamicArray<ComponentCollection *> m_Matches;         // Collections that have every queried type
+		DynamicArray<Component *>           m_Heads;           // First component of each slot type, m_SlotTypes.GetSize() per match
+		HashMap<ComponentCollection *, size_t> m_MatchIndices; // Collection to index in m_Matches
+
+		DynamicArray<const Components::Archetype *> m_Archetypes; // Archetypes holding every queried type (archetype storage only)
+		DynamicArray<size_t>                m_ArchetypeColumns; // Column of each slot type, m_SlotTypes.GetSize() per archetype
+		bool                                m_UseArchetypes;   // Matches are archetype rows rather than m_Matches
+
+		volatile int32_t                    m_RunDepth;        // Non-zero while callbacks are running
+		volatile int32_t                    m_SnapshotUsers;   // Runs in progress, only the first uses the buffers below
+		DynamicArray<Component *>           m_SnapshotComponents;  // Tuples captured by Run, kept between runs
+		DynamicArray<Components::GenerationIndex> m_SnapshotGenerations; // Generation of each captured component
+		bool                                m_Dirty;           // Collections changed while running, rebuild when done
+
+		uint32_t                            m_RebuildCount;
+		uint32_t                            m_UpdateCount;
+	};
+
+	bool ComponentCommandBuffer::IsEmpty() const
+	{
+		return m_Commands.IsEmpty();
+	}
+
+	size_t ComponentCommandBuffer::GetCommandCount() const
+	{
+		return m_Commands.GetSize();
+	}
+
+	const DynamicArray<Components::TypeId> &CachedComponentQuery::GetTypes() const
+	{
+		return m_Types;
+	}
+
+	const DynamicArray<Components::TypeId> &CachedComponentQuery::GetSlotTypes() const
+	{
+		return m_SlotTypes;
+	}
+
+	uint32_t CachedComponentQuery::GetRebuildCount() const
+	{
+		return m_RebuildCount;
+	}
+
+	uint32_t CachedComponentQuery::GetUpdateCount() const
+	{
+		return m_UpdateCount;
+	}
+
+	void CachedComponentQuery::ResetStats()
+	{
+		m_RebuildCount = 0;
+		m_UpdateCount = 0;
+	}
 	
 	template <class A, class B, void (*F)(A *, B *)>
 	void TupleHandler(DynamicArray<Component *> &components)
@@ -27,4 +162,29 @@ namespace Helium
 			static_cast<B *>(components[1]), 
 			static_cast<C *>(components[2]));
 	}
+
+	template <class A, void (*F)(A *, ComponentCommandBuffer &)>
+	void ParallelComponentHandler(Component *pComponent, ComponentCommandBuffer &rCommands, void *)
+	{
+		F(static_cast<A *>(pComponent), rCommands);
+	}
+
+	template <class A, class B, void (*F)(A *, B *, ComponentCommandBuffer &)>
+	void ParallelTupleHandler(DynamicArray<Component *> &components, ComponentCommandBuffer &rCommands, void *)
+	{
+		F(
+			static_cast<A *>(components[0]), 
+			static_cast<B *>(components[1]),
+			rCommands);
+	}
+
+	template <class A, class B, class C, void (*F)(A *, B *, C *, ComponentCommandBuffer &)>
+	void ParallelTupleHandler(DynamicArray<Component *> &components, ComponentCommandBuffer &rCommands, void *)
+	{
+		F(
+			static_cast<A *>(components[0]), 
+			static_cast<B *>(components[1]), 
+			static_cast<C *>(components[2]),
+			rCommands);
+	}
 }
@@ -0,0 +1,494 @@
+#include "Framework/ComponentQuery.h"
+
+#include "Platform/Atomic.h"
+#include "Platform/Timer.h"
+#include "Reflect/Registry.h"
+#include "EngineJobs/JobManager.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Number of entities created for the query benchmark.
+	const size_t QUERY_BENCHMARK_ENTITY_COUNT = 50000;
+	/// Number of times each query is run by the benchmark.
+	const size_t QUERY_BENCHMARK_RUN_COUNT = 20;
+	/// Number of entities created for the parallel query tests.
+	const size_t PARALLEL_QUERY_ENTITY_COUNT = 3000;
+	/// Value written by the allocation callbacks of commands.
+	const uint32_t COMMAND_ALLOCATED_MARKER = 0xc0ffee;
+
+	struct QueryTestPosition : public Component
+	{
+		HELIUM_DECLARE_COMPONENT( QueryTestPosition, Helium::Component );
+		static void PopulateMetaType( Reflect::MetaStruct& comp ) { }
+
+		float32_t m_Position[ 3 ];
+	};
+
+	struct QueryTestVelocity : public Component
+	{
+		HELIUM_DECLARE_COMPONENT( QueryTestVelocity, Helium::Component );
+		static void PopulateMetaType( Reflect::MetaStruct& comp ) { }
+
+		float32_t m_Velocity[ 3 ];
+	};
+
+	/// Only present on some entities, which splits the entities between archetypes.
+	struct QueryTestTag : public Component
+	{
+		HELIUM_DECLARE_COMPONENT( QueryTestTag, Helium::Component );
+		static void PopulateMetaType( Reflect::MetaStruct& comp ) { }
+
+		uint32_t m_Tag;
+	};
+
+	HELIUM_DEFINE_COMPONENT( QueryTestPosition, 64 );
+	HELIUM_DEFINE_COMPONENT( QueryTestVelocity, 64 );
+	HELIUM_DEFINE_COMPONENT( QueryTestTag, 64 );
+
+	/// Minimal component owner standing in for an entity.
+	struct QueryTestEntity : public Components::IHasComponents
+	{
+		ComponentManager *m_pManager;
+		ComponentCollection m_Components;
+
+		QueryTestEntity()
+			: m_pManager( NULL )
+		{
+		}
+
+		virtual ComponentManager* VirtualGetComponentManager() { return m_pManager; }
+		virtual ComponentCollection& VirtualGetComponents() { return m_Components; }
+	};
+
+	/// Tuples seen by the last query run.
+	size_t g_VisitedTupleCount;
+
+	void Integrate( QueryTestPosition *pPosition, QueryTestVelocity *pVelocity )
+	{
+		for ( size_t axis = 0; axis < 3; ++axis )
+		{
+			pPosition->m_Position[ axis ] += pVelocity->m_Velocity[ axis ];
+		}
+
+		++g_VisitedTupleCount;
+	}
+
+	/// Owners of the tuples seen by the last query run.
+	DynamicArray< Components::IHasComponents * > g_VisitedOwners;
+
+	void RecordOwner( QueryTestPosition *pPosition, QueryTestVelocity *pVelocity )
+	{
+		HELIUM_ASSERT( pPosition->GetOwner() == pVelocity->GetOwner() );
+		g_VisitedOwners.Push( pPosition->GetOwner() );
+	}
+
+	/// State shared with the parallel query callbacks.
+	struct ParallelQueryTestData
+	{
+		ComponentManager *m_pManager;
+		QueryTestEntity *m_pEntities;
+		size_t m_PositionCount;
+		size_t m_VelocityCount;
+		volatile int32_t m_VisitCount;
+		volatile int32_t m_ObservedChangeCount;
+	};
+
+	size_t GetEntityIndex( const ParallelQueryTestData &rData, Component *pComponent )
+	{
+		return static_cast< QueryTestEntity * >( pComponent->GetOwner() ) - rData.m_pEntities;
+	}
+
+	void MarkAllocatedTag( Component *pComponent, void * )
+	{
+		static_cast< QueryTestTag * >( pComponent )->m_Tag = COMMAND_ALLOCATED_MARKER;
+	}
+
+	void MarkAllocatedVelocity( Component *pComponent, void * )
+	{
+		static_cast< QueryTestVelocity * >( pComponent )->m_Velocity[ 0 ] = static_cast< float32_t >( COMMAND_ALLOCATED_MARKER );
+	}
+
+	/// Destroys every third entity, tags the next and strips the velocity from the one after.
+	void QueueEntityCommands( Component *pComponent, ComponentCommandBuffer &rCommands, void *pData )
+	{
+		ParallelQueryTestData &rData = *static_cast< ParallelQueryTestData * >( pData );
+		AtomicIncrementAcquire( rData.m_VisitCount );
+
+		// Nothing is applied until every batch has finished
+		if ( rData.m_pManager->CountAllocatedComponents< QueryTestPosition >() != rData.m_PositionCount ||
+			rData.m_pManager->CountAllocatedComponents< QueryTestVelocity >() != rData.m_VelocityCount )
+		{
+			AtomicIncrementAcquire( rData.m_ObservedChangeCount );
+		}
+
+		size_t entityIndex = GetEntityIndex( rData, pComponent );
+		QueryTestEntity &rEntity = rData.m_pEntities[ entityIndex ];
+		switch ( entityIndex % 3 )
+		{
+		case 0:
+			rCommands.Free( pComponent );
+			rCommands.Free( rEntity.m_Components.GetFirst< QueryTestVelocity >() );
+			break;
+
+		case 1:
+			rCommands.Allocate< QueryTestTag >( &rEntity, rEntity.m_Components, MarkAllocatedTag );
+			break;
+
+		default:
+			rCommands.Free( rEntity.m_Components.GetFirst< QueryTestVelocity >() );
+			break;
+		}
+	}
+
+	/// Replaces the entity's velocity, and also frees the velocity of its neighbour (which the neighbour's own batch
+	/// replaces too), so every velocity gets freed twice in the same frame.
+	void ReplaceVelocities( DynamicArray< Component * > &rTuple, ComponentCommandBuffer &rCommands, void *pData )
+	{
+		ParallelQueryTestData &rData = *static_cast< ParallelQueryTestData * >( pData );
+		AtomicIncrementAcquire( rData.m_VisitCount );
+
+		size_t entityIndex = GetEntityIndex( rData, rTuple[ 0 ] );
+		QueryTestEntity &rEntity = rData.m_pEntities[ entityIndex ];
+		QueryTestEntity &rNeighbour = rData.m_pEntities[ entityIndex ^ 1 ];
+
+		rCommands.Free( rTuple[ 1 ] );
+		rCommands.Allocate< QueryTestVelocity >( &rEntity, rEntity.m_Components, MarkAllocatedVelocity );
+		rCommands.Free( rNeighbour.m_Components.GetFirst< QueryTestVelocity >() );
+	}
+
+	class ComponentQueryTest : public testing::Test
+	{
+	protected:
+		ComponentManagerPtr m_spManager;
+		DynamicArray< QueryTestEntity > m_Entities;
+
+		static void SetUpTestCase()
+		{
+			Reflect::Startup();
+			Components::Startup( NULL );
+			JobManager::Startup();
+		}
+
+		static void TearDownTestCase()
+		{
+			JobManager::Shutdown();
+			Components::Shutdown();
+			Reflect::Shutdown();
+		}
+
+		void SetUp()
+		{
+			m_spManager = Components::CreateManager( NULL );
+			g_VisitedTupleCount = 0;
+		}
+
+		void TearDown()
+		{
+			g_VisitedOwners.Clear();
+
+			// Collections free their components, so they must go before the manager
+			m_Entities.Clear();
+			m_spManager.Reset();
+		}
+
+		/// Create entities once (collections must not move after components are allocated into them).
+		void CreateEntities( size_t entityCount )
+		{
+			HELIUM_ASSERT( m_Entities.IsEmpty() );
+			m_Entities.Resize( entityCount );
+			for ( size_t entityIndex = 0; entityIndex < entityCount; ++entityIndex )
+			{
+				m_Entities[ entityIndex ].m_pManager = m_spManager.Get();
+			}
+		}
+
+		template < class T >
+		T *AllocateComponent( size_t entityIndex )
+		{
+			QueryTestEntity &rEntity = m_Entities[ entityIndex ];
+			return m_spManager->Allocate< T >( &rEntity, rEntity.m_Components );
+		}
+
+		/// Give every entity a position and velocity, and every third one a tag.
+		void PopulateMovingEntities()
+		{
+			for ( size_t entityIndex = 0; entityIndex < m_Entities.GetSize(); ++entityIndex )
+			{
+				QueryTestPosition *pPosition = AllocateComponent< QueryTestPosition >( entityIndex );
+				QueryTestVelocity *pVelocity = AllocateComponent< QueryTestVelocity >( entityIndex );
+				ASSERT_TRUE( pPosition && pVelocity );
+
+				for ( size_t axis = 0; axis < 3; ++axis )
+				{
+					pPosition->m_Position[ axis ] = 0.0f;
+					pVelocity->m_Velocity[ axis ] = static_cast< float32_t >( axis + 1 );
+				}
+
+				if ( entityIndex % 3 == 0 )
+				{
+					QueryTestTag *pTag = AllocateComponent< QueryTestTag >( entityIndex );
+					ASSERT_TRUE( pTag != NULL );
+					pTag->m_Tag = static_cast< uint32_t >( entityIndex );
+				}
+			}
+		}
+
+		CachedComponentQuery *GetMovingQuery()
+		{
+			Components::TypeId types[] =
+			{
+				Components::GetType< QueryTestPosition >(),
+				Components::GetType< QueryTestVelocity >()
+			};
+
+			return m_spManager->GetCachedQuery( types, HELIUM_ARRAY_COUNT( types ) );
+		}
+
+		/// Run the moving entity query once, returning how many tuples the given entity appeared in.
+		size_t CountVisits( CachedComponentQuery *pQuery, size_t entityIndex )
+		{
+			g_VisitedOwners.Resize( 0 );
+			pQuery->Run( TupleHandler< QueryTestPosition, QueryTestVelocity, RecordOwner > );
+
+			size_t visitCount = 0;
+			for ( size_t visitIndex = 0; visitIndex < g_VisitedOwners.GetSize(); ++visitIndex )
+			{
+				if ( g_VisitedOwners[ visitIndex ] == &m_Entities[ entityIndex ] )
+				{
+					++visitCount;
+				}
+			}
+
+			return visitCount;
+		}
+
+		/// Add and remove components under a query created up front, checking that its matches follow along.
+		void CheckIncrementalUpdates()
+		{
+			const size_t entityCount = 8;
+			CreateEntities( entityCount );
+
+			CachedComponentQuery *pQuery = GetMovingQuery();
+			ASSERT_EQ( 0u, pQuery->GetMatchCount() );
+			pQuery->ResetStats();
+
+			// Positions everywhere, velocities on even entities only
+			for ( size_t entityIndex = 0; entityIndex < entityCount; ++entityIndex )
+			{
+				ASSERT_TRUE( AllocateComponent< QueryTestPosition >( entityIndex ) != NULL );
+				if ( entityIndex % 2 == 0 )
+				{
+					ASSERT_TRUE( AllocateComponent< QueryTestVelocity >( entityIndex ) != NULL );
+				}
+			}
+
+			EXPECT_EQ( 4u, pQuery->GetMatchCount() );
+			for ( size_t entityIndex = 0; entityIndex < entityCount; ++entityIndex )
+			{
+				EXPECT_EQ( entityIndex % 2 == 0 ? 1u : 0u, CountVisits( pQuery, entityIndex ) );
+			}
+
+			// Losing the velocity drops the entity
+			m_Entities[ 0 ].m_Components.GetFirst< QueryTestVelocity >()->FreeComponent();
+			EXPECT_EQ( 3u, pQuery->GetMatchCount() );
+			EXPECT_EQ( 0u, CountVisits( pQuery, 0 ) );
+
+			// A second velocity adds a tuple but not a match
+			ASSERT_TRUE( AllocateComponent< QueryTestVelocity >( 2 ) != NULL );
+			EXPECT_EQ( 3u, pQuery->GetMatchCount() );
+			EXPECT_EQ( 2u, CountVisits( pQuery, 2 ) );
+			EXPECT_EQ( 4u, g_VisitedOwners.GetSize() );
+
+			// Gaining a velocity adds the entity, and an unrelated tag changes nothing
+			ASSERT_TRUE( AllocateComponent< QueryTestVelocity >( 5 ) != NULL );
+			ASSERT_TRUE( AllocateComponent< QueryTestTag >( 5 ) != NULL );
+			EXPECT_EQ( 4u, pQuery->GetMatchCount() );
+			EXPECT_EQ( 1u, CountVisits( pQuery, 5 ) );
+
+			// Releasing everything on an entity drops it
+			m_Entities[ 4 ].m_Components.ReleaseAll();
+			EXPECT_EQ( 3u, pQuery->GetMatchCount() );
+			EXPECT_EQ( 0u, CountVisits( pQuery, 4 ) );
+
+			size_t expectedVisits[ entityCount ] = { 0, 0, 2, 0, 0, 1, 1, 0 };
+			for ( size_t entityIndex = 0; entityIndex < entityCount; ++entityIndex )
+			{
+				EXPECT_EQ( expectedVisits[ entityIndex ], CountVisits( pQuery, entityIndex ) ) << "Entity " << entityIndex;
+			}
+
+			// None of this needed a full rebuild
+			EXPECT_EQ( 0u, pQuery->GetRebuildCount() );
+		}
+
+		/// Run the moving entity query a number of times, returning the ticks taken.
+		uint64_t TimeMovingQuery( size_t runCount )
+		{
+			CachedComponentQuery *pQuery = GetMovingQuery();
+
+			uint64_t startTicks = Timer::GetTickCount();
+			for ( size_t runIndex = 0; runIndex < runCount; ++runIndex )
+			{
+				g_VisitedTupleCount = 0;
+				pQuery->Run( TupleHandler< QueryTestPosition, QueryTestVelocity, Integrate > );
+			}
+
+			return Timer::GetTickCount() - startTicks;
+		}
+	};
+}
+
+TEST_F( ComponentQueryTest, BenchmarkArchetypeStorage )
+{
+	CreateEntities( QUERY_BENCHMARK_ENTITY_COUNT );
+	PopulateMovingEntities();
+
+	Components::TypeId types[] =
+	{
+		Components::GetType< QueryTestPosition >(),
+		Components::GetType< QueryTestVelocity >()
+	};
+
+	// Uncached search of the pools, as queries ran before they were cached
+	g_VisitedTupleCount = 0;
+	uint64_t startTicks = Timer::GetTickCount();
+	for ( size_t runIndex = 0; runIndex < QUERY_BENCHMARK_RUN_COUNT; ++runIndex )
+	{
+		g_VisitedTupleCount = 0;
+		QueryComponentsInternal( *m_spManager, types, HELIUM_ARRAY_COUNT( types ), TupleHandler< QueryTestPosition, QueryTestVelocity, Integrate > );
+	}
+	uint64_t uncachedTicks = Timer::GetTickCount() - startTicks;
+	EXPECT_EQ( QUERY_BENCHMARK_ENTITY_COUNT, g_VisitedTupleCount );
+
+	ASSERT_FALSE( m_spManager->IsArchetypeStorageEnabled() );
+	uint64_t collectionTicks = TimeMovingQuery( QUERY_BENCHMARK_RUN_COUNT );
+	EXPECT_EQ( QUERY_BENCHMARK_ENTITY_COUNT, g_VisitedTupleCount );
+
+	m_spManager->SetArchetypeStorageEnabled( true );
+	EXPECT_EQ( 2u, m_spManager->GetArchetypes().GetSize() );
+	uint64_t archetypeTicks = TimeMovingQuery( QUERY_BENCHMARK_RUN_COUNT );
+	EXPECT_EQ( QUERY_BENCHMARK_ENTITY_COUNT, g_VisitedTupleCount );
+	EXPECT_EQ( QUERY_BENCHMARK_ENTITY_COUNT, GetMovingQuery()->GetMatchCount() );
+
+	// Every run moved every entity once
+	const float32_t expectedX = static_cast< float32_t >( QUERY_BENCHMARK_RUN_COUNT * 3 );
+	EXPECT_EQ( expectedX, m_Entities[ 0 ].m_Components.GetFirst< QueryTestPosition >()->m_Position[ 0 ] );
+	EXPECT_EQ( expectedX, m_Entities[ QUERY_BENCHMARK_ENTITY_COUNT - 1 ].m_Components.GetFirst< QueryTestPosition >()->m_Position[ 0 ] );
+
+	printf(
+		"%u entities, %u runs: uncached %.3f ms, cached collections %.3f ms, archetypes %.3f ms\n",
+		static_cast< uint32_t >( QUERY_BENCHMARK_ENTITY_COUNT ),
+		static_cast< uint32_t >( QUERY_BENCHMARK_RUN_COUNT ),
+		Timer::TicksToMilliseconds( uncachedTicks ),
+		Timer::TicksToMilliseconds( collectionTicks ),
+		Timer::TicksToMilliseconds( archetypeTicks ) );
+}
+
+TEST_F( ComponentQueryTest, CachedQueryFollowsComponentChanges )
+{
+	CheckIncrementalUpdates();
+}
+
+TEST_F( ComponentQueryTest, ArchetypeQueryFollowsComponentChanges )
+{
+	m_spManager->SetArchetypeStorageEnabled( true );
+	CheckIncrementalUpdates();
+}
+
+TEST_F( ComponentQueryTest, ParallelQueryCommandsApplyAfterAllBatches )
+{
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	CreateEntities( PARALLEL_QUERY_ENTITY_COUNT );
+	for ( size_t entityIndex = 0; entityIndex < PARALLEL_QUERY_ENTITY_COUNT; ++entityIndex )
+	{
+		ASSERT_TRUE( AllocateComponent< QueryTestPosition >( entityIndex ) != NULL );
+		ASSERT_TRUE( AllocateComponent< QueryTestVelocity >( entityIndex ) != NULL );
+	}
+
+	ParallelQueryTestData data = { m_spManager.Get(), m_Entities.GetData(), PARALLEL_QUERY_ENTITY_COUNT, PARALLEL_QUERY_ENTITY_COUNT, 0, 0 };
+	ParallelQueryComponentsInternal( *m_spManager, Components::GetType< QueryTestPosition >(), QueueEntityCommands, &data, 64 );
+
+	EXPECT_EQ( static_cast< int32_t >( PARALLEL_QUERY_ENTITY_COUNT ), data.m_VisitCount );
+	EXPECT_EQ( 0, data.m_ObservedChangeCount );
+
+	const size_t groupCount = PARALLEL_QUERY_ENTITY_COUNT / 3;
+	EXPECT_EQ( PARALLEL_QUERY_ENTITY_COUNT - groupCount, m_spManager->CountAllocatedComponents< QueryTestPosition >() );
+	EXPECT_EQ( groupCount, m_spManager->CountAllocatedComponents< QueryTestVelocity >() );
+	EXPECT_EQ( groupCount, m_spManager->CountAllocatedComponents< QueryTestTag >() );
+
+	for ( size_t entityIndex = 0; entityIndex < PARALLEL_QUERY_ENTITY_COUNT; ++entityIndex )
+	{
+		ComponentCollection &rComponents = m_Entities[ entityIndex ].m_Components;
+		QueryTestTag *pTag = rComponents.GetFirst< QueryTestTag >();
+
+		switch ( entityIndex % 3 )
+		{
+		case 0:
+			EXPECT_TRUE( rComponents.GetFirst< QueryTestPosition >() == NULL );
+			EXPECT_TRUE( rComponents.GetFirst< QueryTestVelocity >() == NULL );
+			EXPECT_TRUE( pTag == NULL );
+			break;
+
+		case 1:
+			EXPECT_TRUE( rComponents.GetFirst< QueryTestPosition >() != NULL );
+			EXPECT_TRUE( rComponents.GetFirst< QueryTestVelocity >() != NULL );
+			ASSERT_TRUE( pTag != NULL );
+			EXPECT_EQ( COMMAND_ALLOCATED_MARKER, pTag->m_Tag );
+			EXPECT_EQ( &m_Entities[ entityIndex ], pTag->GetOwner() );
+			break;
+
+		default:
+			EXPECT_TRUE( rComponents.GetFirst< QueryTestPosition >() != NULL );
+			EXPECT_TRUE( rComponents.GetFirst< QueryTestVelocity >() == NULL );
+			EXPECT_TRUE( pTag == NULL );
+			break;
+		}
+	}
+}
+
+TEST_F( ComponentQueryTest, CommandsSkipComponentsFreedInTheSameFrame )
+{
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	CreateEntities( PARALLEL_QUERY_ENTITY_COUNT );
+	for ( size_t entityIndex = 0; entityIndex < PARALLEL_QUERY_ENTITY_COUNT; ++entityIndex )
+	{
+		ASSERT_TRUE( AllocateComponent< QueryTestPosition >( entityIndex ) != NULL );
+		QueryTestVelocity *pVelocity = AllocateComponent< QueryTestVelocity >( entityIndex );
+		ASSERT_TRUE( pVelocity != NULL );
+		pVelocity->m_Velocity[ 0 ] = 0.0f;
+	}
+
+	Components::TypeId types[] =
+	{
+		Components::GetType< QueryTestPosition >(),
+		Components::GetType< QueryTestVelocity >()
+	};
+
+	// One match per batch, so the two frees of each velocity come from different batches. A freed velocity's slot is
+	// handed straight to the next allocation, so a free that ignored the recorded generation would release the
+	// replacement instead.
+	ParallelQueryTestData data = { m_spManager.Get(), m_Entities.GetData(), 0, 0, 0, 0 };
+	ParallelQueryComponentsInternal( *m_spManager, types, HELIUM_ARRAY_COUNT( types ), ReplaceVelocities, &data, 1 );
+
+	EXPECT_EQ( static_cast< int32_t >( PARALLEL_QUERY_ENTITY_COUNT ), data.m_VisitCount );
+	EXPECT_EQ( PARALLEL_QUERY_ENTITY_COUNT, m_spManager->CountAllocatedComponents< QueryTestVelocity >() );
+
+	for ( size_t entityIndex = 0; entityIndex < PARALLEL_QUERY_ENTITY_COUNT; ++entityIndex )
+	{
+		QueryTestVelocity *pVelocity = m_Entities[ entityIndex ].m_Components.GetFirst< QueryTestVelocity >();
+		ASSERT_TRUE( pVelocity != NULL ) << "Entity " << entityIndex << " lost its replacement velocity";
+		EXPECT_TRUE( pVelocity->GetNextComponent() == NULL );
+		EXPECT_EQ( static_cast< float32_t >( COMMAND_ALLOCATED_MARKER ), pVelocity->m_Velocity[ 0 ] );
+	}
+
+	// The cached query caught up with the replacements
+	CachedComponentQuery *pQuery = GetMovingQuery();
+	EXPECT_EQ( PARALLEL_QUERY_ENTITY_COUNT, pQuery->GetMatchCount() );
+}
@@ -1,9 +1,11 @@
 
 #include "Precompile.h"
 #include "Framework/Components.h"
+#include "Framework/ComponentQuery.h"
 #include "Framework/SystemDefinition.h"
 
 #include "Foundation/Numeric.h"
+#include "Platform/Locks.h"
 #include "Reflect/TranslatorDeduction.h"
 #include "Engine/Asset.h"
 
@@ -25,6 +27,9 @@ int32_t                    g_ComponentManagerInstanceCount = 0;
 DynamicArray<TypeData *>   g_ComponentTypes;
 ComponentPtrBase*          g_ComponentPtrRegistry[COMPONENT_PTR_CHECK_FREQUENCY];
 uint16_t                   g_ComponentProcessPendingDeletesCallCount = 0;
+Mutex                      g_ComponentPtrRegistryLock; // Only taken while g_ParallelUpdateCount is nonzero
+int32_t                    g_ParallelUpdateCount = 0;
+bool                       g_UseComponentArchetypes = false;
 
 ComponentRegistrar<Helium::Component, void> Helium::Component::s_ComponentRegistrar("Helium::Component");
 
@@ -34,6 +39,8 @@ void Components::Startup( SystemDefinition *pSystemDefinition )
 	{
 		if ( pSystemDefinition )
 		{
+			g_UseComponentArchetypes = pSystemDefinition->m_UseComponentArchetypes;
+
 			DynamicArray< ComponentTypeConfig > &rTypeConfigs = pSystemDefinition->m_ComponentTypeConfigs;
 			for (DynamicArray< ComponentTypeConfig >::Iterator configIter = rTypeConfigs.Begin(); 
 				configIter != rTypeConfigs.End(); ++configIter)
@@ -45,7 +52,12 @@ void Components::Startup( SystemDefinition *pSystemDefinition )
 					TypeData &rTypeData = **componentTypeIter;
 					if (rTypeData.m_Name == configIter->m_ComponentTypeName)
 					{
-						rTypeData.m_DefaultCount = configIter->m_PoolSize;
+						// -1 keeps the hard coded default
+						if ( IsValid( configIter->m_PoolSize ) )
+						{
+							rTypeData.m_DefaultCount = configIter->m_PoolSize;
+						}
+
 						found = true;
 						break;
 					}
@@ -83,6 +95,7 @@ void Components::Shutdown()
 		}
 
 		g_ComponentTypes.Clear();
+		g_UseComponentArchetypes = false;
 	}
 }
 
@@ -90,7 +103,7 @@ TypeId Components::RegisterType(
 	const Reflect::MetaStruct *pStructure, 
 	TypeData &rTypeData, 
 	TypeData *pBaseType, 
-	uint16_t defaultCount )
+	ComponentIndex defaultCount )
 {
 	// Some validation of parameters/state
 	HELIUM_ASSERT( pStructure );
@@ -166,12 +179,9 @@ Pool* Pool::CreatePool( ComponentManager *pComponentManager, const TypeData &rTy
 	HELIUM_ASSERT( componentSize );
 	componentSize = PAD_VALUE(componentSize, HELIUM_SIMD_ALIGNMENT);
 
-	size_t poolSize = PAD_VALUE( sizeof( Components::Pool ), HELIUM_SIMD_ALIGNMENT );
-	size_t memoryRequried = poolSize + componentSize * count;
-	Pool *pool = (Pool *)g_ComponentAllocator.AllocateAligned( POOL_ALIGN_SIZE, memoryRequried );
+	// Component memory is allocated a page at a time as the pool fills up, so only the bookkeeping is allocated here
+	Pool *pool = (Pool *)g_ComponentAllocator.AllocateAligned( POOL_ALIGN_SIZE, sizeof( Pool ) );
 	new(pool) Pool();
-	
-	pool->m_ParallelData = HELIUM_NEW_A( g_ComponentAllocator, DataParallel, count );
 
 	pool->m_World = pComponentManager->GetWorld();
 	pool->m_ComponentManager = pComponentManager;
@@ -179,40 +189,27 @@ Pool* Pool::CreatePool( ComponentManager *pComponentManager, const TypeData &rTy
 	pool->m_TypeId = rTypeData.m_TypeId;
 	pool->m_ComponentSize = componentSize;
 	pool->m_FirstUnallocatedIndex = 0;
+	pool->m_HighWaterMark = 0;
 	pool->m_ComponentOffset = rTypeData.GetOffsetOfComponent();
-		
-	pool->m_Roster.Resize( count );
 
-	for (uint16_t i = 0; i < count; ++i)
+	// Pages hold a power of two components: enough for the expected count, but no more than fit in the page size
+	ComponentIndex pageLimit = Max< ComponentIndex >( HELIUM_COMPONENT_POOL_PAGE_SIZE / componentSize, 1 );
+	ComponentIndex pageTarget = Max< ComponentIndex >( count, HELIUM_COMPONENT_POOL_MIN_PAGE_COUNT );
+	uint32_t pageShift = 0;
+	while ( pageShift < 30 && ( 2u << pageShift ) <= pageLimit && ( 1u << pageShift ) < pageTarget )
 	{
-		Component *component = pool->GetComponent( i );
-		pool->m_Roster[i] = component;
-
-		uintptr_t offset = (static_cast<uintptr_t>(reinterpret_cast<uintptr_t>(component) & POOL_ALIGN_SIZE_MASK) - reinterpret_cast<uintptr_t>(pool)) / HELIUM_COMPONENT_POOL_ALIGN_SIZE;
-		HELIUM_ASSERT(offset <= NumericLimits<uint16_t>::Maximum);
-		HELIUM_ASSERT(offset);
-		component->m_InlineData.m_OffsetToPoolStart = static_cast<uint16_t>(offset);
-			
-		component->m_InlineData.m_Owner = NULL;
-		component->m_InlineData.m_Next = Invalid<ComponentIndex>();
-		component->m_InlineData.m_Previous = Invalid<ComponentIndex>();
-		component->m_InlineData.m_Delete = false;
-		component->m_InlineData.m_Generation = 0;
-		pool->m_ParallelData[i].m_Collection = NULL;
-		pool->m_ParallelData[i].m_RosterIndex = i;
-
-		HELIUM_ASSERT( Pool::GetPool( component ) == pool );
-		HELIUM_ASSERT( Pool::GetPool( component )->GetComponentIndex( component ) == i );
-		HELIUM_ASSERT( Pool::GetPool( component )->GetComponent( i ) == component );
+		++pageShift;
 	}
 
+	pool->m_PageShift = pageShift;
+
 	HELIUM_TRACE(
 		TraceLevels::Debug,
-		"Components::Pool::CreatePool - [%5d] %s (%d bytes at %x)\n",
+		"Components::Pool::CreatePool - [%5" PRIu32 "] %s (%" PRIu32 " components of %" PRIu32 " bytes per page)\n",
 		count,
 		rTypeData.m_Structure->m_Name,
-		memoryRequried,
-		pool);
+		1u << pageShift,
+		static_cast< uint32_t >( componentSize ));
 
 	return pool;
 }
@@ -226,12 +223,84 @@ void Pool::DestroyPool( Pool *pPool )
 			pPool->m_Type->m_Structure->m_Name);
 	}
 
-	HELIUM_DELETE_A( g_ComponentAllocator, pPool->m_ParallelData );
+	HELIUM_TRACE(
+		TraceLevels::Debug,
+		"Components::Pool::DestroyPool - %s high water mark %" PRIu32 " of %" PRIu32 " (%" PRIuSZ " pages)\n",
+		pPool->m_Type->m_Structure->m_Name,
+		pPool->m_HighWaterMark,
+		pPool->GetCapacity(),
+		pPool->m_Pages.GetSize());
+
+	for (DynamicArray<PoolPage *>::Iterator iter = pPool->m_Pages.Begin();
+		iter != pPool->m_Pages.End(); ++iter)
+	{
+		g_ComponentAllocator.FreeAligned( *iter );
+	}
+
 	pPool->~Pool();
 	g_ComponentAllocator.FreeAligned( pPool );
 	
 }
 
+bool Pool::AddPage()
+{
+	ComponentIndex pageCount = static_cast<ComponentIndex>( 1 ) << m_PageShift;
+	ComponentIndex firstIndex = static_cast<ComponentIndex>( m_Roster.GetSize() );
+
+	// The invalid index terminates component chains, so it can never be handed out
+	if ( firstIndex > Invalid<ComponentIndex>() - pageCount )
+	{
+		return false;
+	}
+
+	size_t headerSize = PAD_VALUE( sizeof( PoolPage ), HELIUM_SIMD_ALIGNMENT );
+	size_t memoryRequried = headerSize + static_cast<size_t>( m_ComponentSize ) * pageCount;
+	PoolPage *page = (PoolPage *)g_ComponentAllocator.AllocateAligned( POOL_ALIGN_SIZE, memoryRequried );
+	if ( !page )
+	{
+		return false;
+	}
+
+	page->m_Pool = this;
+	page->m_FirstIndex = firstIndex;
+	m_Pages.Push( page );
+
+	m_Roster.Resize( firstIndex + pageCount );
+	m_ParallelData.Resize( firstIndex + pageCount );
+
+	for (ComponentIndex i = firstIndex; i < firstIndex + pageCount; ++i)
+	{
+		Component *component = GetComponent( i );
+		m_Roster[i] = component;
+
+		uintptr_t offset = (static_cast<uintptr_t>(reinterpret_cast<uintptr_t>(component) & POOL_ALIGN_SIZE_MASK) - reinterpret_cast<uintptr_t>(page)) / HELIUM_COMPONENT_POOL_ALIGN_SIZE;
+		HELIUM_ASSERT(offset <= NumericLimits<uint16_t>::Maximum);
+		HELIUM_ASSERT(offset);
+		component->m_InlineData.m_OffsetToPageStart = static_cast<uint16_t>(offset);
+			
+		component->m_InlineData.m_Owner = NULL;
+		component->m_InlineData.m_Next = Invalid<ComponentIndex>();
+		component->m_InlineData.m_Previous = Invalid<ComponentIndex>();
+		component->m_InlineData.m_Delete = false;
+		component->m_InlineData.m_Generation = 0;
+		m_ParallelData[i].m_Collection = NULL;
+		m_ParallelData[i].m_RosterIndex = i;
+
+		HELIUM_ASSERT( Pool::GetPool( component ) == this );
+		HELIUM_ASSERT( GetComponentIndex( component ) == i );
+	}
+
+	HELIUM_TRACE(
+		TraceLevels::Debug,
+		"Components::Pool::AddPage - %s grew to %" PRIu32 " components (%" PRIuSZ " bytes at %p)\n",
+		m_Type->m_Structure->m_Name,
+		GetCapacity(),
+		memoryRequried,
+		page);
+
+	return true;
+}
+
 void Pool::InsertIntoChain(Component *_insertee, ComponentIndex _insertee_index, Component *nextComponent)
 {
 	// If we are inserting into a 0-length chain do nothing
@@ -245,7 +314,7 @@ void Pool::InsertIntoChain(Component *_insertee, ComponentIndex _insertee_index,
 		_insertee->m_InlineData.m_Previous = previous_index;
 
 		// Fix previous component's next pointer
-		if (previous_index != Invalid<uint16_t>())
+		if (previous_index != Invalid<ComponentIndex>())
 		{
 			GetComponent( previous_index )->m_InlineData.m_Next = _insertee_index;
 		}
@@ -273,7 +342,7 @@ void Pool::RemoveFromChain(Component *_component, ComponentIndex index)
 	{
 		GetComponent( previous_index )->m_InlineData.m_Next = _component->m_InlineData.m_Next;
 	}
-	else if ( _component->m_InlineData.m_Next != Invalid<uint16_t>() )
+	else if ( _component->m_InlineData.m_Next != Invalid<ComponentIndex>() )
 	{
 		//m_ParallelData[ index ].m_Collection->m_Components[m_TypeId] = GetComponent( _component->m_InlineData.m_Next );
 		m_ParallelData[ index ].m_Collection->m_Components[m_TypeId] = pNextComponent;
@@ -284,24 +353,24 @@ void Pool::RemoveFromChain(Component *_component, ComponentIndex index)
 	}
 
 	// If we have a next node, repoint its previous pointer to our previous pointer
-	if ( _component->m_InlineData.m_Next != Invalid<uint16_t>() )
+	if ( _component->m_InlineData.m_Next != Invalid<ComponentIndex>() )
 	{
 		//m_ParallelData[ _component->m_InlineData.m_Next ].m_Previous = m_ParallelData[ index ].m_Previous;
 		pNextComponent->m_InlineData.m_Previous = _component->m_InlineData.m_Previous;
 	}
 
 	// wipe our node
-	_component->m_InlineData.m_Next = Invalid<uint16_t>();
-	//m_ParallelData[ index ].m_Previous = Invalid<uint16_t>();
-	_component->m_InlineData.m_Previous = Invalid<uint16_t>();
+	_component->m_InlineData.m_Next = Invalid<ComponentIndex>();
+	//m_ParallelData[ index ].m_Previous = Invalid<ComponentIndex>();
+	_component->m_InlineData.m_Previous = Invalid<ComponentIndex>();
 }
 
 Component* Pool::Allocate( IHasComponents *owner, ComponentCollection &collection )
 {
 	// Null owner is allowed
 
-	// Do we have a free component to allocate?
-	if (m_FirstUnallocatedIndex >= m_Roster.GetSize())
+	// Do we have a free component to allocate? If not, grow by a page
+	if (m_FirstUnallocatedIndex >= m_Roster.GetSize() && !AddPage())
 	{
 		// Could not allocate the component because we ran out..
 		HELIUM_ASSERT_MSG( false, "Could not allocate component of type %s for host %x. No free instances are available. Maximum instances: %d", 
@@ -313,6 +382,10 @@ Component* Pool::Allocate( IHasComponents *owner, ComponentCollection &collectio
 
 	// Find out where the component we should allocate is in the roster
 	ComponentIndex roster_index = m_FirstUnallocatedIndex++;
+	if (m_FirstUnallocatedIndex > m_HighWaterMark)
+	{
+		m_HighWaterMark = m_FirstUnallocatedIndex;
+	}
 	
 	Component *component = m_Roster[roster_index];
 	ComponentIndex component_index = GetComponentIndex( component );
@@ -334,8 +407,10 @@ Component* Pool::Allocate( IHasComponents *owner, ComponentCollection &collectio
 
 	m_ParallelData[ component_index ].m_Collection = &collection;
 
+	m_ComponentManager->OnCollectionChanged( m_TypeId, collection );
+
 	m_Type->Construct( component );
-	HELIUM_ASSERT( component->m_InlineData.m_OffsetToPoolStart);
+	HELIUM_ASSERT( component->m_InlineData.m_OffsetToPageStart );
 
 	return component;
 }
@@ -346,9 +421,12 @@ void Pool::Free( Component *component )
 	
 	// Component is already freed or component doesn't have a good handle for some reason
 	HELIUM_ASSERT( m_ParallelData[ index ].m_Collection );
+	ComponentCollection *pCollection = m_ParallelData[ index ].m_Collection;
 
 	m_Type->Destruct( component );
 	RemoveFromChain( component, index );
+
+	m_ComponentManager->OnCollectionChanged( m_TypeId, *pCollection );
 	
 	// Increment generation to invalidate old handles
 	++component->m_InlineData.m_Generation;
@@ -408,8 +486,22 @@ void Helium::Components::Pool::SpewRosterToTty()
 }
 #endif
 
+size_t Archetype::FindColumn( TypeId type ) const
+{
+	for (size_t i = 0; i < m_Types.GetSize(); ++i)
+	{
+		if (m_Types[i] == type)
+		{
+			return i;
+		}
+	}
+
+	return Invalid<size_t>();
+}
+
 Helium::ComponentManager::ComponentManager(World *pWorld)
 	: m_World(pWorld)
+	, m_UseArchetypes(false)
 {
 	for (DynamicArray<TypeData *>::Iterator iter = g_ComponentTypes.Begin();
 		iter != g_ComponentTypes.End(); ++iter)
@@ -418,12 +510,28 @@ Helium::ComponentManager::ComponentManager(World *pWorld)
 
 		m_Pools.New( Pool::CreatePool( this, type_data, type_data.m_DefaultCount ) );
 	}
+
+	m_QueriesByType.Resize( m_Pools.GetSize() );
+
+	SetArchetypeStorageEnabled( g_UseComponentArchetypes );
 }
 
 Helium::ComponentManager::~ComponentManager()
 {
 	Tick(); // Process pending deletes if necessary
 
+	for (DynamicArray<CachedComponentQuery *>::Iterator iter = m_Queries.Begin();
+		iter != m_Queries.End(); ++iter)
+	{
+		delete *iter;
+	}
+
+	m_Queries.Clear();
+	m_QueriesByType.Clear();
+
+	// Archetype rows point at collections through the pools, so tear them down before the pools go away
+	SetArchetypeStorageEnabled( false );
+
 	for (DynamicArray<Pool *>::Iterator iter = m_Pools.Begin();
 		iter != m_Pools.End(); ++iter)
 	{
@@ -445,8 +553,298 @@ Helium::ComponentManager::~ComponentManager()
 	m_Pools.Clear();
 }
 
+void Helium::ComponentManager::SetArchetypeStorageEnabled( bool enabled )
+{
+	if ( enabled == m_UseArchetypes )
+	{
+		return;
+	}
+
+	MutexScopeLock scopeLock( m_QueriesLock );
+
+	m_UseArchetypes = enabled;
+
+	if ( enabled )
+	{
+		// Sort every collection that already has components into its archetype
+		for (DynamicArray<Pool *>::Iterator iter = m_Pools.Begin();
+			iter != m_Pools.End(); ++iter)
+		{
+			Pool *pPool = *iter;
+			if ( !pPool )
+			{
+				continue;
+			}
+
+			for (ComponentIndex i = 0; i < pPool->GetAllocatedCount(); ++i)
+			{
+				ComponentCollection *pCollection = pPool->GetComponentCollection( pPool->GetComponentByRosterIndex( i ) );
+				HELIUM_ASSERT( pCollection );
+
+				if ( !pCollection->m_Archetype )
+				{
+					UpdateArchetype( *pCollection );
+				}
+			}
+		}
+	}
+	else
+	{
+		for (DynamicArray<Archetype *>::Iterator iter = m_Archetypes.Begin();
+			iter != m_Archetypes.End(); ++iter)
+		{
+			Archetype *pArchetype = *iter;
+			for (size_t row = 0; row < pArchetype->GetRowCount(); ++row)
+			{
+				pArchetype->m_Collections[row]->m_Archetype = NULL;
+				pArchetype->m_Collections[row]->m_ArchetypeRow = Invalid<size_t>();
+			}
+
+			delete pArchetype;
+		}
+
+		m_Archetypes.Clear();
+	}
+
+	// Queries switch between walking archetypes and keeping their own match lists
+	for (DynamicArray<CachedComponentQuery *>::Iterator iter = m_Queries.Begin();
+		iter != m_Queries.End(); ++iter)
+	{
+		(*iter)->Rebuild();
+	}
+}
+
+CachedComponentQuery* Helium::ComponentManager::GetCachedQuery( const TypeId *types, size_t typesCount )
+{
+	HELIUM_ASSERT( typesCount );
+
+	// Tasks for the same world may run in parallel, so guard creation of new queries
+	MutexScopeLock scopeLock( m_QueriesLock );
+
+	for (DynamicArray<CachedComponentQuery *>::Iterator iter = m_Queries.Begin();
+		iter != m_Queries.End(); ++iter)
+	{
+		if ( (*iter)->Matches( types, typesCount ) )
+		{
+			return *iter;
+		}
+	}
+
+	CachedComponentQuery *pQuery = new CachedComponentQuery( *this, types, typesCount );
+	m_Queries.Push( pQuery );
+
+	// Register with every type that can change the query's matches
+	const DynamicArray<TypeId> &slotTypes = pQuery->GetSlotTypes();
+	for (DynamicArray<TypeId>::ConstIterator iter = slotTypes.Begin();
+		iter != slotTypes.End(); ++iter)
+	{
+		DynamicArray<CachedComponentQuery *> &typeQueries = m_QueriesByType[ *iter ];
+		if ( typeQueries.IsEmpty() || typeQueries.GetLast() != pQuery )
+		{
+			typeQueries.Push( pQuery );
+		}
+	}
+
+	pQuery->Rebuild();
+
+	return pQuery;
+}
+
+void Helium::ComponentManager::OnCollectionChanged( TypeId type, ComponentCollection &rCollection )
+{
+	// Another task on this world may be creating a query (see GetCachedQuery)
+	MutexScopeLock scopeLock( m_QueriesLock );
+
+	// Cached queries walk archetype rows directly, so keeping the rows current is enough
+	if ( m_UseArchetypes )
+	{
+		UpdateArchetype( rCollection );
+		return;
+	}
+
+	DynamicArray<CachedComponentQuery *> &typeQueries = m_QueriesByType[ type ];
+	for (DynamicArray<CachedComponentQuery *>::Iterator iter = typeQueries.Begin();
+		iter != typeQueries.End(); ++iter)
+	{
+		(*iter)->UpdateCollection( rCollection );
+	}
+}
+
+void Helium::ComponentManager::UpdateArchetype( ComponentCollection &rCollection )
+{
+	HELIUM_ASSERT( m_UseArchetypes );
+
+	const Map<TypeId, Component *> &rComponents = rCollection.m_Components;
+	Archetype *pArchetype = rCollection.m_Archetype;
+
+	// If the set of types changed, the collection moves to a different archetype
+	if ( pArchetype )
+	{
+		bool signatureMatches = ( pArchetype->m_Types.GetSize() == rComponents.GetSize() );
+		for (Map<TypeId, Component *>::ConstIterator iter = rComponents.Begin();
+			signatureMatches && iter != rComponents.End(); ++iter)
+		{
+			signatureMatches = IsValid( pArchetype->FindColumn( iter->First() ) );
+		}
+
+		if ( !signatureMatches )
+		{
+			RemoveFromArchetype( rCollection );
+			pArchetype = NULL;
+		}
+	}
+
+	if ( !pArchetype )
+	{
+		if ( rComponents.IsEmpty() )
+		{
+			return;
+		}
+
+		pArchetype = FindOrCreateArchetype( rComponents );
+		rCollection.m_Archetype = pArchetype;
+		rCollection.m_ArchetypeRow = pArchetype->GetRowCount();
+		pArchetype->m_Collections.Push( &rCollection );
+
+		for (size_t column = 0; column < pArchetype->m_Columns.GetSize(); ++column)
+		{
+			pArchetype->m_Columns[column].Push( NULL );
+		}
+	}
+
+	// Chain heads change whenever a component of an existing type is added or removed, so refresh the whole row
+	for (Map<TypeId, Component *>::ConstIterator iter = rComponents.Begin();
+		iter != rComponents.End(); ++iter)
+	{
+		size_t column = pArchetype->FindColumn( iter->First() );
+		HELIUM_ASSERT( IsValid( column ) );
+		pArchetype->m_Columns[column][rCollection.m_ArchetypeRow] = iter->Second();
+	}
+}
+
+void Helium::ComponentManager::RemoveFromArchetype( ComponentCollection &rCollection )
+{
+	Archetype *pArchetype = rCollection.m_Archetype;
+	HELIUM_ASSERT( pArchetype );
+
+	size_t row = rCollection.m_ArchetypeRow;
+	HELIUM_ASSERT( row < pArchetype->GetRowCount() );
+	HELIUM_ASSERT( pArchetype->m_Collections[row] == &rCollection );
+
+	// Swap the last row into the vacated slot so the columns stay dense
+	pArchetype->m_Collections.RemoveSwap( row );
+	for (size_t column = 0; column < pArchetype->m_Columns.GetSize(); ++column)
+	{
+		pArchetype->m_Columns[column].RemoveSwap( row );
+	}
+
+	if ( row < pArchetype->GetRowCount() )
+	{
+		pArchetype->m_Collections[row]->m_ArchetypeRow = row;
+	}
+
+	rCollection.m_Archetype = NULL;
+	rCollection.m_ArchetypeRow = Invalid<size_t>();
+}
+
+Archetype* Helium::ComponentManager::FindOrCreateArchetype( const Map< TypeId, Component * > &rComponents )
+{
+	for (DynamicArray<Archetype *>::Iterator archetypeIter = m_Archetypes.Begin();
+		archetypeIter != m_Archetypes.End(); ++archetypeIter)
+	{
+		Archetype *pArchetype = *archetypeIter;
+		if ( pArchetype->m_Types.GetSize() != rComponents.GetSize() )
+		{
+			continue;
+		}
+
+		bool signatureMatches = true;
+		for (Map<TypeId, Component *>::ConstIterator iter = rComponents.Begin();
+			signatureMatches && iter != rComponents.End(); ++iter)
+		{
+			signatureMatches = IsValid( pArchetype->FindColumn( iter->First() ) );
+		}
+
+		if ( signatureMatches )
+		{
+			return pArchetype;
+		}
+	}
+
+	Archetype *pArchetype = new Archetype();
+	for (Map<TypeId, Component *>::ConstIterator iter = rComponents.Begin();
+		iter != rComponents.End(); ++iter)
+	{
+		// Insertion sort; signatures only hold a handful of types
+		TypeId type = iter->First();
+		size_t index = pArchetype->m_Types.GetSize();
+		pArchetype->m_Types.Push( type );
+		while ( index > 0 && pArchetype->m_Types[index - 1] > type )
+		{
+			pArchetype->m_Types[index] = pArchetype->m_Types[index - 1];
+			--index;
+		}
+		pArchetype->m_Types[index] = type;
+	}
+
+	pArchetype->m_Columns.Resize( pArchetype->m_Types.GetSize() );
+	m_Archetypes.Push( pArchetype );
+
+	// Callers hold m_QueriesLock
+	for (DynamicArray<CachedComponentQuery *>::Iterator iter = m_Queries.Begin();
+		iter != m_Queries.End(); ++iter)
+	{
+		(*iter)->OnArchetypeCreated( *pArchetype );
+	}
+
+	return pArchetype;
+}
+
+namespace
+{
+	// Locks the component pointer registry if it may be touched from several threads at once. Serial updates (the
+	// common case) skip the lock entirely.
+	class ComponentPtrRegistryScopeLock
+	{
+	public:
+		ComponentPtrRegistryScopeLock()
+			: m_bLocked( g_ParallelUpdateCount != 0 )
+		{
+			if ( m_bLocked )
+			{
+				g_ComponentPtrRegistryLock.Lock();
+			}
+		}
+
+		~ComponentPtrRegistryScopeLock()
+		{
+			if ( m_bLocked )
+			{
+				g_ComponentPtrRegistryLock.Unlock();
+			}
+		}
+
+	private:
+		bool m_bLocked;
+	};
+}
+
+void Helium::Components::BeginParallelUpdate()
+{
+	// Only called from the updating thread before any parallel work is spawned
+	++g_ParallelUpdateCount;
+}
+
+void Helium::Components::EndParallelUpdate()
+{
+	HELIUM_ASSERT( g_ParallelUpdateCount > 0 );
+	--g_ParallelUpdateCount;
+}
+
 void Helium::Components::Tick()
 {
+	HELIUM_ASSERT( !g_ParallelUpdateCount );
+
 	++g_ComponentProcessPendingDeletesCallCount;
 
 	// Look at our registry of component ptrs, we may need to force some of them to invalidate (a ptr must be checked
@@ -475,6 +873,8 @@ void Helium::Components::Tick()
 
 void Helium::ComponentManager::RegisterComponentPtr( ComponentPtrBase &pPtr )
 {
+	ComponentPtrRegistryScopeLock scopeLock;
+
 	uint16_t registry_index = g_ComponentProcessPendingDeletesCallCount % COMPONENT_PTR_CHECK_FREQUENCY;
 	pPtr.m_Next = g_ComponentPtrRegistry[registry_index];
 	
@@ -506,6 +906,8 @@ size_t Helium::ComponentManager::CountAllocatedComponentsThatImplement( Componen
 
 void Helium::ComponentPtrBase::Unlink() const
 {
+	ComponentPtrRegistryScopeLock scopeLock;
+
 	// If we are the head node in the component ptr registry, we need to point it to the new head
 	if (m_ComponentPtrRegistryHeadIndex != Helium::Invalid<uint16_t>())
 	{
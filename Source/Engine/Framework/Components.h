@@ -7,6 +7,7 @@
 #include "Reflect/Object.h"
 #include "Foundation/Map.h"
 #include "Foundation/SmartPtr.h"
+#include "Platform/Locks.h"
 #include "Framework/Framework.h"
 
 
@@ -57,6 +58,8 @@
 
 #define HELIUM_COMPONENT_PTR_CHECK_FREQUENCY (256)
 #define HELIUM_COMPONENT_POOL_ALIGN_SIZE (32)
+#define HELIUM_COMPONENT_POOL_PAGE_SIZE (64 * 1024)    // Soft cap on the bytes of components in one pool page
+#define HELIUM_COMPONENT_POOL_MIN_PAGE_COUNT (16)      // Fewest components per page, so tiny pools don't grow one at a time
 #define HELIUM_COMPONENT_POOL_ALIGN_SIZE_MASK (~(POOL_ALIGN_SIZE-1))
 
 namespace Helium
@@ -67,6 +70,7 @@ namespace Helium
 	class World;
 	class ComponentPtrBase;
 	class SystemDefinition;
+	class CachedComponentQuery;
 
 	namespace Components
 	{
@@ -87,9 +91,9 @@ namespace Helium
 	{
 		//! Component type id (not the same as the reflect class id).
 		typedef uint16_t TypeId;
-		typedef uint16_t ComponentIndex;
+		typedef uint32_t ComponentIndex;
 		typedef uint16_t ComponentSizeType;
-		typedef uint8_t GenerationIndex;
+		typedef uint16_t GenerationIndex;
 
 		const static uint32_t COMPONENT_PTR_CHECK_FREQUENCY = 256;
 		const static uintptr_t POOL_ALIGN_SIZE = 32;
@@ -110,7 +114,7 @@ namespace Helium
 			const Reflect::MetaStruct* m_Structure;
 			DynamicArray<TypeId>       m_ImplementedTypes;       //< Parent type IDs of this type
 			DynamicArray<TypeId>       m_ImplementingTypes;      //< Child types IDs of this type
-			ComponentIndex             m_DefaultCount;           //< Default number of components of this type to make
+			ComponentIndex             m_DefaultCount;           //< Expected number of components of this type, used to size pool pages (0 means no pool)
 
 			virtual void       Construct(Component *ptr) const = 0;
 			virtual void       Destruct(Component *ptr) const = 0;
@@ -155,7 +159,7 @@ namespace Helium
 		struct HELIUM_FRAMEWORK_API DataInline
 		{
 			IHasComponents*  m_Owner;
-			uint16_t         m_OffsetToPoolStart;
+			uint16_t         m_OffsetToPageStart;
 			ComponentIndex   m_Next;
 			ComponentIndex   m_Previous;
 			GenerationIndex  m_Generation;
@@ -168,12 +172,21 @@ namespace Helium
 			ComponentIndex        m_RosterIndex;
 		};
 		
+		//! Header at the start of every block of components owned by a pool. Pages are never moved or freed until the pool
+		//! is destroyed, so component addresses stay stable as the pool grows.
+		struct HELIUM_FRAMEWORK_API PoolPage
+		{
+			Pool*                      m_Pool;
+			ComponentIndex             m_FirstIndex;
+		};
+
 		struct HELIUM_FRAMEWORK_API Pool
 		{
 		public:
 			static Pool*               CreatePool( ComponentManager *pComponentManager, const TypeData &rTypeData, ComponentIndex count );
 			static void                DestroyPool( Pool *pPool );
 			static inline Pool*        GetPool( const Component *component );
+			static inline PoolPage*    GetPage( const Component *component );
 									   
 			inline TypeId              GetTypeId() const;
 			inline ComponentManager*   GetComponentManager() const;
@@ -197,6 +210,12 @@ namespace Helium
 			inline Component * const * GetAllocatedComponents() const;
 			inline Component *         GetComponentByRosterIndex(ComponentIndex index) const;
 
+			// Growth stats, for tuning ComponentTypeConfig::m_PoolSize
+			inline ComponentIndex      GetCapacity() const;
+			inline size_t              GetPageCount() const;
+			inline ComponentIndex      GetHighWaterMark() const;
+			inline void                ResetHighWaterMark();
+
 			Component*                 Allocate(Components::IHasComponents *owner, ComponentCollection &collection);
 			void                       Free(Component *component);
 			void                       InsertIntoChain(Component *_insertee, ComponentIndex _insertee_index, Component *nextComponent);
@@ -208,28 +227,51 @@ namespace Helium
 
 		private:
 
-			inline uintptr_t           GetFirstComponentPtr() const;
+			bool                       AddPage();
+			inline uintptr_t           GetFirstComponentPtr( const PoolPage *page ) const;
 									   
-			DynamicArray<Component *>  m_Roster;
-			DataParallel*              m_ParallelData;
+			DynamicArray<Component *>  m_Roster;          //< Reallocated as the pool grows; don't hold on to GetAllocatedComponents()
+			DynamicArray<DataParallel> m_ParallelData;
+			DynamicArray<PoolPage *>   m_Pages;
 			World*                     m_World;
 			ComponentManager*          m_ComponentManager;
 			const TypeData*            m_Type;
 			uintptr_t                  m_ComponentOffset;
 			TypeId                     m_TypeId;
 			ComponentSizeType          m_ComponentSize;
+			uint32_t                   m_PageShift;       //< Components per page is always 1 << m_PageShift
 			ComponentIndex             m_FirstUnallocatedIndex;
+			ComponentIndex             m_HighWaterMark;
+		};
+
+		//! Group of component collections that all hold exactly the same set of component types. Components stay in
+		//! their pools (so addresses and ComponentPtr generation checks are unaffected), but the head of each type's
+		//! chain is kept in one contiguous column per type so queries can stream through rows without a map lookup
+		//! per collection.
+		struct HELIUM_FRAMEWORK_API Archetype
+		{
+			DynamicArray<TypeId>                       m_Types;        //< Component types held by every row, sorted
+			DynamicArray<ComponentCollection *>        m_Collections;  //< Collection owning each row
+			DynamicArray< DynamicArray<Component *> >  m_Columns;      //< First component of each type per row, parallel to m_Types
+
+			inline size_t              GetRowCount() const;
+			size_t                     FindColumn( TypeId type ) const;
 		};
 		
 		HELIUM_FRAMEWORK_API void                Startup( SystemDefinition *pSystemDefinition );
 		HELIUM_FRAMEWORK_API void                Shutdown();
 		HELIUM_FRAMEWORK_API void                Tick();
+
+		//! Bracket work that assigns or releases ComponentPtrs on several threads at once (worlds or tasks updating in
+		//! parallel). The component pointer registry is shared by every world and is only locked while this is active.
+		HELIUM_FRAMEWORK_API void                BeginParallelUpdate();
+		HELIUM_FRAMEWORK_API void                EndParallelUpdate();
 		
 		HELIUM_FRAMEWORK_API TypeId              RegisterType(
 			const Reflect::MetaStruct *_structure, 
 			TypeData&                 _type_data, 
 			TypeData*                 _base_type_data, 
-			uint16_t                  _count);
+			ComponentIndex            _count);
 		HELIUM_FRAMEWORK_API const TypeData*     GetTypeData( TypeId type );
 
 		HELIUM_FRAMEWORK_API ComponentManagerPtr   CreateManager( World *pWorld );
@@ -254,12 +296,33 @@ namespace Helium
 		template < class T > size_t    CountAllocatedComponents();
 		template < class T > size_t    CountAllocatedComponentsThatImplement();
 
+		// Archetype storage groups collections by component signature so multi-type queries avoid per-collection lookups
+		void                     SetArchetypeStorageEnabled( bool enabled );
+		inline bool              IsArchetypeStorageEnabled() const;
+		inline const DynamicArray<Components::Archetype *> &GetArchetypes() const;
+
+		// Cached queries are created on first use and kept up to date as components are allocated and freed
+		CachedComponentQuery*    GetCachedQuery( const Components::TypeId *types, size_t typesCount );
+		inline const DynamicArray<CachedComponentQuery *> &GetCachedQueries() const;
+
 	private:
 		friend ComponentManagerPtr Helium::Components::CreateManager( World *pWorld );
+		friend Components::Pool;
 		ComponentManager(World *pWorld);
 
+		void                     OnCollectionChanged( Components::TypeId type, ComponentCollection &rCollection );
+		void                     UpdateArchetype( ComponentCollection &rCollection );
+		void                     RemoveFromArchetype( ComponentCollection &rCollection );
+		Components::Archetype*   FindOrCreateArchetype( const Map< Components::TypeId, Component * > &rComponents );
+
 		World *m_World;
 		DynamicArray<Components::Pool *> m_Pools;
+		DynamicArray<Components::Archetype *> m_Archetypes;
+		bool m_UseArchetypes;
+
+		DynamicArray<CachedComponentQuery *> m_Queries;
+		DynamicArray< DynamicArray<CachedComponentQuery *> > m_QueriesByType; // Queries to update when a type is allocated or freed
+		Mutex m_QueriesLock;
 	};
 
 
@@ -336,7 +399,10 @@ namespace Helium
 
 	private:
 		friend Components::Pool;
+		friend ComponentManager;
 		Map< Components::TypeId, Component * > m_Components;
+		Components::Archetype *m_Archetype;    // Only set when the owning manager uses archetype storage
+		size_t m_ArchetypeRow;
 	};
 
 	//! All components have some data for bookkeeping
@@ -41,7 +41,7 @@ namespace Helium
 		}
 
 		template< class ClassT, class BaseT >
-		ComponentRegistrar<ClassT, BaseT>::ComponentRegistrar( const char* name, uint16_t _count ) 
+		ComponentRegistrar<ClassT, BaseT>::ComponentRegistrar( const char* name, ComponentIndex _count ) 
 			: Reflect::MetaStructRegistrar<ClassT, BaseT>(name)
 			, m_Count(_count)
 		{
@@ -86,10 +86,15 @@ namespace Helium
 
 		Pool* Pool::GetPool( const Component *component )
 		{
-			HELIUM_ASSERT( component->m_InlineData.m_OffsetToPoolStart );
-			return reinterpret_cast<Pool *>( 
+			return GetPage( component )->m_Pool;
+		}
+
+		PoolPage* Pool::GetPage( const Component *component )
+		{
+			HELIUM_ASSERT( component->m_InlineData.m_OffsetToPageStart );
+			return reinterpret_cast<PoolPage *>( 
 				( reinterpret_cast<uintptr_t>(component) & POOL_ALIGN_SIZE_MASK ) - 
-				( static_cast<uintptr_t>( component->m_InlineData.m_OffsetToPoolStart ) * HELIUM_COMPONENT_POOL_ALIGN_SIZE ) );
+				( static_cast<uintptr_t>( component->m_InlineData.m_OffsetToPageStart ) * HELIUM_COMPONENT_POOL_ALIGN_SIZE ) );
 		}
 		
 		TypeId Pool::GetTypeId() const
@@ -111,7 +116,9 @@ namespace Helium
 		{
 			if ( IsValid<ComponentIndex>( index ) )
 			{
-				return reinterpret_cast<Component *>( GetFirstComponentPtr() + index * m_ComponentSize );
+				const PoolPage *page = m_Pages[ index >> m_PageShift ];
+				ComponentIndex indexInPage = index & ( ( static_cast<ComponentIndex>( 1 ) << m_PageShift ) - 1 );
+				return reinterpret_cast<Component *>( GetFirstComponentPtr( page ) + indexInPage * m_ComponentSize );
 			}
 
 			return NULL;
@@ -119,7 +126,8 @@ namespace Helium
 
 		ComponentIndex Pool::GetComponentIndex( const Component *component ) const
 		{
-			return static_cast<ComponentIndex>( ( reinterpret_cast<uintptr_t>( component ) - GetFirstComponentPtr() ) / static_cast<uintptr_t>(m_ComponentSize) );
+			const PoolPage *page = GetPage( component );
+			return page->m_FirstIndex + static_cast<ComponentIndex>( ( reinterpret_cast<uintptr_t>( component ) - GetFirstComponentPtr( page ) ) / static_cast<uintptr_t>(m_ComponentSize) );
 		}
 		
 		ComponentCollection* Pool::GetComponentCollection( const Component *component ) const
@@ -197,10 +205,30 @@ namespace Helium
 			return m_Roster[index];
 		}
 				
-		uintptr_t Pool::GetFirstComponentPtr() const
+		ComponentIndex Pool::GetCapacity() const
+		{
+			return static_cast<ComponentIndex>( m_Roster.GetSize() );
+		}
+
+		size_t Pool::GetPageCount() const
+		{
+			return m_Pages.GetSize();
+		}
+
+		ComponentIndex Pool::GetHighWaterMark() const
 		{
-			static const uintptr_t POOL_SIZE = (  (sizeof(Pool) + (HELIUM_SIMD_ALIGNMENT-1))  &  (~(HELIUM_SIMD_ALIGNMENT-1))  );
-			return reinterpret_cast<uintptr_t>(this) + POOL_SIZE + m_ComponentOffset;
+			return m_HighWaterMark;
+		}
+
+		void Pool::ResetHighWaterMark()
+		{
+			m_HighWaterMark = m_FirstUnallocatedIndex;
+		}
+
+		uintptr_t Pool::GetFirstComponentPtr( const PoolPage *page ) const
+		{
+			static const uintptr_t PAGE_HEADER_SIZE = (  (sizeof(PoolPage) + (HELIUM_SIMD_ALIGNMENT-1))  &  (~(HELIUM_SIMD_ALIGNMENT-1))  );
+			return reinterpret_cast<uintptr_t>(page) + PAGE_HEADER_SIZE + m_ComponentOffset;
 		}
 				
 		template <class T>
@@ -374,7 +402,29 @@ namespace Helium
 		return m_Pools[ typeId ];
 	}
 	
+	size_t Components::Archetype::GetRowCount() const
+	{
+		return m_Collections.GetSize();
+	}
+
+	bool ComponentManager::IsArchetypeStorageEnabled() const
+	{
+		return m_UseArchetypes;
+	}
+
+	const DynamicArray<Components::Archetype *> & ComponentManager::GetArchetypes() const
+	{
+		return m_Archetypes;
+	}
+
+	const DynamicArray<CachedComponentQuery *> & ComponentManager::GetCachedQueries() const
+	{
+		return m_Queries;
+	}
+	
 	Helium::ComponentCollection::ComponentCollection()
+		: m_Archetype( NULL )
+		, m_ArchetypeRow( Invalid<size_t>() )
 	{
 
 	}
@@ -0,0 +1,262 @@
+#include "Framework/Components.h"
+
+#include "Reflect/Registry.h"
+
+#include "gtest/gtest.h"
+
+using namespace Helium;
+
+namespace
+{
+	/// Number of components allocated by the growth tests (many times the default pool size).
+	const size_t POOL_TEST_COMPONENT_COUNT = 1000;
+	/// Number of owners the test components are spread across.
+	const size_t POOL_TEST_OWNER_COUNT = 10;
+
+	struct PoolTestComponent : public Component
+	{
+		HELIUM_DECLARE_COMPONENT( PoolTestComponent, Helium::Component );
+		static void PopulateMetaType( Reflect::MetaStruct& comp ) { }
+
+		uint32_t m_Value;
+	};
+
+	HELIUM_DEFINE_COMPONENT( PoolTestComponent, 16 );
+
+	/// Minimal component owner standing in for an entity.
+	struct PoolTestOwner : public Components::IHasComponents
+	{
+		ComponentManager *m_pManager;
+		ComponentCollection m_Components;
+
+		PoolTestOwner()
+			: m_pManager( NULL )
+		{
+		}
+
+		virtual ComponentManager* VirtualGetComponentManager() { return m_pManager; }
+		virtual ComponentCollection& VirtualGetComponents() { return m_Components; }
+	};
+
+	class ComponentPoolTest : public testing::Test
+	{
+	protected:
+		ComponentManagerPtr m_spManager;
+		PoolTestOwner m_Owners[ POOL_TEST_OWNER_COUNT ];
+		DynamicArray< PoolTestComponent * > m_Components;
+
+		static void SetUpTestCase()
+		{
+			Reflect::Startup();
+			Components::Startup( NULL );
+		}
+
+		static void TearDownTestCase()
+		{
+			Components::Shutdown();
+			Reflect::Shutdown();
+		}
+
+		void SetUp()
+		{
+			m_spManager = Components::CreateManager( NULL );
+			for ( size_t ownerIndex = 0; ownerIndex < POOL_TEST_OWNER_COUNT; ++ownerIndex )
+			{
+				m_Owners[ ownerIndex ].m_pManager = m_spManager.Get();
+			}
+		}
+
+		void TearDown()
+		{
+			// Collections free their components, so they must be emptied before the manager goes
+			for ( size_t ownerIndex = 0; ownerIndex < POOL_TEST_OWNER_COUNT; ++ownerIndex )
+			{
+				m_Owners[ ownerIndex ].m_Components.ReleaseAll();
+			}
+
+			m_Components.Clear();
+			m_spManager.Reset();
+		}
+
+		const Components::Pool *GetPool()
+		{
+			return m_spManager->GetPool( Components::GetType< PoolTestComponent >() );
+		}
+
+		PoolTestComponent *AllocateComponent( uint32_t value )
+		{
+			PoolTestOwner &rOwner = m_Owners[ value % POOL_TEST_OWNER_COUNT ];
+			PoolTestComponent *pComponent = m_spManager->Allocate< PoolTestComponent >( &rOwner, rOwner.m_Components );
+			HELIUM_ASSERT( pComponent );
+			pComponent->m_Value = value;
+
+			return pComponent;
+		}
+
+		void AllocateComponents( size_t count )
+		{
+			for ( size_t componentIndex = 0; componentIndex < count; ++componentIndex )
+			{
+				m_Components.Push( AllocateComponent( static_cast< uint32_t >( m_Components.GetSize() ) ) );
+			}
+		}
+
+		/// Check that the roster and per-component bookkeeping agree with the allocated components, which catches the
+		/// roster or parallel data losing entries when they are reallocated as the pool grows.
+		void CheckPoolConsistency()
+		{
+			const Components::Pool *pPool = GetPool();
+			ASSERT_TRUE( pPool != NULL );
+			ASSERT_EQ( m_Components.GetSize(), pPool->GetAllocatedCount() );
+
+			DynamicArray< bool > seen;
+			seen.Resize( pPool->GetCapacity() );
+			for ( size_t index = 0; index < seen.GetSize(); ++index )
+			{
+				seen[ index ] = false;
+			}
+
+			Component * const *pAllocated = pPool->GetAllocatedComponents();
+			for ( Components::ComponentIndex rosterIndex = 0; rosterIndex < pPool->GetAllocatedCount(); ++rosterIndex )
+			{
+				Component *pComponent = pAllocated[ rosterIndex ];
+				ASSERT_EQ( pComponent, pPool->GetComponentByRosterIndex( rosterIndex ) );
+				ASSERT_EQ( pPool, Components::Pool::GetPool( pComponent ) );
+
+				Components::ComponentIndex componentIndex = pPool->GetComponentIndex( pComponent );
+				ASSERT_LT( componentIndex, pPool->GetCapacity() );
+				EXPECT_FALSE( seen[ componentIndex ] ) << "Component " << componentIndex << " is in the roster twice";
+				seen[ componentIndex ] = true;
+
+				EXPECT_EQ( pComponent, pPool->GetComponent( componentIndex ) );
+				EXPECT_EQ( pComponent->GetOwner(), pPool->GetComponentOwner( pComponent ) );
+				EXPECT_EQ( &static_cast< PoolTestOwner * >( pComponent->GetOwner() )->m_Components, pPool->GetComponentCollection( pComponent ) );
+			}
+
+			// Every component is reachable from its owner's chain
+			size_t chainedCount = 0;
+			for ( size_t ownerIndex = 0; ownerIndex < POOL_TEST_OWNER_COUNT; ++ownerIndex )
+			{
+				for ( PoolTestComponent *pComponent = m_Owners[ ownerIndex ].m_Components.GetFirst< PoolTestComponent >();
+					pComponent;
+					pComponent = pComponent->GetNextComponent() )
+				{
+					EXPECT_EQ( ownerIndex, pComponent->m_Value % POOL_TEST_OWNER_COUNT );
+					++chainedCount;
+				}
+			}
+
+			EXPECT_EQ( m_Components.GetSize(), chainedCount );
+		}
+	};
+}
+
+TEST_F( ComponentPoolTest, PoolGrowsPastOnePage )
+{
+	const Components::Pool *pPool = GetPool();
+	ASSERT_TRUE( pPool != NULL );
+	EXPECT_EQ( 0u, pPool->GetPageCount() );
+
+	AllocateComponents( 1 );
+	ASSERT_EQ( 1u, pPool->GetPageCount() );
+	Components::ComponentIndex pageCapacity = pPool->GetCapacity();
+	ASSERT_LT( pageCapacity, POOL_TEST_COMPONENT_COUNT );
+
+	AllocateComponents( POOL_TEST_COMPONENT_COUNT - 1 );
+
+	EXPECT_EQ( ( POOL_TEST_COMPONENT_COUNT + pageCapacity - 1 ) / pageCapacity, pPool->GetPageCount() );
+	EXPECT_GE( pPool->GetCapacity(), POOL_TEST_COMPONENT_COUNT );
+	EXPECT_EQ( POOL_TEST_COMPONENT_COUNT, pPool->GetHighWaterMark() );
+	EXPECT_EQ( POOL_TEST_COMPONENT_COUNT, m_spManager->CountAllocatedComponents< PoolTestComponent >() );
+
+	CheckPoolConsistency();
+}
+
+TEST_F( ComponentPoolTest, AddressesStayStableAcrossGrowth )
+{
+	AllocateComponents( 1 );
+	const Components::Pool *pPool = GetPool();
+	ASSERT_TRUE( pPool != NULL );
+
+	// Fill the first page and point at every component in it
+	AllocateComponents( pPool->GetCapacity() - 1 );
+	size_t firstPageCount = m_Components.GetSize();
+	DynamicArray< ComponentPtr< PoolTestComponent > > pointers;
+	pointers.Resize( firstPageCount );
+	for ( size_t componentIndex = 0; componentIndex < firstPageCount; ++componentIndex )
+	{
+		pointers[ componentIndex ] = m_Components[ componentIndex ];
+	}
+
+	AllocateComponents( POOL_TEST_COMPONENT_COUNT - firstPageCount );
+	ASSERT_GT( pPool->GetPageCount(), 1u );
+
+	for ( size_t componentIndex = 0; componentIndex < firstPageCount; ++componentIndex )
+	{
+		PoolTestComponent *pComponent = m_Components[ componentIndex ];
+		EXPECT_EQ( componentIndex, pComponent->m_Value );
+		EXPECT_EQ( pPool, Components::Pool::GetPool( pComponent ) );
+		ASSERT_TRUE( pointers[ componentIndex ].IsGood() );
+		EXPECT_EQ( pComponent, pointers[ componentIndex ].Get() );
+	}
+
+	CheckPoolConsistency();
+	pointers.Clear();
+}
+
+TEST_F( ComponentPoolTest, FreedComponentsAreReused )
+{
+	AllocateComponents( POOL_TEST_COMPONENT_COUNT );
+	const Components::Pool *pPool = GetPool();
+	ASSERT_TRUE( pPool != NULL );
+
+	Components::ComponentIndex capacity = pPool->GetCapacity();
+	size_t pageCount = pPool->GetPageCount();
+
+	// Free every other component, keeping a pointer to each
+	DynamicArray< ComponentPtr< PoolTestComponent > > freedPointers;
+	DynamicArray< PoolTestComponent * > freedComponents;
+	DynamicArray< PoolTestComponent * > keptComponents;
+	freedPointers.Resize( POOL_TEST_COMPONENT_COUNT / 2 );
+	for ( size_t componentIndex = 0; componentIndex < POOL_TEST_COMPONENT_COUNT; ++componentIndex )
+	{
+		PoolTestComponent *pComponent = m_Components[ componentIndex ];
+		if ( componentIndex % 2 )
+		{
+			keptComponents.Push( pComponent );
+			continue;
+		}
+
+		freedPointers[ freedComponents.GetSize() ] = pComponent;
+		freedComponents.Push( pComponent );
+		pComponent->FreeComponent();
+	}
+
+	m_Components = keptComponents;
+	CheckPoolConsistency();
+
+	// Allocating the same number again reuses the freed slots instead of growing
+	AllocateComponents( freedComponents.GetSize() );
+	EXPECT_EQ( capacity, pPool->GetCapacity() );
+	EXPECT_EQ( pageCount, pPool->GetPageCount() );
+	EXPECT_EQ( POOL_TEST_COMPONENT_COUNT, pPool->GetAllocatedCount() );
+
+	for ( size_t componentIndex = keptComponents.GetSize(); componentIndex < m_Components.GetSize(); ++componentIndex )
+	{
+		bool reused = false;
+		for ( size_t freedIndex = 0; !reused && freedIndex < freedComponents.GetSize(); ++freedIndex )
+		{
+			reused = ( freedComponents[ freedIndex ] == m_Components[ componentIndex ] );
+		}
+
+		EXPECT_TRUE( reused ) << "Component " << componentIndex << " was not a freed slot";
+	}
+
+	// Pointers to the old occupants stay stale even though the memory is live again
+	for ( size_t freedIndex = 0; freedIndex < freedPointers.GetSize(); ++freedIndex )
+	{
+		EXPECT_FALSE( freedPointers[ freedIndex ].IsGood() );
+	}
+
+	CheckPoolConsistency();
+}
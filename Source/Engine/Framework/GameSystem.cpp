@@ -20,6 +20,7 @@
 #include "Framework/WorldManager.h"
 #include "Framework/SceneDefinition.h"
 #include "Framework/TaskScheduler.h"
+#include "EngineJobs/JobManager.h"
 
 #if !HELIUM_SHARED
 namespace Helium
@@ -88,6 +89,7 @@ bool GameSystem::Initialize(
 #endif
 
 	AsyncLoader::Startup();
+	JobManager::Startup();
 	CacheManager::Startup();
 	Reflect::Startup();
 	Persist::Startup();
@@ -184,6 +186,7 @@ void GameSystem::Cleanup()
 	Reflect::Shutdown();
 	AssetType::Shutdown();
 	Asset::Shutdown();
+	JobManager::Shutdown();
 	AsyncLoader::Shutdown();
 
 	Reflect::ObjectRefCountSupport::Shutdown();
@@ -2,6 +2,9 @@
 #include "Precompile.h"
 #include "TaskScheduler.h"
 #include "Foundation/Map.h"
+#include "Platform/Atomic.h"
+#include "Framework/Components.h"
+#include "EngineJobs/JobManager.h"
 
 using namespace Helium;
 
@@ -10,6 +13,7 @@ TaskDefinition *TaskDefinition::s_FirstTaskDefinition = NULL;
 bool TaskScheduler::m_ContractsDefined = false;
 
 bool InsertToTaskList(A_TaskDefinitionPtr &rTaskInfoList, DynamicArray<TaskFunc> &rTaskFuncList, A_TaskDefinitionPtr &rTaskStack, const TaskDefinition *pTask, uint32_t tickType);
+void BuildScheduleGraph(TaskSchedule &rSchedule);
 
 bool TaskScheduler::CalculateSchedule(uint32_t tickType, TaskSchedule &schedule)
 {	
@@ -205,9 +209,112 @@ bool TaskScheduler::CalculateSchedule(uint32_t tickType, TaskSchedule &schedule)
 	}
 #endif
 
+	BuildScheduleGraph(schedule);
+
 	return true;
 }
 
+// Find every task in the schedule (before index scheduleIndex) that pTask must wait for. Tasks that were dropped
+// from the schedule (abstract tasks or tasks of another tick type) are walked through so that ordering imposed
+// through them is kept.
+void FindScheduledPredecessors(
+	const Map<const TaskDefinition *, size_t> &rScheduleIndices,
+	A_TaskDefinitionPtr &rVisitedTasks,
+	DynamicArray<bool> &rIsPredecessor,
+	const TaskDefinition *pTask,
+	size_t scheduleIndex)
+{
+	for (A_TaskDefinitionPtr::ConstIterator prior_task_iter = pTask->m_RequiredTasks.Begin();
+		prior_task_iter != pTask->m_RequiredTasks.End(); ++prior_task_iter)
+	{
+		const TaskDefinition *pPriorTask = *prior_task_iter;
+
+		Map<const TaskDefinition *, size_t>::ConstIterator index_iter = rScheduleIndices.Find(pPriorTask);
+		if (index_iter != rScheduleIndices.End())
+		{
+			// Only earlier tasks can be waited on, which keeps the graph acyclic and consistent with the serial order
+			if (index_iter->Second() < scheduleIndex)
+			{
+				rIsPredecessor[index_iter->Second()] = true;
+			}
+
+			continue;
+		}
+
+		bool already_visited = false;
+		for (A_TaskDefinitionPtr::Iterator visited_iter = rVisitedTasks.Begin();
+			visited_iter != rVisitedTasks.End(); ++visited_iter)
+		{
+			if (*visited_iter == pPriorTask)
+			{
+				already_visited = true;
+				break;
+			}
+		}
+
+		if (!already_visited)
+		{
+			rVisitedTasks.Push(pPriorTask);
+			FindScheduledPredecessors(rScheduleIndices, rVisitedTasks, rIsPredecessor, pPriorTask, scheduleIndex);
+		}
+	}
+}
+
+void BuildScheduleGraph(TaskSchedule &rSchedule)
+{
+	const size_t taskCount = rSchedule.m_ScheduleInfo.GetSize();
+
+	rSchedule.m_ScheduleSuccessors.Clear();
+	rSchedule.m_ScheduleSuccessors.Resize(taskCount);
+	rSchedule.m_SchedulePredecessorCounts.Clear();
+	rSchedule.m_SchedulePredecessorCounts.Resize(taskCount);
+
+	Map<const TaskDefinition *, size_t> scheduleIndices;
+	for (size_t i = 0; i < taskCount; ++i)
+	{
+		scheduleIndices.Insert(Map<const TaskDefinition *, size_t>::ValueType(rSchedule.m_ScheduleInfo[i], i));
+	}
+
+	A_TaskDefinitionPtr visitedTasks;
+	DynamicArray<bool> isPredecessor;
+
+	for (size_t i = 0; i < taskCount; ++i)
+	{
+		const TaskDefinition *pTask = rSchedule.m_ScheduleInfo[i];
+
+		isPredecessor.Resize(i);
+		for (size_t j = 0; j < i; ++j)
+		{
+			isPredecessor[j] = false;
+		}
+
+		// Ordering requirements
+		visitedTasks.Resize(0);
+		FindScheduledPredecessors(scheduleIndices, visitedTasks, isPredecessor, pTask, i);
+
+		// Data access conflicts with tasks that are not otherwise ordered keep their serial order
+		for (size_t j = 0; j < i; ++j)
+		{
+			if (!isPredecessor[j] && pTask->m_Contract.ConflictsWith(rSchedule.m_ScheduleInfo[j]->m_Contract))
+			{
+				isPredecessor[j] = true;
+			}
+		}
+
+		uint32_t predecessorCount = 0;
+		for (size_t j = 0; j < i; ++j)
+		{
+			if (isPredecessor[j])
+			{
+				rSchedule.m_ScheduleSuccessors[j].Push(i);
+				++predecessorCount;
+			}
+		}
+
+		rSchedule.m_SchedulePredecessorCounts[i] = predecessorCount;
+	}
+}
+
 bool InsertToTaskList(A_TaskDefinitionPtr &rTaskInfoList, DynamicArray<TaskFunc> &rTaskFuncList, A_TaskDefinitionPtr &rTaskStack, const TaskDefinition *pTask, uint32_t tickType)
 {
 	// Don't add functions that do not run under the given tick type
@@ -288,6 +395,160 @@ void TaskScheduler::ExecuteSchedule( const TaskSchedule &schedule, DynamicArray<
 	}
 }
 
+struct ParallelScheduleExecution;
+
+// Per-task state for a single parallel execution of a schedule
+struct ParallelScheduleTask
+{
+	ParallelScheduleExecution *m_Execution;
+	size_t m_TaskIndex;
+	volatile int32_t m_PendingPredecessorCount;
+};
+
+struct ParallelScheduleExecution
+{
+	const TaskSchedule *m_Schedule;
+	DynamicArray< WorldPtr > *m_Worlds;
+	JobManager *m_JobManager;
+	JobCounter m_Counter;
+	DynamicArray< ParallelScheduleTask > m_Tasks;
+};
+
+void RunParallelScheduleTask( void *pData )
+{
+	ParallelScheduleTask *pTask = static_cast< ParallelScheduleTask * >( pData );
+	HELIUM_ASSERT( pTask );
+
+	ParallelScheduleExecution &rExecution = *pTask->m_Execution;
+	const TaskSchedule &rSchedule = *rExecution.m_Schedule;
+
+	rSchedule.m_ScheduleFunc[ pTask->m_TaskIndex ]( *rExecution.m_Worlds );
+
+	// Release every task that was only waiting on us
+	const DynamicArray< size_t > &rSuccessors = rSchedule.m_ScheduleSuccessors[ pTask->m_TaskIndex ];
+	for (DynamicArray< size_t >::ConstIterator iter = rSuccessors.Begin(); iter != rSuccessors.End(); ++iter)
+	{
+		ParallelScheduleTask &rSuccessor = rExecution.m_Tasks[ *iter ];
+		if ( AtomicDecrementRelease( rSuccessor.m_PendingPredecessorCount ) == 0 )
+		{
+			rExecution.m_JobManager->Spawn( RunParallelScheduleTask, &rSuccessor, rExecution.m_Counter );
+		}
+	}
+}
+
+void TaskScheduler::ExecuteScheduleParallel( const TaskSchedule &schedule, DynamicArray< WorldPtr > &rWorlds, JobManager &rJobManager )
+{
+	const size_t taskCount = schedule.m_ScheduleFunc.GetSize();
+	HELIUM_ASSERT( schedule.m_ScheduleSuccessors.GetSize() == taskCount );
+	HELIUM_ASSERT( schedule.m_SchedulePredecessorCounts.GetSize() == taskCount );
+
+	ParallelScheduleExecution execution;
+	execution.m_Schedule = &schedule;
+	execution.m_Worlds = &rWorlds;
+	execution.m_JobManager = &rJobManager;
+	execution.m_Tasks.Resize( taskCount );
+
+	for (size_t i = 0; i < taskCount; ++i)
+	{
+		ParallelScheduleTask &rTask = execution.m_Tasks[ i ];
+		rTask.m_Execution = &execution;
+		rTask.m_TaskIndex = i;
+		rTask.m_PendingPredecessorCount = static_cast< int32_t >( schedule.m_SchedulePredecessorCounts[ i ] );
+	}
+
+	// Tasks that share no declared data may still assign component pointers at the same time
+	Components::BeginParallelUpdate();
+
+	// Kick off every task that has nothing to wait for, the rest are spawned as their predecessors complete
+	for (size_t i = 0; i < taskCount; ++i)
+	{
+		if ( !schedule.m_SchedulePredecessorCounts[ i ] )
+		{
+			rJobManager.Spawn( RunParallelScheduleTask, &execution.m_Tasks[ i ], execution.m_Counter );
+		}
+	}
+
+	rJobManager.Wait( execution.m_Counter );
+
+	Components::EndParallelUpdate();
+}
+
+// A run of consecutive per-world tasks executed against a single world
+struct PerWorldScheduleSegment
+{
+	const TaskSchedule *m_Schedule;
+	size_t m_FirstTaskIndex;
+	size_t m_EndTaskIndex;
+	DynamicArray< WorldPtr > m_World;
+};
+
+void RunPerWorldScheduleSegment( void *pData )
+{
+	PerWorldScheduleSegment *pSegment = static_cast< PerWorldScheduleSegment * >( pData );
+	HELIUM_ASSERT( pSegment );
+
+	for (size_t i = pSegment->m_FirstTaskIndex; i < pSegment->m_EndTaskIndex; ++i)
+	{
+		pSegment->m_Schedule->m_ScheduleFunc[ i ]( pSegment->m_World );
+	}
+}
+
+void TaskScheduler::ExecuteSchedulePerWorld( const TaskSchedule &schedule, DynamicArray< WorldPtr > &rWorlds, JobManager &rJobManager )
+{
+	const size_t worldCount = rWorlds.GetSize();
+	if ( worldCount < 2 )
+	{
+		ExecuteSchedule( schedule, rWorlds );
+		return;
+	}
+
+	DynamicArray< PerWorldScheduleSegment > segments;
+	segments.Resize( worldCount );
+	for (size_t worldIndex = 0; worldIndex < worldCount; ++worldIndex)
+	{
+		segments[ worldIndex ].m_Schedule = &schedule;
+		segments[ worldIndex ].m_World.Push( rWorlds[ worldIndex ] );
+	}
+
+	const size_t taskCount = schedule.m_ScheduleFunc.GetSize();
+	size_t taskIndex = 0;
+	while (taskIndex < taskCount)
+	{
+		// Global tasks see every world at once, and act as a barrier between runs of per-world tasks
+		if ( schedule.m_ScheduleInfo[ taskIndex ]->m_Contract.m_WorldAffinity != WorldAffinities::PerWorld )
+		{
+			schedule.m_ScheduleFunc[ taskIndex ]( rWorlds );
+			++taskIndex;
+			continue;
+		}
+
+		size_t endTaskIndex = taskIndex + 1;
+		while ( endTaskIndex < taskCount && 
+			schedule.m_ScheduleInfo[ endTaskIndex ]->m_Contract.m_WorldAffinity == WorldAffinities::PerWorld )
+		{
+			++endTaskIndex;
+		}
+
+		// Each world runs the whole run of per-world tasks in schedule order on its own job
+		Components::BeginParallelUpdate();
+
+		JobCounter counter;
+		for (size_t worldIndex = 0; worldIndex < worldCount; ++worldIndex)
+		{
+			PerWorldScheduleSegment &rSegment = segments[ worldIndex ];
+			rSegment.m_FirstTaskIndex = taskIndex;
+			rSegment.m_EndTaskIndex = endTaskIndex;
+			rJobManager.Spawn( RunPerWorldScheduleSegment, &rSegment, counter );
+		}
+
+		rJobManager.Wait( counter );
+
+		Components::EndParallelUpdate();
+
+		taskIndex = endTaskIndex;
+	}
+}
+
 void Helium::TaskScheduler::ResetContracts()
 {
 	TaskDefinition *task = TaskDefinition::s_FirstTaskDefinition;
@@ -296,6 +557,10 @@ void Helium::TaskScheduler::ResetContracts()
 		task->m_RequiredTasks.Clear();
 		task->m_Contract.m_ContributedDependencies.Clear();
 		task->m_Contract.m_OrderRequirements.Clear();
+		task->m_Contract.m_ReadResources.Clear();
+		task->m_Contract.m_WriteResources.Clear();
+		task->m_Contract.m_AccessDeclared = false;
+		task->m_Contract.m_WorldAffinity = WorldAffinities::Global;
 		task = task->m_Next;
 	}
 
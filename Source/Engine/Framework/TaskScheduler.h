@@ -67,6 +67,27 @@ namespace Helium
 	}
 	typedef TickTypes::TickType TickType;
 
+	namespace WorldAffinities
+	{
+		enum WorldAffinity
+		{
+			Global,             // Task may touch state shared between worlds, so it runs on the updating thread with every world
+			PerWorld,           // Task only touches the worlds it is handed, so different worlds may be updated on different threads
+		};
+	}
+	typedef WorldAffinities::WorldAffinity WorldAffinity;
+
+	namespace TaskExecutionModes
+	{
+		enum TaskExecutionMode
+		{
+			Serial,             // Every task runs in schedule order on the updating thread
+			ParallelTasks,      // Unordered tasks that do not conflict run at the same time on the job manager
+			ParallelWorlds,     // Each world runs its per-world tasks in schedule order on its own job
+		};
+	}
+	typedef TaskExecutionModes::TaskExecutionMode TaskExecutionMode;
+
 	struct OrderRequirement
 	{
 		TaskDefinition *m_Dependency;
@@ -78,6 +99,8 @@ namespace Helium
 	{
 		TaskContract()
 			: m_TickType( TickTypes::Never )
+			, m_WorldAffinity( WorldAffinities::Global )
+			, m_AccessDeclared( false )
 		{
 
 		}
@@ -126,6 +149,85 @@ namespace Helium
 			m_TickType = tickType;
 		}
 
+		void SetWorldAffinity(WorldAffinity worldAffinity)
+		{
+			m_WorldAffinity = worldAffinity;
+		}
+
+		// Task reads components of type T
+		template <class T>
+		void ReadsComponent()
+		{
+			Reads(&T::GetStaticComponentTypeData());
+		}
+
+		// Task modifies components of type T
+		template <class T>
+		void WritesComponent()
+		{
+			Writes(&T::GetStaticComponentTypeData());
+		}
+
+		// Task reads the given piece of shared data (any unique address may be used to identify it)
+		void Reads(const void *pResource)
+		{
+			m_ReadResources.Push(pResource);
+			m_AccessDeclared = true;
+		}
+
+		// Task modifies the given piece of shared data (any unique address may be used to identify it)
+		void Writes(const void *pResource)
+		{
+			m_WriteResources.Push(pResource);
+			m_AccessDeclared = true;
+		}
+
+		// Task touches no data shared with other tasks
+		void AccessesNoSharedData()
+		{
+			m_AccessDeclared = true;
+		}
+
+		// True if this task and the given task may not run at the same time
+		bool ConflictsWith(const TaskContract &rOther) const
+		{
+			if (!m_AccessDeclared || !rOther.m_AccessDeclared)
+			{
+				return true;
+			}
+
+			for (DynamicArray<const void *>::ConstIterator iter = m_WriteResources.Begin(); iter != m_WriteResources.End(); ++iter)
+			{
+				if (ContainsResource(rOther.m_WriteResources, *iter) || ContainsResource(rOther.m_ReadResources, *iter))
+				{
+					return true;
+				}
+			}
+
+			for (DynamicArray<const void *>::ConstIterator iter = rOther.m_WriteResources.Begin(); iter != rOther.m_WriteResources.End(); ++iter)
+			{
+				if (ContainsResource(m_ReadResources, *iter))
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		static bool ContainsResource(const DynamicArray<const void *> &rResources, const void *pResource)
+		{
+			for (DynamicArray<const void *>::ConstIterator iter = rResources.Begin(); iter != rResources.End(); ++iter)
+			{
+				if (*iter == pResource)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
 		// Every requirement to be before or after another dependency goes here
 		DynamicArray<OrderRequirement> m_OrderRequirements;
 
@@ -133,6 +235,15 @@ namespace Helium
 		DynamicArray<const TaskDefinition *> m_ContributedDependencies;
 
 		TickType m_TickType;
+
+		// Whether each world can be handed to this task separately and on its own thread
+		WorldAffinity m_WorldAffinity;
+
+		// Shared data read and written by this task. Unordered tasks only run in parallel when neither writes data
+		// the other touches. A task that declares nothing is assumed to touch everything and always runs alone.
+		DynamicArray<const void *> m_ReadResources;
+		DynamicArray<const void *> m_WriteResources;
+		bool m_AccessDeclared;
 	};
 
 	class World;
@@ -187,13 +298,22 @@ namespace Helium
 	{
 		A_TaskDefinitionPtr m_ScheduleInfo;
 		DynamicArray<TaskFunc> m_ScheduleFunc; // Compact version of our schedule
+
+		// Dependency graph between the entries of m_ScheduleFunc, used for parallel execution. For each task, the
+		// indices of the tasks that must wait for it, and the number of tasks it must wait for.
+		DynamicArray< DynamicArray<size_t> > m_ScheduleSuccessors;
+		DynamicArray<uint32_t> m_SchedulePredecessorCounts;
 	};
 
+	class JobManager;
+
 	class HELIUM_FRAMEWORK_API TaskScheduler
 	{
 	public:
 		static bool CalculateSchedule( uint32_t tickType, TaskSchedule &schedule );
 		static void ExecuteSchedule( const TaskSchedule &schedule, DynamicArray< WorldPtr > &rWorlds );
+		static void ExecuteScheduleParallel( const TaskSchedule &schedule, DynamicArray< WorldPtr > &rWorlds, JobManager &rJobManager );
+		static void ExecuteSchedulePerWorld( const TaskSchedule &schedule, DynamicArray< WorldPtr > &rWorlds, JobManager &rJobManager );
 
 		static void ResetContracts();
 
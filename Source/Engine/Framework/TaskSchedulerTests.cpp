@@ -0,0 +1,648 @@
+#include "Framework/TaskScheduler.h"
+
+#include "Platform/Atomic.h"
+#include "Platform/Timer.h"
+#include "EngineJobs/JobManager.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Tick type of the layered synthetic tasks (a bit not used by any engine tick type).
+	const uint32_t LAYERED_TICK_TYPE = 1 << 16;
+	/// Tick type of the tasks declaring data access and stage requirements.
+	const uint32_t CONTRACT_TICK_TYPE = 1 << 17;
+
+	/// Number of tasks in the layered synthetic schedule.
+	const size_t SYNTHETIC_TASK_COUNT = 200;
+	/// Number of tasks in each layer of the synthetic schedule (tasks only depend on tasks in the previous layer).
+	const size_t SYNTHETIC_LAYER_WIDTH = 20;
+	/// Number of work iterations performed by each synthetic task.
+	const uint32_t SYNTHETIC_TASK_WORK = 200000;
+
+	/// Number of work iterations performed by each contract task.
+	const uint32_t CONTRACT_TASK_WORK = 20000;
+	/// Number of times the contract schedule is run in parallel.
+	const size_t CONTRACT_PARALLEL_RUN_COUNT = 50;
+
+	/// Completion sequence number of each synthetic task (zero if it has not run).
+	volatile int32_t g_TaskCompletionSequence[ SYNTHETIC_TASK_COUNT ];
+	/// Last completion sequence number handed out.
+	volatile int32_t g_LastCompletionSequence;
+	/// Sink for the results of the synthetic work so that it is not optimized away.
+	volatile uint32_t g_WorkSink;
+
+	uint32_t DoSyntheticWork( uint32_t value, uint32_t iterationCount )
+	{
+		for ( uint32_t i = 0; i < iterationCount; ++i )
+		{
+			value ^= value << 13;
+			value ^= value >> 17;
+			value ^= value << 5;
+		}
+
+		return value;
+	}
+
+	template < size_t Index >
+	void SyntheticTask( DynamicArray< WorldPtr > & )
+	{
+		g_WorkSink = DoSyntheticWork( static_cast< uint32_t >( Index ) + 1, SYNTHETIC_TASK_WORK );
+		g_TaskCompletionSequence[ Index ] = AtomicIncrementAcquire( g_LastCompletionSequence );
+	}
+
+	/// Fill in a table of distinct task functions, one per synthetic task (split in halves to keep template recursion
+	/// shallow).
+	template < size_t Begin, size_t Count >
+	struct SyntheticTaskTable
+	{
+		static void Fill( TaskFunc *pFuncs )
+		{
+			SyntheticTaskTable< Begin, Count / 2 >::Fill( pFuncs );
+			SyntheticTaskTable< Begin + Count / 2, Count - Count / 2 >::Fill( pFuncs );
+		}
+	};
+
+	template < size_t Begin >
+	struct SyntheticTaskTable< Begin, 1 >
+	{
+		static void Fill( TaskFunc *pFuncs )
+		{
+			pFuncs[ Begin ] = &SyntheticTask< Begin >;
+		}
+	};
+
+	TaskFunc GetSyntheticTaskFunc( size_t taskIndex )
+	{
+		static TaskFunc funcs[ SYNTHETIC_TASK_COUNT ];
+		if ( !funcs[ 0 ] )
+		{
+			SyntheticTaskTable< 0, SYNTHETIC_TASK_COUNT >::Fill( funcs );
+		}
+
+		HELIUM_ASSERT( taskIndex < SYNTHETIC_TASK_COUNT );
+		return funcs[ taskIndex ];
+	}
+
+	/// Get the tasks that a synthetic task must wait for.
+	void GetSyntheticPredecessors( size_t taskIndex, size_t &rFirst, size_t &rSecond )
+	{
+		size_t layerStart = taskIndex - taskIndex % SYNTHETIC_LAYER_WIDTH - SYNTHETIC_LAYER_WIDTH;
+		size_t column = taskIndex % SYNTHETIC_LAYER_WIDTH;
+
+		rFirst = layerStart + column;
+		rSecond = layerStart + ( column * 7 + 3 ) % SYNTHETIC_LAYER_WIDTH;
+	}
+
+	/// Task definition of a layered synthetic task, which must run after two tasks of the layer before it.  Like the
+	/// HELIUM_DEFINE_TASK statics, these are registered in the global task definition list during static
+	/// initialization, so the scheduler picks them up along with every other task.
+	struct SyntheticTaskDefinition : public TaskDefinition
+	{
+		SyntheticTaskDefinition()
+			: TaskDefinition( *this, GetSyntheticTaskFunc( sm_DefinitionCount ), "SyntheticTask" )
+			, m_Index( sm_DefinitionCount++ )
+		{
+			m_Contract.SetTickType( static_cast< TickType >( LAYERED_TICK_TYPE ) );
+		}
+
+		virtual void DefineContract( TaskContract &rContract );
+
+		size_t m_Index;
+
+		static size_t sm_DefinitionCount;
+	};
+
+	size_t SyntheticTaskDefinition::sm_DefinitionCount = 0;
+
+	SyntheticTaskDefinition g_SyntheticTasks[ SYNTHETIC_TASK_COUNT ];
+
+	void SyntheticTaskDefinition::DefineContract( TaskContract &rContract )
+	{
+		rContract.AccessesNoSharedData();
+
+		if ( m_Index >= SYNTHETIC_LAYER_WIDTH )
+		{
+			size_t first, second;
+			GetSyntheticPredecessors( m_Index, first, second );
+
+			rContract.ExecuteAfter( g_SyntheticTasks[ first ] );
+			if ( second != first )
+			{
+				rContract.ExecuteAfter( g_SyntheticTasks[ second ] );
+			}
+		}
+	}
+
+	size_t GetSyntheticTaskIndex( const TaskDefinition *pTask )
+	{
+		HELIUM_ASSERT( pTask >= g_SyntheticTasks && pTask < g_SyntheticTasks + SYNTHETIC_TASK_COUNT );
+		return static_cast< const SyntheticTaskDefinition * >( pTask )->m_Index;
+	}
+
+	int32_t GetCompletionSequence( size_t taskIndex )
+	{
+		return g_TaskCompletionSequence[ taskIndex ];
+	}
+
+	void ResetCompletionSequence()
+	{
+		for ( size_t taskIndex = 0; taskIndex < SYNTHETIC_TASK_COUNT; ++taskIndex )
+		{
+			g_TaskCompletionSequence[ taskIndex ] = 0;
+		}
+
+		g_LastCompletionSequence = 0;
+	}
+
+	/// Check that every task ran once and only after the tasks it depends on.
+	void CheckCompletionSequence()
+	{
+		int32_t lastCompletionSequence = g_LastCompletionSequence;
+		EXPECT_EQ( static_cast< int32_t >( SYNTHETIC_TASK_COUNT ), lastCompletionSequence );
+
+		for ( size_t taskIndex = 0; taskIndex < SYNTHETIC_TASK_COUNT; ++taskIndex )
+		{
+			ASSERT_NE( 0, GetCompletionSequence( taskIndex ) ) << "Task " << taskIndex << " did not run";
+		}
+
+		for ( size_t taskIndex = SYNTHETIC_LAYER_WIDTH; taskIndex < SYNTHETIC_TASK_COUNT; ++taskIndex )
+		{
+			size_t first, second;
+			GetSyntheticPredecessors( taskIndex, first, second );
+
+			EXPECT_GT( GetCompletionSequence( taskIndex ), GetCompletionSequence( first ) );
+			EXPECT_GT( GetCompletionSequence( taskIndex ), GetCompletionSequence( second ) );
+		}
+	}
+
+	/// Shared data declared as accessed by the contract tasks.
+	int g_SharedResource;
+	int g_OtherSharedResource;
+
+	enum EContractTask
+	{
+		CONTRACT_TASK_WRITE_SHARED,
+		CONTRACT_TASK_READ_SHARED_A,
+		CONTRACT_TASK_READ_SHARED_B,
+		CONTRACT_TASK_WRITE_OTHER,
+		CONTRACT_TASK_STAGE_B_READ_OTHER,
+		CONTRACT_TASK_UNDECLARED,
+		CONTRACT_TASK_INDEPENDENT,
+
+		CONTRACT_TASK_COUNT
+	};
+
+	/// Sequence numbers of the start and end of each contract task (zero if it has not run).
+	volatile int32_t g_ContractTaskStartSequence[ CONTRACT_TASK_COUNT ];
+	volatile int32_t g_ContractTaskEndSequence[ CONTRACT_TASK_COUNT ];
+	/// Last contract task sequence number handed out.
+	volatile int32_t g_LastContractSequence;
+
+	template < size_t Index >
+	void ContractTask( DynamicArray< WorldPtr > & )
+	{
+		g_ContractTaskStartSequence[ Index ] = AtomicIncrementAcquire( g_LastContractSequence );
+		g_WorkSink = DoSyntheticWork( static_cast< uint32_t >( Index ) + 1, CONTRACT_TASK_WORK );
+		g_ContractTaskEndSequence[ Index ] = AtomicIncrementRelease( g_LastContractSequence );
+	}
+
+	void ResetContractSequence()
+	{
+		for ( size_t taskIndex = 0; taskIndex < CONTRACT_TASK_COUNT; ++taskIndex )
+		{
+			g_ContractTaskStartSequence[ taskIndex ] = 0;
+			g_ContractTaskEndSequence[ taskIndex ] = 0;
+		}
+
+		g_LastContractSequence = 0;
+	}
+
+	/// Abstract stages of the contract tasks, with every task of the second stage running after the first.
+	struct ContractStageA : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( ContractStageA );
+		virtual void DefineContract( TaskContract &rContract );
+	};
+
+	struct ContractStageB : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( ContractStageB );
+		virtual void DefineContract( TaskContract &rContract );
+	};
+
+	HELIUM_DEFINE_ABSTRACT_TASK( ContractStageA );
+	void ContractStageA::DefineContract( TaskContract & )
+	{
+	}
+
+	HELIUM_DEFINE_ABSTRACT_TASK( ContractStageB );
+	void ContractStageB::DefineContract( TaskContract &rContract )
+	{
+		rContract.ExecuteAfter< ContractStageA >();
+	}
+
+	/// Writes the shared resource within the first stage.
+	struct WriteSharedTask : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( WriteSharedTask );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.ExecutesWithin< ContractStageA >();
+			rContract.Writes( &g_SharedResource );
+		}
+	};
+
+	/// Read the shared resource, unordered with respect to its writer and to each other.
+	struct ReadSharedTaskA : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( ReadSharedTaskA );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.Reads( &g_SharedResource );
+		}
+	};
+
+	struct ReadSharedTaskB : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( ReadSharedTaskB );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.Reads( &g_SharedResource );
+		}
+	};
+
+	/// Writes the other resource, explicitly after one of the readers.
+	struct WriteOtherTask : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( WriteOtherTask );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.ExecuteAfter< ReadSharedTaskA >();
+			rContract.Writes( &g_OtherSharedResource );
+		}
+	};
+
+	/// Reads the other resource within the second stage.
+	struct StageBReadOtherTask : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( StageBReadOtherTask );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.ExecutesWithin< ContractStageB >();
+			rContract.Reads( &g_OtherSharedResource );
+		}
+	};
+
+	/// Declares no data access, so it may not overlap any other task.
+	struct UndeclaredAccessTask : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( UndeclaredAccessTask );
+		virtual void DefineContract( TaskContract & )
+		{
+		}
+	};
+
+	/// Touches no shared data, so it only has to stay clear of the undeclared task.
+	struct IndependentTask : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( IndependentTask );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.AccessesNoSharedData();
+		}
+	};
+
+	HELIUM_DEFINE_TASK( WriteSharedTask, ContractTask< CONTRACT_TASK_WRITE_SHARED >, static_cast< TickType >( CONTRACT_TICK_TYPE ) );
+	HELIUM_DEFINE_TASK( ReadSharedTaskA, ContractTask< CONTRACT_TASK_READ_SHARED_A >, static_cast< TickType >( CONTRACT_TICK_TYPE ) );
+	HELIUM_DEFINE_TASK( ReadSharedTaskB, ContractTask< CONTRACT_TASK_READ_SHARED_B >, static_cast< TickType >( CONTRACT_TICK_TYPE ) );
+	HELIUM_DEFINE_TASK( WriteOtherTask, ContractTask< CONTRACT_TASK_WRITE_OTHER >, static_cast< TickType >( CONTRACT_TICK_TYPE ) );
+	HELIUM_DEFINE_TASK( StageBReadOtherTask, ContractTask< CONTRACT_TASK_STAGE_B_READ_OTHER >, static_cast< TickType >( CONTRACT_TICK_TYPE ) );
+	HELIUM_DEFINE_TASK( UndeclaredAccessTask, ContractTask< CONTRACT_TASK_UNDECLARED >, static_cast< TickType >( CONTRACT_TICK_TYPE ) );
+	HELIUM_DEFINE_TASK( IndependentTask, ContractTask< CONTRACT_TASK_INDEPENDENT >, static_cast< TickType >( CONTRACT_TICK_TYPE ) );
+
+	const TaskDefinition *GetContractTaskDefinition( size_t taskIndex )
+	{
+		static const TaskDefinition *const definitions[ CONTRACT_TASK_COUNT ] =
+		{
+			&WriteSharedTask::m_This,
+			&ReadSharedTaskA::m_This,
+			&ReadSharedTaskB::m_This,
+			&WriteOtherTask::m_This,
+			&StageBReadOtherTask::m_This,
+			&UndeclaredAccessTask::m_This,
+			&IndependentTask::m_This,
+		};
+
+		HELIUM_ASSERT( taskIndex < CONTRACT_TASK_COUNT );
+		return definitions[ taskIndex ];
+	}
+
+	/// Get the position of a task in a schedule, or an invalid index if it is not scheduled.
+	size_t FindScheduleIndex( const TaskSchedule &rSchedule, const TaskDefinition *pTask )
+	{
+		size_t taskCount = rSchedule.m_ScheduleInfo.GetSize();
+		for ( size_t scheduleIndex = 0; scheduleIndex < taskCount; ++scheduleIndex )
+		{
+			if ( rSchedule.m_ScheduleInfo[ scheduleIndex ] == pTask )
+			{
+				return scheduleIndex;
+			}
+		}
+
+		return Invalid< size_t >();
+	}
+
+	/// Check whether the task at one schedule index must finish before the task at another one starts, directly or
+	/// through other tasks in the schedule graph.
+	bool IsScheduledBefore( const TaskSchedule &rSchedule, size_t earlierIndex, size_t laterIndex )
+	{
+		size_t taskCount = rSchedule.m_ScheduleSuccessors.GetSize();
+		DynamicArray< bool > visited;
+		visited.Resize( taskCount );
+		for ( size_t scheduleIndex = 0; scheduleIndex < taskCount; ++scheduleIndex )
+		{
+			visited[ scheduleIndex ] = false;
+		}
+
+		DynamicArray< size_t > pending;
+		pending.Push( earlierIndex );
+		while ( !pending.IsEmpty() )
+		{
+			size_t scheduleIndex = pending.GetLast();
+			pending.Pop();
+
+			const DynamicArray< size_t > &rSuccessors = rSchedule.m_ScheduleSuccessors[ scheduleIndex ];
+			for ( size_t successorIndex = 0; successorIndex < rSuccessors.GetSize(); ++successorIndex )
+			{
+				size_t successor = rSuccessors[ successorIndex ];
+				if ( successor == laterIndex )
+				{
+					return true;
+				}
+
+				if ( !visited[ successor ] )
+				{
+					visited[ successor ] = true;
+					pending.Push( successor );
+				}
+			}
+		}
+
+		return false;
+	}
+
+	/// Check whether a task lists another among the tasks it must run after.
+	bool RequiresTask( const TaskDefinition *pTask, const TaskDefinition *pRequiredTask )
+	{
+		for ( size_t requiredIndex = 0; requiredIndex < pTask->m_RequiredTasks.GetSize(); ++requiredIndex )
+		{
+			if ( pTask->m_RequiredTasks[ requiredIndex ] == pRequiredTask )
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	class TaskSchedulerTest : public testing::Test
+	{
+	protected:
+		TaskSchedule m_Schedule;
+		DynamicArray< WorldPtr > m_Worlds;
+
+		void SetUp()
+		{
+			JobManager::Startup();
+			ResetCompletionSequence();
+			ResetContractSequence();
+		}
+
+		void TearDown()
+		{
+			JobManager::Shutdown();
+		}
+	};
+}
+
+TEST_F( TaskSchedulerTest, LayeredScheduleGraphMatchesRequirements )
+{
+	ASSERT_TRUE( TaskScheduler::CalculateSchedule( LAYERED_TICK_TYPE, m_Schedule ) );
+	ASSERT_EQ( SYNTHETIC_TASK_COUNT, m_Schedule.m_ScheduleInfo.GetSize() );
+	ASSERT_EQ( SYNTHETIC_TASK_COUNT, m_Schedule.m_ScheduleFunc.GetSize() );
+	ASSERT_EQ( SYNTHETIC_TASK_COUNT, m_Schedule.m_ScheduleSuccessors.GetSize() );
+	ASSERT_EQ( SYNTHETIC_TASK_COUNT, m_Schedule.m_SchedulePredecessorCounts.GetSize() );
+
+	// Each task comes after its requirements in the serial order, and only waits on them in the graph, as none of the
+	// tasks share data.
+	DynamicArray< size_t > scheduleIndices;
+	scheduleIndices.Resize( SYNTHETIC_TASK_COUNT );
+	for ( size_t scheduleIndex = 0; scheduleIndex < SYNTHETIC_TASK_COUNT; ++scheduleIndex )
+	{
+		scheduleIndices[ GetSyntheticTaskIndex( m_Schedule.m_ScheduleInfo[ scheduleIndex ] ) ] = scheduleIndex;
+	}
+
+	for ( size_t taskIndex = 0; taskIndex < SYNTHETIC_TASK_COUNT; ++taskIndex )
+	{
+		size_t scheduleIndex = scheduleIndices[ taskIndex ];
+		EXPECT_EQ( GetSyntheticTaskFunc( taskIndex ), m_Schedule.m_ScheduleFunc[ scheduleIndex ] );
+
+		if ( taskIndex < SYNTHETIC_LAYER_WIDTH )
+		{
+			EXPECT_EQ( 0u, m_Schedule.m_SchedulePredecessorCounts[ scheduleIndex ] );
+			continue;
+		}
+
+		size_t first, second;
+		GetSyntheticPredecessors( taskIndex, first, second );
+
+		EXPECT_LT( scheduleIndices[ first ], scheduleIndex );
+		EXPECT_LT( scheduleIndices[ second ], scheduleIndex );
+		EXPECT_EQ( first == second ? 1u : 2u, m_Schedule.m_SchedulePredecessorCounts[ scheduleIndex ] );
+		EXPECT_TRUE( IsScheduledBefore( m_Schedule, scheduleIndices[ first ], scheduleIndex ) );
+		EXPECT_TRUE( IsScheduledBefore( m_Schedule, scheduleIndices[ second ], scheduleIndex ) );
+	}
+
+	// Tasks of the same layer never wait on each other.
+	for ( size_t taskIndex = 1; taskIndex < SYNTHETIC_LAYER_WIDTH; ++taskIndex )
+	{
+		EXPECT_FALSE( IsScheduledBefore( m_Schedule, scheduleIndices[ 0 ], scheduleIndices[ taskIndex ] ) );
+		EXPECT_FALSE( IsScheduledBefore( m_Schedule, scheduleIndices[ taskIndex ], scheduleIndices[ 0 ] ) );
+	}
+}
+
+TEST_F( TaskSchedulerTest, SerialScheduleRunsEveryTaskInOrder )
+{
+	ASSERT_TRUE( TaskScheduler::CalculateSchedule( LAYERED_TICK_TYPE, m_Schedule ) );
+
+	TaskScheduler::ExecuteSchedule( m_Schedule, m_Worlds );
+
+	CheckCompletionSequence();
+	for ( size_t scheduleIndex = 0; scheduleIndex < m_Schedule.m_ScheduleInfo.GetSize(); ++scheduleIndex )
+	{
+		size_t taskIndex = GetSyntheticTaskIndex( m_Schedule.m_ScheduleInfo[ scheduleIndex ] );
+		EXPECT_EQ( static_cast< int32_t >( scheduleIndex + 1 ), GetCompletionSequence( taskIndex ) );
+	}
+}
+
+TEST_F( TaskSchedulerTest, ParallelScheduleRespectsDependencies )
+{
+	JobManager *pJobManager = JobManager::GetInstance();
+	ASSERT_TRUE( pJobManager != NULL );
+
+	ASSERT_TRUE( TaskScheduler::CalculateSchedule( LAYERED_TICK_TYPE, m_Schedule ) );
+
+	TaskScheduler::ExecuteScheduleParallel( m_Schedule, m_Worlds, *pJobManager );
+
+	CheckCompletionSequence();
+}
+
+TEST_F( TaskSchedulerTest, ContractScheduleGraphOrdersRequirementsAndConflicts )
+{
+	ASSERT_TRUE( TaskScheduler::CalculateSchedule( CONTRACT_TICK_TYPE, m_Schedule ) );
+
+	// Abstract stages are dropped, leaving only the tasks that do work.
+	ASSERT_EQ( static_cast< size_t >( CONTRACT_TASK_COUNT ), m_Schedule.m_ScheduleInfo.GetSize() );
+
+	size_t scheduleIndices[ CONTRACT_TASK_COUNT ];
+	for ( size_t taskIndex = 0; taskIndex < CONTRACT_TASK_COUNT; ++taskIndex )
+	{
+		scheduleIndices[ taskIndex ] = FindScheduleIndex( m_Schedule, GetContractTaskDefinition( taskIndex ) );
+		ASSERT_TRUE( IsValid( scheduleIndices[ taskIndex ] ) );
+	}
+
+	// Stage membership turns into requirements between the tasks within the stages.
+	EXPECT_TRUE( RequiresTask( &StageBReadOtherTask::m_This, &WriteSharedTask::m_This ) );
+	EXPECT_TRUE( RequiresTask( &WriteOtherTask::m_This, &ReadSharedTaskA::m_This ) );
+
+	// Every requirement and every conflict between two tasks orders them in the graph, in serial schedule order.
+	for ( size_t laterTask = 0; laterTask < CONTRACT_TASK_COUNT; ++laterTask )
+	{
+		for ( size_t earlierTask = 0; earlierTask < CONTRACT_TASK_COUNT; ++earlierTask )
+		{
+			if ( earlierTask == laterTask )
+			{
+				continue;
+			}
+
+			const TaskDefinition *pEarlier = GetContractTaskDefinition( earlierTask );
+			const TaskDefinition *pLater = GetContractTaskDefinition( laterTask );
+			size_t earlierIndex = scheduleIndices[ earlierTask ];
+			size_t laterIndex = scheduleIndices[ laterTask ];
+
+			if ( RequiresTask( pLater, pEarlier ) )
+			{
+				EXPECT_LT( earlierIndex, laterIndex );
+				EXPECT_TRUE( IsScheduledBefore( m_Schedule, earlierIndex, laterIndex ) );
+			}
+
+			if ( earlierIndex < laterIndex && pLater->m_Contract.ConflictsWith( pEarlier->m_Contract ) )
+			{
+				EXPECT_TRUE( IsScheduledBefore( m_Schedule, earlierIndex, laterIndex ) );
+			}
+		}
+	}
+
+	// Readers of the same data may run at the same time.
+	EXPECT_FALSE( GetContractTaskDefinition( CONTRACT_TASK_READ_SHARED_A )->m_Contract.ConflictsWith(
+		GetContractTaskDefinition( CONTRACT_TASK_READ_SHARED_B )->m_Contract ) );
+	EXPECT_FALSE( IsScheduledBefore(
+		m_Schedule, scheduleIndices[ CONTRACT_TASK_READ_SHARED_A ], scheduleIndices[ CONTRACT_TASK_READ_SHARED_B ] ) );
+	EXPECT_FALSE( IsScheduledBefore(
+		m_Schedule, scheduleIndices[ CONTRACT_TASK_READ_SHARED_B ], scheduleIndices[ CONTRACT_TASK_READ_SHARED_A ] ) );
+
+	// A task without declared access conflicts with everything, while one touching no shared data only conflicts with
+	// the undeclared task.
+	for ( size_t taskIndex = 0; taskIndex < CONTRACT_TASK_COUNT; ++taskIndex )
+	{
+		if ( taskIndex == CONTRACT_TASK_UNDECLARED )
+		{
+			continue;
+		}
+
+		const TaskContract &rContract = GetContractTaskDefinition( taskIndex )->m_Contract;
+		EXPECT_TRUE( rContract.ConflictsWith( UndeclaredAccessTask::m_This.m_Contract ) );
+		EXPECT_EQ(
+			taskIndex != CONTRACT_TASK_INDEPENDENT,
+			rContract.ConflictsWith( IndependentTask::m_This.m_Contract ) );
+	}
+}
+
+TEST_F( TaskSchedulerTest, ParallelContractScheduleKeepsOrderAndExcludesConflicts )
+{
+	JobManager *pJobManager = JobManager::GetInstance();
+	ASSERT_TRUE( pJobManager != NULL );
+
+	ASSERT_TRUE( TaskScheduler::CalculateSchedule( CONTRACT_TICK_TYPE, m_Schedule ) );
+
+	for ( size_t runIndex = 0; runIndex < CONTRACT_PARALLEL_RUN_COUNT; ++runIndex )
+	{
+		ResetContractSequence();
+		TaskScheduler::ExecuteScheduleParallel( m_Schedule, m_Worlds, *pJobManager );
+
+		int32_t lastContractSequence = g_LastContractSequence;
+		ASSERT_EQ( static_cast< int32_t >( CONTRACT_TASK_COUNT * 2 ), lastContractSequence );
+
+		for ( size_t firstTask = 0; firstTask < CONTRACT_TASK_COUNT; ++firstTask )
+		{
+			for ( size_t secondTask = 0; secondTask < CONTRACT_TASK_COUNT; ++secondTask )
+			{
+				if ( firstTask == secondTask )
+				{
+					continue;
+				}
+
+				const TaskDefinition *pFirst = GetContractTaskDefinition( firstTask );
+				const TaskDefinition *pSecond = GetContractTaskDefinition( secondTask );
+
+				if ( RequiresTask( pSecond, pFirst ) )
+				{
+					EXPECT_LT( g_ContractTaskEndSequence[ firstTask ], g_ContractTaskStartSequence[ secondTask ] )
+						<< "Task " << secondTask << " started before task " << firstTask << " finished";
+				}
+
+				if ( pFirst->m_Contract.ConflictsWith( pSecond->m_Contract ) )
+				{
+					EXPECT_TRUE(
+						g_ContractTaskEndSequence[ firstTask ] < g_ContractTaskStartSequence[ secondTask ] ||
+						g_ContractTaskEndSequence[ secondTask ] < g_ContractTaskStartSequence[ firstTask ] )
+						<< "Task " << firstTask << " overlapped task " << secondTask;
+				}
+			}
+		}
+	}
+}
+
+TEST_F( TaskSchedulerTest, BenchmarkSerialAgainstParallel )
+{
+	JobManager *pJobManager = JobManager::GetInstance();
+	ASSERT_TRUE( pJobManager != NULL );
+
+	uint64_t startTicks = Timer::GetTickCount();
+	ASSERT_TRUE( TaskScheduler::CalculateSchedule( LAYERED_TICK_TYPE, m_Schedule ) );
+	uint64_t scheduleTicks = Timer::GetTickCount() - startTicks;
+
+	startTicks = Timer::GetTickCount();
+	TaskScheduler::ExecuteSchedule( m_Schedule, m_Worlds );
+	uint64_t serialTicks = Timer::GetTickCount() - startTicks;
+	CheckCompletionSequence();
+
+	ResetCompletionSequence();
+	startTicks = Timer::GetTickCount();
+	TaskScheduler::ExecuteScheduleParallel( m_Schedule, m_Worlds, *pJobManager );
+	uint64_t parallelTicks = Timer::GetTickCount() - startTicks;
+	CheckCompletionSequence();
+
+	printf(
+		"%u tasks: schedule %.3f ms, serial %.3f ms, parallel %.3f ms on %u workers\n",
+		static_cast< uint32_t >( SYNTHETIC_TASK_COUNT ),
+		Timer::TicksToMilliseconds( scheduleTicks ),
+		Timer::TicksToMilliseconds( serialTicks ),
+		Timer::TicksToMilliseconds( parallelTicks ),
+		pJobManager->GetWorkerCount() );
+}
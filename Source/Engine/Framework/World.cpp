@@ -314,3 +314,27 @@ Slice* World::GetSlice( size_t index ) const
 
 	return m_Slices[ index ];
 }
+
+/// Destroy every entity in this world that has been flagged for deferred destruction.
+///
+/// This only touches entities owned by this world, so different worlds may process their deferred destroys on
+/// different threads.
+void World::ProcessDeferredDestroys()
+{
+	// Only touches this world's slices and components, so worlds may run this on different threads at once
+	for ( size_t sliceIndex = 0; sliceIndex < GetSliceCount(); ++sliceIndex )
+	{
+		Slice *pSlice = GetSlice( sliceIndex );
+
+		// Walk backwards, as destroying an entity moves the slice's last entity into its place
+		for ( size_t entityIndex = pSlice->GetEntityCount(); entityIndex-- > 0; )
+		{
+			Entity *pEntity = pSlice->GetEntity( entityIndex );
+
+			if ( pEntity->IsDeferredDestroySet() )
+			{
+				pSlice->DestroyEntity( pEntity );
+			}
+		}
+	}
+}
@@ -64,6 +64,11 @@ namespace Helium
 		Slice* GetSlice( size_t index ) const;
 		//@}
 
+		/// @name Updating
+		//@{
+		void ProcessDeferredDestroys();
+		//@}
+
 	public:
 		// TEMPORARY!
 		ComponentManagerPtr m_ComponentManager;
@@ -103,7 +108,7 @@ namespace Helium
 
 		ComponentManager *pComponentManager = pWorld->GetComponentManager();
 		HELIUM_ASSERT( pComponentManager );
-		QueryComponentsInternal( *pComponentManager, types, HELIUM_ARRAY_COUNT(types), TupleHandler<A, B, F> );
+		pComponentManager->GetCachedQuery( types, HELIUM_ARRAY_COUNT(types) )->Run( TupleHandler<A, B, F> );
 	}
 	
 	template <class A, class B, class C, void (*F)(A *, B *, C *)>
@@ -117,7 +122,44 @@ namespace Helium
 
 		ComponentManager *pComponentManager = pWorld->GetComponentManager();
 		HELIUM_ASSERT( pComponentManager );
-		QueryComponentsInternal( *pComponentManager, types, HELIUM_ARRAY_COUNT(types), TupleHandler<A, B, C, F> );
+		pComponentManager->GetCachedQuery( types, HELIUM_ARRAY_COUNT(types) )->Run( TupleHandler<A, B, C, F> );
+	}
+
+	// Parallel versions split the matches into batches on the job manager. Callbacks for different matches may run at
+	// the same time, so they must not allocate or free components directly; use the command buffer instead.
+	template <class A, void (*F)(A *, ComponentCommandBuffer &)>
+	inline void ParallelQueryComponents( World *pWorld )
+	{
+		ComponentManager *pComponentManager = pWorld->GetComponentManager();
+		HELIUM_ASSERT( pComponentManager );
+		ParallelQueryComponentsInternal( *pComponentManager, Components::GetType<A>(), ParallelComponentHandler<A, F> );
+	}
+
+	template <class A, class B, void (*F)(A *, B *, ComponentCommandBuffer &)>
+	inline void ParallelQueryComponents( World *pWorld )
+	{
+		static Components::TypeId types[] = {
+			Components::GetType<A>(),
+			Components::GetType<B>()
+		};
+
+		ComponentManager *pComponentManager = pWorld->GetComponentManager();
+		HELIUM_ASSERT( pComponentManager );
+		ParallelQueryComponentsInternal( *pComponentManager, types, HELIUM_ARRAY_COUNT(types), ParallelTupleHandler<A, B, F> );
+	}
+
+	template <class A, class B, class C, void (*F)(A *, B *, C *, ComponentCommandBuffer &)>
+	inline void ParallelQueryComponents( World *pWorld )
+	{
+		static Components::TypeId types[] = {
+			Components::GetType<A>(),
+			Components::GetType<B>(),
+			Components::GetType<C>()
+		};
+
+		ComponentManager *pComponentManager = pWorld->GetComponentManager();
+		HELIUM_ASSERT( pComponentManager );
+		ParallelQueryComponentsInternal( *pComponentManager, types, HELIUM_ARRAY_COUNT(types), ParallelTupleHandler<A, B, C, F> );
 	}
 }
 
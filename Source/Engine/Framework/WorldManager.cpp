@@ -4,9 +4,11 @@
 
 #include "Platform/Timer.h"
 #include "Framework/Slice.h"
+#include "Framework/Components.h"
 #include "Framework/Entity.h"
 #include "Framework/SceneDefinition.h"
 #include "Framework/TaskScheduler.h"
+#include "EngineJobs/JobManager.h"
 
 using namespace Helium;
 
@@ -20,6 +22,7 @@ WorldManager::WorldManager()
 , m_frameDeltaTickCount( 0 )
 , m_frameDeltaSeconds( 0.0f )
 , m_bProcessedFirstFrame( false )
+, m_taskExecutionMode( TaskExecutionModes::Serial )
 {
 }
 
@@ -175,34 +178,61 @@ bool WorldManager::ReleaseWorld( World* pWorld )
 	return false;
 }
 
+/// Job entry point for processing the deferred destroys of a single world.
+///
+/// @param[in] pData  World to process.
+static void ProcessDeferredDestroysJob( void* pData )
+{
+	World* pWorld = static_cast< World* >( pData );
+	HELIUM_ASSERT( pWorld );
+	pWorld->ProcessDeferredDestroys();
+}
+
 /// Update all worlds for the current frame.
 void WorldManager::Update( TaskSchedule &schedule )
 {
 	// Update the world time.
 	UpdateTime();
 	
-	Helium::TaskScheduler::ExecuteSchedule( schedule, m_worlds );
+	JobManager* pJobManager = JobManager::GetInstance();
+	TaskExecutionMode executionMode = ( pJobManager ? m_taskExecutionMode : TaskExecutionModes::Serial );
+
+	switch ( executionMode )
+	{
+	case TaskExecutionModes::ParallelTasks:
+		Helium::TaskScheduler::ExecuteScheduleParallel( schedule, m_worlds, *pJobManager );
+		break;
+
+	case TaskExecutionModes::ParallelWorlds:
+		Helium::TaskScheduler::ExecuteSchedulePerWorld( schedule, m_worlds, *pJobManager );
+		break;
+
+	default:
+		Helium::TaskScheduler::ExecuteSchedule( schedule, m_worlds );
+		break;
+	}
 	
 	Components::Tick();
 
-	// TODO: I plan to do a "flag system" - components that are super lightweight.. like bitflags.. that carry no data
-	// but mark an object. This data would be kept parallel with slices/worlds so that they would be far faster to query
-	// than this abomination
-	for ( DynamicArray< WorldPtr >::Iterator worldIter = m_worlds.Begin(); worldIter != m_worlds.End(); ++worldIter )
+	if ( executionMode == TaskExecutionModes::ParallelWorlds && m_worlds.GetSize() > 1 )
+	{
+		Components::BeginParallelUpdate();
+
+		JobCounter counter;
+		for ( DynamicArray< WorldPtr >::Iterator worldIter = m_worlds.Begin(); worldIter != m_worlds.End(); ++worldIter )
+		{
+			pJobManager->Spawn( ProcessDeferredDestroysJob, worldIter->Get(), counter );
+		}
+
+		pJobManager->Wait( counter );
+
+		Components::EndParallelUpdate();
+	}
+	else
 	{
-		for ( size_t sliceIndex = 0; sliceIndex < (*worldIter)->GetSliceCount(); ++sliceIndex )
+		for ( DynamicArray< WorldPtr >::Iterator worldIter = m_worlds.Begin(); worldIter != m_worlds.End(); ++worldIter )
 		{
-			Slice *pSlice = (*worldIter)->GetSlice( sliceIndex );
-			for ( size_t entityIndex = 0; entityIndex < pSlice->GetEntityCount(); ++entityIndex )
-			{
-				Entity *pEntity = pSlice->GetEntity( entityIndex );
-
-				if ( pEntity->IsDeferredDestroySet() )
-				{
-					// TODO: I don't like that strong pointers might be holding these references alive.. need to find a way to fix this
-					pSlice->DestroyEntity( pEntity );
-				}
-			}
+			(*worldIter)->ProcessDeferredDestroys();
 		}
 	}
 }
@@ -36,6 +36,9 @@ namespace Helium
 		/// @name Updating
 		//@{
 		void Update( TaskSchedule &schedule );
+
+		inline TaskExecutionMode GetTaskExecutionMode() const;
+		inline void SetTaskExecutionMode( TaskExecutionMode mode );
 		//@}
 
 		/// @name Timing
@@ -69,6 +72,8 @@ namespace Helium
 
 		/// True if the first frame has been processed.
 		bool m_bProcessedFirstFrame;
+		/// How tasks are distributed across threads during updates.
+		TaskExecutionMode m_taskExecutionMode;
 
 		/// Singleton instance.
 		static WorldManager* sm_pInstance;
@@ -35,4 +35,26 @@ namespace Helium
     {
         return m_frameDeltaSeconds;
     }
-}
\ No newline at end of file
+
+    /// Get how tasks are distributed across threads during Update().
+    ///
+    /// @return  Current task execution mode.
+    ///
+    /// @see SetTaskExecutionMode()
+    TaskExecutionMode WorldManager::GetTaskExecutionMode() const
+    {
+        return m_taskExecutionMode;
+    }
+
+    /// Set how tasks are distributed across threads during Update().
+    ///
+    /// Parallel modes require the JobManager to be running; if it is not, tasks are always run serially.
+    ///
+    /// @param[in] mode  Task execution mode to use for subsequent updates.
+    ///
+    /// @see GetTaskExecutionMode()
+    void WorldManager::SetTaskExecutionMode( TaskExecutionMode mode )
+    {
+        m_taskExecutionMode = mode;
+    }
+}
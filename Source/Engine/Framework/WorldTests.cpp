@@ -0,0 +1,240 @@
+#include "Framework/World.h"
+#include "Framework/Components.h"
+#include "Framework/TaskScheduler.h"
+
+#include "Reflect/Registry.h"
+#include "EngineJobs/JobManager.h"
+
+#include "gtest/gtest.h"
+
+using namespace Helium;
+
+namespace
+{
+	/// Tick type of the per-world test tasks (a bit not used by any engine tick type).
+	const uint32_t WORLD_TEST_TICK_TYPE = 1 << 18;
+
+	/// Number of component pointers each world keeps pointed at its own components.
+	const size_t WORLD_TEST_SLOT_COUNT = 32;
+	/// Number of components allocated, pointed to and freed by each world per frame.
+	const size_t WORLD_TEST_CHURN_COUNT = 2000;
+	/// Number of frames ticked.
+	const size_t WORLD_TEST_FRAME_COUNT = 20;
+
+	struct WorldTestComponent : public Component
+	{
+		HELIUM_DECLARE_COMPONENT( WorldTestComponent, Helium::Component );
+		static void PopulateMetaType( Reflect::MetaStruct& comp ) { }
+
+		uint32_t m_Tag;
+	};
+
+	HELIUM_DEFINE_COMPONENT( WorldTestComponent, 64 );
+
+	/// What a world's tasks have done to its components.
+	struct WorldTestState
+	{
+		World *m_pWorld;
+		uint32_t m_Tag;
+		ComponentPtr< WorldTestComponent > m_Slots[ WORLD_TEST_SLOT_COUNT ];
+		ComponentPtr< WorldTestComponent > m_StaleSlot;
+		size_t m_StalePointerCount;
+		size_t m_ForeignComponentCount;
+		size_t m_VerifiedFrameCount;
+	};
+
+	WorldTestState g_WorldTestStates[ 2 ];
+
+	WorldTestState &GetWorldTestState( World *pWorld )
+	{
+		for ( size_t stateIndex = 0; stateIndex < HELIUM_ARRAY_COUNT( g_WorldTestStates ); ++stateIndex )
+		{
+			if ( g_WorldTestStates[ stateIndex ].m_pWorld == pWorld )
+			{
+				return g_WorldTestStates[ stateIndex ];
+			}
+		}
+
+		HELIUM_ASSERT_MSG( false, "World has no test state" );
+		return g_WorldTestStates[ 0 ];
+	}
+
+	/// Replace the world's components one at a time, pointing the world's component pointers at each new component and
+	/// checking that a pointer to the freed one goes stale. Every assignment links or unlinks a pointer in the shared
+	/// component pointer registry.
+	void ChurnWorldComponents( DynamicArray< WorldPtr > &rWorlds )
+	{
+		for ( size_t worldIndex = 0; worldIndex < rWorlds.GetSize(); ++worldIndex )
+		{
+			World *pWorld = rWorlds[ worldIndex ].Get();
+			WorldTestState &rState = GetWorldTestState( pWorld );
+			ComponentManager *pComponentManager = pWorld->GetComponentManager();
+
+			for ( size_t churnIndex = 0; churnIndex < WORLD_TEST_CHURN_COUNT; ++churnIndex )
+			{
+				ComponentPtr< WorldTestComponent > &rSlot = rState.m_Slots[ churnIndex % WORLD_TEST_SLOT_COUNT ];
+				WorldTestComponent *pOldComponent = rSlot.Get();
+
+				WorldTestComponent *pNewComponent =
+					pComponentManager->Allocate< WorldTestComponent >( pWorld, pWorld->GetComponents() );
+				HELIUM_ASSERT( pNewComponent );
+				pNewComponent->m_Tag = rState.m_Tag;
+				rSlot = pNewComponent;
+
+				if ( pOldComponent )
+				{
+					rState.m_StaleSlot = pOldComponent;
+					pOldComponent->FreeComponent();
+					if ( rState.m_StaleSlot.IsGood() )
+					{
+						++rState.m_StalePointerCount;
+					}
+				}
+			}
+		}
+	}
+
+	/// Check that the world only sees its own components (runs after the churn task on the same world).
+	void VerifyWorldComponents( DynamicArray< WorldPtr > &rWorlds )
+	{
+		for ( size_t worldIndex = 0; worldIndex < rWorlds.GetSize(); ++worldIndex )
+		{
+			World *pWorld = rWorlds[ worldIndex ].Get();
+			WorldTestState &rState = GetWorldTestState( pWorld );
+
+			for ( size_t slotIndex = 0; slotIndex < WORLD_TEST_SLOT_COUNT; ++slotIndex )
+			{
+				WorldTestComponent *pComponent = rState.m_Slots[ slotIndex ].Get();
+				if ( !pComponent || pComponent->GetWorld() != pWorld || pComponent->m_Tag != rState.m_Tag )
+				{
+					++rState.m_ForeignComponentCount;
+				}
+			}
+
+			++rState.m_VerifiedFrameCount;
+		}
+	}
+
+	struct ChurnWorldComponentsTask : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( ChurnWorldComponentsTask );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.SetWorldAffinity( WorldAffinities::PerWorld );
+			rContract.AccessesNoSharedData();
+		}
+	};
+
+	struct VerifyWorldComponentsTask : public TaskDefinition
+	{
+		HELIUM_DECLARE_TASK( VerifyWorldComponentsTask );
+		virtual void DefineContract( TaskContract &rContract )
+		{
+			rContract.SetWorldAffinity( WorldAffinities::PerWorld );
+			rContract.ExecuteAfter< ChurnWorldComponentsTask >();
+			rContract.AccessesNoSharedData();
+		}
+	};
+
+	HELIUM_DEFINE_TASK( ChurnWorldComponentsTask, ChurnWorldComponents, static_cast< TickType >( WORLD_TEST_TICK_TYPE ) );
+	HELIUM_DEFINE_TASK( VerifyWorldComponentsTask, VerifyWorldComponents, static_cast< TickType >( WORLD_TEST_TICK_TYPE ) );
+
+	class WorldTest : public testing::Test
+	{
+	protected:
+		DynamicArray< WorldPtr > m_Worlds;
+
+		static void SetUpTestCase()
+		{
+			Reflect::Startup();
+			Components::Startup( NULL );
+			JobManager::Startup();
+		}
+
+		static void TearDownTestCase()
+		{
+			JobManager::Shutdown();
+			Components::Shutdown();
+			Reflect::Shutdown();
+		}
+
+		void SetUp()
+		{
+			for ( size_t stateIndex = 0; stateIndex < HELIUM_ARRAY_COUNT( g_WorldTestStates ); ++stateIndex )
+			{
+				WorldPtr spWorld( new World );
+				ASSERT_TRUE( spWorld->Initialize() );
+				m_Worlds.Push( spWorld );
+
+				WorldTestState &rState = g_WorldTestStates[ stateIndex ];
+				rState.m_pWorld = spWorld.Get();
+				rState.m_Tag = static_cast< uint32_t >( stateIndex + 1 );
+				rState.m_StalePointerCount = 0;
+				rState.m_ForeignComponentCount = 0;
+				rState.m_VerifiedFrameCount = 0;
+			}
+		}
+
+		void TearDown()
+		{
+			for ( size_t stateIndex = 0; stateIndex < HELIUM_ARRAY_COUNT( g_WorldTestStates ); ++stateIndex )
+			{
+				WorldTestState &rState = g_WorldTestStates[ stateIndex ];
+				for ( size_t slotIndex = 0; slotIndex < WORLD_TEST_SLOT_COUNT; ++slotIndex )
+				{
+					rState.m_Slots[ slotIndex ].Reset();
+				}
+
+				rState.m_StaleSlot.Reset();
+				rState.m_pWorld = NULL;
+			}
+
+			for ( size_t worldIndex = 0; worldIndex < m_Worlds.GetSize(); ++worldIndex )
+			{
+				m_Worlds[ worldIndex ]->Cleanup();
+			}
+
+			m_Worlds.Clear();
+		}
+	};
+}
+
+TEST_F( WorldTest, TwoWorldsTickOnSeparateThreadsWithoutInterfering )
+{
+	JobManager *pJobManager = JobManager::GetInstance();
+	ASSERT_TRUE( pJobManager != NULL );
+
+	TaskSchedule schedule;
+	ASSERT_TRUE( TaskScheduler::CalculateSchedule( WORLD_TEST_TICK_TYPE, schedule ) );
+	ASSERT_EQ( 2u, schedule.m_ScheduleInfo.GetSize() );
+
+	for ( size_t frameIndex = 0; frameIndex < WORLD_TEST_FRAME_COUNT; ++frameIndex )
+	{
+		TaskScheduler::ExecuteSchedulePerWorld( schedule, m_Worlds, *pJobManager );
+		Components::Tick();
+	}
+
+	// Walk every bucket of the component pointer registry, which asserts on any link broken by concurrent updates.
+	for ( size_t tickIndex = 0; tickIndex < HELIUM_COMPONENT_PTR_CHECK_FREQUENCY; ++tickIndex )
+	{
+		Components::Tick();
+	}
+
+	for ( size_t stateIndex = 0; stateIndex < HELIUM_ARRAY_COUNT( g_WorldTestStates ); ++stateIndex )
+	{
+		WorldTestState &rState = g_WorldTestStates[ stateIndex ];
+		EXPECT_EQ( WORLD_TEST_FRAME_COUNT, rState.m_VerifiedFrameCount );
+		EXPECT_EQ( 0u, rState.m_StalePointerCount );
+		EXPECT_EQ( 0u, rState.m_ForeignComponentCount );
+		EXPECT_EQ(
+			WORLD_TEST_SLOT_COUNT,
+			rState.m_pWorld->GetComponentManager()->CountAllocatedComponents< WorldTestComponent >() );
+
+		for ( size_t slotIndex = 0; slotIndex < WORLD_TEST_SLOT_COUNT; ++slotIndex )
+		{
+			ASSERT_TRUE( rState.m_Slots[ slotIndex ].IsGood() );
+			EXPECT_EQ( rState.m_pWorld, rState.m_Slots[ slotIndex ]->GetWorld() );
+			EXPECT_EQ( rState.m_Tag, rState.m_Slots[ slotIndex ]->m_Tag );
+		}
+	}
+}
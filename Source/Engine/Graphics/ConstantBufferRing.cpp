@@ -0,0 +1,234 @@
+#include "Precompile.h"
+#include "Graphics/ConstantBufferRing.h"
+
+#include "Rendering/RConstantBuffer.h"
+#include "Rendering/RFence.h"
+#include "Rendering/RRenderCommandProxy.h"
+#include "Rendering/Renderer.h"
+
+using namespace Helium;
+
+/// Constructor.
+///
+/// @param[in] pageSize  Size of each constant buffer page, in bytes.  Allocations larger than this are given a page of
+///                      their own.
+ConstantBufferRing::ConstantBufferRing( size_t pageSize )
+	: m_pPageData( NULL )
+	, m_pageSize( 0 )
+	, m_pageOffset( 0 )
+	, m_defaultPageSize( Align( Max< size_t >( pageSize, ALLOCATION_ALIGNMENT ), ALLOCATION_ALIGNMENT ) )
+	, m_pageCount( 0 )
+	, m_frameIndex( 0 )
+	, m_bWriting( false )
+{
+}
+
+/// Destructor.
+ConstantBufferRing::~ConstantBufferRing()
+{
+	Shutdown();
+}
+
+/// Begin allocating constant data for a new frame.
+///
+/// This waits for the GPU to finish with the pages allocated the last time the same frame slot was used (if it has
+/// not already done so) and makes them available for reuse.
+///
+/// @see FinishWriting(), EndFrame()
+void ConstantBufferRing::BeginFrame()
+{
+	HELIUM_ASSERT( !m_bWriting );
+
+	m_frameIndex = ( m_frameIndex + 1 ) % FRAME_COUNT;
+	Frame& rFrame = m_frames[ m_frameIndex ];
+
+	if( rFrame.spFence )
+	{
+		Renderer* pRenderer = Renderer::GetInstance();
+		HELIUM_ASSERT( pRenderer );
+		pRenderer->SyncFence( rFrame.spFence );
+		rFrame.spFence.Release();
+	}
+
+	size_t pageCount = rFrame.pages.GetSize();
+	for( size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex )
+	{
+		m_freePages.Push( rFrame.pages[ pageIndex ] );
+	}
+
+	rFrame.pages.Resize( 0 );
+
+	m_pPageData = NULL;
+	m_pageSize = 0;
+	m_pageOffset = 0;
+	m_bWriting = true;
+}
+
+/// Unmap all pages allocated during the current frame.
+///
+/// This must be called once all allocated constant data has been written, and before any of it is used for
+/// rendering.  No further allocations can be made until the next BeginFrame() call.
+///
+/// @see BeginFrame(), EndFrame()
+void ConstantBufferRing::FinishWriting()
+{
+	if( !m_bWriting )
+	{
+		return;
+	}
+
+	Frame& rFrame = m_frames[ m_frameIndex ];
+	size_t pageCount = rFrame.pages.GetSize();
+	for( size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex )
+	{
+		RConstantBuffer* pBuffer = rFrame.pages[ pageIndex ].spBuffer;
+		HELIUM_ASSERT( pBuffer );
+		pBuffer->Unmap();
+	}
+
+	m_pPageData = NULL;
+	m_pageSize = 0;
+	m_pageOffset = 0;
+	m_bWriting = false;
+}
+
+/// Finish the current frame.
+///
+/// A fence is queued after all rendering commands issued so far, and the pages allocated during the frame will not
+/// be reused until it has been reached.
+///
+/// @param[in] pCommandProxy  Command proxy through which all rendering using the current frame's allocations has been
+///                           issued.
+///
+/// @see BeginFrame(), FinishWriting()
+void ConstantBufferRing::EndFrame( RRenderCommandProxy* pCommandProxy )
+{
+	HELIUM_ASSERT( pCommandProxy );
+
+	FinishWriting();
+
+	// Nothing needs to be fenced if no pages were used or the frame has already been ended.
+	Frame& rFrame = m_frames[ m_frameIndex ];
+	if( rFrame.pages.IsEmpty() || rFrame.spFence )
+	{
+		return;
+	}
+
+	Renderer* pRenderer = Renderer::GetInstance();
+	HELIUM_ASSERT( pRenderer );
+
+	RFence* pFence = pRenderer->CreateFence();
+	HELIUM_ASSERT( pFence );
+	rFrame.spFence = pFence;
+
+	pCommandProxy->SetFence( pFence );
+}
+
+/// Release all constant buffer pages and fences.
+///
+/// Pages still referenced by pending rendering commands are kept alive by those commands until they have been
+/// executed.
+void ConstantBufferRing::Shutdown()
+{
+	FinishWriting();
+
+	for( size_t frameIndex = 0; frameIndex < HELIUM_ARRAY_COUNT( m_frames ); ++frameIndex )
+	{
+		Frame& rFrame = m_frames[ frameIndex ];
+		rFrame.pages.Clear();
+		rFrame.spFence.Release();
+	}
+
+	m_freePages.Clear();
+	m_pageCount = 0;
+}
+
+/// Allocate a block of constant data for the current frame.
+///
+/// @param[in]  size      Size of the block, in bytes.
+/// @param[out] rpBuffer  Constant buffer containing the block, to be bound using the returned offset.
+/// @param[out] rOffset   Offset of the block within the constant buffer, in bytes.
+///
+/// @return  Address at which to write the block contents, or null if a constant buffer page could not be created.
+void* ConstantBufferRing::Allocate( size_t size, RConstantBuffer*& rpBuffer, size_t& rOffset )
+{
+	HELIUM_ASSERT( m_bWriting );
+	HELIUM_ASSERT( size != 0 );
+
+	size = Align( size, ALLOCATION_ALIGNMENT );
+
+	if( !m_pPageData || m_pageSize - m_pageOffset < size )
+	{
+		if( !MapNewPage( size ) )
+		{
+			rpBuffer = NULL;
+			rOffset = 0;
+
+			return NULL;
+		}
+	}
+
+	const Frame& rFrame = m_frames[ m_frameIndex ];
+	rpBuffer = rFrame.pages.GetLast().spBuffer;
+	rOffset = m_pageOffset;
+
+	void* pData = m_pPageData + m_pageOffset;
+	m_pageOffset += size;
+
+	return pData;
+}
+
+/// Map a page with room for at least the given number of bytes and make it the current page.
+///
+/// @param[in] size  Minimum page size, in bytes.
+///
+/// @return  True if a page was mapped, false if a page could not be created.
+bool ConstantBufferRing::MapNewPage( size_t size )
+{
+	// Reuse any free page large enough for the allocation, creating a new page only if none is available.
+	Page page;
+	page.size = 0;
+
+	size_t freePageCount = m_freePages.GetSize();
+	for( size_t pageIndex = freePageCount; pageIndex-- != 0; )
+	{
+		if( m_freePages[ pageIndex ].size >= size )
+		{
+			page = m_freePages[ pageIndex ];
+			m_freePages.RemoveSwap( pageIndex );
+
+			break;
+		}
+	}
+
+	if( !page.spBuffer )
+	{
+		Renderer* pRenderer = Renderer::GetInstance();
+		HELIUM_ASSERT( pRenderer );
+
+		page.size = Max( size, m_defaultPageSize );
+		page.spBuffer = pRenderer->CreateConstantBuffer( page.size, RENDERER_BUFFER_USAGE_DYNAMIC );
+		if( !page.spBuffer )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"ConstantBufferRing::MapNewPage(): Failed to create a %" PRIuSZ "-byte constant buffer page.\n",
+				page.size );
+
+			return false;
+		}
+
+		++m_pageCount;
+	}
+
+	void* pMappedData = page.spBuffer->Map( RENDERER_BUFFER_MAP_HINT_DISCARD );
+	HELIUM_ASSERT( pMappedData );
+
+	m_frames[ m_frameIndex ].pages.Push( page );
+
+	m_pPageData = static_cast< uint8_t* >( pMappedData );
+	m_pageSize = page.size;
+	m_pageOffset = 0;
+
+	return true;
+}
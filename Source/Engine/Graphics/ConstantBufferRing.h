@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Graphics/Graphics.h"
+
+#include "Foundation/DynamicArray.h"
+#include "Rendering/RRenderResource.h"
+
+namespace Helium
+{
+	HELIUM_DECLARE_RPTR( RConstantBuffer );
+	HELIUM_DECLARE_RPTR( RFence );
+	HELIUM_DECLARE_RPTR( RRenderCommandProxy );
+
+	/// Per-frame allocator for packing small blocks of shader constants into a few large constant buffers.
+	///
+	/// Blocks are carved linearly out of large constant buffer pages and bound by offset, so each frame only needs
+	/// to map and unmap a handful of buffers regardless of how many blocks it allocates.  The pages used in a frame
+	/// are retired together behind a single fence and are only recycled once that fence has been reached, cycling
+	/// through a fixed number of frames so that no constant data is overwritten while the GPU may still read it.
+	///
+	/// Allocation is not thread-safe, although the memory returned can be filled in from any thread until
+	/// FinishWriting() is called.
+	class HELIUM_GRAPHICS_API ConstantBufferRing : NonCopyable
+	{
+	public:
+		/// Default size of each constant buffer page, in bytes.
+		static const size_t DEFAULT_PAGE_SIZE = 64 * 1024;
+		/// Alignment of each allocation, in bytes (the size of a single four-component float vector).
+		static const size_t ALLOCATION_ALIGNMENT = sizeof( float32_t ) * 4;
+		/// Number of frames through which pages are cycled before being reused.
+		static const size_t FRAME_COUNT = 3;
+
+		/// @name Construction/Destruction
+		//@{
+		explicit ConstantBufferRing( size_t pageSize = DEFAULT_PAGE_SIZE );
+		~ConstantBufferRing();
+		//@}
+
+		/// @name Frame Management
+		//@{
+		void BeginFrame();
+		void FinishWriting();
+		void EndFrame( RRenderCommandProxy* pCommandProxy );
+
+		void Shutdown();
+		//@}
+
+		/// @name Allocation
+		//@{
+		void* Allocate( size_t size, RConstantBuffer*& rpBuffer, size_t& rOffset );
+
+		inline size_t GetPageSize() const;
+		inline size_t GetPageCount() const;
+		//@}
+
+	private:
+		/// Constant buffer page.
+		struct Page
+		{
+			/// Constant buffer.
+			RConstantBufferPtr spBuffer;
+			/// Buffer size, in bytes.
+			size_t size;
+		};
+
+		/// Pages allocated during a single frame.
+		struct Frame
+		{
+			/// Pages in use, in allocation order.
+			DynamicArray< Page > pages;
+			/// Fence set once the frame has been submitted (null if not yet submitted or already reached).
+			RFencePtr spFence;
+		};
+
+		/// Per-frame page lists.
+		Frame m_frames[ FRAME_COUNT ];
+		/// Pages available for reuse.
+		DynamicArray< Page > m_freePages;
+
+		/// Address of the mapped data of the page currently being filled (null if no page is mapped).
+		uint8_t* m_pPageData;
+		/// Size of the page currently being filled.
+		size_t m_pageSize;
+		/// Offset of the next allocation within the page currently being filled.
+		size_t m_pageOffset;
+
+		/// Default page size.
+		size_t m_defaultPageSize;
+		/// Total number of pages created.
+		size_t m_pageCount;
+		/// Index of the current frame.
+		size_t m_frameIndex;
+		/// True if pages in the current frame are mapped for writing.
+		bool m_bWriting;
+
+		/// @name Private Utility Functions
+		//@{
+		bool MapNewPage( size_t size );
+		//@}
+	};
+}
+
+#include "Graphics/ConstantBufferRing.inl"
@@ -0,0 +1,18 @@
+namespace Helium
+{
+    /// Get the default size of each constant buffer page.
+    ///
+    /// @return  Default page size, in bytes.  Pages are only created larger than this to fit oversized allocations.
+    size_t ConstantBufferRing::GetPageSize() const
+    {
+        return m_defaultPageSize;
+    }
+
+    /// Get the total number of constant buffer pages created by this allocator.
+    ///
+    /// @return  Number of pages, both in use and available for reuse.
+    size_t ConstantBufferRing::GetPageCount() const
+    {
+        return m_pageCount;
+    }
+}
@@ -0,0 +1,422 @@
+#include "Graphics/ConstantBufferRing.h"
+
+#include "Foundation/DynamicArray.h"
+#include "Rendering/RConstantBuffer.h"
+#include "Rendering/RFence.h"
+#include "Rendering/RRenderCommandProxy.h"
+#include "Rendering/Renderer.h"
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Page size used by the tests, small enough to fill with a handful of allocations.
+	const size_t TEST_PAGE_SIZE = 1024;
+	/// Number of frames run when checking page reuse, enough to cycle through every frame slot several times.
+	const size_t TEST_FRAME_COUNT = 4 * ConstantBufferRing::FRAME_COUNT;
+
+	/// Fence that is reached once the renderer has synchronized with it.
+	class TestFence : public RFence
+	{
+	public:
+		bool bReached;
+
+		TestFence() : bReached( false ) {}
+	};
+
+	/// Constant buffer backed by system memory that records how it is mapped.
+	class TestConstantBuffer : public RConstantBuffer
+	{
+	public:
+		DynamicArray< uint8_t > data;
+		bool bMapped;
+		size_t mapCount;
+		size_t unmapCount;
+
+		/// Fence set after the last frame using this buffer (null if not in use by a submitted frame).
+		SmartPtr< TestFence > spPendingFence;
+		/// Number of times the buffer was mapped before the GPU was known to be done with it.
+		size_t unsafeMapCount;
+
+		explicit TestConstantBuffer( size_t size )
+			: bMapped( false )
+			, mapCount( 0 )
+			, unmapCount( 0 )
+			, unsafeMapCount( 0 )
+		{
+			data.Resize( size );
+		}
+
+		void* Map( ERendererBufferMapHint /*hint*/ )
+		{
+			if( spPendingFence && !spPendingFence->bReached )
+			{
+				++unsafeMapCount;
+			}
+
+			spPendingFence.Release();
+			bMapped = true;
+			++mapCount;
+
+			return data.GetData();
+		}
+
+		void Unmap()
+		{
+			bMapped = false;
+			++unmapCount;
+		}
+	};
+
+	/// Renderer that only creates constant buffers and fences, registered as the global renderer instance for the
+	/// lifetime of each test.
+	class TestRenderer : public Renderer
+	{
+	public:
+		DynamicArray< SmartPtr< TestConstantBuffer > > buffers;
+		DynamicArray< SmartPtr< TestFence > > fences;
+		size_t syncCount;
+
+		TestRenderer() : syncCount( 0 )
+		{
+			HELIUM_ASSERT( !sm_pInstance );
+			sm_pInstance = this;
+		}
+
+		~TestRenderer()
+		{
+			HELIUM_ASSERT( sm_pInstance == this );
+			sm_pInstance = NULL;
+		}
+
+		bool Initialize() { return true; }
+		void Cleanup() {}
+
+		bool CreateMainContext( const ContextInitParameters& /*rInitParameters*/ ) { return false; }
+		bool ResetMainContext( const ContextInitParameters& /*rInitParameters*/ ) { return false; }
+		RRenderContext* GetMainContext() { return NULL; }
+		RRenderContext* CreateSubContext( const ContextInitParameters& /*rInitParameters*/ ) { return NULL; }
+		EStatus GetStatus() { return STATUS_READY; }
+		EStatus Reset() { return STATUS_READY; }
+
+		RRasterizerState* CreateRasterizerState( const RRasterizerState::Description& /*rDescription*/ ) { return NULL; }
+		RBlendState* CreateBlendState( const RBlendState::Description& /*rDescription*/ ) { return NULL; }
+		RDepthStencilState* CreateDepthStencilState( const RDepthStencilState::Description& /*rDescription*/ ) { return NULL; }
+		RSamplerState* CreateSamplerState( const RSamplerState::Description& /*rDescription*/ ) { return NULL; }
+
+		RSurface* CreateDepthStencilSurface(
+			uint32_t /*width*/, uint32_t /*height*/, ERendererSurfaceFormat /*format*/, uint32_t /*multisampleCount*/ )
+		{
+			return NULL;
+		}
+
+		RVertexShader* CreateVertexShader( size_t /*size*/, const void* /*pData*/ ) { return NULL; }
+		RPixelShader* CreatePixelShader( size_t /*size*/, const void* /*pData*/ ) { return NULL; }
+
+		RVertexBuffer* CreateVertexBuffer( size_t /*size*/, ERendererBufferUsage /*usage*/, const void* /*pData*/ )
+		{
+			return NULL;
+		}
+
+		RIndexBuffer* CreateIndexBuffer(
+			size_t /*size*/, ERendererBufferUsage /*usage*/, ERendererIndexFormat /*format*/, const void* /*pData*/ )
+		{
+			return NULL;
+		}
+
+		RConstantBuffer* CreateConstantBuffer( size_t size, ERendererBufferUsage /*usage*/, const void* /*pData*/ )
+		{
+			TestConstantBuffer* pBuffer = new TestConstantBuffer( size );
+			buffers.Push( pBuffer );
+
+			return pBuffer;
+		}
+
+		RVertexDescription* CreateVertexDescription(
+			const RVertexDescription::Element* /*pElements*/, size_t /*elementCount*/ )
+		{
+			return NULL;
+		}
+
+		RVertexInputLayout* CreateVertexInputLayout( RVertexDescription* /*pDescription*/, RVertexShader* /*pShader*/ )
+		{
+			return NULL;
+		}
+
+		RTexture2d* CreateTexture2d(
+			uint32_t /*width*/, uint32_t /*height*/, uint32_t /*mipCount*/, ERendererPixelFormat /*format*/,
+			ERendererBufferUsage /*usage*/, const RTexture2d::CreateData* /*pData*/ )
+		{
+			return NULL;
+		}
+
+		RFence* CreateFence()
+		{
+			TestFence* pFence = new TestFence;
+			fences.Push( pFence );
+
+			return pFence;
+		}
+
+		void SyncFence( RFence* pFence )
+		{
+			HELIUM_ASSERT( pFence );
+			static_cast< TestFence* >( pFence )->bReached = true;
+			++syncCount;
+		}
+
+		bool TrySyncFence( RFence* pFence )
+		{
+			HELIUM_ASSERT( pFence );
+			return static_cast< TestFence* >( pFence )->bReached;
+		}
+
+		RRenderCommandProxy* GetImmediateCommandProxy() { return NULL; }
+		RRenderCommandProxy* CreateDeferredCommandProxy() { return NULL; }
+
+		void Flush() {}
+	};
+
+	/// Command proxy that only counts the fences set through it.
+	class FenceCommandProxy : public RRenderCommandProxy
+	{
+	public:
+		size_t fenceCount;
+
+		FenceCommandProxy() : fenceCount( 0 ) {}
+
+		void SetRasterizerState( RRasterizerState* /*pState*/ ) {}
+		void SetBlendState( RBlendState* /*pState*/ ) {}
+		void SetDepthStencilState( RDepthStencilState* /*pState*/, uint8_t /*stencilReferenceValue*/ ) {}
+		void SetSamplerStates( size_t /*startIndex*/, size_t /*samplerCount*/, RSamplerState* const* /*ppStates*/ ) {}
+
+		void SetRenderSurfaces( RSurface* /*pRenderTargetSurface*/, RSurface* /*pDepthStencilSurface*/ ) {}
+		void SetViewport( uint32_t /*x*/, uint32_t /*y*/, uint32_t /*width*/, uint32_t /*height*/ ) {}
+
+		void BeginScene() {}
+		void EndScene() {}
+
+		void Clear( uint32_t /*clearFlags*/, const Color& /*rColor*/, float32_t /*depth*/, uint8_t /*stencil*/ ) {}
+
+		void SetIndexBuffer( RIndexBuffer* /*pBuffer*/ ) {}
+		void SetVertexBuffers(
+			size_t /*startIndex*/, size_t /*bufferCount*/, RVertexBuffer* const* /*ppBuffers*/, uint32_t* /*pStrides*/,
+			uint32_t* /*pOffsets*/ )
+		{
+		}
+		void SetVertexInputLayout( RVertexInputLayout* /*pLayout*/ ) {}
+
+		void SetVertexShader( RVertexShader* /*pShader*/ ) {}
+		void SetPixelShader( RPixelShader* /*pShader*/ ) {}
+
+		void SetVertexConstantBuffers(
+			size_t /*startIndex*/, size_t /*bufferCount*/, RConstantBuffer* const* /*ppBuffers*/,
+			const size_t* /*pLimitSizes*/, const size_t* /*pOffsets*/ )
+		{
+		}
+		void SetPixelConstantBuffers(
+			size_t /*startIndex*/, size_t /*bufferCount*/, RConstantBuffer* const* /*ppBuffers*/,
+			const size_t* /*pLimitSizes*/, const size_t* /*pOffsets*/ )
+		{
+		}
+
+		void SetTexture( size_t /*samplerIndex*/, RTexture* /*pTexture*/ ) {}
+
+		void DrawIndexed(
+			ERendererPrimitiveType /*primitiveType*/, uint32_t /*baseVertexIndex*/, uint32_t /*minIndex*/,
+			uint32_t /*usedVertexCount*/, uint32_t /*startIndex*/, uint32_t /*primitiveCount*/ )
+		{
+		}
+		void DrawUnindexed(
+			ERendererPrimitiveType /*primitiveType*/, uint32_t /*baseVertexIndex*/, uint32_t /*primitiveCount*/ )
+		{
+		}
+
+		void SetFence( RFence* pFence )
+		{
+			HELIUM_ASSERT( pFence );
+			++fenceCount;
+		}
+
+		void UnbindResources() {}
+
+		void ExecuteCommandList( RRenderCommandList* /*pCommandList*/ ) {}
+		void FinishCommandList( RRenderCommandListPtr& /*rspCommandList*/ ) {}
+	};
+
+	class ConstantBufferRingTest : public testing::Test
+	{
+	protected:
+		// The renderer must outlive the ring, which releases its pages on destruction.
+		TestRenderer m_renderer;
+		SmartPtr< FenceCommandProxy > m_spCommandProxy;
+		ConstantBufferRing m_ring;
+
+		ConstantBufferRingTest()
+			: m_spCommandProxy( new FenceCommandProxy )
+			, m_ring( TEST_PAGE_SIZE )
+		{
+		}
+
+		/// Allocate a block, filling it in to check that the memory returned is writable.
+		TestConstantBuffer* Allocate( size_t size, size_t& rOffset )
+		{
+			RConstantBuffer* pBuffer = NULL;
+			void* pData = m_ring.Allocate( size, pBuffer, rOffset );
+			EXPECT_TRUE( pData != NULL );
+			EXPECT_TRUE( pBuffer != NULL );
+			if( !pData || !pBuffer )
+			{
+				return NULL;
+			}
+
+			TestConstantBuffer* pTestBuffer = static_cast< TestConstantBuffer* >( pBuffer );
+			EXPECT_TRUE( pTestBuffer->bMapped );
+			EXPECT_LE( rOffset + size, pTestBuffer->data.GetSize() );
+			EXPECT_EQ( pTestBuffer->data.GetData() + rOffset, pData );
+			memset( pData, 0xcd, size );
+
+			return pTestBuffer;
+		}
+	};
+}
+
+TEST_F( ConstantBufferRingTest, PacksAllocationsIntoPages )
+{
+	m_ring.BeginFrame();
+
+	const size_t allocationSize = 60;
+	const size_t alignedSize = Align( allocationSize, ConstantBufferRing::ALLOCATION_ALIGNMENT );
+	const size_t allocationsPerPage = TEST_PAGE_SIZE / alignedSize;
+
+	TestConstantBuffer* pFirstBuffer = NULL;
+	for( size_t allocationIndex = 0; allocationIndex < allocationsPerPage; ++allocationIndex )
+	{
+		size_t offset = 0;
+		TestConstantBuffer* pBuffer = Allocate( allocationSize, offset );
+		ASSERT_TRUE( pBuffer != NULL );
+		if( !pFirstBuffer )
+		{
+			pFirstBuffer = pBuffer;
+		}
+
+		EXPECT_EQ( pFirstBuffer, pBuffer );
+		EXPECT_EQ( allocationIndex * alignedSize, offset );
+	}
+
+	EXPECT_EQ( 1u, m_ring.GetPageCount() );
+	EXPECT_EQ( 1u, pFirstBuffer->mapCount );
+
+	// The next allocation no longer fits, so it starts a new page.
+	size_t offset = 0;
+	TestConstantBuffer* pBuffer = Allocate( allocationSize, offset );
+	EXPECT_NE( pFirstBuffer, pBuffer );
+	EXPECT_EQ( 0u, offset );
+	EXPECT_EQ( 2u, m_ring.GetPageCount() );
+
+	m_ring.EndFrame( m_spCommandProxy );
+}
+
+TEST_F( ConstantBufferRingTest, NoPageIsReusedBeforeItsFence )
+{
+	const size_t pagesPerFrame = 2;
+
+	for( size_t frameIndex = 0; frameIndex < TEST_FRAME_COUNT; ++frameIndex )
+	{
+		m_ring.BeginFrame();
+
+		DynamicArray< TestConstantBuffer* > frameBuffers;
+		for( size_t pageIndex = 0; pageIndex < pagesPerFrame; ++pageIndex )
+		{
+			size_t offset = 0;
+			TestConstantBuffer* pBuffer = Allocate( TEST_PAGE_SIZE, offset );
+			ASSERT_TRUE( pBuffer != NULL );
+			EXPECT_EQ( 0u, offset );
+			frameBuffers.Push( pBuffer );
+		}
+
+		size_t fenceCount = m_renderer.fences.GetSize();
+		m_ring.EndFrame( m_spCommandProxy );
+		ASSERT_EQ( fenceCount + 1, m_renderer.fences.GetSize() );
+		EXPECT_EQ( frameIndex + 1, m_spCommandProxy->fenceCount );
+
+		// Pages may only be mapped again once the GPU has passed the fence queued after the commands using them.
+		for( size_t bufferIndex = 0; bufferIndex < frameBuffers.GetSize(); ++bufferIndex )
+		{
+			EXPECT_FALSE( frameBuffers[ bufferIndex ]->bMapped );
+			frameBuffers[ bufferIndex ]->spPendingFence = m_renderer.fences[ fenceCount ];
+		}
+	}
+
+	for( size_t bufferIndex = 0; bufferIndex < m_renderer.buffers.GetSize(); ++bufferIndex )
+	{
+		EXPECT_EQ( 0u, m_renderer.buffers[ bufferIndex ]->unsafeMapCount ) << "Buffer " << bufferIndex;
+	}
+
+	// Pages are recycled once each frame slot comes around again rather than created every frame, and only the fences
+	// of recycled frames had to be waited on.
+	EXPECT_EQ( ConstantBufferRing::FRAME_COUNT * pagesPerFrame, m_ring.GetPageCount() );
+	EXPECT_EQ( m_ring.GetPageCount(), m_renderer.buffers.GetSize() );
+	EXPECT_EQ( TEST_FRAME_COUNT - ConstantBufferRing::FRAME_COUNT, m_renderer.syncCount );
+}
+
+TEST_F( ConstantBufferRingTest, OversizedAllocationsGetTheirOwnPage )
+{
+	m_ring.BeginFrame();
+
+	size_t offset = 0;
+	TestConstantBuffer* pSmallBuffer = Allocate( 64, offset );
+	ASSERT_TRUE( pSmallBuffer != NULL );
+	EXPECT_EQ( TEST_PAGE_SIZE, pSmallBuffer->data.GetSize() );
+
+	TestConstantBuffer* pLargeBuffer = Allocate( 4 * TEST_PAGE_SIZE, offset );
+	ASSERT_TRUE( pLargeBuffer != NULL );
+	EXPECT_NE( pSmallBuffer, pLargeBuffer );
+	EXPECT_EQ( 0u, offset );
+	EXPECT_EQ( 4 * TEST_PAGE_SIZE, pLargeBuffer->data.GetSize() );
+
+	// Nothing else is packed after the oversized block, even though the first page still has room.
+	TestConstantBuffer* pNextBuffer = Allocate( 64, offset );
+	ASSERT_TRUE( pNextBuffer != NULL );
+	EXPECT_NE( pLargeBuffer, pNextBuffer );
+	EXPECT_EQ( TEST_PAGE_SIZE, pNextBuffer->data.GetSize() );
+
+	EXPECT_EQ( 3u, m_ring.GetPageCount() );
+	EXPECT_EQ( TEST_PAGE_SIZE, m_ring.GetPageSize() );
+
+	m_ring.EndFrame( m_spCommandProxy );
+}
+
+TEST_F( ConstantBufferRingTest, FinishWritingUnmapsEveryPage )
+{
+	m_ring.BeginFrame();
+
+	for( size_t allocationIndex = 0; allocationIndex < 10; ++allocationIndex )
+	{
+		size_t offset = 0;
+		ASSERT_TRUE( Allocate( TEST_PAGE_SIZE / 4, offset ) != NULL );
+	}
+
+	ASSERT_EQ( 3u, m_renderer.buffers.GetSize() );
+
+	m_ring.FinishWriting();
+	for( size_t bufferIndex = 0; bufferIndex < m_renderer.buffers.GetSize(); ++bufferIndex )
+	{
+		TestConstantBuffer* pBuffer = m_renderer.buffers[ bufferIndex ];
+		EXPECT_FALSE( pBuffer->bMapped ) << "Buffer " << bufferIndex;
+		EXPECT_EQ( 1u, pBuffer->mapCount ) << "Buffer " << bufferIndex;
+		EXPECT_EQ( 1u, pBuffer->unmapCount ) << "Buffer " << bufferIndex;
+	}
+
+	// Ending the frame after writing has finished must not unmap anything a second time.
+	m_ring.EndFrame( m_spCommandProxy );
+	EXPECT_EQ( 1u, m_spCommandProxy->fenceCount );
+	for( size_t bufferIndex = 0; bufferIndex < m_renderer.buffers.GetSize(); ++bufferIndex )
+	{
+		EXPECT_EQ( 1u, m_renderer.buffers[ bufferIndex ]->unmapCount ) << "Buffer " << bufferIndex;
+	}
+}
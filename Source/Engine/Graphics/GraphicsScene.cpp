@@ -37,11 +37,140 @@ HELIUM_DEFINE_COMPONENT( Helium::SceneObjectTransform, 32 );
 static const size_t SCENE_VIEW_BUFFERED_DRAWER_POOL_BLOCK_SIZE = 4;
 #endif // GRAPHICS_SCENE_BUFFERED_DRAWER
 
+/// Size of the vertex constants for each static mesh instance (a 4x3 world transform).
+static const size_t INSTANCE_VERTEX_STATIC_DATA_SIZE = sizeof( float32_t ) * 12;
+/// Size of the vertex constants for each skinned sub-mesh instance (a 4x3 transform for each bone).
+static const size_t INSTANCE_VERTEX_SKINNED_DATA_SIZE = sizeof( float32_t ) * 12 * BONE_COUNT_MAX;
+
+/// Sub-mesh draw key pass identifiers.
+enum EDrawKeyPass
+{
+	DRAW_KEY_PASS_SHADOW_DEPTH,
+	DRAW_KEY_PASS_DEPTH_PRE,
+	DRAW_KEY_PASS_BASE
+};
+
+/// Sub-mesh draw key bit offsets.  Keys are laid out, from the most significant bits down, as the pass (4 bits),
+/// vertex shader variant, pixel shader variant, material, mesh, and coarse depth (12 bits each).  Depth-only passes
+/// store the full 32-bit depth in the lowest bits instead, optionally preceded by the coarse depth and mesh directly
+/// below the pass so that nearby instances of the same mesh still end up next to each other.
+static const uint32_t DRAW_KEY_PASS_SHIFT = 60;
+static const uint32_t DRAW_KEY_VERTEX_SHADER_SHIFT = 48;
+static const uint32_t DRAW_KEY_PIXEL_SHADER_SHIFT = 36;
+static const uint32_t DRAW_KEY_MATERIAL_SHIFT = 24;
+static const uint32_t DRAW_KEY_MESH_SHIFT = 12;
+static const uint32_t DRAW_KEY_DEPTH_ONLY_COARSE_DEPTH_SHIFT = 48;
+static const uint32_t DRAW_KEY_DEPTH_ONLY_MESH_SHIFT = 36;
+
+static const uint32_t DRAW_KEY_SHADER_BITS = 12;
+static const uint32_t DRAW_KEY_MATERIAL_BITS = 12;
+static const uint32_t DRAW_KEY_MESH_BITS = 12;
+static const uint32_t DRAW_KEY_COARSE_DEPTH_BITS = 12;
+
 namespace Helium
 {
 	HELIUM_DECLARE_RPTR( RRenderCommandProxy );
 }
 
+/// Convert a depth value to draw key bits that sort in the same order as the depth values themselves.
+///
+/// @param[in] depth  Depth value.
+///
+/// @return  Depth sort bits.
+static uint32_t GetDrawKeyDepthBits( float32_t depth )
+{
+	union
+	{
+		float32_t f;
+		uint32_t u;
+	} depthBits;
+
+	depthBits.f = depth;
+
+	// Flip all bits of negative values and only the sign bit of positive values.
+	return ( ( depthBits.u & 0x80000000 ) ? ~depthBits.u : ( depthBits.u | 0x80000000 ) );
+}
+
+/// Get the dense draw key ID of a resource, assigning the next free ID if the resource has not been seen yet.
+///
+/// IDs are handed out in the order resources are first encountered, so as long as fewer resources are in use than can
+/// be represented by the given number of bits, every resource gets its own ID.  Any further resources share the
+/// highest ID, which only affects how well their draws are batched.
+///
+/// @param[in] rResourceIds  Map of resource IDs assigned so far.
+/// @param[in] pResource     Resource address (may be null).
+/// @param[in] bitCount      Number of bits available for the ID.
+///
+/// @return  Resource sort bits.
+static uint64_t GetDrawKeyResourceId(
+	HashMap< const void*, uint32_t >& rResourceIds,
+	const void* pResource,
+	uint32_t bitCount )
+{
+	HashMap< const void*, uint32_t >::Iterator idIterator = rResourceIds.Find( pResource );
+	if ( idIterator != rResourceIds.End() )
+	{
+		return idIterator->Second();
+	}
+
+	uint32_t id = Min( static_cast<uint32_t>( rResourceIds.GetSize() ), ( 1U << bitCount ) - 1 );
+	HELIUM_VERIFY( rResourceIds.Insert(
+		idIterator,
+		HashMap< const void*, uint32_t >::ValueType( pResource, id ) ) );
+
+	return id;
+}
+
+/// Reduce the identity of a sub-mesh's geometry to a fixed number of draw key bits.
+///
+/// @param[in] rSceneObject  Scene object to which the sub-mesh belongs.
+/// @param[in] rSubMeshData  Sub-mesh data.
+/// @param[in] bitCount      Number of bits to generate.
+///
+/// @return  Mesh sort bits.
+static uint64_t GetDrawKeyMeshBits(
+	const GraphicsSceneObject& rSceneObject,
+	const GraphicsSceneObject::SubMeshData& rSubMeshData,
+	uint32_t bitCount )
+{
+	uint64_t address = static_cast<uint64_t>( reinterpret_cast<uintptr_t>( rSceneObject.GetIndexBuffer() ) );
+	address += rSubMeshData.GetStartIndex();
+
+	return ( ( address * 0x9e3779b97f4a7c15ULL ) >> ( 64 - bitCount ) );
+}
+
+/// Get whether a sub-mesh draws the same geometry with the same vertex shader variant as another.
+///
+/// Instances of such sub-meshes drawn back to back can share all of their draw state aside from their instance
+/// constants.
+///
+/// @param[in] rSceneObject       Scene object to which the sub-mesh belongs.
+/// @param[in] rSubMeshData       Sub-mesh data.
+/// @param[in] rOtherSceneObject  Scene object to which the other sub-mesh belongs.
+/// @param[in] rOtherSubMeshData  Other sub-mesh data.
+///
+/// @return  True if both sub-meshes share the same mesh draw state, false if not.
+static bool SharesMeshDrawState(
+	const GraphicsSceneObject& rSceneObject,
+	const GraphicsSceneObject::SubMeshData& rSubMeshData,
+	const GraphicsSceneObject& rOtherSceneObject,
+	const GraphicsSceneObject::SubMeshData& rOtherSubMeshData )
+{
+	bool bSkinned = ( rSceneObject.GetBoneCount() != 0 && rSceneObject.GetBonePalette() );
+	bool bOtherSkinned = ( rOtherSceneObject.GetBoneCount() != 0 && rOtherSceneObject.GetBonePalette() );
+
+	return ( rSceneObject.GetVertexBuffer() == rOtherSceneObject.GetVertexBuffer() &&
+		rSceneObject.GetIndexBuffer() == rOtherSceneObject.GetIndexBuffer() &&
+		rSceneObject.GetVertexDescription() == rOtherSceneObject.GetVertexDescription() &&
+		rSceneObject.GetVertexStride() == rOtherSceneObject.GetVertexStride() &&
+		bSkinned == bOtherSkinned &&
+		rSubMeshData.GetPrimitiveType() == rOtherSubMeshData.GetPrimitiveType() &&
+		rSubMeshData.GetPrimitiveCount() == rOtherSubMeshData.GetPrimitiveCount() &&
+		rSubMeshData.GetStartVertex() == rOtherSubMeshData.GetStartVertex() &&
+		rSubMeshData.GetVertexRange() == rOtherSubMeshData.GetVertexRange() &&
+		rSubMeshData.GetStartIndex() == rOtherSubMeshData.GetStartIndex() );
+}
+
 /// Constructor.
 GraphicsScene::GraphicsScene()
 	:
@@ -56,6 +185,8 @@ GraphicsScene::GraphicsScene()
 	, m_directionalLightDirection( 0.0f, -1.0f, 0.0f )
 	, m_directionalLightColor( 0xffffffff )
 	, m_directionalLightBrightness( 1.0f )
+	, m_pCullCandidateBounds( NULL )
+	, m_cullCandidateBoundsCapacity( 0 )
 	, m_activeViewId( Invalid< uint32_t >() )
 	, m_constantBufferSetIndex( 0 )
 {
@@ -67,6 +198,7 @@ GraphicsScene::GraphicsScene()
 /// Destructor.
 GraphicsScene::~GraphicsScene()
 {
+	DefaultAllocator().Free( m_pCullCandidateBounds );
 }
 
 /// Update this graphics scene for the current frame.
@@ -193,6 +325,11 @@ void GraphicsScene::Update( World *pWorld )
 	// Finish drawing with the scene's buffered drawer.
 	m_sceneBufferedDrawer.EndDrawing();
 #endif // GRAPHICS_SCENE_BUFFERED_DRAWER
+
+	// Keep the instance constants written this frame from being reused until the GPU is done with them.
+	RRenderCommandProxyPtr spCommandProxy = pRenderer->GetImmediateCommandProxy();
+	HELIUM_ASSERT( spCommandProxy );
+	m_instanceConstantBufferRing.EndFrame( spCommandProxy );
 }
 
 /// Allocate a new scene view.
@@ -275,9 +412,39 @@ void GraphicsScene::ReleaseSceneObject( size_t id )
 	HELIUM_ASSERT( id < m_sceneObjects.GetSize() );
 	HELIUM_ASSERT( m_sceneObjects.IsElementValid( id ) );
 
+	if ( m_sceneObjectBvh.Contains( id ) )
+	{
+		m_sceneObjectBvh.Remove( id );
+	}
+
 	m_sceneObjects.Remove( id );
 }
 
+/// Set the world-space bounds of a scene object, updating its placement for culling and spatial queries.
+///
+/// Scene objects are not rendered until their bounds have been set using this function.
+///
+/// @param[in] id    ID of the object to update.
+/// @param[in] rBox  World-space axis-aligned bounding box to set.
+///
+/// @see GetSceneObjectBvh()
+void GraphicsScene::SetSceneObjectWorldBounds( size_t id, const Simd::AaBox& rBox )
+{
+	HELIUM_ASSERT( id < m_sceneObjects.GetSize() );
+	HELIUM_ASSERT( m_sceneObjects.IsElementValid( id ) );
+
+	m_sceneObjects[id].SetWorldBounds( rBox );
+
+	if ( m_sceneObjectBvh.Contains( id ) )
+	{
+		m_sceneObjectBvh.Update( id, rBox );
+	}
+	else
+	{
+		m_sceneObjectBvh.Insert( id, rBox );
+	}
+}
+
 /// Allocate new scene object sub-mesh data and add it to the scene.
 ///
 /// @param[in] sceneObjectId  ID of the parent graphics scene object used to control the placement of the sub-mesh
@@ -918,12 +1085,9 @@ void GraphicsScene::SwapDynamicConstantBuffers()
 		}
 	}
 
-	// Map each instance constant buffer for updating.
-	DynamicArray< RConstantBufferPtr >& rStaticInstanceVertexGlobalDataBufferPool =
-		m_staticInstanceVertexGlobalDataBufferPool[bufferSetIndex];
-	DynamicArray< RConstantBufferPtr >& rSkinnedInstanceVertexGlobalDataBufferPool =
-		m_skinnedInstanceVertexGlobalDataBufferPool[bufferSetIndex];
-	HELIUM_UNREF( rSkinnedInstanceVertexGlobalDataBufferPool );
+	// Allocate instance constants for the current frame.  All instance constants are packed into a few large
+	// constant buffers and bound by offset, so only those buffers need to be mapped and unmapped each frame.
+	m_instanceConstantBufferRing.BeginFrame();
 
 	size_t sceneObjectCount = m_sceneObjects.GetSize();
 	size_t instanceBufferCount = m_objectVertexGlobalDataBuffers.GetSize();
@@ -931,6 +1095,7 @@ void GraphicsScene::SwapDynamicConstantBuffers()
 	{
 		MemoryZero( m_objectVertexGlobalDataBuffers.GetData(), instanceBufferCount * sizeof( RConstantBuffer* ) );
 		m_objectVertexGlobalDataBuffers.Add( NULL, sceneObjectCount - instanceBufferCount );
+		m_objectVertexGlobalDataOffsets.Add( 0, sceneObjectCount - instanceBufferCount );
 	}
 	else
 	{
@@ -954,6 +1119,7 @@ void GraphicsScene::SwapDynamicConstantBuffers()
 	{
 		MemoryZero( m_subMeshVertexGlobalDataBuffers.GetData(), instanceBufferCount * sizeof( RConstantBuffer* ) );
 		m_subMeshVertexGlobalDataBuffers.Add( NULL, subMeshCount - instanceBufferCount );
+		m_subMeshVertexGlobalDataOffsets.Add( 0, subMeshCount - instanceBufferCount );
 	}
 	else
 	{
@@ -971,10 +1137,6 @@ void GraphicsScene::SwapDynamicConstantBuffers()
 		MemoryZero( m_mappedSubMeshVertexGlobalDataBuffers.GetData(), subMeshCount * sizeof( float32_t* ) );
 	}
 
-	size_t staticBufferIndex = 0;
-	size_t skinnedBufferIndex = 0;
-	HELIUM_UNREF( skinnedBufferIndex );
-
 	for ( size_t subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex )
 	{
 		if ( !m_sceneObjectSubMeshes.IsElementValid( subMeshIndex ) )
@@ -987,104 +1149,59 @@ void GraphicsScene::SwapDynamicConstantBuffers()
 		size_t sceneObjectIndex = rSubMesh.GetSceneObjectId();
 		HELIUM_ASSERT( sceneObjectIndex < sceneObjectCount );
 
-		// If the main scene object for the sub mesh already has a constant buffer assigned, we know it is a static
-		// mesh that has already been processed, so we can skip it.
+		// If the main scene object for the sub mesh already has constants allocated, we know it is a static mesh
+		// that has already been processed, so we can skip it.
 		if ( m_objectVertexGlobalDataBuffers[sceneObjectIndex] )
 		{
 			continue;
 		}
 
-		// Determine whether the object should be rendered as a static mesh (vertex constant buffer per scene
-		// object) or skinned mesh (vertex constant buffer per sub-mesh).
+		// Determine whether the object should be rendered as a static mesh (vertex constants per scene object) or
+		// skinned mesh (vertex constants per sub-mesh).
 		HELIUM_ASSERT( m_sceneObjects.IsElementValid( sceneObjectIndex ) );
 		GraphicsSceneObject& rSceneObject = m_sceneObjects[sceneObjectIndex];
 
 		RConstantBuffer* pBuffer = NULL;
+		size_t offset = 0;
 
 		uint_fast8_t boneCount = rSceneObject.GetBoneCount();
-		if ( boneCount != 0 )
-		{
-			const Simd::Matrix44* pBonePalette = rSceneObject.GetBonePalette();
-			if ( pBonePalette )
-			{
-				const uint8_t* pSkinningPaletteMap = rSubMesh.GetSkinningPaletteMap();
-				if ( pSkinningPaletteMap )
-				{
-					RConstantBuffer* pBuffer;
-					if ( skinnedBufferIndex < rSkinnedInstanceVertexGlobalDataBufferPool.GetSize() )
-					{
-						pBuffer = rSkinnedInstanceVertexGlobalDataBufferPool[skinnedBufferIndex];
-						HELIUM_ASSERT( pBuffer );
-					}
-					else
-					{
-						HELIUM_ASSERT( skinnedBufferIndex == rSkinnedInstanceVertexGlobalDataBufferPool.GetSize() );
-
-						pBuffer = pRenderer->CreateConstantBuffer(
-							sizeof( float32_t ) * 12 * BONE_COUNT_MAX,
-							RENDERER_BUFFER_USAGE_DYNAMIC );
-						if ( !pBuffer )
-						{
-							HELIUM_TRACE(
-								TraceLevels::Error,
-								"GraphicsScene::SwapDynamicConstantBuffers(): Skinned mesh instance vertex constant global data buffer creation failed!\n" );
-						}
-						else
-						{
-							rSkinnedInstanceVertexGlobalDataBufferPool.Push( pBuffer );
-						}
-					}
-
-					if ( pBuffer )
-					{
-						++skinnedBufferIndex;
-
-						m_subMeshVertexGlobalDataBuffers[subMeshIndex] = pBuffer;
-
-						void* pMappedData = pBuffer->Map( RENDERER_BUFFER_MAP_HINT_DISCARD );
-						HELIUM_ASSERT( pMappedData );
-						m_mappedSubMeshVertexGlobalDataBuffers[subMeshIndex] =
-							static_cast<float32_t*>( pMappedData );
-
-						continue;
-					}
-				}
-			}
-		}
-
-		// Instance data not mapped as a skinned mesh, so map as a static mesh.
-		if ( staticBufferIndex < rStaticInstanceVertexGlobalDataBufferPool.GetSize() )
-		{
-			pBuffer = rStaticInstanceVertexGlobalDataBufferPool[staticBufferIndex];
-			HELIUM_ASSERT( pBuffer );
-		}
-		else
+		if ( boneCount != 0 && rSceneObject.GetBonePalette() && rSubMesh.GetSkinningPaletteMap() )
 		{
-			HELIUM_ASSERT( staticBufferIndex == rStaticInstanceVertexGlobalDataBufferPool.GetSize() );
-
-			pBuffer = pRenderer->CreateConstantBuffer(
-				sizeof( float32_t ) * 12,
-				RENDERER_BUFFER_USAGE_DYNAMIC );
-			if ( !pBuffer )
+			void* pMappedData = m_instanceConstantBufferRing.Allocate(
+				INSTANCE_VERTEX_SKINNED_DATA_SIZE,
+				pBuffer,
+				offset );
+			if ( !pMappedData )
 			{
 				HELIUM_TRACE(
 					TraceLevels::Error,
-					"GraphicsScene::SwapDynamicConstantBuffers(): Static mesh instance vertex constant global data buffer creation failed!\n" );
+					"GraphicsScene::SwapDynamicConstantBuffers(): Skinned mesh instance vertex constant global data allocation failed!\n" );
 			}
 			else
 			{
-				rStaticInstanceVertexGlobalDataBufferPool.Push( pBuffer );
+				m_subMeshVertexGlobalDataBuffers[subMeshIndex] = pBuffer;
+				m_subMeshVertexGlobalDataOffsets[subMeshIndex] = offset;
+				m_mappedSubMeshVertexGlobalDataBuffers[subMeshIndex] = static_cast<float32_t*>( pMappedData );
+
+				continue;
 			}
 		}
 
-		if ( pBuffer )
+		// Instance data not allocated as a skinned mesh, so allocate as a static mesh.
+		void* pMappedData = m_instanceConstantBufferRing.Allocate(
+			INSTANCE_VERTEX_STATIC_DATA_SIZE,
+			pBuffer,
+			offset );
+		if ( !pMappedData )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Error,
+				"GraphicsScene::SwapDynamicConstantBuffers(): Static mesh instance vertex constant global data allocation failed!\n" );
+		}
+		else
 		{
-			++staticBufferIndex;
-
 			m_objectVertexGlobalDataBuffers[sceneObjectIndex] = pBuffer;
-
-			void* pMappedData = pBuffer->Map( RENDERER_BUFFER_MAP_HINT_DISCARD );
-			HELIUM_ASSERT( pMappedData );
+			m_objectVertexGlobalDataOffsets[sceneObjectIndex] = offset;
 			m_mappedObjectVertexGlobalDataBuffers[sceneObjectIndex] = static_cast<float32_t*>( pMappedData );
 		}
 	}
@@ -1102,24 +1219,345 @@ void GraphicsScene::SwapDynamicConstantBuffers()
 		job.Run();
 	}
 
-	// Unmap the constant buffers.
-	for ( size_t objectIndex = 0; objectIndex < sceneObjectCount; ++objectIndex )
+	// Unmap the instance constant buffers.
+	m_instanceConstantBufferRing.FinishWriting();
+}
+
+/// Sort the visible sub-mesh list from front to back along a given direction.
+///
+/// @param[in] pass          Draw key pass identifier.
+/// @param[in] rDirection    World-space direction along which to sort.
+/// @param[in] bGroupMeshes  True to sort sub-meshes into coarse depth ranges first, keeping instances of the same mesh
+///                          within each range together so that they can be drawn back to back, or false to sort
+///                          strictly by depth.
+///
+/// @see SortSubMeshesByMaterial()
+void GraphicsScene::SortSubMeshesFrontToBack( uint32_t pass, const Simd::Vector3& rDirection, bool bGroupMeshes )
+{
+	size_t subMeshIndexCount = m_sceneObjectSubMeshIndices.GetSize();
+	m_sceneObjectSubMeshSortKeys.Resize( subMeshIndexCount );
+
+	uint64_t passBits = static_cast<uint64_t>( pass ) << DRAW_KEY_PASS_SHIFT;
+	for ( size_t meshIndexIndex = 0; meshIndexIndex < subMeshIndexCount; ++meshIndexIndex )
 	{
-		if ( m_mappedObjectVertexGlobalDataBuffers[objectIndex] )
+		const GraphicsSceneObject::SubMeshData& rSubMeshData =
+			m_sceneObjectSubMeshes[m_sceneObjectSubMeshIndices[meshIndexIndex]];
+		const GraphicsSceneObject& rSceneObject = m_sceneObjects[rSubMeshData.GetSceneObjectId()];
+
+		Simd::Vector3 position = Simd::Vector4ToVector3( rSceneObject.GetTransform().GetRow( 3 ) );
+		uint32_t depthBits = GetDrawKeyDepthBits( position.Dot( rDirection ) );
+
+		uint64_t key = passBits | depthBits;
+		if ( bGroupMeshes )
 		{
-			RConstantBuffer* pBuffer = m_objectVertexGlobalDataBuffers[objectIndex];
-			HELIUM_ASSERT( pBuffer );
-			pBuffer->Unmap();
+			key |=
+				( static_cast<uint64_t>( depthBits >> ( 32 - DRAW_KEY_COARSE_DEPTH_BITS ) ) <<
+					DRAW_KEY_DEPTH_ONLY_COARSE_DEPTH_SHIFT ) |
+				( GetDrawKeyMeshBits( rSceneObject, rSubMeshData, DRAW_KEY_MESH_BITS ) << DRAW_KEY_DEPTH_ONLY_MESH_SHIFT );
 		}
+
+		m_sceneObjectSubMeshSortKeys[meshIndexIndex] = key;
 	}
 
-	for ( size_t subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex )
+	SortSubMeshIndices();
+}
+
+/// Sort the visible sub-mesh list by shader, material, and mesh, and from front to back for each mesh.
+///
+/// @param[in] pass            Draw key pass identifier.
+/// @param[in] rViewDirection  World-space view direction.
+///
+/// @see SortSubMeshesFrontToBack()
+void GraphicsScene::SortSubMeshesByMaterial( uint32_t pass, const Simd::Vector3& rViewDirection )
+{
+	size_t subMeshIndexCount = m_sceneObjectSubMeshIndices.GetSize();
+	m_sceneObjectSubMeshSortKeys.Resize( subMeshIndexCount );
+
+	// Shader variants and materials are given dense IDs each time the list is sorted, so distinct resources never
+	// share key bits unless more of them are in use than the key can represent.
+	m_vertexShaderDrawKeyIds.Clear();
+	m_pixelShaderDrawKeyIds.Clear();
+	m_materialDrawKeyIds.Clear();
+
+	uint64_t passBits = static_cast<uint64_t>( pass ) << DRAW_KEY_PASS_SHIFT;
+	for ( size_t meshIndexIndex = 0; meshIndexIndex < subMeshIndexCount; ++meshIndexIndex )
+	{
+		const GraphicsSceneObject::SubMeshData& rSubMeshData =
+			m_sceneObjectSubMeshes[m_sceneObjectSubMeshIndices[meshIndexIndex]];
+		const GraphicsSceneObject& rSceneObject = m_sceneObjects[rSubMeshData.GetSceneObjectId()];
+
+		Material* pMaterial = rSubMeshData.GetMaterial();
+		ShaderVariant* pVertexShaderVariant = NULL;
+		ShaderVariant* pPixelShaderVariant = NULL;
+		if ( pMaterial )
+		{
+			pVertexShaderVariant = pMaterial->GetShaderVariant( RShader::TYPE_VERTEX );
+			pPixelShaderVariant = pMaterial->GetShaderVariant( RShader::TYPE_PIXEL );
+		}
+
+		Simd::Vector3 position = Simd::Vector4ToVector3( rSceneObject.GetTransform().GetRow( 3 ) );
+		uint32_t depthBits = GetDrawKeyDepthBits( position.Dot( rViewDirection ) );
+
+		m_sceneObjectSubMeshSortKeys[meshIndexIndex] =
+			passBits |
+			( GetDrawKeyResourceId( m_vertexShaderDrawKeyIds, pVertexShaderVariant, DRAW_KEY_SHADER_BITS ) <<
+				DRAW_KEY_VERTEX_SHADER_SHIFT ) |
+			( GetDrawKeyResourceId( m_pixelShaderDrawKeyIds, pPixelShaderVariant, DRAW_KEY_SHADER_BITS ) <<
+				DRAW_KEY_PIXEL_SHADER_SHIFT ) |
+			( GetDrawKeyResourceId( m_materialDrawKeyIds, pMaterial, DRAW_KEY_MATERIAL_BITS ) << DRAW_KEY_MATERIAL_SHIFT ) |
+			( GetDrawKeyMeshBits( rSceneObject, rSubMeshData, DRAW_KEY_MESH_BITS ) << DRAW_KEY_MESH_SHIFT ) |
+			( depthBits >> ( 32 - DRAW_KEY_COARSE_DEPTH_BITS ) );
+	}
+
+	SortSubMeshIndices();
+}
+
+/// Sort the visible sub-mesh list by the draw keys prepared for each entry.
+///
+/// @see SortSubMeshesFrontToBack(), SortSubMeshesByMaterial()
+void GraphicsScene::SortSubMeshIndices()
+{
+	size_t subMeshIndexCount = m_sceneObjectSubMeshIndices.GetSize();
+	HELIUM_ASSERT( m_sceneObjectSubMeshSortKeys.GetSize() == subMeshIndexCount );
+
+	m_sortScratchKeys.Resize( subMeshIndexCount );
+	m_sortScratchIndices.Resize( subMeshIndexCount );
+
+	RadixSortJob job;
+	RadixSortJob::Parameters& rParameters = job.GetParameters();
+	rParameters.pKeys = m_sceneObjectSubMeshSortKeys.GetData();
+	rParameters.pValues = m_sceneObjectSubMeshIndices.GetData();
+	rParameters.pScratchKeys = m_sortScratchKeys.GetData();
+	rParameters.pScratchValues = m_sortScratchIndices.GetData();
+	rParameters.count = subMeshIndexCount;
+	job.Run();
+}
+
+/// Build the depth-only instance list from the sorted visible sub-mesh list.
+///
+/// Sub-meshes whose instance constants have not been allocated are skipped.
+///
+/// @see DrawDepthOnlyInstances()
+void GraphicsScene::GatherDepthOnlyInstances()
+{
+	size_t subMeshIndexCount = m_sceneObjectSubMeshIndices.GetSize();
+	m_depthOnlyInstances.Resize( 0 );
+	m_depthOnlyInstances.Reserve( subMeshIndexCount );
+
+	for ( size_t meshIndexIndex = 0; meshIndexIndex < subMeshIndexCount; ++meshIndexIndex )
+	{
+		size_t meshIndex = m_sceneObjectSubMeshIndices[meshIndexIndex];
+		HELIUM_ASSERT( m_sceneObjectSubMeshes.IsElementValid( meshIndex ) );
+
+		const GraphicsSceneObject::SubMeshData& rSubMeshData = m_sceneObjectSubMeshes[meshIndex];
+
+		size_t sceneObjectId = rSubMeshData.GetSceneObjectId();
+		HELIUM_ASSERT( IsValid( sceneObjectId ) );
+		HELIUM_ASSERT( sceneObjectId < m_sceneObjects.GetSize() );
+		HELIUM_ASSERT( m_sceneObjects.IsElementValid( sceneObjectId ) );
+
+		HELIUM_ASSERT( meshIndex < m_subMeshVertexGlobalDataBuffers.GetSize() );
+		RConstantBuffer* pInstanceVertexGlobalDataBuffer = m_subMeshVertexGlobalDataBuffers[meshIndex];
+		size_t instanceVertexGlobalDataOffset = m_subMeshVertexGlobalDataOffsets[meshIndex];
+		size_t instanceVertexGlobalDataSize = INSTANCE_VERTEX_SKINNED_DATA_SIZE;
+		if ( !pInstanceVertexGlobalDataBuffer )
+		{
+			HELIUM_ASSERT( sceneObjectId < m_objectVertexGlobalDataBuffers.GetSize() );
+			pInstanceVertexGlobalDataBuffer = m_objectVertexGlobalDataBuffers[sceneObjectId];
+			if ( !pInstanceVertexGlobalDataBuffer )
+			{
+				continue;
+			}
+
+			instanceVertexGlobalDataOffset = m_objectVertexGlobalDataOffsets[sceneObjectId];
+			instanceVertexGlobalDataSize = INSTANCE_VERTEX_STATIC_DATA_SIZE;
+		}
+
+		DepthOnlyInstance* pInstance = m_depthOnlyInstances.New();
+		HELIUM_ASSERT( pInstance );
+		pInstance->pSceneObject = &m_sceneObjects[sceneObjectId];
+		pInstance->pSubMeshData = &rSubMeshData;
+		pInstance->pInstanceDataBuffer = pInstanceVertexGlobalDataBuffer;
+		pInstance->instanceDataOffset = instanceVertexGlobalDataOffset;
+		pInstance->instanceDataSize = instanceVertexGlobalDataSize;
+	}
+}
+
+/// Issue the draw commands for a list of sub-mesh instances in a depth-only pass.
+///
+/// Consecutive instances of the same sub-mesh only differ in their instance constants, so draw state is only resolved
+/// and set for the first instance of each run, and each further instance only costs a constant buffer bind and a
+/// draw.  The blend state, pixel shader, and per-view constants must already be set.
+///
+/// @param[in] pCommandProxy                Command proxy through which to issue the draws.
+/// @param[in] pRenderer                    Renderer used to create vertex input layouts.
+/// @param[in] pNoSkinningVertexShader      Vertex shader for unskinned sub-meshes.
+/// @param[in] pSmoothSkinningVertexShader  Vertex shader for skinned sub-meshes.
+/// @param[in] pInstances                   Instances to draw, in draw order.
+/// @param[in] instanceCount                Number of instances to draw.
+void GraphicsScene::DrawDepthOnlyInstances(
+	RRenderCommandProxy* pCommandProxy,
+	Renderer* pRenderer,
+	RVertexShader* pNoSkinningVertexShader,
+	RVertexShader* pSmoothSkinningVertexShader,
+	const DepthOnlyInstance* pInstances,
+	size_t instanceCount )
+{
+	HELIUM_ASSERT( pCommandProxy );
+	HELIUM_ASSERT( pNoSkinningVertexShader );
+	HELIUM_ASSERT( pSmoothSkinningVertexShader );
+	HELIUM_ASSERT( pInstances || instanceCount == 0 );
+
+	RVertexShader* pPreviousVertexShader = NULL;
+	const DepthOnlyInstance* pRunInstance = NULL;
+
+	for ( size_t instanceIndex = 0; instanceIndex < instanceCount; ++instanceIndex )
+	{
+		const DepthOnlyInstance& rInstance = pInstances[instanceIndex];
+		HELIUM_ASSERT( rInstance.pSceneObject );
+		HELIUM_ASSERT( rInstance.pSubMeshData );
+
+		const GraphicsSceneObject& rSceneObject = *rInstance.pSceneObject;
+		const GraphicsSceneObject::SubMeshData& rSubMeshData = *rInstance.pSubMeshData;
+
+		if ( !pRunInstance ||
+			!SharesMeshDrawState( rSceneObject, rSubMeshData, *pRunInstance->pSceneObject, *pRunInstance->pSubMeshData ) )
+		{
+			RVertexBuffer* pVertexBuffer = rSceneObject.GetVertexBuffer();
+			if ( !pVertexBuffer )
+			{
+				continue;
+			}
+
+			RVertexDescription* pVertexDescription = rSceneObject.GetVertexDescription();
+			if ( !pVertexDescription )
+			{
+				continue;
+			}
+
+			RIndexBuffer* pIndexBuffer = rSceneObject.GetIndexBuffer();
+			if ( !pIndexBuffer )
+			{
+				continue;
+			}
+
+			RVertexShader* pVertexShader;
+			if ( rSceneObject.GetBoneCount() == 0 || !rSceneObject.GetBonePalette() )
+			{
+				pVertexShader = pNoSkinningVertexShader;
+			}
+			else
+			{
+				pVertexShader = pSmoothSkinningVertexShader;
+			}
+
+			pVertexShader->CacheDescription( pRenderer, pVertexDescription );
+			RVertexInputLayout* pInputLayout = pVertexShader->GetCachedInputLayout();
+			if ( !pInputLayout )
+			{
+				continue;
+			}
+
+			uint32_t vertexStride = rSceneObject.GetVertexStride();
+			uint32_t offset = 0;
+
+			if ( pPreviousVertexShader != pVertexShader )
+			{
+				pCommandProxy->SetVertexShader( pVertexShader );
+				pPreviousVertexShader = pVertexShader;
+			}
+
+			pCommandProxy->SetVertexBuffers( 0, 1, &pVertexBuffer, &vertexStride, &offset );
+			pCommandProxy->SetIndexBuffer( pIndexBuffer );
+			pCommandProxy->SetVertexInputLayout( pInputLayout );
+
+			pRunInstance = &rInstance;
+		}
+
+		RConstantBuffer* pInstanceDataBuffer = rInstance.pInstanceDataBuffer;
+		pCommandProxy->SetVertexConstantBuffers(
+			1,
+			1,
+			&pInstanceDataBuffer,
+			&rInstance.instanceDataSize,
+			&rInstance.instanceDataOffset );
+		pCommandProxy->DrawIndexed(
+			rSubMeshData.GetPrimitiveType(),
+			rSubMeshData.GetStartVertex(),
+			0,
+			rSubMeshData.GetVertexRange(),
+			rSubMeshData.GetStartIndex(),
+			rSubMeshData.GetPrimitiveCount() );
+	}
+}
+
+/// Determine which scene objects are visible in a view frustum, storing the results in the visible object bit array.
+///
+/// The bounding volume hierarchy accepts and rejects whole subtrees at a time.  The objects it leaves straddling a
+/// frustum plane have their bounding spheres gathered into struct-of-arrays form and tested four at a time, split
+/// across job workers when there are enough of them.
+///
+/// @param[in] rFrustum  View frustum.
+void GraphicsScene::CullSceneObjects( const Simd::Frustum& rFrustum )
+{
+	HELIUM_ASSERT( m_visibleSceneObjects.GetSize() == m_sceneObjects.GetSize() );
+
+	m_visibleSceneObjects.UnsetAll();
+	m_cullCandidateIds.Resize( 0 );
+	m_sceneObjectBvh.QueryFrustum( rFrustum, m_visibleSceneObjects, &m_cullCandidateIds );
+
+	size_t candidateCount = m_cullCandidateIds.GetSize();
+	if ( candidateCount == 0 )
+	{
+		return;
+	}
+
+	// Pad the bounds arrays to a multiple of the SIMD vector size so that each array starts on an aligned address.
+	size_t paddedCandidateCount = ( candidateCount + 3 ) & ~static_cast<size_t>( 3 );
+	if ( paddedCandidateCount > m_cullCandidateBoundsCapacity )
 	{
-		if ( m_mappedSubMeshVertexGlobalDataBuffers[subMeshIndex] )
+		DefaultAllocator allocator;
+		allocator.Free( m_pCullCandidateBounds );
+		m_pCullCandidateBounds = static_cast<float32_t*>(
+			allocator.AllocateAligned( HELIUM_SIMD_ALIGNMENT, paddedCandidateCount * 4 * sizeof( float32_t ) ) );
+		HELIUM_ASSERT( m_pCullCandidateBounds );
+		m_cullCandidateBoundsCapacity = paddedCandidateCount;
+	}
+
+	size_t boundsCapacity = m_cullCandidateBoundsCapacity;
+	float32_t* pBoundsX = m_pCullCandidateBounds;
+	float32_t* pBoundsY = pBoundsX + boundsCapacity;
+	float32_t* pBoundsZ = pBoundsY + boundsCapacity;
+	float32_t* pBoundsRadius = pBoundsZ + boundsCapacity;
+
+	for ( size_t candidateIndex = 0; candidateIndex < candidateCount; ++candidateIndex )
+	{
+		const Simd::Sphere& rObjectBounds = m_sceneObjects[m_cullCandidateIds[candidateIndex]].GetWorldSphere();
+		pBoundsX[candidateIndex] = rObjectBounds.GetElement( 0 );
+		pBoundsY[candidateIndex] = rObjectBounds.GetElement( 1 );
+		pBoundsZ[candidateIndex] = rObjectBounds.GetElement( 2 );
+		pBoundsRadius[candidateIndex] = rObjectBounds.GetElement( 3 );
+	}
+
+	m_cullCandidateVisibilityBits.Resize( ( candidateCount + 31 ) / 32 );
+
+	CullGraphicsSceneObjectsJobSpawner job;
+	CullGraphicsSceneObjectsJobSpawner::Parameters& rParameters = job.GetParameters();
+	rParameters.sceneObjectCount = static_cast<uint32_t>( candidateCount );
+	rParameters.pFrustum = &rFrustum;
+	rParameters.pBoundsX = pBoundsX;
+	rParameters.pBoundsY = pBoundsY;
+	rParameters.pBoundsZ = pBoundsZ;
+	rParameters.pBoundsRadius = pBoundsRadius;
+	rParameters.pVisibilityBits = m_cullCandidateVisibilityBits.GetData();
+	job.Run();
+
+	const uint32_t* pVisibilityBits = m_cullCandidateVisibilityBits.GetData();
+	for ( size_t candidateIndex = 0; candidateIndex < candidateCount; ++candidateIndex )
+	{
+		if ( pVisibilityBits[candidateIndex / 32] & ( 1U << ( candidateIndex % 32 ) ) )
 		{
-			RConstantBuffer* pBuffer = m_subMeshVertexGlobalDataBuffers[subMeshIndex];
-			HELIUM_ASSERT( pBuffer );
-			pBuffer->Unmap();
+			m_visibleSceneObjects.SetElement( m_cullCandidateIds[candidateIndex] );
 		}
 	}
 }
@@ -1152,23 +1590,7 @@ void GraphicsScene::DrawSceneView( uint_fast32_t viewIndex )
 	}
 
 	// Determine which scene objects are visible in the current view.
-	m_visibleSceneObjects.UnsetAll();
-
-	const Simd::Frustum& rViewFrustum = rView.GetFrustum();
-
-	size_t sceneObjectCount = m_sceneObjects.GetSize();
-	for ( size_t sceneObjectIndex = 0; sceneObjectIndex < sceneObjectCount; ++sceneObjectIndex )
-	{
-		if ( m_sceneObjects.IsElementValid( sceneObjectIndex ) )
-		{
-			//const AaBox& rObjectBounds = m_sceneObjects[ sceneObjectIndex ].GetWorldBox();
-			const Simd::Sphere& rObjectBounds = m_sceneObjects[sceneObjectIndex].GetWorldSphere();
-			if ( rViewFrustum.Intersects( rObjectBounds ) )
-			{
-				m_visibleSceneObjects.SetElement( sceneObjectIndex );
-			}
-		}
-	}
+	CullSceneObjects( rView.GetFrustum() );
 
 	// Build a list of indices for each visible sub-mesh for sorting.
 	m_sceneObjectSubMeshIndices.Resize( 0 );
@@ -1182,7 +1604,7 @@ void GraphicsScene::DrawSceneView( uint_fast32_t viewIndex )
 			HELIUM_ASSERT( sceneObjectId < m_visibleSceneObjects.GetSize() );
 			if ( m_visibleSceneObjects[sceneObjectId] )
 			{
-				m_sceneObjectSubMeshIndices.Push( subMeshIndex );
+				m_sceneObjectSubMeshIndices.Push( static_cast<uint32_t>( subMeshIndex ) );
 			}
 		}
 	}
@@ -1433,22 +1855,7 @@ void GraphicsScene::DrawShadowDepthPass( uint_fast32_t viewIndex )
 	HELIUM_ASSERT( spShadowDepthTextureSurface );
 
 	// Sort meshes based on distance from front to back in order to reduce overdraw.
-	size_t subMeshIndexCount = m_sceneObjectSubMeshIndices.GetSize();
-
-	{
-		SortJob< size_t, SubMeshFrontToBackCompare > job;
-
-		SortJob< size_t, SubMeshFrontToBackCompare >::Parameters& rParameters = job.GetParameters();
-		rParameters.pBase = m_sceneObjectSubMeshIndices.GetData();
-		rParameters.count = subMeshIndexCount;
-		rParameters.compare = SubMeshFrontToBackCompare(
-			m_directionalLightDirection,
-			m_sceneObjects,
-			m_sceneObjectSubMeshes );
-		rParameters.singleJobCount = 100;
-
-		job.Run();
-	}
+	SortSubMeshesFrontToBack( DRAW_KEY_PASS_SHADOW_DEPTH, m_directionalLightDirection, false );
 
 	// Prepare the shadow depth pass scene for rendering.
 	Renderer* pRenderer = Renderer::GetInstance();
@@ -1480,116 +1887,33 @@ void GraphicsScene::DrawShadowDepthPass( uint_fast32_t viewIndex )
 	spCommandProxy->SetVertexConstantBuffers( 0, 1, &pShadowViewVertexDataBuffer );
 	spCommandProxy->SetPixelShader( NULL );
 
-	RVertexShader* pPreviousVertexShader = NULL;
+	GatherDepthOnlyInstances();
+	DrawDepthOnlyInstances(
+		spCommandProxy,
+		pRenderer,
+		pPrePassNoSkinningVertexShader,
+		pPrePassSmoothSkinningVertexShader,
+		m_depthOnlyInstances.GetData(),
+		m_depthOnlyInstances.GetSize() );
 
-	for ( size_t meshIndexIndex = 0; meshIndexIndex < subMeshIndexCount; ++meshIndexIndex )
-	{
-		size_t meshIndex = m_sceneObjectSubMeshIndices[meshIndexIndex];
-		HELIUM_ASSERT( m_sceneObjectSubMeshes.IsElementValid( meshIndex ) );
+	spCommandProxy->EndScene();
+}
 
-		GraphicsSceneObject::SubMeshData& rSubMeshData = m_sceneObjectSubMeshes[meshIndex];
-
-		size_t sceneObjectId = rSubMeshData.GetSceneObjectId();
-		HELIUM_ASSERT( IsValid( sceneObjectId ) );
-		HELIUM_ASSERT( sceneObjectId < m_sceneObjects.GetSize() );
-		HELIUM_ASSERT( m_sceneObjects.IsElementValid( sceneObjectId ) );
-
-		HELIUM_ASSERT( meshIndex < m_subMeshVertexGlobalDataBuffers.GetSize() );
-		RConstantBuffer* pInstanceVertexGlobalDataBuffer = m_subMeshVertexGlobalDataBuffers[meshIndex];
-		if ( !pInstanceVertexGlobalDataBuffer )
-		{
-			HELIUM_ASSERT( sceneObjectId < m_objectVertexGlobalDataBuffers.GetSize() );
-			pInstanceVertexGlobalDataBuffer = m_objectVertexGlobalDataBuffers[sceneObjectId];
-			if ( !pInstanceVertexGlobalDataBuffer )
-			{
-				continue;
-			}
-		}
-
-		GraphicsSceneObject& rSceneObject = m_sceneObjects[sceneObjectId];
-
-		RVertexBuffer* pVertexBuffer = rSceneObject.GetVertexBuffer();
-		if ( !pVertexBuffer )
-		{
-			continue;
-		}
-
-		RVertexDescription* pVertexDescription = rSceneObject.GetVertexDescription();
-		if ( !pVertexDescription )
-		{
-			continue;
-		}
-
-		RIndexBuffer* pIndexBuffer = rSceneObject.GetIndexBuffer();
-		if ( !pIndexBuffer )
-		{
-			continue;
-		}
-
-		RVertexShader* pVertexShader;
-		if ( rSceneObject.GetBoneCount() == 0 || !rSceneObject.GetBonePalette() )
-		{
-			pVertexShader = pPrePassNoSkinningVertexShader;
-		}
-		else
-		{
-			pVertexShader = pPrePassSmoothSkinningVertexShader;
-		}
-
-		pVertexShader->CacheDescription( pRenderer, pVertexDescription );
-		RVertexInputLayout* pInputLayout = pVertexShader->GetCachedInputLayout();
-		if ( !pInputLayout )
-		{
-			continue;
-		}
-
-		uint32_t vertexStride = rSceneObject.GetVertexStride();
-		uint32_t offset = 0;
-
-		ERendererPrimitiveType primitiveType = rSubMeshData.GetPrimitiveType();
-		uint32_t primitiveCount = rSubMeshData.GetPrimitiveCount();
-		uint32_t startVertex = rSubMeshData.GetStartVertex();
-		uint32_t vertexRange = rSubMeshData.GetVertexRange();
-		uint32_t startIndex = rSubMeshData.GetStartIndex();
-
-		if ( pPreviousVertexShader != pVertexShader )
-		{
-			spCommandProxy->SetVertexShader( pVertexShader );
-			pPreviousVertexShader = pVertexShader;
-		}
-
-		spCommandProxy->SetVertexConstantBuffers( 1, 1, &pInstanceVertexGlobalDataBuffer );
-		spCommandProxy->SetVertexBuffers( 0, 1, &pVertexBuffer, &vertexStride, &offset );
-		spCommandProxy->SetIndexBuffer( pIndexBuffer );
-		spCommandProxy->SetVertexInputLayout( pInputLayout );
-
-		spCommandProxy->DrawIndexed(
-			primitiveType,
-			startVertex,
-			0,
-			vertexRange,
-			startIndex,
-			primitiveCount );
-	}
-
-	spCommandProxy->EndScene();
-}
-
-/// Draw the depth-only pre-pass for the given scene view.
-///
-/// - The m_sceneObjectSubMeshIndices array should already be prepared with the (unsorted) list of visible sub
-///   meshes.  This function will sort by depth if rendering is performed.
-/// - Standard viewport render surfaces are expected to have already been set, with the depth buffer cleared.
-/// - Default rasterizer and depth states should be already set.
-/// - Global per-view constant buffers should be already set.
-///
-/// @param[in] viewIndex  Index of the view for which the depth-only pre-pass is being rendered.
-///
-/// @see DrawShadowDepthPass(), DrawBasePass()
-void GraphicsScene::DrawDepthPrePass( uint_fast32_t viewIndex )
-{
-	HELIUM_ASSERT( viewIndex < m_sceneViews.GetSize() );
-	HELIUM_ASSERT( m_sceneViews.IsElementValid( viewIndex ) );
+/// Draw the depth-only pre-pass for the given scene view.
+///
+/// - The m_sceneObjectSubMeshIndices array should already be prepared with the (unsorted) list of visible sub
+///   meshes.  This function will sort by depth if rendering is performed.
+/// - Standard viewport render surfaces are expected to have already been set, with the depth buffer cleared.
+/// - Default rasterizer and depth states should be already set.
+/// - Global per-view constant buffers should be already set.
+///
+/// @param[in] viewIndex  Index of the view for which the depth-only pre-pass is being rendered.
+///
+/// @see DrawShadowDepthPass(), DrawBasePass()
+void GraphicsScene::DrawDepthPrePass( uint_fast32_t viewIndex )
+{
+	HELIUM_ASSERT( viewIndex < m_sceneViews.GetSize() );
+	HELIUM_ASSERT( m_sceneViews.IsElementValid( viewIndex ) );
 
 	RenderResourceManager* pRenderResourceManager = RenderResourceManager::GetInstance();
 	HELIUM_ASSERT( pRenderResourceManager );
@@ -1641,17 +1965,7 @@ void GraphicsScene::DrawDepthPrePass( uint_fast32_t viewIndex )
 	GraphicsSceneView& rView = m_sceneViews[viewIndex];
 	const Simd::Vector3& rViewDirection = rView.GetForward();
 
-	size_t subMeshIndexCount = m_sceneObjectSubMeshIndices.GetSize();
-
-	{
-		SortJob< size_t, SubMeshFrontToBackCompare > job;
-		SortJob< size_t, SubMeshFrontToBackCompare >::Parameters& rParameters = job.GetParameters();
-		rParameters.pBase = m_sceneObjectSubMeshIndices.GetData();
-		rParameters.count = subMeshIndexCount;
-		rParameters.compare = SubMeshFrontToBackCompare( rViewDirection, m_sceneObjects, m_sceneObjectSubMeshes );
-		rParameters.singleJobCount = 100;
-		job.Run();
-	}
+	SortSubMeshesFrontToBack( DRAW_KEY_PASS_DEPTH_PRE, rViewDirection, true );
 
 	// Initialize the blend state and shaders for performing no color writes.
 	Renderer* pRenderer = Renderer::GetInstance();
@@ -1667,97 +1981,14 @@ void GraphicsScene::DrawDepthPrePass( uint_fast32_t viewIndex )
 	spCommandProxy->SetPixelShader( NULL );
 
 	// Draw each visible mesh instance.
-	RVertexShader* pPreviousVertexShader = NULL;
-
-	for ( size_t meshIndexIndex = 0; meshIndexIndex < subMeshIndexCount; ++meshIndexIndex )
-	{
-		size_t meshIndex = m_sceneObjectSubMeshIndices[meshIndexIndex];
-		HELIUM_ASSERT( m_sceneObjectSubMeshes.IsElementValid( meshIndex ) );
-
-		GraphicsSceneObject::SubMeshData& rSubMeshData = m_sceneObjectSubMeshes[meshIndex];
-
-		size_t sceneObjectId = rSubMeshData.GetSceneObjectId();
-		HELIUM_ASSERT( IsValid( sceneObjectId ) );
-		HELIUM_ASSERT( sceneObjectId < m_sceneObjects.GetSize() );
-		HELIUM_ASSERT( m_sceneObjects.IsElementValid( sceneObjectId ) );
-
-		HELIUM_ASSERT( meshIndex < m_subMeshVertexGlobalDataBuffers.GetSize() );
-		RConstantBuffer* pInstanceVertexGlobalDataBuffer = m_subMeshVertexGlobalDataBuffers[meshIndex];
-		if ( !pInstanceVertexGlobalDataBuffer )
-		{
-			HELIUM_ASSERT( sceneObjectId < m_objectVertexGlobalDataBuffers.GetSize() );
-			pInstanceVertexGlobalDataBuffer = m_objectVertexGlobalDataBuffers[sceneObjectId];
-			if ( !pInstanceVertexGlobalDataBuffer )
-			{
-				continue;
-			}
-		}
-
-		GraphicsSceneObject& rSceneObject = m_sceneObjects[sceneObjectId];
-
-		RVertexBuffer* pVertexBuffer = rSceneObject.GetVertexBuffer();
-		if ( !pVertexBuffer )
-		{
-			continue;
-		}
-
-		RVertexDescription* pVertexDescription = rSceneObject.GetVertexDescription();
-		if ( !pVertexDescription )
-		{
-			continue;
-		}
-
-		RIndexBuffer* pIndexBuffer = rSceneObject.GetIndexBuffer();
-		if ( !pIndexBuffer )
-		{
-			continue;
-		}
-
-		RVertexShader* pVertexShader;
-		if ( rSceneObject.GetBoneCount() == 0 || !rSceneObject.GetBonePalette() )
-		{
-			pVertexShader = pPrePassNoSkinningVertexShader;
-		}
-		else
-		{
-			pVertexShader = pPrePassSmoothSkinningVertexShader;
-		}
-
-		pVertexShader->CacheDescription( pRenderer, pVertexDescription );
-		RVertexInputLayout* pInputLayout = pVertexShader->GetCachedInputLayout();
-		if ( !pInputLayout )
-		{
-			continue;
-		}
-
-		uint32_t vertexStride = rSceneObject.GetVertexStride();
-		uint32_t offset = 0;
-
-		ERendererPrimitiveType primitiveType = rSubMeshData.GetPrimitiveType();
-		uint32_t primitiveCount = rSubMeshData.GetPrimitiveCount();
-		uint32_t startVertex = rSubMeshData.GetStartVertex();
-		uint32_t vertexRange = rSubMeshData.GetVertexRange();
-		uint32_t startIndex = rSubMeshData.GetStartIndex();
-
-		if ( pPreviousVertexShader != pVertexShader )
-		{
-			spCommandProxy->SetVertexShader( pVertexShader );
-			pPreviousVertexShader = pVertexShader;
-		}
-
-		spCommandProxy->SetVertexConstantBuffers( 1, 1, &pInstanceVertexGlobalDataBuffer );
-		spCommandProxy->SetVertexBuffers( 0, 1, &pVertexBuffer, &vertexStride, &offset );
-		spCommandProxy->SetIndexBuffer( pIndexBuffer );
-		spCommandProxy->SetVertexInputLayout( pInputLayout );
-
-		spCommandProxy->DrawIndexed(
-			primitiveType,
-			startVertex,
-			0,
-			vertexRange,
-			startIndex,
-			primitiveCount );
-	}
+	GatherDepthOnlyInstances();
+	DrawDepthOnlyInstances(
+		spCommandProxy,
+		pRenderer,
+		pPrePassNoSkinningVertexShader,
+		pPrePassSmoothSkinningVertexShader,
+		m_depthOnlyInstances.GetData(),
+		m_depthOnlyInstances.GetSize() );
 }
 
 /// Draw the base pass for the given scene view.
@@ -1822,19 +2053,9 @@ void GraphicsScene::DrawBasePass( uint_fast32_t viewIndex )
 
 	systemSelections[0].choice = shadowSelectOptions[shadowMode];
 
-	// Sort meshes based on material in order to reduce shader switches.
+	// Sort meshes based on material in order to reduce shader switches (and front to back within each material).
 	size_t subMeshIndexCount = m_sceneObjectSubMeshIndices.GetSize();
-
-	{
-		SortJob< size_t, SubMeshMaterialCompare > job;
-		SortJob< size_t, SubMeshMaterialCompare >::Parameters& rParameters = job.GetParameters();
-		rParameters.pBase = m_sceneObjectSubMeshIndices.GetData();
-		rParameters.count = subMeshIndexCount;
-		rParameters.compare = SubMeshMaterialCompare( m_sceneObjectSubMeshes );
-		rParameters.singleJobCount = 100;
-
-		job.Run();
-	}
+	SortSubMeshesByMaterial( DRAW_KEY_PASS_BASE, m_sceneViews[viewIndex].GetForward() );
 
 	// Set the opaque rendering blend state and per-view constant buffers for this pass.
 	Renderer* pRenderer = Renderer::GetInstance();
@@ -1864,10 +2085,15 @@ void GraphicsScene::DrawBasePass( uint_fast32_t viewIndex )
 
 	RTexture2d* pShadowDepthTexture = pRenderResourceManager->GetShadowDepthTexture();
 
-	RVertexShader* pPreviousVertexShader = NULL;
-	RPixelShader* pPreviousPixelShader = NULL;
-	RConstantBuffer* pPreviousMaterialVertexConstantBuffer = NULL;
-	RConstantBuffer* pPreviousMaterialPixelConstantBuffer = NULL;
+	// Resolve the material draw state whenever the material or skinning variant changes.  Sub-meshes are sorted by
+	// material, so each state is usually only resolved once per pass rather than once per draw.
+	m_basePassInstances.Resize( 0 );
+	m_basePassInstances.Reserve( subMeshIndexCount );
+
+	size_t materialStateCount = 0;
+	Material* pStateMaterial = NULL;
+	bool bStateSkinned = false;
+	bool bStateValid = false;
 
 	for ( size_t meshIndexIndex = 0; meshIndexIndex < subMeshIndexCount; ++meshIndexIndex )
 	{
@@ -1883,6 +2109,8 @@ void GraphicsScene::DrawBasePass( uint_fast32_t viewIndex )
 
 		HELIUM_ASSERT( meshIndex < m_subMeshVertexGlobalDataBuffers.GetSize() );
 		RConstantBuffer* pInstanceVertexGlobalDataBuffer = m_subMeshVertexGlobalDataBuffers[meshIndex];
+		size_t instanceVertexGlobalDataOffset = m_subMeshVertexGlobalDataOffsets[meshIndex];
+		size_t instanceVertexGlobalDataSize = INSTANCE_VERTEX_SKINNED_DATA_SIZE;
 		if ( !pInstanceVertexGlobalDataBuffer )
 		{
 			HELIUM_ASSERT( sceneObjectId < m_objectVertexGlobalDataBuffers.GetSize() );
@@ -1891,216 +2119,327 @@ void GraphicsScene::DrawBasePass( uint_fast32_t viewIndex )
 			{
 				continue;
 			}
+
+			instanceVertexGlobalDataOffset = m_objectVertexGlobalDataOffsets[sceneObjectId];
+			instanceVertexGlobalDataSize = INSTANCE_VERTEX_STATIC_DATA_SIZE;
 		}
 
 		GraphicsSceneObject& rSceneObject = m_sceneObjects[sceneObjectId];
 
-		RVertexBuffer* pVertexBuffer = rSceneObject.GetVertexBuffer();
-		if ( !pVertexBuffer )
+		Material* pMaterial = rSubMeshData.GetMaterial();
+		if ( !pMaterial )
 		{
 			continue;
 		}
 
-		RVertexDescription* pVertexDescription = rSceneObject.GetVertexDescription();
-		if ( !pVertexDescription )
+		bool bSkinned = ( rSceneObject.GetBoneCount() != 0 && rSceneObject.GetBonePalette() );
+		if ( pMaterial != pStateMaterial || bSkinned != bStateSkinned )
 		{
-			continue;
-		}
+			pStateMaterial = pMaterial;
+			bStateSkinned = bSkinned;
+			bStateValid = false;
 
-		RIndexBuffer* pIndexBuffer = rSceneObject.GetIndexBuffer();
-		if ( !pIndexBuffer )
-		{
-			continue;
-		}
+			Shader* pShaderResource = pMaterial->GetShader();
+			if ( !pShaderResource )
+			{
+				continue;
+			}
 
-		Material* pMaterial = rSubMeshData.GetMaterial();
-		if ( !pMaterial )
-		{
-			continue;
-		}
+			ShaderVariant* pVertexShaderVariant = pMaterial->GetShaderVariant( RShader::TYPE_VERTEX );
+			if ( !pVertexShaderVariant )
+			{
+				continue;
+			}
 
-		Shader* pShaderResource = pMaterial->GetShader();
-		if ( !pShaderResource )
-		{
-			continue;
-		}
+			ShaderVariant* pPixelShaderVariant = pMaterial->GetShaderVariant( RShader::TYPE_PIXEL );
+			if ( !pPixelShaderVariant )
+			{
+				continue;
+			}
 
-		ShaderVariant* pVertexShaderVariant = pMaterial->GetShaderVariant( RShader::TYPE_VERTEX );
-		if ( !pVertexShaderVariant )
-		{
-			continue;
-		}
+			systemSelections[1].choice = ( bSkinned ? GetSkinningSmoothOptionName() : GetNoneOptionName() );
+
+			const Shader::Options& rSystemOptions = pShaderResource->GetSystemOptions();
+			size_t vertexShaderIndex = rSystemOptions.GetOptionSetIndex(
+				RShader::TYPE_VERTEX,
+				NULL,
+				0,
+				systemSelections,
+				HELIUM_ARRAY_COUNT( systemSelections ) );
+			size_t pixelShaderIndex = rSystemOptions.GetOptionSetIndex(
+				RShader::TYPE_PIXEL,
+				NULL,
+				0,
+				systemSelections,
+				HELIUM_ARRAY_COUNT( systemSelections ) );
+
+			RVertexShader* pVertexShader =
+				static_cast<RVertexShader*>( pVertexShaderVariant->GetRenderResource( vertexShaderIndex ) );
+			if ( !pVertexShader )
+			{
+				continue;
+			}
 
-		ShaderVariant* pPixelShaderVariant = pMaterial->GetShaderVariant( RShader::TYPE_PIXEL );
-		if ( !pPixelShaderVariant )
-		{
-			continue;
-		}
+			RPixelShader* pPixelShader =
+				static_cast<RPixelShader*>( pPixelShaderVariant->GetRenderResource( pixelShaderIndex ) );
+			if ( !pPixelShader )
+			{
+				continue;
+			}
 
-		if ( rSceneObject.GetBoneCount() == 0 || !rSceneObject.GetBonePalette() )
-		{
-			systemSelections[1].choice = GetNoneOptionName();
-		}
-		else
-		{
-			systemSelections[1].choice = GetSkinningSmoothOptionName();
-		}
+			if ( materialStateCount == m_basePassMaterialStates.GetSize() )
+			{
+				HELIUM_VERIFY( m_basePassMaterialStates.New() );
+			}
 
-		const Shader::Options& rSystemOptions = pShaderResource->GetSystemOptions();
-		size_t vertexShaderIndex = rSystemOptions.GetOptionSetIndex(
-			RShader::TYPE_VERTEX,
-			NULL,
-			0,
-			systemSelections,
-			HELIUM_ARRAY_COUNT( systemSelections ) );
-		size_t pixelShaderIndex = rSystemOptions.GetOptionSetIndex(
-			RShader::TYPE_PIXEL,
-			NULL,
-			0,
-			systemSelections,
-			HELIUM_ARRAY_COUNT( systemSelections ) );
+			BasePassMaterialState& rMaterialState = m_basePassMaterialStates[materialStateCount];
+			rMaterialState.pVertexShader = pVertexShader;
+			rMaterialState.pPixelShader = pPixelShader;
+			rMaterialState.pVertexConstantBuffer = pMaterial->GetConstantBuffer( RShader::TYPE_VERTEX );
+			rMaterialState.pPixelConstantBuffer = pMaterial->GetConstantBuffer( RShader::TYPE_PIXEL );
+			rMaterialState.samplers.Resize( 0 );
+			rMaterialState.textures.Resize( 0 );
 
-		RVertexShader* pVertexShader =
-			static_cast<RVertexShader*>( pVertexShaderVariant->GetRenderResource( vertexShaderIndex ) );
-		if ( !pVertexShader )
-		{
-			continue;
-		}
+			const ShaderSamplerInfoSet* pSamplerInfoSet = pPixelShaderVariant->GetSamplerInfoSet( pixelShaderIndex );
+			if ( pSamplerInfoSet )
+			{
+				const DynamicArray< ShaderSamplerInfo >& samplerInputs = pSamplerInfoSet->inputs;
+				size_t samplerInputCount = samplerInputs.GetSize();
+				for ( size_t inputIndex = 0; inputIndex < samplerInputCount; ++inputIndex )
+				{
+					const ShaderSamplerInfo& rInputInfo = samplerInputs[inputIndex];
+					Name samplerName = rInputInfo.name;
 
-		RPixelShader* pPixelShader =
-			static_cast<RPixelShader*>( pPixelShaderVariant->GetRenderResource( pixelShaderIndex ) );
-		if ( !pPixelShader )
-		{
-			continue;
-		}
+					RSamplerState* pSamplerState = NULL;
+					if ( samplerName == defaultSamplerStateName )
+					{
+						pSamplerState = pSamplerStateDefault;
+					}
+					else if ( samplerName == shadowSamplerStateName ||  // Shader model 4+
+						samplerName == shadowMapTextureName )     // Older shader versions
+					{
+						pSamplerState = pSamplerStateShadowMap;
+					}
 
-		pVertexShader->CacheDescription( pRenderer, pVertexDescription );
-		RVertexInputLayout* pInputLayout = pVertexShader->GetCachedInputLayout();
-		if ( !pInputLayout )
-		{
-			continue;
-		}
+					BasePassMaterialState::SamplerBinding* pBinding = rMaterialState.samplers.New();
+					HELIUM_ASSERT( pBinding );
+					pBinding->bindIndex = rInputInfo.bindIndex;
+					pBinding->pState = pSamplerState;
+				}
+			}
+
+			const ShaderTextureInfoSet* pTextureInfoSet = pPixelShaderVariant->GetTextureInfoSet( pixelShaderIndex );
+			if ( pTextureInfoSet )
+			{
+				size_t materialTextureCount = pMaterial->GetTextureParameterCount();
 
-		RConstantBuffer* pMaterialVertexConstantBuffer = pMaterial->GetConstantBuffer(
-			RShader::TYPE_VERTEX );
-		RConstantBuffer* pMaterialPixelConstantBuffer = pMaterial->GetConstantBuffer(
-			RShader::TYPE_PIXEL );
+				const DynamicArray< ShaderTextureInfo >& textureInputs = pTextureInfoSet->inputs;
+				size_t textureInputCount = textureInputs.GetSize();
+				for ( size_t inputIndex = 0; inputIndex < textureInputCount; ++inputIndex )
+				{
+					const ShaderTextureInfo& rInputInfo = textureInputs[inputIndex];
+					Name textureName = rInputInfo.name;
 
-		uint32_t vertexStride = rSceneObject.GetVertexStride();
-		uint32_t offset = 0;
+					RTexture* pTextureResource = NULL;
 
-		ERendererPrimitiveType primitiveType = rSubMeshData.GetPrimitiveType();
-		uint32_t primitiveCount = rSubMeshData.GetPrimitiveCount();
-		uint32_t startVertex = rSubMeshData.GetStartVertex();
-		uint32_t vertexRange = rSubMeshData.GetVertexRange();
-		uint32_t startIndex = rSubMeshData.GetStartIndex();
+					if ( textureName == shadowMapTextureName )
+					{
+						pTextureResource = pShadowDepthTexture;
+					}
+					else
+					{
+						for ( size_t materialTextureIndex = 0;
+							materialTextureIndex < materialTextureCount;
+							++materialTextureIndex )
+						{
+							const Material::TextureParameter& rTextureParameter = pMaterial->GetTextureParameter(
+								materialTextureIndex );
+							if ( rTextureParameter.name == textureName )
+							{
+								Texture* pTexture = rTextureParameter.value;
+								if ( pTexture )
+								{
+									pTextureResource = pTexture->GetRenderResource();
+								}
 
-		spCommandProxy->SetVertexConstantBuffers( 2, 1, &pInstanceVertexGlobalDataBuffer );
+								break;
+							}
+						}
+					}
 
-		if ( pMaterialVertexConstantBuffer != pPreviousMaterialVertexConstantBuffer )
-		{
-			spCommandProxy->SetVertexConstantBuffers( 3, 1, &pMaterialVertexConstantBuffer );
-			pPreviousMaterialVertexConstantBuffer = pMaterialVertexConstantBuffer;
+					BasePassMaterialState::TextureBinding* pBinding = rMaterialState.textures.New();
+					HELIUM_ASSERT( pBinding );
+					pBinding->bindIndex = rInputInfo.bindIndex;
+					pBinding->pTexture = pTextureResource;
+				}
+			}
+
+			++materialStateCount;
+			bStateValid = true;
 		}
 
-		if ( pMaterialPixelConstantBuffer != pPreviousMaterialPixelConstantBuffer )
+		if ( !bStateValid )
 		{
-			spCommandProxy->SetPixelConstantBuffers( 1, 1, &pMaterialPixelConstantBuffer );
-			pPreviousMaterialPixelConstantBuffer = pMaterialPixelConstantBuffer;
+			continue;
 		}
 
-		spCommandProxy->SetVertexBuffers( 0, 1, &pVertexBuffer, &vertexStride, &offset );
-		spCommandProxy->SetIndexBuffer( pIndexBuffer );
+		BasePassInstance* pInstance = m_basePassInstances.New();
+		HELIUM_ASSERT( pInstance );
+		pInstance->pSceneObject = &rSceneObject;
+		pInstance->pSubMeshData = &rSubMeshData;
+		pInstance->materialStateIndex = materialStateCount - 1;
+		pInstance->pInstanceDataBuffer = pInstanceVertexGlobalDataBuffer;
+		pInstance->instanceDataOffset = instanceVertexGlobalDataOffset;
+		pInstance->instanceDataSize = instanceVertexGlobalDataSize;
+	}
 
-		if ( pVertexShader != pPreviousVertexShader )
-		{
-			spCommandProxy->SetVertexShader( pVertexShader );
-			pPreviousVertexShader = pVertexShader;
-		}
+	DrawBasePassInstances(
+		spCommandProxy,
+		pRenderer,
+		m_basePassMaterialStates.GetData(),
+		m_basePassInstances.GetData(),
+		m_basePassInstances.GetSize() );
+}
 
-		if ( pPixelShader != pPreviousPixelShader )
-		{
-			spCommandProxy->SetPixelShader( pPixelShader );
-			pPreviousPixelShader = pPixelShader;
-		}
+/// Issue the draw commands for a list of sub-mesh instances in the base pass.
+///
+/// Consecutive instances of the same sub-mesh drawn with the same material state only differ in their instance
+/// constants, so draw state is only set for the first instance of each run, and each further instance only costs a
+/// constant buffer bind and a draw.  The blend state and per-view constants must already be set.
+///
+/// @param[in] pCommandProxy    Command proxy through which to issue the draws.
+/// @param[in] pRenderer        Renderer used to create vertex input layouts.
+/// @param[in] pMaterialStates  Material draw states referenced by the instances.
+/// @param[in] pInstances       Instances to draw, in draw order.
+/// @param[in] instanceCount    Number of instances to draw.
+void GraphicsScene::DrawBasePassInstances(
+	RRenderCommandProxy* pCommandProxy,
+	Renderer* pRenderer,
+	const BasePassMaterialState* pMaterialStates,
+	const BasePassInstance* pInstances,
+	size_t instanceCount )
+{
+	HELIUM_ASSERT( pCommandProxy );
+	HELIUM_ASSERT( pMaterialStates || instanceCount == 0 );
+	HELIUM_ASSERT( pInstances || instanceCount == 0 );
+
+	RVertexShader* pPreviousVertexShader = NULL;
+	RPixelShader* pPreviousPixelShader = NULL;
+	RConstantBuffer* pPreviousMaterialVertexConstantBuffer = NULL;
+	RConstantBuffer* pPreviousMaterialPixelConstantBuffer = NULL;
+	const BasePassInstance* pRunInstance = NULL;
+
+	for ( size_t instanceIndex = 0; instanceIndex < instanceCount; ++instanceIndex )
+	{
+		const BasePassInstance& rInstance = pInstances[instanceIndex];
+		HELIUM_ASSERT( rInstance.pSceneObject );
+		HELIUM_ASSERT( rInstance.pSubMeshData );
 
-		spCommandProxy->SetVertexInputLayout( pInputLayout );
+		const GraphicsSceneObject& rSceneObject = *rInstance.pSceneObject;
+		const GraphicsSceneObject::SubMeshData& rSubMeshData = *rInstance.pSubMeshData;
 
-		const ShaderSamplerInfoSet* pSamplerInfoSet = pPixelShaderVariant->GetSamplerInfoSet( pixelShaderIndex );
-		if ( pSamplerInfoSet )
+		if ( !pRunInstance ||
+			rInstance.materialStateIndex != pRunInstance->materialStateIndex ||
+			!SharesMeshDrawState( rSceneObject, rSubMeshData, *pRunInstance->pSceneObject, *pRunInstance->pSubMeshData ) )
 		{
-			const DynamicArray< ShaderSamplerInfo >& samplerInputs = pSamplerInfoSet->inputs;
-			size_t samplerInputCount = samplerInputs.GetSize();
-			for ( size_t inputIndex = 0; inputIndex < samplerInputCount; ++inputIndex )
+			RVertexBuffer* pVertexBuffer = rSceneObject.GetVertexBuffer();
+			if ( !pVertexBuffer )
 			{
-				const ShaderSamplerInfo& rInputInfo = samplerInputs[inputIndex];
-				Name samplerName = rInputInfo.name;
+				continue;
+			}
 
-				RSamplerState* pSamplerState = NULL;
-				if ( samplerName == defaultSamplerStateName )
-				{
-					pSamplerState = pSamplerStateDefault;
-				}
-				else if ( samplerName == shadowSamplerStateName ||  // Shader model 4+
-					samplerName == shadowMapTextureName )     // Older shader versions
-				{
-					pSamplerState = pSamplerStateShadowMap;
-				}
+			RVertexDescription* pVertexDescription = rSceneObject.GetVertexDescription();
+			if ( !pVertexDescription )
+			{
+				continue;
+			}
 
-				spCommandProxy->SetSamplerStates( rInputInfo.bindIndex, 1, &pSamplerState );
+			RIndexBuffer* pIndexBuffer = rSceneObject.GetIndexBuffer();
+			if ( !pIndexBuffer )
+			{
+				continue;
 			}
-		}
 
-		const ShaderTextureInfoSet* pTextureInfoSet = pPixelShaderVariant->GetTextureInfoSet( pixelShaderIndex );
-		if ( pTextureInfoSet )
-		{
-			size_t materialTextureCount = pMaterial->GetTextureParameterCount();
+			const BasePassMaterialState& rMaterialState = pMaterialStates[rInstance.materialStateIndex];
+			RVertexShader* pVertexShader = rMaterialState.pVertexShader;
+			RPixelShader* pPixelShader = rMaterialState.pPixelShader;
+			HELIUM_ASSERT( pVertexShader );
+			HELIUM_ASSERT( pPixelShader );
 
-			const DynamicArray< ShaderTextureInfo >& textureInputs = pTextureInfoSet->inputs;
-			size_t textureInputCount = textureInputs.GetSize();
-			for ( size_t inputIndex = 0; inputIndex < textureInputCount; ++inputIndex )
+			pVertexShader->CacheDescription( pRenderer, pVertexDescription );
+			RVertexInputLayout* pInputLayout = pVertexShader->GetCachedInputLayout();
+			if ( !pInputLayout )
 			{
-				const ShaderTextureInfo& rInputInfo = textureInputs[inputIndex];
-				Name textureName = rInputInfo.name;
+				continue;
+			}
 
-				RTexture* pTextureResource = NULL;
+			RConstantBuffer* pMaterialVertexConstantBuffer = rMaterialState.pVertexConstantBuffer;
+			RConstantBuffer* pMaterialPixelConstantBuffer = rMaterialState.pPixelConstantBuffer;
 
-				if ( textureName == shadowMapTextureName )
-				{
-					pTextureResource = pShadowDepthTexture;
-				}
-				else
-				{
-					for ( size_t materialTextureIndex = 0;
-						materialTextureIndex < materialTextureCount;
-						++materialTextureIndex )
-					{
-						const Material::TextureParameter& rTextureParameter = pMaterial->GetTextureParameter(
-							materialTextureIndex );
-						if ( rTextureParameter.name == textureName )
-						{
-							Texture* pTexture = rTextureParameter.value;
-							if ( pTexture )
-							{
-								pTextureResource = pTexture->GetRenderResource();
-							}
+			uint32_t vertexStride = rSceneObject.GetVertexStride();
+			uint32_t offset = 0;
 
-							break;
-						}
-					}
-				}
+			if ( pMaterialVertexConstantBuffer != pPreviousMaterialVertexConstantBuffer )
+			{
+				pCommandProxy->SetVertexConstantBuffers( 3, 1, &pMaterialVertexConstantBuffer );
+				pPreviousMaterialVertexConstantBuffer = pMaterialVertexConstantBuffer;
+			}
 
-				spCommandProxy->SetTexture( rInputInfo.bindIndex, pTextureResource );
+			if ( pMaterialPixelConstantBuffer != pPreviousMaterialPixelConstantBuffer )
+			{
+				pCommandProxy->SetPixelConstantBuffers( 1, 1, &pMaterialPixelConstantBuffer );
+				pPreviousMaterialPixelConstantBuffer = pMaterialPixelConstantBuffer;
 			}
+
+			pCommandProxy->SetVertexBuffers( 0, 1, &pVertexBuffer, &vertexStride, &offset );
+			pCommandProxy->SetIndexBuffer( pIndexBuffer );
+
+			if ( pVertexShader != pPreviousVertexShader )
+			{
+				pCommandProxy->SetVertexShader( pVertexShader );
+				pPreviousVertexShader = pVertexShader;
+			}
+
+			if ( pPixelShader != pPreviousPixelShader )
+			{
+				pCommandProxy->SetPixelShader( pPixelShader );
+				pPreviousPixelShader = pPixelShader;
+			}
+
+			pCommandProxy->SetVertexInputLayout( pInputLayout );
+
+			size_t samplerCount = rMaterialState.samplers.GetSize();
+			for ( size_t samplerIndex = 0; samplerIndex < samplerCount; ++samplerIndex )
+			{
+				const BasePassMaterialState::SamplerBinding& rBinding = rMaterialState.samplers[samplerIndex];
+				RSamplerState* pSamplerState = rBinding.pState;
+				pCommandProxy->SetSamplerStates( rBinding.bindIndex, 1, &pSamplerState );
+			}
+
+			size_t textureCount = rMaterialState.textures.GetSize();
+			for ( size_t textureIndex = 0; textureIndex < textureCount; ++textureIndex )
+			{
+				const BasePassMaterialState::TextureBinding& rBinding = rMaterialState.textures[textureIndex];
+				pCommandProxy->SetTexture( rBinding.bindIndex, rBinding.pTexture );
+			}
+
+			pRunInstance = &rInstance;
 		}
 
-		spCommandProxy->DrawIndexed(
-			primitiveType,
-			startVertex,
+		RConstantBuffer* pInstanceDataBuffer = rInstance.pInstanceDataBuffer;
+		pCommandProxy->SetVertexConstantBuffers(
+			2,
+			1,
+			&pInstanceDataBuffer,
+			&rInstance.instanceDataSize,
+			&rInstance.instanceDataOffset );
+		pCommandProxy->DrawIndexed(
+			rSubMeshData.GetPrimitiveType(),
+			rSubMeshData.GetStartVertex(),
 			0,
-			vertexRange,
-			startIndex,
-			primitiveCount );
+			rSubMeshData.GetVertexRange(),
+			rSubMeshData.GetStartIndex(),
+			rSubMeshData.GetPrimitiveCount() );
 	}
 }
 
@@ -2149,112 +2488,3 @@ Name GraphicsScene::GetSkinningRigidOptionName()
 
 	return skinningRigidOptionName;
 }
-
-/// Constructor.
-GraphicsScene::SubMeshFrontToBackCompare::SubMeshFrontToBackCompare()
-	: m_cameraDirection( 0.0f )
-	, m_pSceneObjects( NULL )
-	, m_pSubMeshes( NULL )
-{
-}
-
-/// Constructor.
-///
-/// @param[in] rCameraDirection  Camera world direction.
-/// @param[in] rSceneObjects     List of graphics scene objects in the scene.
-/// @param[in] rSubMeshes        List of scene object sub-meshes in the scene.
-GraphicsScene::SubMeshFrontToBackCompare::SubMeshFrontToBackCompare(
-	const Simd::Vector3& rCameraDirection,
-	const SparseArray< GraphicsSceneObject >& rSceneObjects,
-	const SparseArray< GraphicsSceneObject::SubMeshData >& rSubMeshes )
-	: m_cameraDirection( rCameraDirection )
-	, m_pSceneObjects( &rSceneObjects )
-	, m_pSubMeshes( &rSubMeshes )
-{
-}
-
-/// Compare two sub-meshes for sorting.
-///
-/// @param[in] subMeshIndex0  Index of the first sub-mesh to compare.
-/// @param[in] subMeshIndex1  Index of the second sub-mesh to compare.
-///
-/// @return  True if the first sub-mesh should be sorted before the second, false if it should be sorted after or if
-///          they share the same sorting priority.
-bool GraphicsScene::SubMeshFrontToBackCompare::operator()( size_t subMeshIndex0, size_t subMeshIndex1 ) const
-{
-	const GraphicsSceneObject::SubMeshData& rSubMesh0 = m_pSubMeshes->GetElement( subMeshIndex0 );
-	const GraphicsSceneObject::SubMeshData& rSubMesh1 = m_pSubMeshes->GetElement( subMeshIndex1 );
-
-	size_t sceneObjectIndex0 = rSubMesh0.GetSceneObjectId();
-	HELIUM_ASSERT( m_pSceneObjects->IsElementValid( sceneObjectIndex0 ) );
-	size_t sceneObjectIndex1 = rSubMesh1.GetSceneObjectId();
-	HELIUM_ASSERT( m_pSceneObjects->IsElementValid( sceneObjectIndex1 ) );
-
-	const GraphicsSceneObject& rSceneObject0 = m_pSceneObjects->GetElement( sceneObjectIndex0 );
-	const GraphicsSceneObject& rSceneObject1 = m_pSceneObjects->GetElement( sceneObjectIndex1 );
-
-	Simd::Vector3 object0Pos = Simd::Vector4ToVector3( rSceneObject0.GetTransform().GetRow( 3 ) );
-	Simd::Vector3 object1Pos = Simd::Vector4ToVector3( rSceneObject1.GetTransform().GetRow( 3 ) );
-
-	float distance0 = object0Pos.Dot( m_cameraDirection );
-	float distance1 = object1Pos.Dot( m_cameraDirection );
-
-	return ( distance0 < distance1 );
-}
-
-/// Constructor.
-GraphicsScene::SubMeshMaterialCompare::SubMeshMaterialCompare()
-	: m_pSubMeshes( NULL )
-{
-}
-
-/// Constructor.
-///
-/// @param[in] rSubMeshes  List of scene object sub-meshes in the scene.
-GraphicsScene::SubMeshMaterialCompare::SubMeshMaterialCompare(
-	const SparseArray< GraphicsSceneObject::SubMeshData >& rSubMeshes )
-	: m_pSubMeshes( &rSubMeshes )
-{
-}
-
-/// Compare two sub-meshes for sorting.
-///
-/// @param[in] subMeshIndex0  Index of the first sub-mesh to compare.
-/// @param[in] subMeshIndex1  Index of the second sub-mesh to compare.
-///
-/// @return  True if the first sub-mesh should be sorted before the second, false if it should be sorted after or if
-///          they share the same sorting priority.
-bool GraphicsScene::SubMeshMaterialCompare::operator()( size_t subMeshIndex0, size_t subMeshIndex1 ) const
-{
-	const GraphicsSceneObject::SubMeshData& rSubMesh0 = m_pSubMeshes->GetElement( subMeshIndex0 );
-	const GraphicsSceneObject::SubMeshData& rSubMesh1 = m_pSubMeshes->GetElement( subMeshIndex1 );
-
-	Material* pMaterial0 = rSubMesh0.GetMaterial();
-	Material* pMaterial1 = rSubMesh1.GetMaterial();
-	if ( pMaterial0 == pMaterial1 )
-	{
-		return false;
-	}
-
-	if ( !pMaterial0 )
-	{
-		return true;
-	}
-
-	if ( !pMaterial1 )
-	{
-		return false;
-	}
-
-	ShaderVariant* pVariant0 = pMaterial0->GetShaderVariant( RShader::TYPE_VERTEX );
-	ShaderVariant* pVariant1 = pMaterial1->GetShaderVariant( RShader::TYPE_VERTEX );
-	if ( pVariant0 != pVariant1 )
-	{
-		return ( pVariant0 < pVariant1 );
-	}
-
-	pVariant0 = pMaterial0->GetShaderVariant( RShader::TYPE_PIXEL );
-	pVariant1 = pMaterial1->GetShaderVariant( RShader::TYPE_PIXEL );
-
-	return ( pVariant0 < pVariant1 );
-}
@@ -5,9 +5,12 @@
 #include "Reflect/Object.h"
 
 #include "Foundation/BitArray.h"
+#include "Foundation/HashMap.h"
 #include "Rendering/RRenderResource.h"
 #include "GraphicsTypes/GraphicsSceneObject.h"
 #include "GraphicsTypes/GraphicsSceneView.h"
+#include "Graphics/ConstantBufferRing.h"
+#include "Graphics/SceneObjectBvh.h"
 
 #if GRAPHICS_SCENE_BUFFERED_DRAWER
 #include "Foundation/ObjectPool.h"
@@ -18,6 +21,13 @@ namespace Helium
 {
     HELIUM_DECLARE_RPTR( RConstantBuffer );
 
+    class Renderer;
+    class RPixelShader;
+    class RRenderCommandProxy;
+    class RSamplerState;
+    class RTexture;
+    class RVertexShader;
+
     class HELIUM_GRAPHICS_API SceneObjectTransform : public Helium::Component
     {
         HELIUM_DECLARE_COMPONENT(Helium::SceneObjectTransform, Helium::Component);
@@ -31,6 +41,73 @@ namespace Helium
         HELIUM_DECLARE_CLASS( Helium::GraphicsScene, Reflect::Object );
 
     public:
+        /// Sub-mesh instance to draw in a depth-only pass.
+        struct DepthOnlyInstance
+        {
+            /// Scene object providing the vertex data.
+            const GraphicsSceneObject* pSceneObject;
+            /// Sub-mesh to draw.
+            const GraphicsSceneObject::SubMeshData* pSubMeshData;
+            /// Constant buffer holding the instance vertex constants.
+            RConstantBuffer* pInstanceDataBuffer;
+            /// Offset of the instance vertex constants within their buffer, in bytes.
+            size_t instanceDataOffset;
+            /// Size of the instance vertex constants, in bytes.
+            size_t instanceDataSize;
+        };
+
+        /// Material draw state resolved for the base pass.
+        struct BasePassMaterialState
+        {
+            /// Sampler state bound to a pixel shader sampler slot.
+            struct SamplerBinding
+            {
+                /// Sampler bind index.
+                uint16_t bindIndex;
+                /// Sampler state to bind.
+                RSamplerState* pState;
+            };
+
+            /// Texture bound to a pixel shader texture slot.
+            struct TextureBinding
+            {
+                /// Texture bind index.
+                uint16_t bindIndex;
+                /// Texture to bind.
+                RTexture* pTexture;
+            };
+
+            /// Vertex shader variant.
+            RVertexShader* pVertexShader;
+            /// Pixel shader variant.
+            RPixelShader* pPixelShader;
+            /// Material vertex constant buffer.
+            RConstantBuffer* pVertexConstantBuffer;
+            /// Material pixel constant buffer.
+            RConstantBuffer* pPixelConstantBuffer;
+            /// Sampler states used by the pixel shader.
+            DynamicArray< SamplerBinding > samplers;
+            /// Textures used by the pixel shader.
+            DynamicArray< TextureBinding > textures;
+        };
+
+        /// Sub-mesh instance to draw in the base pass.
+        struct BasePassInstance
+        {
+            /// Scene object providing the vertex data.
+            const GraphicsSceneObject* pSceneObject;
+            /// Sub-mesh to draw.
+            const GraphicsSceneObject::SubMeshData* pSubMeshData;
+            /// Index of the material draw state with which to draw the sub-mesh.
+            size_t materialStateIndex;
+            /// Constant buffer holding the instance vertex constants.
+            RConstantBuffer* pInstanceDataBuffer;
+            /// Offset of the instance vertex constants within their buffer, in bytes.
+            size_t instanceDataOffset;
+            /// Size of the instance vertex constants, in bytes.
+            size_t instanceDataSize;
+        };
+
         /// @name Construction/Destruction
         //@{
         GraphicsScene();
@@ -56,6 +133,9 @@ namespace Helium
         size_t AllocateSceneObject();
         void ReleaseSceneObject( size_t id );
         inline GraphicsSceneObject* GetSceneObject( size_t id );
+
+        void SetSceneObjectWorldBounds( size_t id, const Simd::AaBox& rBox );
+        inline const SceneObjectBvh& GetSceneObjectBvh() const;
         //@}
 
         /// @name Scene Asset Sub-mesh Allocation
@@ -88,6 +168,20 @@ namespace Helium
         //@}
 #endif // GRAPHICS_SCENE_BUFFERED_DRAWER
 
+        /// @name Depth-only Drawing
+        //@{
+        static void DrawDepthOnlyInstances(
+            RRenderCommandProxy* pCommandProxy, Renderer* pRenderer, RVertexShader* pNoSkinningVertexShader,
+            RVertexShader* pSmoothSkinningVertexShader, const DepthOnlyInstance* pInstances, size_t instanceCount );
+        //@}
+
+        /// @name Base Pass Drawing
+        //@{
+        static void DrawBasePassInstances(
+            RRenderCommandProxy* pCommandProxy, Renderer* pRenderer, const BasePassMaterialState* pMaterialStates,
+            const BasePassInstance* pInstances, size_t instanceCount );
+        //@}
+
         /// @name Static Reserved Names
         //@{
         static Name GetDefaultSamplerStateName();
@@ -96,52 +190,6 @@ namespace Helium
         //@}
 
     private:
-        /// Front-to-back sub-mesh sort comparison function
-        class HELIUM_GRAPHICS_API SubMeshFrontToBackCompare
-        {
-        public:
-            /// @name Construction/Destruction
-            //@{
-            SubMeshFrontToBackCompare();
-            SubMeshFrontToBackCompare(
-                const Simd::Vector3& rCameraDirection, const SparseArray< GraphicsSceneObject >& rSceneObjects,
-                const SparseArray< GraphicsSceneObject::SubMeshData >& rSubMeshes );
-            //@}
-
-            /// @name Overloaded Operators
-            //@{
-            bool operator()( size_t subMeshIndex0, size_t subMeshIndex1 ) const;
-            //@}
-
-        private:
-            /// Camera direction.
-            Simd::Vector3 m_cameraDirection;
-            /// Scene object list.
-            const SparseArray< GraphicsSceneObject >* m_pSceneObjects;
-            /// Scene object sub-mesh list.
-            const SparseArray< GraphicsSceneObject::SubMeshData >* m_pSubMeshes;
-        };
-
-        /// Material-based sub-mesh sort comparison function
-        class HELIUM_GRAPHICS_API SubMeshMaterialCompare
-        {
-        public:
-            /// @name Construction/Destruction
-            //@{
-            SubMeshMaterialCompare();
-            explicit SubMeshMaterialCompare( const SparseArray< GraphicsSceneObject::SubMeshData >& rSubMeshes );
-            //@}
-
-            /// @name Overloaded Operators
-            //@{
-            bool operator()( size_t subMeshIndex0, size_t subMeshIndex1 ) const;
-            //@}
-
-        private:
-            /// Scene object sub-mesh list.
-            const SparseArray< GraphicsSceneObject::SubMeshData >* m_pSubMeshes;
-        };
-
         /// Scene view list.
         SparseArray< GraphicsSceneView > m_sceneViews;
         /// Scene object list.
@@ -158,10 +206,41 @@ namespace Helium
         DynamicArray< BufferedDrawer* > m_viewBufferedDrawers;
 #endif // GRAPHICS_SCENE_BUFFERED_DRAWER
 
+        /// Bounding volume hierarchy of scene objects with world bounds set.
+        SceneObjectBvh m_sceneObjectBvh;
+
+        /// Scene objects in the current view whose bounds straddle a frustum plane, to be tested in batches.
+        DynamicArray< size_t > m_cullCandidateIds;
+        /// Bounding spheres of the cull candidates in SIMD-aligned struct-of-arrays form (center x, y, and z
+        /// coordinates followed by radii, each array holding m_cullCandidateBoundsCapacity entries).
+        float32_t* m_pCullCandidateBounds;
+        /// Number of cull candidates for which bounding sphere storage has been allocated.
+        size_t m_cullCandidateBoundsCapacity;
+        /// Frustum test result bits for the cull candidates.
+        DynamicArray< uint32_t > m_cullCandidateVisibilityBits;
+
         /// Visible scene objects for the current view.
         BitArray<> m_visibleSceneObjects;
         /// Scene object sub-data index list (for sorting during rendering).
-        DynamicArray< size_t > m_sceneObjectSubMeshIndices;
+        DynamicArray< uint32_t > m_sceneObjectSubMeshIndices;
+        /// Draw key for each entry in the scene object sub-data index list.
+        DynamicArray< uint64_t > m_sceneObjectSubMeshSortKeys;
+        /// Scratch buffer for sorting scene object sub-data draw keys.
+        DynamicArray< uint64_t > m_sortScratchKeys;
+        /// Scratch buffer for sorting scene object sub-data indices.
+        DynamicArray< uint32_t > m_sortScratchIndices;
+        /// Draw key IDs assigned to vertex shader variants for the current sort.
+        HashMap< const void*, uint32_t > m_vertexShaderDrawKeyIds;
+        /// Draw key IDs assigned to pixel shader variants for the current sort.
+        HashMap< const void*, uint32_t > m_pixelShaderDrawKeyIds;
+        /// Draw key IDs assigned to materials for the current sort.
+        HashMap< const void*, uint32_t > m_materialDrawKeyIds;
+        /// Sorted sub-mesh instances for the current depth-only pass.
+        DynamicArray< DepthOnlyInstance > m_depthOnlyInstances;
+        /// Material draw states resolved for the current base pass (entries past the count in use are kept for reuse).
+        DynamicArray< BasePassMaterialState > m_basePassMaterialStates;
+        /// Sorted sub-mesh instances for the current base pass.
+        DynamicArray< BasePassInstance > m_basePassInstances;
 
         /// Ambient light top color.
         Color m_ambientLightTopColor;
@@ -198,18 +277,20 @@ namespace Helium
         /// Per-view vertex constant buffers for shadow depth rendering.
         DynamicArray< RConstantBufferPtr > m_shadowViewVertexDataBuffers[ 2 ];
 
-        /// Pool of per-instance vertex constant buffers for non-skinned meshes.
-        DynamicArray< RConstantBufferPtr > m_staticInstanceVertexGlobalDataBufferPool[ 2 ];
-        /// Pool of per-instance vertex constant buffers for skinned meshes.
-        DynamicArray< RConstantBufferPtr > m_skinnedInstanceVertexGlobalDataBufferPool[ 2 ];
+        /// Per-frame allocator for instance vertex constants.
+        ConstantBufferRing m_instanceConstantBufferRing;
 
         /// Scene object global vertex constant buffers.
         DynamicArray< RConstantBuffer* > m_objectVertexGlobalDataBuffers;
+        /// Scene object global vertex constant offsets within their buffers.
+        DynamicArray< size_t > m_objectVertexGlobalDataOffsets;
         /// Mapped scene object global vertex constant buffer addresses.
         DynamicArray< float32_t* > m_mappedObjectVertexGlobalDataBuffers;
 
         /// Sub-mesh global vertex constant buffers.
         DynamicArray< RConstantBuffer* > m_subMeshVertexGlobalDataBuffers;
+        /// Sub-mesh global vertex constant offsets within their buffers.
+        DynamicArray< size_t > m_subMeshVertexGlobalDataOffsets;
         /// Mapped sub-mesh global veretex constant buffer addresses.
         DynamicArray< float32_t* > m_mappedSubMeshVertexGlobalDataBuffers;
 
@@ -223,6 +304,14 @@ namespace Helium
 
         void SwapDynamicConstantBuffers();
 
+        void SortSubMeshesFrontToBack( uint32_t pass, const Simd::Vector3& rDirection, bool bGroupMeshes );
+        void SortSubMeshesByMaterial( uint32_t pass, const Simd::Vector3& rViewDirection );
+        void SortSubMeshIndices();
+
+        void GatherDepthOnlyInstances();
+
+        void CullSceneObjects( const Simd::Frustum& rFrustum );
+
         void DrawSceneView( uint_fast32_t viewIndex );
 
         void DrawShadowDepthPass( uint_fast32_t viewIndex );
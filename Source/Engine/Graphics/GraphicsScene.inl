@@ -30,6 +30,18 @@ namespace Helium
         return &m_sceneObjects[ id ];
     }
 
+    /// Get the bounding volume hierarchy of the objects in this scene, for use in spatial queries.
+    ///
+    /// Only objects whose bounds have been set using SetSceneObjectWorldBounds() are included.
+    ///
+    /// @return  Scene object bounding volume hierarchy.
+    ///
+    /// @see SetSceneObjectWorldBounds()
+    const SceneObjectBvh& GraphicsScene::GetSceneObjectBvh() const
+    {
+        return m_sceneObjectBvh;
+    }
+
     /// Access the scene object sub-mesh data with the specified ID.
     ///
     /// @param[in] id  ID of the sub-mesh data to retrieve.
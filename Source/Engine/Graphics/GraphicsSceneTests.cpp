@@ -0,0 +1,572 @@
+#include "Graphics/GraphicsScene.h"
+
+#include "Rendering/RConstantBuffer.h"
+#include "Rendering/RIndexBuffer.h"
+#include "Rendering/RPixelShader.h"
+#include "Rendering/RRenderCommandProxy.h"
+#include "Rendering/Renderer.h"
+#include "Rendering/RVertexBuffer.h"
+#include "Rendering/RVertexDescription.h"
+#include "Rendering/RVertexInputLayout.h"
+#include "Rendering/RVertexShader.h"
+
+#include "gtest/gtest.h"
+
+using namespace Helium;
+
+namespace
+{
+	class TestVertexBuffer : public RVertexBuffer
+	{
+	public:
+		void* Map( ERendererBufferMapHint /*hint*/ ) { return NULL; }
+		void Unmap() {}
+	};
+
+	class TestIndexBuffer : public RIndexBuffer
+	{
+	public:
+		void* Map( ERendererBufferMapHint /*hint*/ ) { return NULL; }
+		void Unmap() {}
+	};
+
+	class TestConstantBuffer : public RConstantBuffer
+	{
+	public:
+		void* Map( ERendererBufferMapHint /*hint*/ ) { return NULL; }
+		void Unmap() {}
+	};
+
+	class TestVertexDescription : public RVertexDescription
+	{
+	};
+
+	class TestVertexInputLayout : public RVertexInputLayout
+	{
+	};
+
+	class TestVertexShader : public RVertexShader
+	{
+	public:
+		void* Lock() { return NULL; }
+		bool Unlock() { return true; }
+	};
+
+	class TestPixelShader : public RPixelShader
+	{
+	public:
+		void* Lock() { return NULL; }
+		bool Unlock() { return true; }
+	};
+
+	/// Renderer that only creates vertex input layouts, which is all the sub-mesh drawers need.
+	class TestRenderer : public Renderer
+	{
+	public:
+		size_t inputLayoutCount;
+
+		TestRenderer() : inputLayoutCount( 0 ) {}
+
+		bool Initialize() { return true; }
+		void Cleanup() {}
+
+		bool CreateMainContext( const ContextInitParameters& /*rInitParameters*/ ) { return false; }
+		bool ResetMainContext( const ContextInitParameters& /*rInitParameters*/ ) { return false; }
+		RRenderContext* GetMainContext() { return NULL; }
+		RRenderContext* CreateSubContext( const ContextInitParameters& /*rInitParameters*/ ) { return NULL; }
+		EStatus GetStatus() { return STATUS_READY; }
+		EStatus Reset() { return STATUS_READY; }
+
+		RRasterizerState* CreateRasterizerState( const RRasterizerState::Description& /*rDescription*/ ) { return NULL; }
+		RBlendState* CreateBlendState( const RBlendState::Description& /*rDescription*/ ) { return NULL; }
+		RDepthStencilState* CreateDepthStencilState( const RDepthStencilState::Description& /*rDescription*/ ) { return NULL; }
+		RSamplerState* CreateSamplerState( const RSamplerState::Description& /*rDescription*/ ) { return NULL; }
+
+		RSurface* CreateDepthStencilSurface(
+			uint32_t /*width*/, uint32_t /*height*/, ERendererSurfaceFormat /*format*/, uint32_t /*multisampleCount*/ )
+		{
+			return NULL;
+		}
+
+		RVertexShader* CreateVertexShader( size_t /*size*/, const void* /*pData*/ ) { return NULL; }
+		RPixelShader* CreatePixelShader( size_t /*size*/, const void* /*pData*/ ) { return NULL; }
+
+		RVertexBuffer* CreateVertexBuffer( size_t /*size*/, ERendererBufferUsage /*usage*/, const void* /*pData*/ )
+		{
+			return NULL;
+		}
+
+		RIndexBuffer* CreateIndexBuffer(
+			size_t /*size*/, ERendererBufferUsage /*usage*/, ERendererIndexFormat /*format*/, const void* /*pData*/ )
+		{
+			return NULL;
+		}
+
+		RConstantBuffer* CreateConstantBuffer( size_t /*size*/, ERendererBufferUsage /*usage*/, const void* /*pData*/ )
+		{
+			return NULL;
+		}
+
+		RVertexDescription* CreateVertexDescription(
+			const RVertexDescription::Element* /*pElements*/, size_t /*elementCount*/ )
+		{
+			return NULL;
+		}
+
+		RVertexInputLayout* CreateVertexInputLayout( RVertexDescription* /*pDescription*/, RVertexShader* /*pShader*/ )
+		{
+			++inputLayoutCount;
+			return new TestVertexInputLayout;
+		}
+
+		RTexture2d* CreateTexture2d(
+			uint32_t /*width*/, uint32_t /*height*/, uint32_t /*mipCount*/, ERendererPixelFormat /*format*/,
+			ERendererBufferUsage /*usage*/, const RTexture2d::CreateData* /*pData*/ )
+		{
+			return NULL;
+		}
+
+		RFence* CreateFence() { return NULL; }
+		void SyncFence( RFence* /*pFence*/ ) {}
+		bool TrySyncFence( RFence* /*pFence*/ ) { return true; }
+
+		RRenderCommandProxy* GetImmediateCommandProxy() { return NULL; }
+		RRenderCommandProxy* CreateDeferredCommandProxy() { return NULL; }
+
+		void Flush() {}
+	};
+
+	/// Command proxy that only counts the commands issued through it.
+	class RecordingCommandProxy : public RRenderCommandProxy
+	{
+	public:
+		size_t vertexShaderCount;
+		size_t vertexBufferCount;
+		size_t indexBufferCount;
+		size_t inputLayoutCount;
+		size_t vertexConstantBufferCount;
+		size_t pixelShaderCount;
+		size_t pixelConstantBufferCount;
+		size_t samplerStateCount;
+		size_t textureCount;
+		size_t drawCount;
+
+		RecordingCommandProxy()
+			: vertexShaderCount( 0 )
+			, vertexBufferCount( 0 )
+			, indexBufferCount( 0 )
+			, inputLayoutCount( 0 )
+			, vertexConstantBufferCount( 0 )
+			, pixelShaderCount( 0 )
+			, pixelConstantBufferCount( 0 )
+			, samplerStateCount( 0 )
+			, textureCount( 0 )
+			, drawCount( 0 )
+		{
+		}
+
+		size_t GetStateChangeCount() const
+		{
+			return vertexShaderCount + vertexBufferCount + indexBufferCount + inputLayoutCount;
+		}
+
+		size_t GetCommandCount() const
+		{
+			return GetStateChangeCount() + vertexConstantBufferCount + pixelShaderCount + pixelConstantBufferCount +
+				samplerStateCount + textureCount + drawCount;
+		}
+
+		void SetRasterizerState( RRasterizerState* /*pState*/ ) {}
+		void SetBlendState( RBlendState* /*pState*/ ) {}
+		void SetDepthStencilState( RDepthStencilState* /*pState*/, uint8_t /*stencilReferenceValue*/ ) {}
+		void SetSamplerStates( size_t /*startIndex*/, size_t samplerCount, RSamplerState* const* /*ppStates*/ )
+		{
+			samplerStateCount += samplerCount;
+		}
+
+		void SetRenderSurfaces( RSurface* /*pRenderTargetSurface*/, RSurface* /*pDepthStencilSurface*/ ) {}
+		void SetViewport( uint32_t /*x*/, uint32_t /*y*/, uint32_t /*width*/, uint32_t /*height*/ ) {}
+
+		void BeginScene() {}
+		void EndScene() {}
+
+		void Clear( uint32_t /*clearFlags*/, const Color& /*rColor*/, float32_t /*depth*/, uint8_t /*stencil*/ ) {}
+
+		void SetIndexBuffer( RIndexBuffer* /*pBuffer*/ ) { ++indexBufferCount; }
+		void SetVertexBuffers(
+			size_t /*startIndex*/, size_t /*bufferCount*/, RVertexBuffer* const* /*ppBuffers*/, uint32_t* /*pStrides*/,
+			uint32_t* /*pOffsets*/ )
+		{
+			++vertexBufferCount;
+		}
+		void SetVertexInputLayout( RVertexInputLayout* /*pLayout*/ ) { ++inputLayoutCount; }
+
+		void SetVertexShader( RVertexShader* /*pShader*/ ) { ++vertexShaderCount; }
+		void SetPixelShader( RPixelShader* /*pShader*/ ) { ++pixelShaderCount; }
+
+		void SetVertexConstantBuffers(
+			size_t /*startIndex*/, size_t /*bufferCount*/, RConstantBuffer* const* /*ppBuffers*/,
+			const size_t* /*pLimitSizes*/, const size_t* /*pOffsets*/ )
+		{
+			++vertexConstantBufferCount;
+		}
+		void SetPixelConstantBuffers(
+			size_t /*startIndex*/, size_t /*bufferCount*/, RConstantBuffer* const* /*ppBuffers*/,
+			const size_t* /*pLimitSizes*/, const size_t* /*pOffsets*/ )
+		{
+			++pixelConstantBufferCount;
+		}
+
+		void SetTexture( size_t /*samplerIndex*/, RTexture* /*pTexture*/ ) { ++textureCount; }
+
+		void DrawIndexed(
+			ERendererPrimitiveType /*primitiveType*/, uint32_t /*baseVertexIndex*/, uint32_t /*minIndex*/,
+			uint32_t /*usedVertexCount*/, uint32_t /*startIndex*/, uint32_t /*primitiveCount*/ )
+		{
+			++drawCount;
+		}
+		void DrawUnindexed(
+			ERendererPrimitiveType /*primitiveType*/, uint32_t /*baseVertexIndex*/, uint32_t /*primitiveCount*/ )
+		{
+			++drawCount;
+		}
+
+		void SetFence( RFence* /*pFence*/ ) {}
+
+		void UnbindResources() {}
+
+		void ExecuteCommandList( RRenderCommandList* /*pCommandList*/ ) {}
+		void FinishCommandList( RRenderCommandListPtr& /*rspCommandList*/ ) {}
+	};
+
+	const size_t INSTANCES_PER_MESH = 100;
+
+	/// Two meshes sharing a vertex description, each drawn as a single sub-mesh.
+	class SubMeshDrawTest : public testing::Test
+	{
+	protected:
+		SmartPtr< TestVertexShader > m_spNoSkinningShader;
+		SmartPtr< TestVertexShader > m_spSmoothSkinningShader;
+		SmartPtr< TestConstantBuffer > m_spInstanceBuffer;
+		SmartPtr< RecordingCommandProxy > m_spCommandProxy;
+		TestRenderer m_renderer;
+
+		GraphicsSceneObject m_sceneObjects[ 2 ];
+		GraphicsSceneObject::SubMeshData m_subMesh0;
+		GraphicsSceneObject::SubMeshData m_subMesh1;
+
+		SubMeshDrawTest()
+			: m_subMesh0( 0 )
+			, m_subMesh1( 1 )
+		{
+		}
+
+		void SetUp()
+		{
+			m_spNoSkinningShader = new TestVertexShader;
+			m_spSmoothSkinningShader = new TestVertexShader;
+			m_spInstanceBuffer = new TestConstantBuffer;
+			m_spCommandProxy = new RecordingCommandProxy;
+
+			RVertexDescriptionPtr spDescription( new TestVertexDescription );
+			for( size_t meshIndex = 0; meshIndex < HELIUM_ARRAY_COUNT( m_sceneObjects ); ++meshIndex )
+			{
+				m_sceneObjects[ meshIndex ].SetVertexData( new TestVertexBuffer, spDescription, 32 );
+				m_sceneObjects[ meshIndex ].SetIndexBuffer( new TestIndexBuffer );
+
+				GraphicsSceneObject::SubMeshData& rSubMesh = GetSubMesh( meshIndex );
+				rSubMesh.SetPrimitiveType( RENDERER_PRIMITIVE_TYPE_TRIANGLE_LIST );
+				rSubMesh.SetPrimitiveCount( 12 );
+				rSubMesh.SetStartVertex( 0 );
+				rSubMesh.SetVertexRange( 24 );
+				rSubMesh.SetStartIndex( 0 );
+			}
+		}
+
+		GraphicsSceneObject::SubMeshData& GetSubMesh( size_t meshIndex )
+		{
+			return ( meshIndex == 0 ? m_subMesh0 : m_subMesh1 );
+		}
+	};
+
+	class DepthOnlyDrawTest : public SubMeshDrawTest
+	{
+	protected:
+		DynamicArray< GraphicsScene::DepthOnlyInstance > m_instances;
+
+		void AddInstance( size_t meshIndex, size_t instanceIndex )
+		{
+			GraphicsScene::DepthOnlyInstance* pInstance = m_instances.New();
+			pInstance->pSceneObject = &m_sceneObjects[ meshIndex ];
+			pInstance->pSubMeshData = &GetSubMesh( meshIndex );
+			pInstance->pInstanceDataBuffer = m_spInstanceBuffer;
+			pInstance->instanceDataOffset = instanceIndex * 64;
+			pInstance->instanceDataSize = 64;
+		}
+
+		void Draw()
+		{
+			GraphicsScene::DrawDepthOnlyInstances(
+				m_spCommandProxy,
+				&m_renderer,
+				m_spNoSkinningShader,
+				m_spSmoothSkinningShader,
+				m_instances.GetData(),
+				m_instances.GetSize() );
+		}
+	};
+
+	/// Two materials sharing a vertex shader, one binding two samplers and a texture and the other a sampler and two
+	/// textures.
+	class BasePassDrawTest : public SubMeshDrawTest
+	{
+	protected:
+		SmartPtr< TestPixelShader > m_spPixelShaders[ 2 ];
+		SmartPtr< TestConstantBuffer > m_spMaterialBuffers[ 4 ];
+
+		DynamicArray< GraphicsScene::BasePassMaterialState > m_materialStates;
+		DynamicArray< GraphicsScene::BasePassInstance > m_instances;
+
+		void SetUp()
+		{
+			SubMeshDrawTest::SetUp();
+
+			for( size_t bufferIndex = 0; bufferIndex < HELIUM_ARRAY_COUNT( m_spMaterialBuffers ); ++bufferIndex )
+			{
+				m_spMaterialBuffers[ bufferIndex ] = new TestConstantBuffer;
+			}
+
+			for( size_t materialIndex = 0; materialIndex < HELIUM_ARRAY_COUNT( m_spPixelShaders ); ++materialIndex )
+			{
+				m_spPixelShaders[ materialIndex ] = new TestPixelShader;
+
+				GraphicsScene::BasePassMaterialState* pState = m_materialStates.New();
+				pState->pVertexShader = m_spNoSkinningShader;
+				pState->pPixelShader = m_spPixelShaders[ materialIndex ];
+				pState->pVertexConstantBuffer = m_spMaterialBuffers[ materialIndex * 2 ];
+				pState->pPixelConstantBuffer = m_spMaterialBuffers[ materialIndex * 2 + 1 ];
+
+				for( uint16_t bindIndex = 0; bindIndex < 2 - materialIndex; ++bindIndex )
+				{
+					GraphicsScene::BasePassMaterialState::SamplerBinding* pSampler = pState->samplers.New();
+					pSampler->bindIndex = bindIndex;
+					pSampler->pState = NULL;
+				}
+
+				for( uint16_t bindIndex = 0; bindIndex < 1 + materialIndex; ++bindIndex )
+				{
+					GraphicsScene::BasePassMaterialState::TextureBinding* pTexture = pState->textures.New();
+					pTexture->bindIndex = bindIndex;
+					pTexture->pTexture = NULL;
+				}
+			}
+		}
+
+		void AddInstance( size_t meshIndex, size_t materialIndex, size_t instanceIndex )
+		{
+			GraphicsScene::BasePassInstance* pInstance = m_instances.New();
+			pInstance->pSceneObject = &m_sceneObjects[ meshIndex ];
+			pInstance->pSubMeshData = &GetSubMesh( meshIndex );
+			pInstance->materialStateIndex = materialIndex;
+			pInstance->pInstanceDataBuffer = m_spInstanceBuffer;
+			pInstance->instanceDataOffset = instanceIndex * 64;
+			pInstance->instanceDataSize = 64;
+		}
+
+		void Draw()
+		{
+			GraphicsScene::DrawBasePassInstances(
+				m_spCommandProxy,
+				&m_renderer,
+				m_materialStates.GetData(),
+				m_instances.GetData(),
+				m_instances.GetSize() );
+		}
+	};
+}
+
+TEST_F( DepthOnlyDrawTest, SortedInstancesSetDrawStateOncePerMesh )
+{
+	for( size_t meshIndex = 0; meshIndex < HELIUM_ARRAY_COUNT( m_sceneObjects ); ++meshIndex )
+	{
+		for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+		{
+			AddInstance( meshIndex, instanceIndex );
+		}
+	}
+
+	Draw();
+
+	EXPECT_EQ( 1u, m_spCommandProxy->vertexShaderCount );
+	EXPECT_EQ( 2u, m_spCommandProxy->vertexBufferCount );
+	EXPECT_EQ( 2u, m_spCommandProxy->indexBufferCount );
+	EXPECT_EQ( 2u, m_spCommandProxy->inputLayoutCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->vertexConstantBufferCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->drawCount );
+
+	// Both meshes share a vertex description, so the input layout is only created once.
+	EXPECT_EQ( 1u, m_renderer.inputLayoutCount );
+}
+
+TEST_F( DepthOnlyDrawTest, InterleavedInstancesSetDrawStatePerInstance )
+{
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 0, instanceIndex );
+		AddInstance( 1, instanceIndex );
+	}
+
+	Draw();
+
+	EXPECT_EQ( 1u, m_spCommandProxy->vertexShaderCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->vertexBufferCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->indexBufferCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->inputLayoutCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->drawCount );
+}
+
+TEST_F( DepthOnlyDrawTest, SortingReducesStateChanges )
+{
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 0, instanceIndex );
+		AddInstance( 1, instanceIndex );
+	}
+
+	Draw();
+	size_t interleavedStateChangeCount = m_spCommandProxy->GetStateChangeCount();
+
+	m_instances.Resize( 0 );
+	m_spCommandProxy = new RecordingCommandProxy;
+	for( size_t meshIndex = 0; meshIndex < HELIUM_ARRAY_COUNT( m_sceneObjects ); ++meshIndex )
+	{
+		for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+		{
+			AddInstance( meshIndex, instanceIndex );
+		}
+	}
+
+	Draw();
+	size_t sortedStateChangeCount = m_spCommandProxy->GetStateChangeCount();
+
+	EXPECT_LT( sortedStateChangeCount * 50, interleavedStateChangeCount );
+}
+
+TEST_F( DepthOnlyDrawTest, InstancesWithoutVertexDataAreSkipped )
+{
+	m_sceneObjects[ 1 ].SetVertexData( NULL, NULL, 0 );
+
+	AddInstance( 0, 0 );
+	AddInstance( 1, 0 );
+	AddInstance( 0, 1 );
+
+	Draw();
+
+	EXPECT_EQ( 2u, m_spCommandProxy->drawCount );
+	EXPECT_EQ( 2u, m_spCommandProxy->vertexConstantBufferCount );
+}
+
+TEST_F( BasePassDrawTest, RepeatedPropsSetDrawStateOncePerRun )
+{
+	// Three runs: each mesh with the first material, then the first mesh again with the second material.
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 0, 0, instanceIndex );
+	}
+
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 1, 0, instanceIndex );
+	}
+
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 0, 1, instanceIndex );
+	}
+
+	Draw();
+
+	EXPECT_EQ( 1u, m_spCommandProxy->vertexShaderCount );
+	EXPECT_EQ( 2u, m_spCommandProxy->pixelShaderCount );
+	EXPECT_EQ( 3u, m_spCommandProxy->vertexBufferCount );
+	EXPECT_EQ( 3u, m_spCommandProxy->indexBufferCount );
+	EXPECT_EQ( 3u, m_spCommandProxy->inputLayoutCount );
+	EXPECT_EQ( 2u, m_spCommandProxy->pixelConstantBufferCount );
+	EXPECT_EQ( 2u + 2u + 1u, m_spCommandProxy->samplerStateCount );
+	EXPECT_EQ( 1u + 1u + 2u, m_spCommandProxy->textureCount );
+	EXPECT_EQ( 3 * INSTANCES_PER_MESH, m_spCommandProxy->drawCount );
+
+	// One material vertex constant buffer bind per material, and one instance constant buffer bind per draw.
+	EXPECT_EQ( 2 + 3 * INSTANCES_PER_MESH, m_spCommandProxy->vertexConstantBufferCount );
+
+	EXPECT_EQ( 1u, m_renderer.inputLayoutCount );
+}
+
+TEST_F( BasePassDrawTest, InterleavedPropsSetDrawStatePerInstance )
+{
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 0, 0, instanceIndex );
+		AddInstance( 1, 0, instanceIndex );
+	}
+
+	Draw();
+
+	// Shaders and material constants are only set when they change, but everything else is set for every run.
+	EXPECT_EQ( 1u, m_spCommandProxy->vertexShaderCount );
+	EXPECT_EQ( 1u, m_spCommandProxy->pixelShaderCount );
+	EXPECT_EQ( 1u, m_spCommandProxy->pixelConstantBufferCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->vertexBufferCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->indexBufferCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->inputLayoutCount );
+	EXPECT_EQ( 2 * 2 * INSTANCES_PER_MESH, m_spCommandProxy->samplerStateCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->textureCount );
+	EXPECT_EQ( 2 * INSTANCES_PER_MESH, m_spCommandProxy->drawCount );
+}
+
+TEST_F( BasePassDrawTest, RunsReduceCommandCount )
+{
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 0, 0, instanceIndex );
+		AddInstance( 1, 0, instanceIndex );
+	}
+
+	Draw();
+	size_t interleavedCommandCount = m_spCommandProxy->GetCommandCount();
+
+	m_instances.Resize( 0 );
+	m_spCommandProxy = new RecordingCommandProxy;
+	for( size_t meshIndex = 0; meshIndex < HELIUM_ARRAY_COUNT( m_sceneObjects ); ++meshIndex )
+	{
+		for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+		{
+			AddInstance( meshIndex, 0, instanceIndex );
+		}
+	}
+
+	Draw();
+	size_t sortedCommandCount = m_spCommandProxy->GetCommandCount();
+
+	// Runs of repeated props cost two commands per draw (instance constants and the draw itself), plus the buffers,
+	// input layout, two samplers and texture of each run and the shaders and material constants set once.  When every
+	// draw starts a run of its own, each one costs eight.
+	EXPECT_EQ( 2 * 2 * INSTANCES_PER_MESH + 2 * ( 3 + 2 + 1 ) + 4, sortedCommandCount );
+	EXPECT_LT( sortedCommandCount * 3, interleavedCommandCount );
+}
+
+TEST_F( BasePassDrawTest, MaterialChangeStartsNewRun )
+{
+	for( size_t instanceIndex = 0; instanceIndex < INSTANCES_PER_MESH; ++instanceIndex )
+	{
+		AddInstance( 0, instanceIndex % 2, instanceIndex );
+	}
+
+	Draw();
+
+	// The mesh never changes, but its draw state is set again whenever the material does.
+	EXPECT_EQ( INSTANCES_PER_MESH, m_spCommandProxy->pixelShaderCount );
+	EXPECT_EQ( INSTANCES_PER_MESH, m_spCommandProxy->vertexBufferCount );
+	EXPECT_EQ( INSTANCES_PER_MESH, m_spCommandProxy->pixelConstantBufferCount );
+	EXPECT_EQ( INSTANCES_PER_MESH, m_spCommandProxy->drawCount );
+}
@@ -0,0 +1,726 @@
+#include "Precompile.h"
+#include "Graphics/SceneObjectBvh.h"
+
+#include "MathSimd/Frustum.h"
+#include "MathSimd/Vector3.h"
+
+using namespace Helium;
+
+/// Fraction of an object's size by which its bounds are enlarged along each axis when stored in a leaf node.
+static const float32_t SCENE_OBJECT_BVH_FAT_BOX_SCALE = 0.1f;
+/// Fixed amount by which an object's bounds are enlarged along each axis when stored in a leaf node.
+static const float32_t SCENE_OBJECT_BVH_FAT_BOX_MARGIN = 0.1f;
+
+/// Maximum tree traversal stack depth (a balanced tree needs far fewer entries than this for any realistic object
+/// count).
+static const size_t SCENE_OBJECT_BVH_STACK_SIZE = 64;
+
+/// Compute the smallest box enclosing two given boxes.
+///
+/// @param[in] rBox0  First box.
+/// @param[in] rBox1  Second box.
+///
+/// @return  Combined box.
+static Simd::AaBox CombineBoxes( const Simd::AaBox& rBox0, const Simd::AaBox& rBox1 )
+{
+	const Simd::Vector3& rMinimum0 = rBox0.GetMinimum();
+	const Simd::Vector3& rMaximum0 = rBox0.GetMaximum();
+	const Simd::Vector3& rMinimum1 = rBox1.GetMinimum();
+	const Simd::Vector3& rMaximum1 = rBox1.GetMaximum();
+
+	return Simd::AaBox(
+		Simd::Vector3(
+			Min( rMinimum0.GetElement( 0 ), rMinimum1.GetElement( 0 ) ),
+			Min( rMinimum0.GetElement( 1 ), rMinimum1.GetElement( 1 ) ),
+			Min( rMinimum0.GetElement( 2 ), rMinimum1.GetElement( 2 ) ) ),
+		Simd::Vector3(
+			Max( rMaximum0.GetElement( 0 ), rMaximum1.GetElement( 0 ) ),
+			Max( rMaximum0.GetElement( 1 ), rMaximum1.GetElement( 1 ) ),
+			Max( rMaximum0.GetElement( 2 ), rMaximum1.GetElement( 2 ) ) ) );
+}
+
+/// Compute the enlarged bounds stored in a leaf node for a given object box.
+///
+/// @param[in] rBox  Object bounds.
+///
+/// @return  Enlarged bounds.
+static Simd::AaBox ComputeFatBox( const Simd::AaBox& rBox )
+{
+	Simd::Vector3 margin = rBox.GetMaximum().Subtract( rBox.GetMinimum() );
+	margin.Scale( SCENE_OBJECT_BVH_FAT_BOX_SCALE );
+	margin = margin.Add( Simd::Vector3( SCENE_OBJECT_BVH_FAT_BOX_MARGIN ) );
+
+	return Simd::AaBox( rBox.GetMinimum().Subtract( margin ), rBox.GetMaximum().Add( margin ) );
+}
+
+/// Compute half the surface area of a box (used as the cost metric when choosing where to insert leaves).
+///
+/// @param[in] rBox  Box.
+///
+/// @return  Half of the box surface area.
+static float32_t GetHalfSurfaceArea( const Simd::AaBox& rBox )
+{
+	Simd::Vector3 extent = rBox.GetMaximum().Subtract( rBox.GetMinimum() );
+	float32_t extentX = extent.GetElement( 0 );
+	float32_t extentY = extent.GetElement( 1 );
+	float32_t extentZ = extent.GetElement( 2 );
+
+	return extentX * extentY + extentY * extentZ + extentZ * extentX;
+}
+
+/// Test whether a box fully contains another box.
+///
+/// @param[in] rOuterBox  Containing box.
+/// @param[in] rInnerBox  Contained box.
+///
+/// @return  True if the outer box contains the inner box, false if not.
+static bool BoxContains( const Simd::AaBox& rOuterBox, const Simd::AaBox& rInnerBox )
+{
+	const Simd::Vector3& rOuterMinimum = rOuterBox.GetMinimum();
+	const Simd::Vector3& rOuterMaximum = rOuterBox.GetMaximum();
+	const Simd::Vector3& rInnerMinimum = rInnerBox.GetMinimum();
+	const Simd::Vector3& rInnerMaximum = rInnerBox.GetMaximum();
+
+	for( size_t axis = 0; axis < 3; ++axis )
+	{
+		if( rInnerMinimum.GetElement( axis ) < rOuterMinimum.GetElement( axis ) ||
+			rInnerMaximum.GetElement( axis ) > rOuterMaximum.GetElement( axis ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// Test whether two boxes overlap.
+///
+/// @param[in] rBox0  First box.
+/// @param[in] rBox1  Second box.
+///
+/// @return  True if the boxes overlap, false if not.
+static bool BoxesOverlap( const Simd::AaBox& rBox0, const Simd::AaBox& rBox1 )
+{
+	const Simd::Vector3& rMinimum0 = rBox0.GetMinimum();
+	const Simd::Vector3& rMaximum0 = rBox0.GetMaximum();
+	const Simd::Vector3& rMinimum1 = rBox1.GetMinimum();
+	const Simd::Vector3& rMaximum1 = rBox1.GetMaximum();
+
+	for( size_t axis = 0; axis < 3; ++axis )
+	{
+		if( rMinimum0.GetElement( axis ) > rMaximum1.GetElement( axis ) ||
+			rMinimum1.GetElement( axis ) > rMaximum0.GetElement( axis ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// Test whether a ray segment intersects a box.
+///
+/// @param[in] pOrigin             Ray origin coordinates.
+/// @param[in] pInverseDirection   Reciprocal of each ray direction component (ignored for parallel axes).
+/// @param[in] pParallel           True for each axis to which the ray is parallel.
+/// @param[in] maxDistance         Length of the ray segment, in multiples of the ray direction.
+/// @param[in] rBox                Box to test.
+///
+/// @return  True if the ray segment intersects the box, false if not.
+static bool RayIntersectsBox(
+	const float32_t* pOrigin,
+	const float32_t* pInverseDirection,
+	const bool* pParallel,
+	float32_t maxDistance,
+	const Simd::AaBox& rBox )
+{
+	const Simd::Vector3& rMinimum = rBox.GetMinimum();
+	const Simd::Vector3& rMaximum = rBox.GetMaximum();
+
+	float32_t nearDistance = 0.0f;
+	float32_t farDistance = maxDistance;
+	for( size_t axis = 0; axis < 3; ++axis )
+	{
+		float32_t boxMinimum = rMinimum.GetElement( axis );
+		float32_t boxMaximum = rMaximum.GetElement( axis );
+
+		if( pParallel[ axis ] )
+		{
+			if( pOrigin[ axis ] < boxMinimum || pOrigin[ axis ] > boxMaximum )
+			{
+				return false;
+			}
+
+			continue;
+		}
+
+		float32_t distance0 = ( boxMinimum - pOrigin[ axis ] ) * pInverseDirection[ axis ];
+		float32_t distance1 = ( boxMaximum - pOrigin[ axis ] ) * pInverseDirection[ axis ];
+		if( distance0 > distance1 )
+		{
+			float32_t distance = distance0;
+			distance0 = distance1;
+			distance1 = distance;
+		}
+
+		nearDistance = Max( nearDistance, distance0 );
+		farDistance = Min( farDistance, distance1 );
+		if( nearDistance > farDistance )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// Constructor.
+SceneObjectBvh::SceneObjectBvh()
+: m_rootNode( Invalid< uint32_t >() )
+, m_freeNode( Invalid< uint32_t >() )
+, m_objectCount( 0 )
+{
+}
+
+/// Destructor.
+SceneObjectBvh::~SceneObjectBvh()
+{
+}
+
+/// Add a scene object to this tree.
+///
+/// @param[in] objectId  Scene object ID.  The object must not already be in this tree.
+/// @param[in] rBox      World-space object bounds.
+///
+/// @see Update(), Remove(), Contains()
+void SceneObjectBvh::Insert( size_t objectId, const Simd::AaBox& rBox )
+{
+	HELIUM_ASSERT( IsValid( objectId ) );
+	HELIUM_ASSERT( !Contains( objectId ) );
+
+	if( objectId >= m_objectLeaves.GetSize() )
+	{
+		m_objectLeaves.Reserve( objectId + 1 );
+		while( m_objectLeaves.GetSize() <= objectId )
+		{
+			m_objectLeaves.Push( Invalid< uint32_t >() );
+		}
+	}
+
+	uint32_t leafIndex = AllocateNode();
+	Node& rLeaf = m_nodes[ leafIndex ];
+	rLeaf.box = ComputeFatBox( rBox );
+	rLeaf.objectBox = rBox;
+	rLeaf.objectId = objectId;
+
+	InsertLeaf( leafIndex );
+
+	m_objectLeaves[ objectId ] = leafIndex;
+	++m_objectCount;
+}
+
+/// Update the bounds of a scene object in this tree.
+///
+/// This is cheap for objects that have moved only a short distance: the tree is left untouched if the new bounds
+/// still fit within the object's enlarged leaf bounds, and only the leaf bounds are refit if they still fit within its
+/// parent node.  Objects are removed and reinserted otherwise.
+///
+/// @param[in] objectId  Scene object ID.  The object must already be in this tree.
+/// @param[in] rBox      Updated world-space object bounds.
+///
+/// @see Insert(), Remove()
+void SceneObjectBvh::Update( size_t objectId, const Simd::AaBox& rBox )
+{
+	HELIUM_ASSERT( Contains( objectId ) );
+
+	uint32_t leafIndex = m_objectLeaves[ objectId ];
+	Node& rLeaf = m_nodes[ leafIndex ];
+	rLeaf.objectBox = rBox;
+	if( BoxContains( rLeaf.box, rBox ) )
+	{
+		return;
+	}
+
+	// Every ancestor box encloses its descendants, so a leaf box that still fits in its parent needs no further refit.
+	Simd::AaBox fatBox = ComputeFatBox( rBox );
+	uint32_t parentIndex = rLeaf.parent;
+	if( IsInvalid( parentIndex ) || BoxContains( m_nodes[ parentIndex ].box, fatBox ) )
+	{
+		rLeaf.box = fatBox;
+
+		return;
+	}
+
+	RemoveLeaf( leafIndex );
+	m_nodes[ leafIndex ].box = fatBox;
+	InsertLeaf( leafIndex );
+}
+
+/// Remove a scene object from this tree.
+///
+/// @param[in] objectId  Scene object ID.  The object must be in this tree.
+///
+/// @see Insert(), Contains()
+void SceneObjectBvh::Remove( size_t objectId )
+{
+	HELIUM_ASSERT( Contains( objectId ) );
+
+	uint32_t leafIndex = m_objectLeaves[ objectId ];
+	RemoveLeaf( leafIndex );
+	ReleaseNode( leafIndex );
+
+	SetInvalid( m_objectLeaves[ objectId ] );
+	HELIUM_ASSERT( m_objectCount != 0 );
+	--m_objectCount;
+}
+
+/// Remove all objects from this tree.
+void SceneObjectBvh::Clear()
+{
+	m_nodes.Clear();
+	m_objectLeaves.Clear();
+	SetInvalid( m_rootNode );
+	SetInvalid( m_freeNode );
+	m_objectCount = 0;
+}
+
+/// Find all scene objects whose bounds intersect a view frustum.
+///
+/// Subtrees whose bounds are found to lie fully in front of a clip plane are not tested against that plane again,
+/// and subtrees fully inside the frustum are accepted without any further tests.
+///
+/// Objects whose leaves still straddle one or more clip planes can optionally be returned instead of being tested
+/// here, so that the caller can test them in batches (i.e. using Simd::Frustum::IntersectsSoa()).
+///
+/// @param[in]     rFrustum           Frustum to test.
+/// @param[in,out] rObjectBits        Bit array in which to set the bit for each intersecting scene object ID.  This
+///                                   must be large enough to hold all object IDs in this tree.  Bits for objects that
+///                                   do not intersect the frustum are left unchanged.
+/// @param[out]    pPartialObjectIds  If not null, the IDs of objects that may intersect the frustum but have not been
+///                                   tested individually are appended to this array, and their bits are left unset.
+void SceneObjectBvh::QueryFrustum(
+	const Simd::Frustum& rFrustum,
+	BitArray<>& rObjectBits,
+	DynamicArray< size_t >* pPartialObjectIds ) const
+{
+	if( IsInvalid( m_rootNode ) )
+	{
+		return;
+	}
+
+	uint32_t nodeStack[ SCENE_OBJECT_BVH_STACK_SIZE ];
+	uint32_t planeMaskStack[ SCENE_OBJECT_BVH_STACK_SIZE ];
+	nodeStack[ 0 ] = m_rootNode;
+	planeMaskStack[ 0 ] = ( 1U << Simd::Frustum::PLANE_MAX ) - 1;
+	size_t stackSize = 1;
+
+	while( stackSize != 0 )
+	{
+		--stackSize;
+		const Node& rNode = m_nodes[ nodeStack[ stackSize ] ];
+		uint32_t planeMask = planeMaskStack[ stackSize ];
+
+		bool bLeaf = ( rNode.height == 0 );
+		if( bLeaf && planeMask != 0 && pPartialObjectIds )
+		{
+			pPartialObjectIds->Push( rNode.objectId );
+
+			continue;
+		}
+
+		if( planeMask != 0 && !rFrustum.Intersects( bLeaf ? rNode.objectBox : rNode.box, planeMask ) )
+		{
+			continue;
+		}
+
+		if( bLeaf )
+		{
+			HELIUM_ASSERT( rNode.objectId < rObjectBits.GetSize() );
+			rObjectBits.SetElement( rNode.objectId );
+
+			continue;
+		}
+
+		HELIUM_ASSERT( stackSize + 2 <= SCENE_OBJECT_BVH_STACK_SIZE );
+		nodeStack[ stackSize ] = rNode.children[ 0 ];
+		planeMaskStack[ stackSize ] = planeMask;
+		nodeStack[ stackSize + 1 ] = rNode.children[ 1 ];
+		planeMaskStack[ stackSize + 1 ] = planeMask;
+		stackSize += 2;
+	}
+}
+
+/// Find all scene objects whose bounds overlap a box.
+///
+/// @param[in]  rBox        World-space box to test.
+/// @param[out] rObjectIds  IDs of all objects whose bounds overlap the box are appended to this array.
+void SceneObjectBvh::QueryBox( const Simd::AaBox& rBox, DynamicArray< size_t >& rObjectIds ) const
+{
+	if( IsInvalid( m_rootNode ) )
+	{
+		return;
+	}
+
+	uint32_t nodeStack[ SCENE_OBJECT_BVH_STACK_SIZE ];
+	nodeStack[ 0 ] = m_rootNode;
+	size_t stackSize = 1;
+
+	while( stackSize != 0 )
+	{
+		--stackSize;
+		const Node& rNode = m_nodes[ nodeStack[ stackSize ] ];
+		if( rNode.height == 0 )
+		{
+			if( BoxesOverlap( rNode.objectBox, rBox ) )
+			{
+				rObjectIds.Push( rNode.objectId );
+			}
+
+			continue;
+		}
+
+		if( BoxesOverlap( rNode.box, rBox ) )
+		{
+			HELIUM_ASSERT( stackSize + 2 <= SCENE_OBJECT_BVH_STACK_SIZE );
+			nodeStack[ stackSize ] = rNode.children[ 0 ];
+			nodeStack[ stackSize + 1 ] = rNode.children[ 1 ];
+			stackSize += 2;
+		}
+	}
+}
+
+/// Find all scene objects whose bounds are hit by a ray segment.
+///
+/// Objects are not returned in any particular order.  Callers that need the closest hit should test the returned
+/// objects against their actual geometry.
+///
+/// @param[in]  rOrigin      World-space ray origin.
+/// @param[in]  rDirection   World-space ray direction.
+/// @param[in]  maxDistance  Length of the ray segment, in multiples of the length of the ray direction.
+/// @param[out] rObjectIds   IDs of all objects whose bounds are hit by the ray segment are appended to this array.
+void SceneObjectBvh::QueryRay(
+	const Simd::Vector3& rOrigin,
+	const Simd::Vector3& rDirection,
+	float32_t maxDistance,
+	DynamicArray< size_t >& rObjectIds ) const
+{
+	if( IsInvalid( m_rootNode ) )
+	{
+		return;
+	}
+
+	float32_t origin[ 3 ];
+	float32_t inverseDirection[ 3 ];
+	bool parallel[ 3 ];
+	for( size_t axis = 0; axis < 3; ++axis )
+	{
+		float32_t direction = rDirection.GetElement( axis );
+		origin[ axis ] = rOrigin.GetElement( axis );
+		parallel[ axis ] = ( Abs( direction ) < HELIUM_EPSILON );
+		inverseDirection[ axis ] = ( parallel[ axis ] ? 0.0f : 1.0f / direction );
+	}
+
+	uint32_t nodeStack[ SCENE_OBJECT_BVH_STACK_SIZE ];
+	nodeStack[ 0 ] = m_rootNode;
+	size_t stackSize = 1;
+
+	while( stackSize != 0 )
+	{
+		--stackSize;
+		const Node& rNode = m_nodes[ nodeStack[ stackSize ] ];
+		if( rNode.height == 0 )
+		{
+			if( RayIntersectsBox( origin, inverseDirection, parallel, maxDistance, rNode.objectBox ) )
+			{
+				rObjectIds.Push( rNode.objectId );
+			}
+
+			continue;
+		}
+
+		if( RayIntersectsBox( origin, inverseDirection, parallel, maxDistance, rNode.box ) )
+		{
+			HELIUM_ASSERT( stackSize + 2 <= SCENE_OBJECT_BVH_STACK_SIZE );
+			nodeStack[ stackSize ] = rNode.children[ 0 ];
+			nodeStack[ stackSize + 1 ] = rNode.children[ 1 ];
+			stackSize += 2;
+		}
+	}
+}
+
+/// Allocate a tree node, reusing a previously released node if possible.
+///
+/// Note that this may reallocate the node array, invalidating any existing node references.
+///
+/// @return  Index of the allocated node.
+///
+/// @see ReleaseNode()
+uint32_t SceneObjectBvh::AllocateNode()
+{
+	uint32_t nodeIndex = m_freeNode;
+	if( IsValid( nodeIndex ) )
+	{
+		m_freeNode = m_nodes[ nodeIndex ].parent;
+	}
+	else
+	{
+		nodeIndex = static_cast< uint32_t >( m_nodes.GetSize() );
+		HELIUM_VERIFY( m_nodes.New() );
+	}
+
+	Node& rNode = m_nodes[ nodeIndex ];
+	SetInvalid( rNode.objectId );
+	SetInvalid( rNode.parent );
+	SetInvalid( rNode.children[ 0 ] );
+	SetInvalid( rNode.children[ 1 ] );
+	rNode.height = 0;
+
+	return nodeIndex;
+}
+
+/// Return a tree node to the free list.
+///
+/// @param[in] nodeIndex  Index of the node to release.
+///
+/// @see AllocateNode()
+void SceneObjectBvh::ReleaseNode( uint32_t nodeIndex )
+{
+	HELIUM_ASSERT( nodeIndex < m_nodes.GetSize() );
+
+	Node& rNode = m_nodes[ nodeIndex ];
+	rNode.parent = m_freeNode;
+	rNode.height = -1;
+
+	m_freeNode = nodeIndex;
+}
+
+/// Link a leaf node into the tree.
+///
+/// @param[in] leafIndex  Index of the leaf node to insert.  Its bounds must already be set.
+///
+/// @see RemoveLeaf()
+void SceneObjectBvh::InsertLeaf( uint32_t leafIndex )
+{
+	if( IsInvalid( m_rootNode ) )
+	{
+		m_rootNode = leafIndex;
+		SetInvalid( m_nodes[ leafIndex ].parent );
+
+		return;
+	}
+
+	// Descend towards the sibling that would least increase the total surface area of the tree, stopping once pairing
+	// the leaf with the current node is cheaper than pushing it further down.
+	Simd::AaBox leafBox = m_nodes[ leafIndex ].box;
+
+	uint32_t siblingIndex = m_rootNode;
+	while( m_nodes[ siblingIndex ].height > 0 )
+	{
+		const Node& rNode = m_nodes[ siblingIndex ];
+
+		float32_t area = GetHalfSurfaceArea( rNode.box );
+		float32_t combinedArea = GetHalfSurfaceArea( CombineBoxes( rNode.box, leafBox ) );
+
+		// Cost of creating a new parent for this node and the leaf, and the minimum cost of descending any further
+		// (each ancestor below this point would grow to include the leaf).
+		float32_t cost = 2.0f * combinedArea;
+		float32_t inheritanceCost = 2.0f * ( combinedArea - area );
+
+		float32_t childCosts[ 2 ];
+		for( size_t childSlot = 0; childSlot < 2; ++childSlot )
+		{
+			const Node& rChild = m_nodes[ rNode.children[ childSlot ] ];
+
+			float32_t childCost = GetHalfSurfaceArea( CombineBoxes( rChild.box, leafBox ) );
+			if( rChild.height > 0 )
+			{
+				childCost -= GetHalfSurfaceArea( rChild.box );
+			}
+
+			childCosts[ childSlot ] = childCost + inheritanceCost;
+		}
+
+		if( cost < childCosts[ 0 ] && cost < childCosts[ 1 ] )
+		{
+			break;
+		}
+
+		siblingIndex = rNode.children[ childCosts[ 0 ] < childCosts[ 1 ] ? 0 : 1 ];
+	}
+
+	// Create a new parent for the sibling and the leaf.
+	uint32_t oldParentIndex = m_nodes[ siblingIndex ].parent;
+	uint32_t newParentIndex = AllocateNode();
+
+	Node& rNewParent = m_nodes[ newParentIndex ];
+	Node& rSibling = m_nodes[ siblingIndex ];
+	rNewParent.box = CombineBoxes( rSibling.box, leafBox );
+	rNewParent.parent = oldParentIndex;
+	rNewParent.children[ 0 ] = siblingIndex;
+	rNewParent.children[ 1 ] = leafIndex;
+	rNewParent.height = rSibling.height + 1;
+
+	rSibling.parent = newParentIndex;
+	m_nodes[ leafIndex ].parent = newParentIndex;
+
+	if( IsValid( oldParentIndex ) )
+	{
+		Node& rOldParent = m_nodes[ oldParentIndex ];
+		rOldParent.children[ rOldParent.children[ 0 ] == siblingIndex ? 0 : 1 ] = newParentIndex;
+	}
+	else
+	{
+		m_rootNode = newParentIndex;
+	}
+
+	RefitAncestors( newParentIndex );
+}
+
+/// Unlink a leaf node from the tree.
+///
+/// The leaf node itself is not released.
+///
+/// @param[in] leafIndex  Index of the leaf node to remove.
+///
+/// @see InsertLeaf()
+void SceneObjectBvh::RemoveLeaf( uint32_t leafIndex )
+{
+	if( leafIndex == m_rootNode )
+	{
+		SetInvalid( m_rootNode );
+
+		return;
+	}
+
+	// Replace the leaf's parent with its sibling.
+	uint32_t parentIndex = m_nodes[ leafIndex ].parent;
+	const Node& rParent = m_nodes[ parentIndex ];
+	uint32_t grandParentIndex = rParent.parent;
+	uint32_t siblingIndex = rParent.children[ rParent.children[ 0 ] == leafIndex ? 1 : 0 ];
+
+	m_nodes[ siblingIndex ].parent = grandParentIndex;
+	if( IsValid( grandParentIndex ) )
+	{
+		Node& rGrandParent = m_nodes[ grandParentIndex ];
+		rGrandParent.children[ rGrandParent.children[ 0 ] == parentIndex ? 0 : 1 ] = siblingIndex;
+	}
+	else
+	{
+		m_rootNode = siblingIndex;
+	}
+
+	ReleaseNode( parentIndex );
+	SetInvalid( m_nodes[ leafIndex ].parent );
+
+	RefitAncestors( grandParentIndex );
+}
+
+/// Rebalance and recompute the bounds and height of a node and each of its ancestors.
+///
+/// @param[in] nodeIndex  Index of the first node to update (may be invalid, in which case nothing is done).
+void SceneObjectBvh::RefitAncestors( uint32_t nodeIndex )
+{
+	while( IsValid( nodeIndex ) )
+	{
+		nodeIndex = Balance( nodeIndex );
+
+		Node& rNode = m_nodes[ nodeIndex ];
+		const Node& rChild0 = m_nodes[ rNode.children[ 0 ] ];
+		const Node& rChild1 = m_nodes[ rNode.children[ 1 ] ];
+		rNode.box = CombineBoxes( rChild0.box, rChild1.box );
+		rNode.height = 1 + Max( rChild0.height, rChild1.height );
+
+		nodeIndex = rNode.parent;
+	}
+}
+
+/// Rotate the taller child of a node into its place if its children differ in height by more than one level.
+///
+/// @param[in] nodeIndex  Index of the node to balance.
+///
+/// @return  Index of the node now occupying the given node's place in the tree.
+///
+/// @see Rotate()
+uint32_t SceneObjectBvh::Balance( uint32_t nodeIndex )
+{
+	const Node& rNode = m_nodes[ nodeIndex ];
+	if( rNode.height < 2 )
+	{
+		return nodeIndex;
+	}
+
+	int32_t balance = m_nodes[ rNode.children[ 1 ] ].height - m_nodes[ rNode.children[ 0 ] ].height;
+	if( balance > 1 )
+	{
+		return Rotate( nodeIndex, 1 );
+	}
+
+	if( balance < -1 )
+	{
+		return Rotate( nodeIndex, 0 );
+	}
+
+	return nodeIndex;
+}
+
+/// Rotate a child node into the place of its parent.
+///
+/// The child becomes the parent of the given node, keeping its own taller child and handing its shorter child over
+/// to the given node.
+///
+/// @param[in] nodeIndex  Index of the node to rotate down.
+/// @param[in] childSlot  Slot (0 or 1) of the child to rotate up.  The child must not be a leaf node.
+///
+/// @return  Index of the rotated child, which now occupies the given node's place in the tree.
+///
+/// @see Balance()
+uint32_t SceneObjectBvh::Rotate( uint32_t nodeIndex, size_t childSlot )
+{
+	HELIUM_ASSERT( childSlot < 2 );
+
+	Node& rNode = m_nodes[ nodeIndex ];
+	uint32_t pivotIndex = rNode.children[ childSlot ];
+	uint32_t otherIndex = rNode.children[ 1 - childSlot ];
+
+	Node& rPivot = m_nodes[ pivotIndex ];
+	HELIUM_ASSERT( rPivot.height > 0 );
+
+	uint32_t tallIndex = rPivot.children[ 0 ];
+	uint32_t shortIndex = rPivot.children[ 1 ];
+	if( m_nodes[ tallIndex ].height < m_nodes[ shortIndex ].height )
+	{
+		tallIndex = rPivot.children[ 1 ];
+		shortIndex = rPivot.children[ 0 ];
+	}
+
+	// Move the pivot into the node's place.
+	uint32_t parentIndex = rNode.parent;
+	rPivot.parent = parentIndex;
+	if( IsValid( parentIndex ) )
+	{
+		Node& rParent = m_nodes[ parentIndex ];
+		rParent.children[ rParent.children[ 0 ] == nodeIndex ? 0 : 1 ] = pivotIndex;
+	}
+	else
+	{
+		m_rootNode = pivotIndex;
+	}
+
+	// Make the node a child of the pivot, handing it the pivot's shorter child.
+	rNode.parent = pivotIndex;
+	rNode.children[ childSlot ] = shortIndex;
+	m_nodes[ shortIndex ].parent = nodeIndex;
+
+	rPivot.children[ 0 ] = nodeIndex;
+	rPivot.children[ 1 ] = tallIndex;
+
+	const Node& rOther = m_nodes[ otherIndex ];
+	const Node& rShort = m_nodes[ shortIndex ];
+	const Node& rTall = m_nodes[ tallIndex ];
+	rNode.box = CombineBoxes( rOther.box, rShort.box );
+	rNode.height = 1 + Max( rOther.height, rShort.height );
+	rPivot.box = CombineBoxes( rNode.box, rTall.box );
+	rPivot.height = 1 + Max( rNode.height, rTall.height );
+
+	return pivotIndex;
+}
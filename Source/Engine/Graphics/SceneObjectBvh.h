@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Graphics/Graphics.h"
+
+#include "Foundation/BitArray.h"
+#include "Foundation/DynamicArray.h"
+#include "MathSimd/AaBox.h"
+
+namespace Helium
+{
+	namespace Simd
+	{
+		class Frustum;
+		struct Vector3;
+	}
+
+	/// Dynamic bounding volume hierarchy of graphics scene objects.
+	///
+	/// Each scene object is stored in a leaf node holding both its exact world-space bounds and a slightly enlarged
+	/// ("fat") box.  Objects that move within their fat box do not alter the tree, and objects that move a short
+	/// distance beyond it only need their leaf box refit as long as it stays within the bounds of its parent node.
+	/// Objects are only reinserted when they move further than that.  Insertion picks the sibling that least increases
+	/// the total surface area of the tree, and nodes are rebalanced with tree rotations, so that queries remain
+	/// logarithmic as objects are added, moved, and removed.
+	class HELIUM_GRAPHICS_API SceneObjectBvh : NonCopyable
+	{
+	public:
+		/// @name Construction/Destruction
+		//@{
+		SceneObjectBvh();
+		~SceneObjectBvh();
+		//@}
+
+		/// @name Object Management
+		//@{
+		void Insert( size_t objectId, const Simd::AaBox& rBox );
+		void Update( size_t objectId, const Simd::AaBox& rBox );
+		void Remove( size_t objectId );
+		void Clear();
+
+		inline bool Contains( size_t objectId ) const;
+		inline size_t GetObjectCount() const;
+		inline uint32_t GetHeight() const;
+		//@}
+
+		/// @name Queries
+		//@{
+		void QueryFrustum(
+			const Simd::Frustum& rFrustum, BitArray<>& rObjectBits,
+			DynamicArray< size_t >* pPartialObjectIds = NULL ) const;
+		void QueryBox( const Simd::AaBox& rBox, DynamicArray< size_t >& rObjectIds ) const;
+		void QueryRay(
+			const Simd::Vector3& rOrigin, const Simd::Vector3& rDirection, float32_t maxDistance,
+			DynamicArray< size_t >& rObjectIds ) const;
+		//@}
+
+	private:
+		/// Tree node.
+		HELIUM_SIMD_ALIGN_PRE struct Node
+		{
+			/// Node bounds (enlarged object bounds for leaf nodes).
+			Simd::AaBox box;
+			/// Exact object bounds (leaf nodes only).
+			Simd::AaBox objectBox;
+			/// Scene object ID (leaf nodes only).
+			size_t objectId;
+			/// Parent node index (next free node index for unused nodes).
+			uint32_t parent;
+			/// Child node indices (leaf nodes have none).
+			uint32_t children[ 2 ];
+			/// Height of the subtree rooted at this node (zero for leaf nodes, negative for unused nodes).
+			int32_t height;
+		} HELIUM_SIMD_ALIGN_POST;
+
+		/// Tree nodes.
+		DynamicArray< Node > m_nodes;
+		/// Leaf node index for each scene object ID (invalid for objects not in the tree).
+		DynamicArray< uint32_t > m_objectLeaves;
+		/// Root node index.
+		uint32_t m_rootNode;
+		/// First unused node index.
+		uint32_t m_freeNode;
+		/// Number of objects in the tree.
+		size_t m_objectCount;
+
+		/// @name Private Utility Functions
+		//@{
+		uint32_t AllocateNode();
+		void ReleaseNode( uint32_t nodeIndex );
+
+		void InsertLeaf( uint32_t leafIndex );
+		void RemoveLeaf( uint32_t leafIndex );
+		void RefitAncestors( uint32_t nodeIndex );
+		uint32_t Balance( uint32_t nodeIndex );
+		uint32_t Rotate( uint32_t nodeIndex, size_t childSlot );
+		//@}
+	};
+}
+
+#include "Graphics/SceneObjectBvh.inl"
@@ -0,0 +1,30 @@
+namespace Helium
+{
+    /// Get whether a scene object has been added to this tree.
+    ///
+    /// @param[in] objectId  Scene object ID.
+    ///
+    /// @return  True if the object is in this tree, false if not.
+    ///
+    /// @see Insert(), Remove()
+    bool SceneObjectBvh::Contains( size_t objectId ) const
+    {
+        return ( objectId < m_objectLeaves.GetSize() && IsValid( m_objectLeaves[ objectId ] ) );
+    }
+
+    /// Get the number of scene objects in this tree.
+    ///
+    /// @return  Object count.
+    size_t SceneObjectBvh::GetObjectCount() const
+    {
+        return m_objectCount;
+    }
+
+    /// Get the height of this tree.
+    ///
+    /// @return  Number of levels below the root node (zero if the tree is empty or contains a single object).
+    uint32_t SceneObjectBvh::GetHeight() const
+    {
+        return ( IsValid( m_rootNode ) ? static_cast< uint32_t >( m_nodes[ m_rootNode ].height ) : 0 );
+    }
+}
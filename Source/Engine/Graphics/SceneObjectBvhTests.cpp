@@ -0,0 +1,408 @@
+#include "Graphics/SceneObjectBvh.h"
+
+#include "Platform/Timer.h"
+#include "MathSimd/Frustum.h"
+#include "MathSimd/Vector3.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+using namespace Helium;
+
+namespace
+{
+	/// Number of object IDs used by the randomized tests.
+	const size_t OBJECT_COUNT = 20000;
+	/// Number of random insert, remove, and update operations applied to the tree.
+	const size_t OPERATION_COUNT = 200000;
+	/// Number of each type of query checked against a brute force search.
+	const size_t QUERY_COUNT = 50;
+	/// Number of timed passes for the frustum query benchmark.
+	const uint32_t PASS_COUNT = 20;
+
+	/// Deterministic pseudo-random number generator so that each run tests the same sequence of operations.
+	class Random
+	{
+	public:
+		Random() : m_state( 0x9e3779b9 ) {}
+
+		uint32_t GetInt( uint32_t count )
+		{
+			Advance();
+
+			return ( m_state >> 8 ) % count;
+		}
+
+		float32_t GetFloat( float32_t minValue, float32_t maxValue )
+		{
+			Advance();
+
+			return minValue + ( maxValue - minValue ) * static_cast< float32_t >( m_state >> 8 ) / 16777216.0f;
+		}
+
+		Simd::Vector3 GetVector( float32_t minValue, float32_t maxValue )
+		{
+			float32_t x = GetFloat( minValue, maxValue );
+			float32_t y = GetFloat( minValue, maxValue );
+			float32_t z = GetFloat( minValue, maxValue );
+
+			return Simd::Vector3( x, y, z );
+		}
+
+	private:
+		uint32_t m_state;
+
+		void Advance()
+		{
+			m_state ^= m_state << 13;
+			m_state ^= m_state >> 17;
+			m_state ^= m_state << 5;
+		}
+	};
+
+	bool BoxesOverlap( const Simd::AaBox& rBox0, const Simd::AaBox& rBox1 )
+	{
+		for ( size_t axis = 0; axis < 3; ++axis )
+		{
+			if ( rBox0.GetMinimum().GetElement( axis ) > rBox1.GetMaximum().GetElement( axis ) ||
+				rBox1.GetMinimum().GetElement( axis ) > rBox0.GetMaximum().GetElement( axis ) )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/// Fixture holding a tree along with a flat copy of the bounds of each object for brute force checks.
+	class SceneObjectBvhTest : public testing::Test
+	{
+	protected:
+		SceneObjectBvh m_bvh;
+		DynamicArray< Simd::AaBox > m_boxes;
+		DynamicArray< bool > m_inTree;
+		Random m_random;
+		Simd::Frustum m_frustum;
+
+		void SetUp()
+		{
+			m_boxes.Resize( OBJECT_COUNT );
+			m_inTree.Resize( OBJECT_COUNT );
+			for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+			{
+				m_inTree[ objectId ] = false;
+			}
+
+			// Camera at the origin, so the view matrix is the identity and the frustum comes from the projection alone.
+			Simd::Matrix44 projection;
+			projection.SetPerspectiveProjection(
+				70.0f * static_cast< float32_t >( HELIUM_DEG_TO_RAD ), 16.0f / 9.0f, 1.0f, 800.0f );
+			m_frustum.Set( projection.GetTranspose() );
+		}
+
+		/// Create a small box somewhere in a cube around the origin.
+		Simd::AaBox CreateBox()
+		{
+			Simd::Vector3 minimum = m_random.GetVector( -1000.0f, 1000.0f );
+			Simd::Vector3 extent = m_random.GetVector( 0.0f, 5.0f );
+
+			return Simd::AaBox( minimum, minimum + extent );
+		}
+
+		void Insert( size_t objectId )
+		{
+			m_boxes[ objectId ] = CreateBox();
+			m_bvh.Insert( objectId, m_boxes[ objectId ] );
+			m_inTree[ objectId ] = true;
+		}
+
+		/// Apply a random mix of removals, short moves that usually stay within the fat box or its parent, and long
+		/// moves that force the object to be reinserted.
+		void ApplyRandomOperations( size_t operationCount )
+		{
+			for ( size_t operationIndex = 0; operationIndex < operationCount; ++operationIndex )
+			{
+				size_t objectId = m_random.GetInt( OBJECT_COUNT );
+				uint32_t operation = m_random.GetInt( 10 );
+
+				if ( !m_inTree[ objectId ] )
+				{
+					Insert( objectId );
+				}
+				else if ( operation == 0 )
+				{
+					m_bvh.Remove( objectId );
+					m_inTree[ objectId ] = false;
+				}
+				else if ( operation < 6 )
+				{
+					Simd::Vector3 offset = m_random.GetVector( -1.0f, 1.0f );
+					const Simd::AaBox& rBox = m_boxes[ objectId ];
+					m_boxes[ objectId ] = Simd::AaBox( rBox.GetMinimum() + offset, rBox.GetMaximum() + offset );
+					m_bvh.Update( objectId, m_boxes[ objectId ] );
+				}
+				else
+				{
+					m_boxes[ objectId ] = CreateBox();
+					m_bvh.Update( objectId, m_boxes[ objectId ] );
+				}
+			}
+		}
+
+		size_t GetInTreeCount() const
+		{
+			size_t count = 0;
+			for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+			{
+				count += ( m_inTree[ objectId ] ? 1 : 0 );
+			}
+
+			return count;
+		}
+
+		/// Check that a query returned each matching object exactly once.
+		void CompareIds( DynamicArray< size_t >& rActual, const DynamicArray< size_t >& rExpected, const char* pQueryName )
+		{
+			std::sort( rActual.GetData(), rActual.GetData() + rActual.GetSize() );
+
+			EXPECT_EQ( rExpected.GetSize(), rActual.GetSize() ) << pQueryName;
+			if ( rExpected.GetSize() == rActual.GetSize() )
+			{
+				for ( size_t index = 0; index < rExpected.GetSize(); ++index )
+				{
+					EXPECT_EQ( rExpected[ index ], rActual[ index ] ) << pQueryName;
+				}
+			}
+		}
+
+		void CheckBoxQuery( const Simd::AaBox& rQueryBox )
+		{
+			DynamicArray< size_t > expected;
+			for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+			{
+				if ( m_inTree[ objectId ] && BoxesOverlap( m_boxes[ objectId ], rQueryBox ) )
+				{
+					expected.Push( objectId );
+				}
+			}
+
+			DynamicArray< size_t > actual;
+			m_bvh.QueryBox( rQueryBox, actual );
+			CompareIds( actual, expected, "QueryBox" );
+		}
+
+		/// Check a ray fired along the z axis from in front of the cube, which only hits boxes around its x and y
+		/// coordinates and only reaches as far as the given z coordinate.
+		void CheckRayQuery( float32_t x, float32_t y, float32_t endZ )
+		{
+			const float32_t startZ = -1100.0f;
+
+			DynamicArray< size_t > expected;
+			for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+			{
+				const Simd::AaBox& rBox = m_boxes[ objectId ];
+				if ( m_inTree[ objectId ] &&
+					rBox.GetMinimum().GetElement( 0 ) <= x && rBox.GetMaximum().GetElement( 0 ) >= x &&
+					rBox.GetMinimum().GetElement( 1 ) <= y && rBox.GetMaximum().GetElement( 1 ) >= y &&
+					rBox.GetMinimum().GetElement( 2 ) <= endZ )
+				{
+					expected.Push( objectId );
+				}
+			}
+
+			DynamicArray< size_t > actual;
+			m_bvh.QueryRay( Simd::Vector3( x, y, startZ ), Simd::Vector3( 0.0f, 0.0f, 1.0f ), endZ - startZ, actual );
+			CompareIds( actual, expected, "QueryRay" );
+		}
+
+		/// Check both frustum query modes against testing each object's bounds on its own.
+		///
+		/// @return  Number of visible objects.
+		size_t CheckFrustumQuery()
+		{
+			BitArray<> visibleBits;
+			visibleBits.Resize( OBJECT_COUNT );
+			visibleBits.UnsetAll();
+			m_bvh.QueryFrustum( m_frustum, visibleBits );
+
+			BitArray<> insideBits;
+			insideBits.Resize( OBJECT_COUNT );
+			insideBits.UnsetAll();
+			DynamicArray< size_t > partialIds;
+			m_bvh.QueryFrustum( m_frustum, insideBits, &partialIds );
+
+			DynamicArray< bool > isPartial;
+			isPartial.Resize( OBJECT_COUNT );
+			for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+			{
+				isPartial[ objectId ] = false;
+			}
+
+			for ( size_t index = 0; index < partialIds.GetSize(); ++index )
+			{
+				size_t objectId = partialIds[ index ];
+				EXPECT_TRUE( m_inTree[ objectId ] );
+				EXPECT_FALSE( isPartial[ objectId ] ) << "object " << objectId << " returned twice";
+				isPartial[ objectId ] = true;
+			}
+
+			size_t mismatchCount = 0;
+			size_t visibleCount = 0;
+			for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+			{
+				bool bExpected = ( m_inTree[ objectId ] && m_frustum.Intersects( m_boxes[ objectId ] ) );
+				visibleCount += ( bExpected ? 1 : 0 );
+
+				bool bVisible = visibleBits[ objectId ];
+				mismatchCount += ( bVisible != bExpected ? 1 : 0 );
+
+				// Objects are either known to be fully inside the frustum or handed back for an exact test, never both.
+				bool bInside = insideBits[ objectId ];
+				bool bPartial = isPartial[ objectId ];
+				EXPECT_FALSE( bInside && bPartial );
+				mismatchCount += ( bInside && !bExpected ? 1 : 0 );
+				mismatchCount += ( bExpected && !bInside && !bPartial ? 1 : 0 );
+			}
+
+			EXPECT_EQ( 0u, mismatchCount );
+
+			return visibleCount;
+		}
+	};
+}
+
+TEST_F( SceneObjectBvhTest, MatchesBruteForceQueries )
+{
+	for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+	{
+		Insert( objectId );
+	}
+
+	EXPECT_EQ( OBJECT_COUNT, m_bvh.GetObjectCount() );
+
+	ApplyRandomOperations( OPERATION_COUNT );
+
+	size_t objectCount = GetInTreeCount();
+	EXPECT_EQ( objectCount, m_bvh.GetObjectCount() );
+	for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+	{
+		EXPECT_EQ( m_inTree[ objectId ], m_bvh.Contains( objectId ) );
+	}
+
+	// Rotations keep the tree close to balanced (a balanced tree of 20000 objects has a height of 15).
+	EXPECT_LE( m_bvh.GetHeight(), 30u );
+
+	for ( size_t queryIndex = 0; queryIndex < QUERY_COUNT; ++queryIndex )
+	{
+		Simd::Vector3 minimum = m_random.GetVector( -1000.0f, 1000.0f );
+		CheckBoxQuery( Simd::AaBox( minimum, minimum + m_random.GetVector( 0.0f, 200.0f ) ) );
+
+		float32_t x = m_random.GetFloat( -1000.0f, 1000.0f );
+		float32_t y = m_random.GetFloat( -1000.0f, 1000.0f );
+		CheckRayQuery( x, y, 1100.0f );
+		CheckRayQuery( x, y, m_random.GetFloat( -1000.0f, 1000.0f ) );
+	}
+
+	size_t visibleCount = CheckFrustumQuery();
+	EXPECT_LT( 0u, visibleCount );
+	EXPECT_GT( objectCount, visibleCount );
+}
+
+TEST_F( SceneObjectBvhTest, RemovesAllObjects )
+{
+	for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+	{
+		Insert( objectId );
+	}
+
+	for ( size_t objectId = 0; objectId < OBJECT_COUNT; objectId += 2 )
+	{
+		m_bvh.Remove( objectId );
+		m_inTree[ objectId ] = false;
+	}
+
+	EXPECT_EQ( OBJECT_COUNT / 2, m_bvh.GetObjectCount() );
+	CheckFrustumQuery();
+
+	for ( size_t objectId = 1; objectId < OBJECT_COUNT; objectId += 2 )
+	{
+		m_bvh.Remove( objectId );
+		m_inTree[ objectId ] = false;
+	}
+
+	EXPECT_EQ( 0u, m_bvh.GetObjectCount() );
+	EXPECT_EQ( 0u, m_bvh.GetHeight() );
+
+	DynamicArray< size_t > objectIds;
+	m_bvh.QueryBox( Simd::AaBox( Simd::Vector3( -2000.0f ), Simd::Vector3( 2000.0f ) ), objectIds );
+	EXPECT_EQ( 0u, objectIds.GetSize() );
+
+	// Released nodes are reused.
+	Insert( 0 );
+	EXPECT_EQ( 1u, m_bvh.GetObjectCount() );
+	EXPECT_TRUE( m_bvh.Contains( 0 ) );
+	CheckBoxQuery( m_boxes[ 0 ] );
+}
+
+TEST_F( SceneObjectBvhTest, BenchmarkFrustumQuery )
+{
+	for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+	{
+		Insert( objectId );
+	}
+
+	ApplyRandomOperations( OPERATION_COUNT );
+
+	BitArray<> visibleBits;
+	visibleBits.Resize( OBJECT_COUNT );
+	DynamicArray< size_t > partialIds;
+
+	uint64_t startTicks = Timer::GetTickCount();
+	size_t bruteForceVisibleCount = 0;
+	for ( uint32_t passIndex = 0; passIndex < PASS_COUNT; ++passIndex )
+	{
+		bruteForceVisibleCount = 0;
+		for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+		{
+			if ( m_inTree[ objectId ] && m_frustum.Intersects( m_boxes[ objectId ] ) )
+			{
+				++bruteForceVisibleCount;
+			}
+		}
+	}
+	uint64_t bruteForceTicks = Timer::GetTickCount() - startTicks;
+
+	startTicks = Timer::GetTickCount();
+	for ( uint32_t passIndex = 0; passIndex < PASS_COUNT; ++passIndex )
+	{
+		visibleBits.UnsetAll();
+		partialIds.Resize( 0 );
+		m_bvh.QueryFrustum( m_frustum, visibleBits, &partialIds );
+	}
+	uint64_t bvhTicks = Timer::GetTickCount() - startTicks;
+
+	size_t insideCount = 0;
+	for ( size_t objectId = 0; objectId < OBJECT_COUNT; ++objectId )
+	{
+		bool bInside = visibleBits[ objectId ];
+		insideCount += ( bInside ? 1 : 0 );
+	}
+
+	EXPECT_GE( bruteForceVisibleCount, insideCount );
+	EXPECT_LE( bruteForceVisibleCount, insideCount + partialIds.GetSize() );
+
+	float64_t bruteForceMilliseconds = Timer::TicksToMilliseconds( bruteForceTicks ) / PASS_COUNT;
+	float64_t bvhMilliseconds = Timer::TicksToMilliseconds( bvhTicks ) / PASS_COUNT;
+	printf(
+		"%u objects (%u visible, height %u): brute force %.3f ms, BVH %.3f ms (%u inside, %u straddling), %.2fx\n",
+		static_cast< uint32_t >( m_bvh.GetObjectCount() ),
+		static_cast< uint32_t >( bruteForceVisibleCount ),
+		m_bvh.GetHeight(),
+		bruteForceMilliseconds,
+		bvhMilliseconds,
+		static_cast< uint32_t >( insideCount ),
+		static_cast< uint32_t >( partialIds.GetSize() ),
+		bruteForceMilliseconds / bvhMilliseconds );
+}
@@ -0,0 +1,20 @@
+#include "Precompile.h"
+#include "GraphicsJobs/GraphicsJobsInterface.h"
+
+namespace Helium
+{
+    /// Test the bounds of a set of graphics scene objects against a view frustum.
+    void CullGraphicsSceneObjectsJob::Run()
+    {
+        const Simd::Frustum* pFrustum = m_parameters.pFrustum;
+        HELIUM_ASSERT( pFrustum );
+
+        pFrustum->IntersectsSoa(
+            m_parameters.pBoundsX,
+            m_parameters.pBoundsY,
+            m_parameters.pBoundsZ,
+            m_parameters.pBoundsRadius,
+            m_parameters.sceneObjectCount,
+            m_parameters.pVisibilityBits );
+    }
+}
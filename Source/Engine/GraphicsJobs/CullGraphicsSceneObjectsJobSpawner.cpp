@@ -0,0 +1,72 @@
+#include "Precompile.h"
+#include "GraphicsJobs/GraphicsJobsInterface.h"
+
+#include "EngineJobs/JobManager.h"
+
+/// Maximum number of child jobs to spawn at once.
+static const uint_fast32_t SCENE_OBJECT_CULL_CHILD_JOB_MAX = 64;
+/// Minimum number of graphics scene objects to test in each child job.
+static const uint_fast32_t SCENE_OBJECT_CULL_CHILD_JOB_OBJECT_COUNT_MIN = 4096;
+
+using namespace Helium;
+
+/// Spawn jobs to test the bounds of all graphics scene objects against a view frustum.
+///
+/// Small scenes are tested on the calling thread.  Larger scenes are split across the job manager's worker threads.
+void CullGraphicsSceneObjectsJobSpawner::Run()
+{
+    uint_fast32_t sceneObjectCount = m_parameters.sceneObjectCount;
+
+    // Each child job covers a whole number of 32-bit visibility bit array elements so that no two jobs ever write to
+    // the same element.
+    uint_fast32_t jobObjectCount =
+        ( sceneObjectCount + SCENE_OBJECT_CULL_CHILD_JOB_MAX - 1 ) / SCENE_OBJECT_CULL_CHILD_JOB_MAX;
+    jobObjectCount = ( jobObjectCount + 31 ) & ~static_cast< uint_fast32_t >( 31 );
+    if( jobObjectCount < SCENE_OBJECT_CULL_CHILD_JOB_OBJECT_COUNT_MIN )
+    {
+        jobObjectCount = SCENE_OBJECT_CULL_CHILD_JOB_OBJECT_COUNT_MIN;
+    }
+
+    JobManager* pJobManager = JobManager::GetInstance();
+    if( !pJobManager || sceneObjectCount <= jobObjectCount )
+    {
+        CullGraphicsSceneObjectsJob job;
+        CullGraphicsSceneObjectsJob::Parameters& rParameters = job.GetParameters();
+        rParameters.sceneObjectCount = static_cast< uint32_t >( sceneObjectCount );
+        rParameters.pFrustum = m_parameters.pFrustum;
+        rParameters.pBoundsX = m_parameters.pBoundsX;
+        rParameters.pBoundsY = m_parameters.pBoundsY;
+        rParameters.pBoundsZ = m_parameters.pBoundsZ;
+        rParameters.pBoundsRadius = m_parameters.pBoundsRadius;
+        rParameters.pVisibilityBits = m_parameters.pVisibilityBits;
+        job.Run();
+
+        return;
+    }
+
+    CullGraphicsSceneObjectsJob jobs[ SCENE_OBJECT_CULL_CHILD_JOB_MAX ];
+    JobCounter counter;
+
+    uint_fast32_t jobIndex = 0;
+    for( uint_fast32_t baseObjectIndex = 0; baseObjectIndex < sceneObjectCount; baseObjectIndex += jobObjectCount )
+    {
+        HELIUM_ASSERT( jobIndex < SCENE_OBJECT_CULL_CHILD_JOB_MAX );
+
+        uint_fast32_t remainingObjectCount = sceneObjectCount - baseObjectIndex;
+
+        CullGraphicsSceneObjectsJob& rJob = jobs[ jobIndex ];
+        CullGraphicsSceneObjectsJob::Parameters& rParameters = rJob.GetParameters();
+        rParameters.sceneObjectCount = static_cast< uint32_t >( Min( remainingObjectCount, jobObjectCount ) );
+        rParameters.pFrustum = m_parameters.pFrustum;
+        rParameters.pBoundsX = m_parameters.pBoundsX + baseObjectIndex;
+        rParameters.pBoundsY = m_parameters.pBoundsY + baseObjectIndex;
+        rParameters.pBoundsZ = m_parameters.pBoundsZ + baseObjectIndex;
+        rParameters.pBoundsRadius = m_parameters.pBoundsRadius + baseObjectIndex;
+        rParameters.pVisibilityBits = m_parameters.pVisibilityBits + baseObjectIndex / 32;
+
+        pJobManager->Spawn( CullGraphicsSceneObjectsJob::RunCallback, &rJob, counter );
+        ++jobIndex;
+    }
+
+    pJobManager->Wait( counter );
+}
@@ -0,0 +1,270 @@
+#include "GraphicsJobs/GraphicsJobsInterface.h"
+
+#include "Platform/MemoryHeap.h"
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+#include "MathSimd/Sphere.h"
+#include "EngineJobs/JobManager.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Number of bounding spheres in the benchmark scene.
+	const size_t SPHERE_COUNT = 100000;
+	/// Number of bounding spheres used to check the results of the job split at each edge of a 32-bit element.
+	const size_t SMALL_SPHERE_COUNT = 4096 * 3 + 17;
+	/// Number of timed passes over the benchmark scene for each culling path.
+	const uint32_t PASS_COUNT = 20;
+
+	/// Deterministic pseudo-random number generator so that each run tests the same scene.
+	class Random
+	{
+	public:
+		Random() : m_state( 0x9e3779b9 ) {}
+
+		float32_t GetFloat( float32_t minValue, float32_t maxValue )
+		{
+			m_state ^= m_state << 13;
+			m_state ^= m_state >> 17;
+			m_state ^= m_state << 5;
+
+			return minValue + ( maxValue - minValue ) * static_cast< float32_t >( m_state >> 8 ) / 16777216.0f;
+		}
+
+	private:
+		uint32_t m_state;
+	};
+
+	/// Fixture holding a set of random bounding spheres in struct-of-arrays form and a perspective view frustum.
+	class CullGraphicsSceneObjectsJobSpawnerTest : public testing::Test
+	{
+	protected:
+		size_t m_sphereCount;
+		size_t m_sphereCapacity;
+		float32_t* m_pBounds;
+		Simd::Frustum m_frustum;
+
+		CullGraphicsSceneObjectsJobSpawnerTest()
+			: m_sphereCount( 0 )
+			, m_sphereCapacity( 0 )
+			, m_pBounds( NULL )
+		{
+		}
+
+		void SetUp()
+		{
+			// Camera at the origin, so the view matrix is the identity and the frustum comes from the projection alone.
+			Simd::Matrix44 projection;
+			projection.SetPerspectiveProjection(
+				90.0f * static_cast< float32_t >( HELIUM_DEG_TO_RAD ), 16.0f / 9.0f, 1.0f, 2000.0f );
+			m_frustum.Set( projection.GetTranspose() );
+		}
+
+		void TearDown()
+		{
+			if ( JobManager::GetInstance() )
+			{
+				JobManager::Shutdown();
+			}
+
+			DefaultAllocator().Free( m_pBounds );
+		}
+
+		float32_t* GetBoundsX() const { return m_pBounds; }
+		float32_t* GetBoundsY() const { return m_pBounds + m_sphereCapacity; }
+		float32_t* GetBoundsZ() const { return m_pBounds + m_sphereCapacity * 2; }
+		float32_t* GetBoundsRadius() const { return m_pBounds + m_sphereCapacity * 3; }
+
+		/// Fill the SIMD-aligned bounds arrays with spheres scattered through a cube around the camera.
+		void CreateSpheres( size_t sphereCount )
+		{
+			// Pad each array to a multiple of the SIMD vector size so that each array starts on an aligned address.
+			m_sphereCount = sphereCount;
+			m_sphereCapacity = ( sphereCount + 3 ) & ~static_cast< size_t >( 3 );
+			m_pBounds = static_cast< float32_t* >(
+				DefaultAllocator().AllocateAligned( HELIUM_SIMD_ALIGNMENT, m_sphereCapacity * 4 * sizeof( float32_t ) ) );
+			HELIUM_ASSERT( m_pBounds );
+			memset( m_pBounds, 0, m_sphereCapacity * 4 * sizeof( float32_t ) );
+
+			float32_t* pBoundsX = GetBoundsX();
+			float32_t* pBoundsY = GetBoundsY();
+			float32_t* pBoundsZ = GetBoundsZ();
+			float32_t* pBoundsRadius = GetBoundsRadius();
+
+			Random random;
+			for ( size_t sphereIndex = 0; sphereIndex < sphereCount; ++sphereIndex )
+			{
+				pBoundsX[ sphereIndex ] = random.GetFloat( -1000.0f, 1000.0f );
+				pBoundsY[ sphereIndex ] = random.GetFloat( -1000.0f, 1000.0f );
+				pBoundsZ[ sphereIndex ] = random.GetFloat( -1000.0f, 1000.0f );
+				pBoundsRadius[ sphereIndex ] = random.GetFloat( 0.5f, 10.0f );
+			}
+		}
+
+		/// Test each sphere on its own, as culling did before the struct-of-arrays path.
+		void CullScalar( DynamicArray< uint32_t >& rVisibilityBits ) const
+		{
+			rVisibilityBits.Resize( ( m_sphereCount + 31 ) / 32 );
+			memset( rVisibilityBits.GetData(), 0, rVisibilityBits.GetSize() * sizeof( uint32_t ) );
+
+			const float32_t* pBoundsX = GetBoundsX();
+			const float32_t* pBoundsY = GetBoundsY();
+			const float32_t* pBoundsZ = GetBoundsZ();
+			const float32_t* pBoundsRadius = GetBoundsRadius();
+
+			uint32_t* pVisibilityBits = rVisibilityBits.GetData();
+			for ( size_t sphereIndex = 0; sphereIndex < m_sphereCount; ++sphereIndex )
+			{
+				Simd::Sphere sphere(
+					pBoundsX[ sphereIndex ], pBoundsY[ sphereIndex ], pBoundsZ[ sphereIndex ], pBoundsRadius[ sphereIndex ] );
+				if ( m_frustum.Intersects( sphere ) )
+				{
+					pVisibilityBits[ sphereIndex / 32 ] |= 1U << ( sphereIndex % 32 );
+				}
+			}
+		}
+
+		/// Test four spheres at a time on the calling thread.
+		void CullSoa( DynamicArray< uint32_t >& rVisibilityBits ) const
+		{
+			rVisibilityBits.Resize( ( m_sphereCount + 31 ) / 32 );
+
+			m_frustum.IntersectsSoa(
+				GetBoundsX(), GetBoundsY(), GetBoundsZ(), GetBoundsRadius(), m_sphereCount, rVisibilityBits.GetData() );
+		}
+
+		/// Test four spheres at a time, split across the job manager's worker threads if it is running.
+		void CullJobs( DynamicArray< uint32_t >& rVisibilityBits ) const
+		{
+			rVisibilityBits.Resize( ( m_sphereCount + 31 ) / 32 );
+
+			CullGraphicsSceneObjectsJobSpawner job;
+			CullGraphicsSceneObjectsJobSpawner::Parameters& rParameters = job.GetParameters();
+			rParameters.sceneObjectCount = static_cast< uint32_t >( m_sphereCount );
+			rParameters.pFrustum = &m_frustum;
+			rParameters.pBoundsX = GetBoundsX();
+			rParameters.pBoundsY = GetBoundsY();
+			rParameters.pBoundsZ = GetBoundsZ();
+			rParameters.pBoundsRadius = GetBoundsRadius();
+			rParameters.pVisibilityBits = rVisibilityBits.GetData();
+			job.Run();
+		}
+
+		/// Check that two visibility bit arrays match, and get the number of visible spheres.
+		size_t CompareVisibility( const DynamicArray< uint32_t >& rExpected, const DynamicArray< uint32_t >& rActual ) const
+		{
+			EXPECT_EQ( rExpected.GetSize(), rActual.GetSize() );
+			if ( rExpected.GetSize() != rActual.GetSize() )
+			{
+				return 0;
+			}
+
+			size_t mismatchCount = 0;
+			size_t visibleCount = 0;
+			for ( size_t sphereIndex = 0; sphereIndex < m_sphereCount; ++sphereIndex )
+			{
+				uint32_t bit = 1U << ( sphereIndex % 32 );
+				bool bExpected = ( rExpected[ sphereIndex / 32 ] & bit ) != 0;
+				bool bActual = ( rActual[ sphereIndex / 32 ] & bit ) != 0;
+				mismatchCount += ( bExpected != bActual ? 1 : 0 );
+				visibleCount += ( bActual ? 1 : 0 );
+			}
+
+			EXPECT_EQ( 0u, mismatchCount );
+
+			// Bits past the last sphere are always cleared.
+			if ( m_sphereCount % 32 != 0 )
+			{
+				EXPECT_EQ( 0u, rActual.GetLast() >> ( m_sphereCount % 32 ) );
+			}
+
+			return visibleCount;
+		}
+	};
+}
+
+TEST_F( CullGraphicsSceneObjectsJobSpawnerTest, MatchesScalarTests )
+{
+	CreateSpheres( SMALL_SPHERE_COUNT );
+
+	DynamicArray< uint32_t > scalarBits;
+	CullScalar( scalarBits );
+
+	DynamicArray< uint32_t > soaBits;
+	CullSoa( soaBits );
+	size_t visibleCount = CompareVisibility( scalarBits, soaBits );
+	EXPECT_LT( 0u, visibleCount );
+	EXPECT_GT( m_sphereCount, visibleCount );
+
+	// Split into one job per 4096 spheres, with a partial last job that does not end on a 32-bit element.
+	JobManager::Startup();
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	DynamicArray< uint32_t > jobBits;
+	CullJobs( jobBits );
+	CompareVisibility( scalarBits, jobBits );
+}
+
+TEST_F( CullGraphicsSceneObjectsJobSpawnerTest, BenchmarkCull )
+{
+	CreateSpheres( SPHERE_COUNT );
+
+	DynamicArray< uint32_t > scalarBits;
+	DynamicArray< uint32_t > soaBits;
+	DynamicArray< uint32_t > jobBits;
+
+	// Warm the caches so that each path measures culling rather than the first touch of the bounds arrays.
+	CullScalar( scalarBits );
+
+	uint64_t startTicks = Timer::GetTickCount();
+	for ( uint32_t passIndex = 0; passIndex < PASS_COUNT; ++passIndex )
+	{
+		CullScalar( scalarBits );
+	}
+	uint64_t scalarTicks = Timer::GetTickCount() - startTicks;
+
+	startTicks = Timer::GetTickCount();
+	for ( uint32_t passIndex = 0; passIndex < PASS_COUNT; ++passIndex )
+	{
+		CullSoa( soaBits );
+	}
+	uint64_t soaTicks = Timer::GetTickCount() - startTicks;
+
+	size_t visibleCount = CompareVisibility( scalarBits, soaBits );
+	EXPECT_LT( 0u, visibleCount );
+	EXPECT_GT( m_sphereCount, visibleCount );
+
+	JobManager::Startup();
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	CullJobs( jobBits );
+
+	startTicks = Timer::GetTickCount();
+	for ( uint32_t passIndex = 0; passIndex < PASS_COUNT; ++passIndex )
+	{
+		CullJobs( jobBits );
+	}
+	uint64_t jobTicks = Timer::GetTickCount() - startTicks;
+
+	CompareVisibility( scalarBits, jobBits );
+
+	float64_t scalarMilliseconds = Timer::TicksToMilliseconds( scalarTicks ) / PASS_COUNT;
+	float64_t soaMilliseconds = Timer::TicksToMilliseconds( soaTicks ) / PASS_COUNT;
+	float64_t jobMilliseconds = Timer::TicksToMilliseconds( jobTicks ) / PASS_COUNT;
+	printf(
+		"%u spheres (%u visible): scalar %.3f ms, SoA %.3f ms (%.2fx), %u job workers %.3f ms (%.2fx)\n",
+		static_cast< uint32_t >( SPHERE_COUNT ),
+		static_cast< uint32_t >( visibleCount ),
+		scalarMilliseconds,
+		soaMilliseconds,
+		scalarMilliseconds / soaMilliseconds,
+		JobManager::GetInstance()->GetWorkerCount(),
+		jobMilliseconds,
+		scalarMilliseconds / jobMilliseconds );
+}
@@ -2,6 +2,7 @@
 
 #include "GraphicsJobs/GraphicsJobs.h"
 #include "Platform/Assert.h"
+#include "MathSimd/Frustum.h"
 #include "GraphicsTypes/GraphicsSceneObject.h"
 
 namespace Helium
@@ -56,6 +57,57 @@ private:
     Parameters m_parameters;
 };
 
+/// Spawn jobs to test the bounds of all graphics scene objects against a view frustum.
+class HELIUM_GRAPHICS_JOBS_API CullGraphicsSceneObjectsJobSpawner : Helium::NonCopyable
+{
+public:
+    class Parameters
+    {
+    public:
+        /// [in] Number of scene objects to test.
+        uint32_t sceneObjectCount;
+        /// [in] View frustum against which to test each scene object.
+        const Simd::Frustum* pFrustum;
+        /// [in] SIMD-aligned array of scene object bounding sphere center x coordinates.
+        const float32_t* pBoundsX;
+        /// [in] SIMD-aligned array of scene object bounding sphere center y coordinates.
+        const float32_t* pBoundsY;
+        /// [in] SIMD-aligned array of scene object bounding sphere center z coordinates.
+        const float32_t* pBoundsZ;
+        /// [in] SIMD-aligned array of scene object bounding sphere radii.
+        const float32_t* pBoundsRadius;
+        /// [out] Bit array in which to store whether each scene object is visible.
+        uint32_t* pVisibilityBits;
+
+        /// @name Construction/Destruction
+        //@{
+        inline Parameters();
+        //@}
+    };
+
+    /// @name Construction/Destruction
+    //@{
+    inline CullGraphicsSceneObjectsJobSpawner();
+    inline ~CullGraphicsSceneObjectsJobSpawner();
+    //@}
+
+    /// @name Parameters
+    //@{
+    inline Parameters& GetParameters();
+    inline const Parameters& GetParameters() const;
+    inline void SetParameters( const Parameters& rParameters );
+    //@}
+
+    /// @name Job Execution
+    //@{
+    void Run();
+    inline static void RunCallback( void* pJob );
+    //@}
+
+private:
+    Parameters m_parameters;
+};
+
 /// Spawn jobs to update the constant buffer data for all graphics scene objects.
 class HELIUM_GRAPHICS_JOBS_API UpdateGraphicsSceneObjectBuffersJobSpawner : Helium::NonCopyable
 {
@@ -144,6 +196,57 @@ private:
     Parameters m_parameters;
 };
 
+/// Test the bounds of a set of graphics scene objects against a view frustum.
+class HELIUM_GRAPHICS_JOBS_API CullGraphicsSceneObjectsJob : Helium::NonCopyable
+{
+public:
+    class Parameters
+    {
+    public:
+        /// [in] Number of scene objects to test.
+        uint32_t sceneObjectCount;
+        /// [in] View frustum against which to test each scene object.
+        const Simd::Frustum* pFrustum;
+        /// [in] SIMD-aligned array of scene object bounding sphere center x coordinates.
+        const float32_t* pBoundsX;
+        /// [in] SIMD-aligned array of scene object bounding sphere center y coordinates.
+        const float32_t* pBoundsY;
+        /// [in] SIMD-aligned array of scene object bounding sphere center z coordinates.
+        const float32_t* pBoundsZ;
+        /// [in] SIMD-aligned array of scene object bounding sphere radii.
+        const float32_t* pBoundsRadius;
+        /// [out] Bit array in which to store whether each scene object is visible (existing contents are overwritten).
+        uint32_t* pVisibilityBits;
+
+        /// @name Construction/Destruction
+        //@{
+        inline Parameters();
+        //@}
+    };
+
+    /// @name Construction/Destruction
+    //@{
+    inline CullGraphicsSceneObjectsJob();
+    inline ~CullGraphicsSceneObjectsJob();
+    //@}
+
+    /// @name Parameters
+    //@{
+    inline Parameters& GetParameters();
+    inline const Parameters& GetParameters() const;
+    inline void SetParameters( const Parameters& rParameters );
+    //@}
+
+    /// @name Job Execution
+    //@{
+    void Run();
+    inline static void RunCallback( void* pJob );
+    //@}
+
+private:
+    Parameters m_parameters;
+};
+
 /// Update the constant buffer data for a set of graphics scene objects.
 class HELIUM_GRAPHICS_JOBS_API UpdateGraphicsSceneObjectBuffersJob : Helium::NonCopyable
 {
@@ -34,6 +34,9 @@ void GraphicsSceneObject::SetTransform( const Simd::Matrix44& rTransform )
 
 /// Set the world-space axis-aligned bounding box for this instance.
 ///
+/// Object bounds must be set through GraphicsScene::SetSceneObjectWorldBounds() so that the scene's bounding volume
+/// hierarchy is updated as well.
+///
 /// @param[in] rBox  World-space axis-aligned bounding box to set.
 ///
 /// @see GetWorldBox(), GetWorldSphere()
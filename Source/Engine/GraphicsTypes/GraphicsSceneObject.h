@@ -100,7 +100,6 @@ namespace Helium
         /// @name Data Access
         //@{
         void SetTransform( const Simd::Matrix44& rTransform );
-        void SetWorldBounds( const Simd::AaBox& rBox );
         void SetVertexData( RVertexBuffer* pVertexBuffer, RVertexDescription* pVertexDescription, uint32_t vertexStride );
         void SetIndexBuffer( RIndexBuffer* pIndexBuffer );
 
@@ -134,6 +133,10 @@ namespace Helium
         //@}
 
     private:
+        /// The scene keeps its bounding volume hierarchy in sync with object bounds (see
+        /// GraphicsScene::SetSceneObjectWorldBounds()).
+        friend class GraphicsScene;
+
         /// Scene transform.
         Simd::Matrix44 m_transform;
         /// World-space axis-aligned bounding box.
@@ -166,6 +169,11 @@ namespace Helium
 
         /// Update mode.
         uint8_t m_updateMode;
+
+        /// @name Private Utility Functions
+        //@{
+        void SetWorldBounds( const Simd::AaBox& rBox );
+        //@}
     } HELIUM_SIMD_ALIGN_POST;
 }
 
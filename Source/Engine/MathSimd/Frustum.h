@@ -58,7 +58,12 @@ namespace Helium
             //@{
             bool Contains( const Vector3& rPoint ) const;
             bool Intersects( const AaBox& rBox ) const;
+            bool Intersects( const AaBox& rBox, uint32_t& rPlaneMask ) const;
             bool Intersects( const Sphere& rSphere ) const;
+
+            void IntersectsSoa(
+                const float32_t* pCentersX, const float32_t* pCentersY, const float32_t* pCentersZ,
+                const float32_t* pRadii, size_t sphereCount, uint32_t* pResultBits ) const;
             //@}
 
             /// @name Math
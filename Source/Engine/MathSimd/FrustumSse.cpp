@@ -87,6 +87,79 @@ bool Helium::Simd::Frustum::Intersects( const AaBox& rBox ) const
     return true;
 }
 
+/// Test whether this frustum intersects a given axis-aligned bounding box in world space, skipping clip planes that
+/// are already known to fully contain the box.
+///
+/// This is intended for hierarchical culling: when a box is found to lie entirely in front of a clip plane, that
+/// plane is removed from the mask, and the updated mask can be passed along when testing any boxes nested within it.
+///
+/// @param[in]     rBox        Box to test.
+/// @param[in,out] rPlaneMask  Mask of clip planes against which to test the box, with bit <i>n</i> set for each
+///                            Frustum::EPlane value <i>n</i> to test.  On return, bits will be cleared for each tested
+///                            plane that fully contains the box.  This is not modified if the box is rejected.
+///
+/// @return  True if the box intersects this frustum, false if not.
+bool Helium::Simd::Frustum::Intersects( const AaBox& rBox, uint32_t& rPlaneMask ) const
+{
+    Helium::Simd::Register boxMinVec = rBox.GetMinimum().GetSimdVector();
+    Helium::Simd::Register boxMaxVec = rBox.GetMaximum().GetSimdVector();
+
+    Helium::Simd::Register boxX0 = _mm_shuffle_ps( boxMinVec, boxMinVec, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+    Helium::Simd::Register boxX1 = _mm_shuffle_ps( boxMaxVec, boxMaxVec, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+    Helium::Simd::Register boxY = _mm_shuffle_ps( boxMinVec, boxMaxVec, _MM_SHUFFLE( 1, 1, 1, 1 ) );
+    Helium::Simd::Register boxZ = _mm_unpackhi_ps( boxMinVec, boxMaxVec );
+    boxZ = _mm_movelh_ps( boxZ, boxZ );
+
+    PlaneSoa plane;
+    Vector3Soa points( boxX0, boxY, boxZ );
+    Helium::Simd::Register zeroVec = Helium::Simd::LoadZeros();
+
+    // The far clip plane is never tested if it is infinite, so it can be treated as always containing the box.
+    uint32_t planeMask = rPlaneMask;
+    if( m_bInfiniteFarClip )
+    {
+        planeMask &= ~( 1U << PLANE_FAR );
+    }
+
+    size_t planeCount = ( m_bInfiniteFarClip ? PLANE_FAR : PLANE_MAX );
+    for( size_t planeIndex = 0; planeIndex < planeCount; ++planeIndex )
+    {
+        uint32_t planeBit = 1U << planeIndex;
+        if( !( planeMask & planeBit ) )
+        {
+            continue;
+        }
+
+        plane.Load1Splat(
+            m_planeA + planeIndex,
+            m_planeB + planeIndex,
+            m_planeC + planeIndex,
+            m_planeD + planeIndex );
+
+        points.m_x = boxX0;
+        Helium::Simd::Mask containsPoints0 = Helium::Simd::GreaterEqualsF32( plane.GetDistance( points ), zeroVec );
+
+        points.m_x = boxX1;
+        Helium::Simd::Mask containsPoints1 = Helium::Simd::GreaterEqualsF32( plane.GetDistance( points ), zeroVec );
+
+        int resultMask = _mm_movemask_ps( Helium::Simd::Or( containsPoints0, containsPoints1 ) );
+        if( resultMask == 0 )
+        {
+            return false;
+        }
+
+        resultMask = _mm_movemask_ps( Helium::Simd::MaskAnd( containsPoints0, containsPoints1 ) );
+        if( resultMask == 0xf )
+        {
+            planeMask &= ~planeBit;
+        }
+    }
+
+    rPlaneMask = planeMask;
+
+    return true;
+}
+
 /// Test whether this frustum intersects a given sphere in world space.
 ///
 /// @param[in] rSphere  Sphere to test.
@@ -124,6 +197,96 @@ bool Helium::Simd::Frustum::Intersects( const Sphere& rSphere ) const
     return true;
 }
 
+/// Test whether this frustum intersects each sphere in a set of spheres stored in struct-of-arrays form.
+///
+/// Spheres are tested four at a time against all clip planes, with the result for each sphere stored as a single bit
+/// in the output array (bit @c n of element @c n / 32 is set if sphere @c n intersects this frustum).  Each 32-bit
+/// element of the output array covering the given spheres is overwritten, with any bits past the last sphere cleared.
+///
+/// @param[in]  pCentersX    SIMD-aligned array of sphere center x coordinates.
+/// @param[in]  pCentersY    SIMD-aligned array of sphere center y coordinates.
+/// @param[in]  pCentersZ    SIMD-aligned array of sphere center z coordinates.
+/// @param[in]  pRadii       SIMD-aligned array of sphere radii.
+/// @param[in]  sphereCount  Number of spheres to test.  Each input array must be readable up to this count rounded
+///                          up to the next multiple of four (the contents of any padding are ignored).
+/// @param[out] pResultBits  Array in which to store the intersection results.  This must be large enough to hold
+///                          one bit for each sphere, rounded up to the next 32-bit element.
+///
+/// @see Intersects()
+void Helium::Simd::Frustum::IntersectsSoa(
+    const float32_t* pCentersX,
+    const float32_t* pCentersY,
+    const float32_t* pCentersZ,
+    const float32_t* pRadii,
+    size_t sphereCount,
+    uint32_t* pResultBits ) const
+{
+    HELIUM_ASSERT( pCentersX || sphereCount == 0 );
+    HELIUM_ASSERT( pCentersY || sphereCount == 0 );
+    HELIUM_ASSERT( pCentersZ || sphereCount == 0 );
+    HELIUM_ASSERT( pRadii || sphereCount == 0 );
+    HELIUM_ASSERT( pResultBits || sphereCount == 0 );
+
+    // Splat each clip plane once up front so that each batch of spheres can be tested against it directly.
+    PlaneSoa planes[ PLANE_MAX ];
+
+    size_t planeCount = ( m_bInfiniteFarClip ? PLANE_FAR : PLANE_MAX );
+    for( size_t planeIndex = 0; planeIndex < planeCount; ++planeIndex )
+    {
+        planes[ planeIndex ].Load1Splat(
+            m_planeA + planeIndex,
+            m_planeB + planeIndex,
+            m_planeC + planeIndex,
+            m_planeD + planeIndex );
+    }
+
+    Helium::Simd::Register zeroVec = Helium::Simd::LoadZeros();
+    Vector3Soa centers;
+
+    for( size_t baseSphereIndex = 0; baseSphereIndex < sphereCount; baseSphereIndex += 32 )
+    {
+        size_t blockSphereCount = sphereCount - baseSphereIndex;
+        if( blockSphereCount > 32 )
+        {
+            blockSphereCount = 32;
+        }
+
+        uint32_t resultBits = 0;
+        for( size_t blockSphereIndex = 0; blockSphereIndex < blockSphereCount; blockSphereIndex += 4 )
+        {
+            size_t sphereIndex = baseSphereIndex + blockSphereIndex;
+
+            centers.m_x = Helium::Simd::LoadAligned( pCentersX + sphereIndex );
+            centers.m_y = Helium::Simd::LoadAligned( pCentersY + sphereIndex );
+            centers.m_z = Helium::Simd::LoadAligned( pCentersZ + sphereIndex );
+            Helium::Simd::Register radii = Helium::Simd::LoadAligned( pRadii + sphereIndex );
+
+            // A sphere intersects the frustum as long as it isn't entirely behind any of the clip planes.
+            Helium::Simd::Mask intersects = Helium::Simd::GreaterEqualsF32(
+                Helium::Simd::AddF32( planes[ 0 ].GetDistance( centers ), radii ),
+                zeroVec );
+            for( size_t planeIndex = 1; planeIndex < planeCount; ++planeIndex )
+            {
+                intersects = Helium::Simd::MaskAnd(
+                    intersects,
+                    Helium::Simd::GreaterEqualsF32(
+                        Helium::Simd::AddF32( planes[ planeIndex ].GetDistance( centers ), radii ),
+                        zeroVec ) );
+            }
+
+            resultBits |= static_cast< uint32_t >( _mm_movemask_ps( intersects ) ) << blockSphereIndex;
+        }
+
+        // Clear the results for any padding past the last sphere.
+        if( blockSphereCount < 32 )
+        {
+            resultBits &= ( 1U << blockSphereCount ) - 1;
+        }
+
+        pResultBits[ baseSphereIndex / 32 ] = resultBits;
+    }
+}
+
 /// Compute the corners of this view frustum.
 ///
 /// A view frustum can have either four or eight corners depending on whether a far clip plane exists (eight
@@ -11,6 +11,9 @@
 #include "Engine/AssetLoader.h"
 #include "Engine/Resource.h"
 #include "Engine/Config.h"
+#include "Engine/LoadTrace.h"
+#include "Engine/StableHash.h"
+#include "EngineJobs/JobManager.h"
 #include "PcSupport/PlatformPreprocessor.h"
 #include "PcSupport/ResourceHandler.h"
 #include "Engine/PackageLoader.h"
@@ -19,9 +22,73 @@ using namespace Helium;
 
 static uint32_t g_InitCount = 0;
 AssetPreprocessor* AssetPreprocessor::sm_pInstance = NULL;
+const uint32_t AssetPreprocessor::sm_Version = 2;
+
+#if HELIUM_TOOLS
+/// Size of the buffer used when hashing source files.
+static const size_t CONTENT_HASH_FILE_BUFFER_SIZE = 64 * 1024;
+
+/// Add the contents of a file to a content hash.
+///
+/// @param[in] hash       Current hash value.
+/// @param[in] rFilePath  File to hash.
+///
+/// @return  Updated hash value.  If the file cannot be read, only a marker for the missing file is hashed.
+static uint64_t UpdateContentHash( uint64_t hash, const FilePath& rFilePath )
+{
+	FileStream* pFileStream = FileStream::OpenFileStream( String( rFilePath.Data() ), FileStream::MODE_READ );
+	if( !pFileStream )
+	{
+		uint8_t missingMarker = 0xff;
+
+		return StableHash64( hash, &missingMarker, sizeof( missingMarker ) );
+	}
+
+	DynamicArray< uint8_t > buffer;
+	buffer.Resize( CONTENT_HASH_FILE_BUFFER_SIZE );
+
+	size_t bytesRead;
+	while( ( bytesRead = pFileStream->Read( buffer.GetData(), 1, buffer.GetSize() ) ) != 0 )
+	{
+		hash = StableHash64( hash, buffer.GetData(), bytesRead );
+	}
+
+	delete pFileStream;
+
+	return hash;
+}
+
+/// Run a set of CacheObjects() tasks on the job manager, or on the calling thread if it is not running.
+///
+/// @param[in] rTasks     Tasks to run.
+/// @param[in] pFunction  Job function with which to run each task.
+template< typename T >
+static void RunCacheTasks( DynamicArray< T >& rTasks, JOB_FUNC pFunction )
+{
+	JobManager* pJobManager = JobManager::GetInstance();
+	if( !pJobManager || rTasks.GetSize() < 2 )
+	{
+		for( size_t taskIndex = 0; taskIndex < rTasks.GetSize(); ++taskIndex )
+		{
+			pFunction( &rTasks[ taskIndex ] );
+		}
+
+		return;
+	}
+
+	JobCounter counter;
+	for( size_t taskIndex = 0; taskIndex < rTasks.GetSize(); ++taskIndex )
+	{
+		pJobManager->Spawn( pFunction, &rTasks[ taskIndex ], counter );
+	}
+
+	pJobManager->Wait( counter );
+}
+#endif  // HELIUM_TOOLS
 
 /// Constructor.
 AssetPreprocessor::AssetPreprocessor()
+: m_cacheCompression( Compression::TYPE_NONE )
 {
 	MemoryZero( m_pPlatformPreprocessors, sizeof( m_pPlatformPreprocessors ) );
 }
@@ -53,8 +120,10 @@ void AssetPreprocessor::SetPlatformPreprocessor( Cache::EPlatform platform, Plat
 
 /// Cache an object for all registered platforms.
 ///
+/// @param[in] objectPath                              Asset path.
 /// @param[in] pObject                                 Asset to cache.
-/// @param[in] timestamp                               Asset timestamp.
+/// @param[in] timestamp                               Asset timestamp.  This is stored with the cached data, but is
+///                                                    not used to determine whether the cached data is up-to-date.
 /// @param[in] bEvictPlatformPreprocessedResourceData  If the object being cached is a Resource-based object,
 ///                                                    specifying true will free the raw preprocessed resource data
 ///                                                    for the current platform after caching, while false will keep
@@ -64,6 +133,8 @@ void AssetPreprocessor::SetPlatformPreprocessor( Cache::EPlatform platform, Plat
 ///                                                    to keep this data intact.
 ///
 /// @return  True if object caching was successful, false if not.
+///
+/// @see CacheObjects()
 bool AssetPreprocessor::CacheObject(
 	const AssetPath &objectPath,
 	Asset* pObject,
@@ -75,361 +146,1147 @@ bool AssetPreprocessor::CacheObject(
 	HELIUM_ASSERT( pObject );
 
 	bool bCacheFailure = false;
+	bool bUpdatedAnyCache = false;
 
-	DynamicArray< uint8_t > objectStreamBuffer;
+	// Cached data is considered up-to-date based on the contents of its inputs rather than on file timestamps.
+	uint64_t contentHash = ComputeContentHash( objectPath, pObject );
 
-	Helium::DynamicMemoryStream directStream;
-	Helium::ByteSwappingStream byteSwappingStream( &directStream );
+	for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	{
+		// Don't cache on platforms for which we don't have a preprocessor.
+		if( !m_pPlatformPreprocessors[ platformIndex ] )
+		{
+			continue;
+		}
 
-	// Only worry about resource data caching if the object is a Resource type that's not the default template
-	// object for its specific type.
-	Resource* pResource = ( !pObject->IsDefaultTemplate() ? Reflect::SafeCast< Resource >( pObject ) : NULL );
+		if( !CacheObjectForPlatform(
+			objectPath,
+			pObject,
+			timestamp,
+			contentHash,
+			static_cast< Cache::EPlatform >( platformIndex ),
+			bEvictPlatformPreprocessedResourceData,
+			true,
+			bUpdatedAnyCache ) )
+		{
+			bCacheFailure = true;
+		}
+	}
+
+	// Notify the object that it has been cached.
+	if( bUpdatedAnyCache )
+	{
+		pObject->PostSave();
+	}
+
+	return !bCacheFailure;
+
+#else  // HELIUM_TOOLS
+
+	HELIUM_UNREF( pObject );
+	HELIUM_UNREF( timestamp );
+	HELIUM_UNREF( bEvictPlatformPreprocessedResourceData );
+
+	return false;
+
+#endif  // HELIUM_TOOLS
+}
+
+/// Preprocess and cache a batch of objects for all registered platforms.
+///
+/// Resource preprocessing (for resource handlers that support it) and the caching of each object for each platform are
+/// spread across the job manager, if it is running.  Resources whose handlers do not support concurrent caching are
+/// preprocessed on the calling thread first.  Unlike CacheObject(), this also takes care of loading the resource data of
+/// each Resource-based object, so LoadResourceData() does not need to be called beforehand.
+///
+/// All cache lookups that depend on other objects in the batch (content hashes of dependencies and the dependency
+/// manifests built from them) are made on the calling thread once the jobs have finished, in dependency order, so the
+/// results do not depend on job scheduling.
+///
+/// @param[in] pRequests                               Objects to cache.  Objects requested more than once are only
+///                                                    cached once.
+/// @param[in] requestCount                            Number of objects to cache.
+/// @param[in] bEvictPlatformPreprocessedResourceData  See CacheObject().
+///
+/// @return  True if caching was successful for all objects, false if not.
+///
+/// @see CacheObject()
+bool AssetPreprocessor::CacheObjects(
+	const CacheObjectRequest* pRequests,
+	size_t requestCount,
+	bool bEvictPlatformPreprocessedResourceData )
+{
+#if HELIUM_TOOLS
+
+	HELIUM_ASSERT( pRequests || requestCount == 0 );
 
 	CacheManager* pCacheManager = CacheManager::GetInstance();
 	HELIUM_ASSERT( pCacheManager );
 
-	AssetLoader* pAssetLoader = AssetLoader::GetInstance();
-	HELIUM_ASSERT( pAssetLoader );
+	// Create all caches that will be read or written and fully load their entries up front, so the jobs below only
+	// ever access existing caches and never create entries from a TOC table that a cache update may release.  Content
+	// hashes look up the cached hashes of dependencies, which may be in either object cache.
+	static const char* const objectCacheNames[] = { HELIUM_ASSET_CACHE_NAME, HELIUM_CONFIG_CACHE_NAME };
+	for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	{
+		if( !m_pPlatformPreprocessors[ platformIndex ] )
+		{
+			continue;
+		}
 
-	// Non-user configuration objects should have special caching logic
-	Name objectCacheName( NULL_NAME );
+		for( size_t nameIndex = 0; nameIndex < HELIUM_ARRAY_COUNT( objectCacheNames ); ++nameIndex )
+		{
+			Cache* pCache = pCacheManager->GetCache(
+				Name( objectCacheNames[ nameIndex ] ),
+				static_cast< Cache::EPlatform >( platformIndex ) );
+			HELIUM_ASSERT( pCache );
+			pCache->EnforceTocLoad();
+			pCache->LoadAllEntries();
+		}
+	}
 
-	Config* pConfig = Config::GetInstance();
-	HELIUM_ASSERT( pConfig );
+	size_t platformCount = 0;
+	for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	{
+		if( m_pPlatformPreprocessors[ platformIndex ] )
+		{
+			++platformCount;
+		}
+	}
 
-	// TODO: We should only cache the platform-required configs
-	if( pConfig->IsAssetPathInConfigContainerPackage( objectPath ) )
+	// Only the first request for each object is kept, as tasks for the same object would write the same cache entries
+	// concurrently.  From here on, tasks are indexed by their position in the list of unique requests.
+	DynamicArray< CacheObjectRequest > uniqueRequests;
+	HashMap< AssetPath, size_t > taskIndices;
+	uniqueRequests.Reserve( requestCount );
+	for( size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex )
 	{
-		objectCacheName = Name( HELIUM_CONFIG_CACHE_NAME );
+		HashMap< AssetPath, size_t >::Iterator taskIterator;
+		if( taskIndices.Insert(
+			taskIterator,
+			HashMap< AssetPath, size_t >::ValueType( pRequests[ requestIndex ].objectPath, uniqueRequests.GetSize() ) ) )
+		{
+			uniqueRequests.Push( pRequests[ requestIndex ] );
+		}
 	}
-	
-	if (objectCacheName.IsEmpty())
+
+	pRequests = uniqueRequests.GetData();
+	requestCount = uniqueRequests.GetSize();
+
+	DynamicArray< PrepareObjectTask > prepareTasks;
+	prepareTasks.Reserve( requestCount );
+
+	for( size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex )
 	{
-		objectCacheName = Name( HELIUM_ASSET_CACHE_NAME );
+		const CacheObjectRequest& rRequest = pRequests[ requestIndex ];
+		HELIUM_ASSERT( rRequest.pObject );
+
+		Resource* pResource =
+			( !rRequest.pObject->IsDefaultTemplate() ? Reflect::SafeCast< Resource >( rRequest.pObject ) : NULL );
+
+		if( pResource )
+		{
+			for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+			{
+				if( !m_pPlatformPreprocessors[ platformIndex ] )
+				{
+					continue;
+				}
+
+				Cache* pResourceCache = pCacheManager->GetCache(
+					pResource->GetCacheName(),
+					static_cast< Cache::EPlatform >( platformIndex ) );
+				HELIUM_ASSERT( pResourceCache );
+				pResourceCache->EnforceTocLoad();
+				pResourceCache->LoadAllEntries();
+			}
+		}
+
+		PrepareObjectTask* pTask = prepareTasks.New();
+		HELIUM_ASSERT( pTask );
+		pTask->pPreprocessor = this;
+		pTask->pRequest = &rRequest;
+		pTask->contentHash = 0;
+		pTask->firstCacheTaskIndex = requestIndex * platformCount;
+		pTask->bLoadResourceData = false;
+		pTask->bHashResolving = false;
+		pTask->bHashResolved = false;
+		pTask->bUpdatedCache = false;
+
+		if( pResource )
+		{
+			ResourceHandler* pResourceHandler = ResourceHandler::FindResourceHandlerForType( pResource->GetAssetType() );
+			if( pResourceHandler && pResourceHandler->SupportsConcurrentCaching() )
+			{
+				pTask->bLoadResourceData = true;
+			}
+			else
+			{
+				LoadResourceData( rRequest.objectPath, pResource );
+			}
+		}
 	}
 
-	bool bUpdatedAnyCache = false;
+	RunCacheTasks( prepareTasks, RunPrepareObjectTask );
 
-	for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	// Fold the content hashes of dependencies into each object's content hash, using the newly computed hashes of any
+	// dependencies in the same batch.  This also yields an order in which dependencies precede the objects referencing
+	// them.
+	DynamicArray< size_t > taskOrder;
+	taskOrder.Reserve( requestCount );
+	for( size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex )
 	{
-		// Don't cache on platforms for which we don't have a preprocessor.
+		ResolveContentHash( prepareTasks, taskIndices, requestIndex, taskOrder );
+	}
+
+	// Cache each object for each platform.
+	DynamicArray< PlatformCacheTask > cacheTasks;
+	for( size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex )
+	{
+		for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+		{
+			if( !m_pPlatformPreprocessors[ platformIndex ] )
+			{
+				continue;
+			}
+
+			PlatformCacheTask* pTask = cacheTasks.New();
+			HELIUM_ASSERT( pTask );
+			pTask->pPrepareTask = &prepareTasks[ requestIndex ];
+			pTask->platform = static_cast< Cache::EPlatform >( platformIndex );
+			pTask->bEvictPlatformPreprocessedResourceData = bEvictPlatformPreprocessedResourceData;
+			pTask->bUpdatedCache = false;
+			pTask->bSuccess = false;
+		}
+	}
+
+	HELIUM_ASSERT( cacheTasks.GetSize() == requestCount * platformCount );
+
+	RunCacheTasks( cacheTasks, RunPlatformCacheTask );
+
+	bool bCacheFailure = false;
+	for( size_t taskIndex = 0; taskIndex < cacheTasks.GetSize(); ++taskIndex )
+	{
+		const PlatformCacheTask& rTask = cacheTasks[ taskIndex ];
+		if( !rTask.bSuccess )
+		{
+			bCacheFailure = true;
+		}
+
+		if( rTask.bUpdatedCache )
+		{
+			rTask.pPrepareTask->bUpdatedCache = true;
+		}
+	}
+
+	// Cache the dependency manifests of all recached objects.  Manifests include those of the objects' dependencies,
+	// so they are built in dependency order once all object data has been cached.
+	DynamicArray< AssetPath > dependencies;
+	for( size_t orderIndex = 0; orderIndex < taskOrder.GetSize(); ++orderIndex )
+	{
+		const PrepareObjectTask& rPrepareTask = prepareTasks[ taskOrder[ orderIndex ] ];
+		const CacheObjectRequest& rRequest = *rPrepareTask.pRequest;
+
+		for( size_t platformTaskIndex = 0; platformTaskIndex < platformCount; ++platformTaskIndex )
+		{
+			const PlatformCacheTask& rTask = cacheTasks[ rPrepareTask.firstCacheTaskIndex + platformTaskIndex ];
+			HELIUM_ASSERT( rTask.pPrepareTask == &rPrepareTask );
+			if( !rTask.bUpdatedCache )
+			{
+				continue;
+			}
+
+			Cache* pCache = pCacheManager->GetCache( GetObjectCacheName( rRequest.objectPath ), rTask.platform );
+			HELIUM_ASSERT( pCache );
+
+			dependencies = rPrepareTask.dependencies;
+			CacheDependencyManifest(
+				rRequest.objectPath,
+				pCache,
+				dependencies,
+				rRequest.timestamp,
+				rPrepareTask.contentHash );
+		}
+	}
+
+	// Notify the objects that they have been cached.
+	for( size_t requestIndex = 0; requestIndex < requestCount; ++requestIndex )
+	{
+		if( prepareTasks[ requestIndex ].bUpdatedCache )
+		{
+			pRequests[ requestIndex ].pObject->PostSave();
+		}
+	}
+
+	return !bCacheFailure;
+
+#else  // HELIUM_TOOLS
+
+	HELIUM_UNREF( pRequests );
+	HELIUM_UNREF( requestCount );
+	HELIUM_UNREF( bEvictPlatformPreprocessedResourceData );
+
+	return false;
+
+#endif  // HELIUM_TOOLS
+}
+
+/// Load data for the specified resource into memory, preprocessing it from source data if it is out-of-date.
+///
+/// @param[in] resourcePath  Path of the resource to load.
+/// @param[in] pResource     Resource to load.
+void AssetPreprocessor::LoadResourceData( const AssetPath &resourcePath, Resource* pResource )
+{
+#if HELIUM_TOOLS
+
+	HELIUM_ASSERT( pResource );
+
+	FilePath sourceFilePath;
+	if ( !GetResourceSourceFilePath( resourcePath, pResource, sourceFilePath ) )
+	{
+		return;
+	}
+
+	uint64_t contentHash = ComputeContentHash( resourcePath, pResource );
+
+	// Check if data is loaded for each supported platform, attempting to load the data from the cache if it exists
+	// and is up-to-date.
+	size_t platformIndex;
+	for( platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	{
+		// Skip platforms for which we don't have preprocessing support.
 		PlatformPreprocessor* pPreprocessor = m_pPlatformPreprocessors[ platformIndex ];
 		if( !pPreprocessor )
 		{
 			continue;
 		}
 
-		// Retrieve the cache for the current platform.
-		Cache* pCache = pCacheManager->GetCache( objectCacheName, static_cast< Cache::EPlatform >( platformIndex ) );
+		// Check if we already have loaded resource data.
+		const Resource::PreprocessedData& rPreprocessedData = pResource->GetPreprocessedData(
+			static_cast< Cache::EPlatform >( platformIndex ) );
+		if( rPreprocessedData.bLoaded )
+		{
+			continue;
+		}
+
+		// Retrieve the content hash of the cached data using the object cache.
+		AssetLoader* pAssetLoader = AssetLoader::GetInstance();
+		HELIUM_ASSERT( pAssetLoader );
+
+		CacheManager* pCacheManager = CacheManager::GetInstance();
+		HELIUM_ASSERT( pCacheManager );
+
+		Cache* pCache = pCacheManager->GetCache(
+			Name( HELIUM_ASSET_CACHE_NAME ),
+			static_cast< Cache::EPlatform >( platformIndex ) );
 		HELIUM_ASSERT( pCache );
 		pCache->EnforceTocLoad();
 
-		// Don't recache the object if an up-to-date cache entry already exists for it.
-		const Cache::Entry* pEntry = pCache->FindEntry( objectPath, 0 );
-		if( pEntry && pEntry->timestamp == timestamp )
-		{
-			continue;
-		}
+		const Cache::Entry* pCacheEntry = pCache->FindEntry( resourcePath, 0 );
+		if( !pCacheEntry || pCacheEntry->contentHash != contentHash )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Info,
+				"AssetPreprocessor::LoadResourceData(): Cached resource data not found or is out-of-date for resource \"%s\".  Resource will be preprocessed.\n",
+				*resourcePath.ToString() );
+
+			break;
+		}
+
+		// Cached data should be up-to-date, so attempt to load the data from the cache.
+		if( !LoadCachedResourceData( resourcePath, pResource, static_cast< Cache::EPlatform >( platformIndex ) ) )
+		{
+			HELIUM_TRACE(
+				TraceLevels::Warning,
+				"AssetPreprocessor::LoadResourceData(): Failed to load cached resource data for \"%s\".  Resource will be preprocessed again.\n",
+				*resourcePath.ToString() );
+
+			break;
+		}
+	}
+
+	if( platformIndex >= HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ) )
+	{
+		// All supported platforms loaded successfully, so nothing else needs to be done.
+		return;
+	}
+
+	// Preprocess all resources for each supported platform.
+	if( !PreprocessResource( resourcePath, pResource, String( sourceFilePath.Data() ) ) )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"AssetPreprocessor::LoadResourceData(): Preprocessing of resource \"%s\" failed.\n",
+			*resourcePath.ToString() );
+	}
+
+#else  // HELIUM_TOOLS
+
+	HELIUM_UNREF( pResource );
+
+#endif  // HELIUM_TOOLS
+}
+
+/// Rewrite the caches of each registered platform so that the entries requested in a recorded load are read
+/// sequentially.
+///
+/// Each cache with requests in the trace is rewritten using Cache::OptimizeLayout().  The trace is replayed against each
+/// cache before and after it is rewritten (see Cache::ReplayLoadTrace()), and the number of reads, seeks, and bytes read
+/// by each replay are logged for comparison.
+///
+/// @param[in] rTrace   Load trace, as recorded using AssetLoader::BeginLoadTrace().
+/// @param[in] bBundle  True to also pack objects that are loaded together into bundles.
+///
+/// @return  True if all caches were rewritten successfully, false if not.
+bool AssetPreprocessor::OptimizeCacheLayouts( const LoadTrace& rTrace, bool bBundle )
+{
+#if HELIUM_TOOLS
+
+	CacheManager* pCacheManager = CacheManager::GetInstance();
+	HELIUM_ASSERT( pCacheManager );
+
+	// Gather the names of the caches used in the trace.
+	DynamicArray< Name > cacheNames;
+
+	size_t recordCount = rTrace.GetRecordCount();
+	for( size_t recordIndex = 0; recordIndex < recordCount; ++recordIndex )
+	{
+		Name cacheName = rTrace.GetRecord( recordIndex ).cacheName;
+
+		size_t cacheNameCount = cacheNames.GetSize();
+		size_t cacheNameIndex;
+		for( cacheNameIndex = 0; cacheNameIndex < cacheNameCount; ++cacheNameIndex )
+		{
+			if( cacheNames[ cacheNameIndex ] == cacheName )
+			{
+				break;
+			}
+		}
+
+		if( cacheNameIndex == cacheNameCount )
+		{
+			cacheNames.Push( cacheName );
+		}
+	}
+
+	bool bSuccess = true;
+
+	for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	{
+		if( !m_pPlatformPreprocessors[ platformIndex ] )
+		{
+			continue;
+		}
+
+		Cache::EPlatform platform = static_cast< Cache::EPlatform >( platformIndex );
+
+		size_t cacheNameCount = cacheNames.GetSize();
+		for( size_t cacheNameIndex = 0; cacheNameIndex < cacheNameCount; ++cacheNameIndex )
+		{
+			Cache* pCache = pCacheManager->GetCache( cacheNames[ cacheNameIndex ], platform );
+			if( !pCache )
+			{
+				continue;
+			}
+
+			pCache->EnforceTocLoad();
+
+			// Caches that don't exist yet have nothing to rewrite.
+			Cache::ReplayStatistics originalStatistics;
+			if( !pCache->ReplayLoadTrace( rTrace, originalStatistics ) )
+			{
+				continue;
+			}
+
+			if( !pCache->OptimizeLayout( rTrace, bBundle ) )
+			{
+				bSuccess = false;
+
+				continue;
+			}
+
+			Cache::ReplayStatistics optimizedStatistics;
+			pCache->ReplayLoadTrace( rTrace, optimizedStatistics );
+
+			HELIUM_TRACE(
+				TraceLevels::Info,
+				"AssetPreprocessor: Optimized layout of \"%s\" for %" PRIu32 " requests: %" PRIu32 " -> %" PRIu32
+				" reads, %" PRIu32 " -> %" PRIu32 " seeks, %" PRIu64 " -> %" PRIu64 " bytes read.\n",
+				*pCache->GetCacheFileName(),
+				originalStatistics.requestCount,
+				originalStatistics.readCount,
+				optimizedStatistics.readCount,
+				originalStatistics.seekCount,
+				optimizedStatistics.seekCount,
+				originalStatistics.bytesRead,
+				optimizedStatistics.bytesRead );
+		}
+	}
+
+	return bSuccess;
+
+#else  // HELIUM_TOOLS
+
+	HELIUM_UNREF( rTrace );
+	HELIUM_UNREF( bBundle );
+
+	return false;
+
+#endif  // HELIUM_TOOLS
+}
+
+
+#if HELIUM_TOOLS
+
+/// Get the name of the cache in which an object should be stored.
+///
+/// @param[in] objectPath  Asset path.
+///
+/// @return  Object cache name.
+Name AssetPreprocessor::GetObjectCacheName( const AssetPath &objectPath )
+{
+	Config* pConfig = Config::GetInstance();
+	HELIUM_ASSERT( pConfig );
+
+	// Non-user configuration objects should have special caching logic
+	// TODO: We should only cache the platform-required configs
+	if( pConfig->IsAssetPathInConfigContainerPackage( objectPath ) )
+	{
+		return Name( HELIUM_CONFIG_CACHE_NAME );
+	}
+
+	return Name( HELIUM_ASSET_CACHE_NAME );
+}
+
+/// Expand the list of objects referenced directly by a cached object into its dependency manifest.
+///
+/// The manifests of the direct dependencies stored in the same cache are appended in turn (each of which already
+/// holds the dependencies of that object), so the result approximates the transitive closure of the object's
+/// dependencies, limited to DEPENDENCY_MANIFEST_PATH_COUNT_MAX paths.  Dependencies that have not been cached yet, or
+/// that are stored in a different cache, only contribute themselves.
+///
+/// @param[in]     objectPath     Path of the object being cached.
+/// @param[in]     pCache         Cache in which the object is being stored.
+/// @param[in,out] rDependencies  On input, the objects referenced directly by the object being cached.  On output,
+///                               the full dependency manifest.
+void AssetPreprocessor::BuildDependencyManifest(
+	const AssetPath &objectPath,
+	Cache* pCache,
+	DynamicArray< AssetPath >& rDependencies )
+{
+	HELIUM_ASSERT( pCache );
+
+	// Remove any self-references.
+	for( size_t dependencyIndex = rDependencies.GetSize(); dependencyIndex > 0; --dependencyIndex )
+	{
+		if( rDependencies[ dependencyIndex - 1 ] == objectPath )
+		{
+			rDependencies.Remove( dependencyIndex - 1 );
+		}
+	}
+
+	if( rDependencies.GetSize() > DEPENDENCY_MANIFEST_PATH_COUNT_MAX )
+	{
+		rDependencies.Resize( DEPENDENCY_MANIFEST_PATH_COUNT_MAX );
+	}
+
+	DynamicArray< uint8_t > manifestBuffer;
+	DynamicArray< AssetPath > manifestPaths;
+
+	size_t directDependencyCount = rDependencies.GetSize();
+	for( size_t directDependencyIndex = 0;
+		directDependencyIndex < directDependencyCount &&
+		rDependencies.GetSize() < DEPENDENCY_MANIFEST_PATH_COUNT_MAX;
+		++directDependencyIndex )
+	{
+		AssetPath dependencyPath = rDependencies[ directDependencyIndex ];
+
+		const Cache::Entry* pEntry = pCache->FindEntry( dependencyPath, Cache::DEPENDENCY_MANIFEST_SUB_DATA_INDEX );
+		if( !pEntry || pEntry->size == 0 )
+		{
+			continue;
+		}
+
+		const uint8_t* pManifestData = NULL;
+		if( !pCache->GetEntryData( *pEntry, pManifestData ) )
+		{
+			FileStream* pFileStream = FileStream::OpenFileStream( pCache->GetCacheFileName(), FileStream::MODE_READ );
+			if( !pFileStream )
+			{
+				continue;
+			}
+
+			bool bRead = pCache->ReadEntryData( *pEntry, pFileStream, manifestBuffer );
+
+			delete pFileStream;
+
+			if( !bRead )
+			{
+				continue;
+			}
+
+			pManifestData = manifestBuffer.GetData();
+		}
+
+		Cache::ReadDependencyManifest( pManifestData, pEntry->size, manifestPaths );
+
+		size_t manifestPathCount = manifestPaths.GetSize();
+		for( size_t manifestPathIndex = 0;
+			manifestPathIndex < manifestPathCount && rDependencies.GetSize() < DEPENDENCY_MANIFEST_PATH_COUNT_MAX;
+			++manifestPathIndex )
+		{
+			AssetPath manifestPath = manifestPaths[ manifestPathIndex ];
+			if( manifestPath == objectPath )
+			{
+				continue;
+			}
+
+			size_t dependencyCount = rDependencies.GetSize();
+			size_t dependencyIndex = 0;
+			while( dependencyIndex < dependencyCount && rDependencies[ dependencyIndex ] != manifestPath )
+			{
+				++dependencyIndex;
+			}
+
+			if( dependencyIndex == dependencyCount )
+			{
+				rDependencies.Push( manifestPath );
+			}
+		}
+	}
+}
+
+/// Build and cache the dependency manifest of an object.
+///
+/// The manifest lists the objects the object depends on so that the loader can request them all up front rather than
+/// discovering them one level at a time as each object is deserialized.
+///
+/// @param[in]     objectPath     Path of the object being cached.
+/// @param[in]     pCache         Cache in which the object is stored.
+/// @param[in,out] rDependencies  On input, the objects referenced directly by the object.  On output, the full
+///                               dependency manifest (see BuildDependencyManifest()).
+/// @param[in]     timestamp      Asset timestamp.
+/// @param[in]     contentHash    Content hash of the object.
+void AssetPreprocessor::CacheDependencyManifest(
+	const AssetPath &objectPath,
+	Cache* pCache,
+	DynamicArray< AssetPath >& rDependencies,
+	int64_t timestamp,
+	uint64_t contentHash )
+{
+	HELIUM_ASSERT( pCache );
+
+	BuildDependencyManifest( objectPath, pCache, rDependencies );
+
+	DynamicArray< uint8_t > manifestBuffer;
+	Cache::WriteDependencyManifest( rDependencies, manifestBuffer );
+	HELIUM_ASSERT( manifestBuffer.GetSize() <= UINT32_MAX );
+
+	bool bCacheResult = pCache->CacheEntry(
+		objectPath,
+		Cache::DEPENDENCY_MANIFEST_SUB_DATA_INDEX,
+		manifestBuffer.GetData(),
+		timestamp,
+		static_cast< uint32_t >( manifestBuffer.GetSize() ),
+		contentHash );
+	if( !bCacheResult )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Warning,
+			"AssetPreprocessor: Failed to cache the dependency manifest for \"%s\".\n",
+			*objectPath.ToString() );
+	}
+}
+
+/// Cache an object for a single platform.
+///
+/// This is safe to call for different objects or platforms at the same time, provided that the caches involved have
+/// already been created and fully loaded (see Cache::LoadAllEntries()) and that the dependency manifest is not cached
+/// (it reads the manifests of other objects, which may be cached at the same time).
+///
+/// @param[in]     objectPath                              Asset path.
+/// @param[in]     pObject                                 Asset to cache.
+/// @param[in]     timestamp                               Asset timestamp.
+/// @param[in]     contentHash                             Hash of the inputs for the object data.
+/// @param[in]     platform                                Target platform.
+/// @param[in]     bEvictPlatformPreprocessedResourceData  See CacheObject().
+/// @param[in]     bCacheDependencyManifest                True to also cache the dependency manifest of the object if
+///                                                        it is recached, false if the caller will cache it (see
+///                                                        CacheDependencyManifest()).
+/// @param[in,out] rbUpdatedCache                          Set to true if the cache was updated (left unchanged if not).
+///
+/// @return  True if object caching was successful, false if not.
+bool AssetPreprocessor::CacheObjectForPlatform(
+	const AssetPath &objectPath,
+	Asset* pObject,
+	int64_t timestamp,
+	uint64_t contentHash,
+	Cache::EPlatform platform,
+	bool bEvictPlatformPreprocessedResourceData,
+	bool bCacheDependencyManifest,
+	bool& rbUpdatedCache )
+{
+	HELIUM_ASSERT( pObject );
+	HELIUM_ASSERT( static_cast< size_t >( platform ) < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ) );
+
+	PlatformPreprocessor* pPreprocessor = m_pPlatformPreprocessors[ platform ];
+	HELIUM_ASSERT( pPreprocessor );
+
+	bool bCacheFailure = false;
+
+	DynamicArray< uint8_t > objectStreamBuffer;
+
+	Helium::DynamicMemoryStream directStream;
+	Helium::ByteSwappingStream byteSwappingStream( &directStream );
+
+	// Only worry about resource data caching if the object is a Resource type that's not the default template
+	// object for its specific type.
+	Resource* pResource = ( !pObject->IsDefaultTemplate() ? Reflect::SafeCast< Resource >( pObject ) : NULL );
+
+	CacheManager* pCacheManager = CacheManager::GetInstance();
+	HELIUM_ASSERT( pCacheManager );
+
+	Name objectCacheName = GetObjectCacheName( objectPath );
+
+	// Retrieve the cache for the current platform.
+	Cache* pCache = pCacheManager->GetCache( objectCacheName, platform );
+	HELIUM_ASSERT( pCache );
+	pCache->EnforceTocLoad();
+
+	// Don't recache the object if an up-to-date cache entry already exists for it.
+	const Cache::Entry* pEntry = pCache->FindEntry( objectPath, 0 );
+	if( pEntry && pEntry->contentHash == contentHash )
+	{
+		return true;
+	}
 
-		HELIUM_TRACE(
-			TraceLevels::Info,
-			"AssetPreprocessor: Object \"%s\" is out of date.  Recaching...\n",
-			*objectPath.ToString() );
+	HELIUM_TRACE(
+		TraceLevels::Info,
+		"AssetPreprocessor: Object \"%s\" is out of date.  Recaching...\n",
+		*objectPath.ToString() );
 
-		bUpdatedAnyCache = true;
+	rbUpdatedCache = true;
 
-		// Prepare for writing out the property and persistent resource data for the current platform.
-		objectStreamBuffer.Resize( 0 );
-		directStream.Open( &objectStreamBuffer );
+	// Prepare for writing out the property and persistent resource data for the current platform.
+	objectStreamBuffer.Resize( 0 );
+	directStream.Open( &objectStreamBuffer );
 
-		bool bSwapBytes = pPreprocessor->SwapBytes();
-		Stream& rObjectStream =
-			( bSwapBytes ? static_cast< Stream& >( byteSwappingStream ) : static_cast< Stream& >( directStream ) );
-		
-		DynamicArray<uint8_t> data_buffer;
-		Cache::WriteCacheObjectToBuffer( pObject, data_buffer);
+	bool bSwapBytes = pPreprocessor->SwapBytes();
+	Stream& rObjectStream =
+		( bSwapBytes ? static_cast< Stream& >( byteSwappingStream ) : static_cast< Stream& >( directStream ) );
+	
+	DynamicArray<uint8_t> data_buffer;
+	DynamicArray< AssetPath > dependencies;
+	Cache::WriteCacheObjectToBuffer( pObject, data_buffer, &dependencies );
 
-		if (!data_buffer.IsEmpty())
-		{
-			HELIUM_ASSERT(data_buffer.GetSize() <= Helium::NumericLimits<uint32_t>::Maximum);
-			uint32_t data_size = static_cast<uint32_t>(data_buffer.GetSize()) + 1; // Add one for null terminator
-			rObjectStream.Write(&data_size, sizeof(data_size), 1);
-			rObjectStream.Write(&data_buffer[0], sizeof(data_buffer[0]), data_size - 1); // Copy the data (it is not null terminated).
+	if (!data_buffer.IsEmpty())
+	{
+		HELIUM_ASSERT(data_buffer.GetSize() <= Helium::NumericLimits<uint32_t>::Maximum);
+		uint32_t data_size = static_cast<uint32_t>(data_buffer.GetSize()) + 1; // Add one for null terminator
+		rObjectStream.Write(&data_size, sizeof(data_size), 1);
+		rObjectStream.Write(&data_buffer[0], sizeof(data_buffer[0]), data_size - 1); // Copy the data (it is not null terminated).
 
-			char nullTerminator = 0;
-			rObjectStream.Write(&nullTerminator, sizeof(nullTerminator), 1); // Add the null terminator
-		}
-		else
+		char nullTerminator = 0;
+		rObjectStream.Write(&nullTerminator, sizeof(nullTerminator), 1); // Add the null terminator
+	}
+	else
+	{
+		uint32_t data_size = 0;
+		rObjectStream.Write(&data_size, sizeof(data_size), 1);
+	}
+	
+	// Serialize persistent resource data and the number of chunks of sub-data.
+	if( pResource )
+	{
+		const Resource::PreprocessedData& rResourceData = pResource->GetPreprocessedData( platform );
+		if( !rResourceData.bLoaded )
 		{
-			uint32_t data_size = 0;
-			rObjectStream.Write(&data_size, sizeof(data_size), 1);
+			HELIUM_TRACE(
+				TraceLevels::Warning,
+				"AssetPreprocessor::CacheObject(): Cannot cache resource data for \"%s\" for platform index %" PRIuSZ " as the resource data is not in memory.  Make sure AssetPreprocessor::LoadResourceData() has been called on the object prior to caching.\n",
+				*objectPath.ToString(),
+				static_cast< size_t >( platform ) );
 		}
-		
-		// Serialize persistent resource data and the number of chunks of sub-data.
-		if( pResource )
+		else
 		{
-			const Resource::PreprocessedData& rResourceData = pResource->GetPreprocessedData(
-				static_cast< Cache::EPlatform >( platformIndex ) );
-			if( !rResourceData.bLoaded )
+			rObjectStream.Write(
+				rResourceData.persistentDataBuffer.GetData(),
+				1,
+				rResourceData.persistentDataBuffer.GetSize() );
+
+			// If we write anything, add a null terminator
+			if (rResourceData.persistentDataBuffer.GetSize() > 0)
 			{
-				HELIUM_TRACE(
-					TraceLevels::Warning,
-					"AssetPreprocessor::CacheObject(): Cannot cache resource data for \"%s\" for platform index %" PRIuSZ " as the resource data is not in memory.  Make sure AssetPreprocessor::LoadResourceData() has been called on the object prior to caching.\n",
-					*objectPath.ToString(),
-					platformIndex );
+				char nullTerminator = 0;
+				rObjectStream.Write(&nullTerminator, sizeof(nullTerminator), 1); // Add the null terminator
 			}
-			else
-			{
-				rObjectStream.Write(
-					rResourceData.persistentDataBuffer.GetData(),
-					1,
-					rResourceData.persistentDataBuffer.GetSize() );
-
-				// If we write anything, add a null terminator
-				if (rResourceData.persistentDataBuffer.GetSize() > 0)
-				{
-					char nullTerminator = 0;
-					rObjectStream.Write(&nullTerminator, sizeof(nullTerminator), 1); // Add the null terminator
-				}
 
-				size_t subDataCountActual = rResourceData.subDataBuffers.GetSize();
-				HELIUM_ASSERT( subDataCountActual <= UINT32_MAX );
+			size_t subDataCountActual = rResourceData.subDataBuffers.GetSize();
+			HELIUM_ASSERT( subDataCountActual <= UINT32_MAX );
 
-				uint32_t subDataCount = static_cast< uint32_t >( subDataCountActual );
-				rObjectStream.Write( &subDataCount, sizeof( subDataCount ), 1 );
-			}
+			uint32_t subDataCount = static_cast< uint32_t >( subDataCountActual );
+			rObjectStream.Write( &subDataCount, sizeof( subDataCount ), 1 );
 		}
+	}
 
-		directStream.Close();
-
-		// Cache the object data stream.
-		size_t objectDataSize = objectStreamBuffer.GetSize();
-		HELIUM_ASSERT( objectDataSize <= UINT32_MAX );
+	directStream.Close();
+
+	// Cache the object data stream.
+	size_t objectDataSize = objectStreamBuffer.GetSize();
+	HELIUM_ASSERT( objectDataSize <= UINT32_MAX );
+
+	bool bCacheResult = pCache->CacheEntry(
+		objectPath,
+		0,
+		objectStreamBuffer.GetData(),
+		timestamp,
+		static_cast< uint32_t >( objectDataSize ),
+		contentHash,
+		m_cacheCompression );
+	if( !bCacheResult )
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"AssetPreprocessor: Failed to cache object \"%s\".\n",
+			*objectPath.ToString() );
 
-		bool bCacheResult = pCache->CacheEntry(
-			objectPath,
-			0,
-			objectStreamBuffer.GetData(),
-			timestamp,
-			static_cast< uint32_t >( objectDataSize ) );
-		if( !bCacheResult )
-		{
-			HELIUM_TRACE(
-				TraceLevels::Error,
-				"AssetPreprocessor: Failed to cache object \"%s\".\n",
-				*objectPath.ToString() );
+		bCacheFailure = true;
+	}
 
-			bCacheFailure = true;
-		}
+	if( bCacheDependencyManifest )
+	{
+		CacheDependencyManifest( objectPath, pCache, dependencies, timestamp, contentHash );
+	}
 
-		// Finish resource data caching.
-		if( pResource )
+	// Finish resource data caching.
+	if( pResource )
+	{
+		Resource::PreprocessedData& rResourceData = pResource->GetPreprocessedData( platform );
+		if( rResourceData.bLoaded )
 		{
-			Resource::PreprocessedData& rResourceData = pResource->GetPreprocessedData(
-				static_cast< Cache::EPlatform >( platformIndex ) );
-			if( rResourceData.bLoaded )
+			const DynamicArray< DynamicArray< uint8_t > >& rSubDataBuffers = rResourceData.subDataBuffers;
+			size_t subDataBufferCount = rSubDataBuffers.GetSize();
+			if( subDataBufferCount != 0 )
 			{
-				const DynamicArray< DynamicArray< uint8_t > >& rSubDataBuffers = rResourceData.subDataBuffers;
-				size_t subDataBufferCount = rSubDataBuffers.GetSize();
-				if( subDataBufferCount != 0 )
+				// Cache resource sub-data.
+				Name resourceCacheName = pResource->GetCacheName();
+				HELIUM_ASSERT( !resourceCacheName.IsEmpty() );
+
+				Cache* pResourceCache = pCacheManager->GetCache(
+					resourceCacheName,
+					platform );
+				HELIUM_ASSERT( pResourceCache );
+				pResourceCache->EnforceTocLoad();
+
+				for( size_t subDataBufferIndex = 0;
+					subDataBufferIndex < subDataBufferCount;
+					++subDataBufferIndex )
 				{
-					// Cache resource sub-data.
-					Name resourceCacheName = pResource->GetCacheName();
-					HELIUM_ASSERT( !resourceCacheName.IsEmpty() );
-
-					Cache* pResourceCache = pCacheManager->GetCache(
-						resourceCacheName,
-						static_cast< Cache::EPlatform >( platformIndex ) );
-					HELIUM_ASSERT( pResourceCache );
-					pResourceCache->EnforceTocLoad();
-
-					for( size_t subDataBufferIndex = 0;
-						subDataBufferIndex < subDataBufferCount;
-						++subDataBufferIndex )
+					const DynamicArray< uint8_t >& rSubData = rSubDataBuffers[ subDataBufferIndex ];
+
+					bCacheResult = pResourceCache->CacheEntry(
+						objectPath,
+						static_cast< uint32_t >( subDataBufferIndex ),
+						rSubData.GetData(),
+						timestamp,
+						static_cast< uint32_t >( rSubData.GetSize() ),
+						contentHash,
+						m_cacheCompression );
+					if( !bCacheResult )
 					{
-						const DynamicArray< uint8_t >& rSubData = rSubDataBuffers[ subDataBufferIndex ];
-
-						bCacheResult = pResourceCache->CacheEntry(
-							objectPath,
-							static_cast< uint32_t >( subDataBufferIndex ),
-							rSubData.GetData(),
-							timestamp,
-							static_cast< uint32_t >( rSubData.GetSize() ) );
-						if( !bCacheResult )
-						{
-							HELIUM_TRACE(
-								TraceLevels::Error,
-								"AssetPreprocessor: Failed to cache resource sub-data %" PRIuSZ " for resource \"%s\".\n",
-								subDataBufferIndex,
-								*objectPath.ToString() );
-
-							bCacheFailure = true;
-						}
+						HELIUM_TRACE(
+							TraceLevels::Error,
+							"AssetPreprocessor: Failed to cache resource sub-data %" PRIuSZ " for resource \"%s\".\n",
+							subDataBufferIndex,
+							*objectPath.ToString() );
+
+						bCacheFailure = true;
 					}
 				}
+			}
 
-				// Since all resource data has now been recached for the current platform, we can evict the current
-				// platform data from memory.
-				if( bEvictPlatformPreprocessedResourceData )
-				{
-					rResourceData.persistentDataBuffer.Clear();
-					rResourceData.subDataBuffers.Clear();
-					rResourceData.bLoaded = false;
-				}
+			// Since all resource data has now been recached for the current platform, we can evict the current
+			// platform data from memory.
+			if( bEvictPlatformPreprocessedResourceData )
+			{
+				rResourceData.persistentDataBuffer.Clear();
+				rResourceData.subDataBuffers.Clear();
+				rResourceData.bLoaded = false;
 			}
 		}
 	}
 
-	// Notify the object that it has been cached.
-	if( bUpdatedAnyCache )
-	{
-		pObject->PostSave();
-	}
-
 	return !bCacheFailure;
+}
 
-#else  // HELIUM_TOOLS
-
-	HELIUM_UNREF( pObject );
-	HELIUM_UNREF( timestamp );
-	HELIUM_UNREF( bEvictPlatformPreprocessedResourceData );
+/// Job function for preparing an object for caching in CacheObjects().
+///
+/// @param[in] pData  PrepareObjectTask to run.
+void AssetPreprocessor::RunPrepareObjectTask( void* pData )
+{
+	PrepareObjectTask* pTask = static_cast< PrepareObjectTask* >( pData );
+	HELIUM_ASSERT( pTask );
+	HELIUM_ASSERT( pTask->pPreprocessor );
+	HELIUM_ASSERT( pTask->pRequest );
 
-	return false;
+	const CacheObjectRequest& rRequest = *pTask->pRequest;
+	if( pTask->bLoadResourceData )
+	{
+		pTask->pPreprocessor->LoadResourceData(
+			rRequest.objectPath,
+			Reflect::AssertCast< Resource >( rRequest.pObject ) );
+	}
 
-#endif  // HELIUM_TOOLS
+	// Dependency hashes are folded in by CacheObjects() once all objects in the batch have been hashed.
+	pTask->contentHash = pTask->pPreprocessor->ComputeObjectContentHash(
+		rRequest.objectPath,
+		rRequest.pObject,
+		pTask->dependencies );
 }
 
-/// Load data for the specified resource into memory, preprocessing it from source data if it is out-of-date.
+/// Job function for caching an object for a single platform in CacheObjects().
 ///
-/// @param[in] pResource        Resource to load.
-/// @param[in] objectTimestamp  Timestamp of the object data stored on disk.  This will be combined with the source
-///                             asset timestamp to get the timestamp value with which to compare against the cached
-///                             data.
-void AssetPreprocessor::LoadResourceData( const AssetPath &resourcePath, Resource* pResource )
+/// @param[in] pData  PlatformCacheTask to run.
+void AssetPreprocessor::RunPlatformCacheTask( void* pData )
 {
-#if HELIUM_TOOLS
+	PlatformCacheTask* pTask = static_cast< PlatformCacheTask* >( pData );
+	HELIUM_ASSERT( pTask );
+
+	const PrepareObjectTask* pPrepareTask = pTask->pPrepareTask;
+	HELIUM_ASSERT( pPrepareTask );
+	HELIUM_ASSERT( pPrepareTask->pPreprocessor );
+	HELIUM_ASSERT( pPrepareTask->pRequest );
+
+	const CacheObjectRequest& rRequest = *pPrepareTask->pRequest;
+	pTask->bSuccess = pPrepareTask->pPreprocessor->CacheObjectForPlatform(
+		rRequest.objectPath,
+		rRequest.pObject,
+		rRequest.timestamp,
+		pPrepareTask->contentHash,
+		pTask->platform,
+		pTask->bEvictPlatformPreprocessedResourceData,
+		false,
+		pTask->bUpdatedCache );
+}
 
-	HELIUM_ASSERT( pResource );
+/// Compute the hash of all inputs that affect the cached data of an object.
+///
+/// This covers everything hashed by ComputeObjectContentHash(), along with the stored content hash of each object
+/// the object references.  The dependency manifest of an object includes the references of its dependencies, so the
+/// object must be recached whenever one of its dependencies changes.
+///
+/// @param[in] path     Asset path.
+/// @param[in] pObject  Asset for which to compute the hash.
+///
+/// @return  Content hash (never zero, which is reserved for cache entries with an unknown hash).
+uint64_t AssetPreprocessor::ComputeContentHash( const AssetPath &path, Asset* pObject )
+{
+	DynamicArray< AssetPath > dependencies;
+	uint64_t hash = ComputeObjectContentHash( path, pObject, dependencies );
 
-	// Locate the source asset file of the source template resource and combine its timestamp with the object timestamp.
-	// This will be the asset that extends the default asset (i.e. test.png, which would have Helium::Texture2D as template)
-	Resource* pSourceResource = pResource;
-	Asset* pTestTemplate = Reflect::AssertCast< Asset >( pResource->GetTemplate() );
-	while( pTestTemplate && !pTestTemplate->IsDefaultTemplate() )
+	size_t dependencyCount = dependencies.GetSize();
+	for( size_t dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex )
 	{
-		pSourceResource = Reflect::AssertCast< Resource >( pTestTemplate );
-		pTestTemplate = Reflect::AssertCast< Asset >( pSourceResource->GetTemplate() );
+		const AssetPath& rDependencyPath = dependencies[ dependencyIndex ];
+		if( rDependencyPath != path )
+		{
+			uint64_t dependencyHash = GetCachedContentHash( rDependencyPath );
+			hash = StableHash64( hash, &dependencyHash, sizeof( dependencyHash ) );
+		}
 	}
 
-	AssetPath parentPath = pSourceResource == pResource ? resourcePath : pSourceResource->GetPath();
-	AssetPath baseResourcePath;
-	do
-	{
-		baseResourcePath = parentPath;
-		parentPath = parentPath.GetParent();
-	} while( !parentPath.IsEmpty() && !parentPath.IsPackage() );
-
-	FilePath sourceFilePath;
-	if ( !FileLocations::GetDataDirectory( sourceFilePath ) )
-	{
-		HELIUM_TRACE(
-			TraceLevels::Error,
-			"AssetPreprocessor::LoadResourceData(): Could not retrieve data directory.\n" );
+	return ( hash != 0 ? hash : 1 );
+}
 
-		return;
-	}
+/// Compute the hash of the inputs that belong to an object itself.
+///
+/// This covers the preprocessor version, the serialized data of the object and of every template it inherits from
+/// (changes to a template are not reflected in the serialized data of objects based on it), and for resources, the
+/// contents of the source asset file.
+///
+/// @param[in]  path           Asset path.
+/// @param[in]  pObject        Asset for which to compute the hash.
+/// @param[out] rDependencies  Objects referenced directly by the object.
+///
+/// @return  Content hash, not including the hashes of any dependencies.
+///
+/// @see ComputeContentHash()
+uint64_t AssetPreprocessor::ComputeObjectContentHash(
+	const AssetPath &path,
+	Asset* pObject,
+	DynamicArray< AssetPath >& rDependencies )
+{
+	HELIUM_ASSERT( pObject );
 
-	sourceFilePath += baseResourcePath.ToFilePathString().GetData();
+	uint64_t hash = StableHash64( &sm_Version, sizeof( sm_Version ) );
 
-	Helium::Status stat;
-	stat.Read( sourceFilePath.Data() );
+	rDependencies.Resize( 0 );
 
-	int64_t sourceFileTimestamp = stat.m_ModifiedTime;
-	int64_t assetFileTimestamp = AssetLoader::GetAssetFileTimestamp( baseResourcePath );
+	DynamicArray< uint8_t > objectBuffer;
+	Asset* pHashObject = pObject;
+	do
+	{
+		objectBuffer.Resize( 0 );
+		Cache::WriteCacheObjectToBuffer( pHashObject, objectBuffer, ( pHashObject == pObject ? &rDependencies : NULL ) );
+		hash = StableHash64( hash, objectBuffer.GetData(), objectBuffer.GetSize() );
 
-	int64_t timestamp = Max( assetFileTimestamp, sourceFileTimestamp );
+		pHashObject = Reflect::AssertCast< Asset >( pHashObject->GetTemplate() );
+	} while( pHashObject && !pHashObject->IsDefaultTemplate() );
 
-	// Check if data is loaded for each supported platform, attempting to load the data from the cache if it exists
-	// and is up-to-date.
-	size_t platformIndex;
-	for( platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	Resource* pResource = ( !pObject->IsDefaultTemplate() ? Reflect::SafeCast< Resource >( pObject ) : NULL );
+	if( pResource )
 	{
-		// Skip platforms for which we don't have preprocessing support.
-		PlatformPreprocessor* pPreprocessor = m_pPlatformPreprocessors[ platformIndex ];
-		if( !pPreprocessor )
+		FilePath sourceFilePath;
+		if( GetResourceSourceFilePath( path, pResource, sourceFilePath ) )
 		{
-			continue;
+			hash = UpdateContentHash( hash, sourceFilePath );
 		}
+	}
 
-		// Check if we already have loaded resource data.
-		const Resource::PreprocessedData& rPreprocessedData = pResource->GetPreprocessedData(
-			static_cast< Cache::EPlatform >( platformIndex ) );
-		if( rPreprocessedData.bLoaded )
+	return hash;
+}
+
+/// Get the content hash stored with the cached data of an object.
+///
+/// The same content hash is stored for every platform, so this checks the cache of the first platform with a
+/// registered preprocessor.
+///
+/// @param[in] objectPath  Asset path.
+///
+/// @return  Stored content hash, or zero if the object is not cached.
+uint64_t AssetPreprocessor::GetCachedContentHash( const AssetPath &objectPath )
+{
+	CacheManager* pCacheManager = CacheManager::GetInstance();
+	HELIUM_ASSERT( pCacheManager );
+
+	for( size_t platformIndex = 0; platformIndex < HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ); ++platformIndex )
+	{
+		if( !m_pPlatformPreprocessors[ platformIndex ] )
 		{
 			continue;
 		}
 
-		// Retrieve the timestamp of the cached data using the object cache.
-		AssetLoader* pAssetLoader = AssetLoader::GetInstance();
-		HELIUM_ASSERT( pAssetLoader );
-
-		CacheManager* pCacheManager = CacheManager::GetInstance();
-		HELIUM_ASSERT( pCacheManager );
-
 		Cache* pCache = pCacheManager->GetCache(
-			Name( HELIUM_ASSET_CACHE_NAME ),
+			GetObjectCacheName( objectPath ),
 			static_cast< Cache::EPlatform >( platformIndex ) );
 		HELIUM_ASSERT( pCache );
 		pCache->EnforceTocLoad();
 
-		const Cache::Entry* pCacheEntry = pCache->FindEntry( resourcePath, 0 );
-		if( !pCacheEntry || pCacheEntry->timestamp != timestamp )
-		{
-			HELIUM_TRACE(
-				TraceLevels::Info,
-				"AssetPreprocessor::LoadResourceData(): Cached resource data not found or is out-of-date for resource \"%s\".  Resource will be preprocessed.\n",
-				*resourcePath.ToString() );
+		const Cache::Entry* pEntry = pCache->FindEntry( objectPath, 0 );
 
-			break;
-		}
+		return ( pEntry ? pEntry->contentHash : 0 );
+	}
 
-		// Cached data should be up-to-date, so attempt to load the data from the cache.
-		if( !LoadCachedResourceData( resourcePath, pResource, static_cast< Cache::EPlatform >( platformIndex ) ) )
+	return 0;
+}
+
+/// Fold the content hashes of an object's dependencies into the content hash computed for it by CacheObjects().
+///
+/// Dependencies in the same batch are resolved first, and their new content hashes used in place of any stored in the
+/// cache.  Other dependencies, as well as dependencies that reference the object in turn, use the content hash stored
+/// in the cache, as in ComputeContentHash().
+///
+/// @param[in,out] rTasks        Prepared tasks for all objects in the batch.
+/// @param[in]     rTaskIndices  Index of the task for each object in the batch.
+/// @param[in]     taskIndex     Index of the task to resolve.
+/// @param[in,out] rTaskOrder    Task indices, appended to as each task is resolved (dependencies first).
+void AssetPreprocessor::ResolveContentHash(
+	DynamicArray< PrepareObjectTask >& rTasks,
+	const HashMap< AssetPath, size_t >& rTaskIndices,
+	size_t taskIndex,
+	DynamicArray< size_t >& rTaskOrder )
+{
+	PrepareObjectTask& rTask = rTasks[ taskIndex ];
+	if( rTask.bHashResolved || rTask.bHashResolving )
+	{
+		return;
+	}
+
+	rTask.bHashResolving = true;
+
+	const AssetPath& rObjectPath = rTask.pRequest->objectPath;
+	uint64_t hash = rTask.contentHash;
+
+	size_t dependencyCount = rTask.dependencies.GetSize();
+	for( size_t dependencyIndex = 0; dependencyIndex < dependencyCount; ++dependencyIndex )
+	{
+		const AssetPath& rDependencyPath = rTask.dependencies[ dependencyIndex ];
+		if( rDependencyPath == rObjectPath )
 		{
-			HELIUM_TRACE(
-				TraceLevels::Warning,
-				"AssetPreprocessor::LoadResourceData(): Failed to load cached resource data for \"%s\".  Resource will be preprocessed again.\n",
-				*resourcePath.ToString() );
+			continue;
+		}
 
-			break;
+		const PrepareObjectTask* pDependencyTask = NULL;
+
+		HashMap< AssetPath, size_t >::ConstIterator taskIterator = rTaskIndices.Find( rDependencyPath );
+		if( taskIterator != rTaskIndices.End() )
+		{
+			ResolveContentHash( rTasks, rTaskIndices, taskIterator->Second(), rTaskOrder );
+			pDependencyTask = &rTasks[ taskIterator->Second() ];
 		}
+
+		uint64_t dependencyHash =
+			( pDependencyTask && pDependencyTask->bHashResolved
+			? pDependencyTask->contentHash
+			: GetCachedContentHash( rDependencyPath ) );
+
+		hash = StableHash64( hash, &dependencyHash, sizeof( dependencyHash ) );
 	}
 
-	if( platformIndex >= HELIUM_ARRAY_COUNT( m_pPlatformPreprocessors ) )
+	rTask.contentHash = ( hash != 0 ? hash : 1 );
+	rTask.bHashResolving = false;
+	rTask.bHashResolved = true;
+
+	rTaskOrder.Push( taskIndex );
+}
+
+/// Get the path of the source asset file for a resource.
+///
+/// This is the file of the resource that extends the default template (i.e. test.png, which would have
+/// Helium::Texture2D as its template), which may be a template of the given resource.
+///
+/// @param[in]  resourcePath     Path of the resource.
+/// @param[in]  pResource        Resource.
+/// @param[out] rSourceFilePath  Source asset file path.
+///
+/// @return  True if the path was determined successfully, false if not.
+bool AssetPreprocessor::GetResourceSourceFilePath(
+	const AssetPath &resourcePath,
+	Resource* pResource,
+	FilePath& rSourceFilePath )
+{
+	HELIUM_ASSERT( pResource );
+
+	Resource* pSourceResource = pResource;
+	Asset* pTestTemplate = Reflect::AssertCast< Asset >( pResource->GetTemplate() );
+	while( pTestTemplate && !pTestTemplate->IsDefaultTemplate() )
 	{
-		// All supported platforms loaded successfully, so nothing else needs to be done.
-		return;
+		pSourceResource = Reflect::AssertCast< Resource >( pTestTemplate );
+		pTestTemplate = Reflect::AssertCast< Asset >( pSourceResource->GetTemplate() );
 	}
 
-	// Preprocess all resources for each supported platform.
-	if( !PreprocessResource( resourcePath, pResource, String( sourceFilePath.Data() ) ) )
+	AssetPath parentPath = pSourceResource == pResource ? resourcePath : pSourceResource->GetPath();
+	AssetPath baseResourcePath;
+	do
+	{
+		baseResourcePath = parentPath;
+		parentPath = parentPath.GetParent();
+	} while( !parentPath.IsEmpty() && !parentPath.IsPackage() );
+
+	if ( !FileLocations::GetDataDirectory( rSourceFilePath ) )
 	{
 		HELIUM_TRACE(
 			TraceLevels::Error,
-			"AssetPreprocessor::LoadResourceData(): Preprocessing of resource \"%s\" failed.\n",
-			*resourcePath.ToString() );
-	}
+			"AssetPreprocessor::GetResourceSourceFilePath(): Could not retrieve data directory.\n" );
 
-#else  // HELIUM_TOOLS
+		return false;
+	}
 
-	HELIUM_UNREF( pResource );
+	rSourceFilePath += baseResourcePath.ToFilePathString().GetData();
 
-#endif  // HELIUM_TOOLS
+	return true;
 }
 
-
-#if HELIUM_TOOLS
-
 /// Load the persistent resource data for the specified resource from the object cache.
 ///
 /// @param[in]  resourcePath           FilePath of the resource object.
@@ -505,29 +1362,31 @@ uint32_t AssetPreprocessor::LoadPersistentResourceData(
 		return Invalid< uint32_t >();
 	}
 
-	BufferedStream bufferedStream( pFileStream );
+	// The entry may be stored compressed, so it is read in full before being parsed.
+	DynamicArray< uint8_t > entryData;
+	bool bReadResult = pCache->ReadEntryData( *pCacheEntry, pFileStream, entryData );
+
+	delete pFileStream;
 
-	int64_t seekLocation = bufferedStream.Seek( pCacheEntry->offset, SeekOrigins::Begin );
-	if( static_cast< uint64_t >( seekLocation ) != pCacheEntry->offset )
+	if( !bReadResult )
 	{
 		HELIUM_TRACE(
 			TraceLevels::Error,
-			"AssetPreprocessor::LoadPersistentResourceData(): Failed to seek to byte offset %" PRIu64 " in cache file \"%s\" for retrieving cached object data for \"%s\".\n",
+			"AssetPreprocessor::LoadPersistentResourceData(): Failed to read cached object data for \"%s\" from byte offset %" PRIu64 " in cache file \"%s\".\n",
+			*resourcePath.ToString(),
 			pCacheEntry->offset,
-			*pCache->GetCacheFileName(),
-			*resourcePath.ToString() );
-
-		bufferedStream.Close();
-		delete pFileStream;
+			*pCache->GetCacheFileName() );
 
 		return Invalid< uint32_t >();
 	}
 
-	ByteSwappingStream byteSwapStream( &bufferedStream );
+	StaticMemoryStream entryStream( entryData.GetData(), entryData.GetSize() );
+
+	ByteSwappingStream byteSwapStream( &entryStream );
 	Stream* pReadStream =
 		( pPreprocessor->SwapBytes()
 		? static_cast< Stream* >( &byteSwapStream )
-		: static_cast< Stream* >( &bufferedStream ) );
+		: static_cast< Stream* >( &entryStream ) );
 
 	uint32_t propertyDataSize = 0;
 	size_t readCount = pReadStream->Read( &propertyDataSize, sizeof( propertyDataSize ), 1 );
@@ -539,10 +1398,6 @@ uint32_t AssetPreprocessor::LoadPersistentResourceData(
 			*resourcePath.ToString(),
 			*pCache->GetCacheFileName() );
 
-		byteSwapStream.Close();
-		bufferedStream.Close();
-		delete pFileStream;
-
 		return Invalid< uint32_t >();
 	}
 
@@ -565,28 +1420,18 @@ uint32_t AssetPreprocessor::LoadPersistentResourceData(
 			"AssetPreprocessor::LoadPersistentResourceData(): Property data stream for \"%s\" is not large enough to provide the resource sub-data count.\n",
 			*resourcePath.ToString() );
 
-		byteSwapStream.Close();
-		bufferedStream.Close();
-		delete pFileStream;
-
 		return Invalid< uint32_t >();
 	}
 
-	uint64_t newOffset = pCacheEntry->offset + sizeof( propertyDataSize ) + propertyDataSize;
-	seekLocation = bufferedStream.Seek( newOffset, SeekOrigins::Begin );
-	if( static_cast< uint64_t >( seekLocation ) != newOffset )
+	int64_t newOffset = static_cast< int64_t >( sizeof( propertyDataSize ) + propertyDataSize );
+	int64_t seekLocation = entryStream.Seek( newOffset, SeekOrigins::Begin );
+	if( seekLocation != newOffset )
 	{
 		HELIUM_TRACE(
 			TraceLevels::Error,
-			"AssetPreprocessor::LoadPersistentResourceData(): Failed to seek to byte offset %" PRIu64 " in cache file \"%s\" for the cached persistent resource data for \"%s\".\n",
-			newOffset,
-			*pCache->GetCacheFileName(),
+			"AssetPreprocessor::LoadPersistentResourceData(): Failed to seek to the cached persistent resource data for \"%s\".\n",
 			*resourcePath.ToString() );
 
-		byteSwapStream.Close();
-		bufferedStream.Close();
-		delete pFileStream;
-
 		return Invalid< uint32_t >();
 	}
 
@@ -596,15 +1441,14 @@ uint32_t AssetPreprocessor::LoadPersistentResourceData(
 	rPersistentDataBuffer.Reserve( resourceDataStreamSize );
 	rPersistentDataBuffer.Resize( resourceDataStreamSize );
 
-	size_t bytesRead = bufferedStream.Read( rPersistentDataBuffer.GetData(), 1, resourceDataStreamSize );
+	size_t bytesRead = entryStream.Read( rPersistentDataBuffer.GetData(), 1, resourceDataStreamSize );
 	if( bytesRead != resourceDataStreamSize )
 	{
 		HELIUM_TRACE(
 			TraceLevels::Warning,
-			"AssetPreprocessor::LoadPersistentResourceData(): Attempted to load %" PRIuSZ " bytes from offset %" PRIu64 " in cache file \"%s\", but only %" PRIuSZ " bytes could be read.\n",
+			"AssetPreprocessor::LoadPersistentResourceData(): Attempted to load %" PRIuSZ " bytes of persistent resource data for \"%s\", but only %" PRIuSZ " bytes could be read.\n",
 			resourceDataStreamSize,
-			newOffset,
-			*pCache->GetCacheFileName(),
+			*resourcePath.ToString(),
 			bytesRead );
 
 		rPersistentDataBuffer.Resize( bytesRead );
@@ -613,7 +1457,7 @@ uint32_t AssetPreprocessor::LoadPersistentResourceData(
 	rPersistentDataBuffer.Trim();
 
 	uint32_t subDataCount = 0;
-	readCount = bufferedStream.Read( &subDataCount, sizeof( subDataCount ), 1 );
+	readCount = entryStream.Read( &subDataCount, sizeof( subDataCount ), 1 );
 	if( readCount != 1 )
 	{
 		HELIUM_TRACE(
@@ -622,10 +1466,6 @@ uint32_t AssetPreprocessor::LoadPersistentResourceData(
 			*resourcePath.ToString() );
 	}
 
-	byteSwapStream.Close();
-	bufferedStream.Close();
-	delete pFileStream;
-
 	return subDataCount;
 }
 #endif  // HELIUM_TOOLS
@@ -757,12 +1597,14 @@ bool AssetPreprocessor::LoadCachedResourceData( const AssetPath &path, Resource*
 				return false;
 			}
 
-			int64_t newOffset = pFileStream->Seek( pResourceCacheEntry->offset, SeekOrigins::Begin );
-			if( static_cast< uint64_t >( newOffset ) != pResourceCacheEntry->offset )
+			// Sub-data may be stored compressed, in which case it is decompressed as it is read.
+			DynamicArray< uint8_t >& rSubData = rSubDataBuffers[ subDataIndex ];
+			if( !pResourceCache->ReadEntryData( *pResourceCacheEntry, pFileStream, rSubData ) )
 			{
 				HELIUM_TRACE(
 					TraceLevels::Error,
-					"AssetPreprocessor::LoadCachedResourceData(): Failed to seek to offset %" PRIu64 " in cache \"%s\" when loading sub-data %" PRIu32 " of resource \"%s\".\n",
+					"AssetPreprocessor::LoadCachedResourceData(): Failed to read %" PRIu32 " bytes from offset %" PRIu64 " in cache \"%s\" for sub-data %" PRIu32 " of resource \"%s\".\n",
+					pResourceCacheEntry->size,
 					pResourceCacheEntry->offset,
 					*resourceCacheName,
 					subDataIndex,
@@ -773,29 +1615,7 @@ bool AssetPreprocessor::LoadCachedResourceData( const AssetPath &path, Resource*
 				return false;
 			}
 
-			uint32_t subDataSize = pResourceCacheEntry->size;
-
-			DynamicArray< uint8_t >& rSubData = rSubDataBuffers[ subDataIndex ];
-			rSubData.Reserve( subDataSize );
-			rSubData.Resize( subDataSize );
 			rSubData.Trim();
-
-			size_t bytesRead = pFileStream->Read( rSubData.GetData(), 1, subDataSize );
-			if( bytesRead != subDataSize )
-			{
-				HELIUM_TRACE(
-					TraceLevels::Error,
-					"AssetPreprocessor::LoadCachedResourceData(): Failed to read %" PRIu32 " bytes from cache \"%s\" for sub-data %" PRIu32 " of resource \"%s\" (only %" PRIuSZ " bytes read).\n",
-					subDataSize,
-					*resourceCacheName,
-					subDataIndex,
-					*path.ToString(),
-					bytesRead );
-
-				delete pFileStream;
-
-				return false;
-			}
 		}
 
 		delete pFileStream;
@@ -7,6 +7,7 @@
 namespace Helium
 {
     class Asset;
+    class LoadTrace;
     class Resource;
     class PlatformPreprocessor;
 
@@ -14,15 +15,38 @@ namespace Helium
     class HELIUM_PC_SUPPORT_API AssetPreprocessor : NonCopyable
     {
     public:
+        /// Preprocessor version number.  This is included in the content hash of every cached object, so incrementing
+        /// it forces all objects and resources to be recached.
+        static const uint32_t sm_Version;
+
+        /// Maximum number of paths stored in the dependency manifest of a cached object.
+        static const size_t DEPENDENCY_MANIFEST_PATH_COUNT_MAX = 256;
+
         /// @name Platform Preprocessor Registration
         //@{
         void SetPlatformPreprocessor( Cache::EPlatform platform, PlatformPreprocessor* pPreprocessor );
         inline PlatformPreprocessor* GetPlatformPreprocessor( Cache::EPlatform platform ) const;
         //@}
 
+        /// Object caching request for CacheObjects().
+        struct CacheObjectRequest
+        {
+            /// Asset path.
+            AssetPath objectPath;
+            /// Asset to cache.
+            Asset* pObject;
+            /// Asset timestamp.
+            int64_t timestamp;
+        };
+
         /// @name Asset Caching
         //@{
         bool CacheObject( const AssetPath &objectPath, Asset* pObject, int64_t timestamp, bool bEvictPlatformPreprocessedResourceData = true );
+        bool CacheObjects(
+            const CacheObjectRequest* pRequests, size_t requestCount, bool bEvictPlatformPreprocessedResourceData = true );
+
+        inline void SetCacheCompression( Compression::EType compression );
+        inline Compression::EType GetCacheCompression() const;
         //@}
 
         /// @name Resource Preprocessing
@@ -30,6 +54,11 @@ namespace Helium
         void LoadResourceData( const AssetPath &path, Resource* pResource );
         //@}
 
+        /// @name Cache Layout Optimization
+        //@{
+        bool OptimizeCacheLayouts( const LoadTrace& rTrace, bool bBundle = false );
+        //@}
+
         /// @name Static Access
         //@{
         static AssetPreprocessor* GetInstance();
@@ -38,8 +67,51 @@ namespace Helium
        //@}
 
     private:
+#if HELIUM_TOOLS
+        /// Per-object work run by CacheObjects() before caching the object for each platform.
+        struct PrepareObjectTask
+        {
+            /// Owning preprocessor.
+            AssetPreprocessor* pPreprocessor;
+            /// Object caching request.
+            const CacheObjectRequest* pRequest;
+            /// Content hash of the object.  This only covers the object itself once the task has run, and includes
+            /// the content hashes of its dependencies once resolved by CacheObjects().
+            uint64_t contentHash;
+            /// Objects referenced directly by the object.
+            DynamicArray< AssetPath > dependencies;
+            /// Index of the first PlatformCacheTask for the object.
+            size_t firstCacheTaskIndex;
+            /// True if the resource data for the object should be loaded by this task.
+            bool bLoadResourceData;
+            /// True while the content hash is being resolved.
+            bool bHashResolving;
+            /// True once the content hash has been resolved.
+            bool bHashResolved;
+            /// True if any platform cache was updated for the object.
+            bool bUpdatedCache;
+        };
+
+        /// Work run by CacheObjects() to cache a single object for a single platform.
+        struct PlatformCacheTask
+        {
+            /// Prepared object to cache.
+            PrepareObjectTask* pPrepareTask;
+            /// Target platform.
+            Cache::EPlatform platform;
+            /// True to evict the preprocessed resource data after caching.
+            bool bEvictPlatformPreprocessedResourceData;
+            /// True if the platform cache was updated.
+            bool bUpdatedCache;
+            /// True if caching was successful.
+            bool bSuccess;
+        };
+#endif
+
         /// Platform-specific preprocessing support.
         PlatformPreprocessor* m_pPlatformPreprocessors[ Cache::PLATFORM_MAX ];
+        /// Format in which to store cached object data and resource sub-data.
+        Compression::EType m_cacheCompression;
 
         /// Singleton instance.
         static AssetPreprocessor* sm_pInstance;
@@ -58,6 +130,29 @@ namespace Helium
 
         uint32_t LoadPersistentResourceData(
             AssetPath resourcePath, Cache::EPlatform platform, DynamicArray< uint8_t >& rPersistentDataBuffer );
+
+        uint64_t ComputeContentHash( const AssetPath &path, Asset* pObject );
+        uint64_t ComputeObjectContentHash(
+            const AssetPath &path, Asset* pObject, DynamicArray< AssetPath >& rDependencies );
+        uint64_t GetCachedContentHash( const AssetPath &objectPath );
+        void ResolveContentHash(
+            DynamicArray< PrepareObjectTask >& rTasks, const HashMap< AssetPath, size_t >& rTaskIndices,
+            size_t taskIndex, DynamicArray< size_t >& rTaskOrder );
+        bool GetResourceSourceFilePath( const AssetPath &resourcePath, Resource* pResource, FilePath& rSourceFilePath );
+
+        Name GetObjectCacheName( const AssetPath &objectPath );
+        void BuildDependencyManifest(
+            const AssetPath &objectPath, Cache* pCache, DynamicArray< AssetPath >& rDependencies );
+        void CacheDependencyManifest(
+            const AssetPath &objectPath, Cache* pCache, DynamicArray< AssetPath >& rDependencies, int64_t timestamp,
+            uint64_t contentHash );
+        bool CacheObjectForPlatform(
+            const AssetPath &objectPath, Asset* pObject, int64_t timestamp, uint64_t contentHash,
+            Cache::EPlatform platform, bool bEvictPlatformPreprocessedResourceData, bool bCacheDependencyManifest,
+            bool& rbUpdatedCache );
+
+        static void RunPrepareObjectTask( void* pData );
+        static void RunPlatformCacheTask( void* pData );
 #endif
         //@}
     };
@@ -13,4 +13,30 @@ namespace Helium
 
         return m_pPlatformPreprocessors[ platform ];
     }
+
+    /// Set the format in which cached object data and resource sub-data is stored.
+    ///
+    /// Compressed entries are smaller on disk and take less time to read, at the expense of being decompressed on the
+    /// AsyncLoader worker threads at load time.  This only affects entries cached after it is set.  Entries that do
+    /// not shrink when compressed are always stored uncompressed.
+    ///
+    /// @param[in] compression  Compression format.
+    ///
+    /// @see GetCacheCompression()
+    void AssetPreprocessor::SetCacheCompression( Compression::EType compression )
+    {
+        HELIUM_ASSERT( static_cast< size_t >( compression ) < static_cast< size_t >( Compression::TYPE_MAX ) );
+
+        m_cacheCompression = compression;
+    }
+
+    /// Get the format in which cached object data and resource sub-data is stored.
+    ///
+    /// @return  Compression format.
+    ///
+    /// @see SetCacheCompression()
+    Compression::EType AssetPreprocessor::GetCacheCompression() const
+    {
+        return m_cacheCompression;
+    }
 }
@@ -0,0 +1,376 @@
+#include "PcSupport/AssetPreprocessor.h"
+
+#include "Foundation/FilePath.h"
+#include "Reflect/Registry.h"
+#include "Reflect/TranslatorDeduction.h"
+#include "Persist/Archive.h"
+#include "Engine/Asset.h"
+#include "Engine/AsyncLoader.h"
+#include "Engine/CacheManager.h"
+#include "Engine/FileLocations.h"
+#include "Engine/Resource.h"
+#include "EngineJobs/JobManager.h"
+#include "PcSupport/PlatformPreprocessor.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if HELIUM_OS_LINUX
+
+#include <ftw.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+namespace AssetPreprocessorTests
+{
+	/// Asset with a value to edit and a reference to another asset.
+	class TestAsset : public Helium::Asset
+	{
+		HELIUM_DECLARE_ASSET( TestAsset, Asset );
+		static void PopulateMetaType( Helium::Reflect::MetaStruct& comp );
+
+	public:
+		TestAsset();
+
+		virtual void PostSave();
+
+		int32_t m_Value;
+		Helium::AssetPtr m_Reference;
+
+		/// Number of times the asset has been written to the cache.
+		uint32_t m_CacheCount;
+	};
+	typedef Helium::StrongPtr< TestAsset > TestAssetPtr;
+
+	/// Resource backed by a source file in the data directory.
+	class TestResource : public Helium::Resource
+	{
+		HELIUM_DECLARE_ASSET( TestResource, Resource );
+
+	public:
+		TestResource();
+
+		virtual void PostSave();
+
+		/// Number of times the resource has been written to the cache.
+		uint32_t m_CacheCount;
+	};
+	typedef Helium::StrongPtr< TestResource > TestResourcePtr;
+}
+
+using namespace Helium;
+using namespace AssetPreprocessorTests;
+
+HELIUM_IMPLEMENT_ASSET( AssetPreprocessorTests::TestAsset, PcSupportTests, 0 );
+
+void TestAsset::PopulateMetaType( Reflect::MetaStruct& comp )
+{
+	comp.AddField( &TestAsset::m_Value, "m_Value" );
+	comp.AddField( &TestAsset::m_Reference, "m_Reference" );
+}
+
+TestAsset::TestAsset()
+	: m_Value( 0 )
+	, m_CacheCount( 0 )
+{
+}
+
+void TestAsset::PostSave()
+{
+	Asset::PostSave();
+	++m_CacheCount;
+}
+
+HELIUM_IMPLEMENT_ASSET( AssetPreprocessorTests::TestResource, PcSupportTests, 0 );
+
+TestResource::TestResource()
+	: m_CacheCount( 0 )
+{
+}
+
+void TestResource::PostSave()
+{
+	Resource::PostSave();
+	++m_CacheCount;
+}
+
+namespace
+{
+	/// Platform preprocessor for tests that do not compile shaders.
+	class TestPlatformPreprocessor : public PlatformPreprocessor
+	{
+	public:
+		virtual EByteOrder GetByteOrder() const
+		{
+			return BYTE_ORDER_LITTLE;
+		}
+
+		virtual size_t GetShaderProfileCount() const
+		{
+			return 0;
+		}
+
+		virtual bool CompileShader(
+			const FilePath& /*rShaderPath*/, size_t /*profileIndex*/, RShader::EType /*type*/,
+			const void* /*pShaderCode*/, size_t /*shaderCodeSize*/, const ShaderToken* /*pTokens*/,
+			size_t /*tokenCount*/, DynamicArray< uint8_t >& /*rCompiledCode*/,
+			DynamicArray< String >* /*pErrorMessages*/ )
+		{
+			return false;
+		}
+
+		virtual bool FillShaderReflectionData(
+			size_t /*profileIndex*/, const void* /*pCompiledCode*/, size_t /*compiledCodeSize*/,
+			DynamicArray< ShaderConstantBufferInfo >& /*rConstantBuffers*/,
+			DynamicArray< ShaderSamplerInfo >& /*rSamplers*/, DynamicArray< ShaderTextureInfo >& /*rTextures*/ )
+		{
+			return false;
+		}
+	};
+
+	/// Base directory holding the data and cache directories used by the tests.
+	char g_BaseDirectory[ 256 ];
+
+	int RemoveDirectoryEntry( const char* pPath, const struct stat* /*pStat*/, int /*type*/, struct FTW* /*pFtw*/ )
+	{
+		return remove( pPath );
+	}
+
+	class AssetPreprocessorTest : public testing::Test
+	{
+	protected:
+		PackagePtr m_spPackage;
+
+		static void SetUpTestCase()
+		{
+			strcpy( g_BaseDirectory, "/tmp/AssetPreprocessorTests.XXXXXX" );
+			ASSERT_TRUE( mkdtemp( g_BaseDirectory ) != NULL );
+
+			char dataDirectory[ 512 ];
+			snprintf( dataDirectory, sizeof( dataDirectory ), "%s/Data", g_BaseDirectory );
+			ASSERT_EQ( 0, mkdir( dataDirectory, 0700 ) );
+
+			FileLocations::SetBaseDirectory( FilePath( std::string( g_BaseDirectory ) + "/" ) );
+
+			// Same order as the editor uses when opening a project.
+			AsyncLoader::Startup();
+			CacheManager::Startup();
+			Reflect::Startup();
+			Persist::Startup();
+			AssetPreprocessor::Startup();
+
+			AssetPreprocessor* pAssetPreprocessor = AssetPreprocessor::GetInstance();
+			ASSERT_TRUE( pAssetPreprocessor != NULL );
+			pAssetPreprocessor->SetPlatformPreprocessor( Cache::PLATFORM_PC, new TestPlatformPreprocessor );
+		}
+
+		static void TearDownTestCase()
+		{
+			AssetPreprocessor::Shutdown();
+			Persist::Shutdown();
+			Reflect::Shutdown();
+			AssetType::Shutdown();
+			Asset::Shutdown();
+			Reflect::ObjectRefCountSupport::Shutdown();
+			CacheManager::Shutdown();
+			AsyncLoader::Shutdown();
+			FileLocations::Shutdown();
+
+			nftw( g_BaseDirectory, RemoveDirectoryEntry, 16, FTW_DEPTH | FTW_PHYS );
+		}
+
+		void TearDown()
+		{
+			if ( JobManager::GetInstance() )
+			{
+				JobManager::Shutdown();
+			}
+		}
+
+		/// Create the package holding the objects of a test, along with its directory in the data directory.
+		void CreatePackage( const char* pName )
+		{
+			char packageDirectory[ 512 ];
+			snprintf( packageDirectory, sizeof( packageDirectory ), "%s/Data/%s", g_BaseDirectory, pName );
+			ASSERT_EQ( 0, mkdir( packageDirectory, 0700 ) );
+
+			ASSERT_TRUE( Asset::Create< Package >( m_spPackage, Name( pName ), NULL ) );
+		}
+
+		/// Write the source file of a resource in the test package and optionally give it a fixed modification time.
+		void WriteSourceFile( const char* pName, const char* pContents, time_t modTime = 0 )
+		{
+			char path[ 512 ];
+			snprintf( path, sizeof( path ), "%s/Data/%s/%s", g_BaseDirectory, *m_spPackage->GetName(), pName );
+
+			FILE* pFile = fopen( path, "wb" );
+			ASSERT_TRUE( pFile != NULL );
+			fputs( pContents, pFile );
+			fclose( pFile );
+
+			if ( modTime != 0 )
+			{
+				utimbuf times;
+				times.actime = modTime;
+				times.modtime = modTime;
+				ASSERT_EQ( 0, utime( path, &times ) );
+			}
+		}
+
+		/// Cache an object, passing a timestamp in the same way the loose asset loader does.
+		bool CacheObject( Asset* pObject, int64_t timestamp )
+		{
+			AssetPreprocessor* pAssetPreprocessor = AssetPreprocessor::GetInstance();
+			HELIUM_ASSERT( pAssetPreprocessor );
+
+			return pAssetPreprocessor->CacheObject( pObject->GetPath(), pObject, timestamp );
+		}
+	};
+}
+
+TEST_F( AssetPreprocessorTest, TouchingSourceFileDoesNotRecache )
+{
+	CreatePackage( "TouchTest" );
+
+	TestResourcePtr spResource;
+	ASSERT_TRUE( Asset::Create< TestResource >( spResource, Name( "Source.txt" ), m_spPackage ) );
+
+	const time_t firstModTime = 1500000000;
+	WriteSourceFile( "Source.txt", "first contents", firstModTime );
+	ASSERT_TRUE( CacheObject( spResource, firstModTime ) );
+	EXPECT_EQ( 1u, spResource->m_CacheCount );
+
+	// A checkout or touch changes the time stamp but not the contents.
+	const time_t touchedModTime = firstModTime + 3600;
+	WriteSourceFile( "Source.txt", "first contents", touchedModTime );
+	ASSERT_TRUE( CacheObject( spResource, touchedModTime ) );
+	EXPECT_EQ( 1u, spResource->m_CacheCount );
+
+	// Editing the contents recaches even if the time stamp goes backwards.
+	WriteSourceFile( "Source.txt", "second contents", firstModTime );
+	ASSERT_TRUE( CacheObject( spResource, firstModTime ) );
+	EXPECT_EQ( 2u, spResource->m_CacheCount );
+}
+
+TEST_F( AssetPreprocessorTest, EditingDependencyRecachesReferrer )
+{
+	CreatePackage( "DependencyTest" );
+
+	TestAssetPtr spDependency;
+	TestAssetPtr spReferrer;
+	TestAssetPtr spUnrelated;
+	ASSERT_TRUE( Asset::Create< TestAsset >( spDependency, Name( "Dependency" ), m_spPackage ) );
+	ASSERT_TRUE( Asset::Create< TestAsset >( spReferrer, Name( "Referrer" ), m_spPackage ) );
+	ASSERT_TRUE( Asset::Create< TestAsset >( spUnrelated, Name( "Unrelated" ), m_spPackage ) );
+	spDependency->m_Value = 1;
+	spReferrer->m_Reference = spDependency.Get();
+
+	const int64_t timestamp = 1500000000;
+	ASSERT_TRUE( CacheObject( spDependency, timestamp ) );
+	ASSERT_TRUE( CacheObject( spReferrer, timestamp ) );
+	ASSERT_TRUE( CacheObject( spUnrelated, timestamp ) );
+	EXPECT_EQ( 1u, spDependency->m_CacheCount );
+	EXPECT_EQ( 1u, spReferrer->m_CacheCount );
+	EXPECT_EQ( 1u, spUnrelated->m_CacheCount );
+
+	// Nothing changed, so nothing is recached.
+	ASSERT_TRUE( CacheObject( spDependency, timestamp ) );
+	ASSERT_TRUE( CacheObject( spReferrer, timestamp ) );
+	EXPECT_EQ( 1u, spDependency->m_CacheCount );
+	EXPECT_EQ( 1u, spReferrer->m_CacheCount );
+
+	// Editing the dependency recaches it and the object that references it, even though the referrer's own data and
+	// timestamp are unchanged.
+	spDependency->m_Value = 2;
+	ASSERT_TRUE( CacheObject( spDependency, timestamp ) );
+	ASSERT_TRUE( CacheObject( spReferrer, timestamp ) );
+	ASSERT_TRUE( CacheObject( spUnrelated, timestamp ) );
+	EXPECT_EQ( 2u, spDependency->m_CacheCount );
+	EXPECT_EQ( 2u, spReferrer->m_CacheCount );
+	EXPECT_EQ( 1u, spUnrelated->m_CacheCount );
+
+	// The batch path resolves the dependency's new hash before hashing the referrer.
+	spDependency->m_Value = 3;
+
+	AssetPreprocessor::CacheObjectRequest requests[ 2 ];
+	requests[ 0 ].objectPath = spReferrer->GetPath();
+	requests[ 0 ].pObject = spReferrer;
+	requests[ 0 ].timestamp = timestamp;
+	requests[ 1 ].objectPath = spDependency->GetPath();
+	requests[ 1 ].pObject = spDependency;
+	requests[ 1 ].timestamp = timestamp;
+	ASSERT_TRUE( AssetPreprocessor::GetInstance()->CacheObjects( requests, HELIUM_ARRAY_COUNT( requests ) ) );
+	EXPECT_EQ( 3u, spDependency->m_CacheCount );
+	EXPECT_EQ( 3u, spReferrer->m_CacheCount );
+
+	ASSERT_TRUE( AssetPreprocessor::GetInstance()->CacheObjects( requests, HELIUM_ARRAY_COUNT( requests ) ) );
+	EXPECT_EQ( 3u, spDependency->m_CacheCount );
+	EXPECT_EQ( 3u, spReferrer->m_CacheCount );
+}
+
+TEST_F( AssetPreprocessorTest, DuplicateRequestsAreCachedOnceOnJobManager )
+{
+	CreatePackage( "DuplicateTest" );
+
+	JobManager::Startup();
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	// A chain of objects, each referencing the one before it.
+	const size_t objectCount = 32;
+	DynamicArray< TestAssetPtr > objects;
+	char objectName[ 32 ];
+	for ( size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+	{
+		snprintf( objectName, sizeof( objectName ), "Object%u", static_cast< uint32_t >( objectIndex ) );
+		TestAssetPtr spObject;
+		ASSERT_TRUE( Asset::Create< TestAsset >( spObject, Name( objectName ), m_spPackage ) );
+		spObject->m_Value = static_cast< int32_t >( objectIndex );
+		if ( objectIndex != 0 )
+		{
+			spObject->m_Reference = objects[ objectIndex - 1 ].Get();
+		}
+
+		objects.Push( spObject );
+	}
+
+	// Request every object three times, so duplicates would be cached by different workers at once.
+	const int64_t timestamp = 1500000000;
+	DynamicArray< AssetPreprocessor::CacheObjectRequest > requests;
+	for ( size_t passIndex = 0; passIndex < 3; ++passIndex )
+	{
+		for ( size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+		{
+			AssetPreprocessor::CacheObjectRequest* pRequest = requests.New();
+			pRequest->objectPath = objects[ objectIndex ]->GetPath();
+			pRequest->pObject = objects[ objectIndex ];
+			pRequest->timestamp = timestamp;
+		}
+	}
+
+	AssetPreprocessor* pAssetPreprocessor = AssetPreprocessor::GetInstance();
+	ASSERT_TRUE( pAssetPreprocessor->CacheObjects( requests.GetData(), requests.GetSize() ) );
+	for ( size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+	{
+		EXPECT_EQ( 1u, objects[ objectIndex ]->m_CacheCount ) << "Object " << objectIndex;
+	}
+
+	// Editing the last object recaches only it, once.
+	objects[ objectCount - 1 ]->m_Value = -1;
+	ASSERT_TRUE( pAssetPreprocessor->CacheObjects( requests.GetData(), requests.GetSize() ) );
+	for ( size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+	{
+		EXPECT_EQ( objectIndex == objectCount - 1 ? 2u : 1u, objects[ objectIndex ]->m_CacheCount ) << "Object " << objectIndex;
+	}
+
+	// Editing the first object recaches everything that references it, directly or not, once.
+	objects[ 0 ]->m_Value = -1;
+	ASSERT_TRUE( pAssetPreprocessor->CacheObjects( requests.GetData(), requests.GetSize() ) );
+	for ( size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex )
+	{
+		EXPECT_EQ( objectIndex == objectCount - 1 ? 3u : 2u, objects[ objectIndex ]->m_CacheCount ) << "Object " << objectIndex;
+	}
+}
+
+#endif // HELIUM_OS_LINUX
@@ -7,8 +7,45 @@
 #include "Persist/ArchiveJson.h"
 #include "PcSupport/ResourceHandler.h"
 
+#if HELIUM_OS_LINUX
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
 using namespace Helium;
 
+#if HELIUM_OS_LINUX
+// How long to wait for file events before checking whether the thread should stop or start watching new packages
+static const int INOTIFY_POLL_TIMEOUT_MS = 250;
+
+// Events that mean a file in a package directory has finished being written
+static const uint32_t INOTIFY_WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO;
+#endif
+
+namespace
+{
+	/// Holds the watch list lock for the lifetime of the scope.
+	class WatchListScopeLock : NonCopyable
+	{
+	public:
+		explicit WatchListScopeLock( SpinLock &rLock )
+			: m_rLock( rLock )
+		{
+			m_rLock.Lock();
+		}
+
+		~WatchListScopeLock()
+		{
+			m_rLock.Unlock();
+		}
+
+	private:
+		SpinLock &m_rLock;
+	};
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Sleep between runs and yield to other threads
 // The complex loop is to prevent Editor from hanging on exit (max hang will be "increments" seconds)
@@ -33,6 +70,9 @@ inline void SleepBetweenTracking( bool* cancel = NULL, const uint32_t minutes =
 LooseAssetFileWatcher::LooseAssetFileWatcher() 
 : m_StopTracking( false )
 , m_InterruptTracking( 0 )
+#if HELIUM_OS_LINUX
+, m_InotifyHandle( -1 )
+#endif
 {
 
 }
@@ -48,7 +88,7 @@ LooseAssetFileWatcher::~LooseAssetFileWatcher()
 void LooseAssetFileWatcher::AddPackage( LoosePackageLoader *pPackageLoader )
 {
 	AtomicIncrement( m_InterruptTracking );
-	SpinLock lock( m_PathsToWatchLock );
+	WatchListScopeLock lock( m_PathsToWatchLock );
 
 #if HELIUM_ASSERT_ENABLED
 	for ( DynamicArray<WatchedPackage>::Iterator iter = m_PathsToWatch.Begin(); iter != m_PathsToWatch.End(); ++iter )
@@ -61,18 +101,27 @@ void LooseAssetFileWatcher::AddPackage( LoosePackageLoader *pPackageLoader )
 	WatchedPackage *pWatchedPackage = m_PathsToWatch.New();
 	pWatchedPackage->m_Path = pPackageLoader->m_packageDirPath;
 	pWatchedPackage->m_Loader = pPackageLoader;
+#if HELIUM_OS_LINUX
+	pWatchedPackage->m_WatchDescriptor = -1;
+#endif
 	AtomicDecrement( m_InterruptTracking );
 }
 
 void LooseAssetFileWatcher::RemovePackage( LoosePackageLoader *pPackageLoader )
 {
 	AtomicIncrement( m_InterruptTracking );
-	SpinLock lock( m_PathsToWatchLock );
+	WatchListScopeLock lock( m_PathsToWatchLock );
 
 	for ( size_t i = 0; i < m_PathsToWatch.GetSize(); ++i)
 	{
 		if (pPackageLoader == m_PathsToWatch[i].m_Loader)
 		{
+#if HELIUM_OS_LINUX
+			if ( m_InotifyHandle >= 0 && m_PathsToWatch[i].m_WatchDescriptor >= 0 )
+			{
+				inotify_rm_watch( m_InotifyHandle, m_PathsToWatch[i].m_WatchDescriptor );
+			}
+#endif
 			m_PathsToWatch.RemoveSwap(i);
 			break;
 		}
@@ -95,6 +144,15 @@ void LooseAssetFileWatcher::StartThread()
 
 	m_StopTracking = false;
 
+#if HELIUM_OS_LINUX
+	// Prefer change events over scanning; if inotify is unavailable we silently fall back to the scanner
+	m_InotifyHandle = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if ( m_InotifyHandle < 0 )
+	{
+		HELIUM_TRACE( TraceLevels::Warning, "LooseAssetFileWatcher: inotify_init1() failed (errno %d), falling back to scanning.\n", errno );
+	}
+#endif
+
 	Helium::CallbackThread::Entry entry = &Helium::CallbackThread::EntryHelper<LooseAssetFileWatcher, &LooseAssetFileWatcher::TrackEverything>;
 	if ( !m_Thread.Create( entry, this, "LooseAssetFileWatcher Thread", ThreadPriorities::Low ) )
 	{
@@ -109,6 +167,11 @@ void LooseAssetFileWatcher::StopThread()
 	m_StopTracking = true;
 
 	m_Thread.Join();
+
+#if HELIUM_OS_LINUX
+	WatchListScopeLock lock( m_PathsToWatchLock );
+	StopWatching();
+#endif
 }
 
 void LooseAssetFileWatcher::TrackEverything()
@@ -119,151 +182,361 @@ void LooseAssetFileWatcher::TrackEverything()
 
 	while ( !m_StopTracking )
 	{
+		// Do this once outside the inner loop in case we are iterating over nothing
+		assetSync.Sync();
+
+#if HELIUM_OS_LINUX
+		if ( m_InotifyHandle >= 0 )
+		{
+			// Newly added packages get a watch and one full scan, after which only the files named by events are checked
+			WatchPackages();
+			ProcessFileEvents();
+			DispatchNotifications();
+			continue;
+		}
+#endif
+
 		Log::Print( Log::Levels::Default, "Tracker: Scanning packages for changes...\n" );
 
-		// Do this once outside the inner loop in case we are iterating over nothing
+		ScanPackages( assetSync );
+		DispatchNotifications();
+
+		if ( !m_StopTracking )
+		{
+			// Sleep between runs and yield to other threads
+			// The complex loop is to prevent Editor from hanging on exit (max hang will be "increments" seconds)
+			SleepBetweenTracking( &m_StopTracking );
+		}
+	}
+}
+
+void LooseAssetFileWatcher::ScanPackages( AssetAwareThreadSynchronizer &assetSync )
+{
+	WatchListScopeLock lock( m_PathsToWatchLock );
+
+	// Go through all the packages we're tracking
+	for ( DynamicArray<WatchedPackage>::Iterator packageIter = m_PathsToWatch.Begin(); packageIter != m_PathsToWatch.End(); ++packageIter )
+	{
 		assetSync.Sync();
 
+		ScanPackage( *packageIter );
+
+		if ( m_StopTracking || m_InterruptTracking != 0 )
 		{
-			SpinLock lock( m_PathsToWatchLock );
+			// Our thread is supposed to die, bail early
+			break;
+		}
+	}
+}
 
-			// Go through all the packages we're tracking
-			for ( DynamicArray<WatchedPackage>::Iterator packageIter = m_PathsToWatch.Begin(); packageIter != m_PathsToWatch.End(); ++packageIter )
-			{
-				assetSync.Sync();
+void LooseAssetFileWatcher::ScanPackage( WatchedPackage &package )
+{
+	Helium::DirectoryIterator directory( package.m_Path );
+
+	// For each file
+	for( ; !directory.IsDone(); directory.Next() )
+	{
+		// If our thread is supposed to die, bail early
+		if ( m_StopTracking )
+		{
+			break;
+		}
 
-				//Log::Print( Log::Levels::Default, "Tracker: Scanning package %s\n", packageIter->m_Path.c_str() );
+		const DirectoryIteratorItem& item = directory.GetItem();
+		if ( item.m_Path.IsDirectory() )
+		{
+			// Skip directories
+			continue;
+		}
 
-				SimpleTimer packageTimer;
-				Helium::DirectoryIterator directory( packageIter->m_Path );
+		CheckFile( package, item.m_Path, static_cast<int64_t>( item.m_ModTime ) );
+	}
+}
 
-				// For each file
-				for( ; !directory.IsDone(); directory.Next() )
-				{
-					// If our thread is supposed to die, bail early
-					if ( m_StopTracking )
-					{
-						break;
-					}
-
-					const DirectoryIteratorItem& item = directory.GetItem();
-
-					bool isNewFile = true;
-					bool isChangedFile = false;
-
-					Name objectName;
-					size_t objectIndex = Invalid< size_t >();
-
-					if ( item.m_Path.IsDirectory() )
-					{
-						// Skip directories
-						continue;
-					}
-					else if ( item.m_Path.Extension() == "json" )
-					{
-						// JSON files get handled special
-						objectName.Set( item.m_Path.Basename().c_str() );
-						objectIndex = packageIter->m_Loader->FindObjectByName( objectName );
-					}
-					else
-					{
-						// See if it's a raw asset that we can handle
-						String objectNameString( item.m_Path.Filename().Data() );
-
-						ResourceHandler* pBestHandler = ResourceHandler::GetBestResourceHandlerForFile( objectNameString );
-
-						if (!pBestHandler)
-						{
-							// We don't know what this file is.. skip it
-							continue;
-						}
-
-						objectName.Set( item.m_Path.Filename().Data() );
-						objectIndex = packageIter->m_Loader->FindObjectByName( objectName );
-					}
-
-					// If the package says it loaded something as fresh as the file, do nothing
-					if ( objectIndex != Invalid< size_t >() &&
-						packageIter->m_Loader->m_objects[objectIndex].fileTimeStamp >= static_cast<int64_t>( directory.GetItem().m_ModTime ))
-					{
-						continue;
-					}
-
-					// If we have already emitted a message for this object, skip it
-					HashMap< Name, WatchedAsset >::Iterator watchedAssetItr = packageIter->m_Assets.Find( objectName );
-					if (watchedAssetItr != packageIter->m_Assets.End())
-					{
-						if (watchedAssetItr->Second().m_LastMessageTime >= static_cast<int64_t>( directory.GetItem().m_ModTime ) )
-						{
-							// We already emitted a message for this file change, so don't do anything
-							continue;
-						}
-
-						// We've emitted a message, but it's been modified again. Emit another message and update the timestamp
-						watchedAssetItr->Second().m_LastMessageTime = static_cast<int64_t>( directory.GetItem().m_ModTime );
-					}
-					else
-					{
-						// We've never emitted a message, so record that we will
-						WatchedAsset watchedAsset;
-						watchedAsset.m_LastMessageTime = static_cast<int64_t>( directory.GetItem().m_ModTime );
-
-						packageIter->m_Assets.Insert(
-							watchedAssetItr, 
-							KeyValue< Name, WatchedAsset >( objectName, watchedAsset ) );
-					}
-				
-					// We know the file is changed and we should throw an event.. choose a different event based on new vs. changed
-					if (objectIndex != Invalid< size_t >())
-					{
-						m_ChangeNotifications.Add( packageIter->m_Loader->GetAssetPath( objectIndex ) );
-					}
-					else
-					{
-						AssetPath path;
-						path.Set( objectName, false, packageIter->m_Loader->GetPackagePath());
-
-						m_NewNotifications.Add( path );
-					}
-				}
+void LooseAssetFileWatcher::CheckFile( WatchedPackage &package, const FilePath &path, int64_t modTime )
+{
+	Name objectName;
+	size_t objectIndex = Invalid< size_t >();
+
+	if ( path.Extension() == "json" )
+	{
+		// JSON files get handled special
+		objectName.Set( path.Basename().c_str() );
+		objectIndex = package.m_Loader->FindObjectByName( objectName );
+	}
+	else
+	{
+		// See if it's a raw asset that we can handle
+		String objectNameString( path.Filename().Data() );
+
+		ResourceHandler* pBestHandler = ResourceHandler::GetBestResourceHandlerForFile( objectNameString );
+
+		if (!pBestHandler)
+		{
+			// We don't know what this file is.. skip it
+			return;
+		}
+
+		objectName.Set( path.Filename().Data() );
+		objectIndex = package.m_Loader->FindObjectByName( objectName );
+	}
+
+	// If the package says it loaded something as fresh as the file, do nothing
+	if ( objectIndex != Invalid< size_t >() &&
+		package.m_Loader->m_objects[objectIndex].fileTimeStamp >= modTime )
+	{
+		return;
+	}
+
+	// If we have already emitted a message for this object, skip it
+	HashMap< Name, WatchedAsset >::Iterator watchedAssetItr = package.m_Assets.Find( objectName );
+	if (watchedAssetItr != package.m_Assets.End())
+	{
+		if (watchedAssetItr->Second().m_LastMessageTime >= modTime )
+		{
+			// We already emitted a message for this file change, so don't do anything
+			return;
+		}
+
+		// We've emitted a message, but it's been modified again. Emit another message and update the timestamp
+		watchedAssetItr->Second().m_LastMessageTime = modTime;
+	}
+	else
+	{
+		// We've never emitted a message, so record that we will
+		WatchedAsset watchedAsset;
+		watchedAsset.m_LastMessageTime = modTime;
+
+		package.m_Assets.Insert(
+			watchedAssetItr, 
+			KeyValue< Name, WatchedAsset >( objectName, watchedAsset ) );
+	}
+
+	// We know the file is changed and we should throw an event.. choose a different event based on new vs. changed
+	if (objectIndex != Invalid< size_t >())
+	{
+		m_ChangeNotifications.Add( package.m_Loader->GetAssetPath( objectIndex ) );
+	}
+	else
+	{
+		AssetPath assetPath;
+		assetPath.Set( objectName, false, package.m_Loader->GetPackagePath());
+
+		m_NewNotifications.Add( assetPath );
+	}
+}
+
+void LooseAssetFileWatcher::DispatchNotifications()
+{
+	for ( DynamicArray<AssetPath>::Iterator changedAssetIter = m_ChangeNotifications.Begin(); changedAssetIter != m_ChangeNotifications.End(); ++changedAssetIter )
+	{
+		HELIUM_TRACE( TraceLevels::Info, " %s IS MODIFIED\n", *changedAssetIter->ToString());
+		AssetTracker::GetInstance()->NotifyAssetChangedExternally( *changedAssetIter );
+
+		AssetPtr asset;
+		AssetLoader::GetInstance()->LoadObject( *changedAssetIter, asset, true );
+		Asset::ReplaceAsset( asset.Get(), *changedAssetIter );
+
+		e_AssetFileChanged.Raise( AssetFileEventArgs( *changedAssetIter ) );
+	}
+
+	for ( DynamicArray<AssetPath>::Iterator newAssetIter = m_NewNotifications.Begin(); newAssetIter != m_NewNotifications.End(); ++newAssetIter )
+	{
+		HELIUM_TRACE( TraceLevels::Info, " %s IS MODIFIED\n", *newAssetIter->ToString());
+		AssetTracker::GetInstance()->NotifyAssetCreatedExternally( *newAssetIter );
+
+		e_AssetFileCreated.Raise( AssetFileEventArgs( *newAssetIter ) );
+	}
+
+	m_ChangeNotifications.Clear();
+	m_NewNotifications.Clear();
+}
+
+#if HELIUM_OS_LINUX
+
+void LooseAssetFileWatcher::WatchPackages()
+{
+	WatchListScopeLock lock( m_PathsToWatchLock );
+
+	for ( DynamicArray<WatchedPackage>::Iterator packageIter = m_PathsToWatch.Begin(); packageIter != m_PathsToWatch.End(); ++packageIter )
+	{
+		if ( packageIter->m_WatchDescriptor >= 0 )
+		{
+			continue;
+		}
+
+		packageIter->m_WatchDescriptor = inotify_add_watch( m_InotifyHandle, packageIter->m_Path.Data(), INOTIFY_WATCH_MASK );
+		if ( packageIter->m_WatchDescriptor < 0 )
+		{
+			// Running out of watches (see fs.inotify.max_user_watches) would leave packages unmonitored, so go back to
+			// scanning everything instead
+			HELIUM_TRACE(
+				TraceLevels::Warning,
+				"LooseAssetFileWatcher: inotify_add_watch() failed for %s (errno %d), falling back to scanning.\n",
+				packageIter->m_Path.Data(),
+				errno );
+
+			StopWatching();
+			return;
+		}
+
+		// Catch anything that changed before the watch was in place
+		ScanPackage( *packageIter );
+
+		if ( m_StopTracking || m_InterruptTracking != 0 )
+		{
+			break;
+		}
+	}
+}
+
+void LooseAssetFileWatcher::ProcessFileEvents()
+{
+	pollfd pollHandle;
+	pollHandle.fd = m_InotifyHandle;
+	pollHandle.events = POLLIN;
+	pollHandle.revents = 0;
+
+	if ( poll( &pollHandle, 1, INOTIFY_POLL_TIMEOUT_MS ) <= 0 )
+	{
+		return;
+	}
+
+	// Work from a copy of the watched directories so that packages can be added and removed while we stat files
+	DynamicArray<WatchedDirectory> directories;
+	{
+		WatchListScopeLock lock( m_PathsToWatchLock );
+
+		directories.Reserve( m_PathsToWatch.GetSize() );
+		for ( DynamicArray<WatchedPackage>::Iterator packageIter = m_PathsToWatch.Begin(); packageIter != m_PathsToWatch.End(); ++packageIter )
+		{
+			WatchedDirectory *pDirectory = directories.New();
+			pDirectory->m_Path = packageIter->m_Path;
+			pDirectory->m_WatchDescriptor = packageIter->m_WatchDescriptor;
+		}
+	}
+
+	bool rescanAll = false;
+	DynamicArray<ChangedFile> changedFiles;
+
+	// Aligned for struct inotify_event
+	uint64_t buffer[ 1024 ];
+
+	for ( ;; )
+	{
+		ssize_t bytesRead = read( m_InotifyHandle, buffer, sizeof( buffer ) );
+		if ( bytesRead <= 0 )
+		{
+			// EAGAIN once the queue is drained
+			break;
+		}
+
+		const char *pEventData = reinterpret_cast< const char* >( buffer );
+		const char *pEventEnd = pEventData + bytesRead;
+		while ( pEventData < pEventEnd )
+		{
+			const inotify_event *pEvent = reinterpret_cast< const inotify_event* >( pEventData );
+			pEventData += sizeof( inotify_event ) + pEvent->len;
+
+			if ( pEvent->mask & IN_Q_OVERFLOW )
+			{
+				// Events were dropped, so we can no longer trust that we know about every change
+				rescanAll = true;
+				continue;
+			}
 
-				if ( m_StopTracking || m_InterruptTracking != 0 )
+			if ( ( pEvent->mask & IN_ISDIR ) || pEvent->len == 0 )
+			{
+				continue;
+			}
+
+			for ( DynamicArray<WatchedDirectory>::Iterator directoryIter = directories.Begin(); directoryIter != directories.End(); ++directoryIter )
+			{
+				if ( directoryIter->m_WatchDescriptor != pEvent->wd )
 				{
-					// Our thread is supposed to die, bail early
-					//Log::Print( Log::Levels::Default, "Tracker: Pre-empted after %.2fm\n", packageTimer.Elapsed() / 1000.f / 60.f );
-					break;
+					continue;
 				}
-				else 
+
+				FilePath path = directoryIter->m_Path + pEvent->name;
+
+				Status status;
+				if ( status.Read( path.Get().c_str() ) )
 				{
-					//Log::Print( Log::Levels::Default, "Tracker: Package scanned in %.2fm\n" , packageTimer.Elapsed() / 1000.f / 60.f );
+					ChangedFile *pChangedFile = changedFiles.New();
+					pChangedFile->m_Path = path;
+					pChangedFile->m_WatchDescriptor = pEvent->wd;
+					pChangedFile->m_ModTime = status.m_ModifiedTime;
 				}
+
+				break;
 			}
 		}
+	}
+
+	if ( rescanAll )
+	{
+		Log::Print( Log::Levels::Default, "Tracker: File event queue overflowed, scanning packages for changes...\n" );
 
-		for ( DynamicArray<AssetPath>::Iterator changedAssetIter = m_ChangeNotifications.Begin(); changedAssetIter != m_ChangeNotifications.End(); ++changedAssetIter )
+		for ( DynamicArray<WatchedDirectory>::Iterator directoryIter = directories.Begin(); directoryIter != directories.End(); ++directoryIter )
 		{
-			HELIUM_TRACE( TraceLevels::Info, " %s IS MODIFIED\n", *changedAssetIter->ToString());
-			AssetTracker::GetInstance()->NotifyAssetChangedExternally( *changedAssetIter );
+			// Packages without a watch yet get a full scan from WatchPackages() anyway
+			if ( directoryIter->m_WatchDescriptor < 0 )
+			{
+				continue;
+			}
 
-			AssetPtr asset;
-			AssetLoader::GetInstance()->LoadObject( *changedAssetIter, asset, true );
-			Asset::ReplaceAsset( asset.Get(), *changedAssetIter );
-		}
+			for ( Helium::DirectoryIterator directory( directoryIter->m_Path ); !directory.IsDone() && !m_StopTracking; directory.Next() )
+			{
+				const DirectoryIteratorItem& item = directory.GetItem();
+				if ( item.m_Path.IsDirectory() )
+				{
+					continue;
+				}
 
-		for ( DynamicArray<AssetPath>::Iterator newAssetIter = m_NewNotifications.Begin(); newAssetIter != m_NewNotifications.End(); ++newAssetIter )
-		{
-			HELIUM_TRACE( TraceLevels::Info, " %s IS MODIFIED\n", *newAssetIter->ToString());
-			AssetTracker::GetInstance()->NotifyAssetCreatedExternally( *newAssetIter );
+				ChangedFile *pChangedFile = changedFiles.New();
+				pChangedFile->m_Path = item.m_Path;
+				pChangedFile->m_WatchDescriptor = directoryIter->m_WatchDescriptor;
+				pChangedFile->m_ModTime = static_cast<int64_t>( item.m_ModTime );
+			}
 		}
+	}
+
+	if ( changedFiles.IsEmpty() )
+	{
+		return;
+	}
 
-		m_ChangeNotifications.Clear();
-		m_NewNotifications.Clear();
+	WatchListScopeLock lock( m_PathsToWatchLock );
 
-		if ( !m_StopTracking )
+	for ( DynamicArray<ChangedFile>::Iterator fileIter = changedFiles.Begin(); fileIter != changedFiles.End(); ++fileIter )
+	{
+		// Files of packages removed in the meantime are dropped
+		for ( DynamicArray<WatchedPackage>::Iterator packageIter = m_PathsToWatch.Begin(); packageIter != m_PathsToWatch.End(); ++packageIter )
 		{
-			// Sleep between runs and yield to other threads
-			// The complex loop is to prevent Editor from hanging on exit (max hang will be "increments" seconds)
-			SleepBetweenTracking( &m_StopTracking );
+			if ( packageIter->m_WatchDescriptor == fileIter->m_WatchDescriptor )
+			{
+				CheckFile( *packageIter, fileIter->m_Path, fileIter->m_ModTime );
+				break;
+			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+void LooseAssetFileWatcher::StopWatching()
+{
+	if ( m_InotifyHandle < 0 )
+	{
+		return;
+	}
+
+	// Closing the instance removes all of its watches
+	close( m_InotifyHandle );
+	m_InotifyHandle = -1;
+
+	for ( DynamicArray<WatchedPackage>::Iterator packageIter = m_PathsToWatch.Begin(); packageIter != m_PathsToWatch.End(); ++packageIter )
+	{
+		packageIter->m_WatchDescriptor = -1;
+	}
+}
+
+#endif
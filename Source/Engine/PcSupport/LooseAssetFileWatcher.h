@@ -1,9 +1,32 @@
 #pragma once
 
+#include "PcSupport/PcSupport.h"
+
+#include "Platform/Locks.h"
+#include "Platform/Thread.h"
+#include "Foundation/DynamicArray.h"
+#include "Foundation/Event.h"
+#include "Foundation/FilePath.h"
+#include "Foundation/HashMap.h"
+#include "Engine/Asset.h"
+
 namespace Helium
 {
 	class LoosePackageLoader;
 
+	/// Arguments for notifications about asset files written outside of the engine.
+	class AssetFileEventArgs
+	{
+	public:
+		AssetPath m_Path;
+
+		AssetFileEventArgs( const AssetPath &path )
+			: m_Path( path )
+		{
+		}
+	};
+	typedef Helium::Signature< const AssetFileEventArgs& > AssetFileEventSignature;
+
 	class HELIUM_PC_SUPPORT_API LooseAssetFileWatcher
 	{
 	public:
@@ -19,11 +42,21 @@ namespace Helium
 
 		void TrackEverything();
 
+		/// Raised from the watcher thread for files of assets the package did not know about.
+		AssetFileEventSignature::Event e_AssetFileCreated;
+		/// Raised from the watcher thread for files of known assets that have been modified.
+		AssetFileEventSignature::Event e_AssetFileChanged;
+
 	protected:
 		Helium::CallbackThread m_Thread;
 		bool m_StopTracking;
 		volatile int m_InterruptTracking;
 
+#if HELIUM_OS_LINUX
+		/// inotify instance used to receive change events, or -1 if changes are found by scanning.
+		int m_InotifyHandle;
+#endif
+
 		struct WatchedAsset
 		{
 			int64_t m_LastMessageTime;
@@ -33,6 +66,10 @@ namespace Helium
 		{
 			FilePath m_Path;
 			LoosePackageLoader *m_Loader;
+#if HELIUM_OS_LINUX
+			/// inotify watch on the package directory, or -1 if not watched yet.
+			int m_WatchDescriptor;
+#endif
 
 			HashMap< Name, WatchedAsset > m_Assets;
 		};
@@ -42,6 +79,32 @@ namespace Helium
 
 		DynamicArray<AssetPath> m_ChangeNotifications;
 		DynamicArray<AssetPath> m_NewNotifications;
+
+		void ScanPackages( AssetAwareThreadSynchronizer &assetSync );
+		void ScanPackage( WatchedPackage &package );
+		void CheckFile( WatchedPackage &package, const FilePath &path, int64_t modTime );
+		void DispatchNotifications();
+
+#if HELIUM_OS_LINUX
+		/// Package directory being watched, copied out of the watch list while handling file events.
+		struct WatchedDirectory
+		{
+			FilePath m_Path;
+			int m_WatchDescriptor;
+		};
+
+		/// File named by a file event, checked against its package once the watch list is locked again.
+		struct ChangedFile
+		{
+			FilePath m_Path;
+			int m_WatchDescriptor;
+			int64_t m_ModTime;
+		};
+
+		void WatchPackages();
+		void ProcessFileEvents();
+		void StopWatching();
+#endif
 	};
 }
 
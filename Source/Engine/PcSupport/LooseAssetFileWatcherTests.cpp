@@ -0,0 +1,206 @@
+#include "PcSupport/LooseAssetFileWatcher.h"
+
+#include "Platform/Locks.h"
+#include "Platform/Thread.h"
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+#include "Foundation/FilePath.h"
+#include "Engine/AssetLoader.h"
+#include "Engine/Config.h"
+#include "Engine/FileLocations.h"
+#include "PcSupport/LoosePackageLoader.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if HELIUM_OS_LINUX
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Name of the watched package, which lives in the data directory under the test's base directory.
+	const char PACKAGE_NAME[] = "LooseAssetFileWatcherTests";
+	/// Files written by the tests, removed again on tear down.
+	const char* const TEST_FILE_NAMES[] = { "Existing.json", "Created.json", "Moved.json" };
+	/// How long to wait for the watcher thread to report a file, in milliseconds.
+	const float64_t REPORT_TIMEOUT_MS = 10000.0;
+
+	/// Records the assets the watcher reports from its thread.
+	class FileEventListener
+	{
+	public:
+		void OnAssetFileCreated( const AssetFileEventArgs& rArgs )
+		{
+			MutexScopeLock scopeLock( m_lock );
+			m_reportedNames.Push( rArgs.m_Path.GetName() );
+		}
+
+		size_t CountReports( Name name )
+		{
+			MutexScopeLock scopeLock( m_lock );
+
+			size_t reportCount = 0;
+			for ( size_t nameIndex = 0; nameIndex < m_reportedNames.GetSize(); ++nameIndex )
+			{
+				if ( m_reportedNames[ nameIndex ] == name )
+				{
+					++reportCount;
+				}
+			}
+
+			return reportCount;
+		}
+
+	private:
+		Mutex m_lock;
+		DynamicArray< Name > m_reportedNames;
+	};
+
+	class LooseAssetFileWatcherTest : public testing::Test
+	{
+	protected:
+		char m_rootDirectory[ 256 ];
+		char m_dataDirectory[ 256 ];
+		char m_packageDirectory[ 256 ];
+		char m_stagingDirectory[ 256 ];
+
+		LoosePackageLoader m_loader;
+		LooseAssetFileWatcher m_watcher;
+		FileEventListener m_listener;
+
+		void SetUp()
+		{
+			strcpy( m_rootDirectory, "/tmp/LooseAssetFileWatcherTests.XXXXXX" );
+			ASSERT_TRUE( mkdtemp( m_rootDirectory ) != NULL );
+
+			snprintf( m_dataDirectory, sizeof( m_dataDirectory ), "%s/Data", m_rootDirectory );
+			snprintf( m_packageDirectory, sizeof( m_packageDirectory ), "%s/%s", m_dataDirectory, PACKAGE_NAME );
+			snprintf( m_stagingDirectory, sizeof( m_stagingDirectory ), "%s/Staging", m_rootDirectory );
+			ASSERT_EQ( 0, mkdir( m_dataDirectory, 0700 ) );
+			ASSERT_EQ( 0, mkdir( m_packageDirectory, 0700 ) );
+			ASSERT_EQ( 0, mkdir( m_stagingDirectory, 0700 ) );
+
+			FileLocations::SetBaseDirectory( FilePath( std::string( m_rootDirectory ) + "/" ) );
+			Config::Startup();
+			AssetTracker::Startup();
+
+			char packagePath[ 64 ];
+			snprintf( packagePath, sizeof( packagePath ), "/%s", PACKAGE_NAME );
+			AssetPath path;
+			ASSERT_TRUE( path.Set( packagePath ) );
+			ASSERT_TRUE( m_loader.Initialize( path ) );
+
+			m_watcher.e_AssetFileCreated.AddMethod( &m_listener, &FileEventListener::OnAssetFileCreated );
+			m_watcher.AddPackage( &m_loader );
+		}
+
+		void TearDown()
+		{
+			if ( m_watcher.IsThreadRunning() )
+			{
+				m_watcher.StopThread();
+			}
+
+			m_watcher.RemovePackage( &m_loader );
+			m_watcher.e_AssetFileCreated.RemoveMethod( &m_listener, &FileEventListener::OnAssetFileCreated );
+			m_loader.Cleanup();
+
+			AssetTracker::Shutdown();
+			Config::Shutdown();
+			FileLocations::Shutdown();
+
+			char path[ 512 ];
+			for ( size_t nameIndex = 0; nameIndex < HELIUM_ARRAY_COUNT( TEST_FILE_NAMES ); ++nameIndex )
+			{
+				snprintf( path, sizeof( path ), "%s/%s", m_packageDirectory, TEST_FILE_NAMES[ nameIndex ] );
+				unlink( path );
+				snprintf( path, sizeof( path ), "%s/%s", m_stagingDirectory, TEST_FILE_NAMES[ nameIndex ] );
+				unlink( path );
+			}
+
+			rmdir( m_packageDirectory );
+			rmdir( m_dataDirectory );
+			rmdir( m_stagingDirectory );
+			rmdir( m_rootDirectory );
+		}
+
+		void WriteFile( const char* pDirectory, const char* pName )
+		{
+			char path[ 512 ];
+			snprintf( path, sizeof( path ), "%s/%s", pDirectory, pName );
+
+			FILE* pFile = fopen( path, "wb" );
+			ASSERT_TRUE( pFile != NULL );
+			fputs( "{}\n", pFile );
+			fclose( pFile );
+		}
+
+		/// Wait for the watcher thread to report the named asset.
+		///
+		/// @return  True if it was reported before the deadline, false if not.
+		bool WaitForReport( const char* pName )
+		{
+			Name name( pName );
+			uint64_t startTicks = Timer::GetTickCount();
+			while ( m_listener.CountReports( name ) == 0 )
+			{
+				if ( Timer::TicksToMilliseconds( Timer::GetTickCount() - startTicks ) > REPORT_TIMEOUT_MS )
+				{
+					return false;
+				}
+
+				Thread::Sleep( 10 );
+			}
+
+			return true;
+		}
+	};
+}
+
+TEST_F( LooseAssetFileWatcherTest, ReportsFilesPresentWhenThreadStarts )
+{
+	WriteFile( m_packageDirectory, "Existing.json" );
+
+	m_watcher.StartThread();
+	ASSERT_TRUE( m_watcher.IsThreadRunning() );
+
+	EXPECT_TRUE( WaitForReport( "Existing" ) );
+}
+
+TEST_F( LooseAssetFileWatcherTest, ReportsFilesWrittenWhileThreadRuns )
+{
+	m_watcher.StartThread();
+	ASSERT_TRUE( m_watcher.IsThreadRunning() );
+
+	// Whether the file lands before or after the watch is in place, it is reported exactly once.
+	WriteFile( m_packageDirectory, "Created.json" );
+
+	ASSERT_TRUE( WaitForReport( "Created" ) );
+	m_watcher.StopThread();
+	EXPECT_EQ( 1u, m_listener.CountReports( Name( "Created" ) ) );
+}
+
+TEST_F( LooseAssetFileWatcherTest, ReportsFilesMovedIntoPackage )
+{
+	m_watcher.StartThread();
+	ASSERT_TRUE( m_watcher.IsThreadRunning() );
+
+	// Editors commonly save to another file and rename it over the original.
+	WriteFile( m_stagingDirectory, "Moved.json" );
+
+	char stagingPath[ 512 ];
+	char packagePath[ 512 ];
+	snprintf( stagingPath, sizeof( stagingPath ), "%s/Moved.json", m_stagingDirectory );
+	snprintf( packagePath, sizeof( packagePath ), "%s/Moved.json", m_packageDirectory );
+	ASSERT_EQ( 0, rename( stagingPath, packagePath ) );
+
+	EXPECT_TRUE( WaitForReport( "Moved" ) );
+}
+
+#endif // HELIUM_OS_LINUX
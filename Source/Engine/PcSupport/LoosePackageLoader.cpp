@@ -11,6 +11,7 @@
 #include "Engine/Config.h"
 #include "Engine/AssetLoader.h"
 #include "Engine/Resource.h"
+#include "EngineJobs/JobManager.h"
 #include "PcSupport/AssetPreprocessor.h"
 #include "PcSupport/ResourceHandler.h"
 #include "Reflect/TranslatorDeduction.h"
@@ -18,8 +19,22 @@
 
 #include "LooseAssetLoader.h"
 
+#include <algorithm>
+
 using namespace Helium;
 
+/// Sort comparison function for ordering file read requests by file path.
+///
+/// @param[in] rRequest0  First request.
+/// @param[in] rRequest1  Second request.
+///
+/// @return  True if the first request should be sorted before the second, false if not.
+template< typename T >
+static bool FileReadRequestPathLess( const T& rRequest0, const T& rRequest1 )
+{
+	return ( rRequest0.filePath.Get() < rRequest1.filePath.Get() );
+}
+
 /// Constructor.
 LoosePackageLoader::LoosePackageLoader()
 	: m_startPreloadCounter( 0 )
@@ -279,6 +294,8 @@ bool LoosePackageLoader::BeginPreload()
 
 					request->filePath = item.m_Path;
 					request->fileTimestamp = item.m_ModTime;
+					request->bProcessed = false;
+					request->bParsed = false;
 				}
 				else
 				{
@@ -677,10 +694,18 @@ void LoosePackageLoader::TickPreload()
 
 	bool bAllFileRequestsDone = true;
 
-	// Walk through every load request
-	for ( size_t i = 0; i < m_fileReadRequests.GetSize(); )
+	// Gather every request whose file has finished reading since the last tick
+	DynamicArray< size_t > completedRequestIndices;
+
+	size_t requestCount = m_fileReadRequests.GetSize();
+	for ( size_t i = 0; i < requestCount; ++i )
 	{
 		FileReadRequest &rRequest = m_fileReadRequests[i];
+		if ( rRequest.bProcessed )
+		{
+			continue;
+		}
+
 		HELIUM_ASSERT( rRequest.asyncLoadId );
 		HELIUM_ASSERT( rRequest.pLoadBuffer );
 
@@ -689,128 +714,44 @@ void LoosePackageLoader::TickPreload()
 		{
 			// Havn't finished reading yet, move on to next entry
 			bAllFileRequestsDone = false;
-			++i;
 			continue;
 		}
 
+		SetInvalid( rRequest.asyncLoadId );
+
 		HELIUM_ASSERT( bytes_read == rRequest.expectedSize );
 		if ( IsInvalid( bytes_read ) )
 		{
 			HELIUM_TRACE(
 				TraceLevels::Error,
-				"LoosePackageLoader: Failed to read the contents of async load request \"%d\".\n",
-				rRequest.asyncLoadId );
+				"LoosePackageLoader: Failed to read the contents of package file \"%s\".\n",
+				rRequest.filePath.Data() );
 		}
 		else if ( bytes_read != rRequest.expectedSize )
 		{
 			HELIUM_TRACE(
 				TraceLevels::Warning,
-				"LoosePackageLoader: Attempted to read %" PRIuSZ " bytes from package file \"%s\", but only %" PRIuSZ " bytes were read.\n",
+				"LoosePackageLoader: Attempted to read %" PRIu64 " bytes from package file \"%s\", but only %" PRIuSZ " bytes were read.\n",
 				rRequest.expectedSize,
+				rRequest.filePath.Data(),
 				bytes_read );
 		}
 		else
 		{
 			HELIUM_ASSERT( rRequest.expectedSize < ~static_cast<size_t>( 0 ) );
 
-			// the name is deduced from the file name (bad idea to store it in the file)
-			Name name( m_fileReadRequests[i].filePath.Basename().c_str() );
-
-			// read some preliminary data from the json
-			struct PreliminaryObjectHandler : rapidjson::BaseReaderHandler<>
-			{
-				Helium::Name typeName;
-				Helium::String templatePath;
-				bool templateIsNext;
-
-				PreliminaryObjectHandler()
-					: typeName( ENullName() )
-					, templatePath( "" )
-				{
-					templateIsNext = false;
-				}
-
-				bool Key( const Ch* chars, rapidjson::SizeType length, bool copy )
-				{
-					if ( typeName.IsEmpty() )
-					{
-						typeName.Set( Helium::String( chars, length ) );
-						return true;
-					}
-
-					if ( templatePath.IsEmpty() )
-					{
-						Helium::String str( chars, length );
-
-						if ( str == "m_spTemplate" )
-						{
-							templateIsNext = true;
-							return true;
-						}
-					}
-
-					return true;
-				}
-
-				bool String( const Ch* chars, rapidjson::SizeType length, bool copy )
-				{
-					if ( templatePath.IsEmpty() )
-					{
-						Helium::String str( chars, length );
-
-						if ( templateIsNext )
-						{
-							templatePath = str;
-							templateIsNext = false;
-							return true;
-						}
-					}
-
-					return true;
-				}
-			} handler;
-
-			// non destructive in-place stream helper
-			rapidjson::StringStream stream( static_cast<char*>( rRequest.pLoadBuffer ) );
-
-			// the main reader object
-			rapidjson::Reader reader;
-			if ( reader.Parse< rapidjson::kParseDefaultFlags >( stream, handler ) )
-			{
-				SerializedObjectData* pObjectData = m_objects.New();
-				HELIUM_ASSERT( pObjectData );
-				HELIUM_VERIFY( pObjectData->objectPath.Set( name, false, m_packagePath ) );
-				pObjectData->templatePath.Set( handler.templatePath );
-				pObjectData->typeName = handler.typeName;
-				pObjectData->filePath = rRequest.filePath;
-				pObjectData->fileTimeStamp = rRequest.fileTimestamp;
-				pObjectData->bMetadataGood = true;
-
-				HELIUM_TRACE(
-					TraceLevels::Debug,
-					"LoosePackageLoader: Success reading preliminary data for object '%s' from file '%s'.\n",
-					*name,
-					rRequest.filePath.Data() );
-			}
-			else
-			{
-				HELIUM_TRACE(
-					TraceLevels::Error,
-					"LoosePackageLoader: Failure reading preliminary data for object '%s' from file '%s': Error parsing JSON (%d): %s\n",
-					*name,
-					rRequest.filePath.Data(),
-					reader.GetErrorOffset(),
-					rapidjson::GetParseError_En( reader.GetParseErrorCode() ) );
-			}
+			completedRequestIndices.Push( i );
+			continue;
 		}
 
-		// We're finished with this load, so deallocate memory and get rid of the request
+		// We're finished with this load, so deallocate memory
 		DefaultAllocator().Free( rRequest.pLoadBuffer );
 		rRequest.pLoadBuffer = NULL;
-		SetInvalid( rRequest.asyncLoadId );
-		m_fileReadRequests.RemoveSwap( i );
+		rRequest.bProcessed = true;
 	}
 
+	ParsePreloadedFiles( completedRequestIndices );
+
 	// Wait for the parent package to finish loading.
 	AssetPtr spParentPackage;
 	if ( IsValid( m_parentPackageLoadId ) )
@@ -834,6 +775,43 @@ void LoosePackageLoader::TickPreload()
 		return;
 	}
 
+	// Add the parsed objects in file path order rather than the order in which the directory listed them or their reads
+	// completed, so the object list is the same from one run (and file system) to the next
+	std::sort(
+		m_fileReadRequests.GetData(),
+		m_fileReadRequests.GetData() + m_fileReadRequests.GetSize(),
+		FileReadRequestPathLess< FileReadRequest > );
+
+	for ( size_t i = 0; i < m_fileReadRequests.GetSize(); ++i )
+	{
+		FileReadRequest &rRequest = m_fileReadRequests[i];
+		HELIUM_ASSERT( rRequest.bProcessed );
+		if ( !rRequest.bParsed )
+		{
+			continue;
+		}
+
+		// the name is deduced from the file name (bad idea to store it in the file)
+		Name name( rRequest.filePath.Basename().c_str() );
+
+		SerializedObjectData* pObjectData = m_objects.New();
+		HELIUM_ASSERT( pObjectData );
+		HELIUM_VERIFY( pObjectData->objectPath.Set( name, false, m_packagePath ) );
+		pObjectData->templatePath.Set( rRequest.templatePath );
+		pObjectData->typeName = rRequest.typeName;
+		pObjectData->filePath = rRequest.filePath;
+		pObjectData->fileTimeStamp = rRequest.fileTimestamp;
+		pObjectData->bMetadataGood = true;
+
+		HELIUM_TRACE(
+			TraceLevels::Debug,
+			"LoosePackageLoader: Success reading preliminary data for object '%s' from file '%s'.\n",
+			*name,
+			rRequest.filePath.Data() );
+	}
+
+	m_fileReadRequests.Clear();
+
 	// Create the package object if it does not yet exist.
 	Package* pPackage = m_spPackage;
 	if ( !pPackage )
@@ -936,6 +914,157 @@ void LoosePackageLoader::TickPreload()
 	LooseAssetLoader::OnPackagePreloaded( this );
 }
 
+/// Parse the preliminary object data from a set of completed file read requests.
+///
+/// Files are parsed in batches on the job manager if it is running, or on the calling thread if not.  Results are
+/// stored in each request and merged into the object list, in file path order, once all files have been processed.
+///
+/// @param[in] rRequestIndices  Indices of the file read requests to parse.
+void LoosePackageLoader::ParsePreloadedFiles( const DynamicArray< size_t >& rRequestIndices )
+{
+	size_t requestCount = rRequestIndices.GetSize();
+	if ( requestCount == 0 )
+	{
+		return;
+	}
+
+	DynamicArray< PreloadParseBatch > batches;
+	batches.Reserve( ( requestCount + PRELOAD_PARSE_BATCH_SIZE - 1 ) / PRELOAD_PARSE_BATCH_SIZE );
+	for ( size_t firstIndex = 0; firstIndex < requestCount; firstIndex += PRELOAD_PARSE_BATCH_SIZE )
+	{
+		PreloadParseBatch* pBatch = batches.New();
+		HELIUM_ASSERT( pBatch );
+		pBatch->pRequests = m_fileReadRequests.GetData();
+		pBatch->pRequestIndices = rRequestIndices.GetData() + firstIndex;
+		size_t remainingCount = requestCount - firstIndex;
+		pBatch->requestCount = ( remainingCount < PRELOAD_PARSE_BATCH_SIZE ? remainingCount : PRELOAD_PARSE_BATCH_SIZE );
+	}
+
+	JobManager* pJobManager = JobManager::GetInstance();
+	if ( !pJobManager || batches.GetSize() < 2 )
+	{
+		for ( size_t batchIndex = 0; batchIndex < batches.GetSize(); ++batchIndex )
+		{
+			ParsePreloadBatch( &batches[batchIndex] );
+		}
+
+		return;
+	}
+
+	JobCounter counter;
+	for ( size_t batchIndex = 0; batchIndex < batches.GetSize(); ++batchIndex )
+	{
+		pJobManager->Spawn( ParsePreloadBatch, &batches[batchIndex], counter );
+	}
+
+	pJobManager->Wait( counter );
+}
+
+/// Job function for parsing a batch of preloaded object files.
+///
+/// @param[in] pData  PreloadParseBatch describing the requests to parse.
+void LoosePackageLoader::ParsePreloadBatch( void* pData )
+{
+	PreloadParseBatch* pBatch = static_cast< PreloadParseBatch* >( pData );
+	HELIUM_ASSERT( pBatch );
+
+	for ( size_t i = 0; i < pBatch->requestCount; ++i )
+	{
+		FileReadRequest &rRequest = pBatch->pRequests[pBatch->pRequestIndices[i]];
+		ParsePreliminaryObjectData( rRequest );
+
+		// We're finished with this load, so deallocate memory
+		DefaultAllocator().Free( rRequest.pLoadBuffer );
+		rRequest.pLoadBuffer = NULL;
+		rRequest.bProcessed = true;
+	}
+}
+
+/// Parse the type name and template path from the contents of a loaded object file.
+///
+/// This only touches the given request, so it is safe to call for different requests from multiple threads.
+///
+/// @param[in,out] rRequest  Completed file read request.
+void LoosePackageLoader::ParsePreliminaryObjectData( FileReadRequest& rRequest )
+{
+	HELIUM_ASSERT( rRequest.pLoadBuffer );
+
+	// read some preliminary data from the json
+	struct PreliminaryObjectHandler : rapidjson::BaseReaderHandler<>
+	{
+		Helium::Name typeName;
+		Helium::String templatePath;
+		bool templateIsNext;
+
+		PreliminaryObjectHandler()
+			: typeName( ENullName() )
+			, templatePath( "" )
+		{
+			templateIsNext = false;
+		}
+
+		bool Key( const Ch* chars, rapidjson::SizeType length, bool copy )
+		{
+			if ( typeName.IsEmpty() )
+			{
+				typeName.Set( Helium::String( chars, length ) );
+				return true;
+			}
+
+			if ( templatePath.IsEmpty() )
+			{
+				Helium::String str( chars, length );
+
+				if ( str == "m_spTemplate" )
+				{
+					templateIsNext = true;
+					return true;
+				}
+			}
+
+			return true;
+		}
+
+		bool String( const Ch* chars, rapidjson::SizeType length, bool copy )
+		{
+			if ( templatePath.IsEmpty() )
+			{
+				Helium::String str( chars, length );
+
+				if ( templateIsNext )
+				{
+					templatePath = str;
+					templateIsNext = false;
+					return true;
+				}
+			}
+
+			return true;
+		}
+	} handler;
+
+	// non destructive in-place stream helper
+	rapidjson::StringStream stream( static_cast<char*>( rRequest.pLoadBuffer ) );
+
+	// the main reader object
+	rapidjson::Reader reader;
+	if ( reader.Parse< rapidjson::kParseDefaultFlags >( stream, handler ) )
+	{
+		rRequest.typeName = handler.typeName;
+		rRequest.templatePath = handler.templatePath;
+		rRequest.bParsed = true;
+	}
+	else
+	{
+		HELIUM_TRACE(
+			TraceLevels::Error,
+			"LoosePackageLoader: Failure reading preliminary data from file '%s': Error parsing JSON (%d): %s\n",
+			rRequest.filePath.Data(),
+			reader.GetErrorOffset(),
+			rapidjson::GetParseError_En( reader.GetParseErrorCode() ) );
+	}
+}
+
 /// Update load processing of object load requests.
 void LoosePackageLoader::TickLoadRequests()
 {
@@ -950,6 +1079,12 @@ void LoosePackageLoader::TickLoadRequests()
 		LoadRequest* pRequest = m_loadRequests[loadRequestIndex];
 		HELIUM_ASSERT( pRequest );
 
+		if ( ( pRequest->flags & LOAD_FLAG_PRELOADED ) == LOAD_FLAG_PRELOADED )
+		{
+			// Waiting for the asset loader to pick up the object.
+			continue;
+		}
+
 		if ( !( pRequest->flags & LOAD_FLAG_PROPERTY_PRELOADED ) )
 		{
 			if ( !TickDeserialize( pRequest ) )
@@ -969,6 +1104,13 @@ void LoosePackageLoader::TickLoadRequests()
 				continue;
 			}
 		}
+
+		// Preloading has completed, so let the asset loader know that the object is ready to be picked up.
+		AssetLoader* pAssetLoader = AssetLoader::GetInstance();
+		if ( pAssetLoader )
+		{
+			pAssetLoader->WakeLoadRequest( GetAssetPath( pRequest->index ) );
+		}
 	}
 }
 
@@ -1353,13 +1495,9 @@ bool LoosePackageLoader::TickDeserialize( LoadRequest* pRequest )
 				HELIUM_ASSERT( pRequest->pCachedObjectDataBuffer );
 				pRequest->cachedObjectDataBufferSize = pEntry->size;
 
-				AsyncLoader* pAsyncLoader = AsyncLoader::GetInstance();
-				HELIUM_ASSERT( pAsyncLoader );
-
-				pRequest->persistentResourceDataLoadId = pAsyncLoader->QueueRequest(
+				pRequest->persistentResourceDataLoadId = pCache->QueueEntryLoad(
+					*pEntry,
 					pRequest->pCachedObjectDataBuffer,
-					pCache->GetCacheFileName(),
-					pEntry->offset,
 					pEntry->size );
 				HELIUM_ASSERT( IsValid( pRequest->persistentResourceDataLoadId ) );
 			}
@@ -18,6 +18,8 @@ namespace Helium
 
 		/// Maximum number of bytes to parse at a time.
 		static const size_t PARSE_CHUNK_SIZE = 4 * 1024;
+		/// Number of object files parsed by each job during preloading.
+		static const size_t PRELOAD_PARSE_BATCH_SIZE = 16;
 
 		/// Serialized object data.
 		struct SerializedObjectData
@@ -169,9 +171,29 @@ namespace Helium
 			size_t asyncLoadId;
 			uint64_t expectedSize;
 			uint64_t fileTimestamp;
+
+			/// Type name parsed from the file.
+			Name typeName;
+			/// Template path parsed from the file.
+			String templatePath;
+			/// True once the file has been read and parsed (successfully or not).
+			bool bProcessed;
+			/// True if the preliminary object data was parsed successfully.
+			bool bParsed;
 		};
 		DynamicArray<FileReadRequest> m_fileReadRequests;
 
+		/// Range of completed file read requests to parse on a job thread.
+		struct PreloadParseBatch
+		{
+			/// File read request array.
+			FileReadRequest* pRequests;
+			/// Indices of the requests to parse.
+			const size_t* pRequestIndices;
+			/// Number of requests to parse.
+			size_t requestCount;
+		};
+
 		/// Parent package load request ID.
 		size_t m_parentPackageLoadId;
 
@@ -181,6 +203,7 @@ namespace Helium
 		/// @name Private Utility Functions
 		//@{
 		void TickPreload();
+		void ParsePreloadedFiles( const DynamicArray< size_t >& rRequestIndices );
 
 		void TickLoadRequests();
 		bool TickDeserialize( LoadRequest* pRequest );
@@ -189,5 +212,11 @@ namespace Helium
 
 		size_t FindObjectByPath( const AssetPath &path ) const;
 		size_t FindObjectByName( const Name &name ) const;
+
+		/// @name Static Private Utility Functions
+		//@{
+		static void ParsePreloadBatch( void* pData );
+		static void ParsePreliminaryObjectData( FileReadRequest& rRequest );
+		//@}
 	};
 }
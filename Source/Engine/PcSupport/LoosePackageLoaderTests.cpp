@@ -0,0 +1,237 @@
+#include "PcSupport/LoosePackageLoader.h"
+
+#include "Platform/Timer.h"
+#include "Foundation/DynamicArray.h"
+#include "Foundation/FilePath.h"
+#include "Reflect/Registry.h"
+#include "Engine/AsyncLoader.h"
+#include "Engine/Config.h"
+#include "Engine/FileLocations.h"
+#include "EngineJobs/JobManager.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if HELIUM_OS_LINUX
+
+#include <ftw.h>
+#include <sys/stat.h>
+
+using namespace Helium;
+
+namespace
+{
+	/// Number of object files in the generated benchmark package.
+	const size_t BENCHMARK_FILE_COUNT = 50000;
+	/// Number of object files in the generated package used to check the object list.
+	const size_t SMALL_FILE_COUNT = 200;
+
+	/// Type names used by the generated object files.
+	const char* const OBJECT_TYPE_NAMES[] = { "Helium::Material", "Helium::Mesh", "Helium::Texture2d", "Helium::Font" };
+
+	/// Base directory holding the data directory used by the tests.
+	char g_BaseDirectory[ 256 ];
+
+	int RemoveDirectoryEntry( const char* pPath, const struct stat* /*pStat*/, int /*type*/, struct FTW* /*pFtw*/ )
+	{
+		return remove( pPath );
+	}
+
+	void GetObjectName( size_t fileIndex, char* pBuffer, size_t bufferSize )
+	{
+		snprintf( pBuffer, bufferSize, "Object%05u", static_cast< uint32_t >( fileIndex ) );
+	}
+
+	class LoosePackageLoaderTest : public testing::Test
+	{
+	protected:
+		static void SetUpTestCase()
+		{
+			strcpy( g_BaseDirectory, "/tmp/LoosePackageLoaderTests.XXXXXX" );
+			ASSERT_TRUE( mkdtemp( g_BaseDirectory ) != NULL );
+
+			char dataDirectory[ 512 ];
+			snprintf( dataDirectory, sizeof( dataDirectory ), "%s/Data", g_BaseDirectory );
+			ASSERT_EQ( 0, mkdir( dataDirectory, 0700 ) );
+
+			FileLocations::SetBaseDirectory( FilePath( std::string( g_BaseDirectory ) + "/" ) );
+
+			AsyncLoader::Startup();
+			Reflect::Startup();
+			Config::Startup();
+		}
+
+		static void TearDownTestCase()
+		{
+			Config::Shutdown();
+			Reflect::Shutdown();
+			AssetType::Shutdown();
+			Asset::Shutdown();
+			Reflect::ObjectRefCountSupport::Shutdown();
+			AsyncLoader::Shutdown();
+			FileLocations::Shutdown();
+
+			nftw( g_BaseDirectory, RemoveDirectoryEntry, 16, FTW_DEPTH | FTW_PHYS );
+		}
+
+		void TearDown()
+		{
+			if ( JobManager::GetInstance() )
+			{
+				JobManager::Shutdown();
+			}
+		}
+
+		/// Write a package of object files, each with a type, an optional template, and some property data.  Files are
+		/// created in a scrambled order so that the directory does not list them sorted, and a file that is not valid
+		/// JSON is added alongside them.
+		void WritePackage( const char* pPackageName, size_t fileCount )
+		{
+			char packageDirectory[ 512 ];
+			snprintf( packageDirectory, sizeof( packageDirectory ), "%s/Data/%s", g_BaseDirectory, pPackageName );
+			ASSERT_EQ( 0, mkdir( packageDirectory, 0700 ) );
+
+			char path[ 768 ];
+			char objectName[ 64 ];
+			for ( size_t writeIndex = 0; writeIndex < fileCount; ++writeIndex )
+			{
+				size_t fileIndex = ( writeIndex * 7919 ) % fileCount;
+				GetObjectName( fileIndex, objectName, sizeof( objectName ) );
+				snprintf( path, sizeof( path ), "%s/%s.json", packageDirectory, objectName );
+
+				FILE* pFile = fopen( path, "wb" );
+				ASSERT_TRUE( pFile != NULL );
+
+				fprintf( pFile, "{\n\t\"%s\": {\n", OBJECT_TYPE_NAMES[ fileIndex % HELIUM_ARRAY_COUNT( OBJECT_TYPE_NAMES ) ] );
+				if ( fileIndex % 3 != 0 )
+				{
+					fprintf( pFile, "\t\t\"m_spTemplate\": \"/Templates:Template%u\",\n", static_cast< uint32_t >( fileIndex % 16 ) );
+				}
+
+				fprintf( pFile, "\t\t\"m_values\": [" );
+				for ( uint32_t valueIndex = 0; valueIndex < 64; ++valueIndex )
+				{
+					fprintf( pFile, "%s%u.5", ( valueIndex ? ", " : "" ), static_cast< uint32_t >( fileIndex ) + valueIndex );
+				}
+				fprintf( pFile, "],\n\t\t\"m_name\": \"%s\"\n\t}\n}\n", objectName );
+
+				fclose( pFile );
+			}
+
+			snprintf( path, sizeof( path ), "%s/Broken.json", packageDirectory );
+			FILE* pFile = fopen( path, "wb" );
+			ASSERT_TRUE( pFile != NULL );
+			fputs( "{ \"Helium::Mesh\": [ }\n", pFile );
+			fclose( pFile );
+		}
+
+		/// Preload a package by ticking its loader, the way the asset loader does.
+		///
+		/// @param[in]  pPackageName  Name of the package.
+		/// @param[out] rObjectPaths  Objects listed by the loader once preloading has finished, in loader order.
+		///
+		/// @return  Time taken to preload the package, in ticks.
+		uint64_t Preload( const char* pPackageName, DynamicArray< AssetPath >& rObjectPaths )
+		{
+			char packagePathString[ 64 ];
+			snprintf( packagePathString, sizeof( packagePathString ), "/%s", pPackageName );
+			AssetPath packagePath;
+			HELIUM_VERIFY( packagePath.Set( packagePathString ) );
+
+			LoosePackageLoader loader;
+			rObjectPaths.Resize( 0 );
+			if ( !loader.Initialize( packagePath ) )
+			{
+				ADD_FAILURE() << "Failed to initialize the loader for " << packagePathString;
+
+				return 0;
+			}
+
+			uint64_t startTicks = Timer::GetTickCount();
+			EXPECT_TRUE( loader.BeginPreload() );
+			while ( !loader.TryFinishPreload() )
+			{
+				loader.Tick();
+			}
+
+			uint64_t ticks = Timer::GetTickCount() - startTicks;
+
+			EXPECT_TRUE( loader.GetPackage() != NULL );
+			for ( size_t objectIndex = 0; objectIndex < loader.GetObjectCount(); ++objectIndex )
+			{
+				AssetPath objectPath = loader.GetAssetPath( objectIndex );
+				EXPECT_TRUE( objectPath.GetParent() == packagePath );
+				rObjectPaths.Push( objectPath );
+
+#if HELIUM_TOOLS
+				// Each object remembers the file it was parsed from
+				EXPECT_STREQ( *objectPath.GetName(), loader.GetAssetFileSystemPath( objectPath ).Basename().c_str() );
+#endif
+			}
+
+			loader.Cleanup();
+
+			return ticks;
+		}
+	};
+}
+
+TEST_F( LoosePackageLoaderTest, ListsObjectsInFilePathOrder )
+{
+	WritePackage( "ObjectOrder", SMALL_FILE_COUNT );
+
+	DynamicArray< AssetPath > serialPaths;
+	Preload( "ObjectOrder", serialPaths );
+
+	// The broken file is left out, and everything else comes back sorted no matter what order the directory listed it in.
+	ASSERT_EQ( SMALL_FILE_COUNT, serialPaths.GetSize() );
+	char objectName[ 64 ];
+	for ( size_t fileIndex = 0; fileIndex < SMALL_FILE_COUNT; ++fileIndex )
+	{
+		GetObjectName( fileIndex, objectName, sizeof( objectName ) );
+		EXPECT_TRUE( serialPaths[ fileIndex ].GetName() == Name( objectName ) ) << "Object " << fileIndex << " is out of order";
+	}
+
+	// Parsing on the job manager completes reads in a different order but must produce the same list.
+	JobManager::Startup();
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	DynamicArray< AssetPath > parallelPaths;
+	Preload( "ObjectOrder", parallelPaths );
+	ASSERT_EQ( serialPaths.GetSize(), parallelPaths.GetSize() );
+	for ( size_t objectIndex = 0; objectIndex < serialPaths.GetSize(); ++objectIndex )
+	{
+		EXPECT_TRUE( serialPaths[ objectIndex ] == parallelPaths[ objectIndex ] );
+	}
+}
+
+TEST_F( LoosePackageLoaderTest, BenchmarkPreload )
+{
+	WritePackage( "Benchmark", BENCHMARK_FILE_COUNT );
+
+	DynamicArray< AssetPath > objectPaths;
+
+	// Warm the page cache so that both runs measure reading and parsing rather than the disk.
+	Preload( "Benchmark", objectPaths );
+
+	uint64_t serialTicks = Preload( "Benchmark", objectPaths );
+	ASSERT_EQ( BENCHMARK_FILE_COUNT, objectPaths.GetSize() );
+
+	JobManager::Startup();
+	ASSERT_TRUE( JobManager::GetInstance() != NULL );
+
+	uint64_t parallelTicks = Preload( "Benchmark", objectPaths );
+	ASSERT_EQ( BENCHMARK_FILE_COUNT, objectPaths.GetSize() );
+
+	printf(
+		"%u object files: calling thread %.3f ms, %u job workers %.3f ms, %.2fx\n",
+		static_cast< uint32_t >( BENCHMARK_FILE_COUNT ),
+		Timer::TicksToMilliseconds( serialTicks ),
+		JobManager::GetInstance()->GetWorkerCount(),
+		Timer::TicksToMilliseconds( parallelTicks ),
+		Timer::TicksToMilliseconds( serialTicks ) / Timer::TicksToMilliseconds( parallelTicks ) );
+}
+
+#endif // HELIUM_OS_LINUX
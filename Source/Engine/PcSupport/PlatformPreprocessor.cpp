@@ -39,6 +39,46 @@ PlatformPreprocessor::~PlatformPreprocessor()
 ///
 /// @see GetShaderProfileCount()
 
+/// Compute a key identifying the compiled output of a shader.
+///
+/// The key should cover everything that can affect the result of CompileShader() for the given inputs, such as the
+/// fully preprocessed shader source, the preprocessor definitions, the target profile, and the compiler version and
+/// options.  Platforms that cannot compute such a key can leave this unimplemented, in which case their shaders are
+/// always recompiled.
+///
+/// @param[in]  rShaderPath        FilePath to the shader file being compiled.
+/// @param[in]  profileIndex       Index of the target shader profile (must be a value less than that returned by
+///                                GetShaderProfileCount()).
+/// @param[in]  type               Shader type.
+/// @param[in]  pShaderCode        Pointer to the loaded shader code to compile.
+/// @param[in]  shaderCodeSize     Size of the shader code, in bytes.
+/// @param[in]  pTokens            Array of shader preprocessor tokens.
+/// @param[in]  tokenCount         Number of shader preprocessor tokens in the given array.
+/// @param[out] rKey               Shader cache key.
+/// @param[out] rPreprocessedCode  Preprocessed shader code, if the key was computed from it.  When set, this is
+///                                compiled in place of the original code, without any tokens, so that the shader is
+///                                not preprocessed a second time.  Left empty otherwise.
+///
+/// @return  True if a key was computed, false if the compiled shader should not be cached.
+///
+/// @see CompileShader()
+bool PlatformPreprocessor::ComputeShaderCacheKey(
+	const FilePath& /*rShaderPath*/,
+	size_t /*profileIndex*/,
+	RShader::EType /*type*/,
+	const void* /*pShaderCode*/,
+	size_t /*shaderCodeSize*/,
+	const ShaderToken* /*pTokens*/,
+	size_t /*tokenCount*/,
+	uint64_t& rKey,
+	DynamicArray< uint8_t >& rPreprocessedCode )
+{
+	rKey = 0;
+	rPreprocessedCode.Resize( 0 );
+
+	return false;
+}
+
 /// @fn bool PlatformPreprocessor::FillShaderReflectionData( size_t profileIndex, const void* pCompiledCode, size_t compiledCodeSize, DynamicArray< ShaderConstantBufferInfo >& rConstantBuffers, DynamicArray< ShaderSamplerInfo >& rSamplers, DynamicArray< ShaderTextureInfo >& rTextures )
 /// Fill out data about the shader constants and texture inputs.
 ///
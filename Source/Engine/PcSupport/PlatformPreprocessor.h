@@ -64,6 +64,10 @@ namespace Helium
             const FilePath& rShaderPath, size_t profileIndex, RShader::EType type, const void* pShaderCode,
             size_t shaderCodeSize, const ShaderToken* pTokens, size_t tokenCount, DynamicArray< uint8_t >& rCompiledCode,
             DynamicArray< String >* pErrorMessages ) = 0;
+        virtual bool ComputeShaderCacheKey(
+            const FilePath& rShaderPath, size_t profileIndex, RShader::EType type, const void* pShaderCode,
+            size_t shaderCodeSize, const ShaderToken* pTokens, size_t tokenCount, uint64_t& rKey,
+            DynamicArray< uint8_t >& rPreprocessedCode );
         virtual bool FillShaderReflectionData(
             size_t profileIndex, const void* pCompiledCode, size_t compiledCodeSize,
             DynamicArray< ShaderConstantBufferInfo >& rConstantBuffers, DynamicArray< ShaderSamplerInfo >& rSamplers,
@@ -48,6 +48,16 @@ bool ResourceHandler::CacheResource(
 {
     return false;
 }
+
+/// Get whether CacheResource() can be called for different resources from multiple threads at the same time.
+///
+/// @return  True if concurrent caching is supported, false if resources must be cached one at a time.
+///
+/// @see AssetPreprocessor::CacheObjects()
+bool ResourceHandler::SupportsConcurrentCaching() const
+{
+    return false;
+}
 #endif  // HELIUM_TOOLS
 
 
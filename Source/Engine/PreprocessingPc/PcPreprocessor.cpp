@@ -7,6 +7,7 @@
 #include "Rendering/ShaderProfiles.h"
 #include "Graphics/Shader.h"
 #include "Engine/FileLocations.h"
+#include "Engine/StableHash.h"
 
 #if HELIUM_DIRECT3D
 
@@ -170,73 +171,50 @@ HRESULT D3DIncludeHandler::Close( LPCVOID pData )
     return S_OK;
 }
 
-#endif // HELIUM_DIRECT3D
-
-/// Constructor.
-PcPreprocessor::PcPreprocessor()
-{
-}
-
-/// Destructor.
-PcPreprocessor::~PcPreprocessor()
-{
-}
-
-/// @copydoc PlatformPreprocessor::GetByteOrder()
-PlatformPreprocessor::EByteOrder PcPreprocessor::GetByteOrder() const
-{
-	return BYTE_ORDER_LITTLE;
-}
-
-/// @copydoc PlatformPreprocessor::GetShaderProfileCount()
-size_t PcPreprocessor::GetShaderProfileCount() const
-{
-	return static_cast< size_t >( ShaderProfile::PC_MAX );
-}
+/// Shader compiler flags used for all shader profiles.
+///
+/// XXX TMC: Always use row-major packing, since that's the only option with Cg.
+static const UINT SHADER_COMPILE_FLAGS =
+	D3D10_SHADER_OPTIMIZATION_LEVEL3 | D3D10_SHADER_PACK_MATRIX_ROW_MAJOR | D3D10_SHADER_WARNINGS_ARE_ERRORS;
 
-/// @copydoc PlatformPreprocessor::CompileShader()
-bool PcPreprocessor::CompileShader(
-								   const FilePath& rShaderPath,
-								   size_t profileIndex,
-								   RShader::EType type,
-								   const void* pShaderCode,
-								   size_t shaderCodeSize,
-								   const ShaderToken* pTokens,
-								   size_t tokenCount,
-								   DynamicArray< uint8_t >& rCompiledCode,
-								   DynamicArray< String >* pErrorMessages )
+/// Build the preprocessor definitions and target profile name with which to compile a shader.
+///
+/// @param[in]  profileIndex  Index of the target shader profile.
+/// @param[in]  type          Shader type.
+/// @param[in]  pTokens       Array of shader preprocessor tokens.
+/// @param[in]  tokenCount    Number of shader preprocessor tokens in the given array.
+/// @param[in]  rStackHeap    Heap from which to allocate the token strings.  Allocations remain in use until the
+///                           definitions are no longer needed.
+/// @param[out] rDefines      Null-terminated array of preprocessor definitions.
+/// @param[out] rpProfile     Direct3D shader profile name.
+///
+/// @return  True if the profile and shader type are valid, false if not.
+static bool BuildShaderDefines(
+	size_t profileIndex,
+	RShader::EType type,
+	const PlatformPreprocessor::ShaderToken* pTokens,
+	size_t tokenCount,
+	StackMemoryHeap<>& rStackHeap,
+	DynamicArray< D3D10_SHADER_MACRO >& rDefines,
+	const char*& rpProfile )
 {
-	HELIUM_ASSERT( profileIndex < static_cast< size_t >( ShaderProfile::PC_MAX ) );
-	HELIUM_ASSERT( static_cast< size_t >( type ) < static_cast< size_t >( RShader::TYPE_MAX ) );
-	HELIUM_ASSERT( pShaderCode );
-	HELIUM_ASSERT( pTokens || tokenCount == 0 );
+	rDefines.Resize( 0 );
 
-	rCompiledCode.Resize( 0 );
-	if( pErrorMessages )
-	{
-		pErrorMessages->Resize( 0 );
-	}
-
-#if HELIUM_DIRECT3D
-
-	DynamicArray< D3D10_SHADER_MACRO > defines;
 	D3D10_SHADER_MACRO macro;
 
-	const char* pProfile;
-
 	switch( static_cast< ShaderProfile::EPc >( profileIndex ) )
 	{
 	case ShaderProfile::PC_SM2b:
 		{
 			macro.Name = "HELIUM_PROFILE_PC_SM2b";
 			macro.Definition = "1";
-			defines.Push( macro );
+			rDefines.Push( macro );
 
 			// Also define HELIUM_PROFILE_PC_SM2 for consistency and legacy support.
 			macro.Name = "HELIUM_PROFILE_PC_SM2";
-			defines.Push( macro );
+			rDefines.Push( macro );
 
-			pProfile = ( type == RShader::TYPE_VERTEX ? "vs_2_0" : "ps_2_b" );
+			rpProfile = ( type == RShader::TYPE_VERTEX ? "vs_2_0" : "ps_2_b" );
 
 			break;
 		}
@@ -245,9 +223,9 @@ bool PcPreprocessor::CompileShader(
 		{
 			macro.Name = "HELIUM_PROFILE_PC_SM3";
 			macro.Definition = "1";
-			defines.Push( macro );
+			rDefines.Push( macro );
 
-			pProfile = ( type == RShader::TYPE_VERTEX ? "vs_3_0" : "ps_3_0" );
+			rpProfile = ( type == RShader::TYPE_VERTEX ? "vs_3_0" : "ps_3_0" );
 
 			break;
 		}
@@ -256,16 +234,16 @@ bool PcPreprocessor::CompileShader(
 		{
 			macro.Name = "HELIUM_PROFILE_PC_SM4";
 			macro.Definition = "1";
-			defines.Push( macro );
+			rDefines.Push( macro );
 
-			pProfile = ( type == RShader::TYPE_VERTEX ? "vs_4_0" : "ps_4_0" );
+			rpProfile = ( type == RShader::TYPE_VERTEX ? "vs_4_0" : "ps_4_0" );
 
 			break;
 		}
 
 	default:
 		{
-			HELIUM_BREAK_MSG( "PcPreprocessor::CompileShader(): Invalid shader profile index.\n" );
+			HELIUM_BREAK_MSG( "PcPreprocessor: Invalid shader profile index.\n" );
 
 			return false;
 		}
@@ -277,7 +255,7 @@ bool PcPreprocessor::CompileShader(
 		{
 			macro.Name = "HELIUM_TYPE_VERTEX";
 			macro.Definition = "1";
-			defines.Push( macro );
+			rDefines.Push( macro );
 
 			break;
 		}
@@ -286,25 +264,22 @@ bool PcPreprocessor::CompileShader(
 		{
 			macro.Name = "HELIUM_TYPE_PIXEL";
 			macro.Definition = "1";
-			defines.Push( macro );
+			rDefines.Push( macro );
 
 			break;
 		}
 
 	default:
 		{
-			HELIUM_BREAK_MSG( "PcPreprocessor::CompileShader(): Invalid shader type.\n" );
+			HELIUM_BREAK_MSG( "PcPreprocessor: Invalid shader type.\n" );
 
 			return false;
 		}
 	}
 
-	StackMemoryHeap<>& rStackHeap = ThreadLocalStackAllocator::GetMemoryHeap();
-	StackMemoryHeap<>::Marker stackMarker( rStackHeap );
-
 	for( size_t tokenIndex = 0; tokenIndex < tokenCount; ++tokenIndex )
 	{
-		const ShaderToken& rToken = pTokens[ tokenIndex ];
+		const PlatformPreprocessor::ShaderToken& rToken = pTokens[ tokenIndex ];
 
 		size_t nameBufferSize = rToken.name.GetSize() + 1;
 		char* pNameBuffer = static_cast< char* >( rStackHeap.Allocate( nameBufferSize ) );
@@ -320,22 +295,83 @@ bool PcPreprocessor::CompileShader(
 		
 		HELIUM_TRACE(
 			TraceLevels::Debug,
-			"PcPreprocessor::CompileShader(): Defining option %s = %s (profile index: %" PRIuSZ ").\n",
+			"PcPreprocessor: Defining option %s = %s (profile index: %" PRIuSZ ").\n",
 			macro.Name,
 			macro.Definition,
 			profileIndex );
 
-		defines.Push( macro );
+		rDefines.Push( macro );
 	}
 
 	macro.Name = NULL;
 	macro.Definition = NULL;
-	defines.Push( macro );
+	rDefines.Push( macro );
+
+	return true;
+}
+
+#endif // HELIUM_DIRECT3D
+
+/// Constructor.
+PcPreprocessor::PcPreprocessor()
+{
+}
+
+/// Destructor.
+PcPreprocessor::~PcPreprocessor()
+{
+}
+
+/// @copydoc PlatformPreprocessor::GetByteOrder()
+PlatformPreprocessor::EByteOrder PcPreprocessor::GetByteOrder() const
+{
+	return BYTE_ORDER_LITTLE;
+}
+
+/// @copydoc PlatformPreprocessor::GetShaderProfileCount()
+size_t PcPreprocessor::GetShaderProfileCount() const
+{
+	return static_cast< size_t >( ShaderProfile::PC_MAX );
+}
+
+/// @copydoc PlatformPreprocessor::CompileShader()
+bool PcPreprocessor::CompileShader(
+								   const FilePath& rShaderPath,
+								   size_t profileIndex,
+								   RShader::EType type,
+								   const void* pShaderCode,
+								   size_t shaderCodeSize,
+								   const ShaderToken* pTokens,
+								   size_t tokenCount,
+								   DynamicArray< uint8_t >& rCompiledCode,
+								   DynamicArray< String >* pErrorMessages )
+{
+	HELIUM_ASSERT( profileIndex < static_cast< size_t >( ShaderProfile::PC_MAX ) );
+	HELIUM_ASSERT( static_cast< size_t >( type ) < static_cast< size_t >( RShader::TYPE_MAX ) );
+	HELIUM_ASSERT( pShaderCode );
+	HELIUM_ASSERT( pTokens || tokenCount == 0 );
+
+	rCompiledCode.Resize( 0 );
+	if( pErrorMessages )
+	{
+		pErrorMessages->Resize( 0 );
+	}
+
+#if HELIUM_DIRECT3D
+
+	StackMemoryHeap<>& rStackHeap = ThreadLocalStackAllocator::GetMemoryHeap();
+	StackMemoryHeap<>::Marker stackMarker( rStackHeap );
+
+	DynamicArray< D3D10_SHADER_MACRO > defines;
+	const char* pProfile;
+	if( !BuildShaderDefines( profileIndex, type, pTokens, tokenCount, rStackHeap, defines, pProfile ) )
+	{
+		return false;
+	}
 
 	D3DIncludeHandler includeHandler( rShaderPath );
 	ID3D10Blob* pCompiledCodeBlob = NULL;
 	ID3D10Blob* pErrorMessageBlob = NULL;
-	// XXX TMC: Always use row-major packing, since that's the only option with Cg.
 	HRESULT hResult = D3DCompile(
 		pShaderCode,
 		shaderCodeSize,
@@ -344,7 +380,7 @@ bool PcPreprocessor::CompileShader(
 		&includeHandler,
 		"main",
 		pProfile,
-		D3D10_SHADER_OPTIMIZATION_LEVEL3 | D3D10_SHADER_PACK_MATRIX_ROW_MAJOR | D3D10_SHADER_WARNINGS_ARE_ERRORS,
+		SHADER_COMPILE_FLAGS,
 		0,
 		&pCompiledCodeBlob,
 		( pErrorMessages ? &pErrorMessageBlob : NULL ) );
@@ -508,6 +544,101 @@ bool PcPreprocessor::CompileShader(
 	return true;
 }
 
+/// @copydoc PlatformPreprocessor::ComputeShaderCacheKey()
+bool PcPreprocessor::ComputeShaderCacheKey(
+	const FilePath& rShaderPath,
+	size_t profileIndex,
+	RShader::EType type,
+	const void* pShaderCode,
+	size_t shaderCodeSize,
+	const ShaderToken* pTokens,
+	size_t tokenCount,
+	uint64_t& rKey,
+	DynamicArray< uint8_t >& rPreprocessedCode )
+{
+	HELIUM_ASSERT( profileIndex < static_cast< size_t >( ShaderProfile::PC_MAX ) );
+	HELIUM_ASSERT( static_cast< size_t >( type ) < static_cast< size_t >( RShader::TYPE_MAX ) );
+	HELIUM_ASSERT( pShaderCode );
+	HELIUM_ASSERT( pTokens || tokenCount == 0 );
+
+	rKey = 0;
+	rPreprocessedCode.Resize( 0 );
+
+#if HELIUM_DIRECT3D
+
+	StackMemoryHeap<>& rStackHeap = ThreadLocalStackAllocator::GetMemoryHeap();
+	StackMemoryHeap<>::Marker stackMarker( rStackHeap );
+
+	DynamicArray< D3D10_SHADER_MACRO > defines;
+	const char* pProfile;
+	if( !BuildShaderDefines( profileIndex, type, pTokens, tokenCount, rStackHeap, defines, pProfile ) )
+	{
+		return false;
+	}
+
+	// Hash the fully preprocessed source rather than the raw shader file so that changes to included files are
+	// picked up as well.
+	D3DIncludeHandler includeHandler( rShaderPath );
+	ID3D10Blob* pPreprocessedBlob = NULL;
+	HRESULT hResult = D3DPreprocess(
+		pShaderCode,
+		shaderCodeSize,
+		NULL,
+		defines.GetData(),
+		&includeHandler,
+		&pPreprocessedBlob,
+		NULL );
+	if( FAILED( hResult ) || !pPreprocessedBlob )
+	{
+		if( pPreprocessedBlob )
+		{
+			pPreprocessedBlob->Release();
+		}
+
+		// Let the compiler report the errors.
+		return false;
+	}
+
+	uint64_t key = STABLE_HASH_64_BASIS;
+
+	const uint32_t compilerVersion = D3D_COMPILER_VERSION;
+	key = StableHash64( key, &compilerVersion, sizeof( compilerVersion ) );
+	key = StableHash64( key, &SHADER_COMPILE_FLAGS, sizeof( SHADER_COMPILE_FLAGS ) );
+	key = StableHash64( key, pProfile, StringLength( pProfile ) + 1 );
+
+	size_t defineCount = defines.GetSize() - 1;
+	for( size_t defineIndex = 0; defineIndex < defineCount; ++defineIndex )
+	{
+		const D3D10_SHADER_MACRO& rMacro = defines[ defineIndex ];
+		key = StableHash64( key, rMacro.Name, StringLength( rMacro.Name ) + 1 );
+		key = StableHash64( key, rMacro.Definition, StringLength( rMacro.Definition ) + 1 );
+	}
+
+	const uint8_t* pPreprocessedData = static_cast< const uint8_t* >( pPreprocessedBlob->GetBufferPointer() );
+	size_t preprocessedSize = pPreprocessedBlob->GetBufferSize();
+	key = StableHash64( key, pPreprocessedData, preprocessedSize );
+
+	// Hand back the preprocessed source so that a cache miss compiles it directly rather than preprocessing again.
+	// It keeps the #line directives emitted by the preprocessor, so compiler errors still refer to the original files.
+	rPreprocessedCode.Reserve( preprocessedSize );
+	rPreprocessedCode.AddArray( pPreprocessedData, preprocessedSize );
+
+	pPreprocessedBlob->Release();
+
+	rKey = key;
+
+	return true;
+
+#else // HELIUM_DIRECT3D
+
+	HELIUM_UNREF( rShaderPath );
+	HELIUM_UNREF( shaderCodeSize );
+
+	return false;
+
+#endif // HELIUM_DIRECT3D
+}
+
 /// @copydoc PlatformPreprocessor::FillShaderReflectionData()
 bool PcPreprocessor::FillShaderReflectionData(
 	size_t profileIndex,
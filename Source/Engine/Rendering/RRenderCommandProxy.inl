@@ -53,19 +53,25 @@ namespace Helium
     ///                         should be updated.  On platforms that don't support storage of constant buffers on the
     ///                         GPU (i.e. Direct3D 9 and such, where shader constants must be passed in the command
     ///                         buffer when changing), this can provide a significant performance improvement.
+    /// @param[in] pOffsets     Optional array of offsets (in bytes, aligned to the size of a four-component float
+    ///                         vector) at which each bound range begins within its constant buffer, allowing several
+    ///                         small constant blocks to be packed into a single large buffer.  When offsets are given,
+    ///                         the corresponding limit size is required and also sets the size of the bound range.
     ///
     /// @see SetPixelConstantBuffers()
     void RRenderCommandProxy::SetVertexConstantBuffers(
         size_t startIndex,
         size_t bufferCount,
         RConstantBufferPtr const* pspBuffers,
-        const size_t* pLimitSizes )
+        const size_t* pLimitSizes,
+        const size_t* pOffsets )
     {
         SetVertexConstantBuffers(
             startIndex,
             bufferCount,
             &static_cast< RConstantBuffer* const& >( pspBuffers[ 0 ] ),
-            pLimitSizes );
+            pLimitSizes,
+            pOffsets );
     }
 
     /// Set a range of pixel shader constant buffers to use for rendering.
@@ -79,18 +85,24 @@ namespace Helium
     ///                         should be updated.  On platforms that don't support storage of constant buffers on the
     ///                         GPU (i.e. Direct3D 9 and such, where shader constants must be passed in the command
     ///                         buffer when changing), this can provide a significant performance improvement.
+    /// @param[in] pOffsets     Optional array of offsets (in bytes, aligned to the size of a four-component float
+    ///                         vector) at which each bound range begins within its constant buffer, allowing several
+    ///                         small constant blocks to be packed into a single large buffer.  When offsets are given,
+    ///                         the corresponding limit size is required and also sets the size of the bound range.
     ///
     /// @see SetVertexConstantBuffers()
     void RRenderCommandProxy::SetPixelConstantBuffers(
         size_t startIndex,
         size_t bufferCount,
         RConstantBufferPtr const* pspBuffers,
-        const size_t* pLimitSizes )
+        const size_t* pLimitSizes,
+        const size_t* pOffsets )
     {
         SetPixelConstantBuffers(
             startIndex,
             bufferCount,
             &static_cast< RConstantBuffer* const& >( pspBuffers[ 0 ] ),
-            pLimitSizes );
+            pLimitSizes,
+            pOffsets );
     }
 }
@@ -395,7 +395,8 @@ public:
         size_t startIndex,
         size_t bufferCount,
         RConstantBuffer* const* ppBuffers,
-        const size_t* pLimitSizes )
+        const size_t* pLimitSizes,
+        const size_t* pOffsets )
         : m_startIndex( startIndex )
         , m_bufferCount( bufferCount )
     {
@@ -420,6 +421,15 @@ public:
         {
             MemorySet( m_limitSizes, 0xff, bufferCount * sizeof( size_t ) );
         }
+
+        if( pOffsets )
+        {
+            MemoryCopy( m_offsets, pOffsets, bufferCount * sizeof( size_t ) );
+        }
+        else
+        {
+            MemorySet( m_offsets, 0xff, bufferCount * sizeof( size_t ) );
+        }
     }
 
     ~D3D9SetConstantBuffersCommand()
@@ -431,6 +441,7 @@ protected:
     size_t m_bufferCount;
     RConstantBufferPtr m_buffers[ D3D9ImmediateCommandProxy::CONSTANT_BUFFER_SLOT_COUNT ];
     size_t m_limitSizes[ D3D9ImmediateCommandProxy::CONSTANT_BUFFER_SLOT_COUNT ];
+    size_t m_offsets[ D3D9ImmediateCommandProxy::CONSTANT_BUFFER_SLOT_COUNT ];
 };
 
 class D3D9SetVertexConstantBuffersCommand : public D3D9SetConstantBuffersCommand
@@ -440,8 +451,9 @@ public:
         size_t startIndex,
         size_t bufferCount,
         RConstantBuffer* const* ppBuffers,
-        const size_t* pLimitSizes )
-        : D3D9SetConstantBuffersCommand( startIndex, bufferCount, ppBuffers, pLimitSizes )
+        const size_t* pLimitSizes,
+        const size_t* pOffsets )
+        : D3D9SetConstantBuffersCommand( startIndex, bufferCount, ppBuffers, pLimitSizes, pOffsets )
     {
     }
 
@@ -451,7 +463,8 @@ public:
             m_startIndex,
             m_bufferCount,
             &static_cast< RConstantBuffer* const& >( m_buffers[ 0 ] ),
-            m_limitSizes );
+            m_limitSizes,
+            m_offsets );
     }
 };
 
@@ -462,8 +475,9 @@ public:
         size_t startIndex,
         size_t bufferCount,
         RConstantBuffer* const* ppBuffers,
-        const size_t* pLimitSizes )
-        : D3D9SetConstantBuffersCommand( startIndex, bufferCount, ppBuffers, pLimitSizes )
+        const size_t* pLimitSizes,
+        const size_t* pOffsets )
+        : D3D9SetConstantBuffersCommand( startIndex, bufferCount, ppBuffers, pLimitSizes, pOffsets )
     {
     }
 
@@ -473,7 +487,8 @@ public:
             m_startIndex,
             m_bufferCount,
             &static_cast< RConstantBuffer* const& >( m_buffers[ 0 ] ),
-            m_limitSizes );
+            m_limitSizes,
+            m_offsets );
     }
 };
 
@@ -721,13 +736,15 @@ HELIUM_DEFERRED_COMMAND_PROXY_METHOD(
 
 HELIUM_DEFERRED_COMMAND_PROXY_METHOD(
     SetVertexConstantBuffers,
-    ( size_t startIndex, size_t bufferCount, RConstantBuffer* const* ppBuffers, const size_t* pLimitSizes ),
-    ( startIndex, bufferCount, ppBuffers, pLimitSizes ) )
+    ( size_t startIndex, size_t bufferCount, RConstantBuffer* const* ppBuffers, const size_t* pLimitSizes,
+      const size_t* pOffsets ),
+    ( startIndex, bufferCount, ppBuffers, pLimitSizes, pOffsets ) )
 
 HELIUM_DEFERRED_COMMAND_PROXY_METHOD(
     SetPixelConstantBuffers,
-    ( size_t startIndex, size_t bufferCount, RConstantBuffer* const* ppBuffers, const size_t* pLimitSizes ),
-    ( startIndex, bufferCount, ppBuffers, pLimitSizes ) )
+    ( size_t startIndex, size_t bufferCount, RConstantBuffer* const* ppBuffers, const size_t* pLimitSizes,
+      const size_t* pOffsets ),
+    ( startIndex, bufferCount, ppBuffers, pLimitSizes, pOffsets ) )
 
 HELIUM_DEFERRED_COMMAND_PROXY_METHOD(
     SetTexture,
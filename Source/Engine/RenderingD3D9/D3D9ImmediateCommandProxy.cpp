@@ -560,7 +560,8 @@ void D3D9ImmediateCommandProxy::SetVertexConstantBuffers(
     size_t startIndex,
     size_t bufferCount,
     RConstantBuffer* const* ppBuffers,
-    const size_t* pLimitSizes )
+    const size_t* pLimitSizes,
+    const size_t* pOffsets )
 {
     HELIUM_ASSERT( ppBuffers || bufferCount == 0 );
 
@@ -588,25 +589,13 @@ void D3D9ImmediateCommandProxy::SetVertexConstantBuffers(
         bufferCount = availableSlots;
     }
 
-    if( pLimitSizes )
+    for( size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex )
     {
-        for( size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex )
-        {
-            m_vertexConstantManager.SetBuffer(
-                startIndex + bufferIndex,
-                static_cast< D3D9ConstantBuffer* >( ppBuffers[ bufferIndex ] ),
-                pLimitSizes[ bufferIndex ] );
-        }
-    }
-    else
-    {
-        for( size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex )
-        {
-            m_vertexConstantManager.SetBuffer(
-                startIndex + bufferIndex,
-                static_cast< D3D9ConstantBuffer* >( ppBuffers[ bufferIndex ] ),
-                Invalid< size_t >() );
-        }
+        m_vertexConstantManager.SetBuffer(
+            startIndex + bufferIndex,
+            static_cast< D3D9ConstantBuffer* >( ppBuffers[ bufferIndex ] ),
+            ( pOffsets ? pOffsets[ bufferIndex ] : Invalid< size_t >() ),
+            ( pLimitSizes ? pLimitSizes[ bufferIndex ] : Invalid< size_t >() ) );
     }
 }
 
@@ -615,7 +604,8 @@ void D3D9ImmediateCommandProxy::SetPixelConstantBuffers(
     size_t startIndex,
     size_t bufferCount,
     RConstantBuffer* const* ppBuffers,
-    const size_t* pLimitSizes )
+    const size_t* pLimitSizes,
+    const size_t* pOffsets )
 {
     HELIUM_ASSERT( ppBuffers || bufferCount == 0 );
 
@@ -643,25 +633,13 @@ void D3D9ImmediateCommandProxy::SetPixelConstantBuffers(
         bufferCount = availableSlots;
     }
 
-    if( pLimitSizes )
+    for( size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex )
     {
-        for( size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex )
-        {
-            m_pixelConstantManager.SetBuffer(
-                startIndex + bufferIndex,
-                static_cast< D3D9ConstantBuffer* >( ppBuffers[ bufferIndex ] ),
-                pLimitSizes[ bufferIndex ] );
-        }
-    }
-    else
-    {
-        for( size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex )
-        {
-            m_pixelConstantManager.SetBuffer(
-                startIndex + bufferIndex,
-                static_cast< D3D9ConstantBuffer* >( ppBuffers[ bufferIndex ] ),
-                Invalid< size_t >() );
-        }
+        m_pixelConstantManager.SetBuffer(
+            startIndex + bufferIndex,
+            static_cast< D3D9ConstantBuffer* >( ppBuffers[ bufferIndex ] ),
+            ( pOffsets ? pOffsets[ bufferIndex ] : Invalid< size_t >() ),
+            ( pLimitSizes ? pLimitSizes[ bufferIndex ] : Invalid< size_t >() ) );
     }
 }
 
@@ -848,8 +826,8 @@ void D3D9ImmediateCommandProxy::UnbindResources()
 
     for( size_t constantBufferIndex = 0; constantBufferIndex < CONSTANT_BUFFER_SLOT_COUNT; ++constantBufferIndex )
     {
-        m_vertexConstantManager.SetBuffer( constantBufferIndex, NULL, Invalid< size_t >() );
-        m_pixelConstantManager.SetBuffer( constantBufferIndex, NULL, Invalid< size_t >() );
+        m_vertexConstantManager.SetBuffer( constantBufferIndex, NULL, Invalid< size_t >(), Invalid< size_t >() );
+        m_pixelConstantManager.SetBuffer( constantBufferIndex, NULL, Invalid< size_t >(), Invalid< size_t >() );
     }
 }
 
@@ -885,6 +863,8 @@ void D3D9ImmediateCommandProxy::FinishCommandList( RRenderCommandListPtr& rspCom
 template< typename Pusher, size_t RegisterCount >
 D3D9ImmediateCommandProxy::ConstantManager< Pusher, RegisterCount >::ConstantManager()
 {
+    MemoryZero( m_bufferOffsets, sizeof( m_bufferOffsets ) );
+    MemoryZero( m_bufferRegisterCounts, sizeof( m_bufferRegisterCounts ) );
 }
 
 /// Destructor.
@@ -897,7 +877,10 @@ D3D9ImmediateCommandProxy::ConstantManager< Pusher, RegisterCount >::~ConstantMa
 ///
 /// @param[in] index      Constant buffer slot index.
 /// @param[in] pBuffer    Constant buffer to set.
-/// @param[in] limitSize  Number of bytes, starting from the beginning of the buffer, in which to limit updates to
+/// @param[in] offset     Offset (in bytes) of the range of the buffer to bind to the slot, or an invalid value to bind
+///                       the entire buffer.  If valid, the limit size must also be valid and sets the number of bytes
+///                       covered by the slot.
+/// @param[in] limitSize  Number of bytes, starting from the beginning of the bound range, in which to limit updates to
 ///                       shader constant registers.
 ///
 /// @see GetBuffer()
@@ -905,70 +888,81 @@ template< typename Pusher, size_t RegisterCount >
 void D3D9ImmediateCommandProxy::ConstantManager< Pusher, RegisterCount >::SetBuffer(
     size_t index,
     D3D9ConstantBuffer* pBuffer,
+    size_t offset,
     size_t limitSize )
 {
     HELIUM_ASSERT( index < HELIUM_ARRAY_COUNT( m_buffers ) );
 
     // Convert constant buffer size limits from bytes to register counts.
+    uint16_t limitRegisterCount;
     if( IsValid( limitSize ) )
     {
-        m_bufferLimitSizes[ index ] = static_cast< uint16_t >( Min< size_t >(
+        limitRegisterCount = static_cast< uint16_t >( Min< size_t >(
             ( limitSize + ( sizeof( float32_t ) * 4 - 1 ) ) / ( sizeof( float32_t ) * 4 ),
             UINT16_MAX ) );
     }
     else
     {
-        SetInvalid( m_bufferLimitSizes[ index ] );
+        SetInvalid( limitRegisterCount );
     }
 
-    D3D9ConstantBuffer* pOldBuffer = m_buffers[ index ];
-    if( pOldBuffer != pBuffer )
+    m_bufferLimitSizes[ index ] = limitRegisterCount;
+
+    // Determine the range of buffer registers covered by the slot.  Buffers bound at an offset only cover the range
+    // given by their limit size, so that the registers of any buffers in the following slots remain in place.
+    uint16_t offsetRegister = 0;
+    uint16_t registerCount = 0;
+    if( pBuffer )
     {
-        uint_fast16_t oldRegisterCount = 0;
-        if( pOldBuffer )
+        registerCount = pBuffer->GetRegisterCount();
+        if( IsValid( offset ) )
         {
-            oldRegisterCount = pOldBuffer->GetRegisterCount();
+            HELIUM_ASSERT( offset % ( sizeof( float32_t ) * 4 ) == 0 );
+            HELIUM_ASSERT( IsValid( limitSize ) );
+
+            offsetRegister = static_cast< uint16_t >( Min< size_t >(
+                offset / ( sizeof( float32_t ) * 4 ),
+                registerCount ) );
+            registerCount = Min< uint16_t >( registerCount - offsetRegister, limitRegisterCount );
         }
+    }
 
-        uint_fast16_t newRegisterCount = 0;
-        if( pBuffer )
+    uint_fast16_t oldRegisterCount = m_bufferRegisterCounts[ index ];
+    uint_fast16_t newRegisterCount = registerCount;
+    if( oldRegisterCount != newRegisterCount )
+    {
+        // Register count changed, so invalidate all registers in buffers that follow the one being assigned.
+        uint_fast16_t invalidRegisterStart = newRegisterCount;
+        for( size_t previousIndex = 0; previousIndex < index; ++previousIndex )
         {
-            newRegisterCount = pBuffer->GetRegisterCount();
+            invalidRegisterStart += m_bufferRegisterCounts[ previousIndex ];
         }
 
-        if( oldRegisterCount != newRegisterCount )
+        uint_fast16_t invalidRegisterElementIndex = invalidRegisterStart / ( sizeof( uint32_t ) * 8 );
+        if( invalidRegisterElementIndex < HELIUM_ARRAY_COUNT( m_dirtyRegisters ) )
         {
-            // Register count changed, so invalidate all registers in buffers that follow the one being assigned.
-            uint_fast16_t invalidRegisterStart = newRegisterCount;
-            for( size_t previousIndex = 0; previousIndex < index; ++previousIndex )
-            {
-                D3D9ConstantBuffer* pPreviousBuffer = m_buffers[ previousIndex ];
-                if( pPreviousBuffer )
-                {
-                    invalidRegisterStart += pPreviousBuffer->GetRegisterCount();
-                }
-            }
-
-            uint_fast16_t invalidRegisterElementIndex = invalidRegisterStart / ( sizeof( uint32_t ) * 8 );
-            if( invalidRegisterElementIndex < HELIUM_ARRAY_COUNT( m_dirtyRegisters ) )
+            uint_fast16_t invalidRegisterBit = invalidRegisterStart % ( sizeof( uint32_t ) * 8 );
+            if( invalidRegisterBit != 0 )
             {
-                uint_fast16_t invalidRegisterBit = invalidRegisterStart % ( sizeof( uint32_t ) * 8 );
-                if( invalidRegisterBit != 0 )
-                {
-                    uint32_t bitMask = ~( ( 1U << invalidRegisterBit ) - 1 );
-                    m_dirtyRegisters[ invalidRegisterElementIndex ] |= bitMask;
-
-                    ++invalidRegisterElementIndex;
-                }
+                uint32_t bitMask = ~( ( 1U << invalidRegisterBit ) - 1 );
+                m_dirtyRegisters[ invalidRegisterElementIndex ] |= bitMask;
 
-                MemorySet(
-                    m_dirtyRegisters,
-                    0xff,
-                    ( HELIUM_ARRAY_COUNT( m_dirtyRegisters ) - invalidRegisterElementIndex ) * sizeof( uint32_t ) );
+                ++invalidRegisterElementIndex;
             }
+
+            MemorySet(
+                m_dirtyRegisters,
+                0xff,
+                ( HELIUM_ARRAY_COUNT( m_dirtyRegisters ) - invalidRegisterElementIndex ) * sizeof( uint32_t ) );
         }
+    }
 
+    D3D9ConstantBuffer* pOldBuffer = m_buffers[ index ];
+    if( pOldBuffer != pBuffer || m_bufferOffsets[ index ] != offsetRegister || oldRegisterCount != newRegisterCount )
+    {
         m_buffers[ index ] = pBuffer;
+        m_bufferOffsets[ index ] = offsetRegister;
+        m_bufferRegisterCounts[ index ] = registerCount;
         if( pBuffer )
         {
             // Set the buffer tag as one minus its actual tag to force its contents to be updated during the next
@@ -1028,8 +1022,9 @@ void D3D9ImmediateCommandProxy::ConstantManager< Pusher, RegisterCount >::Push(
         }
 
         // Push dirty registers.
-        const float32_t* pData = static_cast< const float32_t* >( pBuffer->GetData() );
-        uint_fast16_t bufferRegisterCount = pBuffer->GetRegisterCount();
+        const float32_t* pData =
+            static_cast< const float32_t* >( pBuffer->GetData() ) + m_bufferOffsets[ bufferIndex ] * 4;
+        uint_fast16_t bufferRegisterCount = m_bufferRegisterCounts[ bufferIndex ];
         HELIUM_ASSERT( pData || bufferRegisterCount == 0 );
 
         uint_fast16_t bufferRegisterLimit = Min< uint_fast16_t >(
@@ -300,7 +300,8 @@ void GLImmediateCommandProxy::SetVertexConstantBuffers(
 	size_t startIndex,
 	size_t bufferCount,
 	RConstantBuffer* const* ppBuffers,
-	const size_t* pLimitSizes )
+	const size_t* pLimitSizes,
+	const size_t* pOffsets )
 {
 	// TODO: Implement later. HELIUM_BREAK();
 }
@@ -310,7 +311,8 @@ void GLImmediateCommandProxy::SetPixelConstantBuffers(
 	size_t startIndex,
 	size_t bufferCount,
 	RConstantBuffer* const* ppBuffers,
-	const size_t* pLimitSizes )
+	const size_t* pLimitSizes,
+	const size_t* pOffsets )
 {
 	// TODO: Implement later. HELIUM_BREAK();
 }
@@ -57,10 +57,10 @@ namespace Helium
 
 		void SetVertexConstantBuffers(
 			size_t startIndex, size_t bufferCount, RConstantBuffer* const* ppBuffers,
-			const size_t* pLimitSizes = NULL );
+			const size_t* pLimitSizes = NULL, const size_t* pOffsets = NULL );
 		void SetPixelConstantBuffers(
 			size_t startIndex, size_t bufferCount, RConstantBuffer* const* ppBuffers,
-			const size_t* pLimitSizes = NULL );
+			const size_t* pLimitSizes = NULL, const size_t* pOffsets = NULL );
 
 		void SetTexture( size_t samplerIndex, RTexture* pTexture );
 
@@ -33,6 +33,16 @@ project( prefix .. "Engine" )
 		"Source/Engine/Engine/*",
 	}
 
+	excludes
+	{
+		"Source/Engine/Engine/*Tests.*",
+	}
+
+	includedirs
+	{
+		"Dependencies/zlib",
+	}
+
 	filter "kind:SharedLib"
 		links
 		{
@@ -44,10 +54,41 @@ project( prefix .. "Engine" )
 			prefix .. "Reflect",
 			prefix .. "Foundation",
 			prefix .. "Platform",
+
+			"zlib",
 		}
 
 	filter {}
 
+project( prefix .. "EngineTests" )
+
+	Helium.DoTestsProjectSettings()
+
+	files
+	{
+		"Source/Engine/Engine/*Tests.*",
+	}
+
+	includedirs
+	{
+		"Dependencies/zlib",
+	}
+
+	links
+	{
+		prefix .. "Engine",
+		prefix .. "MathSimd",
+
+		-- core
+		prefix .. "Math",
+		prefix .. "Persist",
+		prefix .. "Reflect",
+		prefix .. "Foundation",
+		prefix .. "Platform",
+
+		"zlib",
+	}
+
 project( prefix .. "EngineJobs" )
 
 	Helium.DoModuleProjectSettings( "Source/Engine", "HELIUM", "EngineJobs", "ENGINE_JOBS" )
@@ -57,6 +98,11 @@ project( prefix .. "EngineJobs" )
 		"Source/Engine/EngineJobs/*",
 	}
 
+	excludes
+	{
+		"Source/Engine/EngineJobs/*Tests.*",
+	}
+
 	filter "kind:SharedLib"
 		links
 		{
@@ -73,6 +119,29 @@ project( prefix .. "EngineJobs" )
 	
 	filter {}
 
+project( prefix .. "EngineJobsTests" )
+
+	Helium.DoTestsProjectSettings()
+
+	files
+	{
+		"Source/Engine/EngineJobs/*Tests.*",
+	}
+
+	links
+	{
+		prefix .. "EngineJobs",
+		prefix .. "Engine",
+		prefix .. "MathSimd",
+
+		-- core
+		prefix .. "Math",
+		prefix .. "Persist",
+		prefix .. "Reflect",
+		prefix .. "Foundation",
+		prefix .. "Platform",
+	}
+
 project( prefix .. "Windowing" )
 
 	Helium.DoModuleProjectSettings( "Source/Engine", "HELIUM", "Windowing", "WINDOWING" )
@@ -253,6 +322,11 @@ project( prefix .. "GraphicsJobs" )
 		"Source/Engine/GraphicsJobs/*",
 	}
 
+	excludes
+	{
+		"Source/Engine/GraphicsJobs/*Tests.*",
+	}
+
 	filter "kind:SharedLib"
 		links
 		{
@@ -272,6 +346,32 @@ project( prefix .. "GraphicsJobs" )
 
 	filter {}
 
+project( prefix .. "GraphicsJobsTests" )
+
+	Helium.DoTestsProjectSettings()
+
+	files
+	{
+		"Source/Engine/GraphicsJobs/*Tests.*",
+	}
+
+	links
+	{
+		prefix .. "GraphicsJobs",
+		prefix .. "GraphicsTypes",
+		prefix .. "Rendering",
+		prefix .. "EngineJobs",
+		prefix .. "Engine",
+		prefix .. "MathSimd",
+
+		-- core
+		prefix .. "Math",
+		prefix .. "Persist",
+		prefix .. "Reflect",
+		prefix .. "Foundation",
+		prefix .. "Platform",
+	}
+
 project( prefix .. "Graphics" )
 
 	Helium.DoModuleProjectSettings( "Source/Engine", "HELIUM", "Graphics", "GRAPHICS" )
@@ -282,6 +382,11 @@ project( prefix .. "Graphics" )
 		"Source/Engine/Graphics/*",
 	}
 
+	excludes
+	{
+		"Source/Engine/Graphics/*Tests.*",
+	}
+
 	filter "kind:SharedLib"
 		links
 		{
@@ -303,6 +408,34 @@ project( prefix .. "Graphics" )
 
 	filter {}
 
+project( prefix .. "GraphicsTests" )
+
+	Helium.DoTestsProjectSettings()
+
+	files
+	{
+		"Source/Engine/Graphics/*Tests.*",
+	}
+
+	links
+	{
+		prefix .. "Graphics",
+		prefix .. "GraphicsJobs",
+		prefix .. "GraphicsTypes",
+		prefix .. "Framework",
+		prefix .. "Rendering",
+		prefix .. "EngineJobs",
+		prefix .. "Engine",
+		prefix .. "MathSimd",
+
+		-- core
+		prefix .. "Math",
+		prefix .. "Persist",
+		prefix .. "Reflect",
+		prefix .. "Foundation",
+		prefix .. "Platform",
+	}
+
 project( prefix .. "Components" )
 
 	Helium.DoModuleProjectSettings( "Source/Engine", "HELIUM", "Components", "COMPONENTS" )
@@ -420,6 +553,11 @@ project( prefix .. "Framework" )
 		"Source/Engine/Framework/*",
 	}
 
+	excludes
+	{
+		"Source/Engine/Framework/*Tests.*",
+	}
+
 	filter "kind:SharedLib"
 		links
 		{
@@ -437,6 +575,30 @@ project( prefix .. "Framework" )
 
 	filter {}
 
+project( prefix .. "FrameworkTests" )
+
+	Helium.DoTestsProjectSettings()
+
+	files
+	{
+		"Source/Engine/Framework/*Tests.*",
+	}
+
+	links
+	{
+		prefix .. "Framework",
+		prefix .. "EngineJobs",
+		prefix .. "Engine",
+		prefix .. "MathSimd",
+
+		-- core
+		prefix .. "Math",
+		prefix .. "Persist",
+		prefix .. "Reflect",
+		prefix .. "Foundation",
+		prefix .. "Platform",
+	}
+
 project( prefix .. "FrameworkImpl" )
 
 	Helium.DoModuleProjectSettings( "Source/Engine", "HELIUM", "FrameworkImpl", "FRAMEWORK_IMPL" )
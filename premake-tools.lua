@@ -24,6 +24,11 @@ project( prefix .. "PcSupport" )
 		"Source/Engine/PcSupport/*",
 	}
 
+	excludes
+	{
+		"Source/Engine/PcSupport/*Tests.*",
+	}
+
 	filter "kind:SharedLib"
 		links
 		{
@@ -42,6 +47,31 @@ project( prefix .. "PcSupport" )
 
 	filter {}
 
+project( prefix .. "PcSupportTests" )
+
+	Helium.DoTestsProjectSettings()
+
+	files
+	{
+		"Source/Engine/PcSupport/*Tests.*",
+	}
+
+	links
+	{
+		prefix .. "PcSupport",
+		prefix .. "EngineJobs",
+		prefix .. "Rendering",
+		prefix .. "Engine",
+		prefix .. "MathSimd",
+
+		-- core
+		prefix .. "Math",
+		prefix .. "Persist",
+		prefix .. "Reflect",
+		prefix .. "Foundation",
+		prefix .. "Platform",
+	}
+
 project( prefix .. "PreprocessingPc" )
 
 	Helium.DoModuleProjectSettings( "Source/Engine", "HELIUM", "PreprocessingPc", "PREPROCESSING_PC" )
@@ -85,6 +115,11 @@ project( prefix .. "EditorSupport" )
 		"Source/Engine/EditorSupport/*",
 	}
 
+	excludes
+	{
+		"Source/Engine/EditorSupport/*Tests.*",
+	}
+
 	includedirs
 	{
 		"Dependencies/nvtt",
@@ -126,6 +161,46 @@ project( prefix .. "EditorSupport" )
 
 	filter {}
 
+project( prefix .. "EditorSupportTests" )
+
+	Helium.DoTestsProjectSettings()
+	Helium.DoGraphicsProjectSettings()
+	Helium.DoFbxProjectSettings()
+
+	files
+	{
+		"Source/Engine/EditorSupport/*Tests.*",
+	}
+
+	links
+	{
+		prefix .. "EditorSupport",
+		prefix .. "PreprocessingPc",
+		prefix .. "PcSupport",
+		prefix .. "Framework",
+		prefix .. "Graphics",
+		prefix .. "GraphicsJobs",
+		prefix .. "GraphicsTypes",
+		prefix .. "Rendering",
+		prefix .. "Windowing",
+		prefix .. "EngineJobs",
+		prefix .. "Engine",
+		prefix .. "MathSimd",
+
+		-- core
+		prefix .. "Math",
+		prefix .. "Persist",
+		prefix .. "Reflect",
+		prefix .. "Foundation",
+		prefix .. "Platform",
+
+		"freetype",
+		"libpng",
+		"nvtt",
+		"zlib",
+		"mongo-c",
+	}
+
 project( prefix .. "EditorScene" )
 
 	Helium.DoModuleProjectSettings( "Source/Tools", "HELIUM", "EditorScene", "EDITOR_SCENE" )
@@ -267,6 +342,7 @@ project( prefix .. "Editor" )
 		"bullet",
 		"mongo-c",
 		"ois",
+		"zlib",
 	}
 
 	filter "system:linux"
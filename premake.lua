@@ -406,6 +406,7 @@ Helium.DoGameProjectSettings = function( name )
 		"bullet",
 		"mongo-c",
 		"ois",
+		"zlib",
 	}
 
 	if _OPTIONS[ "gfxapi" ] == "opengl" then